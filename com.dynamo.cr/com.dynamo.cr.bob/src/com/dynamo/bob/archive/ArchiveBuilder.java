@@ -65,6 +65,7 @@ public class ArchiveBuilder {
     private byte[] archiveIndexMD5 = new byte[MD5_HASH_DIGEST_BYTE_LENGTH];
     private int resourcePadding = 4;
     private boolean forceCompression = false; // for building unit tests to create test content
+    private ResourceEncryption.Algorithm encryptionAlgorithm = ResourceEncryption.Algorithm.XTEA;
 
     public ArchiveBuilder(String root, ManifestBuilder manifestBuilder, int resourcePadding) {
         this.root = new File(root).getAbsolutePath();
@@ -133,8 +134,12 @@ public class ArchiveBuilder {
         return ratio <= 0.95;
     }
 
+    public void setEncryptionAlgorithm(ResourceEncryption.Algorithm algorithm) {
+        this.encryptionAlgorithm = algorithm;
+    }
+
     public byte[] encryptResourceData(byte[] buffer) throws CompileExceptionError {
-        return ResourceEncryption.encrypt(buffer);
+        return ResourceEncryption.encrypt(buffer, this.encryptionAlgorithm);
     }
 
     public void writeResourcePack(ArchiveEntry entry, String directory, byte[] buffer) throws IOException {
@@ -207,6 +212,9 @@ public class ArchiveBuilder {
 
         Collections.sort(entries); // Since it has no hash, it sorts on path
 
+        // A custom encryption plugin overrides the selected algorithm
+        boolean encryptWithAes = ResourceEncryption.getEffectiveAlgorithm(this.encryptionAlgorithm) == ResourceEncryption.Algorithm.AES_CTR;
+
         for (int i = entries.size() - 1; i >= 0; --i) {
             ArchiveEntry entry = entries.get(i);
 
@@ -232,6 +240,10 @@ public class ArchiveBuilder {
             if (entry.isEncrypted()) {
                 buffer = this.encryptResourceData(buffer);
                 resourceEntryFlags |= ResourceEntryFlag.ENCRYPTED.getNumber();
+                if (encryptWithAes) {
+                    entry.setFlag(ArchiveEntry.FLAG_ENCRYPTED_AES);
+                    resourceEntryFlags |= ResourceEntryFlag.ENCRYPTED_AES.getNumber();
+                }
             }
 
             // Add entry to manifest
@@ -23,6 +23,7 @@ public class ArchiveEntry implements Comparable<ArchiveEntry> {
     public static final int FLAG_ENCRYPTED = 1 << 0;
     public static final int FLAG_COMPRESSED = 1 << 1;
     public static final int FLAG_LIVEUPDATE = 1 << 2;
+    public static final int FLAG_ENCRYPTED_AES = 1 << 3; // set together with FLAG_ENCRYPTED
     public static final int FLAG_UNCOMPRESSED = 0xFFFFFFFF;
 
     private int size;
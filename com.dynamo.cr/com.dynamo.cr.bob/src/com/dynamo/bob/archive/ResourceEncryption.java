@@ -24,18 +24,48 @@ import java.util.List;
 
 public class ResourceEncryption {
 
+	public enum Algorithm {
+		XTEA,
+		AES_CTR
+	}
+
 	private static class DefaultResourceEncryption extends ResourceEncryptionPlugin {
 		private final byte[] KEY = "aQj8CScgNP4VsfXK".getBytes();
-	
+		private final Algorithm algorithm;
+
+		public DefaultResourceEncryption(Algorithm algorithm) {
+			this.algorithm = algorithm;
+		}
+
 		@Override
 		public byte[] encrypt(byte[] resource) throws Exception {
+			if (algorithm == Algorithm.AES_CTR) {
+				return Crypt.encryptAesCTR(resource, KEY);
+			}
 			return Crypt.encryptCTR(resource, KEY);
 		}
 	}
 
-	private static ResourceEncryptionPlugin encryptionPlugin;
+	private static DefaultResourceEncryption defaultEncryption = new DefaultResourceEncryption(Algorithm.XTEA);
+	private static DefaultResourceEncryption defaultAesEncryption = new DefaultResourceEncryption(Algorithm.AES_CTR);
 
-	private static DefaultResourceEncryption defaultEncryption = new DefaultResourceEncryption();
+	private static ResourceEncryptionPlugin getCustomPlugin() throws CompileExceptionError {
+		return PluginScanner.getOrCreatePlugin("com.dynamo.bob.archive", ResourceEncryptionPlugin.class);
+	}
+
+	/**
+	 * Get the algorithm that will actually be used when asking for a specific algorithm.
+	 * A custom encryption plugin always takes precedence, and the runtime will decrypt
+	 * such resources with the custom decryption function, i.e. they're treated as XTEA.
+	 * @param requested The algorithm selected for the project
+	 * @return The algorithm that is used to encrypt the resources
+	 */
+	public static Algorithm getEffectiveAlgorithm(Algorithm requested) throws CompileExceptionError {
+		if (getCustomPlugin() != null) {
+			return Algorithm.XTEA;
+		}
+		return requested;
+	}
 
 	/**
 	 * Encrypt a resource
@@ -43,11 +73,23 @@ public class ResourceEncryption {
 	 * @return Bytes of encrypted resource data
 	 */
 	public static byte[] encrypt(byte[] resource) throws CompileExceptionError {
+		return encrypt(resource, Algorithm.XTEA);
+	}
+
+	/**
+	 * Encrypt a resource
+	 * @param resource Bytes of resource data to encrypt
+	 * @param algorithm The algorithm to use, unless a custom encryption plugin is present
+	 * @return Bytes of encrypted resource data
+	 */
+	public static byte[] encrypt(byte[] resource, Algorithm algorithm) throws CompileExceptionError {
 		try {
-			ResourceEncryptionPlugin encryptionPlugin = PluginScanner.getOrCreatePlugin("com.dynamo.bob.archive", ResourceEncryptionPlugin.class);
-				
+			ResourceEncryptionPlugin encryptionPlugin = getCustomPlugin();
+
 			// default or custom encryption
-			encryptionPlugin = encryptionPlugin == null ? defaultEncryption : encryptionPlugin;
+			if (encryptionPlugin == null) {
+				encryptionPlugin = algorithm == Algorithm.AES_CTR ? defaultAesEncryption : defaultEncryption;
+			}
 
 			// do the encryption
 			return encryptionPlugin.encrypt(resource);
@@ -57,4 +99,4 @@ public class ResourceEncryption {
 			throw new CompileExceptionError("Unable to encrypt resource", e);
 		}
 	}
-}
\ No newline at end of file
+}
@@ -55,6 +55,7 @@ import com.dynamo.bob.archive.ArchiveBuilder;
 import com.dynamo.bob.archive.ArchiveEntry;
 import com.dynamo.bob.archive.EngineVersion;
 import com.dynamo.bob.archive.ManifestBuilder;
+import com.dynamo.bob.archive.ResourceEncryption;
 import com.dynamo.bob.archive.publisher.Publisher;
 import com.dynamo.bob.bundle.BundleHelper;
 import com.dynamo.bob.fs.IResource;
@@ -221,6 +222,13 @@ public class GameProjectBuilder extends Builder<Void> {
 
         ArchiveBuilder archiveBuilder = new ArchiveBuilder(root, manifestBuilder, resourcePadding);
 
+        String encryptionAlgorithm = project.getProjectProperties().getStringValue("project", "archive_encryption", "xtea");
+        if (encryptionAlgorithm.equals("aes")) {
+            archiveBuilder.setEncryptionAlgorithm(ResourceEncryption.Algorithm.AES_CTR);
+        } else if (!encryptionAlgorithm.equals("xtea")) {
+            throw new CompileExceptionError(String.format("Unknown project.archive_encryption '%s', expected 'xtea' or 'aes'", encryptionAlgorithm));
+        }
+
         boolean doCompress = project.getProjectProperties().getBooleanValue("project", "compress_archive", true);
         HashMap<String, EnumSet<Project.OutputFlags>> outputs = project.getOutputs();
         for (String s : resources) {
@@ -145,6 +145,8 @@ public class MeshsetBuilder extends Builder<Void>  {
         }
 
         ModelImporter.Options options = new ModelImporter.Options();
+        options.lodCount = this.project.getProjectProperties().getIntValue("model", "lod_count", 0);
+        options.lodReduction = Float.parseFloat(this.project.getProjectProperties().getStringValue("model", "lod_reduction", "0.5"));
         ResourceDataResolver dataResolver = new ResourceDataResolver(this.project);
         ModelImporter.Scene scene = ModelUtil.loadScene(task.input(0).getContent(), task.input(0).getPath(), options, dataResolver);
         if (scene == null) {
@@ -611,6 +611,21 @@ public class ModelUtil {
             meshBuilder.setIndices(ByteString.copyFrom(create16BitIndices(mesh.indices)));
         }
 
+        if (mesh.lods != null) {
+            for (ModelImporter.MeshLod lod : mesh.lods) {
+                Rig.MeshLod.Builder lodBuilder = Rig.MeshLod.newBuilder();
+                lodBuilder.setIndicesFormat(meshBuilder.getIndicesFormat());
+                if (mesh.vertexCount >= 65536) {
+                    lodBuilder.setIndices(ByteString.copyFrom(create32BitIndices(lod.indices)));
+                }
+                else {
+                    lodBuilder.setIndices(ByteString.copyFrom(create16BitIndices(lod.indices)));
+                }
+                lodBuilder.setError(lod.error);
+                meshBuilder.addLods(lodBuilder.build());
+            }
+        }
+
         if (mesh.material != null)
             meshBuilder.setMaterialIndex(mesh.material.index);
         else
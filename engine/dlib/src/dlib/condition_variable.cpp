@@ -18,6 +18,8 @@
 
 #if defined(__linux__) || defined(__MACH__) || defined(__EMSCRIPTEN__)
 #include <pthread.h>
+#include <errno.h>
+#include <sys/time.h>
 #elif defined(_WIN32)
 #include "safe_windows.h"
 #else
@@ -61,6 +63,20 @@ namespace dmConditionVariable
         assert(ret == 0);
     }
 
+    bool TimedWait(HConditionVariable condition, dmMutex::HMutex mutex, uint64_t timeout)
+    {
+        assert(condition);
+        struct timeval now;
+        gettimeofday(&now, 0);
+        uint64_t usec = (uint64_t)now.tv_usec + timeout;
+        struct timespec end;
+        end.tv_sec = now.tv_sec + (time_t)(usec / 1000000);
+        end.tv_nsec = (long)(usec % 1000000) * 1000;
+        int ret = pthread_cond_timedwait(&condition->m_NativeHandle, &mutex->m_NativeHandle, &end);
+        assert(ret == 0 || ret == ETIMEDOUT);
+        return ret == 0;
+    }
+
     void Signal(HConditionVariable condition)
     {
         assert(condition);
@@ -97,6 +113,15 @@ namespace dmConditionVariable
         assert(ret);
     }
 
+    bool TimedWait(HConditionVariable condition, dmMutex::HMutex mutex, uint64_t timeout)
+    {
+        assert(condition);
+        DWORD ms = (DWORD)((timeout + 999) / 1000);
+        BOOL ret = SleepConditionVariableCS(&condition->m_NativeHandle, &mutex->m_NativeHandle, ms);
+        assert(ret || GetLastError() == ERROR_TIMEOUT);
+        return ret != 0;
+    }
+
     void Signal(HConditionVariable condition)
     {
         assert(condition);
@@ -133,6 +158,11 @@ namespace dmConditionVariable
         // We cannot place assertions here.
     }
 
+    bool TimedWait(HConditionVariable condition, dmMutex::HMutex mutex, uint64_t timeout)
+    {
+        return false;
+    }
+
     void Signal(HConditionVariable condition)
     {
 
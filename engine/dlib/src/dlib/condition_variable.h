@@ -16,5 +16,18 @@
 #define DM_CONDITION_VARIABLE_H
 
 #include <dmsdk/dlib/condition_variable.h>
+#include <stdint.h>
+
+namespace dmConditionVariable
+{
+    /**
+     * Like Wait(), but waits for at most timeout microseconds.
+     * @param condition ConditionVariable handle
+     * @param mutex Mutex handle. The mutex must be locked by the calling thread
+     * @param timeout The timeout in microseconds
+     * @return false if the wait timed out
+     */
+    bool TimedWait(HConditionVariable condition, dmMutex::HMutex mutex, uint64_t timeout);
+}
 
 #endif // #ifndef DM_CONDITION_VARIABLE_H
@@ -416,6 +416,8 @@ namespace dmConnectionPool
     {
         // try connecting to the host using ipv4 first
         uint64_t dial_started = dmTime::GetTime();
+        // resolve the ipv6 address at the same time, so that it is ready if the ipv4 connection fails
+        dmSocket::PrefetchHostByName(host, false, true);
         Result r = DoDial(pool, host, port, ssl, timeout, cancelflag, connection, sock_res, 1, 0);
         // Only if handshake failed NOT because of timeout
         if (r == RESULT_OK || r == RESULT_SHUT_DOWN || r == RESULT_OUT_OF_RESOURCES ||
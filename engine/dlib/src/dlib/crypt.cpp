@@ -18,8 +18,16 @@
 #include <assert.h>
 #include "shared_library.h"
 #include "crypt.h"
+#include "crypt_private.h"
 
+#include <dlib/atomic.h>
+#include <dlib/condition_variable.h>
+#include <dlib/dlib.h>
 #include <dlib/endian.h>
+#include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/thread.h>
+#include <dlib/time.h>
 #include <mbedtls/md5.h>
 #include <mbedtls/base64.h>
 #include <mbedtls/error.h>
@@ -35,6 +43,14 @@
 
 #include <dlib/log.h> // For debugging the manifest verification issue
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DM_XTEA_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define DM_XTEA_NEON
+#endif
+
 namespace dmCrypt
 {
     const uint32_t NUM_ROUNDS = 32;
@@ -54,6 +70,69 @@ namespace dmCrypt
         return ret;
     }
 
+    // Four counter blocks are encrypted at once. The lanes only differ in the counter value,
+    // so the rounds map directly to simd instructions
+    static const uint32_t XTEA_LANES = 4;
+
+    // The per round constants: sum + key[...]
+    static void XTeaRoundConstants(const uint32_t* key, uint32_t* round_a, uint32_t* round_b)
+    {
+        uint32_t sum = 0, delta = 0x9e3779b9;
+        for (uint32_t i = 0; i < NUM_ROUNDS; i++) {
+            round_a[i] = sum + dmEndian::ToHost(key[sum & 3]);
+            sum += delta;
+            round_b[i] = sum + dmEndian::ToHost(key[(sum>>11) & 3]);
+        }
+    }
+
+#if defined(DM_XTEA_SSE2)
+    static void EncryptXTea4(uint64_t counter, const uint32_t* round_a, const uint32_t* round_b, uint32_t* out_v0, uint32_t* out_v1)
+    {
+        __m128i v0 = _mm_set1_epi32((int)(counter >> 32)); // The high words are the same, since the 4 counters start at a multiple of 4
+        __m128i v1 = _mm_add_epi32(_mm_set1_epi32((int)(counter & 0xffffffff)), _mm_set_epi32(3, 2, 1, 0));
+        for (uint32_t i = 0; i < NUM_ROUNDS; i++) {
+            __m128i f1 = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v1, 4), _mm_srli_epi32(v1, 5)), v1);
+            v0 = _mm_add_epi32(v0, _mm_xor_si128(f1, _mm_set1_epi32((int)round_a[i])));
+            __m128i f0 = _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v0, 4), _mm_srli_epi32(v0, 5)), v0);
+            v1 = _mm_add_epi32(v1, _mm_xor_si128(f0, _mm_set1_epi32((int)round_b[i])));
+        }
+        _mm_storeu_si128((__m128i*)out_v0, v0);
+        _mm_storeu_si128((__m128i*)out_v1, v1);
+    }
+#elif defined(DM_XTEA_NEON)
+    static void EncryptXTea4(uint64_t counter, const uint32_t* round_a, const uint32_t* round_b, uint32_t* out_v0, uint32_t* out_v1)
+    {
+        static const uint32_t lane_offsets[4] = {0, 1, 2, 3};
+        uint32x4_t v0 = vdupq_n_u32((uint32_t)(counter >> 32));
+        uint32x4_t v1 = vaddq_u32(vdupq_n_u32((uint32_t)(counter & 0xffffffff)), vld1q_u32(lane_offsets));
+        for (uint32_t i = 0; i < NUM_ROUNDS; i++) {
+            uint32x4_t f1 = vaddq_u32(veorq_u32(vshlq_n_u32(v1, 4), vshrq_n_u32(v1, 5)), v1);
+            v0 = vaddq_u32(v0, veorq_u32(f1, vdupq_n_u32(round_a[i])));
+            uint32x4_t f0 = vaddq_u32(veorq_u32(vshlq_n_u32(v0, 4), vshrq_n_u32(v0, 5)), v0);
+            v1 = vaddq_u32(v1, veorq_u32(f0, vdupq_n_u32(round_b[i])));
+        }
+        vst1q_u32(out_v0, v0);
+        vst1q_u32(out_v1, v1);
+    }
+#else
+    static void EncryptXTea4(uint64_t counter, const uint32_t* round_a, const uint32_t* round_b, uint32_t* out_v0, uint32_t* out_v1)
+    {
+        uint32_t v0[XTEA_LANES], v1[XTEA_LANES];
+        for (uint32_t l = 0; l < XTEA_LANES; ++l) {
+            v0[l] = (uint32_t)(counter >> 32);
+            v1[l] = (uint32_t)(counter & 0xffffffff) + l;
+        }
+        for (uint32_t i = 0; i < NUM_ROUNDS; i++) {
+            for (uint32_t l = 0; l < XTEA_LANES; ++l)
+                v0[l] += (((v1[l] << 4) ^ (v1[l] >> 5)) + v1[l]) ^ round_a[i];
+            for (uint32_t l = 0; l < XTEA_LANES; ++l)
+                v1[l] += (((v0[l] << 4) ^ (v0[l] >> 5)) + v0[l]) ^ round_b[i];
+        }
+        memcpy(out_v0, v0, sizeof(v0));
+        memcpy(out_v1, v1, sizeof(v1));
+    }
+#endif
+
     static void EncryptXTeaCTR(uint8_t* data, uint32_t datalen, const uint8_t* key, uint32_t keylen)
     {
         assert(keylen <= 16);
@@ -63,11 +142,36 @@ namespace dmCrypt
 
         uint64_t counter = 0;
 
+        uint32_t num_blocks = datalen / block_len;
         uint32_t i = 0;
-        uint64_t* d = (uint64_t*) data;
-        for (i = 0; i < datalen / block_len; i++) {
+
+        if (num_blocks >= XTEA_LANES)
+        {
+            uint32_t round_a[NUM_ROUNDS], round_b[NUM_ROUNDS];
+            XTeaRoundConstants((uint32_t*) paddedkey, round_a, round_b);
+
+            for (; i + XTEA_LANES <= num_blocks; i += XTEA_LANES) {
+                uint32_t v0[XTEA_LANES], v1[XTEA_LANES];
+                EncryptXTea4(counter, round_a, round_b, v0, v1);
+                counter += XTEA_LANES;
+
+                for (uint32_t l = 0; l < XTEA_LANES; ++l) {
+                    uint64_t enc_counter = dmEndian::ToHost((((uint64_t) v0[l]) << 32 | v1[l]));
+                    uint64_t d;
+                    memcpy(&d, data, block_len);
+                    d ^= enc_counter;
+                    memcpy(data, &d, block_len);
+                    data += block_len;
+                }
+            }
+        }
+
+        for (; i < num_blocks; i++) {
             uint64_t enc_counter = EncryptXTea(counter, (uint32_t*) paddedkey);
-            d[i] ^= enc_counter;
+            uint64_t d;
+            memcpy(&d, data, block_len);
+            d ^= enc_counter;
+            memcpy(data, &d, block_len);
             data += block_len;
             counter++;
         }
@@ -82,14 +186,20 @@ namespace dmCrypt
 
     Result Encrypt(Algorithm algo, uint8_t* data, uint32_t datalen, const uint8_t* key, uint32_t keylen)
     {
-        EncryptXTeaCTR(data, datalen, key, keylen);
+        if (keylen > 16)
+            return RESULT_ERROR;
+
+        if (algo == ALGORITHM_AES_CTR)
+            EncryptAesCTR(data, datalen, key, keylen);
+        else
+            EncryptXTeaCTR(data, datalen, key, keylen);
         return RESULT_OK;
     }
 
     Result Decrypt(Algorithm algo, uint8_t* data, uint32_t datalen, const uint8_t* key, uint32_t keylen)
     {
-        EncryptXTeaCTR(data, datalen, key, keylen);
-        return RESULT_OK;
+        // Both algorithms are used in CTR mode, where decryption is the same as encryption
+        return Encrypt(algo, data, datalen, key, keylen);
     }
 
     // Same as rsa_alt_decrypt_wrap() except with a MBEDTLS_RSA_PUBLIC
@@ -171,6 +281,9 @@ namespace dmCrypt
 
     void HashSha1(const uint8_t* buf, uint32_t buflen, uint8_t* digest)
     {
+        if (HashSha1Hardware(buf, buflen, digest))
+            return;
+
         mbedtls_sha1_context ctx;
         mbedtls_sha1_init(&ctx);
         mbedtls_sha1_starts_ret(&ctx);
@@ -184,6 +297,9 @@ namespace dmCrypt
 
     void HashSha256(const uint8_t* buf, uint32_t buflen, uint8_t* digest)
     {
+        if (HashSha256Hardware(buf, buflen, digest))
+            return;
+
         int ret = mbedtls_sha256_ret((const unsigned char*)buf, (size_t)buflen, (unsigned char*)digest, 0);
         if (ret != 0) {
             memset(digest, 0, 20);
@@ -206,6 +322,178 @@ namespace dmCrypt
         }
     }
 
+    void Hash(HashAlgorithm algorithm, const uint8_t* buf, uint32_t buflen, uint8_t* digest)
+    {
+        switch(algorithm)
+        {
+        case HASH_ALGORITHM_MD5:    HashMd5(buf, buflen, digest); break;
+        case HASH_ALGORITHM_SHA1:   HashSha1(buf, buflen, digest); break;
+        case HASH_ALGORITHM_SHA256: HashSha256(buf, buflen, digest); break;
+        case HASH_ALGORITHM_SHA512: HashSha512(buf, buflen, digest); break;
+        }
+    }
+
+    struct HashBuffersContext
+    {
+        HashAlgorithm   m_Algorithm;
+        HashBuffer*     m_Buffers;
+        uint32_t        m_NumBuffers;
+        int32_atomic_t  m_Next;
+    };
+
+    static void HashBuffersWorker(HashBuffersContext* ctx)
+    {
+        while (true)
+        {
+            uint32_t i = (uint32_t)dmAtomicIncrement32(&ctx->m_Next);
+            if (i >= ctx->m_NumBuffers)
+                break;
+            HashBuffer* b = &ctx->m_Buffers[i];
+            Hash(ctx->m_Algorithm, b->m_Buffer, b->m_BufferLength, b->m_Digest);
+        }
+    }
+
+    static const uint32_t HASH_MAX_THREADS = 16;
+    static const uint32_t HASH_THREAD_STACK_SIZE = 0x20000;
+
+    // The worker threads are started when they are first needed, and then wait for more work until the process exits.
+    // Only one batch at a time is spread over the workers, the calling thread works on it as well.
+    struct HashWorkerPool
+    {
+        dmMutex::HMutex                         m_JobMutex;     // Held by the caller whose batch is being hashed
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_WorkCondition;
+        dmConditionVariable::HConditionVariable m_DoneCondition;
+        dmThread::Thread                        m_Threads[HASH_MAX_THREADS];
+        uint32_t                                m_NumThreads;
+        HashBuffersContext*                     m_Context;      // The current batch, if any
+        uint32_t                                m_NumSeats;     // The number of workers that may still join the current batch
+        uint32_t                                m_NumWorking;   // The number of workers that are hashing the current batch
+    };
+
+    enum HashWorkerPoolState
+    {
+        HASH_POOL_STATE_NONE    = 0,
+        HASH_POOL_STATE_BUSY    = 1,
+        HASH_POOL_STATE_CREATED = 2,
+    };
+
+    static HashWorkerPool   g_HashWorkerPool;
+    static int32_atomic_t   g_HashWorkerPoolState = HASH_POOL_STATE_NONE;
+
+    static void HashWorkerThread(void* arg)
+    {
+        HashWorkerPool* pool = (HashWorkerPool*)arg;
+
+        dmMutex::Lock(pool->m_Mutex);
+        while (true)
+        {
+            while (pool->m_Context == 0 || pool->m_NumSeats == 0)
+            {
+                dmConditionVariable::Wait(pool->m_WorkCondition, pool->m_Mutex);
+            }
+
+            HashBuffersContext* ctx = pool->m_Context;
+            pool->m_NumSeats--;
+            pool->m_NumWorking++;
+            dmMutex::Unlock(pool->m_Mutex);
+
+            HashBuffersWorker(ctx);
+
+            dmMutex::Lock(pool->m_Mutex);
+            if (--pool->m_NumWorking == 0)
+            {
+                dmConditionVariable::Signal(pool->m_DoneCondition);
+            }
+        }
+    }
+
+    static HashWorkerPool* GetHashWorkerPool()
+    {
+        while (true)
+        {
+            int32_t state = dmAtomicCompareStore32(&g_HashWorkerPoolState, HASH_POOL_STATE_BUSY, HASH_POOL_STATE_NONE);
+            if (state == HASH_POOL_STATE_CREATED)
+            {
+                return &g_HashWorkerPool;
+            }
+            else if (state == HASH_POOL_STATE_NONE)
+            {
+                break;
+            }
+            dmTime::Sleep(1000);
+        }
+
+        HashWorkerPool* pool = &g_HashWorkerPool;
+        pool->m_JobMutex = dmMutex::New();
+        pool->m_Mutex = dmMutex::New();
+        pool->m_WorkCondition = dmConditionVariable::New();
+        pool->m_DoneCondition = dmConditionVariable::New();
+        pool->m_NumThreads = 0;
+        pool->m_Context = 0;
+        pool->m_NumSeats = 0;
+        pool->m_NumWorking = 0;
+        dmAtomicStore32(&g_HashWorkerPoolState, HASH_POOL_STATE_CREATED);
+        return pool;
+    }
+
+    void HashBuffers(HashAlgorithm algorithm, HashBuffer* buffers, uint32_t num_buffers, uint32_t max_threads)
+    {
+        // Spreading the work isn't worth it for small batches
+        const uint32_t MIN_BYTES_PER_THREAD = 256 * 1024;
+
+        uint64_t total_size = 0;
+        for (uint32_t i = 0; i < num_buffers; ++i)
+            total_size += buffers[i].m_BufferLength;
+
+        uint32_t num_threads = (uint32_t)dmMath::Min<uint64_t>(total_size / MIN_BYTES_PER_THREAD, num_buffers);
+        num_threads = dmMath::Min(num_threads, dmMath::Min(max_threads, HASH_MAX_THREADS));
+        if (!dLib::FeaturesSupported(DM_FEATURE_BIT_THREADS))
+            num_threads = 1;
+
+        HashBuffersContext ctx;
+        ctx.m_Algorithm = algorithm;
+        ctx.m_Buffers = buffers;
+        ctx.m_NumBuffers = num_buffers;
+        ctx.m_Next = 0;
+
+        HashWorkerPool* pool = num_threads > 1 ? GetHashWorkerPool() : 0;
+
+        // If another batch is being hashed, the workers are already busy
+        if (pool == 0 || !dmMutex::TryLock(pool->m_JobMutex))
+        {
+            HashBuffersWorker(&ctx);
+            return;
+        }
+
+        // The calling thread is one of the workers
+        uint32_t num_workers = num_threads - 1;
+        dmMutex::Lock(pool->m_Mutex);
+        for (uint32_t i = pool->m_NumThreads; i < num_workers; ++i)
+        {
+            pool->m_Threads[i] = dmThread::New(HashWorkerThread, HASH_THREAD_STACK_SIZE, pool, "hash");
+        }
+        pool->m_NumThreads = dmMath::Max(pool->m_NumThreads, num_workers);
+        pool->m_Context = &ctx;
+        pool->m_NumSeats = num_workers;
+        dmConditionVariable::Broadcast(pool->m_WorkCondition);
+        dmMutex::Unlock(pool->m_Mutex);
+
+        HashBuffersWorker(&ctx);
+
+        // Workers that haven't joined yet won't find anything to do, so they aren't waited for
+        dmMutex::Lock(pool->m_Mutex);
+        pool->m_Context = 0;
+        pool->m_NumSeats = 0;
+        while (pool->m_NumWorking > 0)
+        {
+            dmConditionVariable::Wait(pool->m_DoneCondition, pool->m_Mutex);
+        }
+        dmMutex::Unlock(pool->m_Mutex);
+
+        dmMutex::Unlock(pool->m_JobMutex);
+    }
+
     bool Base64Encode(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t* dst_len)
     {
         size_t out_len = 0;
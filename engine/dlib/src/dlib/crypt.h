@@ -31,6 +31,66 @@ namespace dmCrypt
      * @return RESULT_OK if decrypting went ok.
      */
     Result Decrypt(const uint8_t* key, uint32_t keylen, const uint8_t* data, uint32_t datalen, uint8_t** output, uint32_t* outputlen);
+
+    enum HashAlgorithm
+    {
+        HASH_ALGORITHM_MD5,
+        HASH_ALGORITHM_SHA1,
+        HASH_ALGORITHM_SHA256,
+        HASH_ALGORITHM_SHA512,
+    };
+
+    struct HashBuffer
+    {
+        const uint8_t*  m_Buffer;
+        uint32_t        m_BufferLength;
+        uint8_t*        m_Digest;       // Must hold the digest size of the algorithm
+    };
+
+    /**
+     * Hash a single buffer
+     * @param algorithm The hash algorithm
+     * @param buf The source data
+     * @param buflen The length of the source data
+     * @param digest [out] The digest (16, 20, 32 or 64 bytes)
+     */
+    void Hash(HashAlgorithm algorithm, const uint8_t* buf, uint32_t buflen, uint8_t* digest);
+
+    /**
+     * Hash many buffers, spread over up to max_threads worker threads.
+     * Small batches, or platforms without thread support, are hashed on the calling thread.
+     * @param algorithm The hash algorithm
+     * @param buffers The buffers to hash. Each digest is written to the m_Digest field
+     * @param num_buffers The number of buffers
+     * @param max_threads The maximum number of threads to use
+     */
+    void HashBuffers(HashAlgorithm algorithm, HashBuffer* buffers, uint32_t num_buffers, uint32_t max_threads);
+
+    /**
+     * Check if the cpu has hash instructions for SHA1 and SHA256 (SHA-NI or the ARMv8 crypto extensions)
+     * @return true if the hashes are hardware accelerated
+     */
+    bool HasHardwareSha();
+
+    /**
+     * Enable/disable the hardware SHA1/SHA256 paths (e.g. for testing the portable implementation)
+     * @param enabled Whether to use the cpu hash instructions if they're available
+     * @return the previous setting
+     */
+    bool SetHardwareShaEnabled(bool enabled);
+
+    /**
+     * Check if the cpu has AES instructions (AES-NI or the ARMv8 crypto extensions)
+     * @return true if the AES encryption is hardware accelerated
+     */
+    bool HasHardwareAes();
+
+    /**
+     * Enable/disable the hardware AES path (e.g. for testing the portable implementation)
+     * @param enabled Whether to use the cpu AES instructions if they're available
+     * @return the previous setting
+     */
+    bool SetHardwareAesEnabled(bool enabled);
 }
 
 #endif /* DM_CRYPT_H */
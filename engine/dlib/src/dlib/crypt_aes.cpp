@@ -0,0 +1,574 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// AES-128 in CTR mode, used for encrypting archive entries.
+// Uses AES-NI on x86 and the ARMv8 AES instructions on arm64 when available (checked at runtime),
+// and otherwise a portable bitsliced implementation (no lookup tables), processing four blocks at a time.
+//
+// The counter block is a 128 bit big endian integer, starting at zero (i.e. "AES/CTR/NoPadding" with a zero IV)
+
+#include <string.h>
+#include <assert.h>
+#include "crypt.h"
+#include "crypt_private.h"
+
+#if defined(__EMSCRIPTEN__)
+    // no hardware support
+#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define DM_CRYPT_AES_X86
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+    // The intrinsics need the crypto extensions enabled at compile time (e.g. -march=armv8-a+crypto, the default on Apple arm64)
+    #define DM_CRYPT_AES_ARM
+#endif
+
+#if defined(DM_CRYPT_AES_X86)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #include <wmmintrin.h>
+        #define DM_AES_TARGET
+    #else
+        #include <cpuid.h>
+        #include <wmmintrin.h>
+        #define DM_AES_TARGET __attribute__((target("aes,sse2")))
+    #endif
+#elif defined(DM_CRYPT_AES_ARM)
+    #include <arm_neon.h>
+    #if defined(__linux__) || defined(__ANDROID__)
+        #include <sys/auxv.h>
+        #include <asm/hwcap.h>
+    #endif
+#endif
+
+namespace dmCrypt
+{
+    static const uint32_t AES_BLOCK_SIZE = 16;
+    static const uint32_t AES_NUM_ROUNDS = 10;   // AES-128
+    static const uint32_t AES_ROUND_KEYS_SIZE = AES_BLOCK_SIZE * (AES_NUM_ROUNDS + 1);
+
+    // ****************************************************************************************************
+    // Portable bitsliced implementation
+    //
+    // Four blocks are processed at once, as eight 64 bit "bit planes", where plane b holds bit b of all 64 bytes,
+    // i.e. byte n of the four consecutive blocks is stored at bit n of each plane.
+    // Since the AES state is column major (byte = col*4 + row), each block occupies 16 bits of a plane,
+    // each column 4 bits and each row a single bit within the column.
+
+    // The S-box circuit by Boyar and Peralta (x0 is the most significant bit)
+    static void SubBytesBitsliced(uint64_t* q)
+    {
+        uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+        uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+        uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+        uint64_t y20, y21;
+        uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+        uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+        uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+        uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+        uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+        uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+        uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+        uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+        uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+        uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+        x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+        x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+        // Top linear transformation
+        y14 = x3 ^ x5;
+        y13 = x0 ^ x6;
+        y9 = x0 ^ x3;
+        y8 = x0 ^ x5;
+        t0 = x1 ^ x2;
+        y1 = t0 ^ x7;
+        y4 = y1 ^ x3;
+        y12 = y13 ^ y14;
+        y2 = y1 ^ x0;
+        y5 = y1 ^ x6;
+        y3 = y5 ^ y8;
+        t1 = x4 ^ y12;
+        y15 = t1 ^ x5;
+        y20 = t1 ^ x1;
+        y6 = y15 ^ x7;
+        y10 = y15 ^ t0;
+        y11 = y20 ^ y9;
+        y7 = x7 ^ y11;
+        y17 = y10 ^ y11;
+        y19 = y10 ^ y8;
+        y16 = t0 ^ y11;
+        y21 = y13 ^ y16;
+        y18 = x0 ^ y16;
+
+        // Non-linear section
+        t2 = y12 & y15;
+        t3 = y3 & y6;
+        t4 = t3 ^ t2;
+        t5 = y4 & x7;
+        t6 = t5 ^ t2;
+        t7 = y13 & y16;
+        t8 = y5 & y1;
+        t9 = t8 ^ t7;
+        t10 = y2 & y7;
+        t11 = t10 ^ t7;
+        t12 = y9 & y11;
+        t13 = y14 & y17;
+        t14 = t13 ^ t12;
+        t15 = y8 & y10;
+        t16 = t15 ^ t12;
+        t17 = t4 ^ t14;
+        t18 = t6 ^ t16;
+        t19 = t9 ^ t14;
+        t20 = t11 ^ t16;
+        t21 = t17 ^ y20;
+        t22 = t18 ^ y19;
+        t23 = t19 ^ y21;
+        t24 = t20 ^ y18;
+
+        t25 = t21 ^ t22;
+        t26 = t21 & t23;
+        t27 = t24 ^ t26;
+        t28 = t25 & t27;
+        t29 = t28 ^ t22;
+        t30 = t23 ^ t24;
+        t31 = t22 ^ t26;
+        t32 = t31 & t30;
+        t33 = t32 ^ t24;
+        t34 = t23 ^ t33;
+        t35 = t27 ^ t33;
+        t36 = t24 & t35;
+        t37 = t36 ^ t34;
+        t38 = t27 ^ t36;
+        t39 = t29 & t38;
+        t40 = t25 ^ t39;
+
+        t41 = t40 ^ t37;
+        t42 = t29 ^ t33;
+        t43 = t29 ^ t40;
+        t44 = t33 ^ t37;
+        t45 = t42 ^ t41;
+        z0 = t44 & y15;
+        z1 = t37 & y6;
+        z2 = t33 & x7;
+        z3 = t43 & y16;
+        z4 = t40 & y1;
+        z5 = t29 & y7;
+        z6 = t42 & y11;
+        z7 = t45 & y17;
+        z8 = t41 & y10;
+        z9 = t44 & y12;
+        z10 = t37 & y3;
+        z11 = t33 & y4;
+        z12 = t43 & y13;
+        z13 = t40 & y5;
+        z14 = t29 & y2;
+        z15 = t42 & y9;
+        z16 = t45 & y14;
+        z17 = t41 & y8;
+
+        // Bottom linear transformation
+        t46 = z15 ^ z16;
+        t47 = z10 ^ z11;
+        t48 = z5 ^ z13;
+        t49 = z9 ^ z10;
+        t50 = z2 ^ z12;
+        t51 = z2 ^ z5;
+        t52 = z7 ^ z8;
+        t53 = z0 ^ z3;
+        t54 = z6 ^ z7;
+        t55 = z16 ^ z17;
+        t56 = z12 ^ t48;
+        t57 = t50 ^ t53;
+        t58 = z4 ^ t46;
+        t59 = z3 ^ t54;
+        t60 = t46 ^ t57;
+        t61 = z14 ^ t57;
+        t62 = t52 ^ t58;
+        t63 = t49 ^ t58;
+        t64 = z4 ^ t59;
+        t65 = t61 ^ t62;
+        t66 = z1 ^ t63;
+        s0 = t59 ^ t63;
+        s6 = t56 ^ ~t62;
+        s7 = t48 ^ ~t60;
+        t67 = t64 ^ t65;
+        s3 = t53 ^ t66;
+        s4 = t51 ^ t66;
+        s5 = t47 ^ t65;
+        s1 = t64 ^ ~s3;
+        s2 = t55 ^ ~t67;
+
+        q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+        q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+    }
+
+    // Rotate the columns within each block, so that column c gets the value of column c+n
+    static inline uint64_t RotateColumns1(uint64_t x) { return ((x >> 4) & 0x0FFF0FFF0FFF0FFFULL) | ((x << 12) & 0xF000F000F000F000ULL); }
+    static inline uint64_t RotateColumns2(uint64_t x) { return ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x << 8) & 0xFF00FF00FF00FF00ULL); }
+    static inline uint64_t RotateColumns3(uint64_t x) { return ((x >> 12) & 0x000F000F000F000FULL) | ((x << 4) & 0xFFF0FFF0FFF0FFF0ULL); }
+
+    static void ShiftRowsBitsliced(uint64_t* q)
+    {
+        // Row r of column c comes from column c+r
+        for (int b = 0; b < 8; ++b)
+        {
+            uint64_t x = q[b];
+            q[b] = (x & 0x1111111111111111ULL)
+                 | (RotateColumns1(x) & 0x2222222222222222ULL)
+                 | (RotateColumns2(x) & 0x4444444444444444ULL)
+                 | (RotateColumns3(x) & 0x8888888888888888ULL);
+        }
+    }
+
+    // Rotate the rows within each column, so that row r gets the value of row r+n
+    static inline uint64_t RotateRows1(uint64_t x) { return ((x >> 1) & 0x7777777777777777ULL) | ((x << 3) & 0x8888888888888888ULL); }
+    static inline uint64_t RotateRows2(uint64_t x) { return ((x >> 2) & 0x3333333333333333ULL) | ((x << 2) & 0xCCCCCCCCCCCCCCCCULL); }
+    static inline uint64_t RotateRows3(uint64_t x) { return ((x >> 3) & 0x1111111111111111ULL) | ((x << 1) & 0xEEEEEEEEEEEEEEEEULL); }
+
+    static void MixColumnsBitsliced(uint64_t* q)
+    {
+        // out[r] = 2*a[r] ^ 3*a[r+1] ^ a[r+2] ^ a[r+3] = 2*(a[r] ^ a[r+1]) ^ a[r+1] ^ a[r+2] ^ a[r+3]
+        uint64_t t[8];
+        uint64_t rest[8];
+        for (int b = 0; b < 8; ++b)
+        {
+            uint64_t a1 = RotateRows1(q[b]);
+            t[b] = q[b] ^ a1;
+            rest[b] = a1 ^ RotateRows2(q[b]) ^ RotateRows3(q[b]);
+        }
+
+        // Multiplication by 2 in GF(2^8), reducing with x^8 + x^4 + x^3 + x + 1
+        q[0] = t[7] ^ rest[0];
+        q[1] = t[0] ^ t[7] ^ rest[1];
+        q[2] = t[1] ^ rest[2];
+        q[3] = t[2] ^ t[7] ^ rest[3];
+        q[4] = t[3] ^ t[7] ^ rest[4];
+        q[5] = t[4] ^ rest[5];
+        q[6] = t[5] ^ rest[6];
+        q[7] = t[6] ^ rest[7];
+    }
+
+    // Transposes an 8x8 bit matrix, where each byte is a row
+    static inline uint64_t Transpose8x8(uint64_t x)
+    {
+        uint64_t t;
+        t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+        x = x ^ t ^ (t << 7);
+        t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+        x = x ^ t ^ (t << 14);
+        t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+        x = x ^ t ^ (t << 28);
+        return x;
+    }
+
+    static void BitsliceLoad(const uint8_t* in, uint64_t* q)
+    {
+        memset(q, 0, sizeof(uint64_t) * 8);
+        for (uint32_t g = 0; g < 8; ++g)
+        {
+            uint64_t x;
+            memcpy(&x, in + g * 8, sizeof(x)); // little endian
+            x = Transpose8x8(x);
+            for (int b = 0; b < 8; ++b)
+                q[b] |= ((x >> (b * 8)) & 0xFF) << (g * 8);
+        }
+    }
+
+    static void BitsliceStore(const uint64_t* q, uint8_t* out)
+    {
+        for (uint32_t g = 0; g < 8; ++g)
+        {
+            uint64_t x = 0;
+            for (int b = 0; b < 8; ++b)
+                x |= ((q[b] >> (g * 8)) & 0xFF) << (b * 8);
+            x = Transpose8x8(x);
+            memcpy(out + g * 8, &x, sizeof(x));
+        }
+    }
+
+    static uint8_t SubByte(uint8_t x)
+    {
+        uint64_t q[8];
+        for (int b = 0; b < 8; ++b)
+            q[b] = (x >> b) & 1;
+        SubBytesBitsliced(q);
+        uint8_t r = 0;
+        for (int b = 0; b < 8; ++b)
+            r |= (uint8_t)((q[b] & 1) << b);
+        return r;
+    }
+
+    static void ExpandKey128(const uint8_t* key, uint8_t* round_keys)
+    {
+        memcpy(round_keys, key, AES_BLOCK_SIZE);
+        uint8_t rcon = 1;
+        for (uint32_t i = 4; i < 4 * (AES_NUM_ROUNDS + 1); ++i)
+        {
+            uint8_t t[4];
+            memcpy(t, &round_keys[(i - 1) * 4], 4);
+            if ((i & 3) == 0)
+            {
+                uint8_t t0 = t[0];
+                t[0] = SubByte(t[1]) ^ rcon;
+                t[1] = SubByte(t[2]);
+                t[2] = SubByte(t[3]);
+                t[3] = SubByte(t0);
+                rcon = (uint8_t)((rcon << 1) ^ (0x1B & -(rcon >> 7)));
+            }
+            for (uint32_t j = 0; j < 4; ++j)
+                round_keys[i * 4 + j] = round_keys[(i - 4) * 4 + j] ^ t[j];
+        }
+    }
+
+    static void EncryptBlocks4Bitsliced(const uint64_t* round_key_planes, const uint8_t* in, uint8_t* out)
+    {
+        uint64_t q[8];
+        BitsliceLoad(in, q);
+
+        for (int b = 0; b < 8; ++b)
+            q[b] ^= round_key_planes[b];
+
+        for (uint32_t r = 1; r <= AES_NUM_ROUNDS; ++r)
+        {
+            SubBytesBitsliced(q);
+            ShiftRowsBitsliced(q);
+            if (r != AES_NUM_ROUNDS)
+                MixColumnsBitsliced(q);
+            for (int b = 0; b < 8; ++b)
+                q[b] ^= round_key_planes[r * 8 + b];
+        }
+
+        BitsliceStore(q, out);
+    }
+
+    static inline void WriteCounterBlock(uint8_t* block, uint64_t counter)
+    {
+        memset(block, 0, 8);
+        for (int i = 0; i < 8; ++i)
+            block[8 + i] = (uint8_t)(counter >> (56 - i * 8));
+    }
+
+    static void EncryptAesCTRPortable(const uint8_t* round_keys, uint8_t* data, uint32_t datalen)
+    {
+        // The round keys are the same for all blocks, so we broadcast each key bit to all four blocks
+        uint64_t planes[(AES_NUM_ROUNDS + 1) * 8];
+        for (uint32_t r = 0; r <= AES_NUM_ROUNDS; ++r)
+        {
+            for (int b = 0; b < 8; ++b)
+            {
+                uint64_t plane = 0;
+                for (uint32_t pos = 0; pos < AES_BLOCK_SIZE; ++pos)
+                    plane |= (uint64_t)((round_keys[r * AES_BLOCK_SIZE + pos] >> b) & 1) << pos;
+                planes[r * 8 + b] = plane * 0x0001000100010001ULL;
+            }
+        }
+
+        uint8_t counters[AES_BLOCK_SIZE * 4];
+        uint8_t keystream[AES_BLOCK_SIZE * 4];
+        uint64_t counter = 0;
+        for (uint32_t offset = 0; offset < datalen; offset += sizeof(keystream))
+        {
+            for (uint32_t i = 0; i < 4; ++i)
+                WriteCounterBlock(&counters[i * AES_BLOCK_SIZE], counter++);
+            EncryptBlocks4Bitsliced(planes, counters, keystream);
+
+            uint32_t n = datalen - offset < sizeof(keystream) ? datalen - offset : sizeof(keystream);
+            for (uint32_t i = 0; i < n; ++i)
+                data[offset + i] ^= keystream[i];
+        }
+    }
+
+    // ****************************************************************************************************
+    // Hardware implementations
+
+#if defined(DM_CRYPT_AES_X86)
+
+    static bool HasAesInstructions()
+    {
+        // aes: leaf 1, ecx bit 25
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        return (regs[2] & (1 << 25)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            return false;
+        return (ecx & (1 << 25)) != 0;
+#endif
+    }
+
+    DM_AES_TARGET static inline __m128i CounterBlock(uint64_t counter)
+    {
+        // The low 8 bytes of the block are the big endian counter
+        uint8_t block[AES_BLOCK_SIZE];
+        WriteCounterBlock(block, counter);
+        return _mm_loadu_si128((const __m128i*)block);
+    }
+
+    DM_AES_TARGET static void EncryptAesCTRHardware(const uint8_t* round_keys, uint8_t* data, uint32_t datalen)
+    {
+        __m128i rk[AES_NUM_ROUNDS + 1];
+        for (uint32_t i = 0; i <= AES_NUM_ROUNDS; ++i)
+            rk[i] = _mm_loadu_si128((const __m128i*)&round_keys[i * AES_BLOCK_SIZE]);
+
+        uint64_t counter = 0;
+        uint32_t offset = 0;
+
+        // Four blocks in flight, to hide the latency of the aes instructions
+        for (; offset + AES_BLOCK_SIZE * 4 <= datalen; offset += AES_BLOCK_SIZE * 4)
+        {
+            __m128i b0 = _mm_xor_si128(CounterBlock(counter + 0), rk[0]);
+            __m128i b1 = _mm_xor_si128(CounterBlock(counter + 1), rk[0]);
+            __m128i b2 = _mm_xor_si128(CounterBlock(counter + 2), rk[0]);
+            __m128i b3 = _mm_xor_si128(CounterBlock(counter + 3), rk[0]);
+            counter += 4;
+            for (uint32_t r = 1; r < AES_NUM_ROUNDS; ++r)
+            {
+                b0 = _mm_aesenc_si128(b0, rk[r]);
+                b1 = _mm_aesenc_si128(b1, rk[r]);
+                b2 = _mm_aesenc_si128(b2, rk[r]);
+                b3 = _mm_aesenc_si128(b3, rk[r]);
+            }
+            b0 = _mm_aesenclast_si128(b0, rk[AES_NUM_ROUNDS]);
+            b1 = _mm_aesenclast_si128(b1, rk[AES_NUM_ROUNDS]);
+            b2 = _mm_aesenclast_si128(b2, rk[AES_NUM_ROUNDS]);
+            b3 = _mm_aesenclast_si128(b3, rk[AES_NUM_ROUNDS]);
+
+            __m128i* d = (__m128i*)(data + offset);
+            _mm_storeu_si128(d + 0, _mm_xor_si128(_mm_loadu_si128(d + 0), b0));
+            _mm_storeu_si128(d + 1, _mm_xor_si128(_mm_loadu_si128(d + 1), b1));
+            _mm_storeu_si128(d + 2, _mm_xor_si128(_mm_loadu_si128(d + 2), b2));
+            _mm_storeu_si128(d + 3, _mm_xor_si128(_mm_loadu_si128(d + 3), b3));
+        }
+
+        for (; offset < datalen; offset += AES_BLOCK_SIZE)
+        {
+            __m128i b = _mm_xor_si128(CounterBlock(counter++), rk[0]);
+            for (uint32_t r = 1; r < AES_NUM_ROUNDS; ++r)
+                b = _mm_aesenc_si128(b, rk[r]);
+            b = _mm_aesenclast_si128(b, rk[AES_NUM_ROUNDS]);
+
+            uint8_t keystream[AES_BLOCK_SIZE];
+            _mm_storeu_si128((__m128i*)keystream, b);
+            uint32_t n = datalen - offset < AES_BLOCK_SIZE ? datalen - offset : AES_BLOCK_SIZE;
+            for (uint32_t i = 0; i < n; ++i)
+                data[offset + i] ^= keystream[i];
+        }
+    }
+
+#elif defined(DM_CRYPT_AES_ARM)
+
+    static bool HasAesInstructions()
+    {
+#if defined(__ANDROID__) || defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+        return true; // The build already requires the crypto extensions
+#endif
+    }
+
+    static inline uint8x16_t EncryptBlock(const uint8x16_t* rk, uint8x16_t b)
+    {
+        // vaeseq does AddRoundKey + SubBytes + ShiftRows
+        for (uint32_t r = 0; r < AES_NUM_ROUNDS - 1; ++r)
+            b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+        b = vaeseq_u8(b, rk[AES_NUM_ROUNDS - 1]);
+        return veorq_u8(b, rk[AES_NUM_ROUNDS]);
+    }
+
+    static void EncryptAesCTRHardware(const uint8_t* round_keys, uint8_t* data, uint32_t datalen)
+    {
+        uint8x16_t rk[AES_NUM_ROUNDS + 1];
+        for (uint32_t i = 0; i <= AES_NUM_ROUNDS; ++i)
+            rk[i] = vld1q_u8(&round_keys[i * AES_BLOCK_SIZE]);
+
+        uint64_t counter = 0;
+        uint32_t offset = 0;
+        uint8_t block[AES_BLOCK_SIZE];
+
+        for (; offset + AES_BLOCK_SIZE * 4 <= datalen; offset += AES_BLOCK_SIZE * 4)
+        {
+            uint8x16_t b[4];
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                WriteCounterBlock(block, counter++);
+                b[i] = vld1q_u8(block);
+            }
+            for (uint32_t r = 0; r < AES_NUM_ROUNDS - 1; ++r)
+            {
+                for (uint32_t i = 0; i < 4; ++i)
+                    b[i] = vaesmcq_u8(vaeseq_u8(b[i], rk[r]));
+            }
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                b[i] = veorq_u8(vaeseq_u8(b[i], rk[AES_NUM_ROUNDS - 1]), rk[AES_NUM_ROUNDS]);
+                uint8_t* d = data + offset + i * AES_BLOCK_SIZE;
+                vst1q_u8(d, veorq_u8(vld1q_u8(d), b[i]));
+            }
+        }
+
+        for (; offset < datalen; offset += AES_BLOCK_SIZE)
+        {
+            WriteCounterBlock(block, counter++);
+            uint8_t keystream[AES_BLOCK_SIZE];
+            vst1q_u8(keystream, EncryptBlock(rk, vld1q_u8(block)));
+            uint32_t n = datalen - offset < AES_BLOCK_SIZE ? datalen - offset : AES_BLOCK_SIZE;
+            for (uint32_t i = 0; i < n; ++i)
+                data[offset + i] ^= keystream[i];
+        }
+    }
+
+#endif
+
+    // 0: unknown, 1: supported, 2: unsupported
+    static int g_AesSupport = 0;
+    static bool g_AesEnabled = true;
+
+    bool HasHardwareAes()
+    {
+#if defined(DM_CRYPT_AES_X86) || defined(DM_CRYPT_AES_ARM)
+        if (g_AesSupport == 0)
+            g_AesSupport = HasAesInstructions() ? 1 : 2; // benign race, all threads compute the same answer
+        return g_AesSupport == 1;
+#else
+        return false;
+#endif
+    }
+
+    bool SetHardwareAesEnabled(bool enabled)
+    {
+        bool prev = g_AesEnabled;
+        g_AesEnabled = enabled;
+        return prev;
+    }
+
+    void EncryptAesCTR(uint8_t* data, uint32_t datalen, const uint8_t* key, uint32_t keylen)
+    {
+        assert(keylen <= 16);
+        uint8_t paddedkey[AES_BLOCK_SIZE] = {0};
+        memcpy(paddedkey, key, keylen);
+
+        uint8_t round_keys[AES_ROUND_KEYS_SIZE];
+        ExpandKey128(paddedkey, round_keys);
+
+#if defined(DM_CRYPT_AES_X86) || defined(DM_CRYPT_AES_ARM)
+        if (g_AesEnabled && HasHardwareAes())
+        {
+            EncryptAesCTRHardware(round_keys, data, datalen);
+            return;
+        }
+#endif
+        EncryptAesCTRPortable(round_keys, data, datalen);
+    }
+}
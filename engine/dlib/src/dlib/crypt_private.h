@@ -0,0 +1,31 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_CRYPT_PRIVATE_H
+#define DM_CRYPT_PRIVATE_H
+
+#include <stdint.h>
+
+namespace dmCrypt
+{
+    // Hashes using the cpu sha instructions. Returns false if they're unavailable (or disabled),
+    // in which case the caller should use the portable implementation
+    bool HashSha1Hardware(const uint8_t* buf, uint32_t buflen, uint8_t* digest);
+    bool HashSha256Hardware(const uint8_t* buf, uint32_t buflen, uint8_t* digest);
+
+    // AES-128 in CTR mode (encryption and decryption are the same operation). Keys shorter than 16 bytes are zero padded
+    void EncryptAesCTR(uint8_t* data, uint32_t datalen, const uint8_t* key, uint32_t keylen);
+}
+
+#endif // DM_CRYPT_PRIVATE_H
@@ -0,0 +1,349 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// SHA1/SHA256 using the cpu hash instructions (SHA-NI on x86, the ARMv8 crypto extensions on arm64)
+// Selected at runtime, with mbedtls as the fallback (see crypt.cpp)
+
+#include <string.h>
+#include "crypt.h"
+#include "crypt_private.h"
+
+#if defined(__EMSCRIPTEN__)
+    // no hardware support
+#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define DM_CRYPT_SHA_X86
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+    // The intrinsics need the crypto extensions enabled at compile time (e.g. -march=armv8-a+crypto, the default on Apple arm64)
+    #define DM_CRYPT_SHA_ARM
+#endif
+
+#if defined(DM_CRYPT_SHA_X86)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #include <immintrin.h>
+        #define DM_SHA_TARGET
+    #else
+        #include <cpuid.h>
+        #include <immintrin.h>
+        #define DM_SHA_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+    #endif
+#elif defined(DM_CRYPT_SHA_ARM)
+    #include <arm_neon.h>
+    #if defined(__linux__) || defined(__ANDROID__)
+        #include <sys/auxv.h>
+        #include <asm/hwcap.h>
+    #endif
+#endif
+
+namespace dmCrypt
+{
+    typedef void (*ProcessBlocksFn)(uint32_t* state, const uint8_t* data, uint32_t num_blocks);
+
+    static const uint32_t SHA_BLOCK_SIZE = 64;
+
+    static const uint32_t SHA256_K[64] =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+#if defined(DM_CRYPT_SHA_X86)
+
+    static bool HasShaInstructions()
+    {
+        // sha: leaf 7, ebx bit 29. ssse3/sse4.1: leaf 1, ecx bits 9 and 19
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7)
+            return false;
+        __cpuid(regs, 1);
+        bool sse = (regs[2] & (1 << 9)) && (regs[2] & (1 << 19));
+        __cpuidex(regs, 7, 0);
+        return sse && (regs[1] & (1 << 29));
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0, 0) < 7)
+            return false;
+        __cpuid(1, eax, ebx, ecx, edx);
+        bool sse = (ecx & (1 << 9)) && (ecx & (1 << 19));
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        return sse && (ebx & (1 << 29));
+#endif
+    }
+
+    // Rounds [FUNC*20, FUNC*20+20), which all use the same round function
+    template<int FUNC>
+    DM_SHA_TARGET static inline void Sha1Rounds20(__m128i& abcd, __m128i& e, __m128i& prev_abcd, __m128i* msg)
+    {
+        for (int g = FUNC*5; g < FUNC*5 + 5; ++g)
+        {
+            if (g >= 4)
+                msg[g&3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(msg[g&3], msg[(g+1)&3]), msg[(g+2)&3]), msg[(g+3)&3]);
+
+            e = g == 0 ? _mm_add_epi32(e, msg[0]) : _mm_sha1nexte_epu32(prev_abcd, msg[g&3]);
+            prev_abcd = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e, FUNC);
+        }
+    }
+
+    DM_SHA_TARGET static void Sha1ProcessBlocks(uint32_t* state, const uint8_t* data, uint32_t num_blocks)
+    {
+        const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+        __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+        for (uint32_t b = 0; b < num_blocks; ++b, data += SHA_BLOCK_SIZE)
+        {
+            __m128i abcd_save = abcd;
+            __m128i e0_save = e0;
+            __m128i prev_abcd = abcd;
+            __m128i e = e0;
+
+            // The message schedule is kept in a ring of four 4-word groups
+            __m128i msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i*16)), mask);
+
+            Sha1Rounds20<0>(abcd, e, prev_abcd, msg);
+            Sha1Rounds20<1>(abcd, e, prev_abcd, msg);
+            Sha1Rounds20<2>(abcd, e, prev_abcd, msg);
+            Sha1Rounds20<3>(abcd, e, prev_abcd, msg);
+
+            e0 = _mm_sha1nexte_epu32(prev_abcd, e0_save);
+            abcd = _mm_add_epi32(abcd, abcd_save);
+        }
+
+        abcd = _mm_shuffle_epi32(abcd, 0x1B);
+        _mm_storeu_si128((__m128i*)state, abcd);
+        state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+    }
+
+    DM_SHA_TARGET static void Sha256ProcessBlocks(uint32_t* state, const uint8_t* data, uint32_t num_blocks)
+    {
+        const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1); // CDAB
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B); // EFGH
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+        for (uint32_t b = 0; b < num_blocks; ++b, data += SHA_BLOCK_SIZE)
+        {
+            __m128i abef_save = state0;
+            __m128i cdgh_save = state1;
+
+            __m128i msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i*16)), mask);
+
+            for (int g = 0; g < 16; ++g)
+            {
+                if (g >= 4)
+                {
+                    __m128i w = _mm_add_epi32(_mm_sha256msg1_epu32(msg[g&3], msg[(g+1)&3]), _mm_alignr_epi8(msg[(g+3)&3], msg[(g+2)&3], 4));
+                    msg[g&3] = _mm_sha256msg2_epu32(w, msg[(g+3)&3]);
+                }
+
+                __m128i wk = _mm_add_epi32(msg[g&3], _mm_loadu_si128((const __m128i*)&SHA256_K[g*4]));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+            }
+
+            state0 = _mm_add_epi32(state0, abef_save);
+            state1 = _mm_add_epi32(state1, cdgh_save);
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+        state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+        state1 = _mm_alignr_epi8(state1, tmp, 8); // HGFE
+        _mm_storeu_si128((__m128i*)&state[0], state0);
+        _mm_storeu_si128((__m128i*)&state[4], state1);
+    }
+
+#elif defined(DM_CRYPT_SHA_ARM)
+
+    static bool HasShaInstructions()
+    {
+#if defined(__ANDROID__) || defined(__linux__)
+        unsigned long hwcap = getauxval(AT_HWCAP);
+        return (hwcap & HWCAP_SHA1) && (hwcap & HWCAP_SHA2);
+#else
+        return true; // The build already requires the crypto extensions
+#endif
+    }
+
+    static void Sha1ProcessBlocks(uint32_t* state, const uint8_t* data, uint32_t num_blocks)
+    {
+        static const uint32_t K[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+        uint32x4_t abcd = vld1q_u32(state);
+        uint32_t e0 = state[4];
+
+        for (uint32_t b = 0; b < num_blocks; ++b, data += SHA_BLOCK_SIZE)
+        {
+            uint32x4_t abcd_save = abcd;
+            uint32_t e0_save = e0;
+            uint32_t e = e0;
+
+            uint32x4_t msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i*16)));
+
+            for (int g = 0; g < 20; ++g)
+            {
+                if (g >= 4)
+                    msg[g&3] = vsha1su1q_u32(vsha1su0q_u32(msg[g&3], msg[(g+1)&3], msg[(g+2)&3]), msg[(g+3)&3]);
+
+                uint32x4_t wk = vaddq_u32(msg[g&3], vdupq_n_u32(K[g/5]));
+                uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+                switch (g / 5)
+                {
+                case 0:  abcd = vsha1cq_u32(abcd, e, wk); break;
+                case 2:  abcd = vsha1mq_u32(abcd, e, wk); break;
+                default: abcd = vsha1pq_u32(abcd, e, wk); break;
+                }
+                e = e_next;
+            }
+
+            e0 = e + e0_save;
+            abcd = vaddq_u32(abcd, abcd_save);
+        }
+
+        vst1q_u32(state, abcd);
+        state[4] = e0;
+    }
+
+    static void Sha256ProcessBlocks(uint32_t* state, const uint8_t* data, uint32_t num_blocks)
+    {
+        uint32x4_t state0 = vld1q_u32(&state[0]);
+        uint32x4_t state1 = vld1q_u32(&state[4]);
+
+        for (uint32_t b = 0; b < num_blocks; ++b, data += SHA_BLOCK_SIZE)
+        {
+            uint32x4_t abef_save = state0;
+            uint32x4_t cdgh_save = state1;
+
+            uint32x4_t msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i*16)));
+
+            for (int g = 0; g < 16; ++g)
+            {
+                if (g >= 4)
+                    msg[g&3] = vsha256su1q_u32(vsha256su0q_u32(msg[g&3], msg[(g+1)&3]), msg[(g+2)&3], msg[(g+3)&3]);
+
+                uint32x4_t wk = vaddq_u32(msg[g&3], vld1q_u32(&SHA256_K[g*4]));
+                uint32x4_t tmp = state0;
+                state0 = vsha256hq_u32(state0, state1, wk);
+                state1 = vsha256h2q_u32(state1, tmp, wk);
+            }
+
+            state0 = vaddq_u32(state0, abef_save);
+            state1 = vaddq_u32(state1, cdgh_save);
+        }
+
+        vst1q_u32(&state[0], state0);
+        vst1q_u32(&state[4], state1);
+    }
+
+#endif
+
+    // 0: unknown, 1: supported, 2: unsupported
+    static int g_ShaSupport = 0;
+    static bool g_ShaEnabled = true;
+
+    bool HasHardwareSha()
+    {
+#if defined(DM_CRYPT_SHA_X86) || defined(DM_CRYPT_SHA_ARM)
+        if (g_ShaSupport == 0)
+            g_ShaSupport = HasShaInstructions() ? 1 : 2; // benign race, all threads compute the same answer
+        return g_ShaSupport == 1;
+#else
+        return false;
+#endif
+    }
+
+    bool SetHardwareShaEnabled(bool enabled)
+    {
+        bool prev = g_ShaEnabled;
+        g_ShaEnabled = enabled;
+        return prev;
+    }
+
+    static inline void WriteBE32(uint8_t* out, uint32_t v)
+    {
+        out[0] = (uint8_t)(v >> 24);
+        out[1] = (uint8_t)(v >> 16);
+        out[2] = (uint8_t)(v >> 8);
+        out[3] = (uint8_t)v;
+    }
+
+    static void HashMerkleDamgard(ProcessBlocksFn process, uint32_t* state, uint32_t num_words, const uint8_t* buf, uint32_t buflen, uint8_t* digest)
+    {
+        uint32_t num_blocks = buflen / SHA_BLOCK_SIZE;
+        process(state, buf, num_blocks);
+
+        // Pad the tail with 0x80, zeroes and the message length in bits
+        uint8_t tail[SHA_BLOCK_SIZE*2];
+        uint32_t rest = buflen - num_blocks * SHA_BLOCK_SIZE;
+        uint32_t tail_size = rest < SHA_BLOCK_SIZE - 8 ? SHA_BLOCK_SIZE : SHA_BLOCK_SIZE*2;
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, buf + num_blocks * SHA_BLOCK_SIZE, rest);
+        tail[rest] = 0x80;
+        uint64_t bitlen = (uint64_t)buflen * 8;
+        WriteBE32(&tail[tail_size - 8], (uint32_t)(bitlen >> 32));
+        WriteBE32(&tail[tail_size - 4], (uint32_t)bitlen);
+        process(state, tail, tail_size / SHA_BLOCK_SIZE);
+
+        for (uint32_t i = 0; i < num_words; ++i)
+            WriteBE32(&digest[i*4], state[i]);
+    }
+
+    bool HashSha1Hardware(const uint8_t* buf, uint32_t buflen, uint8_t* digest)
+    {
+#if defined(DM_CRYPT_SHA_X86) || defined(DM_CRYPT_SHA_ARM)
+        if (!g_ShaEnabled || !HasHardwareSha())
+            return false;
+        uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+        HashMerkleDamgard(Sha1ProcessBlocks, state, 5, buf, buflen, digest);
+        return true;
+#else
+        (void)buf; (void)buflen; (void)digest;
+        return false;
+#endif
+    }
+
+    bool HashSha256Hardware(const uint8_t* buf, uint32_t buflen, uint8_t* digest)
+    {
+#if defined(DM_CRYPT_SHA_X86) || defined(DM_CRYPT_SHA_ARM)
+        if (!g_ShaEnabled || !HasHardwareSha())
+            return false;
+        uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        HashMerkleDamgard(Sha256ProcessBlocks, state, 8, buf, buflen, digest);
+        return true;
+#else
+        (void)buf; (void)buflen; (void)digest;
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,248 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "frame_arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <dmsdk/dlib/atomic.h>
+#include <dmsdk/dlib/spinlock.h>
+#include <dmsdk/dlib/thread.h>
+#include <dlib/math.h>
+
+namespace dmFrameArena
+{
+    // The size of a buffer the first time it is used
+    static const uint32_t INITIAL_BUFFER_SIZE = 64 * 1024;
+    static const uint32_t BUFFER_SIZE_GRANULARITY = 16 * 1024;
+
+    // Header of a block that didn't fit in the buffer
+    struct Overflow
+    {
+        Overflow* m_Next;
+    };
+    static const uint32_t OVERFLOW_HEADER_SIZE = 16;
+
+    struct Buffer
+    {
+        uint8_t*    m_Memory;
+        Overflow*   m_Overflows;
+        uint32_t    m_Capacity;
+        uint32_t    m_Used;
+        // Bytes requested this frame that didn't fit in the buffer
+        uint32_t    m_OverflowBytes;
+        int32_t     m_Frame;
+    };
+
+    struct Arena
+    {
+        Buffer      m_Buffers[2];
+        Arena*      m_Next;
+        // Only written by the owning thread
+        uint32_t    m_Allocations;
+        uint32_t    m_OverflowAllocations;
+        uint32_t    m_SystemAllocations;
+        uint32_t    m_HighWaterMark;
+    };
+
+    struct State
+    {
+        State()
+        {
+            m_TlsKey = dmThread::AllocTls();
+            dmSpinlock::Create(&m_Lock);
+            m_Arenas = 0;
+            m_ArenaCount = 0;
+            m_Frame = 0;
+        }
+
+        dmThread::TlsKey        m_TlsKey;
+        dmSpinlock::Spinlock    m_Lock;
+        Arena*                  m_Arenas;
+        uint32_t                m_ArenaCount;
+        int32_atomic_t          m_Frame;
+    };
+
+    static State& GetState()
+    {
+        static State state;
+        return state;
+    }
+
+    static Arena* GetThreadArena(State& state)
+    {
+        Arena* arena = (Arena*) dmThread::GetTlsValue(state.m_TlsKey);
+        if (arena)
+        {
+            return arena;
+        }
+
+        arena = (Arena*) calloc(1, sizeof(Arena));
+        if (!arena)
+        {
+            return 0;
+        }
+        // A frame that never happens, so that the buffers are set up on first use
+        arena->m_Buffers[0].m_Frame = -1;
+        arena->m_Buffers[1].m_Frame = -1;
+        dmThread::SetTlsValue(state.m_TlsKey, arena);
+
+        DM_SPINLOCK_SCOPED_LOCK(state.m_Lock);
+        arena->m_Next = state.m_Arenas;
+        state.m_Arenas = arena;
+        state.m_ArenaCount++;
+        return arena;
+    }
+
+    static void FreeOverflows(Buffer* buffer)
+    {
+        Overflow* overflow = buffer->m_Overflows;
+        while (overflow)
+        {
+            Overflow* next = overflow->m_Next;
+            free(overflow);
+            overflow = next;
+        }
+        buffer->m_Overflows = 0;
+    }
+
+    static void ResetBuffer(Arena* arena, Buffer* buffer, int32_t frame)
+    {
+        FreeOverflows(buffer);
+
+        uint32_t frame_bytes = buffer->m_Used + buffer->m_OverflowBytes;
+        arena->m_HighWaterMark = dmMath::Max(arena->m_HighWaterMark, frame_bytes);
+
+        uint32_t capacity = buffer->m_Capacity;
+        if (capacity == 0)
+        {
+            capacity = INITIAL_BUFFER_SIZE;
+        }
+        if (frame_bytes > capacity)
+        {
+            // Make room for the whole frame, with some margin for the next one
+            capacity = frame_bytes + frame_bytes / 4;
+            capacity = (capacity + BUFFER_SIZE_GRANULARITY - 1) & ~(BUFFER_SIZE_GRANULARITY - 1);
+        }
+
+        if (capacity != buffer->m_Capacity)
+        {
+            free(buffer->m_Memory);
+            buffer->m_Memory = (uint8_t*) malloc(capacity);
+            buffer->m_Capacity = buffer->m_Memory ? capacity : 0;
+            arena->m_SystemAllocations++;
+        }
+
+        buffer->m_Used = 0;
+        buffer->m_OverflowBytes = 0;
+        buffer->m_Frame = frame;
+    }
+
+    static void* AllocOverflow(Arena* arena, Buffer* buffer, uint32_t size, uint32_t align)
+    {
+        Overflow* overflow = (Overflow*) malloc(OVERFLOW_HEADER_SIZE + align + size);
+        if (!overflow)
+        {
+            return 0;
+        }
+        overflow->m_Next = buffer->m_Overflows;
+        buffer->m_Overflows = overflow;
+        buffer->m_OverflowBytes += size + align;
+        arena->m_OverflowAllocations++;
+        arena->m_SystemAllocations++;
+
+        uintptr_t p = (uintptr_t) overflow + OVERFLOW_HEADER_SIZE;
+        p = (p + align - 1) & ~(uintptr_t) (align - 1);
+        return (void*) p;
+    }
+
+    void NewFrame()
+    {
+        dmAtomicIncrement32(&GetState().m_Frame);
+    }
+
+    void* Alloc(uint32_t size, uint32_t align)
+    {
+        assert(align != 0 && (align & (align - 1)) == 0);
+
+        State& state = GetState();
+        Arena* arena = GetThreadArena(state);
+        if (!arena)
+        {
+            return 0;
+        }
+
+        int32_t frame = dmAtomicGet32(&state.m_Frame);
+        Buffer* buffer = &arena->m_Buffers[frame & 1];
+        if (buffer->m_Frame != frame)
+        {
+            // Last used two or more frames ago, so nothing in it can be alive anymore
+            ResetBuffer(arena, buffer, frame);
+        }
+        arena->m_Allocations++;
+
+        uint32_t offset = (buffer->m_Used + align - 1) & ~(align - 1);
+        if (buffer->m_Memory && offset + size <= buffer->m_Capacity)
+        {
+            buffer->m_Used = offset + size;
+            return buffer->m_Memory + offset;
+        }
+        return AllocOverflow(arena, buffer, size, align);
+    }
+
+    void GetStats(Stats* stats)
+    {
+        State& state = GetState();
+        DM_SPINLOCK_SCOPED_LOCK(state.m_Lock);
+
+        stats->m_ArenaCount = state.m_ArenaCount;
+        stats->m_Allocations = 0;
+        stats->m_OverflowAllocations = 0;
+        stats->m_SystemAllocations = 0;
+        stats->m_HighWaterMark = 0;
+        stats->m_ReservedBytes = 0;
+        for (Arena* arena = state.m_Arenas; arena; arena = arena->m_Next)
+        {
+            stats->m_Allocations += arena->m_Allocations;
+            stats->m_OverflowAllocations += arena->m_OverflowAllocations;
+            stats->m_SystemAllocations += arena->m_SystemAllocations;
+            stats->m_HighWaterMark = dmMath::Max(stats->m_HighWaterMark, arena->m_HighWaterMark);
+            stats->m_ReservedBytes += arena->m_Buffers[0].m_Capacity + arena->m_Buffers[1].m_Capacity;
+        }
+    }
+
+    void ReleaseMemory()
+    {
+        State& state = GetState();
+        DM_SPINLOCK_SCOPED_LOCK(state.m_Lock);
+
+        // The arenas themselves are kept, since the threads still refer to them
+        for (Arena* arena = state.m_Arenas; arena; arena = arena->m_Next)
+        {
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                Buffer* buffer = &arena->m_Buffers[i];
+                FreeOverflows(buffer);
+                free(buffer->m_Memory);
+                buffer->m_Memory = 0;
+                buffer->m_Capacity = 0;
+                buffer->m_Used = 0;
+                buffer->m_OverflowBytes = 0;
+                buffer->m_Frame = -1;
+            }
+            arena->m_HighWaterMark = 0;
+        }
+    }
+}
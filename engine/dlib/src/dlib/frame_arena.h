@@ -0,0 +1,87 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_FRAME_ARENA_H
+#define DM_FRAME_ARENA_H
+
+#include <stdint.h>
+
+/**
+ * Linear allocators for data that only lives for a frame or two.
+ *
+ * Each thread allocates from its own arena, so allocating needs no locking.
+ * The arenas are double buffered: memory allocated during a frame stays valid until the end
+ * of the next frame, which also covers data that is produced in one frame and consumed in the next.
+ * Nothing is freed individually. Instead a buffer is reset the first time it is used after NewFrame()
+ * has been called twice.
+ *
+ * Allocations that don't fit in the buffer fall back to the system allocator, and the buffer is
+ * grown to the high water mark when it's reset, so that the arenas settle at a size where a
+ * frame needs no system allocations.
+ *
+ * The engine calls NewFrame() every frame. Tools and tests that use the arenas outside of the
+ * engine loop should call it themselves, or the arenas keep growing.
+ */
+namespace dmFrameArena
+{
+    struct Stats
+    {
+        /// Number of threads that have allocated from an arena
+        uint32_t m_ArenaCount;
+        /// Total number of allocations from the arenas
+        uint32_t m_Allocations;
+        /// Allocations that didn't fit in the arena buffers
+        uint32_t m_OverflowAllocations;
+        /// Calls to the system allocator made by the arenas, for buffers and overflow blocks
+        uint32_t m_SystemAllocations;
+        /// The largest number of bytes allocated by one thread during a frame
+        uint32_t m_HighWaterMark;
+        /// Bytes reserved for the arena buffers
+        uint32_t m_ReservedBytes;
+    };
+
+    /**
+     * Starts a new frame. Called once per frame by the engine, after the back buffer has been presented.
+     */
+    void NewFrame();
+
+    /**
+     * Allocates memory from the arena of the calling thread.
+     * The memory stays valid until the end of the frame after the current one.
+     * @param size number of bytes
+     * @param align alignment, must be a power of two
+     * @return pointer to the memory, or 0 if the system is out of memory
+     */
+    void* Alloc(uint32_t size, uint32_t align = 16);
+
+    /**
+     * Allocates an array of count elements from the arena of the calling thread.
+     * No constructors are run.
+     */
+    template <typename T>
+    T* Alloc(uint32_t count)
+    {
+        return (T*) Alloc(count * sizeof(T), sizeof(T) >= 16 ? 16 : (sizeof(T) >= 8 ? 8 : 4));
+    }
+
+    void GetStats(Stats* stats);
+
+    /**
+     * Frees the memory of all arenas. No other thread may use the arenas during the call,
+     * and all memory allocated from them becomes invalid.
+     */
+    void ReleaseMemory();
+}
+
+#endif // DM_FRAME_ARENA_H
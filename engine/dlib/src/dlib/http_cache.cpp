@@ -12,10 +12,12 @@
 // CONDITIONS OF ANY KIND, either express or implied. See the License for the
 // specific language governing permissions and limitations under the License.
 
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <algorithm>
 #include "dstrings.h"
 #include "http_cache.h"
 #include "log.h"
@@ -32,25 +34,88 @@
 
 namespace dmHttpCache
 {
-    // Magic file header for index file
+    /*
+     * The index is stored as a journal, where every change to the index is appended as a record.
+     * The journal is rewritten with only the live entries (compacted) when it's mostly garbage.
+     *
+     * Content up to MAX_PACKED_ENTRY_SIZE is appended to shared pack files instead of being
+     * stored in a file of its own. A pack file is repacked, ie the live content is moved to the
+     * current pack file, when less than half of it is in use.
+     *
+     * Content is always written before the journal record referencing it, so a crash can only
+     * leave unreferenced content behind. Unreferenced pack and content files are removed when the cache is opened.
+     */
+
+    // Magic file header for the journal
     const uint32_t MAGIC = 0xCAAAAAAC;
-    // Current index file version
-    const uint32_t VERSION = 7;
+    // Current journal version
+    const uint32_t VERSION = 8;
 
     // Maximum number of cache entry creations in flight
     const uint32_t MAX_CACHE_CREATORS = 16;
 
-    // Index header struct
-    struct IndexHeader
+    // Content up to this size is stored in pack files
+    const uint32_t MAX_PACKED_ENTRY_SIZE = 16 * 1024;
+    // A new pack file is started when the current one would grow beyond this size
+    const uint32_t MAX_PACK_SIZE = 1024 * 1024;
+    // The journal isn't compacted until it's at least this size
+    const uint32_t MIN_JOURNAL_COMPACT_SIZE = 64 * 1024;
+
+    enum RecordType
+    {
+        RECORD_TYPE_PUT = 0,
+        RECORD_TYPE_REMOVE = 1,
+        RECORD_TYPE_TOUCH = 2,
+    };
+
+    // Journal file header
+    struct JournalHeader
     {
         // Magic number, see MAGIC
         uint32_t m_Magic;
-        // Index file version number
+        // Journal file version number
         uint32_t m_Version;
-        // Checksum of the index payload, ie the data that follows the header
+    };
+
+    // Header of a journal record. The payload follows the header
+    struct RecordHeader
+    {
+        // Checksum of type, size and payload. Used to detect torn writes at the end of the journal
+        uint32_t m_Checksum;
+        uint16_t m_Type;
+        // Size of the payload
+        uint16_t m_Size;
+    };
+
+    // RECORD_TYPE_PUT. Adds or replaces a cache entry. The record is followed by the URI (not null terminated)
+    struct PutRecord
+    {
+        uint64_t m_UriHash;
+        // The content hash is the hash of URI and ETag.
+        uint64_t m_IdentifierHash;
+        uint64_t m_LastAccessed;
+        uint64_t m_Expires;
         uint64_t m_Checksum;
-        uint32_t m_SizeOfEntry;     // Making sure the size is double checked
-        uint32_t m_SizeOfFileEntry; // Making sure the size is double checked
+        // Pack file id. 0 if the content is stored in a file of its own
+        uint32_t m_Pack;
+        // Offset in the pack file
+        uint32_t m_Offset;
+        // Content size
+        uint32_t m_Size;
+        char     m_ETag[MAX_TAG_LEN];
+    };
+
+    // RECORD_TYPE_REMOVE
+    struct RemoveRecord
+    {
+        uint64_t m_UriHash;
+    };
+
+    // RECORD_TYPE_TOUCH. Updates the last accessed time
+    struct TouchRecord
+    {
+        uint64_t m_UriHash;
+        uint64_t m_LastAccessed;
     };
 
     /*
@@ -63,28 +128,29 @@ namespace dmHttpCache
             memset(this, 0, sizeof(*this));
         }
         EntryInfo m_Info;
+        uint32_t m_Pack;
+        uint32_t m_Offset;
+        uint32_t m_Size;
+        // Size of the journal record for the entry. 0 if the entry isn't in the journal
+        uint16_t m_RecordSize;
         uint8_t  m_ReadLockCount : 8;
         uint8_t  m_WriteLock : 1;
+        // The content is stored, ie m_Pack, m_Offset and m_Size are valid
+        uint8_t  m_Committed : 1;
+        // Accessed since the last flush
+        uint8_t  m_Touched : 1;
     };
 
     /*
-     * Disk (index) representation of a cache entry
+     * Pack file for small content
      */
-    struct FileEntry
+    struct Pack
     {
-        uint64_t m_UriHash;
-        // ETag string
-        char     m_ETag[MAX_TAG_LEN];
-        // Path string
-        char     m_URI[MAX_URI_LEN];
-        // The content hash is the hash of URI and ETag.
-        uint64_t m_IdentifierHash;
-        // Last accessed time
-        uint64_t m_LastAccessed;
-        // Expires
-        uint64_t m_Expires;
-        // Checksum
-        uint64_t m_Checksum;
+        uint32_t m_Id;
+        // File size
+        uint32_t m_Size;
+        // Number of bytes referenced by cache entries
+        uint32_t m_LiveSize;
     };
 
     /*
@@ -94,6 +160,9 @@ namespace dmHttpCache
     {
         char*       m_Filename;
         FILE*       m_File;
+        // Content is kept in memory until it's too large to be packed
+        uint8_t*    m_Buffer;
+        uint32_t    m_Size;
         HashState64 m_ChecksumState;
         uint64_t    m_IdentifierHash;
         uint64_t    m_UriHash;
@@ -101,20 +170,40 @@ namespace dmHttpCache
         uint32_t    m_Error : 1;
     };
 
+    /*
+     * Cache entry reading state. Packed content is read to memory up front
+     */
+    struct CacheReader
+    {
+        FILE*       m_File;
+        uint8_t*    m_Data;
+        uint32_t    m_Size;
+        uint32_t    m_Offset;
+    };
+
     /*
      * The cache database
      */
     struct Cache
     {
-        Cache(const char* path, uint64_t max_entry_age)
+        Cache(const char* path, uint64_t max_entry_age, uint64_t max_size)
         {
             m_Path = strdup(path);
             m_MaxCacheEntryAge = max_entry_age;
+            m_MaxCacheSize = max_size;
+            m_TotalSize = 0;
             m_CacheTable.SetCapacity(11, 32);
             m_Mutex = dmMutex::New();
             m_Policy = CONSISTENCY_POLICY_VERIFY;
             m_StringAllocator = dmPoolAllocator::New(4096);
+            m_Journal = 0;
+            m_JournalSize = 0;
+            m_JournalLiveSize = 0;
+            m_PackFile = 0;
+            m_CurrentPack = 0;
+            m_NextPackId = 1;
             m_Dirty = false;
+            m_JournalError = false;
         }
 
         ~Cache()
@@ -126,19 +215,34 @@ namespace dmHttpCache
 
         char*                m_Path;
         uint64_t             m_MaxCacheEntryAge;
+        uint64_t             m_MaxCacheSize;
+        uint64_t             m_TotalSize;
         dmHashTable64<Entry> m_CacheTable;
         dmMutex::HMutex      m_Mutex;
         dmIndexPool16        m_CacheCreatorsPool;
         dmArray<CacheCreator> m_CacheCreators;
         ConsistencyPolicy    m_Policy;
         dmPoolAllocator::HPool m_StringAllocator;
+        FILE*                m_Journal;
+        uint32_t             m_JournalSize;
+        // Size of the records describing the current entries
+        uint32_t             m_JournalLiveSize;
+        dmArray<Pack>        m_Packs;
+        // Pack file that content is appended to
+        FILE*                m_PackFile;
+        uint32_t             m_CurrentPack;
+        uint32_t             m_NextPackId;
+        // There are touched entries, see Flush
         bool                 m_Dirty;
+        // The journal on disk is incomplete and must be rewritten
+        bool                 m_JournalError;
     };
 
     void SetDefaultParams(NewParams* params)
     {
         memset(params, 0, sizeof(*params));
         params->m_MaxCacheEntryAge = 60 * 60 * 24 * 5;
+        params->m_MaxCacheSize = 128 * 1024 * 1024;
     }
 
     static void HashToString(uint64_t hash, char* str)
@@ -165,6 +269,16 @@ namespace dmHttpCache
                     &identifier_string[2]);
     }
 
+    static void PackFilePath(HCache cache, uint32_t pack, char* path, int path_len)
+    {
+        dmSnPrintf(path, path_len, "%s/pack_%08x", cache->m_Path, pack);
+    }
+
+    static void JournalFilePath(HCache cache, char* path, int path_len)
+    {
+        dmSnPrintf(path, path_len, "%s/%s", cache->m_Path, "journal");
+    }
+
     static void RemoveCachedContentFile(HCache cache, uint64_t identifier_hash)
     {
         char path[DMPATH_MAX_PATH];
@@ -173,16 +287,614 @@ namespace dmHttpCache
         if (r != dmSys::RESULT_OK)
         {
             dmLogWarning("Unable to remove %s", path);
-            cache->m_Dirty = true;
         }
     }
 
-    static bool IsValidHeader(IndexHeader* header)
+    static Pack* FindPack(HCache cache, uint32_t id)
+    {
+        for (uint32_t i = 0; i < cache->m_Packs.Size(); ++i)
+        {
+            if (cache->m_Packs[i].m_Id == id)
+                return &cache->m_Packs[i];
+        }
+        return 0;
+    }
+
+    static void RemovePack(HCache cache, uint32_t id)
+    {
+        Pack* pack = FindPack(cache, id);
+        cache->m_Packs.EraseSwapRef(*pack);
+
+        char path[DMPATH_MAX_PATH];
+        PackFilePath(cache, id, path, sizeof(path));
+        dmSys::Unlink(path);
+    }
+
+    static bool OpenNewPack(HCache cache)
+    {
+        if (cache->m_PackFile)
+        {
+            fclose(cache->m_PackFile);
+            cache->m_PackFile = 0;
+        }
+
+        uint32_t id = cache->m_NextPackId++;
+        char path[DMPATH_MAX_PATH];
+        PackFilePath(cache, id, path, sizeof(path));
+        FILE* f = fopen(path, "wb");
+        if (f == 0)
+        {
+            dmLogError("Unable to create pack file '%s'", path);
+            return false;
+        }
+
+        Pack pack;
+        pack.m_Id = id;
+        pack.m_Size = 0;
+        pack.m_LiveSize = 0;
+        if (cache->m_Packs.Full())
+            cache->m_Packs.OffsetCapacity(8);
+        cache->m_Packs.Push(pack);
+
+        cache->m_PackFile = f;
+        cache->m_CurrentPack = id;
+        return true;
+    }
+
+    static Result StorePacked(HCache cache, Entry* entry, const void* content, uint32_t content_len)
+    {
+        Pack* pack = cache->m_PackFile ? FindPack(cache, cache->m_CurrentPack) : 0;
+        if (pack == 0 || pack->m_Size + content_len > MAX_PACK_SIZE)
+        {
+            if (!OpenNewPack(cache))
+                return RESULT_IO_ERROR;
+            pack = FindPack(cache, cache->m_CurrentPack);
+        }
+
+        // The pack file is flushed before the entry is written to the journal
+        size_t n_written = fwrite(content, 1, content_len, cache->m_PackFile);
+        if (n_written != content_len || fflush(cache->m_PackFile) != 0)
+        {
+            dmLogError("Unable to write to pack file %08x", pack->m_Id);
+            // Start over with a new pack file, as the end of this one is unknown
+            fclose(cache->m_PackFile);
+            cache->m_PackFile = 0;
+            pack->m_Size += content_len;
+            return RESULT_IO_ERROR;
+        }
+
+        entry->m_Pack = pack->m_Id;
+        entry->m_Offset = pack->m_Size;
+        entry->m_Size = content_len;
+        pack->m_Size += content_len;
+        pack->m_LiveSize += content_len;
+        return RESULT_OK;
+    }
+
+    static Result StoreFile(HCache cache, Entry* entry, const char* filename, uint32_t content_len)
+    {
+        char path[DMPATH_MAX_PATH];
+        ContentFilePath(cache, entry->m_Info.m_IdentifierHash, path, sizeof(path));
+        if (dmSys::Exists(path))
+        {
+            dmSys::Result r = dmSys::Unlink(path);
+            if (r != dmSys::RESULT_OK)
+            {
+                dmLogError("Unable to remove cache file: %s", path);
+                return RESULT_IO_ERROR;
+            }
+        }
+        else
+        {
+            // Modify path and remove last part of hash temporarily
+            // ie, .../5d/a7b8fa56d18877 to .../5d
+            char* last_slash = strrchr(path, '/');
+            char save = *last_slash;
+            *last_slash = '\0';
+            if (!dmSys::Exists(path))
+            {
+                dmSys::Result r = dmSys::Mkdir(path, 0755);
+                if (r != dmSys::RESULT_OK)
+                {
+                    dmLogError("Unable to create directory '%s'", path);
+                    return RESULT_IO_ERROR;
+                }
+            }
+            *last_slash = save;
+        }
+
+        if (dmSys::RESULT_OK != dmSys::Rename(path, filename))
+        {
+            char errmsg[128] = {};
+            dmStrError(errmsg, sizeof(errmsg), errno);
+            dmLogError("Unable to rename temporary cache file from '%s' to '%s'. %s (%d)", filename, path, errmsg, errno);
+            return RESULT_IO_ERROR;
+        }
+
+        entry->m_Pack = 0;
+        entry->m_Offset = 0;
+        entry->m_Size = content_len;
+        return RESULT_OK;
+    }
+
+    // Releases the stored content of an entry. Packed content is reclaimed when the pack file is repacked
+    static void ReleaseContent(HCache cache, Entry* entry)
+    {
+        if (!entry->m_Committed)
+            return;
+
+        cache->m_TotalSize -= entry->m_Size;
+        if (entry->m_Pack)
+        {
+            Pack* pack = FindPack(cache, entry->m_Pack);
+            if (pack)
+                pack->m_LiveSize -= entry->m_Size;
+        }
+        else
+        {
+            RemoveCachedContentFile(cache, entry->m_Info.m_IdentifierHash);
+        }
+        entry->m_Committed = 0;
+    }
+
+    static uint32_t RecordChecksum(const RecordHeader* header, const void* payload)
+    {
+        HashState32 hash_state;
+        dmHashInit32(&hash_state, false);
+        dmHashUpdateBuffer32(&hash_state, &header->m_Type, sizeof(header->m_Type));
+        dmHashUpdateBuffer32(&hash_state, &header->m_Size, sizeof(header->m_Size));
+        dmHashUpdateBuffer32(&hash_state, payload, header->m_Size);
+        return dmHashFinal32(&hash_state);
+    }
+
+    static bool WriteRecord(FILE* f, uint16_t type, const void* payload, uint16_t size)
+    {
+        RecordHeader header;
+        header.m_Type = type;
+        header.m_Size = size;
+        header.m_Checksum = RecordChecksum(&header, payload);
+        return fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+               fwrite(payload, 1, size, f) == size;
+    }
+
+    // Returns the payload size
+    static uint16_t MakePutRecord(uint64_t uri_hash, const Entry* entry, uint8_t* buffer)
+    {
+        PutRecord record;
+        memset(&record, 0, sizeof(record));
+        record.m_UriHash = uri_hash;
+        record.m_IdentifierHash = entry->m_Info.m_IdentifierHash;
+        record.m_LastAccessed = entry->m_Info.m_LastAccessed;
+        record.m_Expires = entry->m_Info.m_Expires;
+        record.m_Checksum = entry->m_Info.m_Checksum;
+        record.m_Pack = entry->m_Pack;
+        record.m_Offset = entry->m_Offset;
+        record.m_Size = entry->m_Size;
+        memcpy(record.m_ETag, entry->m_Info.m_ETag, sizeof(record.m_ETag));
+
+        uint32_t uri_len = dmMath::Min((uint32_t) strlen(entry->m_Info.m_URI), MAX_URI_LEN - 1);
+        memcpy(buffer, &record, sizeof(record));
+        memcpy(buffer + sizeof(record), entry->m_Info.m_URI, uri_len);
+        return (uint16_t) (sizeof(record) + uri_len);
+    }
+
+    static void AppendRecord(HCache cache, uint16_t type, const void* payload, uint16_t size)
+    {
+        if (cache->m_Journal == 0)
+            return;
+
+        if (!WriteRecord(cache->m_Journal, type, payload, size))
+        {
+            dmLogError("Unable to write to the http cache journal");
+            cache->m_JournalError = true;
+        }
+        cache->m_JournalSize += sizeof(RecordHeader) + size;
+    }
+
+    static void FlushJournal(HCache cache)
+    {
+        if (cache->m_Journal && fflush(cache->m_Journal) != 0)
+        {
+            dmLogError("Unable to write to the http cache journal");
+            cache->m_JournalError = true;
+        }
+    }
+
+    static void JournalPut(HCache cache, uint64_t uri_hash, Entry* entry)
+    {
+        uint8_t buffer[sizeof(PutRecord) + MAX_URI_LEN];
+        uint16_t size = MakePutRecord(uri_hash, entry, buffer);
+        AppendRecord(cache, RECORD_TYPE_PUT, buffer, size);
+
+        // The previous record of the entry is garbage from now on
+        cache->m_JournalLiveSize -= entry->m_RecordSize;
+        entry->m_RecordSize = sizeof(RecordHeader) + size;
+        cache->m_JournalLiveSize += entry->m_RecordSize;
+    }
+
+    static void RemoveEntry(HCache cache, uint64_t uri_hash, Entry* entry)
+    {
+        ReleaseContent(cache, entry);
+        if (entry->m_RecordSize)
+        {
+            RemoveRecord record;
+            record.m_UriHash = uri_hash;
+            AppendRecord(cache, RECORD_TYPE_REMOVE, &record, sizeof(record));
+            cache->m_JournalLiveSize -= entry->m_RecordSize;
+        }
+        cache->m_CacheTable.Erase(uri_hash);
+    }
+
+    static void GrowCacheTable(HCache cache)
+    {
+        if (cache->m_CacheTable.Full())
+        {
+            uint32_t new_capacity = cache->m_CacheTable.Capacity() + 128;
+            cache->m_CacheTable.SetCapacity(dmMath::Max(1U, 2 * new_capacity / 3), new_capacity);
+        }
+    }
+
+    static bool ApplyRecord(HCache cache, uint16_t type, const uint8_t* payload, uint16_t size)
+    {
+        if (type == RECORD_TYPE_PUT)
+        {
+            if (size < sizeof(PutRecord) || size >= sizeof(PutRecord) + MAX_URI_LEN)
+                return false;
+
+            PutRecord record;
+            memcpy(&record, payload, sizeof(record));
+            char uri[MAX_URI_LEN];
+            uint32_t uri_len = size - sizeof(PutRecord);
+            memcpy(uri, payload + sizeof(PutRecord), uri_len);
+            uri[uri_len] = '\0';
+
+            Entry* prev = cache->m_CacheTable.Get(record.m_UriHash);
+            if (prev)
+            {
+                cache->m_JournalLiveSize -= prev->m_RecordSize;
+            }
+            else
+            {
+                GrowCacheTable(cache);
+            }
+
+            Entry e;
+            memcpy(e.m_Info.m_ETag, record.m_ETag, sizeof(e.m_Info.m_ETag));
+            e.m_Info.m_ETag[MAX_TAG_LEN-1] = '\0';
+            e.m_Info.m_URI = dmPoolAllocator::Duplicate(cache->m_StringAllocator, uri);
+            e.m_Info.m_IdentifierHash = record.m_IdentifierHash;
+            e.m_Info.m_LastAccessed = record.m_LastAccessed;
+            e.m_Info.m_Expires = record.m_Expires;
+            e.m_Info.m_Checksum = record.m_Checksum;
+            e.m_Pack = record.m_Pack;
+            e.m_Offset = record.m_Offset;
+            e.m_Size = record.m_Size;
+            e.m_RecordSize = sizeof(RecordHeader) + size;
+            e.m_Committed = 1;
+            cache->m_CacheTable.Put(record.m_UriHash, e);
+            cache->m_JournalLiveSize += e.m_RecordSize;
+        }
+        else if (type == RECORD_TYPE_REMOVE)
+        {
+            if (size != sizeof(RemoveRecord))
+                return false;
+
+            RemoveRecord record;
+            memcpy(&record, payload, sizeof(record));
+            Entry* entry = cache->m_CacheTable.Get(record.m_UriHash);
+            if (entry)
+            {
+                cache->m_JournalLiveSize -= entry->m_RecordSize;
+                cache->m_CacheTable.Erase(record.m_UriHash);
+            }
+        }
+        else if (type == RECORD_TYPE_TOUCH)
+        {
+            if (size != sizeof(TouchRecord))
+                return false;
+
+            TouchRecord record;
+            memcpy(&record, payload, sizeof(record));
+            Entry* entry = cache->m_CacheTable.Get(record.m_UriHash);
+            if (entry)
+                entry->m_Info.m_LastAccessed = record.m_LastAccessed;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    static bool IsValidHeader(JournalHeader* header)
     {
          return header->m_Magic == MAGIC &&
-                header->m_Version == VERSION &&
-                header->m_SizeOfEntry == (uint32_t)sizeof(Entry) &&
-                header->m_SizeOfFileEntry == (uint32_t)sizeof(FileEntry);
+                header->m_Version == VERSION;
+    }
+
+    static bool NeedsCompaction(HCache cache)
+    {
+        return cache->m_JournalError ||
+               (cache->m_JournalSize > MIN_JOURNAL_COMPACT_SIZE && cache->m_JournalSize > 2 * cache->m_JournalLiveSize);
+    }
+
+    // Replays the journal. Returns true if the journal must be rewritten
+    static bool LoadJournal(HCache cache)
+    {
+        char journal_file[DMPATH_MAX_PATH];
+        JournalFilePath(cache, journal_file, sizeof(journal_file));
+        FILE* f = fopen(journal_file, "rb");
+        if (!f)
+        {
+            return true;
+        }
+
+        fseek(f, 0, SEEK_END);
+        size_t size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        uint8_t* buffer = (uint8_t*) malloc(size);
+        size = fread(buffer, 1, size, f);
+        fclose(f);
+
+        JournalHeader header;
+        if (size < sizeof(JournalHeader) || (memcpy(&header, buffer, sizeof(header)), !IsValidHeader(&header)))
+        {
+            dmLogError("Invalid cache journal file '%s'. Removing file.", journal_file);
+            free(buffer);
+            return true;
+        }
+
+        size_t offset = sizeof(JournalHeader);
+        while (offset + sizeof(RecordHeader) <= size)
+        {
+            RecordHeader record_header;
+            memcpy(&record_header, buffer + offset, sizeof(record_header));
+            const uint8_t* payload = buffer + offset + sizeof(RecordHeader);
+            if (offset + sizeof(RecordHeader) + record_header.m_Size > size)
+                break;
+            if (RecordChecksum(&record_header, payload) != record_header.m_Checksum)
+                break;
+            if (!ApplyRecord(cache, record_header.m_Type, payload, record_header.m_Size))
+                break;
+            offset += sizeof(RecordHeader) + record_header.m_Size;
+        }
+        free(buffer);
+
+        cache->m_JournalSize = (uint32_t) offset;
+        if (offset != size)
+        {
+            // Most likely a write that was interrupted by a crash
+            dmLogWarning("Discarding %u bytes at the end of the cache journal file '%s'", (uint32_t) (size - offset), journal_file);
+            return true;
+        }
+        return NeedsCompaction(cache);
+    }
+
+    struct WriteEntryContext
+    {
+        HCache m_Cache;
+        FILE* m_File;
+        bool m_Error;
+        uint32_t m_Size;
+        WriteEntryContext(HCache cache, FILE* f)
+        {
+            m_Cache = cache;
+            m_File = f;
+            m_Error = false;
+            m_Size = 0;
+        }
+    };
+
+    static void WriteEntry(WriteEntryContext* context, const uint64_t* key, Entry* entry)
+    {
+        entry->m_Touched = 0;
+        if (!entry->m_Committed || entry->m_WriteLock)
+        {
+            // The entry is written to the journal when it's committed, see End()
+            entry->m_RecordSize = 0;
+            return;
+        }
+
+        uint8_t buffer[sizeof(PutRecord) + MAX_URI_LEN];
+        uint16_t size = MakePutRecord(*key, entry, buffer);
+        if (!context->m_Error && !WriteRecord(context->m_File, RECORD_TYPE_PUT, buffer, size))
+        {
+            context->m_Error = true;
+        }
+        entry->m_RecordSize = sizeof(RecordHeader) + size;
+        context->m_Size += entry->m_RecordSize;
+    }
+
+    // Rewrites the journal with only the current entries
+    static Result CompactJournal(HCache cache)
+    {
+        char journal_file[DMPATH_MAX_PATH];
+        char tmp_file[DMPATH_MAX_PATH];
+        JournalFilePath(cache, journal_file, sizeof(journal_file));
+        dmSnPrintf(tmp_file, sizeof(tmp_file), "%s.tmp", journal_file);
+
+        FILE* f = fopen(tmp_file, "wb");
+        if (!f)
+        {
+            dmLogError("Unable to open cache journal file '%s'", tmp_file);
+            return RESULT_IO_ERROR;
+        }
+
+        JournalHeader header;
+        header.m_Magic = MAGIC;
+        header.m_Version = VERSION;
+        WriteEntryContext context(cache, f);
+        context.m_Error = fwrite(&header, 1, sizeof(header), f) != sizeof(header);
+        cache->m_CacheTable.Iterate(&WriteEntry, &context);
+        cache->m_Dirty = false;
+        bool ok = !context.m_Error && fflush(f) == 0;
+        fclose(f);
+
+        if (cache->m_Journal)
+        {
+            fclose(cache->m_Journal);
+            cache->m_Journal = 0;
+        }
+
+        if (!ok || dmSys::RESULT_OK != dmSys::Rename(journal_file, tmp_file))
+        {
+            dmLogError("Error writing to cache journal file '%s'", journal_file);
+            dmSys::Unlink(tmp_file);
+            // Keep appending to the old journal. It will be rewritten at the next flush
+            cache->m_Journal = fopen(journal_file, "ab");
+            cache->m_JournalError = true;
+            return RESULT_IO_ERROR;
+        }
+
+        cache->m_Journal = fopen(journal_file, "ab");
+        cache->m_JournalSize = sizeof(header) + context.m_Size;
+        cache->m_JournalLiveSize = context.m_Size;
+        cache->m_JournalError = cache->m_Journal == 0;
+        if (!cache->m_Journal)
+        {
+            dmLogError("Unable to open cache journal file '%s'", journal_file);
+            return RESULT_IO_ERROR;
+        }
+        return RESULT_OK;
+    }
+
+    static void ScanCacheFile(void* context, const char* path, bool isdir)
+    {
+        HCache cache = (HCache) context;
+        if (isdir)
+            return;
+
+        const char* basename = strrchr(path, '/');
+        basename = basename ? basename + 1 : path;
+        uint32_t id;
+        if (sscanf(basename, "pack_%08x", &id) == 1 && id > 0)
+        {
+            dmSys::StatInfo info;
+            if (dmSys::Stat(path, &info) != dmSys::RESULT_OK)
+                return;
+
+            Pack pack;
+            pack.m_Id = id;
+            pack.m_Size = (uint32_t) info.m_Size;
+            pack.m_LiveSize = 0;
+            if (cache->m_Packs.Full())
+                cache->m_Packs.OffsetCapacity(8);
+            cache->m_Packs.Push(pack);
+            cache->m_NextPackId = dmMath::Max(cache->m_NextPackId, id + 1);
+        }
+        else if (strncmp(basename, "temp", 4) == 0 || strcmp(basename, "journal.tmp") == 0)
+        {
+            // Left behind by an interrupted session
+            dmSys::Unlink(path);
+        }
+    }
+
+    struct ValidateEntryContext
+    {
+        HCache            m_Cache;
+        uint64_t          m_CurrentTime;
+        dmArray<uint64_t> m_Removed;
+    };
+
+    static void ValidateEntry(ValidateEntryContext* context, const uint64_t* key, Entry* entry)
+    {
+        HCache cache = context->m_Cache;
+        Pack* pack = entry->m_Pack ? FindPack(cache, entry->m_Pack) : 0;
+        // Empty content doesn't need its pack file
+        bool valid = entry->m_Pack == 0 || entry->m_Size == 0 || (pack && (uint64_t) entry->m_Offset + entry->m_Size <= pack->m_Size);
+        bool expired = entry->m_Info.m_LastAccessed + cache->m_MaxCacheEntryAge < context->m_CurrentTime;
+
+        if (valid)
+        {
+            cache->m_TotalSize += entry->m_Size;
+            if (pack)
+                pack->m_LiveSize += entry->m_Size;
+        }
+        else
+        {
+            // Never released, see below
+            entry->m_Committed = 0;
+        }
+
+        if (!valid || expired)
+        {
+            if (context->m_Removed.Full())
+                context->m_Removed.OffsetCapacity(64);
+            context->m_Removed.Push(*key);
+        }
+    }
+
+    struct SweepContext
+    {
+        // Sorted identifier hashes of the entries stored in files of their own
+        dmArray<uint64_t> m_ContentFiles;
+    };
+
+    static void CollectContentFile(SweepContext* context, const uint64_t* key, Entry* entry)
+    {
+        if (entry->m_Pack != 0)
+            return;
+        if (context->m_ContentFiles.Full())
+            context->m_ContentFiles.OffsetCapacity(64);
+        context->m_ContentFiles.Push(entry->m_Info.m_IdentifierHash);
+    }
+
+    static bool IsHexString(const char* str, uint32_t len)
+    {
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            char c = str[i];
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+                return false;
+        }
+        return true;
+    }
+
+    // Content files are stored as "<first two hex digits>/<remaining 14 hex digits>" of the identifier hash, see ContentFilePath()
+    static bool ParseContentFilePath(const char* path, uint64_t* identifier_hash)
+    {
+        const char* basename = strrchr(path, '/');
+        if (!basename || basename - path < 3 || basename[-3] != '/')
+            return false;
+        const char* dirname = basename - 2;
+        ++basename;
+        if (strlen(basename) != 14 || !IsHexString(dirname, 2) || !IsHexString(basename, 14))
+            return false;
+
+        char identifier_string[8 * 2 + 1];
+        memcpy(identifier_string, dirname, 2);
+        memcpy(identifier_string + 2, basename, 14);
+        identifier_string[16] = '\0';
+        *identifier_hash = strtoull(identifier_string, 0, 16);
+        return true;
+    }
+
+    static void SweepContentFile(void* ctx, const char* path, bool isdir)
+    {
+        SweepContext* context = (SweepContext*) ctx;
+        uint64_t identifier_hash;
+        if (isdir || !ParseContentFilePath(path, &identifier_hash))
+            return;
+
+        const uint64_t* begin = context->m_ContentFiles.Begin();
+        const uint64_t* end = context->m_ContentFiles.End();
+        if (!std::binary_search(begin, end, identifier_hash))
+        {
+            // Written by a session that crashed before the journal record, or that failed to remove it
+            if (dmSys::Unlink(path) != dmSys::RESULT_OK)
+            {
+                dmLogWarning("Unable to remove %s", path);
+            }
+        }
+    }
+
+    // Removes the content files that no entry references
+    static void SweepContentFiles(HCache cache)
+    {
+        SweepContext context;
+        cache->m_CacheTable.Iterate(&CollectContentFile, &context);
+        std::sort(context.m_ContentFiles.Begin(), context.m_ContentFiles.End());
+        dmSys::IterateTree(cache->m_Path, true, false, &context, &SweepContentFile);
     }
 
     Result Open(NewParams* params, HCache* cache)
@@ -206,7 +918,17 @@ namespace dmHttpCache
             }
         }
 
-        Cache* c = new Cache(path, params->m_MaxCacheEntryAge * 1000000);
+        char legacy_index[DMPATH_MAX_PATH];
+        dmSnPrintf(legacy_index, sizeof(legacy_index), "%s/%s", path, "index");
+        if (dmSys::Exists(legacy_index))
+        {
+            // The content of caches from before the journal can't be recovered
+            dmLogInfo("Removing http cache '%s' in old format", path);
+            dmSys::RmTree(path);
+            dmSys::Mkdir(path, 0755);
+        }
+
+        Cache* c = new Cache(path, params->m_MaxCacheEntryAge * 1000000, params->m_MaxCacheSize);
         c->m_CacheCreatorsPool.SetCapacity(MAX_CACHE_CREATORS);
         c->m_CacheCreators.SetCapacity(MAX_CACHE_CREATORS);
         c->m_CacheCreators.SetSize(MAX_CACHE_CREATORS);
@@ -217,174 +939,176 @@ namespace dmHttpCache
             memset(h, 0, sizeof(*h));
         }
 
-        char cache_file[DMPATH_MAX_PATH];
-        dmSnPrintf(cache_file, sizeof(cache_file), "%s/%s", path, "index");
-        FILE* f = fopen(cache_file, "rb");
-        if (f)
+        bool compact = LoadJournal(c);
+        dmSys::IterateTree(path, false, false, c, &ScanCacheFile);
+
+        ValidateEntryContext context;
+        context.m_Cache = c;
+        context.m_CurrentTime = dmTime::GetTime();
+        c->m_CacheTable.Iterate(&ValidateEntry, &context);
+        for (uint32_t i = 0; i < context.m_Removed.Size(); ++i)
         {
-            fseek(f, 0, SEEK_END);
-            size_t size = ftell(f);
-            fseek(f, 0, SEEK_SET);
-            void* buffer = malloc(size);
-            (void)fread(buffer, 1, size, f);
-            IndexHeader* header = (IndexHeader*) buffer;
-            if (size < (sizeof(IndexHeader)) || !IsValidHeader(header))
-            {
-                dmLogError("Invalid cache index file '%s'. Removing file.", cache_file);
-                // We remove the file and return RESULT_OK
-                dmSys::Unlink(cache_file);
-            }
+            // Remove old cache entry or entry with missing content
+            RemoveEntry(c, context.m_Removed[i], c->m_CacheTable.Get(context.m_Removed[i]));
+        }
+        compact |= context.m_Removed.Size() > 0;
+
+        for (uint32_t i = 0; i < c->m_Packs.Size();)
+        {
+            if (c->m_Packs[i].m_LiveSize == 0)
+                RemovePack(c, c->m_Packs[i].m_Id);
             else
+                ++i;
+        }
+
+        SweepContentFiles(c);
+
+        if (compact)
+        {
+            CompactJournal(c);
+        }
+        else
+        {
+            char journal_file[DMPATH_MAX_PATH];
+            JournalFilePath(c, journal_file, sizeof(journal_file));
+            c->m_Journal = fopen(journal_file, "ab");
+            if (!c->m_Journal)
             {
-                uint64_t checksum = dmHashBuffer64((void*) (((uintptr_t) buffer) + sizeof(IndexHeader)), size - sizeof(IndexHeader));
-                if (checksum != header->m_Checksum)
-                {
-                    dmLogError("Corrupt cache index file '%s'. Removing file.", cache_file);
-                }
-                else
-                {
-                    uint32_t n_entries = (size - sizeof(IndexHeader)) / sizeof(FileEntry);
-                    FileEntry* entries = (FileEntry*) (((uintptr_t) buffer) + sizeof(IndexHeader));
-                    uint32_t capacity = n_entries + 128;
-                    c->m_CacheTable.SetCapacity(2 * capacity / 3, capacity);
-                    uint64_t current_time = dmTime::GetTime();
-                    for (uint32_t i = 0; i < n_entries; ++i)
-                    {
-                        if (entries[i].m_LastAccessed + c->m_MaxCacheEntryAge >= current_time)
-                        {
-                            // Keep cache entry, ie within max age
-                            Entry e;
-                            memcpy(e.m_Info.m_ETag, entries[i].m_ETag, sizeof(e.m_Info.m_ETag));
-                            e.m_Info.m_URI = dmPoolAllocator::Duplicate(c->m_StringAllocator, entries[i].m_URI);
-                            e.m_Info.m_IdentifierHash = entries[i].m_IdentifierHash;
-                            e.m_Info.m_LastAccessed = entries[i].m_LastAccessed;
-                            e.m_Info.m_Expires = entries[i].m_Expires;
-                            e.m_Info.m_Checksum = entries[i].m_Checksum;
-                            c->m_CacheTable.Put(entries[i].m_UriHash, e);
-                        }
-                        else
-                        {
-                            // Remove old cache entry
-                            RemoveCachedContentFile(c, entries[i].m_IdentifierHash);
-                        }
-                    }
-                }
+                dmLogError("Unable to open cache journal file '%s'", journal_file);
             }
-            free(buffer);
-            fclose(f);
         }
 
         *cache = c;
         return RESULT_OK;
     }
 
-    struct WriteEntryContext
+    struct RepackContext
     {
-        FILE* m_File;
-        bool m_Error;
-        HashState64 m_HashState;
-        WriteEntryContext(FILE* f)
-        {
-            m_File = f;
-            m_Error = false;
-            dmHashInit64(&m_HashState, false);
-        }
+        HCache         m_Cache;
+        uint32_t       m_Pack;
+        const uint8_t* m_Data;
+        uint32_t       m_Size;
+        bool           m_Error;
     };
 
-    static void WriteEntry(WriteEntryContext* context, const uint64_t* key, Entry* entry)
+    static void RepackEntry(RepackContext* context, const uint64_t* key, Entry* entry)
     {
-        if (context->m_Error)
+        if (context->m_Error || !entry->m_Committed || entry->m_Pack != context->m_Pack)
             return;
 
-        if(entry->m_WriteLock)
+        HCache cache = context->m_Cache;
+        if ((uint64_t) entry->m_Offset + entry->m_Size > context->m_Size)
         {
-            dmLogWarning("Invalid http cache state. Not yet flushed cache entry (etag: %s).", entry->m_Info.m_ETag);
+            context->m_Error = true;
             return;
         }
 
-        FileEntry file_entry;
-        memset(&file_entry, 0, sizeof(file_entry));
-
-        file_entry.m_UriHash = *key;
-        memcpy(file_entry.m_ETag, entry->m_Info.m_ETag, sizeof(file_entry.m_ETag));
-        dmStrlCpy(file_entry.m_URI, entry->m_Info.m_URI, sizeof(file_entry.m_URI));
-        file_entry.m_IdentifierHash = entry->m_Info.m_IdentifierHash;
-        file_entry.m_LastAccessed = entry->m_Info.m_LastAccessed;
-        file_entry.m_Expires = entry->m_Info.m_Expires;
-        file_entry.m_Checksum = entry->m_Info.m_Checksum;
-
-        dmHashUpdateBuffer64(&context->m_HashState, &file_entry, sizeof(file_entry));
-        size_t n_written = fwrite(&file_entry, 1, sizeof(file_entry), context->m_File);
-        if (n_written != sizeof(file_entry))
+        uint32_t size = entry->m_Size;
+        if (StorePacked(cache, entry, context->m_Data + entry->m_Offset, size) != RESULT_OK)
         {
             context->m_Error = true;
+            return;
         }
+        FindPack(cache, context->m_Pack)->m_LiveSize -= size;
+        JournalPut(cache, *key, entry);
     }
 
-    static Result WriteIndex(HCache cache, FILE* f)
+    // Moves the live content of a pack file to the current pack file and removes it
+    static bool Repack(HCache cache, uint32_t id)
     {
-        IndexHeader header;
-
-        header.m_Magic = MAGIC;
-        header.m_Version = VERSION;
-        header.m_Checksum = 0;
-        header.m_SizeOfEntry = (uint32_t)sizeof(Entry);
-        header.m_SizeOfFileEntry = (uint32_t)sizeof(FileEntry);
-        size_t n_written = fwrite(&header, 1, sizeof(header), f);
-        if (n_written != sizeof(header))
-        {
-            return RESULT_IO_ERROR;
-        }
-        else
+        Pack* pack = FindPack(cache, id);
+        if (pack->m_LiveSize > 0)
         {
-            WriteEntryContext context(f);
-            cache->m_CacheTable.Iterate(&WriteEntry, &context);
+            char path[DMPATH_MAX_PATH];
+            PackFilePath(cache, id, path, sizeof(path));
+            FILE* f = fopen(path, "rb");
+            if (!f)
+            {
+                dmLogError("Unable to open pack file '%s'", path);
+                return false;
+            }
+
+            RepackContext context;
+            context.m_Cache = cache;
+            context.m_Pack = id;
+            context.m_Size = pack->m_Size;
+            context.m_Error = false;
+            uint8_t* data = (uint8_t*) malloc(pack->m_Size);
+            context.m_Data = data;
+            context.m_Size = (uint32_t) fread(data, 1, pack->m_Size, f);
+            fclose(f);
+
+            cache->m_CacheTable.Iterate(&RepackEntry, &context);
+            free(data);
+
+            // The new locations must be in the journal before the pack file is removed
+            FlushJournal(cache);
             if (context.m_Error)
             {
-                return RESULT_IO_ERROR;
+                dmLogError("Unable to repack pack file '%s'", path);
+                return false;
             }
-            else
+        }
+
+        RemovePack(cache, id);
+        return true;
+    }
+
+    static void RepackPacks(HCache cache)
+    {
+        for (uint32_t i = 0; i < cache->m_Packs.Size();)
+        {
+            const Pack& pack = cache->m_Packs[i];
+            bool current = cache->m_PackFile && pack.m_Id == cache->m_CurrentPack;
+            if (current || pack.m_LiveSize * 2 > pack.m_Size || !Repack(cache, pack.m_Id))
             {
-                // Rewrite header with checksum
-                fseek(f, 0, SEEK_SET);
-                header.m_Checksum = dmHashFinal64(&context.m_HashState);
-                size_t n_written = fwrite(&header, 1, sizeof(header), f);
-                if (n_written != sizeof(header))
-                {
-                    return RESULT_IO_ERROR;
-                }
+                ++i;
             }
+            // else: the pack at index i was replaced by another one, see RemovePack()
+        }
+    }
+
+    struct TouchEntryContext
+    {
+        HCache m_Cache;
+    };
+
+    static void TouchEntry(TouchEntryContext* context, const uint64_t* key, Entry* entry)
+    {
+        if (!entry->m_Touched)
+            return;
+
+        entry->m_Touched = 0;
+        if (entry->m_RecordSize)
+        {
+            TouchRecord record;
+            record.m_UriHash = *key;
+            record.m_LastAccessed = entry->m_Info.m_LastAccessed;
+            AppendRecord(context->m_Cache, RECORD_TYPE_TOUCH, &record, sizeof(record));
         }
-        return RESULT_OK;
     }
 
     Result Flush(HCache cache)
     {
         dmMutex::ScopedLock lock(cache->m_Mutex);
-        if (!cache->m_Dirty) {
-            return RESULT_OK;
+
+        if (cache->m_Dirty)
+        {
+            cache->m_Dirty = false;
+            TouchEntryContext context;
+            context.m_Cache = cache;
+            cache->m_CacheTable.Iterate(&TouchEntry, &context);
+            FlushJournal(cache);
         }
 
-        cache->m_Dirty = false;
-        dmLogInfo("Flushing http cache to disk");
+        RepackPacks(cache);
 
-        char cache_file[DMPATH_MAX_PATH];
-        dmSnPrintf(cache_file, sizeof(cache_file), "%s/%s", cache->m_Path, "index");
-        FILE* f = fopen(cache_file, "wb");
-        if (f) {
-            Result r = WriteIndex(cache, f);
-            fclose(f);
-            if (r != RESULT_OK) {
-                dmLogError("Error writing to index file '%s'", cache_file);
-                dmSys::Unlink(cache_file);
-                return RESULT_IO_ERROR;
-            }
-        } else {
-            dmLogError("Unable to open index file '%s'", cache_file);
-            return RESULT_IO_ERROR;
+        if (NeedsCompaction(cache))
+        {
+            return CompactJournal(cache);
         }
 
-        return RESULT_OK;
+        return cache->m_JournalError ? RESULT_IO_ERROR : RESULT_OK;
     }
 
     Result Close(HCache cache)
@@ -401,9 +1125,21 @@ namespace dmHttpCache
             {
                 fclose(h->m_File);
             }
+
+            free(h->m_Buffer);
         }
 
         Flush(cache);
+
+        if (cache->m_Journal)
+        {
+            fclose(cache->m_Journal);
+        }
+        if (cache->m_PackFile)
+        {
+            fclose(cache->m_PackFile);
+        }
+
         delete cache;
         return RESULT_OK;
     }
@@ -448,15 +1184,22 @@ namespace dmHttpCache
                 }
             }
         }
+
+        if (cache->m_CacheCreatorsPool.Remaining() == 0)
+        {
+            return RESULT_OUT_OF_RESOURCES;
+        }
+
+        if (entry)
+        {
+            // The previous content can't be read once the entry is updated
+            ReleaseContent(cache, entry);
+        }
         else
         {
             // New entry
             Entry new_entry;
-            if (cache->m_CacheTable.Full())
-            {
-                uint32_t new_capacity = cache->m_CacheTable.Capacity() + 128;
-                cache->m_CacheTable.SetCapacity(dmMath::Max(1U, 2 * new_capacity / 3), new_capacity);
-            }
+            GrowCacheTable(cache);
             cache->m_CacheTable.Put(uri_hash, new_entry);
         }
 
@@ -473,31 +1216,20 @@ namespace dmHttpCache
         }
         entry->m_WriteLock = 1;
 
-        if (cache->m_CacheCreatorsPool.Remaining() == 0)
-        {
-            return RESULT_OUT_OF_RESOURCES;
-        }
         uint16_t index = cache->m_CacheCreatorsPool.Pop();
 
-        int file_name_len = strlen(cache->m_Path) + 1 /* slash */ + 8 /* tempXXXX */ + 1 /* '\0' */;
-        char* file_name = (char*) malloc(file_name_len);
-        dmSnPrintf(file_name, file_name_len, "%s/temp%04d", cache->m_Path, (int) index);
-        FILE* f = fopen(file_name, "wb");
-        if (f == 0)
+        CacheCreator* handle = &cache->m_CacheCreators[index];
+        if (handle->m_Buffer == 0)
         {
-            dmLogError("Unable to open temporary file: '%s'", file_name);
-            free(file_name);
-            cache->m_CacheCreatorsPool.Push(index);
-            return RESULT_IO_ERROR;
+            handle->m_Buffer = (uint8_t*) malloc(MAX_PACKED_ENTRY_SIZE);
         }
-
-        CacheCreator* handle = &cache->m_CacheCreators[index];
         handle->m_Index = index;
         dmHashInit64(&handle->m_ChecksumState, false);
-        handle->m_File = f;
-        handle->m_Filename = file_name;
+        handle->m_File = 0;
+        handle->m_Filename = 0;
+        handle->m_Size = 0;
         handle->m_IdentifierHash = identifier_hash;
-        handle->m_UriHash = dmHashString64(uri);
+        handle->m_UriHash = uri_hash;
         handle->m_Error = 0;
         *cache_creator = handle;
 
@@ -524,9 +1256,35 @@ namespace dmHttpCache
         cache_creator->m_Index = 0xffff;
     }
 
+    // Moves the content to a temporary file, as it's too large to be packed
+    static Result OpenTemporaryFile(HCache cache, HCacheCreator cache_creator)
+    {
+        int file_name_len = strlen(cache->m_Path) + 1 /* slash */ + 8 /* tempXXXX */ + 1 /* '\0' */;
+        char* file_name = (char*) malloc(file_name_len);
+        dmSnPrintf(file_name, file_name_len, "%s/temp%04d", cache->m_Path, (int) cache_creator->m_Index);
+        FILE* f = fopen(file_name, "wb");
+        if (f == 0)
+        {
+            dmLogError("Unable to open temporary file: '%s'", file_name);
+            free(file_name);
+            return RESULT_IO_ERROR;
+        }
+
+        cache_creator->m_File = f;
+        cache_creator->m_Filename = file_name;
+
+        size_t nwritten = fwrite(cache_creator->m_Buffer, 1, cache_creator->m_Size, f);
+        if (nwritten != cache_creator->m_Size)
+        {
+            dmLogError("Error writing to cache file: '%s'", file_name);
+            return RESULT_IO_ERROR;
+        }
+        return RESULT_OK;
+    }
+
     Result Add(HCache cache, HCacheCreator cache_creator, const void* content, uint32_t content_len)
     {
-        assert(cache_creator->m_File && cache_creator->m_Filename);
+        assert(cache_creator->m_Buffer);
         dmHashUpdateBuffer64(&cache_creator->m_ChecksumState, content, content_len);
 
         if (cache_creator->m_Error)
@@ -534,6 +1292,22 @@ namespace dmHttpCache
             return RESULT_IO_ERROR;
         }
 
+        if (cache_creator->m_File == 0)
+        {
+            if (cache_creator->m_Size + content_len <= MAX_PACKED_ENTRY_SIZE)
+            {
+                memcpy(cache_creator->m_Buffer + cache_creator->m_Size, content, content_len);
+                cache_creator->m_Size += content_len;
+                return RESULT_OK;
+            }
+
+            if (OpenTemporaryFile(cache, cache_creator) != RESULT_OK)
+            {
+                cache_creator->m_Error = 1;
+                return RESULT_IO_ERROR;
+            }
+        }
+
         size_t nwritten = fwrite(content, 1, content_len, cache_creator->m_File);
         if (nwritten != content_len)
         {
@@ -541,6 +1315,7 @@ namespace dmHttpCache
             cache_creator->m_Error = 1;
             return RESULT_IO_ERROR;
         }
+        cache_creator->m_Size += content_len;
 
         return RESULT_OK;
     }
@@ -550,79 +1325,108 @@ namespace dmHttpCache
         cache_creator->m_Error = 1;
     }
 
+    struct EvictCandidate
+    {
+        uint64_t m_LastAccessed;
+        uint64_t m_UriHash;
+    };
+
+    static void CollectEvictCandidate(dmArray<EvictCandidate>* candidates, const uint64_t* key, Entry* entry)
+    {
+        if (!entry->m_Committed || entry->m_WriteLock || entry->m_ReadLockCount > 0)
+            return;
+
+        EvictCandidate candidate;
+        candidate.m_LastAccessed = entry->m_Info.m_LastAccessed;
+        candidate.m_UriHash = *key;
+        candidates->Push(candidate);
+    }
+
+    static bool EvictCandidateLess(const EvictCandidate& a, const EvictCandidate& b)
+    {
+        return a.m_LastAccessed < b.m_LastAccessed;
+    }
+
+    // Removes the least recently used entries until the total size is at most target_size
+    static void EvictEntries(HCache cache, uint64_t target_size, uint64_t keep_uri_hash)
+    {
+        dmArray<EvictCandidate> candidates;
+        candidates.SetCapacity(cache->m_CacheTable.Size());
+        cache->m_CacheTable.Iterate(&CollectEvictCandidate, &candidates);
+        std::sort(candidates.Begin(), candidates.End(), EvictCandidateLess);
+
+        for (uint32_t i = 0; i < candidates.Size() && cache->m_TotalSize > target_size; ++i)
+        {
+            uint64_t uri_hash = candidates[i].m_UriHash;
+            if (uri_hash != keep_uri_hash)
+            {
+                RemoveEntry(cache, uri_hash, cache->m_CacheTable.Get(uri_hash));
+            }
+        }
+    }
+
     Result End(HCache cache, HCacheCreator cache_creator)
     {
         dmMutex::ScopedLock lock(cache->m_Mutex);
 
-        assert(cache_creator->m_File && cache_creator->m_Filename);
+        assert(cache_creator->m_Buffer);
         uint64_t identifier_hash = cache_creator->m_IdentifierHash;
 
-        fclose(cache_creator->m_File);
-        cache_creator->m_File = 0;
+        if (cache_creator->m_File)
+        {
+            if (fclose(cache_creator->m_File) != 0)
+            {
+                cache_creator->m_Error = 1;
+            }
+            cache_creator->m_File = 0;
+        }
 
         uint64_t uri_hash = cache_creator->m_UriHash;
         Entry* entry = cache->m_CacheTable.Get(uri_hash);
         assert(entry);
+        assert(entry->m_WriteLock);
+        assert(entry->m_Info.m_IdentifierHash == identifier_hash);
 
+        Result r = RESULT_OK;
         if (cache_creator->m_Error)
         {
-            dmSys::Unlink(cache_creator->m_Filename);
-            FreeCacheCreator(cache, cache_creator);
-            cache->m_CacheTable.Erase(uri_hash);
-            return RESULT_IO_ERROR;
+            r = RESULT_IO_ERROR;
         }
-
-        char path[DMPATH_MAX_PATH];
-        ContentFilePath(cache, identifier_hash, path, sizeof(path));
-        if (dmSys::Exists(path))
+        else if (cache->m_MaxCacheSize > 0 && cache_creator->m_Size > cache->m_MaxCacheSize)
         {
-            dmSys::Result r = dmSys::Unlink(path);
-            if (r != dmSys::RESULT_OK)
-            {
-                dmLogError("Unable to remove cache file: %s", path);
-                FreeCacheCreator(cache, cache_creator);
-                cache->m_CacheTable.Erase(uri_hash);
-                return RESULT_IO_ERROR;
-            }
+            dmLogWarning("Content of uri: '%s' (%u bytes) is larger than the http cache.", entry->m_Info.m_URI, cache_creator->m_Size);
+            r = RESULT_OUT_OF_RESOURCES;
+        }
+        else if (cache_creator->m_Filename)
+        {
+            r = StoreFile(cache, entry, cache_creator->m_Filename, cache_creator->m_Size);
         }
         else
         {
-            // Modify path and remove last part of hash temporarily
-            // ie, .../5d/a7b8fa56d18877 to .../5d
-            char* last_slash = strrchr(path, '/');
-            char save = *last_slash;
-            *last_slash = '\0';
-            if (!dmSys::Exists(path))
-            {
-                dmSys::Result r = dmSys::Mkdir(path, 0755);
-                if (r != dmSys::RESULT_OK)
-                {
-                    dmLogError("Unable to create directory '%s'", path);
-                    FreeCacheCreator(cache, cache_creator);
-                    cache->m_CacheTable.Erase(uri_hash);
-                    return RESULT_IO_ERROR;
-                }
-            }
-            *last_slash = save;
+            r = StorePacked(cache, entry, cache_creator->m_Buffer, cache_creator->m_Size);
         }
 
-        assert(entry->m_WriteLock);
-        assert(entry->m_Info.m_IdentifierHash == identifier_hash);
         entry->m_WriteLock = 0;
-        entry->m_Info.m_Checksum = dmHashFinal64(&cache_creator->m_ChecksumState);
-
-        if (dmSys::RESULT_OK != dmSys::Rename(path, cache_creator->m_Filename))
+        if (r != RESULT_OK)
         {
-            char errmsg[128] = {};
-            dmStrError(errmsg, sizeof(errmsg), errno);
-            dmLogError("Unable to rename temporary cache file from '%s' to '%s'. %s (%d)", cache_creator->m_Filename, path, errmsg, errno);
             FreeCacheCreator(cache, cache_creator);
-            cache->m_CacheTable.Erase(uri_hash);
-            return RESULT_IO_ERROR;
+            RemoveEntry(cache, uri_hash, entry);
+            FlushJournal(cache);
+            return r;
         }
 
+        entry->m_Info.m_Checksum = dmHashFinal64(&cache_creator->m_ChecksumState);
+        entry->m_Committed = 1;
+        cache->m_TotalSize += entry->m_Size;
+        JournalPut(cache, uri_hash, entry);
         FreeCacheCreator(cache, cache_creator);
-        cache->m_Dirty = true;
+
+        if (cache->m_MaxCacheSize > 0 && cache->m_TotalSize > cache->m_MaxCacheSize)
+        {
+            // Evict a bit more than needed, to not evict on every new entry
+            EvictEntries(cache, cache->m_MaxCacheSize - cache->m_MaxCacheSize / 8, uri_hash);
+        }
+        FlushJournal(cache);
 
         return RESULT_OK;
     }
@@ -666,7 +1470,67 @@ namespace dmHttpCache
         }
     }
 
-    Result Get(HCache cache, const char* uri, const char* etag, FILE** file, uint64_t* checksum)
+    static CacheReader* OpenReader(HCache cache, const Entry* entry)
+    {
+        char path[DMPATH_MAX_PATH];
+        if (entry->m_Pack == 0)
+        {
+            ContentFilePath(cache, entry->m_Info.m_IdentifierHash, path, sizeof(path));
+            FILE* f = fopen(path, "rb");
+            if (!f)
+            {
+                dmLogError("Unable to open %s", path);
+                return 0;
+            }
+
+            CacheReader* reader = (CacheReader*) malloc(sizeof(CacheReader));
+            fseek(f, 0, SEEK_END);
+            reader->m_File = f;
+            reader->m_Data = 0;
+            reader->m_Size = (uint32_t) ftell(f);
+            reader->m_Offset = 0;
+            fseek(f, 0, SEEK_SET);
+            return reader;
+        }
+
+        CacheReader* reader = (CacheReader*) malloc(sizeof(CacheReader) + entry->m_Size);
+        reader->m_File = 0;
+        reader->m_Data = (uint8_t*) (reader + 1);
+        reader->m_Size = entry->m_Size;
+        reader->m_Offset = 0;
+        if (entry->m_Size == 0)
+            return reader;
+
+        PackFilePath(cache, entry->m_Pack, path, sizeof(path));
+        FILE* f = fopen(path, "rb");
+        if (!f)
+        {
+            dmLogError("Unable to open %s", path);
+            free(reader);
+            return 0;
+        }
+
+        bool ok = fseek(f, entry->m_Offset, SEEK_SET) == 0 && fread(reader->m_Data, 1, entry->m_Size, f) == entry->m_Size;
+        fclose(f);
+        if (!ok)
+        {
+            dmLogError("Unable to read %u bytes at %u from %s", entry->m_Size, entry->m_Offset, path);
+            free(reader);
+            return 0;
+        }
+        return reader;
+    }
+
+    static void CloseReader(CacheReader* reader)
+    {
+        if (reader->m_File)
+        {
+            fclose(reader->m_File);
+        }
+        free(reader);
+    }
+
+    Result Get(HCache cache, const char* uri, const char* etag, HCacheReader* reader, uint64_t* checksum)
     {
         dmMutex::ScopedLock lock(cache->m_Mutex);
 
@@ -687,22 +1551,22 @@ namespace dmHttpCache
             }
 
             entry->m_Info.m_LastAccessed = dmTime::GetTime();
+            entry->m_Touched = 1;
+            cache->m_Dirty = true;
 
-            char path[DMPATH_MAX_PATH];
-            ContentFilePath(cache, identifier_hash, path, sizeof(path));
-            FILE* f = fopen(path, "rb");
-            if (f)
+            CacheReader* r = OpenReader(cache, entry);
+            if (r)
             {
-                *file = f;
+                *reader = r;
                 entry->m_ReadLockCount++;
                 *checksum = entry->m_Info.m_Checksum;
                 return RESULT_OK;
             }
             else
             {
-                dmLogError("Unable to open %s", path);
                 // Remove invalid cache entry
-                cache->m_CacheTable.Erase(uri_hash);
+                RemoveEntry(cache, uri_hash, entry);
+                FlushJournal(cache);
                 return RESULT_NO_ENTRY;
             }
         }
@@ -710,6 +1574,24 @@ namespace dmHttpCache
         return RESULT_NO_ENTRY;
     }
 
+    uint32_t Read(HCacheReader reader, void* buffer, uint32_t buffer_len)
+    {
+        if (reader->m_File)
+        {
+            return (uint32_t) fread(buffer, 1, buffer_len, reader->m_File);
+        }
+
+        uint32_t n = dmMath::Min(buffer_len, reader->m_Size - reader->m_Offset);
+        memcpy(buffer, reader->m_Data + reader->m_Offset, n);
+        reader->m_Offset += n;
+        return n;
+    }
+
+    uint32_t GetContentSize(HCacheReader reader)
+    {
+        return reader->m_Size;
+    }
+
     Result SetVerified(HCache cache, const char* uri, bool verified)
     {
         dmMutex::ScopedLock lock(cache->m_Mutex);
@@ -727,7 +1609,7 @@ namespace dmHttpCache
         }
     }
 
-    Result Release(HCache cache, const char* uri, const char* etag, FILE* file)
+    Result Release(HCache cache, const char* uri, const char* etag, HCacheReader reader)
     {
         dmMutex::ScopedLock lock(cache->m_Mutex);
 
@@ -745,7 +1627,7 @@ namespace dmHttpCache
         assert(entry->m_ReadLockCount > 0);
         --entry->m_ReadLockCount;
 
-        fclose(file);
+        CloseReader(reader);
         return RESULT_OK;
     }
 
@@ -755,6 +1637,12 @@ namespace dmHttpCache
         return cache->m_CacheTable.Size();
     }
 
+    uint64_t GetTotalSize(HCache cache)
+    {
+        dmMutex::ScopedLock lock(cache->m_Mutex);
+        return cache->m_TotalSize;
+    }
+
     struct IterateContext
     {
         IterateContext(HCache cache, void* context, void (*callback)(void* context, const EntryInfo* entry_info))
@@ -30,6 +30,11 @@ namespace dmHttpCache
      */
     typedef struct CacheCreator* HCacheCreator;
 
+    /**
+     * HTTP-cache reader handle. Handle to read the content of a cache entry, see Get.
+     */
+    typedef struct CacheReader* HCacheReader;
+
     enum Result
     {
         RESULT_OK = 0,
@@ -96,6 +101,11 @@ namespace dmHttpCache
         /// Default value is 60 * 60 * 24 * 5, ie 5 days
         uint64_t    m_MaxCacheEntryAge;
 
+        /// Maximum total size of the cached content in bytes. The least recently
+        /// used entries are evicted when the limit is exceeded. 0 means unlimited.
+        /// Default value is 128MB
+        uint64_t    m_MaxCacheSize;
+
         NewParams()
         {
             SetDefaultParams(this);
@@ -118,7 +128,9 @@ namespace dmHttpCache
     Result Close(HCache cache);
 
     /**
-     * Flush index to disk. Flush will only write to disk when the index is dirty.
+     * Flush index to disk. Changes to the entries are journaled as they're made, so this
+     * only appends the access times of entries read since the last flush. The journal
+     * and the pack files for small entries are compacted when they contain too much garbage.
      * @param cache http cache handle
      * @return RESULT_OK on success
      */
@@ -173,15 +185,31 @@ namespace dmHttpCache
     Result GetInfo(HCache cache, const char* uri, EntryInfo* info);
 
     /**
-     * Get file for cache entry
+     * Get reader for cache entry
      * @param cache cache
      * @param uri uri
      * @param etag etag
-     * @param file file representing the cached content
+     * @param reader reader for the cached content (out)
      * @param checksum content checksum (dmHashString64)
      * @return RESULT_OK on success.
      */
-    Result Get(HCache cache, const char* uri, const char* etag, FILE** file, uint64_t* checksum);
+    Result Get(HCache cache, const char* uri, const char* etag, HCacheReader* reader, uint64_t* checksum);
+
+    /**
+     * Read cached content
+     * @param reader reader, see Get
+     * @param buffer buffer to read to
+     * @param buffer_len size of buffer
+     * @return number of bytes read. 0 when all content is read
+     */
+    uint32_t Read(HCacheReader reader, void* buffer, uint32_t buffer_len);
+
+    /**
+     * Get size of the cached content
+     * @param reader reader, see Get
+     * @return content size in bytes
+     */
+    uint32_t GetContentSize(HCacheReader reader);
 
     /**
      * Set cache entry to verifed
@@ -197,10 +225,10 @@ namespace dmHttpCache
      * @param cache
      * @param uri uri
      * @param etag etag
-     * @param file file representing the cached content
+     * @param reader reader returned by Get
      * @return RESULT_OK on success.
      */
-    Result Release(HCache cache, const char* uri, const char* etag, FILE* file);
+    Result Release(HCache cache, const char* uri, const char* etag, HCacheReader reader);
 
     /**
      * Get total entry count in cache
@@ -209,6 +237,13 @@ namespace dmHttpCache
      */
     uint32_t GetEntryCount(HCache cache);
 
+    /**
+     * Get total size of the cached content
+     * @param cache http cache handle
+     * @return size in bytes
+     */
+    uint64_t GetTotalSize(HCache cache);
+
     /**
      * Set consistency policy
      * @param cache cache
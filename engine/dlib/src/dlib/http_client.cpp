@@ -776,21 +776,21 @@ bail:
             }
         }
 
-        FILE* file = 0;
+        dmHttpCache::HCacheReader reader = 0;
         uint64_t checksum;
-        cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_URI, cache_etag, &file, &checksum);
+        cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_URI, cache_etag, &reader, &checksum);
         if (cache_result == dmHttpCache::RESULT_OK)
         {
             // NOTE: We have an extra byte for null-termination so no buffer overrun here.
-            size_t nread;
+            uint32_t nread;
             do
             {
-                nread = fread(client->m_Buffer, 1, BUFFER_SIZE, file);
+                nread = dmHttpCache::Read(reader, client->m_Buffer, BUFFER_SIZE);
                 client->m_Buffer[nread] = '\0';
                 client->m_HttpContent(response, client->m_Userdata, response->m_Status, client->m_Buffer, nread);
             }
             while (nread > 0);
-            dmHttpCache::Release(client->m_HttpCache, client->m_URI, cache_etag, file);
+            dmHttpCache::Release(client->m_HttpCache, client->m_URI, cache_etag, reader);
         }
         else
         {
@@ -1056,22 +1056,22 @@ bail:
         Response response(client);
         client->m_Statistics.m_DirectFromCache++;
 
-        FILE* file = 0;
+        dmHttpCache::HCacheReader reader = 0;
         uint64_t checksum;
 
-        dmHttpCache::Result cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_URI, info->m_ETag, &file, &checksum);
+        dmHttpCache::Result cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_URI, info->m_ETag, &reader, &checksum);
         if (cache_result == dmHttpCache::RESULT_OK)
         {
             // NOTE: We have an extra byte for null-termination so no buffer overrun here.
-            size_t nread;
+            uint32_t nread;
             do
             {
-                nread = fread(client->m_Buffer, 1, BUFFER_SIZE, file);
+                nread = dmHttpCache::Read(reader, client->m_Buffer, BUFFER_SIZE);
                 client->m_Buffer[nread] = '\0';
                 client->m_HttpContent(&response, client->m_Userdata, 304, client->m_Buffer, nread);
             }
             while (nread > 0);
-            dmHttpCache::Release(client->m_HttpCache, client->m_URI, info->m_ETag, file);
+            dmHttpCache::Release(client->m_HttpCache, client->m_URI, info->m_ETag, reader);
             return RESULT_NOT_200_OK;
         }
         else
@@ -14,6 +14,8 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include "atomic.h"
@@ -24,7 +26,6 @@
 #include "profile/profile.h"
 #include "socket.h"
 #include "spinlock.h"
-#include "message.h"
 #include "thread.h"
 #include "math.h"
 #include "time.h"
@@ -32,6 +33,12 @@
 #include "sys.h"
 #include "network_constants.h"
 
+#if defined(_WIN32)
+#include "safe_windows.h"
+#else
+#include <pthread.h>
+#endif
+
 #ifdef ANDROID
 #include <android/log.h>
 #endif
@@ -59,20 +66,17 @@ static const uint32_t DLIB_MAX_LOG_CONNECTIONS = 16;
 
 struct dmLogServer
 {
-    dmLogServer(dmSocket::Socket server_socket, uint16_t port,
-                 dmMessage::HSocket message_socket)
+    dmLogServer(dmSocket::Socket server_socket, uint16_t port)
     {
         m_Connections.SetCapacity(DLIB_MAX_LOG_CONNECTIONS);
         m_ServerSocket = server_socket;
         m_Port = port;
-        m_MessageSocket = message_socket;
         m_Thread = 0;
     }
 
     dmArray<dmLogConnection> m_Connections;
     dmSocket::Socket         m_ServerSocket;
     uint16_t                 m_Port;
-    dmMessage::HSocket       m_MessageSocket;
     dmThread::Thread         m_Thread;
 };
 
@@ -335,21 +339,10 @@ static void DoLogSynchronized(LogSeverity severity, const char* domain, const ch
     dmProfile::LogText("%s", output);
 }
 
-static void dmLogDispatch(dmMessage::Message *message, void* user_ptr)
+static void SendToConnections(const char* output, int output_len)
 {
     dmLogServer* server = g_dmLogServer;
 
-    bool* run = (bool*) user_ptr;
-    LogMessage* log_message = (LogMessage*) &message->m_Data[0];
-    if (log_message->m_Type == LogMessage::SHUTDOWN)
-    {
-        *run = false;
-        return;
-    }
-
-    int msg_len = (int) strlen(log_message->m_Message);
-    DoLogSynchronized((LogSeverity)log_message->m_Severity, log_message->m_Domain, log_message->m_Message, msg_len);
-
     // NOTE: Keep i as signed! See --i below after EraseSwap
     int n = 0;
     {
@@ -376,7 +369,7 @@ static void dmLogDispatch(dmMessage::Message *message, void* user_ptr)
         int total_sent = 0;
         do
         {
-            r = dmSocket::Send(socket, log_message->m_Message + total_sent, msg_len - total_sent, &sent_bytes);
+            r = dmSocket::Send(socket, output + total_sent, output_len - total_sent, &sent_bytes);
             if (r == dmSocket::RESULT_OK)
             {
                 total_sent += sent_bytes;
@@ -402,23 +395,741 @@ static void dmLogDispatch(dmMessage::Message *message, void* user_ptr)
                 --i;
                 break;
             }
-        } while (total_sent < msg_len);
+        } while (total_sent < output_len);
     }
 }
 
-static void dmLogThread(void* args)
+static const char* GetSeverityString(LogSeverity severity)
 {
-    dmLogServer* server = g_dmLogServer;
+    switch (severity)
+    {
+        case LOG_SEVERITY_DEBUG:        return "DEBUG";
+        case LOG_SEVERITY_USER_DEBUG:   return "DEBUG";
+        case LOG_SEVERITY_INFO:         return "INFO";
+        case LOG_SEVERITY_WARNING:      return "WARNING";
+        case LOG_SEVERITY_ERROR:        return "ERROR";
+        case LOG_SEVERITY_FATAL:        return "FATAL";
+        default:
+            assert(0);
+            return "";
+    }
+}
+
+// Writes the "SEVERITY:DOMAIN: " prefix of a log line, returns the number of characters
+static int BeginLogLine(char* str_buf, LogSeverity severity, const char* domain)
+{
+    return dmSnPrintf(str_buf, MAX_STRING_SIZE, "%s:%s: ", GetSeverityString(severity), domain);
+}
+
+// Terminates the log line, given that n characters were (or would have been) written. Returns the actual length
+static int EndLogLine(char* str_buf, int n)
+{
+    if (n < (int)MAX_STRING_SIZE)
+    {
+        n += dmSnPrintf(str_buf + n, MAX_STRING_SIZE - n, "\n");
+    }
+
+    if (n >= (int)MAX_STRING_SIZE)
+    {
+        strcpy(&str_buf[MAX_STRING_SIZE - (strlen(LOG_OUTPUT_TRUNCATED_MESSAGE) + 1)], LOG_OUTPUT_TRUNCATED_MESSAGE);
+    }
+
+    str_buf[MAX_STRING_SIZE-1] = '\0';
+    return dmMath::Min(n, (int)(MAX_STRING_SIZE-1));
+}
+
+static int FormatLogLine(char* str_buf, LogSeverity severity, const char* domain, const char* format, va_list lst)
+{
+    int n = BeginLogLine(str_buf, severity, domain);
+    if (n < (int)MAX_STRING_SIZE)
+    {
+        n += vsnprintf(str_buf + n, MAX_STRING_SIZE - n, format, lst);
+    }
+    return EndLogLine(str_buf, n);
+}
+
+/*
+ * Deferred formatting
+ *
+ * A log call only copies the format string and its arguments into a ring buffer owned by the
+ * calling thread. The log thread formats the message and outputs it to the platform log, the
+ * log file, the listeners and the connected sockets. String arguments are copied, since they
+ * may not outlive the call. Formats that can't be replayed (e.g. %n or wide strings) are
+ * formatted on the calling thread instead.
+ *
+ * Errors are formatted and output to the platform log on the calling thread, so that they aren't
+ * lost if the process crashes. Before that, the caller waits for the log thread to output the earlier
+ * platform messages of the same thread, to keep them in order.
+ *
+ * Each ring has a single producer (its thread) and a single consumer (the log thread), and
+ * only needs atomic counters. When a thread exits, its ring is handed to the next thread that
+ * logs. Threads beyond MAX_LOG_RINGS at the same time share one ring, guarded by a spinlock.
+ * When a ring is full, the message is dropped and counted, rather than making the caller wait.
+ */
+
+static const uint32_t LOG_RING_SIZE = 64 * 1024; // Must be a power of two
+static const uint32_t MAX_LOG_RINGS = 32;
+static const uint32_t MAX_LOG_RECORD_SIZE = MAX_STRING_SIZE + 512;
+// The log thread sleeps in slices while idle, so that producers can wake it up when their ring is filling up
+static const uint32_t LOG_THREAD_IDLE_SLICE = 4000;
+static const uint32_t LOG_THREAD_IDLE_SLICES = 8;
+// How long an error waits for the earlier platform output of its thread
+static const uint32_t LOG_PLATFORM_WAIT_SLICE = 1000;
+static const uint32_t LOG_PLATFORM_WAIT_SLICES = 100;
+static const uint32_t MAX_FORMAT_SPEC_SIZE = 32;
+
+enum LogRecordType
+{
+    LOG_RECORD_DEFERRED  = 0, // The format string followed by the packed arguments
+    LOG_RECORD_FORMATTED = 1, // A formatted log line
+    LOG_RECORD_WRAP      = 2, // Padding up to the end of the ring
+};
+
+struct LogRecord
+{
+    uint32_t    m_Size;         // Total size, including the header. Multiple of 8
+    uint8_t     m_Type;
+    uint8_t     m_Severity;
+    uint8_t     m_Platform;     // If the log thread should output to the platform log
+    uint8_t     m_Pad;
+    uint32_t    m_TextSize;     // Size of the format string or log line, including the null terminator
+    char        m_Domain[20];
+};
+
+struct LogRing
+{
+    uint8_t                 m_Buffer[LOG_RING_SIZE];
+    int32_atomic_t          m_Write;    // Only advanced by the producer
+    int32_atomic_t          m_Read;     // Only advanced by the consumer
+    int32_atomic_t          m_Dropped;
+    int32_atomic_t          m_PlatformEnd;  // The write position after the last record with platform output
+    bool                    m_Shared;
+    bool                    m_InUse;        // If a thread owns the ring. Guarded by LogRings::m_Lock
+    dmSpinlock::Spinlock    m_ProducerLock; // Only used by the shared ring
+};
+
+static void ReleaseThreadLogRing(void* ring);
+
+// Unlike dmThread::AllocTls(), the key releases the ring of a thread when it exits
+#if defined(_WIN32)
+typedef DWORD LogRingKey;
+
+static void WINAPI ReleaseThreadLogRingCallback(void* ring)
+{
+    if (ring)
+        ReleaseThreadLogRing(ring);
+}
+
+static LogRingKey NewLogRingKey()                           { return FlsAlloc(ReleaseThreadLogRingCallback); }
+static void* GetLogRingKeyValue(LogRingKey key)             { return FlsGetValue(key); }
+static void SetLogRingKeyValue(LogRingKey key, void* ring)  { FlsSetValue(key, ring); }
+#else
+typedef pthread_key_t LogRingKey;
+
+static LogRingKey NewLogRingKey()
+{
+    pthread_key_t key;
+    int ret = pthread_key_create(&key, ReleaseThreadLogRing);
+    assert(ret == 0);
+    (void)ret;
+    return key;
+}
+
+static void* GetLogRingKeyValue(LogRingKey key)             { return pthread_getspecific(key); }
+static void SetLogRingKeyValue(LogRingKey key, void* ring)  { pthread_setspecific(key, ring); }
+#endif
+
+struct LogRings
+{
+    LogRings()
+    {
+        m_RingKey = NewLogRingKey();
+        dmSpinlock::Create(&m_Lock);
+        memset(m_Rings, 0, sizeof(m_Rings));
+        m_RingCount = 0;
+        m_SharedRing = 0;
+    }
+
+    LogRingKey              m_RingKey;
+    dmSpinlock::Spinlock    m_Lock;
+    // The rings live until the process exits, since threads may hold on to them at any time
+    LogRing*                m_Rings[MAX_LOG_RINGS];
+    int32_atomic_t          m_RingCount;
+    LogRing*                m_SharedRing;
+};
+
+static int32_atomic_t   g_LogThreadRunning = 0;
+static int32_atomic_t   g_LogThreadRun = 0;
+static dmThread::Thread g_LogThread = 0; // Kept outside of the server, so that it's safe to read while finalizing
+static int32_atomic_t   g_DroppedMessages = 0;
+static int32_atomic_t   g_LogThreadWakeup = 0;
+
+static LogRings& GetLogRings()
+{
+    static LogRings rings;
+    return rings;
+}
+
+static LogRing* NewLogRing(bool shared)
+{
+    LogRing* ring = (LogRing*) malloc(sizeof(LogRing));
+    memset(ring, 0, sizeof(LogRing));
+    ring->m_Shared = shared;
+    if (shared)
+        dmSpinlock::Create(&ring->m_ProducerLock);
+    return ring;
+}
+
+static LogRing* GetThreadLogRing()
+{
+    LogRings& rings = GetLogRings();
+    LogRing* ring = (LogRing*) GetLogRingKeyValue(rings.m_RingKey);
+    if (ring)
+        return ring;
+
+    DM_SPINLOCK_SCOPED_LOCK(rings.m_Lock);
+    // Reuse the ring of a thread that has exited. The log thread may still be reading from it,
+    // but there is only ever one thread writing to it
+    uint32_t count = (uint32_t)dmAtomicGet32(&rings.m_RingCount);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!rings.m_Rings[i]->m_InUse)
+        {
+            ring = rings.m_Rings[i];
+            break;
+        }
+    }
+
+    if (ring)
+    {
+        ring->m_InUse = true;
+    }
+    else if (count < MAX_LOG_RINGS)
+    {
+        ring = NewLogRing(false);
+        ring->m_InUse = true;
+        rings.m_Rings[count] = ring;
+        // Publish the ring to the log thread once it is set up
+        dmAtomicAdd32(&rings.m_RingCount, 1);
+    }
+    else
+    {
+        if (!rings.m_SharedRing)
+            rings.m_SharedRing = NewLogRing(true);
+        ring = rings.m_SharedRing;
+    }
+    SetLogRingKeyValue(rings.m_RingKey, ring);
+    return ring;
+}
+
+// Called when a thread that has logged exits
+static void ReleaseThreadLogRing(void* _ring)
+{
+    LogRing* ring = (LogRing*)_ring;
+    if (ring->m_Shared)
+        return;
+
+    LogRings& rings = GetLogRings();
+    DM_SPINLOCK_SCOPED_LOCK(rings.m_Lock);
+    ring->m_InUse = false;
+}
+
+static inline uint32_t AlignRecordSize(uint32_t size)
+{
+    return (size + 7) & ~7U;
+}
+
+enum FormatArgType
+{
+    FORMAT_ARG_NONE,        // %%
+    FORMAT_ARG_INT,
+    FORMAT_ARG_LONG,
+    FORMAT_ARG_LONG_LONG,
+    FORMAT_ARG_SIZE,
+    FORMAT_ARG_INTMAX,
+    FORMAT_ARG_PTRDIFF,
+    FORMAT_ARG_DOUBLE,
+    FORMAT_ARG_LONG_DOUBLE,
+    FORMAT_ARG_STRING,
+    FORMAT_ARG_POINTER,
+};
+
+struct FormatSpec
+{
+    uint32_t    m_Length;       // Length of the spec, including the '%'
+    int         m_Precision;    // A precision written in the format string, or -1
+    uint8_t     m_Type;
+    uint8_t     m_StarWidth : 1;
+    uint8_t     m_StarPrecision : 1;
+};
+
+// Parses the conversion spec at 'p' (which points to a '%'). Returns false if it can't be deferred
+static bool ParseFormatSpec(const char* p, FormatSpec* spec)
+{
+    const char* q = p + 1;
+    spec->m_Precision = -1;
+    spec->m_StarWidth = 0;
+    spec->m_StarPrecision = 0;
+
+    while (*q && strchr("-+ #0", *q))
+        ++q;
+
+    if (*q == '*')
+    {
+        spec->m_StarWidth = 1;
+        ++q;
+    }
+    else
+    {
+        while (*q >= '0' && *q <= '9')
+            ++q;
+    }
+
+    if (*q == '.')
+    {
+        ++q;
+        if (*q == '*')
+        {
+            spec->m_StarPrecision = 1;
+            ++q;
+        }
+        else
+        {
+            spec->m_Precision = 0;
+            while (*q >= '0' && *q <= '9')
+                spec->m_Precision = spec->m_Precision * 10 + (*q++ - '0');
+        }
+    }
+
+    // Length modifier
+    char length = 0;
+    if (q[0] == 'h' && q[1] == 'h')         { length = 'H'; q += 2; }
+    else if (q[0] == 'l' && q[1] == 'l')    { length = 'q'; q += 2; }
+    else if (*q && strchr("hlLqzjt", *q))   { length = *q++; }
+
+    char conversion = *q++;
+    switch (conversion)
+    {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+            switch (length)
+            {
+                case 0: case 'h': case 'H': spec->m_Type = FORMAT_ARG_INT; break;
+                case 'l':                   spec->m_Type = FORMAT_ARG_LONG; break;
+                case 'q':                   spec->m_Type = FORMAT_ARG_LONG_LONG; break;
+                case 'z':                   spec->m_Type = FORMAT_ARG_SIZE; break;
+                case 'j':                   spec->m_Type = FORMAT_ARG_INTMAX; break;
+                case 't':                   spec->m_Type = FORMAT_ARG_PTRDIFF; break;
+                default:                    return false;
+            }
+            if (conversion == 'c' && length != 0)
+                return false; // wint_t
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if (length != 0 && length != 'l' && length != 'L')
+                return false;
+            spec->m_Type = length == 'L' ? FORMAT_ARG_LONG_DOUBLE : FORMAT_ARG_DOUBLE;
+            break;
+        case 's':
+            if (length != 0)
+                return false; // wchar_t*
+            spec->m_Type = FORMAT_ARG_STRING;
+            break;
+        case 'p':
+            spec->m_Type = FORMAT_ARG_POINTER;
+            break;
+        case '%':
+            spec->m_Type = FORMAT_ARG_NONE;
+            break;
+        default:
+            return false; // %n, platform specific modifiers or a broken format
+    }
+
+    spec->m_Length = (uint32_t)(q - p);
+    return spec->m_Length < MAX_FORMAT_SPEC_SIZE;
+}
+
+// Packs the format string and the arguments into the record. Returns false if the format can't be deferred
+static bool PackLogRecord(LogRecord* record, uint32_t capacity, const char* format, va_list lst)
+{
+    uint8_t* buffer = (uint8_t*) record;
+    uint32_t format_size = (uint32_t)strlen(format) + 1;
+    uint32_t offset = AlignRecordSize(sizeof(LogRecord) + format_size);
+    if (offset > capacity)
+        return false;
+    memcpy(buffer + sizeof(LogRecord), format, format_size);
+    record->m_Type = LOG_RECORD_DEFERRED;
+    record->m_TextSize = format_size;
+
+    for (const char* p = format; *p; ++p)
+    {
+        if (*p != '%')
+            continue;
+
+        FormatSpec spec;
+        if (!ParseFormatSpec(p, &spec))
+            return false;
+        p += spec.m_Length - 1;
+
+        // The star arguments and the value are stored in 8 byte slots, strings are stored inline
+        if (offset + 3 * 8 + sizeof(long double) > capacity)
+            return false;
+
+        int precision = spec.m_Precision;
+        if (spec.m_StarWidth)
+        {
+            int64_t width = va_arg(lst, int);
+            memcpy(buffer + offset, &width, 8);
+            offset += 8;
+        }
+        if (spec.m_StarPrecision)
+        {
+            int64_t star_precision = va_arg(lst, int);
+            memcpy(buffer + offset, &star_precision, 8);
+            offset += 8;
+            precision = (int)star_precision;
+        }
+
+        uint64_t value = 0;
+        switch (spec.m_Type)
+        {
+            case FORMAT_ARG_NONE:       continue;
+            case FORMAT_ARG_INT:        value = (uint64_t)va_arg(lst, int); break;
+            case FORMAT_ARG_LONG:       value = (uint64_t)va_arg(lst, long); break;
+            case FORMAT_ARG_LONG_LONG:  value = (uint64_t)va_arg(lst, long long); break;
+            case FORMAT_ARG_SIZE:       value = (uint64_t)va_arg(lst, size_t); break;
+            case FORMAT_ARG_INTMAX:     value = (uint64_t)va_arg(lst, intmax_t); break;
+            case FORMAT_ARG_PTRDIFF:    value = (uint64_t)va_arg(lst, ptrdiff_t); break;
+            case FORMAT_ARG_POINTER:    value = (uint64_t)(uintptr_t)va_arg(lst, void*); break;
+            case FORMAT_ARG_DOUBLE:
+                {
+                    double d = va_arg(lst, double);
+                    memcpy(&value, &d, 8);
+                }
+                break;
+            case FORMAT_ARG_LONG_DOUBLE:
+                {
+                    long double d = va_arg(lst, long double);
+                    memcpy(buffer + offset, &d, sizeof(d));
+                    offset += AlignRecordSize(sizeof(d));
+                }
+                continue;
+            case FORMAT_ARG_STRING:
+                {
+                    const char* s = va_arg(lst, const char*);
+                    if (!s)
+                        s = "(null)";
+                    // Only read as far as the precision allows, the string may not be null terminated
+                    uint32_t max_length = precision >= 0 ? dmMath::Min((uint32_t)precision, MAX_STRING_SIZE) : MAX_STRING_SIZE;
+                    uint32_t length = 0;
+                    while (length < max_length && s[length])
+                        ++length;
+                    if (offset + AlignRecordSize(4 + length + 1) > capacity)
+                        return false;
+                    memcpy(buffer + offset, &length, 4);
+                    memcpy(buffer + offset + 4, s, length);
+                    buffer[offset + 4 + length] = 0;
+                    offset += AlignRecordSize(4 + length + 1);
+                }
+                continue;
+        }
+        memcpy(buffer + offset, &value, 8);
+        offset += 8;
+    }
+
+    record->m_Size = offset;
+    return true;
+}
+
+template <typename T>
+static int FormatLogArg(char* out, uint32_t size, const char* spec_format, const FormatSpec& spec, int width, int precision, T value)
+{
+    if (spec.m_StarWidth && spec.m_StarPrecision)
+        return snprintf(out, size, spec_format, width, precision, value);
+    else if (spec.m_StarWidth)
+        return snprintf(out, size, spec_format, width, value);
+    else if (spec.m_StarPrecision)
+        return snprintf(out, size, spec_format, precision, value);
+    return snprintf(out, size, spec_format, value);
+}
+
+// Formats a deferred record. Returns the number of characters written, or a number >= size if it was truncated
+static int FormatLogRecord(char* out, uint32_t size, const LogRecord* record)
+{
+    const uint8_t* buffer = (const uint8_t*) record;
+    const char* format = (const char*) (buffer + sizeof(LogRecord));
+    uint32_t offset = AlignRecordSize(sizeof(LogRecord) + record->m_TextSize);
 
-    volatile bool run = true;
-    while (run)
+    uint32_t n = 0;
+    const char* p = format;
+    while (*p && n < size)
     {
-        // NOTE: We have support for blocking dispatch in dmMessage
-        // but we have to wait for both new messages and on sockets.
-        // Currently no support for that and hence the sleep here
-        dmTime::Sleep(1000 * 30);
+        if (*p != '%')
+        {
+            out[n++] = *p++;
+            continue;
+        }
+
+        FormatSpec spec;
+        bool ok = ParseFormatSpec(p, &spec);
+        assert(ok); // It was parsed when the record was packed
+        (void)ok;
+
+        char spec_format[MAX_FORMAT_SPEC_SIZE];
+        memcpy(spec_format, p, spec.m_Length);
+        spec_format[spec.m_Length] = 0;
+        p += spec.m_Length;
+
+        int width = 0;
+        int precision = 0;
+        int64_t star;
+        if (spec.m_StarWidth)
+        {
+            memcpy(&star, buffer + offset, 8);
+            offset += 8;
+            width = (int)star;
+        }
+        if (spec.m_StarPrecision)
+        {
+            memcpy(&star, buffer + offset, 8);
+            offset += 8;
+            precision = (int)star;
+        }
+
+        int written = 0;
+        uint64_t value = 0;
+        switch (spec.m_Type)
+        {
+            case FORMAT_ARG_NONE:
+                out[n] = '%';
+                written = 1;
+                break;
+            case FORMAT_ARG_LONG_DOUBLE:
+                {
+                    long double d;
+                    memcpy(&d, buffer + offset, sizeof(d));
+                    offset += AlignRecordSize(sizeof(d));
+                    written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, d);
+                }
+                break;
+            case FORMAT_ARG_STRING:
+                {
+                    uint32_t length;
+                    memcpy(&length, buffer + offset, 4);
+                    const char* s = (const char*) (buffer + offset + 4);
+                    offset += AlignRecordSize(4 + length + 1);
+                    written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, s);
+                }
+                break;
+            default:
+                memcpy(&value, buffer + offset, 8);
+                offset += 8;
+                switch (spec.m_Type)
+                {
+                    case FORMAT_ARG_INT:        written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (int)value); break;
+                    case FORMAT_ARG_LONG:       written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (long)value); break;
+                    case FORMAT_ARG_LONG_LONG:  written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (long long)value); break;
+                    case FORMAT_ARG_SIZE:       written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (size_t)value); break;
+                    case FORMAT_ARG_INTMAX:     written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (intmax_t)value); break;
+                    case FORMAT_ARG_PTRDIFF:    written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (ptrdiff_t)value); break;
+                    case FORMAT_ARG_POINTER:    written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, (void*)(uintptr_t)value); break;
+                    case FORMAT_ARG_DOUBLE:
+                        {
+                            double d;
+                            memcpy(&d, &value, 8);
+                            written = FormatLogArg(out + n, size - n, spec_format, spec, width, precision, d);
+                        }
+                        break;
+                }
+                break;
+        }
+
+        if (written < 0)
+            written = 0;
+        n += (uint32_t)written;
+    }
+
+    if (n < size)
+        out[n] = 0;
+    else
+        out[size-1] = 0;
+    return (int)n;
+}
+
+// Copies a record into the ring. Returns false if there wasn't room for it
+static bool WriteLogRecord(LogRing* ring, const LogRecord* record)
+{
+    uint32_t write = (uint32_t)dmAtomicGet32(&ring->m_Write);
+    uint32_t read = (uint32_t)dmAtomicGet32(&ring->m_Read);
+    uint32_t pos = write & (LOG_RING_SIZE - 1);
+    uint32_t size = record->m_Size;
+
+    // Records are contiguous, so pad up to the end of the ring if it doesn't fit there
+    uint32_t padding = LOG_RING_SIZE - pos < size ? LOG_RING_SIZE - pos : 0;
+    if (LOG_RING_SIZE - (write - read) < padding + size)
+        return false;
+
+    if (padding)
+    {
+        LogRecord* wrap = (LogRecord*) &ring->m_Buffer[pos];
+        wrap->m_Size = padding;
+        wrap->m_Type = LOG_RECORD_WRAP;
+        pos = 0;
+    }
+    memcpy(&ring->m_Buffer[pos], record, size);
+
+    // Publish the record. The atomic add is a full barrier, so the record is visible before the write position
+    dmAtomicAdd32(&ring->m_Write, (int32_t)(padding + size));
+    if (record->m_Platform)
+    {
+        dmAtomicStore32(&ring->m_PlatformEnd, (int32_t)(write + padding + size));
+    }
+
+    if (write + padding + size - read > LOG_RING_SIZE / 2)
+    {
+        dmAtomicStore32(&g_LogThreadWakeup, 1);
+    }
+    return true;
+}
+
+// The calling thread never waits for the log thread. If the ring is full, the message is dropped
+static void PushLogRecord(LogRecord* record)
+{
+    LogRing* ring = GetThreadLogRing();
+    bool written;
+    if (ring->m_Shared)
+    {
+        DM_SPINLOCK_SCOPED_LOCK(ring->m_ProducerLock);
+        written = WriteLogRecord(ring, record);
+    }
+    else
+    {
+        written = WriteLogRecord(ring, record);
+    }
+
+    if (!written)
+    {
+        dmAtomicIncrement32(&ring->m_Dropped);
+        dmAtomicStore32(&g_LogThreadWakeup, 1);
+    }
+}
+
+// Waits (for a limited time) until the log thread has output the platform records of the calling thread,
+// so that a message that is output directly doesn't come before them
+static void WaitForPlatformOutput()
+{
+    LogRing* ring = GetThreadLogRing();
+    uint32_t end = (uint32_t)dmAtomicGet32(&ring->m_PlatformEnd);
+    for (uint32_t i = 0; i < LOG_PLATFORM_WAIT_SLICES; ++i)
+    {
+        if ((int32_t)((uint32_t)dmAtomicGet32(&ring->m_Read) - end) >= 0 || !dmAtomicGet32(&g_LogThreadRun))
+            return;
+        dmAtomicStore32(&g_LogThreadWakeup, 1);
+        dmTime::Sleep(LOG_PLATFORM_WAIT_SLICE);
+    }
+}
+
+// Outputs a formatted log line from the log thread
+static void OutputLogLine(LogSeverity severity, const char* domain, const char* str_buf, int str_len, bool platform)
+{
+    if (platform)
+    {
+        DoLogPlatform(severity, str_buf, str_len);
+    }
+    DoLogSynchronized(severity, domain, str_buf, str_len);
+    SendToConnections(str_buf, str_len);
+}
+
+// Consumes the records of all rings. Must only be called from one thread at a time
+static uint32_t FlushLogRings()
+{
+    LogRings& rings = GetLogRings();
+    char str_buf[MAX_STRING_SIZE];
+    uint32_t consumed = 0;
+
+    uint32_t ring_count = (uint32_t)dmAtomicGet32(&rings.m_RingCount);
+    for (uint32_t r = 0; r <= ring_count; ++r)
+    {
+        LogRing* ring = r < ring_count ? rings.m_Rings[r] : rings.m_SharedRing;
+        if (!ring)
+            continue;
+
+        uint32_t read = (uint32_t)dmAtomicGet32(&ring->m_Read);
+        uint32_t write = (uint32_t)dmAtomicGet32(&ring->m_Write);
+        while (read != write)
+        {
+            const LogRecord* record = (const LogRecord*) &ring->m_Buffer[read & (LOG_RING_SIZE - 1)];
+            uint32_t size = record->m_Size;
+            if (record->m_Type != LOG_RECORD_WRAP)
+            {
+                LogSeverity severity = (LogSeverity)record->m_Severity;
+                int str_len;
+                if (record->m_Type == LOG_RECORD_FORMATTED)
+                {
+                    str_len = (int)record->m_TextSize - 1;
+                    memcpy(str_buf, ((const uint8_t*)record) + sizeof(LogRecord), record->m_TextSize);
+                }
+                else
+                {
+                    int n = BeginLogLine(str_buf, severity, record->m_Domain);
+                    if (n < (int)MAX_STRING_SIZE)
+                    {
+                        n += FormatLogRecord(str_buf + n, MAX_STRING_SIZE - n, record);
+                    }
+                    str_len = EndLogLine(str_buf, n);
+                }
+                OutputLogLine(severity, record->m_Domain, str_buf, str_len, record->m_Platform != 0);
+            }
+
+            read += size;
+            consumed += size;
+            // Hand the space back to the producer
+            dmAtomicAdd32(&ring->m_Read, (int32_t)size);
+        }
+
+        uint32_t dropped = (uint32_t)dmAtomicStore32(&ring->m_Dropped, 0);
+        if (dropped)
+        {
+            dmAtomicAdd32(&g_DroppedMessages, (int32_t)dropped);
+            int str_len = dmSnPrintf(str_buf, sizeof(str_buf), "WARNING:DLIB: %u log messages were dropped, the log buffer was full\n", dropped);
+            OutputLogLine(LOG_SEVERITY_WARNING, "DLIB", str_buf, str_len, dLib::IsDebugMode());
+        }
+    }
+    return consumed;
+}
+
+// Discards anything left in the rings, e.g. from threads that logged during shutdown
+static void ClearLogRings()
+{
+    LogRings& rings = GetLogRings();
+    uint32_t ring_count = (uint32_t)dmAtomicGet32(&rings.m_RingCount);
+    for (uint32_t r = 0; r <= ring_count; ++r)
+    {
+        LogRing* ring = r < ring_count ? rings.m_Rings[r] : rings.m_SharedRing;
+        if (!ring)
+            continue;
+        uint32_t read = (uint32_t)dmAtomicGet32(&ring->m_Read);
+        uint32_t write = (uint32_t)dmAtomicGet32(&ring->m_Write);
+        dmAtomicAdd32(&ring->m_Read, (int32_t)(write - read));
+        dmAtomicStore32(&ring->m_Dropped, 0);
+    }
+}
+
+static void dmLogThread(void* args)
+{
+    while (dmAtomicGet32(&g_LogThreadRun))
+    {
+        // NOTE: We have to wait for both new log records and on sockets.
+        // Currently no support for that and hence the sleep here.
+        // While records keep coming in, we don't sleep, to keep the rings from filling up
+        dmAtomicStore32(&g_LogThreadWakeup, 0);
+        uint32_t consumed = FlushLogRings();
         dmLogUpdateNetwork();
-        dmMessage::Dispatch(server->m_MessageSocket, dmLogDispatch, (void*) &run);
+        for (uint32_t i = 0; !consumed && i < LOG_THREAD_IDLE_SLICES; ++i)
+        {
+            if (dmAtomicGet32(&g_LogThreadWakeup) || !dmAtomicGet32(&g_LogThreadRun))
+                break;
+            dmTime::Sleep(LOG_THREAD_IDLE_SLICE);
+        }
     }
 }
 
@@ -447,34 +1158,25 @@ void LogInitialize(const LogParams* params)
         }
     }
 
-    dmMessage::HSocket message_socket = 0;
-    dmMessage::Result mr;
-
-    mr = dmMessage::NewSocket("@log", &message_socket);
-    if (mr != dmMessage::RESULT_OK)
-    {
-        fprintf(stderr, "ERROR:DLIB: Unable to create @log message socket\n");
-        if (message_socket != 0)
-            dmMessage::DeleteSocket(message_socket);
-        if (server_socket != dmSocket::INVALID_SOCKET_HANDLE)
-            dmSocket::Delete(server_socket);
-        return;
-    }
-
-    dmLogServer* server = new dmLogServer(server_socket, port, message_socket);
+    dmLogServer* server = new dmLogServer(server_socket, port);
     g_dmLogServer = server;
 
+    dmAtomicStore32(&g_ListenersCount, 0);
+    dmSpinlock::Create(&g_ListenerLock);
+
     server->m_Thread = 0;
     if(dLib::FeaturesSupported(DM_FEATURE_BIT_SOCKET_SERVER_TCP)) // e.g. Emscripten doesn't support it
     {
+        ClearLogRings();
+        dmAtomicStore32(&g_DroppedMessages, 0);
+        dmAtomicStore32(&g_LogThreadRun, 1);
         server->m_Thread = dmThread::New(dmLogThread, 0x80000, 0, "log");
+        g_LogThread = server->m_Thread;
+        dmAtomicStore32(&g_LogThreadRunning, 1);
     }
 
     dmAtomicStore32(&g_LogServerInitialized, 1);
 
-    dmAtomicStore32(&g_ListenersCount, 0);
-    dmSpinlock::Create(&g_ListenerLock);
-
     /*
      * This message is parsed by editor 2 - don't remove or change without
      * corresponding changes in engine.clj
@@ -500,19 +1202,17 @@ void LogFinalize()
 
     dmLogServer* self = g_dmLogServer;
 
-    LogMessage msg;
-    msg.m_Type = LogMessage::SHUTDOWN;
-    dmMessage::URL receiver;
-    receiver.m_Socket = self->m_MessageSocket;
-    receiver.m_Path = 0;
-    receiver.m_Fragment = 0;
-    dmMessage::Post(0, &receiver, 0, 0, 0, &msg, sizeof(msg), 0);
-
-    // Make sure we have control of the context
+    // Stop accepting new log records, and make sure we have control of the context
     dmAtomicStore32(&g_LogServerInitialized, 0);
+    dmAtomicStore32(&g_LogThreadRunning, 0);
+    dmAtomicStore32(&g_LogThreadRun, 0);
 
     if (self->m_Thread)
+    {
         dmThread::Join(self->m_Thread);
+        // The log thread is gone, so this thread is now the only consumer. Output what's left
+        FlushLogRings();
+    }
 
     {
         DM_SPINLOCK_SCOPED_LOCK(g_LogServerLock);
@@ -532,11 +1232,6 @@ void LogFinalize()
             self->m_ServerSocket = dmSocket::INVALID_SOCKET_HANDLE;
         }
 
-        if (self->m_MessageSocket != 0)
-        {
-            dmMessage::DeleteSocket(self->m_MessageSocket);
-        }
-
         delete self;
         g_dmLogServer = 0;
         CloseLogFile();
@@ -546,6 +1241,16 @@ void LogFinalize()
     dmSpinlock::Destroy(&g_LogServerLock);
 }
 
+uint32_t GetDroppedMessageCount()
+{
+    return (uint32_t)dmAtomicGet32(&g_DroppedMessages);
+}
+
+uint32_t GetLogRingCount()
+{
+    return (uint32_t)dmAtomicGet32(&GetLogRings().m_RingCount);
+}
+
 uint16_t GetPort()
 {
     if (!g_dmLogServer)
@@ -631,48 +1336,67 @@ void LogInternal(LogSeverity severity, const char* domain, const char* format, .
     va_list lst;
     va_start(lst, format);
 
-    const char* severity_str = 0;
-    switch (severity)
+    bool has_log_thread = dmAtomicGet32(&dmLog::g_LogThreadRunning) != 0;
+    // Errors are output to the platform directly, in case the process doesn't live long enough for the log thread to get to them
+    bool direct_platform = is_debug_mode && severity >= LOG_SEVERITY_ERROR;
+    bool deferred = has_log_thread && !direct_platform;
+    if (has_log_thread && dmThread::GetCurrentThread() == dmLog::g_LogThread)
     {
-        case LOG_SEVERITY_DEBUG:        severity_str = "DEBUG"; break;
-        case LOG_SEVERITY_USER_DEBUG:   severity_str = "DEBUG"; break;
-        case LOG_SEVERITY_INFO:         severity_str = "INFO"; break;
-        case LOG_SEVERITY_WARNING:      severity_str = "WARNING"; break;
-        case LOG_SEVERITY_ERROR:        severity_str = "ERROR"; break;
-        case LOG_SEVERITY_FATAL:        severity_str = "FATAL"; break;
-        default:
-            assert(0);
-            break;
+        // Due to the recursive nature, we're not allowed make new dmLogXxx calls from the log thread
+        // However, we may call the print functions
+        char str_buf[dmLog::MAX_STRING_SIZE];
+        int actual_n = dmLog::FormatLogLine(str_buf, severity, domain, format, lst);
+        va_end(lst);
+        if (is_debug_mode)
+        {
+            dmLog::DoLogPlatform(severity, str_buf, actual_n);
+        }
+        return;
     }
 
-    char tmp_buf[sizeof(dmLog::LogMessage) + dmLog::MAX_STRING_SIZE];
-    dmLog::LogMessage* msg = (dmLog::LogMessage*) &tmp_buf[0];
-    char* str_buf = &tmp_buf[sizeof(dmLog::LogMessage)];
+    uint64_t record_buf[dmLog::MAX_LOG_RECORD_SIZE / sizeof(uint64_t)];
+    dmLog::LogRecord* record = (dmLog::LogRecord*) record_buf;
+    record->m_Severity = (uint8_t)severity;
+    record->m_Platform = is_debug_mode ? 1 : 0;
+    record->m_Pad = 0;
+    dmStrlCpy(record->m_Domain, domain, sizeof(record->m_Domain));
 
-    int n = 0;
-    n += dmSnPrintf(str_buf + n, dmLog::MAX_STRING_SIZE - n, "%s:%s: ", severity_str, domain);
-    if (n < dmLog::MAX_STRING_SIZE)
+    if (deferred)
     {
-        n += vsnprintf(str_buf + n, dmLog::MAX_STRING_SIZE - n, format, lst);
-    }
+        va_list packed_lst;
+        va_copy(packed_lst, lst);
+        bool packed = dmLog::PackLogRecord(record, sizeof(record_buf), format, packed_lst);
+        va_end(packed_lst);
 
-    if (n < dmLog::MAX_STRING_SIZE)
-    {
-        n += dmSnPrintf(str_buf + n, dmLog::MAX_STRING_SIZE - n, "\n");
+        if (packed)
+        {
+            va_end(lst);
+            dmLog::PushLogRecord(record);
+            return;
+        }
     }
 
-    if (n >= dmLog::MAX_STRING_SIZE)
+    // The message couldn't be deferred, so it's formatted here
+    char* str_buf = (char*) (record + 1);
+    int actual_n = dmLog::FormatLogLine(str_buf, severity, domain, format, lst);
+    va_end(lst);
+
+    if (has_log_thread)
     {
-        strcpy(&str_buf[dmLog::MAX_STRING_SIZE - (strlen(dmLog::LOG_OUTPUT_TRUNCATED_MESSAGE) + 1)], dmLog::LOG_OUTPUT_TRUNCATED_MESSAGE);
+        if (direct_platform)
+        {
+            // The listeners are still called from the log thread
+            dmLog::WaitForPlatformOutput();
+            dmLog::DoLogPlatform(severity, str_buf, actual_n);
+            record->m_Platform = 0;
+        }
+        record->m_Type = dmLog::LOG_RECORD_FORMATTED;
+        record->m_TextSize = actual_n + 1;
+        record->m_Size = dmLog::AlignRecordSize(sizeof(dmLog::LogRecord) + record->m_TextSize);
+        dmLog::PushLogRecord(record);
+        return;
     }
 
-    str_buf[dmLog::MAX_STRING_SIZE-1] = '\0';
-    int actual_n = dmMath::Min(n, (int)(dmLog::MAX_STRING_SIZE-1));
-
-    va_end(lst);
-
-    // Could potentially be moved to the thread, but these are already thread safe, and
-    // I think it's good to output info directly to the native platform as soon as possible.
     if (is_debug_mode)
     {
         dmLog::DoLogPlatform(severity, str_buf, actual_n);
@@ -686,31 +1410,6 @@ void LogInternal(LogSeverity severity, const char* domain, const char* format, .
     if (!dmLog::IsServerInitialized())
         return; // The log system may have been shut down in between
 
-    dmLog::dmLogServer* server = dmLog::g_dmLogServer;
-    if (!server->m_Thread) // e.g. Emscripten
-    {
-        dmLog::DoLogSynchronized(severity, domain, str_buf, actual_n);
-    }
-
-    if(!dLib::FeaturesSupported(DM_FEATURE_BIT_SOCKET_SERVER_TCP)) // e.g. Emscripten
-        return;
-
-    if (dmThread::GetCurrentThread() == server->m_Thread)
-    {
-        // Due to the recursive nature, we're not allowed make new dmLogXxx calls from the dispatch thread
-        // However, we may call the print functions
-        return;
-    }
-
-    if (server)
-    {
-        msg->m_Type = dmLog::LogMessage::MESSAGE;
-        msg->m_Severity = severity;
-        dmStrlCpy(msg->m_Domain, domain, sizeof(msg->m_Domain));
-        dmMessage::URL receiver;
-        receiver.m_Socket = server->m_MessageSocket;
-        receiver.m_Path = 0;
-        receiver.m_Fragment = 0;
-        dmMessage::Post(0, &receiver, 0, 0, 0, msg, dmMath::Min(sizeof(dmLog::LogMessage) + actual_n + 1, sizeof(tmp_buf)), 0);
-    }
+    // No log thread (e.g. Emscripten), so the listeners are called from here
+    dmLog::DoLogSynchronized(severity, domain, str_buf, actual_n);
 }
@@ -78,6 +78,20 @@ void LogFinalize();
  */
 uint16_t GetPort();
 
+/**
+ * Get the number of log messages dropped since the log system was initialized.
+ * Messages are dropped when a thread logs faster than the log thread can output them.
+ * @return number of dropped messages
+ */
+uint32_t GetDroppedMessageCount();
+
+/**
+ * Get the number of per thread log buffers. The buffer of a thread is reused by other threads
+ * once it exits. Used by the unit tests.
+ * @return number of log buffers
+ */
+uint32_t GetLogRingCount();
+
 /**
  * Set log file. The file will be created and truncated.
  * Subsequent invocations to this function will close previous opened file.
@@ -14,7 +14,11 @@
 
 #include "memory.h"
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <dmsdk/dlib/atomic.h>
+#include <dmsdk/dlib/spinlock.h>
+#include "dstrings.h"
 #if defined(__ANDROID__) || defined(_MSC_VER)
 #include <malloc.h>
 #endif
@@ -66,4 +70,191 @@ namespace dmMemory
 #endif
     }
 
+    struct Tag
+    {
+        char            m_Name[MAX_TAG_NAME];
+        int32_atomic_t  m_LiveBytes;
+        int32_atomic_t  m_PeakBytes;
+        // The live count is derived from these, to keep the number of atomic operations down
+        int32_atomic_t  m_AllocCount;
+        int32_atomic_t  m_FreeCount;
+        uint32_t        m_SoftBudget;
+        uint32_t        m_HardBudget;
+    };
+
+    // The tags are never unregistered, so they can be read without taking the lock
+    static Tag              g_Tags[MAX_TAG_COUNT];
+    static int32_atomic_t   g_TagCount = 0;
+    static FBudgetCallback  g_BudgetCallback = 0;
+    static void*            g_BudgetCallbackCtx = 0;
+
+    // Header in front of blocks from dmMemory::Malloc, keeps the block 16 byte aligned
+    struct BlockHeader
+    {
+        uint32_t m_Tag;
+        uint32_t m_Size;
+        uint32_t m_Pad[2];
+    };
+
+    static dmSpinlock::Spinlock& GetTagLock()
+    {
+        struct Lock
+        {
+            Lock() { dmSpinlock::Create(&m_Lock); }
+            dmSpinlock::Spinlock m_Lock;
+        };
+        static Lock lock;
+        return lock.m_Lock;
+    }
+
+    static HTag FindTagUnlocked(const char* name, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (strncmp(g_Tags[i].m_Name, name, MAX_TAG_NAME-1) == 0)
+                return i;
+        }
+        return INVALID_TAG;
+    }
+
+    HTag RegisterTag(const char* name)
+    {
+        DM_SPINLOCK_SCOPED_LOCK(GetTagLock());
+        uint32_t count = (uint32_t)dmAtomicGet32(&g_TagCount);
+        HTag tag = FindTagUnlocked(name, count);
+        if (tag != INVALID_TAG)
+            return tag;
+        if (count == MAX_TAG_COUNT)
+            return INVALID_TAG;
+
+        Tag* t = &g_Tags[count];
+        memset(t, 0, sizeof(*t));
+        dmStrlCpy(t->m_Name, name, sizeof(t->m_Name));
+        // Publish the tag once it is set up
+        dmAtomicStore32(&g_TagCount, (int32_t)count + 1);
+        return count;
+    }
+
+    HTag FindTag(const char* name)
+    {
+        return FindTagUnlocked(name, (uint32_t)dmAtomicGet32(&g_TagCount));
+    }
+
+    uint32_t GetTagCount()
+    {
+        return (uint32_t)dmAtomicGet32(&g_TagCount);
+    }
+
+    bool GetTagStats(HTag tag, TagStats* stats)
+    {
+        if (tag >= GetTagCount())
+            return false;
+        Tag* t = &g_Tags[tag];
+        stats->m_Name       = t->m_Name;
+        stats->m_LiveBytes  = (uint32_t)dmAtomicGet32(&t->m_LiveBytes);
+        stats->m_PeakBytes  = (uint32_t)dmAtomicGet32(&t->m_PeakBytes);
+        uint32_t freed      = (uint32_t)dmAtomicGet32(&t->m_FreeCount);
+        stats->m_TotalCount = (uint32_t)dmAtomicGet32(&t->m_AllocCount);
+        stats->m_LiveCount  = stats->m_TotalCount - freed;
+        stats->m_SoftBudget = t->m_SoftBudget;
+        stats->m_HardBudget = t->m_HardBudget;
+        return true;
+    }
+
+    void SetTagBudget(HTag tag, uint32_t soft_budget, uint32_t hard_budget)
+    {
+        if (tag >= GetTagCount())
+            return;
+        g_Tags[tag].m_SoftBudget = soft_budget;
+        g_Tags[tag].m_HardBudget = hard_budget;
+    }
+
+    void SetBudgetCallback(FBudgetCallback callback, void* user_ctx)
+    {
+        DM_SPINLOCK_SCOPED_LOCK(GetTagLock());
+        g_BudgetCallback = callback;
+        g_BudgetCallbackCtx = user_ctx;
+    }
+
+    static void CheckBudget(HTag tag, uint32_t budget, BudgetLevel level, uint32_t prev, uint32_t live)
+    {
+        // Only report when the budget is crossed, not on every allocation above it
+        if (budget == 0 || prev >= budget || live < budget)
+            return;
+
+        FBudgetCallback callback = g_BudgetCallback;
+        if (!callback)
+            return;
+        TagStats stats;
+        GetTagStats(tag, &stats);
+        callback(g_BudgetCallbackCtx, tag, level, &stats);
+    }
+
+    static void AddLiveBytes(HTag tag, Tag* t, uint32_t size)
+    {
+        uint32_t prev = (uint32_t)dmAtomicAdd32(&t->m_LiveBytes, (int32_t)size);
+        uint32_t live = prev + size;
+
+        // A plain read is enough here, the compare-and-swap below catches any race
+        int32_t peak = *(volatile int32_t*)&t->m_PeakBytes;
+        while ((uint32_t)peak < live)
+        {
+            int32_t old = dmAtomicCompareStore32(&t->m_PeakBytes, (int32_t)live, peak);
+            if (old == peak)
+                break;
+            peak = old;
+        }
+
+        CheckBudget(tag, t->m_SoftBudget, BUDGET_LEVEL_SOFT, prev, live);
+        CheckBudget(tag, t->m_HardBudget, BUDGET_LEVEL_HARD, prev, live);
+    }
+
+    void TrackAlloc(HTag tag, uint32_t size)
+    {
+        if (tag >= MAX_TAG_COUNT)
+            return;
+        Tag* t = &g_Tags[tag];
+        dmAtomicIncrement32(&t->m_AllocCount);
+        AddLiveBytes(tag, t, size);
+    }
+
+    void TrackFree(HTag tag, uint32_t size)
+    {
+        if (tag >= MAX_TAG_COUNT)
+            return;
+        Tag* t = &g_Tags[tag];
+        dmAtomicIncrement32(&t->m_FreeCount);
+        dmAtomicSub32(&t->m_LiveBytes, (int32_t)size);
+    }
+
+    void TrackRealloc(HTag tag, uint32_t old_size, uint32_t new_size)
+    {
+        if (tag >= MAX_TAG_COUNT)
+            return;
+        Tag* t = &g_Tags[tag];
+        if (new_size > old_size)
+            AddLiveBytes(tag, t, new_size - old_size);
+        else
+            dmAtomicSub32(&t->m_LiveBytes, (int32_t)(old_size - new_size));
+    }
+
+    void* Malloc(HTag tag, uint32_t size)
+    {
+        BlockHeader* header = (BlockHeader*)malloc(sizeof(BlockHeader) + size);
+        if (!header)
+            return 0;
+        header->m_Tag = tag;
+        header->m_Size = size;
+        TrackAlloc(tag, size);
+        return header + 1;
+    }
+
+    void Free(void* ptr)
+    {
+        if (!ptr)
+            return;
+        BlockHeader* header = ((BlockHeader*)ptr) - 1;
+        TrackFree(header->m_Tag, header->m_Size);
+        free(header);
+    }
 }
@@ -15,6 +15,109 @@
 #ifndef DM_MEMORY_H
 #define DM_MEMORY_H
 
+#include <stdint.h>
 #include <dmsdk/dlib/memory.h>
 
+/**
+ * Tagged memory accounting
+ *
+ * Subsystems register a tag by name and report their allocations against it, either by
+ * allocating through Malloc()/Free(), or by calling TrackAlloc()/TrackFree() when they
+ * already know the sizes. Each tag keeps live, peak and count statistics.
+ *
+ * A tag can have a soft and a hard budget. When the live bytes of a tag cross a budget,
+ * the budget callback is called on the thread that did the allocation. The budgets
+ * don't make any allocations fail.
+ */
+namespace dmMemory
+{
+    typedef uint32_t HTag;
+
+    const HTag      INVALID_TAG     = 0xFFFFFFFF;
+    const uint32_t  MAX_TAG_COUNT   = 64;
+    const uint32_t  MAX_TAG_NAME    = 32;
+
+    struct TagStats
+    {
+        const char* m_Name;
+        uint32_t    m_LiveBytes;
+        uint32_t    m_PeakBytes;
+        uint32_t    m_LiveCount;    // Number of live allocations
+        uint32_t    m_TotalCount;   // Number of allocations since the tag was registered
+        uint32_t    m_SoftBudget;   // 0 if unset
+        uint32_t    m_HardBudget;   // 0 if unset
+    };
+
+    enum BudgetLevel
+    {
+        BUDGET_LEVEL_SOFT = 0,
+        BUDGET_LEVEL_HARD = 1,
+    };
+
+    /**
+     * Called when the live bytes of a tag go above one of its budgets
+     */
+    typedef void (*FBudgetCallback)(void* user_ctx, HTag tag, BudgetLevel level, const TagStats* stats);
+
+    /**
+     * Register a tag. Registering a name that already exists returns the existing tag.
+     * @param name [type: const char*] The name. Truncated to MAX_TAG_NAME-1 characters
+     * @return tag [type: HTag] The tag, or INVALID_TAG if there are already MAX_TAG_COUNT tags
+     */
+    HTag RegisterTag(const char* name);
+
+    /**
+     * Find a tag by name
+     * @return tag [type: HTag] The tag, or INVALID_TAG if it isn't registered
+     */
+    HTag FindTag(const char* name);
+
+    /**
+     * Get the number of registered tags. Tags are numbered 0 to count-1.
+     */
+    uint32_t GetTagCount();
+
+    /**
+     * Get the statistics of a tag
+     * @return result [type: bool] false if the tag is invalid
+     */
+    bool GetTagStats(HTag tag, TagStats* stats);
+
+    /**
+     * Set the budgets of a tag, in bytes. Use 0 to disable a budget.
+     */
+    void SetTagBudget(HTag tag, uint32_t soft_budget, uint32_t hard_budget);
+
+    /**
+     * Set the callback that is called when a budget is exceeded. Pass 0 to remove it.
+     */
+    void SetBudgetCallback(FBudgetCallback callback, void* user_ctx);
+
+    /**
+     * Report an allocation of size bytes. INVALID_TAG is ignored.
+     */
+    void TrackAlloc(HTag tag, uint32_t size);
+
+    /**
+     * Report that an allocation of size bytes was freed. INVALID_TAG is ignored.
+     */
+    void TrackFree(HTag tag, uint32_t size);
+
+    /**
+     * Report that an allocation changed size from old_size to new_size bytes
+     */
+    void TrackRealloc(HTag tag, uint32_t old_size, uint32_t new_size);
+
+    /**
+     * Allocate memory and account it to a tag. The block must be freed with dmMemory::Free
+     * @return ptr [type: void*] The memory, 16 byte aligned. 0 if out of memory
+     */
+    void* Malloc(HTag tag, uint32_t size);
+
+    /**
+     * Free memory allocated with dmMemory::Malloc
+     */
+    void Free(void* ptr);
+}
+
 #endif // DM_MEMORY_H
@@ -134,6 +134,8 @@ namespace dmMessage
 
     MessageContext* g_MessageContext = 0;
     dmSpinlock::Spinlock g_MessageSpinlock;
+    // Bumped each time a socket is created or deleted, see GetSocketGeneration()
+    static int32_atomic_t g_SocketGeneration = 0;
 
     static MessageContext* Create(uint32_t max_sockets)
     {
@@ -212,6 +214,7 @@ namespace dmMessage
 
         g_MessageContext->m_Sockets.Put(name_hash, s);
         *socket = name_hash;
+        dmAtomicIncrement32(&g_SocketGeneration);
 
         return RESULT_OK;
     }
@@ -306,6 +309,7 @@ namespace dmMessage
 
             g_MessageContext->m_Sockets.Erase(s->m_NameHash);
             --s->m_RefCount;
+            dmAtomicIncrement32(&g_SocketGeneration);
 
             if(s->m_RefCount > 0)
             {
@@ -345,6 +349,11 @@ namespace dmMessage
         return GetSocketNoLock(name_hash, out_socket);
     }
 
+    uint32_t GetSocketGeneration()
+    {
+        return (uint32_t)dmAtomicGet32(&g_SocketGeneration);
+    }
+
     const char* GetSocketName(HSocket socket)
     {
         DM_SPINLOCK_SCOPED_LOCK(g_MessageSpinlock);
@@ -58,6 +58,13 @@ namespace dmMessage
      */
     Result GetSocket(const char *name, HSocket* out_socket);
 
+    /**
+     * Get the socket generation, which changes each time a socket is created or deleted.
+     * Used to invalidate data derived from the sockets, e.g. resolved URLs.
+     * @return socket generation
+     */
+    uint32_t GetSocketGeneration();
+
     /**
      * Test if a socket has any messages
      * @param socket Socket
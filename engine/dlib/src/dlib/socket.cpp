@@ -26,6 +26,10 @@
 #include "thread.h"
 #include "atomic.h"
 #include "time.h"
+#include "array.h"
+#include "hash.h"
+#include "mutex.h"
+#include "condition_variable.h"
 
 // Helper and utility functions
 namespace dmSocket
@@ -76,8 +80,11 @@ namespace dmSocket
         return PlatformInitialize();
     }
 
+    static void StopResolver();
+
     Result Finalize()
     {
+        StopResolver();
         return PlatformFinalize();
     }
 
@@ -88,79 +95,430 @@ namespace dmSocket
         return address;
     }
 
-    struct GetHostByNameThreadContext
+#if defined(__EMSCRIPTEN__)
+    Result GetHostByNameT(const char* name, Address* address, uint64_t timeout, int* cancelflag, bool ipv4, bool ipv6)
+    {
+        return GetHostByName(name, address, ipv4, ipv6);
+    }
+
+    void PrefetchHostByName(const char* name, bool ipv4, bool ipv6)
+    {
+    }
+
+    void ClearHostCache()
+    {
+    }
+
+    void SetHostLookupFunction(HostLookupFunction fn)
+    {
+    }
+
+    static void StopResolver()
+    {
+    }
+#else
+    // Host names are resolved by a small pool of persistent threads. The results are cached, and
+    // concurrent lookups of the same name are coalesced into one. The platform lookup (getaddrinfo)
+    // can't be cancelled, so a caller that times out simply stops waiting for it, and the result
+    // still ends up in the cache. Since lookups may hang for a long time, more threads are started
+    // when all of them are busy. These extra threads exit once the queue is empty.
+    const uint32_t RESOLVER_THREAD_COUNT = 4;
+    const uint32_t RESOLVER_MAX_THREAD_COUNT = 32;
+    const uint32_t RESOLVER_THREAD_STACK_SIZE = 0x20000;
+    const uint32_t RESOLVER_MAX_CACHED_LOOKUPS = 32;
+    const uint64_t RESOLVER_POSITIVE_TTL = 60 * 1000000U; // The platform lookup doesn't give us the record TTL
+    const uint64_t RESOLVER_NEGATIVE_TTL = 5 * 1000000U;
+    const uint64_t RESOLVER_CANCEL_POLL_INTERVAL = 10000; // How often a waiting caller checks its cancel flag
+
+    struct HostLookup
     {
-        int32_atomic_t m_Finished;
-        const char* m_Name;
-        Address m_Address;
-        Result m_Result;
-        bool m_Ipv4;
-        bool m_Ipv6;
+        dmhash_t m_Key;
+        char*    m_Name;
+        Address  m_Address;
+        Result   m_Result;
+        uint64_t m_Expires;
+        uint32_t m_RefCount;    // One for the cache, one while queued or resolving, and one per waiting caller
+        uint32_t m_Ipv4 : 1;
+        uint32_t m_Ipv6 : 1;
+        uint32_t m_Done : 1;
+        uint32_t : 29;
     };
 
-    static void GetHostByNameThreadWorker(void* arg)
+    struct HostResolver
     {
-        GetHostByNameThreadContext* ctx = (GetHostByNameThreadContext*)arg;
-        ctx->m_Result = GetHostByName(ctx->m_Name, &ctx->m_Address, ctx->m_Ipv4, ctx->m_Ipv6);
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_Condition;     // Signaled when a lookup is queued
+        dmConditionVariable::HConditionVariable m_DoneCondition; // Signaled when a lookup is done, or the resolver is stopped
+        dmArray<HostLookup*>                    m_Lookups;  // Finished and in progress lookups
+        dmArray<HostLookup*>                    m_Queue;
+        HostLookupFunction                      m_LookupFunction;
+        uint32_t                                m_RefCount; // One for the owner, one per thread, and one per caller
+        uint32_t                                m_ThreadCount;
+        uint32_t                                m_IdleThreadCount;
+        bool                                    m_Run;
+    };
+
+    enum ResolverState
+    {
+        RESOLVER_STATE_STOPPED = 0,
+        RESOLVER_STATE_BUSY    = 1,
+        RESOLVER_STATE_RUNNING = 2,
+    };
+
+    static HostResolver*        g_Resolver = 0;
+    static int32_atomic_t       g_ResolverState = RESOLVER_STATE_STOPPED;
 
-        if (dmAtomicIncrement32(&ctx->m_Finished)+1 == 2)
+    static void ReleaseLookup(HostLookup* lookup)
+    {
+        assert(lookup->m_RefCount > 0);
+        if (--lookup->m_RefCount == 0)
         {
-            // The calling thread was already finished, waiting for this thread.
-            free((void*)ctx->m_Name);
-            delete ctx;
+            free(lookup->m_Name);
+            delete lookup;
         }
     }
 
-#if defined(__EMSCRIPTEN__)
-    Result GetHostByNameT(const char* name, Address* address, uint64_t timeout, int* cancelflag, bool ipv4, bool ipv6)
+    // Called with the resolver mutex held. Returns true if the resolver was deleted
+    static bool ReleaseResolver(HostResolver* resolver)
     {
-        return GetHostByName(name, address, ipv4, ipv6);
+        assert(resolver->m_RefCount > 0);
+        if (--resolver->m_RefCount > 0)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < resolver->m_Queue.Size(); ++i)
+        {
+            ReleaseLookup(resolver->m_Queue[i]);
+        }
+        for (uint32_t i = 0; i < resolver->m_Lookups.Size(); ++i)
+        {
+            ReleaseLookup(resolver->m_Lookups[i]);
+        }
+        dmMutex::Unlock(resolver->m_Mutex);
+        dmConditionVariable::Delete(resolver->m_Condition);
+        dmConditionVariable::Delete(resolver->m_DoneCondition);
+        dmMutex::Delete(resolver->m_Mutex);
+        delete resolver;
+        return true;
     }
-#else
-    Result GetHostByNameT(const char* name, Address* address, uint64_t timeout, int* cancelflag, bool ipv4, bool ipv6)
+
+    // Called with the resolver mutex held. Unlocks it, unless the resolver was deleted
+    static void ReleaseResolverAndUnlock(HostResolver* resolver)
     {
-        const uint32_t THREAD_STACK_SIZE = 0x20000;
+        if (!ReleaseResolver(resolver))
+        {
+            dmMutex::Unlock(resolver->m_Mutex);
+        }
+    }
 
-        GetHostByNameThreadContext* ctx = new GetHostByNameThreadContext;
-        ctx->m_Name = strdup(name);
-        ctx->m_Ipv4 = ipv4;
-        ctx->m_Ipv6 = ipv6;
-        ctx->m_Result = RESULT_HOSTUNREACH;
-        ctx->m_Finished = 0;
+    static void ResolverThread(void* arg)
+    {
+        HostResolver* resolver = (HostResolver*)arg;
 
-        dmThread::Thread t = dmThread::New(&GetHostByNameThreadWorker, THREAD_STACK_SIZE, ctx, "GetHostByName");
-        uint64_t tend = timeout ? dmTime::GetTime() + timeout : 0xFFFFFFFFFFFFFFFF;
-        while (tend > dmTime::GetTime())
+        dmMutex::Lock(resolver->m_Mutex);
+        while (true)
         {
-            if (dmAtomicAdd32(&ctx->m_Finished, 0) == 1) // the thread has finished
+            if (resolver->m_Queue.Empty() && resolver->m_ThreadCount > RESOLVER_THREAD_COUNT)
             {
                 break;
             }
 
-            if (cancelflag && *cancelflag)
+            resolver->m_IdleThreadCount++;
+            while (resolver->m_Run && resolver->m_Queue.Empty())
+            {
+                dmConditionVariable::Wait(resolver->m_Condition, resolver->m_Mutex);
+            }
+            resolver->m_IdleThreadCount--;
+
+            if (!resolver->m_Run)
+            {
+                break;
+            }
+
+            HostLookup* lookup = resolver->m_Queue[0];
+            uint32_t queue_size = resolver->m_Queue.Size();
+            memmove(resolver->m_Queue.Begin(), resolver->m_Queue.Begin() + 1, (queue_size - 1) * sizeof(HostLookup*));
+            resolver->m_Queue.SetSize(queue_size - 1);
+
+            HostLookupFunction lookup_fn = resolver->m_LookupFunction;
+            dmMutex::Unlock(resolver->m_Mutex);
+
+            Address address;
+            Result result = lookup_fn(lookup->m_Name, &address, lookup->m_Ipv4, lookup->m_Ipv6);
+
+            dmMutex::Lock(resolver->m_Mutex);
+            lookup->m_Address = address;
+            lookup->m_Result = result;
+            lookup->m_Expires = dmTime::GetTime() + (result == RESULT_OK ? RESOLVER_POSITIVE_TTL : RESOLVER_NEGATIVE_TTL);
+            lookup->m_Done = 1;
+            ReleaseLookup(lookup);
+            dmConditionVariable::Broadcast(resolver->m_DoneCondition);
+        }
+
+        resolver->m_ThreadCount--;
+        ReleaseResolverAndUnlock(resolver);
+    }
+
+    // Called with the resolver mutex held
+    static void StartResolverThread(HostResolver* resolver)
+    {
+        // A thread may be stuck in a platform lookup for a long time, so they are never joined.
+        // The last one to finish deletes the resolver.
+        resolver->m_ThreadCount++;
+        resolver->m_RefCount++;
+        dmThread::Thread thread = dmThread::New(&ResolverThread, RESOLVER_THREAD_STACK_SIZE, resolver, "GetHostByName");
+        dmThread::Detach(thread);
+    }
+
+    // The compare and store is a full barrier, which dmAtomicStore32() isn't on all platforms
+    static void LeaveBusyResolverState(ResolverState state)
+    {
+        dmAtomicCompareStore32(&g_ResolverState, state, RESOLVER_STATE_BUSY);
+    }
+
+    // Returns the resolver with a reference held by the caller, which must be released with ReleaseResolver().
+    // The resolver is started on first use, so that it also works if dmSocket::Initialize() wasn't called
+    static HostResolver* AcquireResolver()
+    {
+        while (true)
+        {
+            int32_t state = dmAtomicCompareStore32(&g_ResolverState, RESOLVER_STATE_BUSY, RESOLVER_STATE_RUNNING);
+            if (state == RESOLVER_STATE_RUNNING)
+            {
+                // The state is busy while we take the reference, so the resolver can't be stopped in between
+                HostResolver* resolver = g_Resolver;
+                dmMutex::Lock(resolver->m_Mutex);
+                resolver->m_RefCount++;
+                dmMutex::Unlock(resolver->m_Mutex);
+                LeaveBusyResolverState(RESOLVER_STATE_RUNNING);
+                return resolver;
+            }
+
+            state = dmAtomicCompareStore32(&g_ResolverState, RESOLVER_STATE_BUSY, RESOLVER_STATE_STOPPED);
+            if (state == RESOLVER_STATE_STOPPED)
+            {
+                break;
+            }
+            dmTime::Sleep(state == RESOLVER_STATE_BUSY ? 0 : 1000);
+        }
+
+        HostResolver* resolver = new HostResolver;
+        resolver->m_Mutex = dmMutex::New();
+        resolver->m_Condition = dmConditionVariable::New();
+        resolver->m_DoneCondition = dmConditionVariable::New();
+        resolver->m_Lookups.SetCapacity(RESOLVER_MAX_CACHED_LOOKUPS);
+        resolver->m_Queue.SetCapacity(RESOLVER_MAX_CACHED_LOOKUPS);
+        resolver->m_LookupFunction = GetHostByName;
+        resolver->m_RefCount = 2; // The owner and the caller
+        resolver->m_ThreadCount = 0;
+        resolver->m_IdleThreadCount = 0;
+        resolver->m_Run = true;
+
+        dmMutex::Lock(resolver->m_Mutex);
+        for (uint32_t i = 0; i < RESOLVER_THREAD_COUNT; ++i)
+        {
+            StartResolverThread(resolver);
+        }
+        dmMutex::Unlock(resolver->m_Mutex);
+
+        g_Resolver = resolver;
+        LeaveBusyResolverState(RESOLVER_STATE_RUNNING);
+        return resolver;
+    }
+
+    static void StopResolver()
+    {
+        while (true)
+        {
+            int32_t state = dmAtomicCompareStore32(&g_ResolverState, RESOLVER_STATE_BUSY, RESOLVER_STATE_RUNNING);
+            if (state == RESOLVER_STATE_RUNNING)
             {
                 break;
             }
+            else if (state == RESOLVER_STATE_STOPPED)
+            {
+                return;
+            }
+            dmTime::Sleep(0);
+        }
+
+        HostResolver* resolver = g_Resolver;
+        g_Resolver = 0;
+
+        dmMutex::Lock(resolver->m_Mutex);
+        resolver->m_Run = false;
+        for (uint32_t i = 0; i < resolver->m_Queue.Size(); ++i)
+        {
+            // Lookups that never started are failed
+            HostLookup* lookup = resolver->m_Queue[i];
+            lookup->m_Result = RESULT_HOSTUNREACH;
+            lookup->m_Done = 1;
+            ReleaseLookup(lookup);
+        }
+        resolver->m_Queue.SetSize(0);
+        dmConditionVariable::Broadcast(resolver->m_Condition);
+        // Callers waiting for lookups in progress return as well
+        dmConditionVariable::Broadcast(resolver->m_DoneCondition);
+        ReleaseResolverAndUnlock(resolver);
+
+        LeaveBusyResolverState(RESOLVER_STATE_STOPPED);
+    }
+
+    static dmhash_t GetLookupKey(const char* name, bool ipv4, bool ipv6)
+    {
+        HashState64 state;
+        dmHashInit64(&state, false);
+        dmHashUpdateBuffer64(&state, name, strlen(name));
+        uint8_t families = (ipv4 ? 1 : 0) | (ipv6 ? 2 : 0);
+        dmHashUpdateBuffer64(&state, &families, sizeof(families));
+        return dmHashFinal64(&state);
+    }
+
+    // Called with the resolver mutex held
+    static void RemoveLookup(HostResolver* resolver, uint32_t index)
+    {
+        HostLookup* lookup = resolver->m_Lookups[index];
+        resolver->m_Lookups.EraseSwap(index);
+        ReleaseLookup(lookup);
+    }
+
+    // Called with the resolver mutex held. Returns a cached or in progress lookup, or starts a new one
+    static HostLookup* BeginLookup(HostResolver* resolver, const char* name, bool ipv4, bool ipv6)
+    {
+        dmhash_t key = GetLookupKey(name, ipv4, ipv6);
+        uint64_t time = dmTime::GetTime();
+
+        int32_t oldest = -1;
+        for (uint32_t i = 0; i < resolver->m_Lookups.Size(); ++i)
+        {
+            HostLookup* lookup = resolver->m_Lookups[i];
+            if (lookup->m_Done && lookup->m_Expires <= time)
+            {
+                RemoveLookup(resolver, i--);
+                continue;
+            }
+
+            if (lookup->m_Key == key && strcmp(lookup->m_Name, name) == 0)
+            {
+                return lookup;
+            }
+
+            if (lookup->m_Done && (oldest == -1 || lookup->m_Expires < resolver->m_Lookups[oldest]->m_Expires))
+            {
+                oldest = (int32_t)i;
+            }
+        }
+
+        if (resolver->m_Lookups.Full())
+        {
+            if (oldest != -1)
+            {
+                RemoveLookup(resolver, (uint32_t)oldest);
+            }
+            else
+            {
+                resolver->m_Lookups.OffsetCapacity(RESOLVER_MAX_CACHED_LOOKUPS);
+            }
+        }
 
-            dmTime::Sleep(2000);
+        HostLookup* lookup = new HostLookup;
+        memset(lookup, 0, sizeof(HostLookup));
+        lookup->m_Key = key;
+        lookup->m_Name = strdup(name);
+        lookup->m_Result = RESULT_HOSTUNREACH;
+        lookup->m_RefCount = 2;
+        lookup->m_Ipv4 = ipv4;
+        lookup->m_Ipv6 = ipv6;
+        resolver->m_Lookups.Push(lookup);
+
+        if (resolver->m_Queue.Full())
+        {
+            resolver->m_Queue.OffsetCapacity(RESOLVER_MAX_CACHED_LOOKUPS);
         }
+        resolver->m_Queue.Push(lookup);
 
-        // if the thread hasn't finished, we let the thread clean up
-        if (dmAtomicIncrement32(&ctx->m_Finished)+1 == 1)
+        // Don't let the new lookup wait behind lookups that may hang
+        if (resolver->m_Run && resolver->m_Queue.Size() > resolver->m_IdleThreadCount && resolver->m_ThreadCount < RESOLVER_MAX_THREAD_COUNT)
         {
-            dmThread::Detach(t);
-            return RESULT_TIMEDOUT;
+            StartResolverThread(resolver);
         }
+        dmConditionVariable::Signal(resolver->m_Condition);
+        return lookup;
+    }
 
-        dmThread::Join(t);
+    Result GetHostByNameT(const char* name, Address* address, uint64_t timeout, int* cancelflag, bool ipv4, bool ipv6)
+    {
+        HostResolver* resolver = AcquireResolver();
 
-        Result result = ctx->m_Result;
-        *address = ctx->m_Address;
-        free((void*)ctx->m_Name);
-        delete ctx;
+        dmMutex::Lock(resolver->m_Mutex);
+        HostLookup* lookup = BeginLookup(resolver, name, ipv4, ipv6);
+        lookup->m_RefCount++;
 
+        Result result = RESULT_TIMEDOUT;
+        uint64_t tend = timeout ? dmTime::GetTime() + timeout : 0xFFFFFFFFFFFFFFFF;
+        while (true)
+        {
+            if (lookup->m_Done)
+            {
+                *address = lookup->m_Address;
+                result = lookup->m_Result;
+                break;
+            }
+
+            if (!resolver->m_Run)
+            {
+                result = RESULT_HOSTUNREACH;
+                break;
+            }
+
+            uint64_t time = dmTime::GetTime();
+            if (tend <= time || (cancelflag && *cancelflag))
+            {
+                break;
+            }
+
+            // The cancel flag isn't signaled, so it's checked at regular intervals
+            uint64_t wait = tend - time;
+            if (cancelflag && wait > RESOLVER_CANCEL_POLL_INTERVAL)
+            {
+                wait = RESOLVER_CANCEL_POLL_INTERVAL;
+            }
+            dmConditionVariable::TimedWait(resolver->m_DoneCondition, resolver->m_Mutex, wait);
+        }
+
+        ReleaseLookup(lookup);
+        ReleaseResolverAndUnlock(resolver);
         return result;
     }
+
+    void PrefetchHostByName(const char* name, bool ipv4, bool ipv6)
+    {
+        HostResolver* resolver = AcquireResolver();
+        dmMutex::Lock(resolver->m_Mutex);
+        BeginLookup(resolver, name, ipv4, ipv6);
+        ReleaseResolverAndUnlock(resolver);
+    }
+
+    void ClearHostCache()
+    {
+        HostResolver* resolver = AcquireResolver();
+        dmMutex::Lock(resolver->m_Mutex);
+        for (uint32_t i = 0; i < resolver->m_Lookups.Size(); ++i)
+        {
+            ReleaseLookup(resolver->m_Lookups[i]);
+        }
+        resolver->m_Lookups.SetSize(0);
+        ReleaseResolverAndUnlock(resolver);
+    }
+
+    void SetHostLookupFunction(HostLookupFunction fn)
+    {
+        HostResolver* resolver = AcquireResolver();
+        dmMutex::Lock(resolver->m_Mutex);
+        resolver->m_LookupFunction = fn ? fn : GetHostByName;
+        ReleaseResolverAndUnlock(resolver);
+    }
 #endif
 
     #define DM_SOCKET_RESULT_TO_STRING_CASE(x) case RESULT_##x: return #x;
@@ -68,6 +68,21 @@ namespace dmSocket
      */
     Result Finalize();
 
+    /**
+     * Start resolving a host name in the background, without waiting for the result.
+     * A later GetHostByNameT() call for the same name and address families waits for
+     * this lookup instead of starting a new one, or uses its cached result.
+     * @param name Hostname to resolve
+     * @param ipv4 Whether or not to search for IPv4 addresses
+     * @param ipv6 Whether or not to search for IPv6 addresses
+     */
+    void PrefetchHostByName(const char* name, bool ipv4, bool ipv6);
+
+    /**
+     * Remove all cached host name lookups made by GetHostByNameT()
+     */
+    void ClearHostCache();
+
     /**
      * Add multicast membership
      * @param socket socket to add membership on
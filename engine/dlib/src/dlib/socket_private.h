@@ -23,6 +23,11 @@ namespace dmSocket
     Result NativeToResult(const char* filename, int line, int r);
     #define NATIVETORESULT(_R_) NativeToResult(__FILE__, __LINE__, _R_)
 
+    typedef Result (*HostLookupFunction)(const char* name, Address* address, bool ipv4, bool ipv6);
+
+    // Used by the unit tests to replace the platform lookup done by GetHostByNameT(). Pass 0 to restore GetHostByName()
+    void SetHostLookupFunction(HostLookupFunction fn);
+
 #if defined(__NX__)
     int gethostname(char*, int);
 #endif
@@ -15,6 +15,7 @@
 #ifndef DM_SYS_H
 #define DM_SYS_H
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h> // free
 
@@ -147,6 +148,13 @@ namespace dmSys
      */
     Result RmTree(const char* path);
 
+    /**
+     * Write the buffered data of a file, and make sure that it has reached the storage device
+     * @param file file opened for writing
+     * @return RESULT_OK on success
+     */
+    Result FlushFile(FILE* file);
+
     /**
      * Iterate a file tree and callback for each file entry
      * @param path path to directory to iterate
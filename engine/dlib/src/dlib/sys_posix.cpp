@@ -1063,6 +1063,21 @@ namespace dmSys
             return ErrnoToResult(errno);
     }
 
+    Result FlushFile(FILE* file)
+    {
+        if (fflush(file) != 0)
+            return ErrnoToResult(errno);
+#if defined(_WIN32)
+        int ret = _commit(_fileno(file));
+#else
+        int ret = fsync(fileno(file));
+#endif
+        if (ret == 0)
+            return RESULT_OK;
+        else
+            return ErrnoToResult(errno);
+    }
+
     Result Stat(const char* path, StatInfo* stat_info)
     {
         struct stat info;
@@ -34,10 +34,12 @@ namespace dmCrypt
      * @enum
      * @name Algorithm
      * @member dmCrypt::ALGORITHM_XTEA
+     * @member dmCrypt::ALGORITHM_AES_CTR
      */
     enum Algorithm
     {
-        ALGORITHM_XTEA
+        ALGORITHM_XTEA,
+        ALGORITHM_AES_CTR,
     };
 
     /*# result enumeration
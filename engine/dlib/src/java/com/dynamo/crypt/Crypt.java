@@ -14,6 +14,12 @@
 
 package com.dynamo.crypt;
 
+import java.util.Arrays;
+
+import javax.crypto.Cipher;
+import javax.crypto.spec.IvParameterSpec;
+import javax.crypto.spec.SecretKeySpec;
+
 public class Crypt {
 
     private final static int NUM_ROUNDS = 32;
@@ -70,4 +76,16 @@ public class Crypt {
     public static byte[] decryptCTR(byte[] data, byte[] key) {
         return encryptCTR(data, key);
     }
+
+    // AES-128 with a 128 bit big endian counter, starting at zero (matches dmCrypt::ALGORITHM_AES_CTR)
+    // Keys shorter than 16 bytes are zero padded
+    public static byte[] encryptAesCTR(byte[] data, byte[] key) throws Exception {
+        Cipher cipher = Cipher.getInstance("AES/CTR/NoPadding");
+        cipher.init(Cipher.ENCRYPT_MODE, new SecretKeySpec(Arrays.copyOf(key, 16), "AES"), new IvParameterSpec(new byte[16]));
+        return cipher.doFinal(data);
+    }
+
+    public static byte[] decryptAesCTR(byte[] data, byte[] key) throws Exception {
+        return encryptAesCTR(data, key);
+    }
 }
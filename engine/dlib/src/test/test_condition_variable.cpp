@@ -19,6 +19,7 @@
 #include <dlib/thread.h>
 #include <dlib/mutex.h>
 #include <dlib/condition_variable.h>
+#include <dlib/time.h>
 
 struct ThreadArg
 {
@@ -95,6 +96,43 @@ TEST(dmConditionVariable, ProducerConsumer)
     ASSERT_EQ((int64_t) (MAX/2) * (MAX-1), a.m_Sum);
 }
 
+static void SignalLater(void* arg)
+{
+    ThreadArg* a = (ThreadArg*) arg;
+    dmTime::Sleep(20000);
+    dmMutex::Lock(a->m_Mutex);
+    a->m_Sum = 1;
+    dmConditionVariable::Signal(a->m_More);
+    dmMutex::Unlock(a->m_Mutex);
+}
+
+TEST(dmConditionVariable, TimedWait)
+{
+    ThreadArg a;
+    a.m_Mutex = dmMutex::New();
+    a.m_More = dmConditionVariable::New();
+    a.m_Sum = 0;
+
+    dmMutex::Lock(a.m_Mutex);
+    uint64_t start = dmTime::GetTime();
+    ASSERT_FALSE(dmConditionVariable::TimedWait(a.m_More, a.m_Mutex, 10000));
+    ASSERT_LE(10000U, dmTime::GetTime() - start);
+
+    dmThread::Thread t = dmThread::New(&SignalLater, 0x80000, &a, "signal");
+    start = dmTime::GetTime();
+    while (a.m_Sum == 0)
+    {
+        ASSERT_GT(2000000U, dmTime::GetTime() - start);
+        dmConditionVariable::TimedWait(a.m_More, a.m_Mutex, 1000000);
+    }
+    ASSERT_GT(1000000U, dmTime::GetTime() - start);
+    dmMutex::Unlock(a.m_Mutex);
+
+    dmThread::Join(t);
+    dmMutex::Delete(a.m_Mutex);
+    dmConditionVariable::Delete(a.m_More);
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -13,11 +13,14 @@
 // specific language governing permissions and limitations under the License.
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include "../dlib/crypt.h"
+#include "../dlib/thread.h"
+#include "../dlib/time.h"
 
 
 TEST(dmCrypt, XTea)
@@ -88,6 +91,150 @@ TEST(dmCrypt, Random)
     }
 }
 
+// Reference implementation, to verify the vectorised version
+static void EncryptXTeaCTRReference(uint8_t* data, uint32_t datalen, const uint8_t* key)
+{
+    uint32_t k[4];
+    for (int i = 0; i < 4; ++i)
+        k[i] = (uint32_t)key[i*4+0] << 24 | (uint32_t)key[i*4+1] << 16 | (uint32_t)key[i*4+2] << 8 | (uint32_t)key[i*4+3];
+
+    for (uint32_t i = 0; i < datalen; i += 8)
+    {
+        uint64_t counter = i / 8;
+        uint32_t v0 = (uint32_t)(counter >> 32), v1 = (uint32_t)counter, sum = 0;
+        for (int r = 0; r < 32; ++r)
+        {
+            v0 += (((v1 << 4) ^ (v1 >> 5)) + v1) ^ (sum + k[sum & 3]);
+            sum += 0x9e3779b9;
+            v1 += (((v0 << 4) ^ (v0 >> 5)) + v0) ^ (sum + k[(sum >> 11) & 3]);
+        }
+        uint8_t enc_counter[8] = { (uint8_t)(v0 >> 24), (uint8_t)(v0 >> 16), (uint8_t)(v0 >> 8), (uint8_t)v0,
+                                   (uint8_t)(v1 >> 24), (uint8_t)(v1 >> 16), (uint8_t)(v1 >> 8), (uint8_t)v1 };
+        for (uint32_t j = 0; j < 8 && i + j < datalen; ++j)
+            data[i + j] ^= enc_counter[j];
+    }
+}
+
+TEST(dmCrypt, XTeaMatchesReference)
+{
+    const uint32_t size = 1024;
+    uint8_t original[size];
+    uint8_t expected[size];
+    uint8_t buf[size];
+    for (uint32_t i = 0; i < size; ++i)
+        original[i] = rand() & 0xff;
+
+    const uint8_t* key = (const uint8_t*)"aQj8CScgNP4VsfXK";
+    for (uint32_t len = 0; len < size; ++len)
+    {
+        memcpy(expected, original, len);
+        EncryptXTeaCTRReference(expected, len, key);
+
+        memcpy(buf, original, len);
+        dmCrypt::Encrypt(dmCrypt::ALGORITHM_XTEA, buf, len, key, 16);
+        ASSERT_EQ(0, memcmp(expected, buf, len));
+    }
+}
+
+TEST(dmCrypt, AesCTR)
+{
+    // The key stream is AES-128 of the big endian block counters 0, 1, 2 ...
+    const uint8_t* key = (const uint8_t*)"aQj8CScgNP4VsfXK";
+    const uint8_t expected[] = {
+        0x92, 0xdc, 0x86, 0x6f, 0x09, 0x7d, 0x7b, 0x4b, 0xd5, 0x14, 0x4d, 0x9f, 0x12, 0x0b, 0x58, 0xe9,
+        0xf9, 0x25, 0x63, 0x31, 0xaa, 0x1e, 0x37, 0xc6, 0x88, 0xf0, 0x01, 0x19, 0x81, 0xfb, 0x89, 0xac,
+        0x3f, 0x21, 0x22, 0xaa, 0x18, 0xcb, 0x05, 0x49, 0x51, 0xd5, 0xa9, 0x59, 0xe1, 0x6b, 0xc2,
+    };
+
+    for (int hw = 0; hw < 2; ++hw)
+    {
+        if (hw && !dmCrypt::HasHardwareAes())
+            continue;
+        dmCrypt::SetHardwareAesEnabled(hw != 0);
+
+        uint8_t buf[sizeof(expected)] = {0};
+        ASSERT_EQ(dmCrypt::RESULT_OK, dmCrypt::Encrypt(dmCrypt::ALGORITHM_AES_CTR, buf, sizeof(buf), key, 16));
+        ASSERT_ARRAY_EQ(expected, buf);
+
+        ASSERT_EQ(dmCrypt::RESULT_OK, dmCrypt::Decrypt(dmCrypt::ALGORITHM_AES_CTR, buf, sizeof(buf), key, 16));
+        for (uint32_t i = 0; i < sizeof(buf); ++i)
+            ASSERT_EQ(0, buf[i]);
+    }
+    dmCrypt::SetHardwareAesEnabled(true);
+
+    uint8_t buf[16];
+    ASSERT_EQ(dmCrypt::RESULT_ERROR, dmCrypt::Encrypt(dmCrypt::ALGORITHM_AES_CTR, buf, sizeof(buf), (const uint8_t*)"01234567890123456", 17));
+}
+
+// Compare the hardware and portable implementations for all tail lengths
+TEST(dmCrypt, AesHardwareMatchesPortable)
+{
+    if (!dmCrypt::HasHardwareAes())
+        return;
+
+    const uint32_t size = 1024;
+    uint8_t original[size];
+    uint8_t hw[size];
+    uint8_t sw[size];
+    for (uint32_t i = 0; i < size; ++i)
+        original[i] = rand() & 0xff;
+
+    for (uint32_t len = 0; len < size; ++len)
+    {
+        uint8_t key[16];
+        uint32_t keylen = rand() % 17;
+        for (uint32_t k = 0; k < keylen; ++k)
+            key[k] = rand() & 0xff;
+
+        memcpy(hw, original, len);
+        dmCrypt::SetHardwareAesEnabled(true);
+        dmCrypt::Encrypt(dmCrypt::ALGORITHM_AES_CTR, hw, len, key, keylen);
+
+        memcpy(sw, original, len);
+        dmCrypt::SetHardwareAesEnabled(false);
+        dmCrypt::Encrypt(dmCrypt::ALGORITHM_AES_CTR, sw, len, key, keylen);
+        ASSERT_EQ(0, memcmp(hw, sw, len));
+
+        dmCrypt::Decrypt(dmCrypt::ALGORITHM_AES_CTR, sw, len, key, keylen);
+        ASSERT_EQ(0, memcmp(original, sw, len));
+    }
+    dmCrypt::SetHardwareAesEnabled(true);
+}
+
+TEST(dmCrypt, EncryptPerformance)
+{
+    const uint32_t size = 32 * 1024 * 1024;
+    uint8_t* data = new uint8_t[size];
+    memset(data, 0x5a, size);
+    const uint8_t* key = (const uint8_t*)"aQj8CScgNP4VsfXK";
+    const float total_mb = size / (1024.0f * 1024.0f);
+
+    uint64_t tstart = dmTime::GetTime();
+    EncryptXTeaCTRReference(data, size, key);
+    uint64_t t = dmTime::GetTime() - tstart;
+    printf("XTEA reference: %.1f MB/s\n", total_mb / (t / 1000000.0f));
+
+    tstart = dmTime::GetTime();
+    dmCrypt::Encrypt(dmCrypt::ALGORITHM_XTEA, data, size, key, 16);
+    t = dmTime::GetTime() - tstart;
+    printf("XTEA: %.1f MB/s\n", total_mb / (t / 1000000.0f));
+
+    for (uint32_t hw = 0; hw < 2; ++hw)
+    {
+        if (hw && !dmCrypt::HasHardwareAes())
+            continue;
+        dmCrypt::SetHardwareAesEnabled(hw != 0);
+
+        tstart = dmTime::GetTime();
+        dmCrypt::Encrypt(dmCrypt::ALGORITHM_AES_CTR, data, size, key, 16);
+        t = dmTime::GetTime() - tstart;
+        printf("AES-CTR %s: %.1f MB/s\n", hw ? "hardware" : "portable", total_mb / (t / 1000000.0f));
+    }
+    dmCrypt::SetHardwareAesEnabled(true);
+
+    delete[] data;
+}
+
 
 TEST(dmCrypt, MD5)
 {
@@ -126,6 +273,233 @@ TEST(dmCrypt, SHA512)
 }
 
 
+struct ShaTestVector
+{
+    const char* m_Input;
+    uint32_t    m_Repeat;
+    const char* m_Sha1;
+    const char* m_Sha256;
+};
+
+// FIPS 180 test vectors
+static const ShaTestVector g_ShaTestVectors[] = {
+    {"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "84983e441c3bd26ebaae4aa1f95129e5e54670f1", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f", "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+static void ToHex(const uint8_t* digest, uint32_t len, char* out)
+{
+    for (uint32_t i = 0; i < len; ++i)
+        sprintf(out + i*2, "%02x", digest[i]);
+}
+
+static void TestShaVectors()
+{
+    for (uint32_t i = 0; i < sizeof(g_ShaTestVectors)/sizeof(g_ShaTestVectors[0]); ++i)
+    {
+        const ShaTestVector& v = g_ShaTestVectors[i];
+        uint32_t input_len = strlen(v.m_Input);
+        uint32_t len = input_len * v.m_Repeat;
+        uint8_t* buf = new uint8_t[len + 1];
+        for (uint32_t r = 0; r < v.m_Repeat; ++r)
+            memcpy(buf + r * input_len, v.m_Input, input_len);
+
+        uint8_t digest[32];
+        char hex[65];
+        dmCrypt::HashSha1(buf, len, digest);
+        ToHex(digest, 20, hex);
+        ASSERT_STREQ(v.m_Sha1, hex);
+
+        dmCrypt::HashSha256(buf, len, digest);
+        ToHex(digest, 32, hex);
+        ASSERT_STREQ(v.m_Sha256, hex);
+
+        delete[] buf;
+    }
+}
+
+TEST(dmCrypt, ShaVectors)
+{
+    printf("Hardware SHA: %s\n", dmCrypt::HasHardwareSha() ? "yes" : "no");
+    TestShaVectors();
+
+    bool prev = dmCrypt::SetHardwareShaEnabled(false);
+    TestShaVectors();
+    dmCrypt::SetHardwareShaEnabled(prev);
+}
+
+// Compare the hardware and portable implementations for all tail lengths
+TEST(dmCrypt, ShaHardwareMatchesPortable)
+{
+    if (!dmCrypt::HasHardwareSha())
+        return;
+
+    const uint32_t size = 1024;
+    uint8_t buf[size];
+    for (uint32_t i = 0; i < size; ++i)
+        buf[i] = rand() & 0xff;
+
+    for (uint32_t len = 0; len < size; ++len)
+    {
+        uint8_t hw[32], sw[32];
+        dmCrypt::SetHardwareShaEnabled(true);
+        dmCrypt::HashSha1(buf, len, hw);
+        dmCrypt::SetHardwareShaEnabled(false);
+        dmCrypt::HashSha1(buf, len, sw);
+        ASSERT_EQ(0, memcmp(hw, sw, 20));
+
+        dmCrypt::SetHardwareShaEnabled(true);
+        dmCrypt::HashSha256(buf, len, hw);
+        dmCrypt::SetHardwareShaEnabled(false);
+        dmCrypt::HashSha256(buf, len, sw);
+        ASSERT_EQ(0, memcmp(hw, sw, 32));
+    }
+    dmCrypt::SetHardwareShaEnabled(true);
+}
+
+TEST(dmCrypt, HashBuffers)
+{
+    const uint32_t num_buffers = 37;
+    const uint32_t max_size = 64 * 1024;
+    uint8_t* data = new uint8_t[max_size];
+    for (uint32_t i = 0; i < max_size; ++i)
+        data[i] = rand() & 0xff;
+
+    dmCrypt::HashBuffer buffers[num_buffers];
+    uint8_t digests[num_buffers][32];
+    for (uint32_t i = 0; i < num_buffers; ++i)
+    {
+        buffers[i].m_Buffer = data + i;
+        buffers[i].m_BufferLength = (i * 7919) % (max_size - num_buffers);
+        buffers[i].m_Digest = digests[i];
+    }
+
+    dmCrypt::HashAlgorithm algorithms[] = {dmCrypt::HASH_ALGORITHM_SHA1, dmCrypt::HASH_ALGORITHM_SHA256};
+    for (uint32_t a = 0; a < 2; ++a)
+    {
+        memset(digests, 0, sizeof(digests));
+        dmCrypt::HashBuffers(algorithms[a], buffers, num_buffers, 4);
+
+        for (uint32_t i = 0; i < num_buffers; ++i)
+        {
+            uint8_t expected[32];
+            dmCrypt::Hash(algorithms[a], buffers[i].m_Buffer, buffers[i].m_BufferLength, expected);
+            ASSERT_EQ(0, memcmp(expected, digests[i], a == 0 ? 20 : 32));
+        }
+    }
+
+    delete[] data;
+}
+
+struct HashBuffersThreadContext
+{
+    dmCrypt::HashBuffer*    m_Buffers;
+    uint32_t                m_NumBuffers;
+};
+
+static void HashBuffersThread(void* arg)
+{
+    HashBuffersThreadContext* ctx = (HashBuffersThreadContext*)arg;
+    for (uint32_t i = 0; i < 8; ++i)
+        dmCrypt::HashBuffers(dmCrypt::HASH_ALGORITHM_SHA1, ctx->m_Buffers, ctx->m_NumBuffers, 4);
+}
+
+// The worker threads are shared, so batches from several threads at once must still all be hashed
+TEST(dmCrypt, HashBuffersConcurrent)
+{
+    const uint32_t num_threads = 3;
+    const uint32_t num_buffers = 16;
+    const uint32_t buffer_size = 128 * 1024;
+    uint8_t* data = new uint8_t[buffer_size + num_threads * num_buffers];
+    for (uint32_t i = 0; i < buffer_size + num_threads * num_buffers; ++i)
+        data[i] = rand() & 0xff;
+
+    dmCrypt::HashBuffer buffers[num_threads][num_buffers];
+    uint8_t digests[num_threads][num_buffers][20];
+    memset(digests, 0, sizeof(digests));
+    HashBuffersThreadContext contexts[num_threads];
+    dmThread::Thread threads[num_threads];
+    for (uint32_t t = 0; t < num_threads; ++t)
+    {
+        for (uint32_t i = 0; i < num_buffers; ++i)
+        {
+            buffers[t][i].m_Buffer = data + t * num_buffers + i;
+            buffers[t][i].m_BufferLength = buffer_size;
+            buffers[t][i].m_Digest = digests[t][i];
+        }
+        contexts[t].m_Buffers = buffers[t];
+        contexts[t].m_NumBuffers = num_buffers;
+        threads[t] = dmThread::New(HashBuffersThread, 0x20000, &contexts[t], "hash_test");
+    }
+
+    for (uint32_t t = 0; t < num_threads; ++t)
+    {
+        dmThread::Join(threads[t]);
+        for (uint32_t i = 0; i < num_buffers; ++i)
+        {
+            uint8_t expected[20];
+            dmCrypt::Hash(dmCrypt::HASH_ALGORITHM_SHA1, buffers[t][i].m_Buffer, buffers[t][i].m_BufferLength, expected);
+            ASSERT_EQ(0, memcmp(expected, digests[t][i], 20));
+        }
+    }
+
+    delete[] data;
+}
+
+// Verification of a synthetic 500 MB archive (2000 resources of 256 KB each)
+// To keep the memory usage down, the resources share a 32 MB data buffer
+TEST(dmCrypt, ShaPerformance)
+{
+    const uint32_t data_size = 32 * 1024 * 1024;
+    const uint32_t resource_size = 256 * 1024;
+    const uint32_t num_resources = 2000;
+    uint8_t* data = new uint8_t[data_size];
+    for (uint32_t i = 0; i < data_size; ++i)
+        data[i] = (uint8_t)(i * 31 + (i >> 11));
+
+    dmCrypt::HashBuffer* buffers = new dmCrypt::HashBuffer[num_resources];
+    uint8_t* digests = new uint8_t[num_resources * 32];
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        buffers[i].m_Buffer = data + (i * resource_size) % data_size;
+        buffers[i].m_BufferLength = resource_size;
+        buffers[i].m_Digest = digests + i * 32;
+    }
+
+    const float total_mb = (num_resources * (float)resource_size) / (1024.0f * 1024.0f);
+    dmCrypt::HashAlgorithm algorithms[] = {dmCrypt::HASH_ALGORITHM_SHA1, dmCrypt::HASH_ALGORITHM_SHA256};
+    const char* names[] = {"SHA1", "SHA256"};
+    for (uint32_t a = 0; a < 2; ++a)
+    {
+        for (uint32_t hw = 0; hw < 2; ++hw)
+        {
+            if (hw && !dmCrypt::HasHardwareSha())
+                continue;
+            dmCrypt::SetHardwareShaEnabled(hw != 0);
+
+            uint64_t tstart = dmTime::GetTime();
+            for (uint32_t i = 0; i < num_resources; ++i)
+                dmCrypt::Hash(algorithms[a], buffers[i].m_Buffer, buffers[i].m_BufferLength, buffers[i].m_Digest);
+            uint64_t tsingle = dmTime::GetTime() - tstart;
+
+            tstart = dmTime::GetTime();
+            dmCrypt::HashBuffers(algorithms[a], buffers, num_resources, 4);
+            uint64_t tmulti = dmTime::GetTime() - tstart;
+
+            printf("%s %s: %.1f MB in %.3f s (%.1f MB/s), 4 threads: %.3f s (%.1f MB/s)\n", names[a], hw ? "hardware" : "portable",
+                    total_mb, tsingle / 1000000.0f, total_mb / (tsingle / 1000000.0f), tmulti / 1000000.0f, total_mb / (tmulti / 1000000.0f));
+        }
+    }
+    dmCrypt::SetHardwareShaEnabled(true);
+
+    delete[] digests;
+    delete[] buffers;
+    delete[] data;
+}
+
+
 TEST(dmCrypt, Base64Encode)
 {
     const char* source = "Lorem Ipsum";
@@ -0,0 +1,206 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+#include "../dlib/array.h"
+#include "../dlib/frame_arena.h"
+#include "../dlib/thread.h"
+#include "../dlib/time.h"
+
+class dmFrameArenaTest : public jc_test_base_class
+{
+protected:
+    virtual void TearDown()
+    {
+        dmFrameArena::ReleaseMemory();
+    }
+};
+
+TEST_F(dmFrameArenaTest, Alignment)
+{
+    for (uint32_t align = 1; align <= 256; align *= 2)
+    {
+        dmFrameArena::Alloc(3, 1);
+        void* p = dmFrameArena::Alloc(17, align);
+        ASSERT_NE((void*) 0, p);
+        ASSERT_EQ(0u, (uint32_t) ((uintptr_t) p & (align - 1)));
+    }
+
+    // Overflow blocks are aligned as well
+    void* p = dmFrameArena::Alloc(1024 * 1024, 128);
+    ASSERT_NE((void*) 0, p);
+    ASSERT_EQ(0u, (uint32_t) ((uintptr_t) p & 127));
+}
+
+TEST_F(dmFrameArenaTest, Lifetime)
+{
+    uint8_t* frame0 = (uint8_t*) dmFrameArena::Alloc(256);
+    memset(frame0, 0xAB, 256);
+
+    // Still valid during the next frame
+    dmFrameArena::NewFrame();
+    uint8_t* frame1 = (uint8_t*) dmFrameArena::Alloc(256);
+    memset(frame1, 0xCD, 256);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        ASSERT_EQ(0xAB, frame0[i]);
+    }
+
+    // The buffer of the first frame is reused
+    dmFrameArena::NewFrame();
+    uint8_t* frame2 = (uint8_t*) dmFrameArena::Alloc(256);
+    ASSERT_EQ(frame0, frame2);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        ASSERT_EQ(0xCD, frame1[i]);
+    }
+}
+
+TEST_F(dmFrameArenaTest, OverflowGrowsBuffer)
+{
+    const uint32_t count = 64;
+    const uint32_t size = 4 * 1024;
+
+    dmFrameArena::Stats stats;
+    for (uint32_t frame = 0; frame < 6; ++frame)
+    {
+        dmFrameArena::NewFrame();
+        dmFrameArena::GetStats(&stats);
+        uint32_t overflows = stats.m_OverflowAllocations;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint8_t* p = (uint8_t*) dmFrameArena::Alloc(size);
+            ASSERT_NE((uint8_t*) 0, p);
+            memset(p, (int) i, size);
+        }
+
+        dmFrameArena::GetStats(&stats);
+        if (frame >= 4)
+        {
+            // Both buffers have been grown to the high water mark by now
+            ASSERT_EQ(overflows, stats.m_OverflowAllocations);
+        }
+    }
+
+    ASSERT_LE(count * size, stats.m_HighWaterMark);
+    ASSERT_LE(2 * count * size, stats.m_ReservedBytes);
+}
+
+struct ThreadContext
+{
+    uint8_t* m_Pointers[16];
+    uint8_t  m_Value;
+};
+
+static void ThreadAlloc(void* arg)
+{
+    ThreadContext* ctx = (ThreadContext*) arg;
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(ctx->m_Pointers); ++i)
+    {
+        ctx->m_Pointers[i] = (uint8_t*) dmFrameArena::Alloc(1024);
+        memset(ctx->m_Pointers[i], ctx->m_Value, 1024);
+    }
+}
+
+TEST_F(dmFrameArenaTest, Threads)
+{
+    ThreadContext ctx[4];
+    dmThread::Thread threads[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        ctx[i].m_Value = (uint8_t) (i + 1);
+        threads[i] = dmThread::New(ThreadAlloc, 0x80000, &ctx[i], "arena");
+    }
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        dmThread::Join(threads[i]);
+    }
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        for (uint32_t j = 0; j < DM_ARRAY_SIZE(ctx[i].m_Pointers); ++j)
+        {
+            for (uint32_t k = 0; k < 1024; ++k)
+            {
+                ASSERT_EQ(ctx[i].m_Value, ctx[i].m_Pointers[j][k]);
+            }
+        }
+    }
+
+    dmFrameArena::Stats stats;
+    dmFrameArena::GetStats(&stats);
+    ASSERT_LE(4u, stats.m_ArenaCount);
+}
+
+// Simulates the transient allocations of a frame: a few hundred short lived arrays of varying size
+TEST_F(dmFrameArenaTest, Bench)
+{
+    const uint32_t frame_count = 200;
+    const uint32_t alloc_count = 500;
+    void* pointers[alloc_count];
+
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t frame = 0; frame < frame_count; ++frame)
+    {
+        for (uint32_t i = 0; i < alloc_count; ++i)
+        {
+            uint32_t size = 16 + (i * 37) % 2048;
+            pointers[i] = malloc(size);
+            memset(pointers[i], 0, 16);
+        }
+        for (uint32_t i = 0; i < alloc_count; ++i)
+        {
+            free(pointers[i]);
+        }
+    }
+    uint64_t malloc_time = dmTime::GetTime() - start;
+
+    dmFrameArena::Stats before;
+    dmFrameArena::GetStats(&before);
+
+    start = dmTime::GetTime();
+    for (uint32_t frame = 0; frame < frame_count; ++frame)
+    {
+        dmFrameArena::NewFrame();
+        for (uint32_t i = 0; i < alloc_count; ++i)
+        {
+            uint32_t size = 16 + (i * 37) % 2048;
+            pointers[i] = dmFrameArena::Alloc(size);
+            memset(pointers[i], 0, 16);
+        }
+    }
+    uint64_t arena_time = dmTime::GetTime() - start;
+
+    dmFrameArena::Stats after;
+    dmFrameArena::GetStats(&after);
+    uint32_t system_allocations = after.m_SystemAllocations - before.m_SystemAllocations;
+
+    printf("%u frames of %u allocations: malloc/free %.3f ms (%u allocator calls), frame arena %.3f ms (%u allocator calls)\n",
+            frame_count, alloc_count, malloc_time / 1000.0f, frame_count * alloc_count * 2, arena_time / 1000.0f, system_allocations);
+
+    // Only the first frames overflow, once the buffers have grown the frames need no system allocations at all
+    ASSERT_GT(frame_count * alloc_count / 10, system_allocations);
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
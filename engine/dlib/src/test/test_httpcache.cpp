@@ -17,6 +17,10 @@
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include <dlib/http_cache.h>
+#include <dlib/http_client.h>
+#include <dlib/http_server.h>
+#include <dlib/atomic.h>
+#include <dlib/thread.h>
 #include <dlib/log.h>
 #include <dlib/sys.h>
 #include <dlib/time.h>
@@ -71,18 +75,16 @@ public:
 
     dmHttpCache::Result Get(dmHttpCache::HCache cache, const char* uri, const char* etag, void** content, uint64_t* checksum, uint32_t* size_out = 0)
     {
-        FILE* f = 0;
+        dmHttpCache::HCacheReader reader = 0;
         dmHttpCache::Result r;
-        r = dmHttpCache::Get(cache, uri, etag, &f, checksum);
+        r = dmHttpCache::Get(cache, uri, etag, &reader, checksum);
         if (r != dmHttpCache::RESULT_OK)
             return r;
 
-        fseek(f, 0, SEEK_END);
-        size_t size = ftell(f);
-        fseek(f, 0, SEEK_SET);
+        uint32_t size = dmHttpCache::GetContentSize(reader);
 
-        void* buffer = malloc(size);
-        size_t n_read = fread(buffer, 1, size, f);
+        void* buffer = malloc(size + 1);
+        uint32_t n_read = dmHttpCache::Read(reader, buffer, size + 1);
         // ... not ASSERT_EQ here due to
         // ...assertions that generate a fatal failure (FAIL* and ASSERT_*) can only be used in void-returning functions...
         // http://code.google.com/p/googletest/wiki/AdvancedGuide
@@ -90,7 +92,7 @@ public:
         *content = buffer;
         if (size_out)
             *size_out = size;
-        dmHttpCache::Release(cache, uri, etag, f);
+        dmHttpCache::Release(cache, uri, etag, reader);
 
         return dmHttpCache::RESULT_OK;
     }
@@ -123,7 +125,7 @@ TEST_F(dmHttpCacheTest, PathIsFile)
 TEST_F(dmHttpCacheTest, CorruptIndex)
 {
     char index_path[1024];
-    dmSnPrintf(index_path, sizeof(index_path), "%s/index", m_Path);
+    dmSnPrintf(index_path, sizeof(index_path), "%s/journal", m_Path);
 
     dmSys::Mkdir(m_Path, 0755);
     dmHttpCache::HCache cache;
@@ -270,6 +272,10 @@ static void CorruptDirs(void* ctx, const char* path, bool isdir)
     {
         dmSys::IterateTree(path, false, false, ctx, CorruptFile);
     }
+    else if (!isdir && basename && strncmp(basename+1, "pack_", 5) == 0)
+    {
+        CorruptFile(ctx, path, isdir);
+    }
 }
 
 TEST_F(dmHttpCacheTest, CorruptContent)
@@ -330,6 +336,10 @@ static void MissingContent_Dirs(void* ctx, const char* path, bool isdir)
     {
         dmSys::IterateTree(path, false, false, ctx, MissingContent_File);
     }
+    else if (!isdir && basename && strncmp(basename+1, "pack_", 5) == 0)
+    {
+        MissingContent_File(ctx, path, isdir);
+    }
 }
 
 TEST_F(dmHttpCacheTest, MissingContent)
@@ -385,9 +395,9 @@ TEST_F(dmHttpCacheTest, UpdateReadlocked)
     r = Put(cache, "uri", "etag", "data", strlen("data"));
     ASSERT_EQ(dmHttpCache::RESULT_OK, r);
 
-    FILE* file;
+    dmHttpCache::HCacheReader reader;
     uint64_t checksum;
-    r = dmHttpCache::Get(cache, "uri", "etag", &file, &checksum);
+    r = dmHttpCache::Get(cache, "uri", "etag", &reader, &checksum);
     ASSERT_EQ(dmHashString64("data"), checksum);
     ASSERT_EQ(dmHttpCache::RESULT_OK, r);
 
@@ -397,7 +407,7 @@ TEST_F(dmHttpCacheTest, UpdateReadlocked)
     r = Put(cache, "uri", "etag2", "data", strlen("data"));
     ASSERT_EQ(dmHttpCache::RESULT_LOCKED, r);
 
-    dmHttpCache::Release(cache, "uri", "etag", file);
+    dmHttpCache::Release(cache, "uri", "etag", reader);
 
     r = dmHttpCache::Close(cache);
     ASSERT_EQ(dmHttpCache::RESULT_OK, r);
@@ -415,9 +425,9 @@ TEST_F(dmHttpCacheTest, GetWriteLocked)
     r = dmHttpCache::Begin(cache, "uri", "etag", 0, &cache_creator);
     ASSERT_EQ(dmHttpCache::RESULT_OK, r);
 
-    FILE* file;
+    dmHttpCache::HCacheReader reader;
     uint64_t checksum;
-    r = dmHttpCache::Get(cache, "uri", "etag", &file, &checksum);
+    r = dmHttpCache::Get(cache, "uri", "etag", &reader, &checksum);
     ASSERT_EQ(dmHttpCache::RESULT_LOCKED, r);
 
     dmHttpCache::Add(cache, cache_creator, "data", 4);
@@ -479,9 +489,9 @@ TEST_F(dmHttpCacheTest, PartialUpdate)
     r = dmHttpCache::Begin(cache, "uri", "etag", 0, &cache_creator);
     ASSERT_EQ(dmHttpCache::RESULT_OK, r);
 
-    FILE* file;
+    dmHttpCache::HCacheReader reader;
     uint64_t checksum;
-    r = dmHttpCache::Get(cache, "uri", "etag", &file, &checksum);
+    r = dmHttpCache::Get(cache, "uri", "etag", &reader, &checksum);
     ASSERT_EQ(dmHttpCache::RESULT_LOCKED, r);
 
     dmHttpCache::Add(cache, cache_creator, "data", 4);
@@ -764,6 +774,650 @@ TEST_F(dmHttpCacheTest, Persist)
     dmHttpCache::Close(cache);
 }
 
+static uint32_t CountFiles(const char* path, const char* prefix)
+{
+    struct Context
+    {
+        const char* m_Prefix;
+        uint32_t    m_Count;
+        static void Callback(void* ctx, const char* path, bool isdir)
+        {
+            Context* context = (Context*) ctx;
+            const char* basename = strrchr(path, '/');
+            if (!isdir && basename && strncmp(basename + 1, context->m_Prefix, strlen(context->m_Prefix)) == 0)
+                context->m_Count++;
+        }
+    };
+    Context context = {prefix, 0};
+    dmSys::IterateTree(path, true, false, &context, Context::Callback);
+    return context.m_Count;
+}
+
+static void MakeContent(char* buffer, uint32_t size, int seed)
+{
+    for (uint32_t i = 0; i < size; ++i)
+        buffer[i] = (char) ('a' + (i * 7 + seed) % 26);
+}
+
+TEST_F(dmHttpCacheTest, PackedContent)
+{
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    // Small content is packed, large content gets a file of its own
+    const uint32_t large_size = 64 * 1024;
+    char* large = (char*) malloc(large_size);
+    MakeContent(large, large_size, 0);
+    for (int i = 0; i < 100; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        r = Put(cache, uri, "etag", uri, strlen(uri));
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    }
+    r = Put(cache, "large", "etag", large, large_size);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    ASSERT_EQ(1U, CountFiles(m_Path, "pack_"));
+    ASSERT_EQ(101U, dmHttpCache::GetEntryCount(cache));
+    ASSERT_EQ(large_size + 190U, dmHttpCache::GetTotalSize(cache));
+
+    dmHttpCache::Close(cache);
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(101U, dmHttpCache::GetEntryCount(cache));
+    ASSERT_EQ(large_size + 190U, dmHttpCache::GetTotalSize(cache));
+
+    for (int i = 0; i < 100; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        void* buffer = 0;
+        uint64_t checksum;
+        uint32_t size;
+        r = Get(cache, uri, "etag", &buffer, &checksum, &size);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        ASSERT_EQ(strlen(uri), size);
+        ASSERT_EQ(dmHashString64(uri), checksum);
+        ASSERT_TRUE(memcmp(uri, buffer, size) == 0);
+        free(buffer);
+    }
+
+    void* buffer = 0;
+    uint64_t checksum;
+    uint32_t size;
+    r = Get(cache, "large", "etag", &buffer, &checksum, &size);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(large_size, size);
+    ASSERT_EQ(dmHashBuffer64(large, large_size), checksum);
+    ASSERT_TRUE(memcmp(large, buffer, size) == 0);
+    free(buffer);
+    free(large);
+
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+}
+
+TEST_F(dmHttpCacheTest, Repack)
+{
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    // Fill a few pack files, and then replace most of the content
+    char content[8 * 1024];
+    for (int i = 0; i < 400; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        MakeContent(content, sizeof(content), i);
+        r = Put(cache, uri, "etag", content, sizeof(content));
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    }
+    uint32_t pack_count = CountFiles(m_Path, "pack_");
+    ASSERT_LT(1U, pack_count);
+
+    for (int i = 0; i < 400; ++i)
+    {
+        if (i % 4 == 0)
+            continue;
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        MakeContent(content, 16, i + 1);
+        r = Put(cache, uri, "etag2", content, 16);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    }
+
+    r = dmHttpCache::Flush(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_GT(pack_count, CountFiles(m_Path, "pack_"));
+
+    dmHttpCache::Close(cache);
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(400U, dmHttpCache::GetEntryCount(cache));
+
+    for (int i = 0; i < 400; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        uint32_t expected_size = i % 4 == 0 ? sizeof(content) : 16;
+        MakeContent(content, expected_size, i % 4 == 0 ? i : i + 1);
+
+        void* buffer = 0;
+        uint64_t checksum;
+        uint32_t size;
+        r = Get(cache, uri, i % 4 == 0 ? "etag" : "etag2", &buffer, &checksum, &size);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        ASSERT_EQ(expected_size, size);
+        ASSERT_TRUE(memcmp(content, buffer, size) == 0);
+        free(buffer);
+    }
+
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+}
+
+TEST_F(dmHttpCacheTest, Eviction)
+{
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    params.m_MaxCacheSize = 8 * 1024;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    char content[1024];
+    for (int i = 0; i < 8; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        MakeContent(content, sizeof(content), i);
+        r = Put(cache, uri, "etag", content, sizeof(content));
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        dmTime::Sleep(1000);
+    }
+    ASSERT_EQ(8U, dmHttpCache::GetEntryCount(cache));
+
+    // Use the first entry, so that "1" and "2" are the least recently used
+    void* buffer = 0;
+    uint64_t checksum;
+    r = Get(cache, "0", "etag", &buffer, &checksum);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    free(buffer);
+    dmTime::Sleep(1000);
+
+    r = Put(cache, "8", "etag", content, sizeof(content));
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_GE(params.m_MaxCacheSize, dmHttpCache::GetTotalSize(cache));
+
+    char tag_buffer[16];
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::GetETag(cache, "0", tag_buffer, sizeof(tag_buffer)));
+    ASSERT_EQ(dmHttpCache::RESULT_NO_ENTRY, dmHttpCache::GetETag(cache, "1", tag_buffer, sizeof(tag_buffer)));
+    ASSERT_EQ(dmHttpCache::RESULT_NO_ENTRY, dmHttpCache::GetETag(cache, "2", tag_buffer, sizeof(tag_buffer)));
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::GetETag(cache, "8", tag_buffer, sizeof(tag_buffer)));
+
+    // Content larger than the cache isn't cached
+    char* large = (char*) malloc(params.m_MaxCacheSize + 1);
+    r = Put(cache, "large", "etag", large, params.m_MaxCacheSize + 1);
+    ASSERT_EQ(dmHttpCache::RESULT_OUT_OF_RESOURCES, r);
+    ASSERT_EQ(dmHttpCache::RESULT_NO_ENTRY, dmHttpCache::GetETag(cache, "large", tag_buffer, sizeof(tag_buffer)));
+    free(large);
+
+    // The evictions are persisted
+    uint32_t count = dmHttpCache::GetEntryCount(cache);
+    dmHttpCache::Close(cache);
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(count, dmHttpCache::GetEntryCount(cache));
+    ASSERT_EQ(dmHttpCache::RESULT_NO_ENTRY, dmHttpCache::GetETag(cache, "1", tag_buffer, sizeof(tag_buffer)));
+
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+}
+
+TEST_F(dmHttpCacheTest, JournalCompaction)
+{
+    char journal_path[1024];
+    dmSnPrintf(journal_path, sizeof(journal_path), "%s/journal", m_Path);
+
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    // Updating the same few entries over and over again must not grow the journal without bounds
+    for (int i = 0; i < 2000; ++i)
+    {
+        char uri[16];
+        char etag[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i % 10);
+        dmSnPrintf(etag, sizeof(etag), "%d", i);
+        r = Put(cache, uri, etag, etag, strlen(etag));
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        if (i % 100 == 0)
+        {
+            r = dmHttpCache::Flush(cache);
+            ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        }
+    }
+    r = dmHttpCache::Flush(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    dmSys::StatInfo info;
+    ASSERT_EQ(dmSys::RESULT_OK, dmSys::Stat(journal_path, &info));
+    ASSERT_GT(128U * 1024U, info.m_Size);
+
+    dmHttpCache::Close(cache);
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(10U, dmHttpCache::GetEntryCount(cache));
+
+    void* buffer = 0;
+    uint64_t checksum;
+    uint32_t size;
+    r = Get(cache, "9", "1999", &buffer, &checksum, &size);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(4U, size);
+    ASSERT_TRUE(memcmp("1999", buffer, size) == 0);
+    free(buffer);
+
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+}
+
+static bool ReadFile(const char* path, char** data, uint32_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    *size = (uint32_t) ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *data = (char*) malloc(*size);
+    bool ok = fread(*data, 1, *size, f) == *size;
+    fclose(f);
+    return ok;
+}
+
+static bool WriteFile(const char* path, const char* data, uint32_t size)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    fclose(f);
+    return ok;
+}
+
+struct CopyDirContext
+{
+    const char* m_Src;
+    const char* m_Dst;
+};
+
+static void CopyDirFile(void* ctx, const char* path, bool isdir)
+{
+    CopyDirContext* context = (CopyDirContext*) ctx;
+    char dst[1024];
+    dmSnPrintf(dst, sizeof(dst), "%s%s", context->m_Dst, path + strlen(context->m_Src));
+    if (isdir)
+    {
+        dmSys::Mkdir(dst, 0755);
+        return;
+    }
+    char* data;
+    uint32_t size;
+    if (ReadFile(path, &data, &size))
+    {
+        WriteFile(dst, data, size);
+        free(data);
+    }
+}
+
+// Copies the cache directory of an open cache, ie the state on disk if the process would crash
+static void SnapshotCache(const char* src, const char* dst)
+{
+    dmSys::RmTree(dst);
+    dmSys::Mkdir(dst, 0755);
+    CopyDirContext context = {src, dst};
+    dmSys::IterateTree(src, true, true, &context, CopyDirFile);
+}
+
+// Checks that every entry in the cache is either missing or has the correct content
+static uint32_t CheckCacheContent(dmHttpCacheTest* test, const char* path, uint32_t num_entries)
+{
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    EXPECT_EQ(dmHttpCache::RESULT_OK, r);
+
+    uint32_t found = 0;
+    char content[2048];
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        uint32_t expected_size = (i * 97) % sizeof(content);
+        MakeContent(content, expected_size, i);
+
+        void* buffer = 0;
+        uint64_t checksum;
+        uint32_t size;
+        r = test->Get(cache, uri, "etag", &buffer, &checksum, &size);
+        if (r == dmHttpCache::RESULT_NO_ENTRY)
+            continue;
+        EXPECT_EQ(dmHttpCache::RESULT_OK, r);
+        EXPECT_EQ(expected_size, size);
+        EXPECT_EQ(dmHashBuffer64(content, expected_size), checksum);
+        EXPECT_TRUE(memcmp(content, buffer, expected_size) == 0);
+        free(buffer);
+        ++found;
+    }
+    EXPECT_EQ(found, dmHttpCache::GetEntryCount(cache));
+    dmHttpCache::Close(cache);
+    return found;
+}
+
+TEST_F(dmHttpCacheTest, CrashConsistency)
+{
+    char crash_path[1024];
+    dmTestUtil::MakeHostPath(crash_path, sizeof(crash_path), "tmp/cache_crash");
+    char journal_path[1024];
+    dmSnPrintf(journal_path, sizeof(journal_path), "%s/journal", crash_path);
+
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    const uint32_t num_entries = 50;
+    char content[2048];
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        uint32_t size = (i * 97) % sizeof(content);
+        MakeContent(content, size, i);
+        r = Put(cache, uri, "etag", content, size);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    }
+
+    // Crash without closing the cache
+    SnapshotCache(m_Path, crash_path);
+    ASSERT_EQ(num_entries, CheckCacheContent(this, crash_path, num_entries));
+
+    // A write torn at any point, only loses the entries from that point
+    SnapshotCache(m_Path, crash_path);
+    char* journal;
+    uint32_t journal_size;
+    ASSERT_TRUE(ReadFile(journal_path, &journal, &journal_size));
+    uint32_t prev_found = 0;
+    for (uint32_t size = 0; size <= journal_size; size += 61)
+    {
+        SnapshotCache(m_Path, crash_path);
+        ASSERT_TRUE(WriteFile(journal_path, journal, size));
+        uint32_t found = CheckCacheContent(this, crash_path, num_entries);
+        ASSERT_LE(prev_found, found);
+        prev_found = found;
+    }
+
+    // Garbage in the middle of the journal
+    SnapshotCache(m_Path, crash_path);
+    journal[journal_size / 2] ^= 0xff;
+    ASSERT_TRUE(WriteFile(journal_path, journal, journal_size));
+    uint32_t found = CheckCacheContent(this, crash_path, num_entries);
+    ASSERT_LT(0U, found);
+    ASSERT_GT(num_entries, found);
+    free(journal);
+
+    // Content written without a journal record (crash before the record was written) is removed
+    SnapshotCache(m_Path, crash_path);
+    ASSERT_TRUE(WriteFile(journal_path, 0, 0));
+    ASSERT_EQ(0U, CheckCacheContent(this, crash_path, num_entries));
+    ASSERT_EQ(0U, CountFiles(crash_path, "pack_"));
+
+    dmSys::RmTree(crash_path);
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+}
+
+// Counts the files of content stored in a file of its own, see ContentFilePath() in http_cache.cpp
+static uint32_t CountContentFiles(const char* path)
+{
+    struct Context
+    {
+        uint32_t m_Count;
+        static void Callback(void* ctx, const char* path, bool isdir)
+        {
+            Context* context = (Context*) ctx;
+            const char* basename = strrchr(path, '/');
+            if (!isdir && basename && strlen(basename + 1) == 14)
+                context->m_Count++;
+        }
+    };
+    Context context = {0};
+    dmSys::IterateTree(path, true, false, &context, Context::Callback);
+    return context.m_Count;
+}
+
+TEST_F(dmHttpCacheTest, OrphanedContentFiles)
+{
+    char journal_path[1024];
+    dmSnPrintf(journal_path, sizeof(journal_path), "%s/journal", m_Path);
+
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    dmHttpCache::Result r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    // Large enough to get files of their own
+    const uint32_t num_entries = 3;
+    const uint32_t size = 20 * 1024;
+    char* content = (char*) malloc(size);
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        MakeContent(content, size, i);
+        r = Put(cache, uri, "etag", content, size);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    }
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(num_entries, CountContentFiles(m_Path));
+
+    // Content without an entry, and a file that isn't content
+    char dir_path[1024];
+    char orphan_path[1024];
+    char other_path[1024];
+    dmSnPrintf(dir_path, sizeof(dir_path), "%s/0f", m_Path);
+    dmSnPrintf(orphan_path, sizeof(orphan_path), "%s/0123456789abcd", dir_path);
+    dmSnPrintf(other_path, sizeof(other_path), "%s/other", dir_path);
+    if (!dmSys::Exists(dir_path))
+        dmSys::Mkdir(dir_path, 0755);
+    ASSERT_TRUE(WriteFile(orphan_path, content, size));
+    ASSERT_TRUE(WriteFile(other_path, content, 16));
+
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_FALSE(dmSys::Exists(orphan_path));
+    ASSERT_TRUE(dmSys::Exists(other_path));
+    ASSERT_EQ(num_entries, CountContentFiles(m_Path));
+    ASSERT_EQ(num_entries, dmHttpCache::GetEntryCount(cache));
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        char uri[16];
+        dmSnPrintf(uri, sizeof(uri), "%d", i);
+        void* buffer = 0;
+        uint64_t checksum;
+        uint32_t content_size;
+        r = Get(cache, uri, "etag", &buffer, &checksum, &content_size);
+        ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+        ASSERT_EQ(size, content_size);
+        MakeContent(content, size, i);
+        ASSERT_EQ(0, memcmp(content, buffer, size));
+        free(buffer);
+    }
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    // Content written without a journal record (crash before the record was written) is removed
+    char* journal;
+    uint32_t journal_size;
+    ASSERT_TRUE(ReadFile(journal_path, &journal, &journal_size));
+    ASSERT_TRUE(WriteFile(journal_path, journal, 8)); // Only the journal header
+    free(journal);
+
+    r = dmHttpCache::Open(&params, &cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+    ASSERT_EQ(0U, dmHttpCache::GetEntryCount(cache));
+    ASSERT_EQ(0U, CountContentFiles(m_Path));
+    r = dmHttpCache::Close(cache);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, r);
+
+    free(content);
+}
+
+// A local stand-in for a content server, serving small resources with etags
+struct StandInServer
+{
+    dmHttpServer::HServer m_Server;
+    dmThread::Thread      m_Thread;
+    int32_atomic_t        m_Quit;
+    uint32_t              m_Requests;
+};
+
+static void StandInServerResponse(void* user_data, const dmHttpServer::Request* request)
+{
+    StandInServer* server = (StandInServer*) user_data;
+    server->m_Requests++;
+
+    char content[1024];
+    MakeContent(content, sizeof(content), atoi(request->m_Resource + 1));
+    char etag[64];
+    dmSnPrintf(etag, sizeof(etag), "\"%s\"", request->m_Resource + 1);
+    dmHttpServer::SendAttribute(request, "ETag", etag);
+    dmHttpServer::Send(request, content, sizeof(content));
+}
+
+static void StandInServerThread(void* user_data)
+{
+    StandInServer* server = (StandInServer*) user_data;
+    while (!dmAtomicGet32(&server->m_Quit))
+    {
+        dmHttpServer::Update(server->m_Server);
+        dmTime::Sleep(100);
+    }
+}
+
+struct BenchmarkClient
+{
+    uint32_t m_Received;
+    int      m_Status;
+};
+
+static void BenchmarkHttpContent(dmHttpClient::HResponse, void* user_data, int status_code, const void* content_data, uint32_t content_data_size)
+{
+    BenchmarkClient* client = (BenchmarkClient*) user_data;
+    client->m_Status = status_code;
+    client->m_Received += content_data_size;
+}
+
+TEST_F(dmHttpCacheTest, Throughput)
+{
+    const uint32_t num_resources = 200;
+
+    StandInServer server;
+    server.m_Quit = 0;
+    server.m_Requests = 0;
+    dmHttpServer::NewParams server_params;
+    server_params.m_Userdata = &server;
+    server_params.m_HttpResponse = StandInServerResponse;
+    ASSERT_EQ(dmHttpServer::RESULT_OK, dmHttpServer::New(&server_params, 0, &server.m_Server));
+    dmSocket::Address address;
+    uint16_t port;
+    dmHttpServer::GetName(server.m_Server, &address, &port);
+    server.m_Thread = dmThread::New(StandInServerThread, 0x80000, &server, "standin");
+
+    dmHttpCache::HCache cache;
+    dmHttpCache::NewParams params;
+    params.m_Path = m_Path;
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::Open(&params, &cache));
+
+    BenchmarkClient client_data;
+    client_data.m_Received = 0;
+    dmHttpClient::NewParams client_params;
+    client_params.m_Userdata = &client_data;
+    client_params.m_HttpContent = BenchmarkHttpContent;
+    client_params.m_HttpCache = cache;
+    dmHttpClient::HClient client = dmHttpClient::New(&client_params, "localhost", port);
+    ASSERT_NE((void*) 0, client);
+
+    // Cold: every resource is fetched from the server and written to the cache
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        char path[32];
+        dmSnPrintf(path, sizeof(path), "/%u", i);
+        ASSERT_EQ(dmHttpClient::RESULT_OK, dmHttpClient::Get(client, path));
+    }
+    uint64_t cold_time = dmTime::GetTime() - start;
+    ASSERT_EQ(num_resources, server.m_Requests);
+    ASSERT_EQ(num_resources * 1024, client_data.m_Received);
+    ASSERT_EQ(num_resources, dmHttpCache::GetEntryCount(cache));
+
+    start = dmTime::GetTime();
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::Flush(cache));
+    uint64_t flush_time = dmTime::GetTime() - start;
+
+    // Warm: the verified entries are read from the cache without contacting the server
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        // The client appends the path to the host with a separating slash
+        char uri[64];
+        dmSnPrintf(uri, sizeof(uri), "http://localhost:%u//%u", port, i);
+        dmHttpCache::SetVerified(cache, uri, true);
+    }
+    dmHttpCache::SetConsistencyPolicy(cache, dmHttpCache::CONSISTENCY_POLICY_TRUST_CACHE);
+    client_data.m_Received = 0;
+    start = dmTime::GetTime();
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        char path[32];
+        dmSnPrintf(path, sizeof(path), "/%u", i);
+        dmHttpClient::Get(client, path);
+        ASSERT_EQ(304, client_data.m_Status);
+    }
+    uint64_t warm_time = dmTime::GetTime() - start;
+    ASSERT_EQ(num_resources, server.m_Requests);
+    ASSERT_EQ(num_resources * 1024, client_data.m_Received);
+
+    start = dmTime::GetTime();
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::Flush(cache));
+    uint64_t touch_flush_time = dmTime::GetTime() - start;
+
+    printf("%u resources: cold %.1f req/s, warm %.1f req/s, flush %.3f ms, flush after reads %.3f ms, %u pack files\n",
+            num_resources, num_resources / (cold_time / 1000000.0), num_resources / (warm_time / 1000000.0),
+            flush_time / 1000.0, touch_flush_time / 1000.0, CountFiles(m_Path, "pack_"));
+
+    dmHttpClient::Delete(client);
+    ASSERT_EQ(dmHttpCache::RESULT_OK, dmHttpCache::Close(cache));
+
+    dmAtomicStore32(&server.m_Quit, 1);
+    dmThread::Join(server.m_Thread);
+    dmHttpServer::Delete(server.m_Server);
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -14,15 +14,19 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <algorithm>
 #include <testmain/testmain.h>
 #include "../dlib/array.h"
 #include "../dlib/atomic.h"
 #include "../dlib/dlib.h"
 #include "../dlib/hash.h"
 #include "../dlib/log.h"
+#include "../dlib/message.h"
 #include "../dlib/mutex.h"
 #include "../dlib/dstrings.h"
 #include "../dlib/socket.h"
+#include "../dlib/spinlock.h"
 #include "../dlib/time.h"
 #include "../dlib/thread.h"
 #include "../dlib/path.h"
@@ -266,6 +270,106 @@ TEST(dmLog, TestCapture)
     ASSERT_STREQ(ExpectedOutput, g_LogListenerOutput.Begin());
 }
 
+// Deferred messages are formatted on the log thread, from a copy of the arguments
+TEST(dmLog, DeferredFormatting)
+{
+    g_LogListenerOutput.SetSize(0);
+    dmLog::LogParams params;
+    dmLog::LogInitialize(&params);
+    dmLogRegisterListener(TestLogCaptureCallback);
+
+    char str[] = "abcdef";
+    dmLogInfo("[%*.*s]", 6, 3, str);
+    dmLogInfo("[%-*.*s]", 5, 2, str);
+    dmLogInfo("[%.*s]", 4, str);
+    str[0] = 'X'; // The string is copied by the log call
+    dmLogInfo("[%Lf]", (long double)1.25);
+    dmLogInfo("[%5.1f%%]", 99.5);
+    dmLogInfo("[%d %u %x %c %s %lld]", -1, 2U, 255, 'z', "str", (long long)1 << 40);
+
+    // These can't be deferred, and are formatted on the calling thread
+    int count = 0;
+    dmLogInfo("[abc%n]", &count);
+    ASSERT_EQ(4, count);
+    dmLogInfo("[%ls]", L"wide");
+
+    dmLog::LogFinalize();
+    dmLogUnregisterListener(TestLogCaptureCallback);
+
+    g_LogListenerOutput.SetCapacity(g_LogListenerOutput.Size()+1);
+    g_LogListenerOutput.Push(0);
+
+    const char* ExpectedOutput =
+                "INFO:DLIB: [   abc]\n"
+                "INFO:DLIB: [ab   ]\n"
+                "INFO:DLIB: [abcd]\n"
+                "INFO:DLIB: [1.250000]\n"
+                "INFO:DLIB: [ 99.5%]\n"
+                "INFO:DLIB: [-1 2 ff z str 1099511627776]\n"
+                "INFO:DLIB: [abc]\n"
+                "INFO:DLIB: [wide]\n";
+
+    ASSERT_STREQ(ExpectedOutput, g_LogListenerOutput.Begin());
+}
+
+// Errors are output directly, after the earlier messages of the same thread
+TEST(dmLog, ErrorOutputOrder)
+{
+    g_LogListenerOutput.SetSize(0);
+    dmLog::LogParams params;
+    dmLog::LogInitialize(&params);
+    dmLogRegisterListener(TestLogCaptureCallback);
+
+    dmLogInfo("first");
+    dmLogError("second");
+    // The log thread has output the info message by the time the error call returns
+    uint32_t info_len = (uint32_t)strlen("INFO:DLIB: first\n");
+    ASSERT_LE(info_len, g_LogListenerOutput.Size());
+    ASSERT_EQ(0, memcmp("INFO:DLIB: first\n", g_LogListenerOutput.Begin(), info_len));
+
+    dmLog::LogFinalize();
+    dmLogUnregisterListener(TestLogCaptureCallback);
+
+    g_LogListenerOutput.SetCapacity(g_LogListenerOutput.Size()+1);
+    g_LogListenerOutput.Push(0);
+    ASSERT_STREQ("INFO:DLIB: first\nERROR:DLIB: second\n", g_LogListenerOutput.Begin());
+}
+
+int32_atomic_t g_RingTestListenerCount = 0;
+static void RingTestLogListener(LogSeverity severity, const char* domain, const char* formatted_string)
+{
+    if (strstr(formatted_string, "INFO:DLIB: Thread ") == formatted_string)
+        dmAtomicAdd32(&g_RingTestListenerCount, 1);
+}
+
+static void LogOnceThread(void* arg)
+{
+    dmLogInfo("Thread %d", (int)(uintptr_t)arg);
+}
+
+// The log buffer of a thread is reused once the thread exits
+TEST(dmLog, ReuseThreadLogRing)
+{
+    dmLog::LogParams params;
+    dmLog::LogInitialize(&params);
+    g_RingTestListenerCount = 0;
+    dmLogRegisterListener(RingTestLogListener);
+
+    const int num_threads = 100;
+    uint32_t ring_count = 0;
+    for (int i = 0; i < num_threads; ++i)
+    {
+        dmThread::Thread thread = dmThread::New(LogOnceThread, 0x80000, (void*)(uintptr_t)i, "test");
+        dmThread::Join(thread);
+        if (i == 0)
+            ring_count = dmLog::GetLogRingCount();
+    }
+    ASSERT_EQ(ring_count, dmLog::GetLogRingCount());
+
+    dmLog::LogFinalize();
+    dmLogUnregisterListener(RingTestLogListener);
+    ASSERT_EQ(num_threads, dmAtomicGet32(&g_RingTestListenerCount));
+}
 
 static void LogThreadWithLogCalls(void* arg)
 {
@@ -310,6 +414,161 @@ TEST(dmLog, TestLogThreadWithLogCalls)
     dLib::SetDebugMode(true);
 }
 
+// A copy of the previous log path, where the message was formatted on the calling thread,
+// and posted to the log thread through a message socket
+struct LegacyLogContext
+{
+    dmSpinlock::Spinlock    m_Lock;
+    dmMessage::HSocket      m_Socket;
+    int32_atomic_t          m_Run;
+} g_LegacyLogContext;
+
+static void LegacyLogInternal(LogSeverity severity, const char* domain, const char* format, ...)
+{
+    va_list lst;
+    va_start(lst, format);
+
+    char tmp_buf[sizeof(dmLog::LogMessage) + dmLog::MAX_STRING_SIZE];
+    dmLog::LogMessage* msg = (dmLog::LogMessage*) &tmp_buf[0];
+    char* str_buf = &tmp_buf[sizeof(dmLog::LogMessage)];
+
+    int n = dmSnPrintf(str_buf, dmLog::MAX_STRING_SIZE, "%s:%s: ", "INFO", domain);
+    n += vsnprintf(str_buf + n, dmLog::MAX_STRING_SIZE - n, format, lst);
+    n += dmSnPrintf(str_buf + n, dmLog::MAX_STRING_SIZE - n, "\n");
+    va_end(lst);
+
+    DM_SPINLOCK_SCOPED_LOCK(g_LegacyLogContext.m_Lock);
+    msg->m_Type = dmLog::LogMessage::MESSAGE;
+    msg->m_Severity = severity;
+    dmStrlCpy(msg->m_Domain, domain, sizeof(msg->m_Domain));
+    dmMessage::URL receiver;
+    receiver.m_Socket = g_LegacyLogContext.m_Socket;
+    receiver.m_Path = 0;
+    receiver.m_Fragment = 0;
+    dmMessage::Post(0, &receiver, 0, 0, 0, msg, sizeof(dmLog::LogMessage) + n + 1, 0);
+}
+
+int32_atomic_t g_BenchListenerCount = 0;
+static void BenchLogListener(LogSeverity severity, const char* domain, const char* formatted_string)
+{
+    if (strstr(formatted_string, "INFO:DLIB: Frame ") == formatted_string)
+        dmAtomicAdd32(&g_BenchListenerCount, 1);
+}
+
+static void LegacyLogDispatch(dmMessage::Message* message, void* user_ptr)
+{
+    dmLog::LogMessage* log_message = (dmLog::LogMessage*) &message->m_Data[0];
+    BenchLogListener((LogSeverity)log_message->m_Severity, log_message->m_Domain, log_message->m_Message);
+}
+
+static void LegacyLogThread(void* arg)
+{
+    while (dmAtomicGet32(&g_LegacyLogContext.m_Run))
+    {
+        dmTime::Sleep(1000 * 30);
+        dmMessage::Dispatch(g_LegacyLogContext.m_Socket, LegacyLogDispatch, 0);
+    }
+    dmMessage::Dispatch(g_LegacyLogContext.m_Socket, LegacyLogDispatch, 0);
+}
+
+static const uint32_t BENCH_CALLS_PER_SAMPLE = 16; // The timer has microsecond resolution
+static const uint32_t BENCH_SAMPLE_COUNT = 500;
+
+struct BenchThreadContext
+{
+    bool        m_Legacy;
+    uint32_t    m_Samples[BENCH_SAMPLE_COUNT]; // nanoseconds per call
+};
+
+static void LogBenchThread(void* arg)
+{
+    BenchThreadContext* ctx = (BenchThreadContext*)arg;
+    for (uint32_t i = 0; i < BENCH_SAMPLE_COUNT; ++i)
+    {
+        uint64_t start = dmTime::GetTime();
+        for (uint32_t j = 0; j < BENCH_CALLS_PER_SAMPLE; ++j)
+        {
+            if (ctx->m_Legacy)
+                LegacyLogInternal(LOG_SEVERITY_INFO, DLIB_LOG_DOMAIN, "Frame %u: entity %s moved to (%.2f, %.2f)", i, "player", 1.5f * j, 2.5f);
+            else
+                dmLogInfo("Frame %u: entity %s moved to (%.2f, %.2f)", i, "player", 1.5f * j, 2.5f);
+        }
+        ctx->m_Samples[i] = (uint32_t)((dmTime::GetTime() - start) * 1000 / BENCH_CALLS_PER_SAMPLE);
+        dmTime::Sleep(1000); // A heavy, but sustained, stream of messages
+    }
+}
+
+static void RunLogBench(bool legacy, uint32_t* p50, uint32_t* p99)
+{
+    const int num_threads = 4;
+    dmThread::Thread threads[num_threads];
+    BenchThreadContext* ctx = new BenchThreadContext[num_threads];
+    for (int i = 0; i < num_threads; ++i)
+    {
+        ctx[i].m_Legacy = legacy;
+        threads[i] = dmThread::New(LogBenchThread, 0x80000, &ctx[i], "bench");
+    }
+    for (int i = 0; i < num_threads; ++i)
+    {
+        dmThread::Join(threads[i]);
+    }
+
+    uint32_t* samples = new uint32_t[num_threads * BENCH_SAMPLE_COUNT];
+    uint32_t count = 0;
+    for (int i = 0; i < num_threads; ++i)
+    {
+        for (uint32_t j = 0; j < BENCH_SAMPLE_COUNT; ++j)
+            samples[count++] = ctx[i].m_Samples[j];
+    }
+    std::sort(samples, samples + count);
+    *p50 = samples[count / 2];
+    *p99 = samples[(count * 99) / 100];
+    delete[] samples;
+    delete[] ctx;
+}
+
+TEST(dmLog, CallLatencyBench)
+{
+    dLib::SetDebugMode(false); // avoid spam in the unit tests
+
+    dmLog::LogParams params;
+    dmLog::LogInitialize(&params);
+    g_BenchListenerCount = 0;
+    dmLogRegisterListener(BenchLogListener);
+
+    uint32_t p50, p99;
+    RunLogBench(false, &p50, &p99);
+
+    // Finalizing outputs any pending messages
+    dmLog::LogFinalize();
+    uint32_t dropped = dmLog::GetDroppedMessageCount();
+
+    uint32_t expected_count = 4 * BENCH_SAMPLE_COUNT * BENCH_CALLS_PER_SAMPLE;
+    ASSERT_EQ(expected_count, (uint32_t)dmAtomicGet32(&g_BenchListenerCount) + dropped);
+    // The stream is sustained, so the log thread should keep up with almost all of it
+    ASSERT_LT(dropped, expected_count / 10);
+
+    dmSpinlock::Create(&g_LegacyLogContext.m_Lock);
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::NewSocket("@legacylog", &g_LegacyLogContext.m_Socket));
+    dmAtomicStore32(&g_LegacyLogContext.m_Run, 1);
+    dmThread::Thread legacy_thread = dmThread::New(LegacyLogThread, 0x80000, 0, "legacylog");
+    g_BenchListenerCount = 0;
+
+    uint32_t legacy_p50, legacy_p99;
+    RunLogBench(true, &legacy_p50, &legacy_p99);
+
+    dmAtomicStore32(&g_LegacyLogContext.m_Run, 0);
+    dmThread::Join(legacy_thread);
+    dmMessage::DeleteSocket(g_LegacyLogContext.m_Socket);
+    dmSpinlock::Destroy(&g_LegacyLogContext.m_Lock);
+
+    ASSERT_EQ(expected_count, (uint32_t)dmAtomicGet32(&g_BenchListenerCount));
+
+    dLib::SetDebugMode(true);
+    printf("Log call latency, 4 threads (ns per call): deferred p50 %u p99 %u, legacy p50 %u p99 %u, dropped %u\n",
+            p50, p99, legacy_p50, legacy_p99, dropped);
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
@@ -14,9 +14,11 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include "../dlib/memory.h"
+#include "../dlib/time.h"
 
 TEST(dmMemory, Malloc)
 {
@@ -52,6 +54,170 @@ TEST(dmMemory, AlignedMalloc)
     dummy = 0;
 }
 
+TEST(dmMemory, RegisterTag)
+{
+    dmMemory::HTag tag = dmMemory::RegisterTag("test.register");
+    ASSERT_NE(dmMemory::INVALID_TAG, tag);
+    ASSERT_EQ(tag, dmMemory::RegisterTag("test.register"));
+    ASSERT_EQ(tag, dmMemory::FindTag("test.register"));
+    ASSERT_EQ(dmMemory::INVALID_TAG, dmMemory::FindTag("test.unknown"));
+    ASSERT_LT(tag, dmMemory::GetTagCount());
+
+    dmMemory::TagStats stats;
+    ASSERT_TRUE(dmMemory::GetTagStats(tag, &stats));
+    ASSERT_STREQ("test.register", stats.m_Name);
+    ASSERT_FALSE(dmMemory::GetTagStats(dmMemory::INVALID_TAG, &stats));
+}
+
+TEST(dmMemory, TrackAlloc)
+{
+    dmMemory::HTag tag = dmMemory::RegisterTag("test.track");
+
+    dmMemory::TrackAlloc(tag, 100);
+    dmMemory::TrackAlloc(tag, 50);
+    dmMemory::TrackRealloc(tag, 50, 80);
+    dmMemory::TrackFree(tag, 100);
+
+    dmMemory::TagStats stats;
+    dmMemory::GetTagStats(tag, &stats);
+    ASSERT_EQ(80u, stats.m_LiveBytes);
+    ASSERT_EQ(180u, stats.m_PeakBytes);
+    ASSERT_EQ(1u, stats.m_LiveCount);
+    ASSERT_EQ(2u, stats.m_TotalCount);
+
+    dmMemory::TrackRealloc(tag, 80, 10);
+    dmMemory::TrackFree(tag, 10);
+    dmMemory::GetTagStats(tag, &stats);
+    ASSERT_EQ(0u, stats.m_LiveBytes);
+    ASSERT_EQ(180u, stats.m_PeakBytes);
+    ASSERT_EQ(0u, stats.m_LiveCount);
+
+    // Untagged allocations are ignored
+    dmMemory::TrackAlloc(dmMemory::INVALID_TAG, 100);
+    dmMemory::TrackFree(dmMemory::INVALID_TAG, 100);
+}
+
+TEST(dmMemory, TaggedMalloc)
+{
+    dmMemory::HTag tag = dmMemory::RegisterTag("test.malloc");
+
+    void* a = dmMemory::Malloc(tag, 1000);
+    void* b = dmMemory::Malloc(tag, 24);
+    ASSERT_NE((void*)0, a);
+    ASSERT_NE((void*)0, b);
+    ASSERT_EQ(0u, ((uintptr_t)a) % 16);
+    ASSERT_EQ(0u, ((uintptr_t)b) % 16);
+    memset(a, 0xCD, 1000);
+
+    dmMemory::TagStats stats;
+    dmMemory::GetTagStats(tag, &stats);
+    ASSERT_EQ(1024u, stats.m_LiveBytes);
+    ASSERT_EQ(2u, stats.m_LiveCount);
+
+    dmMemory::Free(a);
+    dmMemory::Free(b);
+    dmMemory::Free(0);
+    dmMemory::GetTagStats(tag, &stats);
+    ASSERT_EQ(0u, stats.m_LiveBytes);
+    ASSERT_EQ(0u, stats.m_LiveCount);
+}
+
+struct BudgetEvents
+{
+    dmMemory::HTag  m_Tag;
+    uint32_t        m_Soft;
+    uint32_t        m_Hard;
+    uint32_t        m_LiveBytes;
+};
+
+static void BudgetCallback(void* user_ctx, dmMemory::HTag tag, dmMemory::BudgetLevel level, const dmMemory::TagStats* stats)
+{
+    BudgetEvents* events = (BudgetEvents*)user_ctx;
+    if (tag != events->m_Tag)
+        return;
+    if (level == dmMemory::BUDGET_LEVEL_SOFT)
+        events->m_Soft++;
+    else
+        events->m_Hard++;
+    events->m_LiveBytes = stats->m_LiveBytes;
+}
+
+TEST(dmMemory, Budgets)
+{
+    BudgetEvents events = {};
+    events.m_Tag = dmMemory::RegisterTag("test.budget");
+    dmMemory::SetTagBudget(events.m_Tag, 1000, 2000);
+    dmMemory::SetBudgetCallback(BudgetCallback, &events);
+
+    dmMemory::TrackAlloc(events.m_Tag, 999);
+    ASSERT_EQ(0u, events.m_Soft);
+
+    dmMemory::TrackAlloc(events.m_Tag, 1);
+    ASSERT_EQ(1u, events.m_Soft);
+    ASSERT_EQ(1000u, events.m_LiveBytes);
+
+    // Only crossing the budget is reported
+    dmMemory::TrackAlloc(events.m_Tag, 100);
+    ASSERT_EQ(1u, events.m_Soft);
+
+    dmMemory::TrackRealloc(events.m_Tag, 100, 2000);
+    ASSERT_EQ(1u, events.m_Soft);
+    ASSERT_EQ(1u, events.m_Hard);
+    ASSERT_EQ(3000u, events.m_LiveBytes);
+
+    // Going below the budget and above it again is reported again
+    dmMemory::TrackFree(events.m_Tag, 2000);
+    dmMemory::TrackFree(events.m_Tag, 1);
+    dmMemory::TrackAlloc(events.m_Tag, 1);
+    ASSERT_EQ(2u, events.m_Soft);
+    ASSERT_EQ(1u, events.m_Hard);
+
+    dmMemory::TrackFree(events.m_Tag, 1);
+    dmMemory::TrackFree(events.m_Tag, 999);
+
+    dmMemory::SetBudgetCallback(0, 0);
+    dmMemory::SetTagBudget(events.m_Tag, 0, 0);
+}
+
+// Headless allocation stress test, to keep an eye on the cost of the accounting
+TEST(dmMemory, TaggedMallocBench)
+{
+    const uint32_t count = 4096;
+    const uint32_t iterations = 100;
+    void** blocks = (void**)malloc(count * sizeof(void*));
+    dmMemory::HTag tag = dmMemory::RegisterTag("test.bench");
+
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (uint32_t j = 0; j < count; ++j)
+            blocks[j] = malloc(16 + (j & 255));
+        for (uint32_t j = 0; j < count; ++j)
+            free(blocks[j]);
+    }
+    uint64_t untagged = dmTime::GetTime() - start;
+
+    start = dmTime::GetTime();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (uint32_t j = 0; j < count; ++j)
+            blocks[j] = dmMemory::Malloc(tag, 16 + (j & 255));
+        for (uint32_t j = 0; j < count; ++j)
+            dmMemory::Free(blocks[j]);
+    }
+    uint64_t tagged = dmTime::GetTime() - start;
+
+    free(blocks);
+
+    dmMemory::TagStats stats;
+    dmMemory::GetTagStats(tag, &stats);
+    ASSERT_EQ(0u, stats.m_LiveBytes);
+    ASSERT_EQ(count * iterations, stats.m_TotalCount);
+
+    printf("malloc/free: %.3f ms  tagged: %.3f ms  (%.1f ns per allocation)\n", untagged / 1000.0f, tagged / 1000.0f,
+            (tagged - (double)untagged) * 1000.0 / (count * iterations));
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -25,6 +25,7 @@
 #endif
 
 #include <dlib/network_constants.h>
+#include "../dlib/socket_private.h"
 
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
@@ -936,6 +937,223 @@ TEST(Socket, GetHostByName_NoValidAddressFamily)
     ASSERT_EQ(dmSocket::RESULT_HOST_NOT_FOUND, result);
 }
 
+// Stands in for the platform lookup, with a single known host
+static int32_atomic_t g_HostLookupCount = 0;
+static int32_atomic_t g_HostLookupDelay = 0; // microseconds
+static int32_atomic_t g_SlowHostLookupDelay = 0; // microseconds, for the names starting with "slow"
+
+static dmSocket::Result TestHostLookup(const char* name, dmSocket::Address* address, bool ipv4, bool ipv6)
+{
+    dmAtomicIncrement32(&g_HostLookupCount);
+    uint32_t delay = (uint32_t)dmAtomicGet32(strncmp(name, "slow", 4) == 0 ? &g_SlowHostLookupDelay : &g_HostLookupDelay);
+    if (delay)
+    {
+        dmTime::Sleep(delay);
+    }
+
+    if (strcmp(name, "host.test") != 0)
+    {
+        return dmSocket::RESULT_HOST_NOT_FOUND;
+    }
+    if (ipv4)
+    {
+        address->m_family = dmSocket::DOMAIN_IPV4;
+        *dmSocket::IPv4(address) = 0x0100000a;
+    }
+    else if (ipv6)
+    {
+        address->m_family = dmSocket::DOMAIN_IPV6;
+        memset(address->m_address, 0, sizeof(address->m_address));
+        address->m_address[3] = 0x01000000;
+    }
+    else
+    {
+        return dmSocket::RESULT_HOST_NOT_FOUND;
+    }
+    return dmSocket::RESULT_OK;
+}
+
+class HostCacheTest : public jc_test_base_class
+{
+protected:
+    virtual void SetUp()
+    {
+        dmSocket::ClearHostCache();
+        dmSocket::SetHostLookupFunction(TestHostLookup);
+        dmAtomicStore32(&g_HostLookupCount, 0);
+        dmAtomicStore32(&g_HostLookupDelay, 0);
+        dmAtomicStore32(&g_SlowHostLookupDelay, 0);
+    }
+
+    virtual void TearDown()
+    {
+        dmSocket::SetHostLookupFunction(0);
+        dmSocket::ClearHostCache();
+    }
+};
+
+TEST_F(HostCacheTest, Cached)
+{
+    dmSocket::Address address;
+    dmSocket::Result result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_EQ(dmSocket::DOMAIN_IPV4, address.m_family);
+    ASSERT_EQ(0x0100000a, *dmSocket::IPv4(&address));
+    ASSERT_EQ(1, dmAtomicGet32(&g_HostLookupCount));
+
+    dmSocket::Address cached_address;
+    result = dmSocket::GetHostByNameT("host.test", &cached_address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_TRUE(address == cached_address);
+    ASSERT_EQ(1, dmAtomicGet32(&g_HostLookupCount));
+
+    // Each set of address families is resolved separately
+    result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, false, true);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_EQ(dmSocket::DOMAIN_IPV6, address.m_family);
+    ASSERT_EQ(2, dmAtomicGet32(&g_HostLookupCount));
+
+    dmSocket::ClearHostCache();
+    result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_EQ(3, dmAtomicGet32(&g_HostLookupCount));
+}
+
+TEST_F(HostCacheTest, NegativeCached)
+{
+    dmSocket::Address address;
+    dmSocket::Result result = dmSocket::GetHostByNameT("missing.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_HOST_NOT_FOUND, result);
+    result = dmSocket::GetHostByNameT("missing.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_HOST_NOT_FOUND, result);
+    ASSERT_EQ(1, dmAtomicGet32(&g_HostLookupCount));
+}
+
+TEST_F(HostCacheTest, TimeoutAndCancel)
+{
+    dmAtomicStore32(&g_HostLookupDelay, 200000);
+
+    dmSocket::Address address;
+    uint64_t start = dmTime::GetTime();
+    dmSocket::Result result = dmSocket::GetHostByNameT("host.test", &address, 20000, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_TIMEDOUT, result);
+    ASSERT_GT(150000U, dmTime::GetTime() - start);
+
+    int cancel = 1;
+    result = dmSocket::GetHostByNameT("host.test", &address, 0, &cancel, true, false);
+    ASSERT_EQ(dmSocket::RESULT_TIMEDOUT, result);
+
+    // The abandoned lookup finishes in the background, and is then served from the cache
+    result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_EQ(0x0100000a, *dmSocket::IPv4(&address));
+    ASSERT_EQ(1, dmAtomicGet32(&g_HostLookupCount));
+}
+
+struct HostLookupThreadContext
+{
+    dmSocket::Address m_Address;
+    dmSocket::Result  m_Result;
+};
+
+static void HostLookupThread(void* arg)
+{
+    HostLookupThreadContext* ctx = (HostLookupThreadContext*)arg;
+    ctx->m_Result = dmSocket::GetHostByNameT("host.test", &ctx->m_Address, 0, 0, true, false);
+}
+
+TEST_F(HostCacheTest, Coalesced)
+{
+    dmAtomicStore32(&g_HostLookupDelay, 50000);
+
+    const uint32_t thread_count = 8;
+    HostLookupThreadContext contexts[thread_count];
+    dmThread::Thread threads[thread_count];
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        contexts[i].m_Result = dmSocket::RESULT_UNKNOWN;
+        threads[i] = dmThread::New(HostLookupThread, 0x20000, &contexts[i], "lookup");
+    }
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        dmThread::Join(threads[i]);
+        ASSERT_EQ(dmSocket::RESULT_OK, contexts[i].m_Result);
+        ASSERT_EQ(0x0100000a, *dmSocket::IPv4(&contexts[i].m_Address));
+    }
+    ASSERT_EQ(1, dmAtomicGet32(&g_HostLookupCount));
+}
+
+TEST_F(HostCacheTest, Finalize)
+{
+    dmAtomicStore32(&g_HostLookupDelay, 200000);
+
+    // Keep the resolver threads busy
+    const char* names[] = { "a.test", "b.test", "c.test", "d.test" };
+    for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        dmSocket::PrefetchHostByName(names[i], true, false);
+    }
+
+    HostLookupThreadContext context;
+    context.m_Result = dmSocket::RESULT_UNKNOWN;
+    dmThread::Thread thread = dmThread::New(HostLookupThread, 0x20000, &context, "lookup");
+    dmTime::Sleep(50000);
+
+    // The waiting caller returns once the resolver is stopped, instead of waiting for the lookup
+    uint64_t start = dmTime::GetTime();
+    dmSocket::Finalize();
+    dmThread::Join(thread);
+    ASSERT_EQ(dmSocket::RESULT_HOSTUNREACH, context.m_Result);
+    ASSERT_GT(150000U, dmTime::GetTime() - start);
+    dmSocket::Initialize();
+}
+
+TEST_F(HostCacheTest, HungLookups)
+{
+    dmAtomicStore32(&g_SlowHostLookupDelay, 300000);
+
+    // More lookups that hang than there are resolver threads to begin with
+    const uint32_t slow_count = 8;
+    char name[32];
+    for (uint32_t i = 0; i < slow_count; ++i)
+    {
+        dmSnPrintf(name, sizeof(name), "slow%u.test", i);
+        dmSocket::PrefetchHostByName(name, false, true);
+    }
+
+    // A new lookup doesn't wait behind them
+    uint64_t start = dmTime::GetTime();
+    dmSocket::Address address;
+    dmSocket::Result result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_GT(150000U, dmTime::GetTime() - start);
+
+    for (uint32_t i = 0; i < slow_count; ++i)
+    {
+        dmSnPrintf(name, sizeof(name), "slow%u.test", i);
+        result = dmSocket::GetHostByNameT(name, &address, 0, 0, false, true);
+        ASSERT_EQ(dmSocket::RESULT_HOST_NOT_FOUND, result);
+    }
+    ASSERT_GT(600000U, dmTime::GetTime() - start);
+}
+
+TEST_F(HostCacheTest, Prefetch)
+{
+    dmAtomicStore32(&g_HostLookupDelay, 100000);
+
+    // Both address families are resolved at the same time
+    uint64_t start = dmTime::GetTime();
+    dmSocket::PrefetchHostByName("host.test", false, true);
+    dmSocket::Address address;
+    dmSocket::Result result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, true, false);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    result = dmSocket::GetHostByNameT("host.test", &address, 0, 0, false, true);
+    ASSERT_EQ(dmSocket::RESULT_OK, result);
+    ASSERT_EQ(dmSocket::DOMAIN_IPV6, address.m_family);
+    ASSERT_GT(190000U, dmTime::GetTime() - start);
+    ASSERT_EQ(2, dmAtomicGet32(&g_HostLookupCount));
+}
+
 TEST(Socket, ServerSocketIPv4)
 {
     dmSocket::Socket socket;
@@ -27,10 +27,12 @@
 #include <dlib/buffer.h>
 #include <dlib/dlib.h>
 #include <dlib/dstrings.h>
+#include <dlib/frame_arena.h>
 #include <dlib/hash.h>
 #include <dlib/http_client.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dlib/memprofile.h>
 #include <dlib/path.h>
 #include <dlib/profile.h>
@@ -222,6 +224,8 @@ namespace dmEngine
     : m_Config(0)
     , m_Alive(true)
     , m_MainCollection(0)
+    , m_MainCollectionPreloader(0)
+    , m_MainCollectionPath(0)
     , m_LastReloadMTime(0)
     , m_MouseSensitivity(1.0f)
     , m_GraphicsContext(0)
@@ -263,6 +267,11 @@ namespace dmEngine
         m_ModelContext.m_MaxModelCount = 0;
         m_AccumFrameTime = 0;
         m_PreviousFrameTime = dmTime::GetTime();
+        m_StartupPhases.SetCapacity(16);
+        m_StartupTime = m_PreviousFrameTime;
+        m_StartupPhase = 0;
+        m_BootFrameCount = 0;
+        m_StartupComplete = false;
     }
 
     HEngine New(dmEngineService::HEngineService engine_service)
@@ -272,6 +281,8 @@ namespace dmEngine
 
     void Delete(HEngine engine)
     {
+        if (engine->m_MainCollectionPreloader)
+            dmResource::DeletePreloader(engine->m_MainCollectionPreloader);
         if (engine->m_MainCollection)
             dmResource::Release(engine->m_Factory, engine->m_MainCollection);
         dmGameObject::PostUpdate(engine->m_Register);
@@ -532,6 +543,92 @@ namespace dmEngine
         }
     }
 
+    static void MemoryBudgetCallback(void* ctx, dmMemory::HTag tag, dmMemory::BudgetLevel level, const dmMemory::TagStats* stats)
+    {
+        if (level == dmMemory::BUDGET_LEVEL_SOFT)
+            dmLogWarning("Memory for '%s' is above its soft budget: %u KB (budget %u KB)", stats->m_Name, stats->m_LiveBytes / 1024, stats->m_SoftBudget / 1024);
+        else
+            dmLogError("Memory for '%s' is above its hard budget: %u KB (budget %u KB)", stats->m_Name, stats->m_LiveBytes / 1024, stats->m_HardBudget / 1024);
+    }
+
+    // Reads the budgets from "memory.<tag>_soft_budget_kb" and "memory.<tag>_hard_budget_kb",
+    // e.g. memory.lua_soft_budget_kb or memory.resource.texturec_hard_budget_kb
+    static void SetupMemoryBudgets(HEngine engine)
+    {
+        // Register the subsystem tags up front, since some are only registered when the first collection is loaded
+        const char* subsystem_tags[] = {"lua", "physics", "gui", "sprite"};
+        for (uint32_t i = 0; i < DM_ARRAY_SIZE(subsystem_tags); ++i)
+        {
+            dmMemory::RegisterTag(subsystem_tags[i]);
+        }
+
+        uint32_t tag_count = dmMemory::GetTagCount();
+        for (uint32_t i = 0; i < tag_count; ++i)
+        {
+            dmMemory::TagStats stats;
+            dmMemory::GetTagStats(i, &stats);
+
+            char key[128];
+            dmSnPrintf(key, sizeof(key), "memory.%s_soft_budget_kb", stats.m_Name);
+            uint32_t soft_budget = (uint32_t)dmConfigFile::GetInt(engine->m_Config, key, 0);
+            dmSnPrintf(key, sizeof(key), "memory.%s_hard_budget_kb", stats.m_Name);
+            uint32_t hard_budget = (uint32_t)dmConfigFile::GetInt(engine->m_Config, key, 0);
+            if (soft_budget || hard_budget)
+            {
+                dmMemory::SetTagBudget(i, soft_budget * 1024, hard_budget * 1024);
+            }
+        }
+
+        dmMemory::SetBudgetCallback(MemoryBudgetCallback, engine);
+    }
+
+    static uint32_t BeginStartupPhase(HEngine engine, const char* name)
+    {
+        if (engine->m_StartupPhases.Full())
+            engine->m_StartupPhases.OffsetCapacity(8);
+
+        StartupPhase phase;
+        phase.m_Name = name;
+        phase.m_Start = dmTime::GetTime() - engine->m_StartupTime;
+        phase.m_End = 0;
+        engine->m_StartupPhases.Push(phase);
+        return engine->m_StartupPhases.Size() - 1;
+    }
+
+    static void EndStartupPhase(HEngine engine, uint32_t phase)
+    {
+        engine->m_StartupPhases[phase].m_End = dmMath::Max(dmTime::GetTime() - engine->m_StartupTime, (uint64_t)1);
+    }
+
+    // Writes the startup timeline as json to the file set in "engine.startup_timeline" (if any),
+    // so that e.g. cold start benchmarks can run the engine headless and inspect the result
+    static void WriteStartupTimeline(HEngine engine)
+    {
+        const StartupPhase& last = engine->m_StartupPhases.Back();
+        dmLogDebug("Engine startup took %.3f ms (%u boot frames)", last.m_End / 1000.0f, engine->m_BootFrameCount);
+
+        const char* path = dmConfigFile::GetString(engine->m_Config, "engine.startup_timeline", 0);
+        if (!path)
+            return;
+
+        FILE* f = fopen(path, "wb");
+        if (!f)
+        {
+            dmLogWarning("Unable to write the startup timeline to '%s'", path);
+            return;
+        }
+
+        fprintf(f, "{\"total_us\": %llu, \"boot_frames\": %u, \"phases\": [", (unsigned long long)last.m_End, engine->m_BootFrameCount);
+        for (uint32_t i = 0; i < engine->m_StartupPhases.Size(); ++i)
+        {
+            const StartupPhase& phase = engine->m_StartupPhases[i];
+            fprintf(f, "%s\n    {\"name\": \"%s\", \"start_us\": %llu, \"end_us\": %llu}", i ? "," : "",
+                    phase.m_Name, (unsigned long long)phase.m_Start, (unsigned long long)phase.m_End);
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+    }
+
     /*
      The game.projectc is located using the following scheme:
 
@@ -550,6 +647,9 @@ namespace dmEngine
     */
     bool Init(HEngine engine, int argc, char *argv[])
     {
+        engine->m_StartupTime = dmTime::GetTime();
+        uint32_t phase = BeginStartupPhase(engine, "project");
+
         dmLogInfo("Defold Engine %s (%.7s)", dmEngineVersion::VERSION, dmEngineVersion::VERSION_SHA1);
 
         dmCrash::SetExtraInfoCallback(CrashHandlerCallback, engine);
@@ -664,6 +764,8 @@ namespace dmEngine
         }
         #endif
 
+        EndStartupPhase(engine, phase);
+
         // Catch engine specific arguments
         bool verify_graphics_calls = dLib::IsDebugMode();
 
@@ -708,6 +810,8 @@ namespace dmEngine
             }
         }
 
+        phase = BeginStartupPhase(engine, "extensions");
+
         dmBuffer::NewContext();
 
 
@@ -744,6 +848,8 @@ namespace dmEngine
             return false;
         }
 
+        EndStartupPhase(engine, phase);
+
         int write_log = dmConfigFile::GetInt(engine->m_Config, "project.write_log", 0);
         if (write_log) {
             uint32_t count = 0;
@@ -792,6 +898,8 @@ namespace dmEngine
         // This scope is mainly here to make sure the "Main" scope is created first
         DM_PROFILE("Init");
 
+        phase = BeginStartupPhase(engine, "graphics");
+
         dmGraphics::ContextParams graphics_context_params;
         graphics_context_params.m_DefaultTextureMinFilter = ConvertMinTextureFilter(dmConfigFile::GetString(engine->m_Config, "graphics.default_texture_min_filter", "linear"));
         graphics_context_params.m_DefaultTextureMagFilter = ConvertMagTextureFilter(dmConfigFile::GetString(engine->m_Config, "graphics.default_texture_mag_filter", "linear"));
@@ -801,6 +909,16 @@ namespace dmEngine
         graphics_context_params.m_UseValidationLayers = use_validation_layers || dmConfigFile::GetInt(engine->m_Config, "graphics.use_validationlayers", 0) != 0;
         graphics_context_params.m_GraphicsMemorySize = dmConfigFile::GetInt(engine->m_Config, "graphics.memory_size", 0) * 1024*1024; // MB -> bytes
 
+        // Compiled pipelines are kept between runs (Vulkan only) to avoid hitches the first time a material is drawn
+        char pipeline_cache_dir[DMPATH_MAX_PATH];
+        char pipeline_cache_path[DMPATH_MAX_PATH];
+        const char* pipeline_cache_app_name = dmConfigFile::GetString(engine->m_Config, "project.title_as_file_name", "defold");
+        if (dmSys::GetApplicationSupportPath(pipeline_cache_app_name, pipeline_cache_dir, sizeof(pipeline_cache_dir)) == dmSys::RESULT_OK)
+        {
+            dmPath::Concat(pipeline_cache_dir, "pipeline.cache", pipeline_cache_path, sizeof(pipeline_cache_path));
+            graphics_context_params.m_PipelineCachePath = pipeline_cache_path;
+        }
+
         engine->m_GraphicsContext = dmGraphics::NewContext(graphics_context_params);
         if (engine->m_GraphicsContext == 0x0)
         {
@@ -846,6 +964,8 @@ namespace dmEngine
             return false;
         }
 
+        EndStartupPhase(engine, phase);
+
         uint32_t physical_dpi = dmGraphics::GetDisplayDpi(engine->m_GraphicsContext);
         uint32_t physical_width = dmGraphics::GetWindowWidth(engine->m_GraphicsContext);
         uint32_t physical_height = dmGraphics::GetWindowHeight(engine->m_GraphicsContext);
@@ -873,6 +993,8 @@ namespace dmEngine
         }
         SetSwapInterval(engine, opengl_swap_interval);
 
+        phase = BeginStartupPhase(engine, "resource_factory");
+
         const uint32_t max_resources = dmConfigFile::GetInt(engine->m_Config, dmResource::MAX_RESOURCES_KEY, 1024);
         dmResource::NewFactoryParams params;
         params.m_MaxResources = max_resources;
@@ -910,6 +1032,9 @@ namespace dmEngine
             return false;
         }
 
+        EndStartupPhase(engine, phase);
+        phase = BeginStartupPhase(engine, "systems");
+
         dmScript::ClearLuaRefCount(); // Reset the debug counter to 0
 
         dmArray<dmScript::HContext>& module_script_contexts = engine->m_ModuleContext.m_ScriptContexts;
@@ -936,6 +1061,26 @@ namespace dmEngine
             module_script_contexts.Push(engine->m_GuiScriptContext);
         }
 
+        // Bytecode compiled from Lua source (i.e. when running vanilla Lua) is kept between runs to speed up the startup
+        if (dmConfigFile::GetInt(engine->m_Config, "script.bytecode_cache", 1))
+        {
+            char bytecode_cache_dir[DMPATH_MAX_PATH];
+            char bytecode_cache_path[DMPATH_MAX_PATH];
+            const char* bytecode_cache_app_name = dmConfigFile::GetString(engine->m_Config, "project.title_as_file_name", "defold");
+            if (dmSys::GetApplicationSupportPath(bytecode_cache_app_name, bytecode_cache_dir, sizeof(bytecode_cache_dir)) == dmSys::RESULT_OK)
+            {
+                dmPath::Concat(bytecode_cache_dir, "luacache", bytecode_cache_path, sizeof(bytecode_cache_path));
+                dmSys::Result r = dmSys::Mkdir(bytecode_cache_path, 0755);
+                if (r == dmSys::RESULT_OK || r == dmSys::RESULT_EXIST)
+                {
+                    for (uint32_t i = 0; i < module_script_contexts.Size(); ++i)
+                    {
+                        dmScript::SetBytecodeCachePath(module_script_contexts[i], bytecode_cache_path);
+                    }
+                }
+            }
+        }
+
         dmSound::InitializeParams sound_params;
         sound_params.m_OutputDevice = "default";
 #if defined(__EMSCRIPTEN__)
@@ -965,6 +1110,7 @@ namespace dmEngine
         render_params.m_MaxCharacters = (uint32_t) dmConfigFile::GetInt(engine->m_Config, "graphics.max_characters", 2048 * 4);
         render_params.m_CommandBufferSize = 1024;
         render_params.m_ScriptContext = engine->m_RenderScriptContext;
+        render_params.m_PrewarmMaterials = dmConfigFile::GetInt(engine->m_Config, "graphics.prewarm_materials", 0) != 0;
 #if !defined(DM_RELEASE)
         render_params.m_VertexShaderDesc = ::DEBUG_VPC;
         render_params.m_VertexShaderDescSize = ::DEBUG_VPC_SIZE;
@@ -1039,6 +1185,7 @@ namespace dmEngine
         physics_params.m_RayCastLimit3D = dmConfigFile::GetInt(engine->m_Config, "physics.ray_cast_limit_3d", 128);
         physics_params.m_TriggerOverlapCapacity = dmConfigFile::GetInt(engine->m_Config, "physics.trigger_overlap_capacity", 16);
         physics_params.m_VelocityThreshold = dmConfigFile::GetFloat(engine->m_Config, "physics.velocity_threshold", 1.0f);
+        physics_params.m_WorkerThreadCount2D = dmConfigFile::GetInt(engine->m_Config, "physics.worker_thread_count", 0);
         if (physics_params.m_Scale < dmPhysics::MIN_SCALE || physics_params.m_Scale > dmPhysics::MAX_SCALE)
         {
             dmLogWarning("Physics scale must be in the range %.2f - %.2f and has been clamped.", dmPhysics::MIN_SCALE, dmPhysics::MAX_SCALE);
@@ -1095,6 +1242,7 @@ namespace dmEngine
         engine->m_ModelContext.m_RenderContext = engine->m_RenderContext;
         engine->m_ModelContext.m_Factory = engine->m_Factory;
         engine->m_ModelContext.m_MaxModelCount = dmConfigFile::GetInt(engine->m_Config, "model.max_count", 128);
+        engine->m_ModelContext.m_LodPixelError = dmConfigFile::GetFloat(engine->m_Config, "model.lod_pixel_error", 1.0f);
 
         engine->m_LabelContext.m_RenderContext      = engine->m_RenderContext;
         engine->m_LabelContext.m_MaxLabelCount      = dmConfigFile::GetInt(engine->m_Config, "label.max_count", 64);
@@ -1134,6 +1282,9 @@ namespace dmEngine
         // Variables need to be declared up here due to the goto's
         bool has_host_mount = dmSys::GetEnv("DM_HOSTFS") != 0;
 
+        EndStartupPhase(engine, phase);
+        phase = BeginStartupPhase(engine, "register_types");
+
         engine->m_ResourceTypeContexts.Put(dmHashString64("goc"), engine->m_Register);
         engine->m_ResourceTypeContexts.Put(dmHashString64("collectionc"), engine->m_Register);
         engine->m_ResourceTypeContexts.Put(dmHashString64("luac"), &engine->m_ModuleContext);
@@ -1152,6 +1303,8 @@ namespace dmEngine
         if (fact_result != dmResource::RESULT_OK)
             goto bail;
 
+        SetupMemoryBudgets(engine);
+
         go_result = dmGameSystem::RegisterComponentTypes(engine->m_Factory, engine->m_Register, engine->m_RenderContext, &engine->m_PhysicsContext, &engine->m_ParticleFXContext, &engine->m_SpriteContext,
                                                                                                 &engine->m_CollectionProxyContext, &engine->m_FactoryContext, &engine->m_CollectionFactoryContext,
                                                                                                 &engine->m_ModelContext, &engine->m_LabelContext, &engine->m_TilemapContext,
@@ -1165,12 +1318,18 @@ namespace dmEngine
         if (go_result != dmGameObject::RESULT_OK)
             goto bail;
 
+        EndStartupPhase(engine, phase);
+        phase = BeginStartupPhase(engine, "bootstrap_content");
+
         if (!LoadBootstrapContent(engine, engine->m_Config))
         {
             dmLogError("Unable to load bootstrap data.");
             goto bail;
         }
 
+        EndStartupPhase(engine, phase);
+        phase = BeginStartupPhase(engine, "script_libs");
+
 #if !defined(DM_RELEASE)
         {
             const char* init_script = dmConfigFile::GetString(engine->m_Config, "bootstrap.debug_init_script", 0);
@@ -1261,10 +1420,24 @@ namespace dmEngine
                 goto bail;
         }
 
-        fact_result = dmResource::Get(engine->m_Factory, dmConfigFile::GetString(engine->m_Config, "bootstrap.main_collection", "/logic/main.collectionc"), (void**) &engine->m_MainCollection);
-        if (fact_result != dmResource::RESULT_OK)
-            goto bail;
-        dmGameObject::Init(engine->m_MainCollection);
+        EndStartupPhase(engine, phase);
+
+        engine->m_MainCollectionPath = dmConfigFile::GetString(engine->m_Config, "bootstrap.main_collection", "/logic/main.collectionc");
+        engine->m_StartupPhase = BeginStartupPhase(engine, "main_collection");
+        if (dmConfigFile::GetInt(engine->m_Config, "bootstrap.async_main_collection", 1))
+        {
+            // Streamed in while the first frames are rendered, see StepFrame()
+            engine->m_MainCollectionPreloader = dmResource::NewPreloader(engine->m_Factory, engine->m_MainCollectionPath);
+        }
+        else
+        {
+            fact_result = dmResource::Get(engine->m_Factory, engine->m_MainCollectionPath, (void**) &engine->m_MainCollection);
+            if (fact_result != dmResource::RESULT_OK)
+                goto bail;
+            dmGameObject::Init(engine->m_MainCollection);
+            EndStartupPhase(engine, engine->m_StartupPhase);
+            engine->m_StartupPhase = BeginStartupPhase(engine, "first_frame");
+        }
 
         engine->m_LastReloadMTime = 0;
 
@@ -1436,6 +1609,65 @@ bail:
         return memcount;
     }
 
+    static bool MainCollectionLoadedCallback(const dmResource::PreloaderCompleteCallbackParams* params)
+    {
+        HEngine engine = (HEngine) params->m_UserData;
+        return dmResource::Get(params->m_Factory, engine->m_MainCollectionPath, (void**) &engine->m_MainCollection) == dmResource::RESULT_OK;
+    }
+
+    // Returns true once the main collection is loaded and initialized
+    static bool UpdateMainCollectionLoading(HEngine engine)
+    {
+        DM_PROFILE("MainCollectionLoading");
+
+        dmResource::PreloaderCompleteCallbackParams params;
+        params.m_Factory = engine->m_Factory;
+        params.m_UserData = engine;
+        dmResource::Result r = dmResource::UpdatePreloader(engine->m_MainCollectionPreloader, MainCollectionLoadedCallback, &params, 10*1000);
+        if (r == dmResource::RESULT_PENDING)
+            return false;
+
+        dmResource::DeletePreloader(engine->m_MainCollectionPreloader);
+        engine->m_MainCollectionPreloader = 0;
+
+        if (r != dmResource::RESULT_OK)
+        {
+            dmLogFatal("Unable to load the main collection '%s' (%d)", engine->m_MainCollectionPath, r);
+            engine->m_Alive = false;
+            engine->m_RunResult.m_ExitCode = 1;
+            engine->m_RunResult.m_Action = dmEngine::RunResult::EXIT;
+            return false;
+        }
+
+        dmGameObject::Init(engine->m_MainCollection);
+        EndStartupPhase(engine, engine->m_StartupPhase);
+        engine->m_StartupPhase = BeginStartupPhase(engine, "first_frame");
+        return true;
+    }
+
+    // The boot screen, shown while the main collection is loading, is only the clear color
+    static void StepBootFrame(HEngine engine)
+    {
+        dmHID::Update(engine->m_HidContext);
+        if (!dmGraphics::GetWindowState(engine->m_GraphicsContext, dmGraphics::WINDOW_STATE_OPENED))
+        {
+            engine->m_Alive = false;
+            return;
+        }
+
+        dmGraphics::BeginFrame(engine->m_GraphicsContext);
+        dmGraphics::SetViewport(engine->m_GraphicsContext, 0, 0, dmGraphics::GetWindowWidth(engine->m_GraphicsContext), dmGraphics::GetWindowHeight(engine->m_GraphicsContext));
+        dmGraphics::Clear(engine->m_GraphicsContext, dmGraphics::BUFFER_TYPE_COLOR0_BIT | dmGraphics::BUFFER_TYPE_DEPTH_BIT | dmGraphics::BUFFER_TYPE_STENCIL_BIT,
+                            (float)((engine->m_ClearColor>> 0)&0xFF),
+                            (float)((engine->m_ClearColor>> 8)&0xFF),
+                            (float)((engine->m_ClearColor>>16)&0xFF),
+                            (float)((engine->m_ClearColor>>24)&0xFF),
+                            1.0f, 0);
+        dmGraphics::Flip(engine->m_GraphicsContext);
+
+        ++engine->m_BootFrameCount;
+    }
+
     static void StepFrame(HEngine engine, float dt)
     {
         dmProfiler::SetUpdateFrequency((uint32_t)(1.0f / dt));
@@ -1470,6 +1702,17 @@ bail:
             }
         }
 
+        if (engine->m_MainCollectionPreloader)
+        {
+            // Frames rendered while loading aren't counted as game frames
+            if (!UpdateMainCollectionLoading(engine))
+            {
+                if (engine->m_Alive)
+                    StepBootFrame(engine);
+                return;
+            }
+        }
+
         dmProfile::HProfile profile = dmProfile::BeginFrame();
         {
             DM_PROFILE("Frame");
@@ -1654,6 +1897,7 @@ bail:
             }
 
             dmGraphics::Flip(engine->m_GraphicsContext);
+            dmFrameArena::NewFrame();
 
             RecordData* record_data = &engine->m_RecordData;
             if (record_data->m_Recorder)
@@ -1679,6 +1923,13 @@ bail:
 
         ++engine->m_Stats.m_FrameCount;
         engine->m_Stats.m_TotalTime += dt;
+
+        if (!engine->m_StartupComplete)
+        {
+            EndStartupPhase(engine, engine->m_StartupPhase);
+            engine->m_StartupComplete = true;
+            WriteStartupTimeline(engine);
+        }
     }
 
     static void CalcTimeStep(HEngine engine, float& step_dt, uint32_t& num_steps)
@@ -1943,32 +2194,54 @@ bail:
         }
 
         const char* gamepads = dmConfigFile::GetString(config, "input.gamepads", 0);
+        const char* game_input_binding = dmConfigFile::GetString(config, "input.game_binding", "/input/game.input_bindingc");
+        const char* render_path = dmConfigFile::GetString(config, "bootstrap.render", "/builtins/render/default.renderc");
+        const char* display_profiles_path = dmConfigFile::GetString(config, "display.display_profiles", "/builtins/render/default.display_profilesc");
+
+        // The remaining resources don't depend on each other, so they're loaded concurrently
+        // by a preloader. The first one is the root, the others are loaded as hints.
+        dmArray<const char*> names;
+        names.SetCapacity(4);
+        names.Push(render_path);
+        names.Push(game_input_binding);
+        names.Push(display_profiles_path);
+        if (gamepads)
+            names.Push(gamepads);
+
+        dmResource::HPreloader preloader = dmResource::NewPreloader(engine->m_Factory, names);
+        while (dmResource::UpdatePreloader(preloader, 0, 0, 10*1000) == dmResource::RESULT_PENDING)
+        {
+        }
+
+        // The preloader holds on to the resources until it's deleted, so these are cache hits.
+        // Hints that failed to load are loaded again here, which also reports their errors.
+        bool result = false;
         if (gamepads)
         {
             dmInputDDF::GamepadMaps* gamepad_maps_ddf;
             fact_error = dmResource::Get(engine->m_Factory, gamepads, (void**)&gamepad_maps_ddf);
             if (fact_error != dmResource::RESULT_OK)
-                return false;
+                goto done;
             dmInput::RegisterGamepads(engine->m_InputContext, gamepad_maps_ddf);
             dmResource::Release(engine->m_Factory, gamepad_maps_ddf);
         }
 
-        const char* game_input_binding = dmConfigFile::GetString(config, "input.game_binding", "/input/game.input_bindingc");
         fact_error = dmResource::Get(engine->m_Factory, game_input_binding, (void**)&engine->m_GameInputBinding);
         if (fact_error != dmResource::RESULT_OK)
-            return false;
+            goto done;
 
-        const char* render_path = dmConfigFile::GetString(config, "bootstrap.render", "/builtins/render/default.renderc");
         fact_error = dmResource::Get(engine->m_Factory, render_path, (void**)&engine->m_RenderScriptPrototype);
         if (fact_error != dmResource::RESULT_OK)
-            return false;
+            goto done;
 
-        const char* display_profiles_path = dmConfigFile::GetString(config, "display.display_profiles", "/builtins/render/default.display_profilesc");
         fact_error = dmResource::Get(engine->m_Factory, display_profiles_path, (void**)&engine->m_DisplayProfiles);
         if (fact_error != dmResource::RESULT_OK)
-            return false;
+            goto done;
 
-        return true;
+        result = true;
+done:
+        dmResource::DeletePreloader(preloader);
+        return result;
     }
 
     void UnloadBootstrapContent(HEngine engine)
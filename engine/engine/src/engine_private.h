@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 
+#include <dlib/array.h>
 #include <dlib/configfile.h>
 #include <dlib/hashtable.h>
 #include <dlib/message.h>
@@ -87,6 +88,14 @@ namespace dmEngine
         float    m_TotalTime;   // Total running time of the game
     };
 
+    // A timed step of the engine startup, used to produce the startup timeline
+    struct StartupPhase
+    {
+        const char* m_Name;
+        uint64_t    m_Start;    // Time since the start of dmEngine::Init (us)
+        uint64_t    m_End;      // 0 if the phase never completed
+    };
+
     struct RecordData
     {
         RecordData()
@@ -112,6 +121,8 @@ namespace dmEngine
 
         dmGameObject::HRegister                     m_Register;
         dmGameObject::HCollection                   m_MainCollection;
+        dmResource::HPreloader                      m_MainCollectionPreloader;  //!< Set while the main collection is streamed in
+        const char*                                 m_MainCollectionPath;
         dmArray<dmGameObject::InputAction>          m_InputBuffer;
         dmHashTable64<void*>                        m_ResourceTypeContexts;
 
@@ -166,6 +177,12 @@ namespace dmEngine
         float                                       m_InvPhysicalHeight;
 
         RecordData                                  m_RecordData;
+
+        dmArray<StartupPhase>                       m_StartupPhases;
+        uint64_t                                    m_StartupTime;
+        uint32_t                                    m_StartupPhase;             //!< The phase that spans frames, i.e. "main_collection" or "first_frame"
+        uint32_t                                    m_BootFrameCount;           //!< Frames rendered while the main collection was loading
+        bool                                        m_StartupComplete;
     };
 
 
@@ -18,6 +18,7 @@
 #include <dlib/message.h>
 #include <dlib/dstrings.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dlib/log.h>
 #include <dlib/profile.h>
 #include <dlib/ssdp.h>
@@ -825,6 +826,32 @@ namespace dmEngineService
 
 #undef CHECK_RESULT_BOOL
 
+    //
+    // Memory profiler
+    //
+
+    static void HttpMemoryRequestCallback(void* context, dmWebServer::Request* request)
+    {
+        dmWebServer::SetStatusCode(request, 200);
+        dmWebServer::SendAttribute(request, "Content-Type", "application/json");
+        dmWebServer::SendAttribute(request, "Access-Control-Allow-Origin", "*");
+        dmWebServer::SendAttribute(request, "Cache-Control", "no-store");
+
+        SendText(request, "{\"tags\": [");
+        uint32_t tag_count = dmMemory::GetTagCount();
+        for (uint32_t i = 0; i < tag_count; ++i)
+        {
+            dmMemory::TagStats stats;
+            dmMemory::GetTagStats(i, &stats);
+
+            char buffer[384];
+            dmSnPrintf(buffer, sizeof(buffer), "%s\n    {\"name\": \"%s\", \"live\": %u, \"peak\": %u, \"count\": %u, \"total_count\": %u, \"soft_budget\": %u, \"hard_budget\": %u}",
+                        i == 0 ? "" : ",", stats.m_Name, stats.m_LiveBytes, stats.m_PeakBytes, stats.m_LiveCount, stats.m_TotalCount, stats.m_SoftBudget, stats.m_HardBudget);
+            SendText(request, buffer);
+        }
+        SendText(request, "\n]}\n");
+    }
+
     //
     // All profilers' setup
     //
@@ -854,6 +881,11 @@ namespace dmEngineService
         scenegraph_params.m_Userdata = regist;
         dmWebServer::AddHandler(engine_service->m_WebServer, "/scene_graph", &scenegraph_params);
 
+        dmWebServer::HandlerParams memory_params;
+        memory_params.m_Handler = HttpMemoryRequestCallback;
+        memory_params.m_Userdata = 0;
+        dmWebServer::AddHandler(engine_service->m_WebServer, "/memory_data", &memory_params);
+
         // The entry point to the engine service profiler
         dmWebServer::HandlerParams profile_params;
         profile_params.m_Handler = ProfileHandler;
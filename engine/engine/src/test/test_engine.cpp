@@ -20,6 +20,7 @@
 #include <dlib/thread.h>
 #include <dlib/dstrings.h>
 #include <dlib/profile.h>
+#include <dlib/sys.h>
 #include "test_engine.h"
 #include "../../../graphics/src/graphics_private.h"
 #include "../engine.h"
@@ -176,6 +177,48 @@ TEST_F(EngineTest, CrossScriptMessaging)
     ASSERT_EQ(frame_count, 1u);
 }
 
+// A headless cold start, checking that all startup phases are written to the timeline in order
+TEST_F(EngineTest, StartupTimeline)
+{
+    uint32_t frame_count = 0;
+    char project_path[256];
+    char timeline_path[256];
+    char timeline_arg[300];
+    dmTestUtil::MakeHostPath(timeline_path, sizeof(timeline_path), CONTENT_ROOT "/startup_timeline.json");
+    dmSnPrintf(timeline_arg, sizeof(timeline_arg), "--config=engine.startup_timeline=%s", timeline_path);
+    const char* argv[] = {"test_engine", "--config=bootstrap.main_collection=/cross_script_messaging/main.collectionc", "--config=bootstrap.render=/cross_script_messaging/default.renderc", "--config=dmengine.unload_builtins=0", timeline_arg, MAKE_PATH(project_path, "/game.projectc")};
+    ASSERT_EQ(0, Launch(DM_ARRAY_SIZE(argv), (char**)argv, 0, PostRunFrameCount, &frame_count));
+    ASSERT_EQ(frame_count, 1u);
+
+    char timeline[2048];
+    FILE* f = fopen(timeline_path, "rb");
+    ASSERT_NE((FILE*)0, f);
+    size_t size = fread(timeline, 1, sizeof(timeline) - 1, f);
+    fclose(f);
+    timeline[size] = 0;
+    dmSys::Unlink(timeline_path);
+
+    const char* phases[] = {"project", "extensions", "graphics", "resource_factory", "systems", "register_types",
+                            "bootstrap_content", "script_libs", "main_collection", "first_frame"};
+    const char* cursor = timeline;
+    uint64_t prev_end = 0;
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(phases); ++i)
+    {
+        char name[64];
+        dmSnPrintf(name, sizeof(name), "\"name\": \"%s\"", phases[i]);
+        cursor = strstr(cursor, name);
+        ASSERT_NE((const char*)0, cursor) << "Missing phase " << phases[i];
+
+        unsigned long long start = 0, end = 0;
+        ASSERT_EQ(2, sscanf(cursor + strlen(name), ", \"start_us\": %llu, \"end_us\": %llu", &start, &end));
+        ASSERT_GE(start, prev_end);
+        ASSERT_GE(end, start);
+        ASSERT_NE(0u, end);
+        prev_end = end;
+        printf("%-20s %8.3f ms\n", phases[i], (end - start) / 1000.0f);
+    }
+}
+
 TEST_F(EngineTest, RenderScript)
 {
     uint32_t frame_count = 0;
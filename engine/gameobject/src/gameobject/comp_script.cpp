@@ -441,246 +441,252 @@ namespace dmGameObject
         return result;
     }
 
-    InputResult CompScriptOnInput(const ComponentOnInputParams& params)
+    // Pushes the action table passed to on_input
+    static void PushInputAction(lua_State* L, const InputAction* input_action)
     {
-        DM_PROFILE("RunScript");
-        InputResult result = INPUT_RESULT_IGNORED;
+        lua_createtable(L, 0, 16);
 
-        ScriptInstance* script_instance = (ScriptInstance*)*params.m_UserData;
+        int action_table = lua_gettop(L);
 
-        int function_ref = script_instance->m_Script->m_FunctionReferences[SCRIPT_FUNCTION_ONINPUT];
-        if (function_ref != LUA_NOREF)
+        if (input_action->m_IsGamepad)
         {
-            lua_State* L = GetLuaState(params.m_Context);
-            int top = lua_gettop(L);
-            (void)top;
-
-            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
-            dmScript::SetInstance(L);
+            lua_pushnumber(L, input_action->m_GamepadIndex);
+            lua_setfield(L, action_table, "gamepad");
 
-            lua_rawgeti(L, LUA_REGISTRYINDEX, function_ref);
-            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
-
-            // 0 is reserved for pure mouse movement
-            if (params.m_InputAction->m_ActionId != 0)
-            {
-                dmScript::PushHash(L, params.m_InputAction->m_ActionId);
-            }
-            else
-            {
-                lua_pushnil(L);
-            }
+            lua_pushinteger(L, input_action->m_UserID);
+            lua_setfield(L, action_table, "userid");
 
-            lua_createtable(L, 0, 16);
+            lua_pushboolean(L, input_action->m_GamepadUnknown);
+            lua_setfield(L, action_table, "gamepad_unknown");
+        }
 
-            int action_table = lua_gettop(L);
+        if (input_action->m_GamepadConnected)
+        {
+            lua_pushlstring(L, input_action->m_Text, input_action->m_TextCount);
+            lua_setfield(L, action_table, "gamepad_name");
+        }
 
-            if (params.m_InputAction->m_IsGamepad)
+        if (input_action->m_HasGamepadPacket)
+        {
+            dmHID::GamepadPacket gamepadPacket = input_action->m_GamepadPacket;
+            lua_pushliteral(L, "gamepad_axis");
+            lua_createtable(L, dmHID::MAX_GAMEPAD_AXIS_COUNT, 0);
+            for (int i = 0; i < dmHID::MAX_GAMEPAD_AXIS_COUNT; ++i)
             {
-                lua_pushnumber(L, params.m_InputAction->m_GamepadIndex);
-                lua_setfield(L, action_table, "gamepad");
-
-                lua_pushinteger(L, params.m_InputAction->m_UserID);
-                lua_setfield(L, action_table, "userid");
-
-                lua_pushboolean(L, params.m_InputAction->m_GamepadUnknown);
-                lua_setfield(L, action_table, "gamepad_unknown");
+                lua_pushinteger(L, (lua_Integer) (i+1));
+                lua_pushnumber(L, gamepadPacket.m_Axis[i]);
+                lua_settable(L, -3);
             }
+            lua_settable(L, -3);
 
-            if (params.m_InputAction->m_GamepadConnected)
+            lua_pushliteral(L, "gamepad_buttons");
+            lua_createtable(L, dmHID::MAX_GAMEPAD_BUTTON_COUNT, 0);
+            for (int i = 0; i < dmHID::MAX_GAMEPAD_BUTTON_COUNT; ++i)
             {
-                lua_pushlstring(L, params.m_InputAction->m_Text, params.m_InputAction->m_TextCount);
-                lua_setfield(L, action_table, "gamepad_name");
+                lua_pushinteger(L, (lua_Integer) (i+1));
+                lua_pushnumber(L, dmHID::GetGamepadButton(&gamepadPacket, i));
+                lua_settable(L, -3);
             }
+            lua_settable(L, -3);
 
-            if (params.m_InputAction->m_HasGamepadPacket)
+            lua_pushliteral(L, "gamepad_hats");
+            lua_createtable(L, dmHID::MAX_GAMEPAD_HAT_COUNT, 0);
+            for (int i = 0; i < dmHID::MAX_GAMEPAD_HAT_COUNT; ++i)
             {
-                dmHID::GamepadPacket gamepadPacket = params.m_InputAction->m_GamepadPacket;
-                lua_pushliteral(L, "gamepad_axis");
-                lua_createtable(L, dmHID::MAX_GAMEPAD_AXIS_COUNT, 0);
-                for (int i = 0; i < dmHID::MAX_GAMEPAD_AXIS_COUNT; ++i)
-                {
-                    lua_pushinteger(L, (lua_Integer) (i+1));
-                    lua_pushnumber(L, gamepadPacket.m_Axis[i]);
-                    lua_settable(L, -3);
-                }
-                lua_settable(L, -3);
-
-                lua_pushliteral(L, "gamepad_buttons");
-                lua_createtable(L, dmHID::MAX_GAMEPAD_BUTTON_COUNT, 0);
-                for (int i = 0; i < dmHID::MAX_GAMEPAD_BUTTON_COUNT; ++i)
+                lua_pushinteger(L, (lua_Integer) (i+1));
+                uint8_t hat_value;
+                if (dmHID::GetGamepadHat(&gamepadPacket, i, &hat_value))
                 {
-                    lua_pushinteger(L, (lua_Integer) (i+1));
-                    lua_pushnumber(L, dmHID::GetGamepadButton(&gamepadPacket, i));
-                    lua_settable(L, -3);
+                    lua_pushnumber(L, hat_value);
                 }
-                lua_settable(L, -3);
-
-                lua_pushliteral(L, "gamepad_hats");
-                lua_createtable(L, dmHID::MAX_GAMEPAD_HAT_COUNT, 0);
-                for (int i = 0; i < dmHID::MAX_GAMEPAD_HAT_COUNT; ++i)
+                else
                 {
-                    lua_pushinteger(L, (lua_Integer) (i+1));
-                    uint8_t hat_value;
-                    if (dmHID::GetGamepadHat(&gamepadPacket, i, &hat_value))
-                    {
-                        lua_pushnumber(L, hat_value);
-                    }
-                    else
-                    {
-                        lua_pushnumber(L, 0);
-                    }
-                    lua_settable(L, -3);
+                    lua_pushnumber(L, 0);
                 }
                 lua_settable(L, -3);
             }
+            lua_settable(L, -3);
+        }
 
-            if (params.m_InputAction->m_ActionId != 0)
-            {
-                lua_pushliteral(L, "value");
-                lua_pushnumber(L, params.m_InputAction->m_Value);
-                lua_settable(L, action_table);
+        if (input_action->m_ActionId != 0)
+        {
+            lua_pushliteral(L, "value");
+            lua_pushnumber(L, input_action->m_Value);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "pressed");
-                lua_pushboolean(L, params.m_InputAction->m_Pressed);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "pressed");
+            lua_pushboolean(L, input_action->m_Pressed);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "released");
-                lua_pushboolean(L, params.m_InputAction->m_Released);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "released");
+            lua_pushboolean(L, input_action->m_Released);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "repeated");
-                lua_pushboolean(L, params.m_InputAction->m_Repeated);
-                lua_settable(L, action_table);
-            }
+            lua_pushliteral(L, "repeated");
+            lua_pushboolean(L, input_action->m_Repeated);
+            lua_settable(L, action_table);
+        }
 
-            if (params.m_InputAction->m_PositionSet)
-            {
-                lua_pushliteral(L, "x");
-                lua_pushnumber(L, params.m_InputAction->m_X);
-                lua_settable(L, action_table);
+        if (input_action->m_PositionSet)
+        {
+            lua_pushliteral(L, "x");
+            lua_pushnumber(L, input_action->m_X);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "y");
-                lua_pushnumber(L, params.m_InputAction->m_Y);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "y");
+            lua_pushnumber(L, input_action->m_Y);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "dx");
-                lua_pushnumber(L, params.m_InputAction->m_DX);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "dx");
+            lua_pushnumber(L, input_action->m_DX);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "dy");
-                lua_pushnumber(L, params.m_InputAction->m_DY);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "dy");
+            lua_pushnumber(L, input_action->m_DY);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "screen_x");
-                lua_pushnumber(L, params.m_InputAction->m_ScreenX);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "screen_x");
+            lua_pushnumber(L, input_action->m_ScreenX);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "screen_y");
-                lua_pushnumber(L, params.m_InputAction->m_ScreenY);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "screen_y");
+            lua_pushnumber(L, input_action->m_ScreenY);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "screen_dx");
-                lua_pushnumber(L, params.m_InputAction->m_ScreenDX);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "screen_dx");
+            lua_pushnumber(L, input_action->m_ScreenDX);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "screen_dy");
-                lua_pushnumber(L, params.m_InputAction->m_ScreenDY);
-                lua_settable(L, action_table);
-            }
+            lua_pushliteral(L, "screen_dy");
+            lua_pushnumber(L, input_action->m_ScreenDY);
+            lua_settable(L, action_table);
+        }
 
-            if (params.m_InputAction->m_AccelerationSet)
-            {
-                lua_pushliteral(L, "acc_x");
-                lua_pushnumber(L, params.m_InputAction->m_AccX);
-                lua_settable(L, action_table);
+        if (input_action->m_AccelerationSet)
+        {
+            lua_pushliteral(L, "acc_x");
+            lua_pushnumber(L, input_action->m_AccX);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "acc_y");
-                lua_pushnumber(L, params.m_InputAction->m_AccY);
-                lua_settable(L, action_table);
+            lua_pushliteral(L, "acc_y");
+            lua_pushnumber(L, input_action->m_AccY);
+            lua_settable(L, action_table);
 
-                lua_pushliteral(L, "acc_z");
-                lua_pushnumber(L, params.m_InputAction->m_AccZ);
-                lua_settable(L, action_table);
-            }
+            lua_pushliteral(L, "acc_z");
+            lua_pushnumber(L, input_action->m_AccZ);
+            lua_settable(L, action_table);
+        }
 
-            if (params.m_InputAction->m_TouchCount > 0)
+        if (input_action->m_TouchCount > 0)
+        {
+            int tc = input_action->m_TouchCount;
+            lua_pushliteral(L, "touch");
+            lua_createtable(L, tc, 0);
+            for (int i = 0; i < tc; ++i)
             {
-                int tc = params.m_InputAction->m_TouchCount;
-                lua_pushliteral(L, "touch");
-                lua_createtable(L, tc, 0);
-                for (int i = 0; i < tc; ++i)
-                {
-                    const dmHID::Touch& t = params.m_InputAction->m_Touch[i];
+                const dmHID::Touch& t = input_action->m_Touch[i];
 
-                    lua_pushinteger(L, (lua_Integer) (i+1));
-                    lua_createtable(L, 0, 6);
+                lua_pushinteger(L, (lua_Integer) (i+1));
+                lua_createtable(L, 0, 6);
 
-                    lua_pushliteral(L, "id");
-                    lua_pushinteger(L, (lua_Integer) t.m_Id);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "id");
+                lua_pushinteger(L, (lua_Integer) t.m_Id);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "tap_count");
-                    lua_pushinteger(L, (lua_Integer) t.m_TapCount);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "tap_count");
+                lua_pushinteger(L, (lua_Integer) t.m_TapCount);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "pressed");
-                    lua_pushboolean(L, t.m_Phase == dmHID::PHASE_BEGAN);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "pressed");
+                lua_pushboolean(L, t.m_Phase == dmHID::PHASE_BEGAN);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "released");
-                    lua_pushboolean(L, t.m_Phase == dmHID::PHASE_ENDED || t.m_Phase == dmHID::PHASE_CANCELLED);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "released");
+                lua_pushboolean(L, t.m_Phase == dmHID::PHASE_ENDED || t.m_Phase == dmHID::PHASE_CANCELLED);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "x");
-                    lua_pushinteger(L, (lua_Integer) t.m_X);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "x");
+                lua_pushinteger(L, (lua_Integer) t.m_X);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "y");
-                    lua_pushinteger(L, (lua_Integer) t.m_Y);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "y");
+                lua_pushinteger(L, (lua_Integer) t.m_Y);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "screen_x");
-                    lua_pushnumber(L, (lua_Integer) t.m_ScreenX);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "screen_x");
+                lua_pushnumber(L, (lua_Integer) t.m_ScreenX);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "screen_y");
-                    lua_pushnumber(L, (lua_Integer) t.m_ScreenY);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "screen_y");
+                lua_pushnumber(L, (lua_Integer) t.m_ScreenY);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "dx");
-                    lua_pushinteger(L, (lua_Integer) t.m_DX);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "dx");
+                lua_pushinteger(L, (lua_Integer) t.m_DX);
+                lua_settable(L, -3);
 
-                    lua_pushliteral(L, "dy");
-                    lua_pushinteger(L, (lua_Integer) t.m_DY);
-                    lua_settable(L, -3);
+                lua_pushliteral(L, "dy");
+                lua_pushinteger(L, (lua_Integer) t.m_DY);
+                lua_settable(L, -3);
 
-                    lua_pushstring(L, "screen_dx");
-                    lua_pushnumber(L, (lua_Integer) t.m_ScreenDX);
-                    lua_rawset(L, -3);
+                lua_pushstring(L, "screen_dx");
+                lua_pushnumber(L, (lua_Integer) t.m_ScreenDX);
+                lua_rawset(L, -3);
 
-                    lua_pushstring(L, "screen_dy");
-                    lua_pushnumber(L, (lua_Integer) t.m_ScreenDY);
-                    lua_rawset(L, -3);
+                lua_pushstring(L, "screen_dy");
+                lua_pushnumber(L, (lua_Integer) t.m_ScreenDY);
+                lua_rawset(L, -3);
 
-                    lua_settable(L, -3);
-                }
                 lua_settable(L, -3);
             }
+            lua_settable(L, -3);
+        }
 
-            if (params.m_InputAction->m_HasText)
+        if (input_action->m_HasText)
+        {
+            int tc = input_action->m_TextCount;
+            lua_pushliteral(L, "text");
+            if (tc == 0) {
+                lua_pushstring(L, "");
+            } else {
+                lua_pushlstring(L, input_action->m_Text, tc);
+            }
+            lua_settable(L, -3);
+        }
+    }
+
+    InputResult CompScriptOnInput(const ComponentOnInputParams& params)
+    {
+        DM_PROFILE("RunScript");
+        InputResult result = INPUT_RESULT_IGNORED;
+
+        ScriptInstance* script_instance = (ScriptInstance*)*params.m_UserData;
+
+        int function_ref = script_instance->m_Script->m_FunctionReferences[SCRIPT_FUNCTION_ONINPUT];
+        if (function_ref != LUA_NOREF)
+        {
+            lua_State* L = GetLuaState(params.m_Context);
+            int top = lua_gettop(L);
+            (void)top;
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
+            dmScript::SetInstance(L);
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, function_ref);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
+
+            // 0 is reserved for pure mouse movement
+            if (params.m_InputAction->m_ActionId != 0)
             {
-                int tc = params.m_InputAction->m_TextCount;
-                lua_pushliteral(L, "text");
-                if (tc == 0) {
-                    lua_pushstring(L, "");
-                } else {
-                    lua_pushlstring(L, params.m_InputAction->m_Text, tc);
-                }
-                lua_settable(L, -3);
+                dmScript::PushHash(L, params.m_InputAction->m_ActionId);
+            }
+            else
+            {
+                lua_pushnil(L);
             }
 
+            PushInputAction(L, params.m_InputAction);
+
             int arg_count = 3;
             int input_ret = lua_gettop(L) - arg_count;
             int ret;
@@ -722,6 +728,112 @@ namespace dmGameObject
         return result;
     }
 
+    InputMode CompScriptGetInputMode(void* context, uintptr_t* user_data)
+    {
+        ScriptInstance* script_instance = (ScriptInstance*)*user_data;
+        const int* function_refs = script_instance->m_Script->m_FunctionReferences;
+        if (function_refs[SCRIPT_FUNCTION_ONINPUTBATCH] != LUA_NOREF)
+            return INPUT_MODE_BATCH;
+        if (function_refs[SCRIPT_FUNCTION_ONINPUT] != LUA_NOREF)
+            return INPUT_MODE_ACTION;
+        return INPUT_MODE_NONE;
+    }
+
+    InputResult CompScriptOnInputBatch(const ComponentOnInputBatchParams& params)
+    {
+        DM_PROFILE("RunScript");
+        InputResult result = INPUT_RESULT_IGNORED;
+
+        ScriptInstance* script_instance = (ScriptInstance*)*params.m_UserData;
+
+        int function_ref = script_instance->m_Script->m_FunctionReferences[SCRIPT_FUNCTION_ONINPUTBATCH];
+        if (function_ref != LUA_NOREF)
+        {
+            lua_State* L = GetLuaState(params.m_Context);
+            int top = lua_gettop(L);
+            (void)top;
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
+            dmScript::SetInstance(L);
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, function_ref);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, script_instance->m_InstanceReference);
+
+            // An array of the same action tables as on_input gets, with the action id in "action_id"
+            lua_createtable(L, params.m_InputActionCount, 0);
+            for (uint32_t i = 0; i < params.m_InputActionCount; ++i)
+            {
+                const InputAction* input_action = params.m_InputActions[i];
+                PushInputAction(L, input_action);
+
+                // 0 is reserved for pure mouse movement
+                if (input_action->m_ActionId != 0)
+                {
+                    dmScript::PushHash(L, input_action->m_ActionId);
+                    lua_setfield(L, -2, "action_id");
+                }
+
+                lua_rawseti(L, -2, i + 1);
+            }
+
+            int arg_count = 2;
+            int ret;
+            {
+                char buffer[128];
+                const char* profiler_string = dmScript::GetProfilerString(L, 0, script_instance->m_Script->m_LuaModule->m_Source.m_Filename, SCRIPT_FUNCTION_NAMES[SCRIPT_FUNCTION_ONINPUTBATCH], 0, buffer, sizeof(buffer));
+                DM_PROFILE_DYN(profiler_string, 0);
+
+                ret = dmScript::PCall(L, arg_count, 1);
+            }
+            if (ret != 0)
+            {
+                result = INPUT_RESULT_UNKNOWN_ERROR;
+            }
+            else
+            {
+                // Either true to consume all the actions, or an array with the indices of the consumed actions
+                if (lua_isboolean(L, -1))
+                {
+                    if (lua_toboolean(L, -1))
+                    {
+                        memset(params.m_Consumed, 1, params.m_InputActionCount);
+                        result = INPUT_RESULT_CONSUMED;
+                    }
+                }
+                else if (lua_istable(L, -1))
+                {
+                    int count = lua_objlen(L, -1);
+                    for (int i = 1; i <= count; ++i)
+                    {
+                        lua_rawgeti(L, -1, i);
+                        int index = lua_isnumber(L, -1) ? (int) lua_tointeger(L, -1) : 0;
+                        lua_pop(L, 1);
+                        if (index < 1 || index > (int) params.m_InputActionCount)
+                        {
+                            dmLogError("Script %s returned an invalid action index.", SCRIPT_FUNCTION_NAMES[SCRIPT_FUNCTION_ONINPUTBATCH]);
+                            result = INPUT_RESULT_UNKNOWN_ERROR;
+                            break;
+                        }
+                        params.m_Consumed[index - 1] = 1;
+                        result = INPUT_RESULT_CONSUMED;
+                    }
+                }
+                else if (!lua_isnil(L, -1))
+                {
+                    dmLogError("Script %s must return a boolean value, a table of consumed action indices, or no value at all.", SCRIPT_FUNCTION_NAMES[SCRIPT_FUNCTION_ONINPUTBATCH]);
+                    result = INPUT_RESULT_UNKNOWN_ERROR;
+                }
+                lua_pop(L, 1);
+            }
+
+            lua_pushnil(L);
+            dmScript::SetInstance(L);
+
+            assert(top == lua_gettop(L));
+        }
+        return result;
+    }
+
     void CompScriptOnReload(const ComponentOnReloadParams& params)
     {
         HScriptInstance script_instance = (HScriptInstance)*params.m_UserData;
@@ -40,6 +40,10 @@ namespace dmGameObject
 
     InputResult CompScriptOnInput(const ComponentOnInputParams& params);
 
+    InputMode CompScriptGetInputMode(void* context, uintptr_t* user_data);
+
+    InputResult CompScriptOnInputBatch(const ComponentOnInputBatchParams& params);
+
     void CompScriptOnReload(const ComponentOnReloadParams& params);
 
     PropertyResult CompScriptSetProperties(const ComponentSetPropertiesParams& params);
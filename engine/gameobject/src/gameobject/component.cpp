@@ -117,6 +117,8 @@ void ComponentTypeSetFixedUpdateFn(ComponentType* type, ComponentsFixedUpdate fn
 void ComponentTypeSetPostUpdateFn(ComponentType* type, ComponentsPostUpdate fn)             { type->m_PostUpdateFunction = fn; }
 void ComponentTypeSetOnMessageFn(ComponentType* type, ComponentOnMessage fn)                { type->m_OnMessageFunction = fn; }
 void ComponentTypeSetOnInputFn(ComponentType* type, ComponentOnInput fn)                    { type->m_OnInputFunction = fn; }
+void ComponentTypeSetGetInputModeFn(ComponentType* type, ComponentGetInputMode fn)          { type->m_GetInputModeFunction = fn; }
+void ComponentTypeSetOnInputBatchFn(ComponentType* type, ComponentOnInputBatch fn)          { type->m_OnInputBatchFunction = fn; }
 void ComponentTypeSetOnReloadFn(ComponentType* type, ComponentOnReload fn)                  { type->m_OnReloadFunction = fn; }
 void ComponentTypeSetSetPropertiesFn(ComponentType* type, ComponentSetProperties fn)        { type->m_SetPropertiesFunction = fn; }
 void ComponentTypeSetGetPropertyFn(ComponentType* type, ComponentGetProperty fn)            { type->m_GetPropertyFunction = fn; }
@@ -22,6 +22,49 @@
 
 namespace dmGameObject
 {
+    /*#
+     * How a component instance wants to receive input
+     */
+    enum InputMode
+    {
+        INPUT_MODE_NONE   = 0, // Doesn't handle input at all
+        INPUT_MODE_ACTION = 1, // One ComponentOnInput call per input action
+        INPUT_MODE_BATCH  = 2, // One ComponentOnInputBatch call with all the input actions of the frame
+    };
+
+    /*#
+     * Component get-input-mode function. If not set, components with a ComponentOnInput function use INPUT_MODE_ACTION
+     * @param context User context
+     * @param user_data User data storage pointer
+     * @return How the component instance wants to receive input
+     */
+    typedef InputMode (*ComponentGetInputMode)(void* context, uintptr_t* user_data);
+
+    /*#
+     * Parameters to ComponentOnInputBatch callback.
+     */
+    struct ComponentOnInputBatchParams
+    {
+        /// Instance handle
+        HInstance           m_Instance;
+        /// The input actions that reached this component, in the order they occurred
+        const InputAction** m_InputActions;
+        uint32_t            m_InputActionCount;
+        /// Out: set to 1 for each input action the component consumed
+        uint8_t*            m_Consumed;
+        /// User context
+        void*               m_Context;
+        /// User data storage pointer
+        uintptr_t*          m_UserData;
+    };
+
+    /*#
+     * Component on-input-batch function. Called once per frame with all input actions for components in INPUT_MODE_BATCH
+     * @param params Input parameters
+     * @return INPUT_RESULT_UNKNOWN_ERROR on failure
+     */
+    typedef InputResult (*ComponentOnInputBatch)(const ComponentOnInputBatchParams& params);
+
     /*#
      * Collection of component registration data.
      */
@@ -47,6 +90,8 @@ namespace dmGameObject
         ComponentsPostUpdate    m_PostUpdateFunction;
         ComponentOnMessage      m_OnMessageFunction;
         ComponentOnInput        m_OnInputFunction;
+        ComponentGetInputMode   m_GetInputModeFunction;
+        ComponentOnInputBatch   m_OnInputBatchFunction;
         ComponentOnReload       m_OnReloadFunction;
         ComponentSetProperties  m_SetPropertiesFunction;
         ComponentGetProperty    m_GetPropertyFunction;
@@ -109,6 +154,9 @@ namespace dmGameObject
      */
     void SortComponentTypes(HRegister regist);
 
+    void ComponentTypeSetGetInputModeFn(ComponentType* type, ComponentGetInputMode fn);
+    void ComponentTypeSetOnInputBatchFn(ComponentType* type, ComponentOnInputBatch fn);
+
 
     struct ComponentTypeDescriptor
     {
@@ -16,6 +16,7 @@
 #include <algorithm>
 #include <stdio.h>
 #include <dlib/dstrings.h>
+#include <dlib/frame_arena.h>
 #include <dlib/log.h>
 #include <dlib/hashtable.h>
 #include <dlib/message.h>
@@ -208,6 +209,7 @@ namespace dmGameObject
         m_WorldTransforms.SetSize(max_instances);
         m_IDToInstance.SetCapacity(dmMath::Max(1U, max_instances/3), max_instances);
         m_InputFocusStack.SetCapacity(max_input_stack_entries);
+        m_InputRoutesDirty = 1;
         m_NameHash = 0;
         m_ComponentSocket = 0;
         m_FrameSocket = 0;
@@ -1307,8 +1309,8 @@ namespace dmGameObject
         // table for output ids
         id_mapping->SetCapacity(32, collection_desc->m_Instances.m_Count);
 
-        dmArray<HInstance> new_instances;
-        new_instances.SetCapacity(collection_desc->m_Instances.m_Count);
+        uint32_t instance_count = collection_desc->m_Instances.m_Count;
+        dmArray<HInstance> new_instances(dmFrameArena::Alloc<HInstance>(instance_count), 0, instance_count);
 
         bool success = true;
 
@@ -1447,8 +1449,7 @@ namespace dmGameObject
 
         // After this point, instances are either removed (through undo) on error, or added
         // to the 'created' array from which they can be deleted on error.
-        dmArray<HInstance> created;
-        created.SetCapacity(collection_desc->m_Instances.m_Count);
+        dmArray<HInstance> created(dmFrameArena::Alloc<HInstance>(instance_count), 0, instance_count);
 
         for (uint32_t i = 0; i < collection_desc->m_Instances.m_Count; ++i)
         {
@@ -1985,6 +1986,7 @@ namespace dmGameObject
         if (found_instance)
         {
             collection->m_InputFocusStack.Pop();
+            collection->m_InputRoutesDirty = 1;
         }
 
         DeallocInstance(instance);
@@ -2820,61 +2822,211 @@ namespace dmGameObject
         return result;
     }
 
+    static void BuildInputRoutes(Collection* collection)
+    {
+        dmArray<InputRoute>& routes = collection->m_InputRoutes;
+        routes.SetSize(0);
+
+        // iterate stack from top to bottom
+        uint32_t stack_size = collection->m_InputFocusStack.Size();
+        for (uint32_t k = 0; k < stack_size; ++k)
+        {
+            Instance* instance = collection->m_InputFocusStack[stack_size - 1 - k];
+            Prototype* prototype = instance->m_Prototype;
+            uint32_t components_size = prototype->m_ComponentCount;
+
+            uint32_t next_component_instance_data = 0;
+            for (uint32_t l = 0; l < components_size; ++l)
+            {
+                ComponentType* component_type = prototype->m_Components[l].m_Type;
+                assert(component_type);
+
+                uint16_t component_instance_data = INVALID_INPUT_ROUTE_DATA;
+                if (component_type->m_InstanceHasUserData)
+                {
+                    component_instance_data = (uint16_t) next_component_instance_data++;
+                }
+
+                if (!component_type->m_OnInputFunction)
+                {
+                    continue;
+                }
+
+                InputMode mode = INPUT_MODE_ACTION;
+                if (component_type->m_GetInputModeFunction)
+                {
+                    uintptr_t* user_data = component_instance_data != INVALID_INPUT_ROUTE_DATA ? &instance->m_ComponentInstanceUserData[component_instance_data] : 0;
+                    mode = component_type->m_GetInputModeFunction(component_type->m_Context, user_data);
+                }
+                if (mode == INPUT_MODE_NONE)
+                {
+                    continue;
+                }
+
+                if (routes.Full())
+                {
+                    routes.OffsetCapacity(dmMath::Max(16U, routes.Capacity()));
+                }
+
+                InputRoute route;
+                route.m_Instance              = instance;
+                route.m_Type                  = component_type;
+                route.m_ComponentInstanceData = component_instance_data;
+                route.m_Batch                 = mode == INPUT_MODE_BATCH && component_type->m_OnInputBatchFunction != 0;
+                routes.Push(route);
+            }
+        }
+
+        collection->m_InputRoutesDirty = 0;
+    }
+
+    static inline bool IsDispatchedInputAction(const InputAction& input_action)
+    {
+        return input_action.m_ActionId != 0 || input_action.m_PositionSet || input_action.m_AccelerationSet;
+    }
+
+    static inline uintptr_t* GetInputRouteUserData(const InputRoute& route)
+    {
+        if (route.m_ComponentInstanceData == INVALID_INPUT_ROUTE_DATA)
+            return 0;
+        return &route.m_Instance->m_ComponentInstanceUserData[route.m_ComponentInstanceData];
+    }
+
+    static void ClearConsumedInputActions(Instance** consumed_by, InputAction* input_actions, uint32_t input_action_count)
+    {
+        for (uint32_t i = 0; i < input_action_count; ++i)
+        {
+            if (consumed_by[i] != 0)
+            {
+                InputAction& input_action = input_actions[i];
+                memset(&input_action, 0, sizeof(InputAction));
+                input_action.m_Consumed = 1;
+            }
+        }
+    }
+
+    // Delivers all actions that weren't consumed further up the stack to a component in one call
+    static InputResult DispatchInputBatch(const InputRoute& route, Instance** consumed_by, InputAction* input_actions, uint32_t input_action_count)
+    {
+        const InputAction** batch = dmFrameArena::Alloc<const InputAction*>(input_action_count);
+        uint32_t batch_size = 0;
+        for (uint32_t i = 0; i < input_action_count; ++i)
+        {
+            if (IsDispatchedInputAction(input_actions[i]) && (consumed_by[i] == 0 || consumed_by[i] == route.m_Instance))
+            {
+                batch[batch_size++] = &input_actions[i];
+            }
+        }
+
+        if (batch_size == 0)
+        {
+            return INPUT_RESULT_IGNORED;
+        }
+
+        uint8_t* consumed = dmFrameArena::Alloc<uint8_t>(batch_size);
+        memset(consumed, 0, batch_size);
+
+        ComponentOnInputBatchParams params;
+        params.m_Instance = route.m_Instance;
+        params.m_InputActions = batch;
+        params.m_InputActionCount = batch_size;
+        params.m_Consumed = consumed;
+        params.m_Context = route.m_Type->m_Context;
+        params.m_UserData = GetInputRouteUserData(route);
+        InputResult res = route.m_Type->m_OnInputBatchFunction(params);
+
+        for (uint32_t j = 0; j < batch_size; ++j)
+        {
+            if (consumed[j])
+            {
+                consumed_by[batch[j] - input_actions] = route.m_Instance;
+            }
+        }
+        return res;
+    }
+
     UpdateResult DispatchInput(Collection* collection, InputAction* input_actions, uint32_t input_action_count)
     {
         DM_PROFILE("DispatchInput");
 
-        // iterate stacks from top to bottom
-        for (uint32_t i = 0; i < input_action_count; ++i)
+        if (collection->m_InputRoutesDirty)
+        {
+            BuildInputRoutes(collection);
+        }
+
+        const dmArray<InputRoute>& routes = collection->m_InputRoutes;
+        uint32_t route_count = routes.Size();
+        if (route_count == 0 || input_action_count == 0)
+        {
+            return UPDATE_RESULT_OK;
+        }
+
+        // The instance that consumed each action. The other components of that instance
+        // still receive the action, but the instances further down the stack don't
+        Instance** consumed_by = dmFrameArena::Alloc<Instance*>(input_action_count);
+        memset(consumed_by, 0, sizeof(Instance*) * input_action_count);
+
+        uint32_t band_start = 0;
+        while (band_start < route_count)
         {
-            InputAction& input_action = input_actions[i];
-            if (input_action.m_ActionId != 0 || input_action.m_PositionSet || input_action.m_AccelerationSet)
+            // The routes up to the next batched one get one call per action, each action going
+            // from the top of the stack to the bottom
+            uint32_t band_end = band_start;
+            while (band_end < route_count && !routes[band_end].m_Batch)
+            {
+                ++band_end;
+            }
+
+            for (uint32_t i = 0; i < input_action_count && band_start < band_end; ++i)
             {
-                uint32_t stack_size = collection->m_InputFocusStack.Size();
-                for (uint32_t k = 0; k < stack_size; ++k)
+                InputAction& input_action = input_actions[i];
+                if (!IsDispatchedInputAction(input_action))
+                {
+                    continue;
+                }
+
+                for (uint32_t r = band_start; r < band_end; ++r)
                 {
-                    HInstance instance = collection->m_InputFocusStack[stack_size - 1 - k];
-                    Prototype* prototype = instance->m_Prototype;
-                    uint32_t components_size = prototype->m_ComponentCount;
+                    const InputRoute& route = routes[r];
+                    if (consumed_by[i] != 0 && consumed_by[i] != route.m_Instance)
+                    {
+                        // The routes are grouped per instance, so the rest are further down the stack
+                        break;
+                    }
 
-                    InputResult res = INPUT_RESULT_IGNORED;
-                    uint32_t next_component_instance_data = 0;
-                    for (uint32_t l = 0; l < components_size; ++l)
+                    ComponentOnInputParams params;
+                    params.m_Instance = route.m_Instance;
+                    params.m_InputAction = &input_action;
+                    params.m_Context = route.m_Type->m_Context;
+                    params.m_UserData = GetInputRouteUserData(route);
+                    InputResult comp_res = route.m_Type->m_OnInputFunction(params);
+                    if (comp_res == INPUT_RESULT_CONSUMED)
                     {
-                        ComponentType* component_type = prototype->m_Components[l].m_Type;
-                        assert(component_type);
-                        if (component_type->m_OnInputFunction)
-                        {
-                            uintptr_t* component_instance_data = 0;
-                            if (component_type->m_InstanceHasUserData)
-                            {
-                                component_instance_data = &instance->m_ComponentInstanceUserData[next_component_instance_data];
-                            }
-                            ComponentOnInputParams params;
-                            params.m_Instance = instance;
-                            params.m_InputAction = &input_action;
-                            params.m_Context = component_type->m_Context;
-                            params.m_UserData = component_instance_data;
-                            InputResult comp_res = component_type->m_OnInputFunction(params);
-                            if (comp_res == INPUT_RESULT_CONSUMED)
-                                res = comp_res;
-                            else if (comp_res == INPUT_RESULT_UNKNOWN_ERROR)
-                                return UPDATE_RESULT_UNKNOWN_ERROR;
-                        }
-                        if (component_type->m_InstanceHasUserData)
-                        {
-                            next_component_instance_data++;
-                        }
+                        consumed_by[i] = route.m_Instance;
                     }
-                    if (res == INPUT_RESULT_CONSUMED)
+                    else if (comp_res == INPUT_RESULT_UNKNOWN_ERROR)
                     {
-                        memset(&input_action, 0, sizeof(InputAction));
-                        input_action.m_Consumed = 1;
-                        break;
+                        ClearConsumedInputActions(consumed_by, input_actions, input_action_count);
+                        return UPDATE_RESULT_UNKNOWN_ERROR;
                     }
                 }
             }
+
+            // The batched route gets all the actions the routes above it didn't consume
+            if (band_end < route_count)
+            {
+                if (DispatchInputBatch(routes[band_end], consumed_by, input_actions, input_action_count) == INPUT_RESULT_UNKNOWN_ERROR)
+                {
+                    ClearConsumedInputActions(consumed_by, input_actions, input_action_count);
+                    return UPDATE_RESULT_UNKNOWN_ERROR;
+                }
+                ++band_end;
+            }
+
+            band_start = band_end;
         }
+
+        ClearConsumedInputActions(consumed_by, input_actions, input_action_count);
         return UPDATE_RESULT_OK;
     }
 
@@ -2904,6 +3056,7 @@ namespace dmGameObject
         if (!collection->m_InputFocusStack.Full())
         {
             collection->m_InputFocusStack.Push(instance);
+            collection->m_InputRoutesDirty = 1;
         }
         else
         {
@@ -2928,6 +3081,7 @@ namespace dmGameObject
         if (found)
         {
             collection->m_InputFocusStack.Pop();
+            collection->m_InputRoutesDirty = 1;
         }
     }
 
@@ -3698,6 +3852,10 @@ namespace dmGameObject
     static void ResourceReloadedCallback(const dmResource::ResourceReloadedParams& params)
     {
         Collection* collection = (Collection*) params.m_UserData;
+
+        // Reloaded instances or scripts might change how input is routed
+        collection->m_InputRoutesDirty = 1;
+
         for (uint32_t level_i = 0; level_i < MAX_HIERARCHICAL_DEPTH; ++level_i)
         {
             dmArray<uint16_t>& level = collection->m_LevelIndices[level_i];
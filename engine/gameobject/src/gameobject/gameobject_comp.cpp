@@ -38,6 +38,8 @@ namespace dmGameObject
         ComponentTypeSetFixedUpdateFn(type, CompScriptFixedUpdate);
         ComponentTypeSetOnMessageFn(type, CompScriptOnMessage);
         ComponentTypeSetOnInputFn(type, CompScriptOnInput);
+        ComponentTypeSetGetInputModeFn(type, CompScriptGetInputMode);
+        ComponentTypeSetOnInputBatchFn(type, CompScriptOnInputBatch);
         ComponentTypeSetOnReloadFn(type, CompScriptOnReload);
         ComponentTypeSetSetPropertiesFn(type, CompScriptSetProperties);
         ComponentTypeSetGetPropertyFn(type, CompScriptGetProperty);
@@ -213,6 +213,19 @@ namespace dmGameObject
     // depth is interpreted as up to <depth> levels of child nodes including root-nodes
     // Must be greater than zero
     const uint32_t MAX_HIERARCHICAL_DEPTH = 128;
+
+    // A component that receives input, see Collection::m_InputRoutes
+    struct InputRoute
+    {
+        Instance*      m_Instance;
+        ComponentType* m_Type;
+        uint16_t       m_ComponentInstanceData; // Index into Instance::m_ComponentInstanceUserData, or INVALID_INPUT_ROUTE_DATA
+        uint16_t       m_Batch : 1;             // INPUT_MODE_BATCH
+        uint16_t       : 15;
+    };
+
+    const uint16_t INVALID_INPUT_ROUTE_DATA = 0xFFFF;
+
     struct Collection
     {
         Collection(dmResource::HFactory factory, HRegister regist, uint32_t max_instances, uint32_t max_input_stack_entries);
@@ -259,6 +272,10 @@ namespace dmGameObject
         // Stack keeping track of which instance has the input focus
         dmArray<Instance*>       m_InputFocusStack;
 
+        // The components that receive input, from the top of the input focus stack to the bottom.
+        // Rebuilt lazily when m_InputRoutesDirty is set
+        dmArray<InputRoute>      m_InputRoutes;
+
         // Array of dynamically created resources (i.e runtime-only resources)
         dmArray<dmhash_t>        m_DynamicResources;
 
@@ -298,6 +315,7 @@ namespace dmGameObject
         uint32_t                 m_DirtyTransforms : 1;
         uint32_t                 m_Initialized : 1;
         uint32_t                 m_FirstUpdate : 1;
+        uint32_t                 m_InputRoutesDirty : 1;
     };
 
     struct CollectionHandle
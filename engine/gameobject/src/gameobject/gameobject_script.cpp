@@ -23,6 +23,7 @@
 #include <dlib/hashtable.h>
 #include <dlib/message.h>
 #include <dlib/dstrings.h>
+#include <dlib/frame_arena.h>
 #include <dlib/profile.h>
 #include <dmsdk/dlib/vmath.h>
 
@@ -163,6 +164,7 @@ namespace dmGameObject
         "fixed_update",
         "on_message",
         "on_input",
+        "on_input_batch",
         "on_reload"
     };
 
@@ -542,22 +544,22 @@ namespace dmGameObject
 
     Result PostScriptMessage(const dmDDF::Descriptor* payload_descriptor, const uint8_t* payload, uint32_t payload_size, const dmMessage::URL* sender, const dmMessage::URL* receiver, int function_ref, bool unref_function_after_call)
     {
-        dmArray<uint8_t> msg_buffer;
-        msg_buffer.SetCapacity(sizeof(dmGameObjectDDF::ScriptMessage) + payload_size);
-        msg_buffer.SetSize(msg_buffer.Capacity());
+        // Post() copies the message, so the buffer only has to live for this call
+        uint32_t msg_size = sizeof(dmGameObjectDDF::ScriptMessage) + payload_size;
+        uint8_t* msg_buffer = (uint8_t*) dmFrameArena::Alloc(msg_size);
 
-        dmGameObjectDDF::ScriptMessage* script_msg = (dmGameObjectDDF::ScriptMessage*)msg_buffer.Begin();
+        dmGameObjectDDF::ScriptMessage* script_msg = (dmGameObjectDDF::ScriptMessage*)msg_buffer;
         script_msg->m_PayloadSize = payload_size;
         script_msg->m_DescriptorHash = payload_descriptor->m_NameHash;
         script_msg->m_Function = function_ref;
         script_msg->m_UnrefFunction = unref_function_after_call;
 
-        uint8_t* message_payload = msg_buffer.Begin() + sizeof(dmGameObjectDDF::ScriptMessage);
+        uint8_t* message_payload = msg_buffer + sizeof(dmGameObjectDDF::ScriptMessage);
         memcpy(message_payload, payload, payload_size);
 
         dmDDF::Descriptor* descriptor = dmGameObjectDDF::ScriptMessage::m_DDFDescriptor;
         dmMessage::Result result = Post(sender, receiver, descriptor->m_NameHash, 0, 0,
-                                        (uintptr_t)descriptor, msg_buffer.Begin(), msg_buffer.Size(), 0);
+                                        (uintptr_t)descriptor, msg_buffer, msg_size, 0);
 
         if (dmMessage::RESULT_OK != result)
         {
@@ -2984,6 +2986,38 @@ bail:
      * ```
      */
 
+    /*# called when user input is received, with all input actions of the frame
+     *
+     * This is an alternative to `on_input`. If a script defines `on_input_batch`, it is called
+     * once per frame with all the input actions that reached the instance, instead of calling
+     * `on_input` once per action. Each entry is the same table as the `action` passed to
+     * `on_input`, with the action id in the `action_id` field (nil for pure mouse movement).
+     *
+     * Actions are consumed either by returning `true` to consume all of them, or by
+     * returning an array with the indices of the consumed actions.
+     *
+     * @name on_input_batch
+     * @param self [type:object] reference to the script state to be used for storing data
+     * @param actions [type:table] an array of the input action tables, in the order they occurred
+     * @return consume [type:boolean|table|nil] optional boolean to consume all actions, or an array with the indices of the consumed actions
+     * @examples
+     *
+     * ```lua
+     * function on_input_batch(self, actions)
+     *     local consumed = {}
+     *     for i, action in ipairs(actions) do
+     *         if action.action_id == hash("touch") and action.touch then
+     *             for _, touch in ipairs(action.touch) do
+     *                 handle_touch(self, touch)
+     *             end
+     *             table.insert(consumed, i)
+     *         end
+     *     end
+     *     return consumed
+     * end
+     * ```
+     */
+
     /*# called when the script component is reloaded
      *
      * This is a callback-function, which is called by the engine when the script component is reloaded, e.g. from the editor.
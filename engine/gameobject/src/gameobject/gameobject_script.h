@@ -50,6 +50,7 @@ namespace dmGameObject
         SCRIPT_FUNCTION_FIXED_UPDATE,
         SCRIPT_FUNCTION_ONMESSAGE,
         SCRIPT_FUNCTION_ONINPUT,
+        SCRIPT_FUNCTION_ONINPUTBATCH,
         SCRIPT_FUNCTION_ONRELOAD,
         MAX_SCRIPT_FUNCTION_COUNT
     };
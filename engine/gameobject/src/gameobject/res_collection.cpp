@@ -247,6 +247,7 @@ bail:
         size += collection->m_WorldTransforms.Capacity()*sizeof(Matrix4);
         size += collection->m_IDToInstance.Capacity()*(sizeof(Instance*)+sizeof(dmhash_t));
         size += collection->m_InputFocusStack.Capacity()*sizeof(Instance*);
+        size += collection->m_InputRoutes.Capacity()*sizeof(InputRoute);
         size += collection->m_Instances.Capacity()*sizeof(Instance*);
         return size;
     }
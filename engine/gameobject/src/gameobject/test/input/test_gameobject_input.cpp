@@ -12,12 +12,16 @@
 // CONDITIONS OF ANY KIND, either express or implied. See the License for the
 // specific language governing permissions and limitations under the License.
 
+#include <stdio.h>
+#include <string.h>
+
 #include <jc_test/jc_test.h>
 
 #include <dmsdk/dlib/vmath.h>
 
 #include <dlib/hash.h>
 #include <dlib/dstrings.h>
+#include <dlib/time.h>
 
 #include <resource/resource.h>
 
@@ -305,3 +309,93 @@ TEST_F(InputTest, TestDeleteFocusInstance)
 
     ASSERT_EQ(dmGameObject::UPDATE_RESULT_OK, r);
 }
+
+TEST_F(InputTest, TestComponentInputBatch)
+{
+    dmGameObject::HInstance go_bottom = dmGameObject::New(m_Collection, "/input_target.goc");
+    ASSERT_NE((void*) 0, (void*) go_bottom);
+    dmGameObject::HInstance go_top = dmGameObject::New(m_Collection, "/component_input_batch.goc");
+    ASSERT_NE((void*) 0, (void*) go_top);
+
+    dmGameObject::AcquireInputFocus(m_Collection, go_bottom);
+    dmGameObject::AcquireInputFocus(m_Collection, go_top);
+
+    dmGameObject::InputAction actions[4];
+    actions[0].m_ActionId = dmHashString64("test_action");
+    actions[0].m_Value = 1.0f;
+    actions[0].m_Pressed = 1;
+
+    actions[1].m_PositionSet = true;
+    actions[1].m_X = 1.0f;
+    actions[1].m_Y = 2.0f;
+
+    // actions[2] is empty and should never reach the components
+
+    actions[3].m_ActionId = dmHashString64("test_action");
+    actions[3].m_TouchCount = 2;
+    actions[3].m_Touch[0].m_Id = 0;
+    actions[3].m_Touch[1].m_Id = 1;
+
+    dmGameObject::UpdateResult r = dmGameObject::DispatchInput(m_Collection, actions, 4);
+    ASSERT_EQ(dmGameObject::UPDATE_RESULT_OK, r);
+
+    // The script only consumes the position action, the rest fall through to the target below
+    ASSERT_EQ(2U, m_InputCounter);
+    ASSERT_EQ(1U, actions[0].m_Consumed);
+    ASSERT_EQ(1U, actions[1].m_Consumed);
+    ASSERT_EQ(0U, actions[2].m_Consumed);
+    ASSERT_EQ(1U, actions[3].m_Consumed);
+}
+
+static uint64_t DispatchInputBench(InputTest* test, const char* prototype, uint32_t instance_count, uint32_t frame_count)
+{
+    dmGameObject::HCollection collection = dmGameObject::NewCollection("bench", test->m_Factory, test->m_Register, 1024, 0x0);
+
+    for (uint32_t i = 0; i < instance_count; ++i)
+    {
+        dmGameObject::HInstance go = dmGameObject::New(collection, prototype);
+        assert(go != 0);
+        dmGameObject::AcquireInputFocus(collection, go);
+    }
+    dmGameObject::Init(collection);
+
+    const uint32_t action_count = 10;
+    dmGameObject::InputAction actions[action_count];
+
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t frame = 0; frame < frame_count; ++frame)
+    {
+        for (uint32_t i = 0; i < action_count; ++i)
+        {
+            dmGameObject::InputAction& action = actions[i];
+            memset(&action, 0, sizeof(action));
+            action.m_ActionId = dmHashString64("touch");
+            action.m_PositionSet = true;
+            action.m_X = (float) i;
+            action.m_Y = (float) frame;
+            action.m_TouchCount = 2;
+            action.m_Touch[1].m_Id = 1;
+        }
+        dmGameObject::UpdateResult r = dmGameObject::DispatchInput(collection, actions, action_count);
+        assert(r == dmGameObject::UPDATE_RESULT_OK);
+        (void) r;
+    }
+    uint64_t elapsed = dmTime::GetTime() - start;
+
+    dmGameObject::DeleteCollection(collection);
+    dmGameObject::PostUpdate(test->m_Register);
+    return elapsed;
+}
+
+TEST_F(InputTest, TestComponentInputBatchBench)
+{
+    const uint32_t instance_count = 200;
+    const uint32_t frame_count = 60;
+    dmGameObject::SetInputStackDefaultCapacity(m_Register, 256);
+
+    uint64_t per_action = DispatchInputBench(this, "/component_input_bench.goc", instance_count, frame_count);
+    uint64_t batched = DispatchInputBench(this, "/component_input_bench_batch.goc", instance_count, frame_count);
+
+    printf("DispatchInput, %u instances, %u frames: on_input %.3f ms, on_input_batch %.3f ms\n",
+            instance_count, frame_count, per_action / 1000.0f, batched / 1000.0f);
+}
@@ -378,6 +378,20 @@ TEST_F(ScriptTest, TestURLNilId)
     ASSERT_FALSE(dmGameObject::Init(m_Collection));
 }
 
+// Compares go.get_position with string URLs to hashes and URL objects, see url_perf.script
+TEST_F(ScriptTest, TestURLPerf)
+{
+    dmGameObject::HInstance go_null = dmGameObject::New(m_Collection, "/null.goc");
+    ASSERT_NE((void*) 0, (void*) go_null);
+    ASSERT_EQ(dmGameObject::RESULT_OK, dmGameObject::SetIdentifier(m_Collection, go_null, "a"));
+
+    dmGameObject::HInstance go = dmGameObject::New(m_Collection, "/url_perf.goc");
+    ASSERT_NE((void*) 0, (void*) go);
+    ASSERT_EQ(dmGameObject::RESULT_OK, dmGameObject::SetIdentifier(m_Collection, go, "b"));
+
+    ASSERT_TRUE(dmGameObject::Init(m_Collection));
+}
+
 #define REF_VALUE "__ref_value"
 
 int TestRef(lua_State* L)
@@ -40,6 +40,13 @@ namespace dmGameSystem
     struct RigSceneResource;
     struct TextureResource;
 
+    struct ModelResourceLod
+    {
+        dmGraphics::HIndexBuffer    m_IndexBuffer; // Shares the vertex buffer with the full resolution mesh
+        uint32_t                    m_IndexCount;
+        float                       m_Error;       // Relative to the radius of the mesh bounding sphere
+    };
+
     struct ModelResourceBuffers
     {
         dmGraphics::HVertexBuffer   m_VertexBuffer;
@@ -47,6 +54,8 @@ namespace dmGameSystem
         uint32_t                    m_VertexCount;
         uint32_t                    m_IndexCount;
         dmGraphics::Type            m_IndexBufferElementType;
+        ModelResourceLod*           m_Lods;        // Simplified levels of detail, in order of decreasing detail
+        uint32_t                    m_LodCount;
     };
 
     struct MeshInfo
@@ -896,7 +896,7 @@ namespace dmGameSystem
     }
 
     static void ApplyStencilClipping(RenderGuiContext* gui_context, const dmGui::StencilScope* state, dmRender::StencilTestParams& stp) {
-        if (state != 0x0) {
+        if (state != 0x0 && !state->m_Scissor) {
             stp.m_Front.m_Func = dmGraphics::COMPARE_FUNC_EQUAL;
             stp.m_Front.m_OpSFail = dmGraphics::STENCIL_OP_KEEP;
             stp.m_Front.m_OpDPFail = dmGraphics::STENCIL_OP_REPLACE;
@@ -931,11 +931,30 @@ namespace dmGameSystem
     static void ApplyStencilClipping(RenderGuiContext* gui_context, const dmGui::StencilScope* state, dmRender::RenderObject& ro) {
         ro.m_SetStencilTest = 1;
         ApplyStencilClipping(gui_context, state, ro.m_StencilTestParams);
+        if (state != 0x0 && state->m_Scissor) {
+            const float* rect = state->m_ScissorRect;
+            ro.m_ScissorRect = Vector4(rect[0], rect[1], rect[2], rect[3]);
+            ro.m_SetScissor = 1;
+        }
     }
 
     static void ApplyStencilClipping(RenderGuiContext* gui_context, const dmGui::StencilScope* state, dmRender::DrawTextParams& params) {
         params.m_StencilTestParamsSet = 1;
         ApplyStencilClipping(gui_context, state, params.m_StencilTestParams);
+        if (state != 0x0 && state->m_Scissor) {
+            const float* rect = state->m_ScissorRect;
+            params.m_ScissorRect = Vector4(rect[0], rect[1], rect[2], rect[3]);
+            params.m_ScissorSet = 1;
+        }
+    }
+
+    // Nodes clipped by different scissor clippers can still be batched if the rectangles are the same
+    static inline bool IsSameClipping(const dmGui::StencilScope* a, const dmGui::StencilScope* b) {
+        if (a == b)
+            return true;
+        if (a == 0x0 || b == 0x0 || !a->m_Scissor || !b->m_Scissor)
+            return false;
+        return memcmp(a->m_ScissorRect, b->m_ScissorRect, sizeof(a->m_ScissorRect)) == 0;
     }
 
     static dmGraphics::HTexture GetNodeTexture(dmGui::HScene scene, dmGui::HNode node)
@@ -1917,7 +1936,7 @@ namespace dmGameSystem
                                 texture                != prev_texture       ||
                                 material               != prev_material      ||
                                 font                   != prev_font          ||
-                                prev_stencil_scope     != stencil_scope      ||
+                                !IsSameClipping(prev_stencil_scope, stencil_scope) ||
                                 prev_emitter_batch_key != emitter_batch_key;
 
             bool flush = (i > 0 && batch_change);
@@ -2219,6 +2238,7 @@ namespace dmGameSystem
         rp.m_NewTexture = &NewTexture;
         rp.m_DeleteTexture = &DeleteTexture;
         rp.m_SetTextureData = &SetTextureData;
+        rp.m_ScissorClipping = true;
 
         RenderGuiContext render_gui_context;
         render_gui_context.m_RenderContext = gui_context->m_RenderContext;
@@ -52,6 +52,7 @@ DM_PROPERTY_U32(rmtp_Model, 0, FrameReset, "# components", &rmtp_Components);
 DM_PROPERTY_U32(rmtp_ModelIndexCount, 0, FrameReset, "# indices", &rmtp_Model);
 DM_PROPERTY_U32(rmtp_ModelVertexCount, 0, FrameReset, "# vertices", &rmtp_Model);
 DM_PROPERTY_U32(rmtp_ModelVertexSize, 0, FrameReset, "size of vertices in bytes", &rmtp_Model);
+DM_PROPERTY_U32(rmtp_ModelLodIndexCount, 0, FrameReset, "# indices skipped by lod selection", &rmtp_Model);
 
 namespace dmGameSystem
 {
@@ -69,7 +70,8 @@ namespace dmGameSystem
         dmRigDDF::Mesh*             m_Mesh;     // Used for world space materials
         uint32_t                    m_MaterialIndex : 4; // current max 16 materials per model
         uint32_t                    m_Enabled : 1;
-        uint32_t                    : 27;
+        uint32_t                    m_LodIndex : 4; // 0 is the full resolution mesh, N is m_Buffers->m_Lods[N-1]
+        uint32_t                    : 23;
     };
 
     struct ModelComponent
@@ -110,9 +112,11 @@ namespace dmGameSystem
         uint32_t                        m_MaxElementsVertices;
         uint32_t                        m_VertexBufferSwapChainIndex;
         uint32_t                        m_VertexBufferSwapChainSize;
+        float                           m_LodPixelError;
     };
 
     static const uint32_t VERTEX_BUFFER_MAX_BATCHES = 16;     // Max dmRender::RenderListEntry.m_MinorOrder (4 bits)
+    static const float LOD_HYSTERESIS = 0.25f;                // Switching to a coarser lod requires the error to be this much below the threshold
 
     static const dmhash_t PROP_SKIN = dmHashString64("skin");
     static const dmhash_t PROP_ANIMATION = dmHashString64("animation");
@@ -155,6 +159,7 @@ namespace dmGameSystem
 
         world->m_VertexDeclaration = dmGraphics::NewVertexDeclaration(graphics_context, stream_declaration);
         world->m_MaxElementsVertices = dmGraphics::GetMaxElementsVertices(graphics_context);
+        world->m_LodPixelError = context->m_LodPixelError;
         world->m_VertexBuffers = new dmGraphics::HVertexBuffer[VERTEX_BUFFER_MAX_BATCHES];
         world->m_VertexBufferData = new dmArray<dmRig::RigModelVertex>[VERTEX_BUFFER_MAX_BATCHES];
         for(uint32_t i = 0; i < VERTEX_BUFFER_MAX_BATCHES; ++i)
@@ -465,6 +470,7 @@ namespace dmGameSystem
             item.m_AabbMin = item.m_Mesh->m_AabbMin;
             item.m_AabbMax = item.m_Mesh->m_AabbMax;
             item.m_Enabled = 1;
+            item.m_LodIndex = 0;
             component->m_RenderItems.Push(item);
         }
     }
@@ -604,17 +610,74 @@ namespace dmGameSystem
         return dmGameObject::CREATE_RESULT_OK;
     }
 
+    float CompModelGetProjectedRadius(const Matrix4& view_proj, const Point3& center, float radius, float viewport_height)
+    {
+        // The length of the row gives the ndc scale of a world space distance (regardless of the camera orientation)
+        // For orthographic projections, w is always 1
+        Vector4 clip = view_proj * center;
+        float w = dmMath::Max(dmMath::Abs(clip.getW()), 0.0001f);
+        float ndc_scale = dmVMath::Length(view_proj.getRow(1).getXYZ());
+        return radius * ndc_scale / w * viewport_height * 0.5f;
+    }
+
+    uint32_t CompModelSelectLod(const ModelResourceLod* lods, uint32_t lod_count, uint32_t current_lod, float projected_radius, float max_pixel_error)
+    {
+        // The lods have increasing errors, so we pick the coarsest one that is still within the threshold.
+        // To avoid flickering between two lods, a coarser lod than the current one needs a smaller error.
+        for (uint32_t i = lod_count; i > 0; --i)
+        {
+            float pixel_error = lods[i-1].m_Error * projected_radius;
+            float threshold = i > current_lod ? max_pixel_error * (1.0f - LOD_HYSTERESIS) : max_pixel_error;
+            if (pixel_error <= threshold)
+                return i;
+        }
+        return 0;
+    }
+
+    static void UpdateLod(MeshRenderItem* render_item, const Matrix4& view_proj, float viewport_height, float max_pixel_error)
+    {
+        Vector3 center = (render_item->m_AabbMin + render_item->m_AabbMax) * 0.5f;
+        float radius = dmVMath::Length(render_item->m_AabbMax - render_item->m_AabbMin) * 0.5f;
+
+        const Matrix4& world = render_item->m_World;
+        float scale = dmMath::Max(dmVMath::Length(world.getCol0().getXYZ()),
+                      dmMath::Max(dmVMath::Length(world.getCol1().getXYZ()), dmVMath::Length(world.getCol2().getXYZ())));
+        Vector4 world_center = world * Point3(center);
+
+        float projected_radius = CompModelGetProjectedRadius(view_proj, Point3(world_center.getXYZ()), radius * scale, viewport_height);
+        const ModelResourceBuffers* buffers = render_item->m_Buffers;
+        render_item->m_LodIndex = CompModelSelectLod(buffers->m_Lods, buffers->m_LodCount, render_item->m_LodIndex, projected_radius, max_pixel_error);
+    }
+
     static inline void RenderBatchLocalVS(ModelWorld* world, dmRender::HMaterial material, dmRender::HRenderContext render_context, dmRender::RenderListEntry *buf, uint32_t* begin, uint32_t* end)
     {
         DM_PROFILE("RenderBatchLocal");
 
+        const Matrix4& view_proj = dmRender::GetViewProjectionMatrix(render_context);
+        float viewport_height = (float)dmGraphics::GetWindowHeight(dmRender::GetGraphicsContext(render_context));
+        bool select_lod = world->m_LodPixelError > 0.0f;
+
         for (uint32_t *i=begin;i!=end;i++)
         {
-            const MeshRenderItem* render_item = (MeshRenderItem*) buf[*i].m_UserData;
+            MeshRenderItem* render_item = (MeshRenderItem*) buf[*i].m_UserData;
             const ModelResourceBuffers* buffers = render_item->m_Buffers;
             const ModelComponent* component = render_item->m_Component;
             uint32_t material_index = render_item->m_MaterialIndex;
 
+            dmGraphics::HIndexBuffer index_buffer = buffers->m_IndexBuffer;
+            uint32_t index_count = buffers->m_IndexCount;
+            if (select_lod && buffers->m_LodCount > 0)
+            {
+                UpdateLod(render_item, view_proj, viewport_height, world->m_LodPixelError);
+                if (render_item->m_LodIndex > 0)
+                {
+                    const ModelResourceLod& lod = buffers->m_Lods[render_item->m_LodIndex - 1];
+                    DM_PROPERTY_ADD_U32(rmtp_ModelLodIndexCount, index_count - lod.m_IndexCount);
+                    index_buffer = lod.m_IndexBuffer;
+                    index_count = lod.m_IndexCount;
+                }
+            }
+
             // We currently have no support for instancing, so we generate a separate draw call for each render item
             world->m_RenderObjects.SetSize(world->m_RenderObjects.Size()+1);
             dmRender::RenderObject& ro = world->m_RenderObjects.Back();
@@ -627,14 +690,14 @@ namespace dmGameSystem
 
             // These should be named "element" or "index" (as opposed to vertex)
             ro.m_VertexStart = 0;
-            ro.m_VertexCount = buffers->m_IndexCount;
+            ro.m_VertexCount = index_count;
 
             ro.m_WorldTransform = render_item->m_World;
 
-            ro.m_IndexBuffer = buffers->m_IndexBuffer;              // May be 0
+            ro.m_IndexBuffer = index_buffer;                        // May be 0
             ro.m_IndexType = buffers->m_IndexBufferElementType;
 
-            DM_PROPERTY_ADD_U32(rmtp_ModelIndexCount, buffers->m_IndexCount);
+            DM_PROPERTY_ADD_U32(rmtp_ModelIndexCount, index_count);
             DM_PROPERTY_ADD_U32(rmtp_ModelVertexCount, buffers->m_VertexCount);
             DM_PROPERTY_ADD_U32(rmtp_ModelVertexSize, buffers->m_VertexCount * sizeof(dmRig::RigModelVertex));
 
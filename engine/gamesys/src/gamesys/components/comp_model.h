@@ -56,6 +56,13 @@ namespace dmGameSystem
     ModelResource* CompModelGetModelResource(ModelComponent* component);
     dmGameObject::HInstance CompModelGetNodeInstance(ModelComponent* component, uint32_t bone_index);
 
+    struct ModelResourceLod;
+
+    // Returns the radius (in pixels) of the bounding sphere, when projected onto the screen
+    float CompModelGetProjectedRadius(const dmVMath::Matrix4& view_proj, const dmVMath::Point3& center, float radius, float viewport_height);
+    // Returns the lod to render (0 is the full resolution mesh, N is lods[N-1])
+    uint32_t CompModelSelectLod(const ModelResourceLod* lods, uint32_t lod_count, uint32_t current_lod, float projected_radius, float max_pixel_error);
+
     // these aren't used yet??
     bool CompModelSetIKTargetInstance(ModelComponent* component, dmhash_t constraint_id, float mix, dmhash_t instance_id);
     bool CompModelSetIKTargetPosition(ModelComponent* component, dmhash_t constraint_id, float mix, dmVMath::Point3 position);
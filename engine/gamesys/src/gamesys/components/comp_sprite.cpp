@@ -26,6 +26,7 @@
 #include <dlib/dstrings.h>
 #include <dlib/object_pool.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dmsdk/dlib/vmath.h>
 #include <dmsdk/dlib/intersection.h>
 #include <graphics/graphics.h>
@@ -112,6 +113,8 @@ namespace dmGameSystem
         uint32_t                        m_IndexCount;
         uint8_t*                        m_IndexBufferData;
         uint8_t*                        m_IndexBufferWritePtr;
+        dmMemory::HTag                  m_MemoryTag;
+        uint32_t                        m_BufferMemorySize; // Vertex and index data size, as reported to m_MemoryTag
         uint8_t                         m_Is16BitIndex : 1;
         uint8_t                         m_ReallocBuffers : 1;
     };
@@ -166,6 +169,10 @@ namespace dmGameSystem
         sprite_world->m_Is16BitIndex    = index_data_type_size == sizeof(uint16_t) ? 1 : 0;
         sprite_world->m_IndexBufferData = (uint8_t*)realloc(sprite_world->m_IndexBufferData, indices_memsize);
 
+        uint32_t buffer_memsize = vertex_memsize + (uint32_t)indices_memsize;
+        dmMemory::TrackRealloc(sprite_world->m_MemoryTag, sprite_world->m_BufferMemorySize, buffer_memsize);
+        sprite_world->m_BufferMemorySize = buffer_memsize;
+
         if (sprite_world->m_IndexBuffer)
         {
             dmGraphics::DeleteIndexBuffer(sprite_world->m_IndexBuffer);
@@ -176,6 +183,12 @@ namespace dmGameSystem
         sprite_world->m_ReallocBuffers = 0;
     }
 
+    static uint32_t GetWorldMemorySize(SpriteWorld* sprite_world)
+    {
+        uint32_t comp_count = sprite_world->m_BoundingVolumes.Capacity();
+        return sizeof(SpriteWorld) + comp_count * (sizeof(SpriteComponent) + sizeof(float));
+    }
+
     dmGameObject::CreateResult CompSpriteNewWorld(const dmGameObject::ComponentNewWorldParams& params)
     {
         SpriteContext* sprite_context = (SpriteContext*)params.m_Context;
@@ -190,6 +203,9 @@ namespace dmGameSystem
         sprite_world->m_VertexBufferData = 0;
         sprite_world->m_IndexBuffer      = 0;
         sprite_world->m_IndexBufferData  = 0;
+        sprite_world->m_MemoryTag        = dmMemory::RegisterTag("sprite");
+        sprite_world->m_BufferMemorySize = 0;
+        dmMemory::TrackAlloc(sprite_world->m_MemoryTag, GetWorldMemorySize(sprite_world));
 
         *params.m_World = sprite_world;
         return dmGameObject::CREATE_RESULT_OK;
@@ -209,6 +225,8 @@ namespace dmGameSystem
         dmGraphics::DeleteIndexBuffer(sprite_world->m_IndexBuffer);
         free(sprite_world->m_IndexBufferData);
 
+        dmMemory::TrackFree(sprite_world->m_MemoryTag, GetWorldMemorySize(sprite_world) + sprite_world->m_BufferMemorySize);
+
         delete sprite_world;
         return dmGameObject::CREATE_RESULT_OK;
     }
@@ -134,6 +134,7 @@ namespace dmGameSystem
         dmRender::HRenderContext    m_RenderContext;
         dmResource::HFactory        m_Factory;
         uint32_t                    m_MaxModelCount;
+        float                       m_LodPixelError; // Max screen space error (in pixels) when selecting mesh lods. 0 disables lod selection
     };
 
     struct SoundContext
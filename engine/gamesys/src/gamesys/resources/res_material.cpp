@@ -280,6 +280,14 @@ namespace dmGameSystem
             resource->m_Material = material;
             SetMaterial(params.m_Filename, resource, &resources, ddf);
 
+            // Optionally create the pipeline for drawing to the screen with the default state already while loading,
+            // instead of on the first draw call. A no-op on graphics adapters without pipeline objects.
+            if (dmRender::GetPrewarmMaterials(render_context))
+            {
+                dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
+                dmRender::PrewarmMaterial(material, 0, 0, dmGraphics::GetPipelineState(graphics_context));
+            }
+
             params.m_Resource->m_Resource = (void*) resource;
         }
         dmDDF::FreeMessage(ddf);
@@ -147,6 +147,24 @@ namespace dmGameSystem
         return out_write_ptr;
     }
 
+    static void CreateLodBuffers(dmGraphics::HContext context, const dmRigDDF::Mesh* ddf_mesh, uint32_t index_type_size, ModelResourceBuffers* buffers)
+    {
+        uint32_t lod_count = dmMath::Min(ddf_mesh->m_Lods.m_Count, MAX_MODEL_LOD_COUNT);
+        if (lod_count == 0)
+            return;
+
+        buffers->m_Lods = new ModelResourceLod[lod_count];
+        buffers->m_LodCount = lod_count;
+        for (uint32_t i = 0; i < lod_count; ++i)
+        {
+            const dmRigDDF::MeshLod& ddf_lod = ddf_mesh->m_Lods[i];
+            ModelResourceLod& lod = buffers->m_Lods[i];
+            lod.m_IndexCount = ddf_lod.m_Indices.m_Count / index_type_size;
+            lod.m_IndexBuffer = dmGraphics::NewIndexBuffer(context, ddf_lod.m_Indices.m_Count, ddf_lod.m_Indices.m_Data, dmGraphics::BUFFER_USAGE_STATIC_DRAW);
+            lod.m_Error = ddf_lod.m_Error;
+        }
+    }
+
     static ModelResourceBuffers* CreateBuffers(dmGraphics::HContext context, const dmRigDDF::Mesh* ddf_mesh, dmArray<dmRig::RigModelVertex>& scratch_buffer)
     {
         ModelResourceBuffers* buffers = new ModelResourceBuffers;
@@ -189,6 +207,8 @@ namespace dmGameSystem
             buffers->m_IndexBuffer = dmGraphics::NewIndexBuffer(context, num_indices * index_type_size, index_buffer, dmGraphics::BUFFER_USAGE_STATIC_DRAW);
             buffers->m_IndexBufferElementType = index_element_type;
             buffers->m_IndexCount = num_indices;
+
+            CreateLodBuffers(context, ddf_mesh, index_type_size, buffers);
         }
 
         return buffers;
@@ -296,6 +316,11 @@ namespace dmGameSystem
     {
         dmGraphics::DeleteVertexBuffer(buffers->m_VertexBuffer);
         dmGraphics::DeleteIndexBuffer(buffers->m_IndexBuffer);
+        for (uint32_t i = 0; i < buffers->m_LodCount; ++i)
+        {
+            dmGraphics::DeleteIndexBuffer(buffers->m_Lods[i].m_IndexBuffer);
+        }
+        delete[] buffers->m_Lods;
         delete buffers;
     }
 
@@ -20,6 +20,8 @@
 
 namespace dmGameSystem
 {
+    static const uint32_t MAX_MODEL_LOD_COUNT = 8;
+
     dmResource::Result ResModelPreload(const dmResource::ResourcePreloadParams& params);
 
     dmResource::Result ResModelCreate(const dmResource::ResourceCreateParams& params);
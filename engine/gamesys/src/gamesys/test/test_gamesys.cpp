@@ -34,8 +34,10 @@
 #include <gamesys/gamesys_ddf.h>
 #include <gamesys/sprite_ddf.h>
 #include "../components/comp_label.h"
+#include "../components/comp_model.h"
 
 #include <dmsdk/gamesys/render_constants.h>
+#include <dmsdk/gamesys/resources/res_model.h>
 
 using namespace dmVMath;
 
@@ -1812,6 +1814,46 @@ TEST_P(DrawCountTest, DrawCount)
     ASSERT_TRUE(dmGameObject::Final(m_Collection));
 }
 
+/* GUI Clipping */
+
+static void RenderFrame(dmGameObject::HCollection collection, dmGameObject::UpdateContext* update_context, dmRender::HRenderContext render_context, dmGraphics::HContext graphics_context)
+{
+    // Resets the draw counters
+    dmGraphics::Flip(graphics_context);
+
+    ASSERT_TRUE(dmGameObject::Update(collection, update_context));
+
+    dmRender::RenderListBegin(render_context);
+    dmGameObject::Render(collection);
+    dmRender::RenderListEnd(render_context);
+    dmRender::DrawRenderList(render_context, 0x0, 0x0, 0x0);
+
+    ASSERT_TRUE(dmGameObject::PostUpdate(collection));
+}
+
+TEST_F(GuiTest, NestedScrollListClipping)
+{
+    ASSERT_TRUE(dmGameObject::Init(m_Collection));
+
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/gui/nested_scroll_lists.goc", dmHashString64("/go"), 0, 0, Point3(0, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    // Clipped with scissor rectangles: the clippers aren't drawn, and since each nested list has the same
+    // rectangle as its parent list, the items of both are drawn in one batch per list
+    RenderFrame(m_Collection, &m_UpdateContext, m_RenderContext, m_GraphicsContext);
+    ASSERT_EQ(2U, dmGraphics::GetDrawCount());
+    ASSERT_EQ(0U, dmGraphics::GetStencilWriteDrawCount());
+
+    // The script rotates the lists, which falls back to the stencil buffer: each of the four clippers is
+    // drawn to the stencil buffer, and breaks the batch of the items after it
+    RenderFrame(m_Collection, &m_UpdateContext, m_RenderContext, m_GraphicsContext);
+    ASSERT_EQ(8U, dmGraphics::GetDrawCount());
+    ASSERT_EQ(4U, dmGraphics::GetStencilWriteDrawCount());
+
+    dmGraphics::Flip(m_GraphicsContext);
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+}
+
 /* GUI Box Render */
 
 void AssertVertexEqual(const dmGameSystem::BoxVertex& lhs, const dmGameSystem::BoxVertex& rhs)
@@ -2709,6 +2751,110 @@ INSTANTIATE_TEST_CASE_P(Label, ComponentTest, jc_test_values_in(valid_label_gos)
 const char* invalid_label_gos[] = {"/label/invalid_label.goc"};
 INSTANTIATE_TEST_CASE_P(Label, ComponentFailTest, jc_test_values_in(invalid_label_gos));
 
+/* Model lods */
+
+static void SetupLods(dmGameSystem::ModelResourceLod* lods, uint32_t lod_count, uint32_t index_count)
+{
+    // Each lod halves the triangle count, roughly doubling the (radius relative) error
+    float error = 0.001f;
+    for (uint32_t i = 0; i < lod_count; ++i)
+    {
+        index_count = (index_count / 6) * 3;
+        lods[i].m_IndexBuffer = 0;
+        lods[i].m_IndexCount = index_count;
+        lods[i].m_Error = error;
+        error *= 2.0f;
+    }
+}
+
+TEST(ModelLod, SelectLod)
+{
+    dmGameSystem::ModelResourceLod lods[3];
+    SetupLods(lods, 3, 6000); // errors: 0.001, 0.002, 0.004
+
+    // Up close, the full mesh is needed
+    ASSERT_EQ(0u, dmGameSystem::CompModelSelectLod(lods, 3, 0, 2000.0f, 1.0f));
+    // Far away, the coarsest lod is good enough
+    ASSERT_EQ(3u, dmGameSystem::CompModelSelectLod(lods, 3, 0, 10.0f, 1.0f));
+    ASSERT_EQ(1u, dmGameSystem::CompModelSelectLod(lods, 3, 0, 700.0f, 1.0f));
+
+    // Hysteresis: lod 1 has pixel error 0.9, which is too large to switch to from lod 0...
+    ASSERT_EQ(0u, dmGameSystem::CompModelSelectLod(lods, 3, 0, 900.0f, 1.0f));
+    // ...but small enough to stay at lod 1
+    ASSERT_EQ(1u, dmGameSystem::CompModelSelectLod(lods, 3, 1, 900.0f, 1.0f));
+    // Switching to a finer lod happens as soon as the threshold is exceeded
+    ASSERT_EQ(0u, dmGameSystem::CompModelSelectLod(lods, 3, 1, 1100.0f, 1.0f));
+
+    // No lods
+    ASSERT_EQ(0u, dmGameSystem::CompModelSelectLod(lods, 0, 0, 1.0f, 1.0f));
+}
+
+TEST(ModelLod, ProjectedRadius)
+{
+    // 90 degree fov: a sphere with radius 1 at distance 1 spans half the viewport height
+    Matrix4 proj = Matrix4::perspective(1.5707963f, 1.0f, 0.1f, 1000.0f);
+    Matrix4 view = Matrix4::lookAt(Point3(0.0f, 0.0f, 0.0f), Point3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f));
+    Matrix4 view_proj = proj * view;
+
+    EXPECT_NEAR(500.0f, dmGameSystem::CompModelGetProjectedRadius(view_proj, Point3(0.0f, 0.0f, -1.0f), 1.0f, 1000.0f), 0.01f);
+    EXPECT_NEAR(50.0f, dmGameSystem::CompModelGetProjectedRadius(view_proj, Point3(0.0f, 0.0f, -10.0f), 1.0f, 1000.0f), 0.01f);
+    EXPECT_NEAR(50.0f, dmGameSystem::CompModelGetProjectedRadius(view_proj, Point3(5.0f, 0.0f, -10.0f), 1.0f, 1000.0f), 0.01f);
+}
+
+// Headless benchmark: the triangles submitted per frame for a large field of models, with and without lod selection
+TEST(ModelLod, Performance)
+{
+    const uint32_t grid_size = 100;
+    const uint32_t num_frames = 60;
+    const uint32_t index_count = 30000;
+    const float radius = 1.0f;
+    const float viewport_height = 1080.0f;
+
+    dmGameSystem::ModelResourceLod lods[4];
+    SetupLods(lods, 4, index_count);
+
+    uint8_t* current_lods = new uint8_t[grid_size * grid_size];
+    memset(current_lods, 0, grid_size * grid_size);
+
+    Matrix4 proj = Matrix4::perspective(0.7853981f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    uint64_t triangles_full = 0;
+    uint64_t triangles_lod = 0;
+    uint64_t time_lod = 0;
+    for (uint32_t frame = 0; frame < num_frames; ++frame)
+    {
+        // The camera flies over the field
+        float z = 10.0f - frame * 2.0f;
+        Matrix4 view = Matrix4::lookAt(Point3(0.0f, 5.0f, z), Point3(0.0f, 0.0f, z - 20.0f), Vector3(0.0f, 1.0f, 0.0f));
+        Matrix4 view_proj = proj * view;
+
+        uint64_t tstart = dmTime::GetTime();
+        for (uint32_t y = 0; y < grid_size; ++y)
+        {
+            for (uint32_t x = 0; x < grid_size; ++x)
+            {
+                Point3 center((x - grid_size * 0.5f) * 4.0f, 0.0f, -(float)y * 4.0f);
+                uint8_t& lod = current_lods[y * grid_size + x];
+                float projected_radius = dmGameSystem::CompModelGetProjectedRadius(view_proj, center, radius, viewport_height);
+                lod = (uint8_t)dmGameSystem::CompModelSelectLod(lods, 4, lod, projected_radius, 1.0f);
+
+                triangles_full += index_count / 3;
+                triangles_lod += (lod == 0 ? index_count : lods[lod - 1].m_IndexCount) / 3;
+            }
+        }
+        time_lod += dmTime::GetTime() - tstart;
+    }
+
+    printf("Models: %u  Frames: %u\n", grid_size * grid_size, num_frames);
+    printf("Triangles/frame without lods: %llu\n", (unsigned long long)(triangles_full / num_frames));
+    printf("Triangles/frame with lods:    %llu\n", (unsigned long long)(triangles_lod / num_frames));
+    printf("Lod selection: %.3f ms/frame\n", (time_lod / 1000.0f) / num_frames);
+
+    ASSERT_LT(triangles_lod, triangles_full);
+
+    delete[] current_lods;
+}
+
 /* Test material vertex space component compatibility */
 
 const char* invalid_vertexspace_resources[] =
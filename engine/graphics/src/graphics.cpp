@@ -235,6 +235,7 @@ namespace dmGraphics
     : m_DefaultTextureMinFilter(TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST)
     , m_DefaultTextureMagFilter(TEXTURE_FILTER_LINEAR)
     , m_GraphicsMemorySize(0)
+    , m_PipelineCachePath(0)
     , m_VerifyGraphicsCalls(false)
     , m_RenderDocSupport(0)
     , m_UseValidationLayers(0)
@@ -748,6 +749,9 @@ namespace dmGraphics
             case STATE_POLYGON_OFFSET_FILL:
                 pipeline_state.m_PolygonOffsetFillEnabled = value;
             break;
+            case STATE_SCISSOR_TEST:
+                // The scissor rectangle is dynamic state, the adapters keep track of it themselves
+            break;
             default:
                 assert(0 && "EnableState: State not supported");
             break;
@@ -1237,6 +1241,10 @@ namespace dmGraphics
     {
         return g_functions.m_GetPipelineState(context);
     }
+    void PrewarmPipeline(HContext context, HProgram program, HVertexDeclaration vertex_declaration, HRenderTarget render_target, const PipelineState& pipeline_state)
+    {
+        g_functions.m_PrewarmPipeline(context, program, vertex_declaration, render_target, pipeline_state);
+    }
     uint8_t GetNumTextureHandles(HTexture texture)
     {
         return g_functions.m_GetNumTextureHandles(texture);
@@ -319,6 +319,7 @@ namespace dmGraphics
         TextureFilter m_DefaultTextureMinFilter;
         TextureFilter m_DefaultTextureMagFilter;
         uint32_t      m_GraphicsMemorySize;             // The max allowed Gfx memory (default 0)
+        const char*   m_PipelineCachePath;              // Vulkan only. File to persist compiled pipelines in between runs (default 0)
         uint8_t       m_VerifyGraphicsCalls : 1;
         uint8_t       m_RenderDocSupport : 1;           // Vulkan only
         uint8_t       m_UseValidationLayers : 1;        // Vulkan only
@@ -605,6 +606,17 @@ namespace dmGraphics
     PipelineState GetPipelineState(HContext context);
     bool          IsContextFeatureSupported(HContext context, ContextFeature feature);
 
+    /**
+     * Creates the device pipeline for a program, vertex format and render target combination ahead of the first
+     * draw call using it, so that it doesn't have to be compiled mid-frame. Adapters without pipeline objects ignore this.
+     * @param context Graphics context
+     * @param program Program that will be used
+     * @param vertex_declaration Vertex declaration that will be used together with the program
+     * @param render_target Render target that will be drawn to, or 0 for the main framebuffer
+     * @param pipeline_state Render state that will be used
+     */
+    void          PrewarmPipeline(HContext context, HProgram program, HVertexDeclaration vertex_declaration, HRenderTarget render_target, const PipelineState& pipeline_state);
+
     TextureFormat GetSupportedCompressionFormat(HContext context, TextureFormat format, uint32_t width, uint32_t height);
 
     uint32_t GetTextureFormatBitsPerPixel(TextureFormat format);
@@ -77,6 +77,7 @@ namespace dmGraphics
 
     // Test functions:
     uint64_t    GetDrawCount();
+    uint64_t    GetStencilWriteDrawCount();
     void*       MapVertexBuffer(HVertexBuffer buffer, BufferAccess access);
     bool        UnmapVertexBuffer(HVertexBuffer buffer);
     void*       MapIndexBuffer(HIndexBuffer buffer, BufferAccess access);
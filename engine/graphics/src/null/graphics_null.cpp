@@ -28,6 +28,7 @@
 #include "glsl_uniform_parser.h"
 
 uint64_t g_DrawCount = 0;
+uint64_t g_StencilWriteDrawCount = 0;
 uint64_t g_Flipped = 0;
 
 // Used only for tests
@@ -601,6 +602,30 @@ namespace dmGraphics
         return ~0;
     }
 
+    // A draw writes to the stencil buffer if any of the stencil ops changes the stored value
+    static bool IsStencilWrite(const PipelineState& ps)
+    {
+        if (ps.m_StencilWriteMask == 0)
+            return false;
+        return ps.m_StencilFrontOpFail != STENCIL_OP_KEEP || ps.m_StencilFrontOpDepthFail != STENCIL_OP_KEEP || ps.m_StencilFrontOpPass != STENCIL_OP_KEEP ||
+               ps.m_StencilBackOpFail  != STENCIL_OP_KEEP || ps.m_StencilBackOpDepthFail  != STENCIL_OP_KEEP || ps.m_StencilBackOpPass  != STENCIL_OP_KEEP;
+    }
+
+    static void CountDraw(NullContext* context)
+    {
+        if (g_Flipped)
+        {
+            g_Flipped = 0;
+            g_DrawCount = 0;
+            g_StencilWriteDrawCount = 0;
+        }
+        g_DrawCount++;
+        if (IsStencilWrite(context->m_PipelineState))
+        {
+            g_StencilWriteDrawCount++;
+        }
+    }
+
     static void NullDrawElements(HContext _context, PrimitiveType prim_type, uint32_t first, uint32_t count, Type type, HIndexBuffer index_buffer)
     {
         assert(_context);
@@ -625,24 +650,13 @@ namespace dmGraphics
             }
         }
 
-        if (g_Flipped)
-        {
-            g_Flipped = 0;
-            g_DrawCount = 0;
-        }
-        g_DrawCount++;
+        CountDraw(context);
     }
 
     static void NullDraw(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count)
     {
         assert(context);
-
-        if (g_Flipped)
-        {
-            g_Flipped = 0;
-            g_DrawCount = 0;
-        }
-        g_DrawCount++;
+        CountDraw((NullContext*) context);
     }
 
     // For tests
@@ -651,6 +665,12 @@ namespace dmGraphics
         return g_DrawCount;
     }
 
+    // For tests
+    uint64_t GetStencilWriteDrawCount()
+    {
+        return g_StencilWriteDrawCount;
+    }
+
     struct VertexProgram
     {
         char*                m_Data;
@@ -682,6 +702,7 @@ namespace dmGraphics
             m_Uniforms.SetCapacity(16);
             m_VP = vp;
             m_FP = fp;
+            memset(m_Registers, 0, sizeof(m_Registers));
             if (m_VP != 0x0)
             {
                 GLSLAttributeParse(m_VP->m_Language, m_VP->m_Data, NullShaderResourceCallback, (uintptr_t)this);
@@ -703,6 +724,8 @@ namespace dmGraphics
         FragmentProgram*       m_FP;
         dmArray<ShaderBinding> m_Uniforms;
         dmArray<ShaderBinding> m_Attributes;
+        // Like the other adapters, the constant values are stored per program
+        Vector4                m_Registers[MAX_REGISTER_COUNT];
     };
 
     static void NullShaderResourceCallback(dmGraphics::GLSLUniformParserBindingType binding_type, const char* name, uint32_t name_length, dmGraphics::Type type, uint32_t size, uintptr_t userdata)
@@ -942,7 +965,15 @@ namespace dmGraphics
         assert(_context);
         NullContext* context = (NullContext*) _context;
         assert(context->m_Program != 0x0);
-        return context->m_ProgramRegisters[base_register];
+        return ((Program*) context->m_Program)->m_Registers[base_register];
+    }
+
+    // Tests Only
+    uint32_t GetConstantUploadCount(HContext _context)
+    {
+        assert(_context);
+        NullContext* context = (NullContext*) _context;
+        return context->m_ConstantUploadCount;
     }
 
     static void NullSetConstantV4(HContext _context, const Vector4* data, int count, int base_register)
@@ -950,7 +981,8 @@ namespace dmGraphics
         assert(_context);
         NullContext* context = (NullContext*) _context;
         assert(context->m_Program != 0x0);
-        memcpy(&context->m_ProgramRegisters[base_register], data, sizeof(Vector4) * count);
+        memcpy(&((Program*) context->m_Program)->m_Registers[base_register], data, sizeof(Vector4) * count);
+        context->m_ConstantUploadCount++;
     }
 
     static void NullSetConstantM4(HContext _context, const Vector4* data, int count, int base_register)
@@ -958,7 +990,8 @@ namespace dmGraphics
         assert(_context);
         NullContext* context = (NullContext*) _context;
         assert(context->m_Program != 0x0);
-        memcpy(&context->m_ProgramRegisters[base_register], data, sizeof(Vector4) * 4 * count);
+        memcpy(&((Program*) context->m_Program)->m_Registers[base_register], data, sizeof(Vector4) * 4 * count);
+        context->m_ConstantUploadCount++;
     }
 
     static void NullSetSampler(HContext context, int32_t location, int32_t unit)
@@ -1606,6 +1639,11 @@ namespace dmGraphics
         return false;
     }
 
+    static void NullPrewarmPipeline(HContext context, HProgram program, HVertexDeclaration vertex_declaration, HRenderTarget render_target, const PipelineState& pipeline_state)
+    {
+        assert(context);
+    }
+
     ////////////////////////////////
     // UNIT TEST FUNCTIONS
     ////////////////////////////////
@@ -95,7 +95,6 @@ namespace dmGraphics
 
         dmOpaqueHandleContainer<uintptr_t> m_AssetHandleContainer;
         VertexStreamBuffer          m_VertexStreams[MAX_VERTEX_STREAM_COUNT];
-        dmVMath::Vector4            m_ProgramRegisters[MAX_REGISTER_COUNT];
         HTexture                    m_Textures[MAX_TEXTURE_COUNT];
         FrameBuffer                 m_MainFrameBuffer;
         FrameBuffer*                m_CurrentFrameBuffer;
@@ -116,6 +115,7 @@ namespace dmGraphics
         uint32_t                    m_Dpi;
         int32_t                     m_ScissorRect[4];
         uint32_t                    m_TextureFormatSupport;
+        uint32_t                    m_ConstantUploadCount; // Only use for testing
         uint32_t                    m_WindowOpened : 1;
         // Only use for testing
         uint32_t                    m_RequestWindowClose : 1;
@@ -3837,6 +3837,11 @@ static void LogFrameBufferError(GLenum status)
         return false;
     }
 
+    static void OpenGLPrewarmPipeline(HContext context, HProgram program, HVertexDeclaration vertex_declaration, HRenderTarget render_target, const PipelineState& pipeline_state)
+    {
+        // Pipeline state is set piecemeal in OpenGL, there is nothing to create up front
+    }
+
     GLenum TEXTURE_UNIT_NAMES[32] =
     {
         GL_TEXTURE0,
@@ -0,0 +1,688 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// Tests for the Vulkan pipeline cache. The tests that need a device are skipped if there is no Vulkan driver,
+// on CI they run on Mesa lavapipe.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+
+#include <dlib/array.h>
+#include <dlib/dstrings.h>
+#include <dlib/sys.h>
+#include <dlib/testutil.h>
+#include <dlib/time.h>
+
+#include "../vulkan/graphics_vulkan_defines.h"
+#include "../vulkan/graphics_vulkan_private.h"
+
+static const uint32_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+class PipelineCacheHeaderTest : public jc_test_base_class
+{
+protected:
+    virtual void SetUp()
+    {
+        memset(&m_Properties, 0, sizeof(m_Properties));
+        m_Properties.vendorID = 0x10DE;
+        m_Properties.deviceID = 0x1B80;
+        for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+        {
+            m_Properties.pipelineCacheUUID[i] = (uint8_t) (i + 1);
+        }
+
+        // A VkPipelineCacheHeaderVersionOne, followed by the driver data
+        memset(m_Data, 0xCD, sizeof(m_Data));
+        SetHeaderField(0, PIPELINE_CACHE_HEADER_SIZE);
+        SetHeaderField(1, VK_PIPELINE_CACHE_HEADER_VERSION_ONE);
+        SetHeaderField(2, m_Properties.vendorID);
+        SetHeaderField(3, m_Properties.deviceID);
+        memcpy(m_Data + 16, m_Properties.pipelineCacheUUID, VK_UUID_SIZE);
+    }
+
+    void SetHeaderField(uint32_t index, uint32_t value)
+    {
+        memcpy(m_Data + index * sizeof(uint32_t), &value, sizeof(value));
+    }
+
+    bool IsCompatible(uint32_t data_size)
+    {
+        return dmGraphics::IsPipelineCacheDataCompatible(m_Properties, m_Data, data_size);
+    }
+
+    VkPhysicalDeviceProperties m_Properties;
+    uint8_t                    m_Data[128];
+};
+
+TEST_F(PipelineCacheHeaderTest, Compatible)
+{
+    ASSERT_TRUE(IsCompatible(sizeof(m_Data)));
+    ASSERT_TRUE(IsCompatible(PIPELINE_CACHE_HEADER_SIZE));
+}
+
+TEST_F(PipelineCacheHeaderTest, NoData)
+{
+    ASSERT_FALSE(dmGraphics::IsPipelineCacheDataCompatible(m_Properties, 0, sizeof(m_Data)));
+    ASSERT_FALSE(IsCompatible(0));
+}
+
+TEST_F(PipelineCacheHeaderTest, Truncated)
+{
+    ASSERT_FALSE(IsCompatible(PIPELINE_CACHE_HEADER_SIZE - 1));
+    ASSERT_FALSE(IsCompatible(16));
+    ASSERT_FALSE(IsCompatible(4));
+}
+
+TEST_F(PipelineCacheHeaderTest, WrongHeaderSize)
+{
+    SetHeaderField(0, PIPELINE_CACHE_HEADER_SIZE - 1);
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+    SetHeaderField(0, 0);
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+}
+
+TEST_F(PipelineCacheHeaderTest, WrongHeaderVersion)
+{
+    SetHeaderField(1, VK_PIPELINE_CACHE_HEADER_VERSION_ONE + 1);
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+}
+
+TEST_F(PipelineCacheHeaderTest, WrongVendor)
+{
+    SetHeaderField(2, m_Properties.vendorID + 1);
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+}
+
+TEST_F(PipelineCacheHeaderTest, WrongDevice)
+{
+    SetHeaderField(3, m_Properties.deviceID + 1);
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+}
+
+TEST_F(PipelineCacheHeaderTest, WrongUUID)
+{
+    m_Data[16] ^= 0xFF;
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+    m_Data[16] ^= 0xFF;
+
+    m_Data[16 + VK_UUID_SIZE - 1] ^= 0xFF;
+    ASSERT_FALSE(IsCompatible(sizeof(m_Data)));
+}
+
+// #version 450
+// layout(local_size_x = 1) in;
+// void main() {}
+static const uint32_t EMPTY_COMPUTE_SPIRV[] =
+{
+    0x07230203, 0x00010000, 0x00000000, 0x00000005, 0x00000000,
+    0x00020011, 0x00000001,                                         // OpCapability Shader
+    0x0003000E, 0x00000000, 0x00000001,                             // OpMemoryModel Logical GLSL450
+    0x0005000F, 0x00000005, 0x00000001, 0x6E69616D, 0x00000000,     // OpEntryPoint GLCompute %1 "main"
+    0x00060010, 0x00000001, 0x00000011, 0x00000001, 0x00000001, 0x00000001, // OpExecutionMode %1 LocalSize 1 1 1
+    0x00020013, 0x00000002,                                         // %2 = OpTypeVoid
+    0x00030021, 0x00000003, 0x00000002,                             // %3 = OpTypeFunction %2
+    0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003,     // %1 = OpFunction %2 None %3
+    0x000200F8, 0x00000004,                                         // %4 = OpLabel
+    0x000100FD,                                                     // OpReturn
+    0x00010038,                                                     // OpFunctionEnd
+};
+
+// Creates a device without a window, skipping the device tests if there is no Vulkan driver
+class VulkanDeviceTest : public jc_test_base_class
+{
+protected:
+    virtual void SetUp()
+    {
+        m_Instance    = VK_NULL_HANDLE;
+        m_Device      = VK_NULL_HANDLE;
+        m_CommandPool = VK_NULL_HANDLE;
+        m_Context     = 0;
+
+    #if ANDROID
+        if (!dmGraphics::LoadVulkanLibrary())
+        {
+            return;
+        }
+    #endif
+
+        if (dmGraphics::CreateInstance(&m_Instance, 0, 0, 0, 0, 0, 0) != VK_SUCCESS)
+        {
+            m_Instance = VK_NULL_HANDLE;
+            return;
+        }
+
+    #if ANDROID
+        dmGraphics::LoadVulkanFunctions(m_Instance);
+    #endif
+
+        VkPhysicalDevice vk_physical_device = VK_NULL_HANDLE;
+        uint32_t device_count = 1;
+        VkResult res = vkEnumeratePhysicalDevices(m_Instance, &device_count, &vk_physical_device);
+        if ((res != VK_SUCCESS && res != VK_INCOMPLETE) || device_count == 0)
+        {
+            return;
+        }
+
+        VkQueueFamilyProperties vk_queue_families[16];
+        uint32_t queue_family_count = DM_ARRAY_SIZE(vk_queue_families);
+        vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count, vk_queue_families);
+        uint32_t queue_family = queue_family_count;
+        for (uint32_t i = 0; i < queue_family_count; ++i)
+        {
+            if (vk_queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                queue_family = i;
+                break;
+            }
+        }
+        if (queue_family == queue_family_count)
+        {
+            return;
+        }
+
+        const float queue_priority = 1.0f;
+        VkDeviceQueueCreateInfo vk_queue_create_info;
+        memset(&vk_queue_create_info, 0, sizeof(vk_queue_create_info));
+        vk_queue_create_info.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        vk_queue_create_info.queueFamilyIndex = queue_family;
+        vk_queue_create_info.queueCount       = 1;
+        vk_queue_create_info.pQueuePriorities = &queue_priority;
+
+        VkDeviceCreateInfo vk_device_create_info;
+        memset(&vk_device_create_info, 0, sizeof(vk_device_create_info));
+        vk_device_create_info.sType                = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        vk_device_create_info.queueCreateInfoCount = 1;
+        vk_device_create_info.pQueueCreateInfos    = &vk_queue_create_info;
+
+        if (vkCreateDevice(vk_physical_device, &vk_device_create_info, 0, &m_Device) != VK_SUCCESS)
+        {
+            m_Device = VK_NULL_HANDLE;
+            return;
+        }
+
+        VkCommandPoolCreateInfo vk_command_pool_create_info;
+        memset(&vk_command_pool_create_info, 0, sizeof(vk_command_pool_create_info));
+        vk_command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        vk_command_pool_create_info.queueFamilyIndex = queue_family;
+        vk_command_pool_create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if (vkCreateCommandPool(m_Device, &vk_command_pool_create_info, 0, &m_CommandPool) != VK_SUCCESS)
+        {
+            m_CommandPool = VK_NULL_HANDLE;
+            return;
+        }
+
+        dmGraphics::ContextParams params;
+        m_Context = new dmGraphics::VulkanContext(params, m_Instance);
+        m_Context->m_PhysicalDevice.m_Device   = vk_physical_device;
+        m_Context->m_LogicalDevice.m_Device    = m_Device;
+        m_Context->m_LogicalDevice.m_CommandPool = m_CommandPool;
+        vkGetDeviceQueue(m_Device, queue_family, 0, &m_Context->m_LogicalDevice.m_GraphicsQueue);
+        vkGetPhysicalDeviceProperties(vk_physical_device, &m_Context->m_PhysicalDevice.m_Properties);
+    }
+
+    virtual void TearDown()
+    {
+        if (m_Context)
+        {
+            vkDeviceWaitIdle(m_Device);
+            dmGraphics::DestroyPipelineCache(m_Device, &m_Context->m_DriverPipelineCache);
+            delete m_Context;
+        }
+        if (m_CommandPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(m_Device, m_CommandPool, 0);
+        }
+        if (m_Device != VK_NULL_HANDLE)
+        {
+            vkDestroyDevice(m_Device, 0);
+        }
+        if (m_Instance != VK_NULL_HANDLE)
+        {
+            vkDestroyInstance(m_Instance, 0);
+        }
+    }
+
+    VkInstance                  m_Instance;
+    VkDevice                    m_Device;
+    VkCommandPool               m_CommandPool;
+    dmGraphics::VulkanContext*  m_Context;
+};
+
+class PipelineCacheDeviceTest : public VulkanDeviceTest
+{
+protected:
+    virtual void SetUp()
+    {
+        dmTestUtil::MakeHostPath(m_CachePath, sizeof(m_CachePath), "test_pipeline.cache");
+        RemoveCacheFile();
+
+        VulkanDeviceTest::SetUp();
+        if (m_Context)
+        {
+            dmStrlCpy(m_Context->m_DriverPipelineCachePath, m_CachePath, sizeof(m_Context->m_DriverPipelineCachePath));
+        }
+    }
+
+    virtual void TearDown()
+    {
+        VulkanDeviceTest::TearDown();
+        RemoveCacheFile();
+    }
+
+    void RemoveCacheFile()
+    {
+        char tmp_path[DMPATH_MAX_PATH];
+        dmSnPrintf(tmp_path, sizeof(tmp_path), "%s.tmp", m_CachePath);
+        const char* paths[] = { m_CachePath, tmp_path };
+        for (uint32_t i = 0; i < DM_ARRAY_SIZE(paths); ++i)
+        {
+            if (dmSys::Exists(paths[i]))
+                dmSys::Unlink(paths[i]);
+        }
+    }
+
+    // Creates a pipeline through the driver pipeline cache, and returns the time it took in microseconds
+    void CreatePipeline(uint64_t* time_out)
+    {
+        VkShaderModuleCreateInfo vk_shader_create_info;
+        memset(&vk_shader_create_info, 0, sizeof(vk_shader_create_info));
+        vk_shader_create_info.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        vk_shader_create_info.codeSize = sizeof(EMPTY_COMPUTE_SPIRV);
+        vk_shader_create_info.pCode    = EMPTY_COMPUTE_SPIRV;
+
+        VkShaderModule vk_shader_module = VK_NULL_HANDLE;
+        ASSERT_EQ(VK_SUCCESS, vkCreateShaderModule(m_Device, &vk_shader_create_info, 0, &vk_shader_module));
+
+        VkPipelineLayoutCreateInfo vk_layout_create_info;
+        memset(&vk_layout_create_info, 0, sizeof(vk_layout_create_info));
+        vk_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+        VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;
+        ASSERT_EQ(VK_SUCCESS, vkCreatePipelineLayout(m_Device, &vk_layout_create_info, 0, &vk_pipeline_layout));
+
+        VkComputePipelineCreateInfo vk_pipeline_create_info;
+        memset(&vk_pipeline_create_info, 0, sizeof(vk_pipeline_create_info));
+        vk_pipeline_create_info.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        vk_pipeline_create_info.stage.sType        = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vk_pipeline_create_info.stage.stage        = VK_SHADER_STAGE_COMPUTE_BIT;
+        vk_pipeline_create_info.stage.module       = vk_shader_module;
+        vk_pipeline_create_info.stage.pName        = "main";
+        vk_pipeline_create_info.layout             = vk_pipeline_layout;
+        vk_pipeline_create_info.basePipelineIndex  = -1;
+
+        VkPipeline vk_pipeline = VK_NULL_HANDLE;
+        uint64_t start = dmTime::GetTime();
+        VkResult res = vkCreateComputePipelines(m_Device, m_Context->m_DriverPipelineCache, 1, &vk_pipeline_create_info, 0, &vk_pipeline);
+        *time_out = dmTime::GetTime() - start;
+
+        // Same as when the adapter creates a pipeline
+        m_Context->m_DriverCacheDirty = 1;
+
+        vkDestroyPipeline(m_Device, vk_pipeline, 0);
+        vkDestroyPipelineLayout(m_Device, vk_pipeline_layout, 0);
+        vkDestroyShaderModule(m_Device, vk_shader_module, 0);
+        ASSERT_EQ(VK_SUCCESS, res);
+    }
+
+    uint32_t GetCacheDataSize()
+    {
+        size_t data_size = 0;
+        VkResult res = vkGetPipelineCacheData(m_Device, m_Context->m_DriverPipelineCache, &data_size, 0);
+        return res == VK_SUCCESS ? (uint32_t) data_size : 0;
+    }
+
+    void ReloadCache()
+    {
+        dmGraphics::DestroyPipelineCache(m_Device, &m_Context->m_DriverPipelineCache);
+        ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateDriverPipelineCache(m_Context));
+    }
+
+    void ReadCacheFile(dmArray<uint8_t>& data)
+    {
+        FILE* f = fopen(m_CachePath, "rb");
+        ASSERT_NE((FILE*) 0, f);
+        fseek(f, 0, SEEK_END);
+        data.SetCapacity((uint32_t) ftell(f));
+        data.SetSize(data.Capacity());
+        fseek(f, 0, SEEK_SET);
+        ASSERT_EQ(data.Size(), (uint32_t) fread(data.Begin(), 1, data.Size(), f));
+        fclose(f);
+    }
+
+    void WriteCacheFile(const dmArray<uint8_t>& data)
+    {
+        FILE* f = fopen(m_CachePath, "wb");
+        ASSERT_NE((FILE*) 0, f);
+        ASSERT_EQ(data.Size(), (uint32_t) fwrite(data.Begin(), 1, data.Size(), f));
+        fclose(f);
+    }
+
+    char m_CachePath[DMPATH_MAX_PATH];
+};
+
+TEST_F(PipelineCacheDeviceTest, SaveAndReload)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    // No file yet, the cache starts out empty
+    ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateDriverPipelineCache(m_Context));
+    uint32_t empty_size = GetCacheDataSize();
+
+    // Nothing to save until a pipeline has been created
+    dmGraphics::SaveDriverPipelineCache(m_Context);
+    ASSERT_FALSE(dmSys::Exists(m_CachePath));
+
+    uint64_t cold_time = 0;
+    CreatePipeline(&cold_time);
+    uint32_t saved_size = GetCacheDataSize();
+    dmGraphics::SaveDriverPipelineCache(m_Context);
+    ASSERT_TRUE(dmSys::Exists(m_CachePath));
+    ASSERT_FALSE(m_Context->m_DriverCacheDirty);
+
+    // The pipelines compiled by the previous run are handed back to the driver
+    ReloadCache();
+    ASSERT_EQ(saved_size, GetCacheDataSize());
+    uint64_t warm_time = 0;
+    CreatePipeline(&warm_time);
+    printf("Pipeline creation: %.3f ms with an empty cache, %.3f ms with the saved cache\n", cold_time / 1000.0, warm_time / 1000.0);
+
+    // Files written by another driver version are discarded
+    dmArray<uint8_t> file_data;
+    ReadCacheFile(file_data);
+    file_data[8] ^= 0xFF; // PipelineCacheFileHeader::m_DriverVersion
+    WriteCacheFile(file_data);
+    ReloadCache();
+    ASSERT_EQ(empty_size, GetCacheDataSize());
+
+    // As are files that were cut short
+    file_data[8] ^= 0xFF;
+    file_data.SetSize(file_data.Size() - 1);
+    WriteCacheFile(file_data);
+    ReloadCache();
+    ASSERT_EQ(empty_size, GetCacheDataSize());
+}
+
+TEST(TextureUpload, Alignment)
+{
+    // Offsets must be a multiple of both the texel block size and 4
+    ASSERT_EQ(4u,  dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_LUMINANCE));
+    ASSERT_EQ(4u,  dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_LUMINANCE_ALPHA));
+    ASSERT_EQ(4u,  dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGB));
+    ASSERT_EQ(4u,  dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGBA));
+    ASSERT_EQ(8u,  dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGBA16F));
+    ASSERT_EQ(12u, dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGB16F));
+    ASSERT_EQ(12u, dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGB32F));
+    ASSERT_EQ(16u, dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGBA32F));
+    ASSERT_EQ(16u, dmGraphics::GetTextureUploadAlignment(dmGraphics::TEXTURE_FORMAT_RGB_ETC1));
+}
+
+class TextureUploadTest : public VulkanDeviceTest
+{
+protected:
+    static const uint32_t BUFFER_SIZE = 64 * 1024;
+
+    virtual void SetUp()
+    {
+        VulkanDeviceTest::SetUp();
+        if (m_Context)
+        {
+            ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateTextureUploadBatches(m_Context, BUFFER_SIZE));
+            // The driver may round the staging buffers up
+            m_BufferSize = m_Context->m_TextureUploadBatches[0].m_DeviceBuffer.m_MemorySize;
+        }
+    }
+
+    virtual void TearDown()
+    {
+        if (m_Context)
+        {
+            dmGraphics::DestroyTextureUploadBatches(m_Context);
+        }
+        VulkanDeviceTest::TearDown();
+    }
+
+    uint32_t GetBatchIndex(dmGraphics::TextureUploadBatch* batch)
+    {
+        return (uint32_t) (batch - m_Context->m_TextureUploadBatches);
+    }
+
+    uint32_t m_BufferSize;
+};
+
+TEST_F(TextureUploadTest, Alignment)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    uint32_t offset;
+    dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, 3, 4, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(0u, offset);
+
+    // Not a power of two
+    batch = dmGraphics::GetTextureUploadBatch(m_Context, 12, 12, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(12u, offset);
+
+    batch = dmGraphics::GetTextureUploadBatch(m_Context, 16, 16, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(32u, offset);
+    ASSERT_EQ(48u, batch->m_MappedDataCursor);
+
+    // Already aligned
+    batch = dmGraphics::GetTextureUploadBatch(m_Context, 4, 16, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(48u, offset);
+}
+
+TEST_F(TextureUploadTest, WrapAround)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    // Only one of these fits in a batch, so every reservation moves on to the next batch
+    const uint32_t size = m_BufferSize / 2 + 1;
+    for (uint32_t i = 0; i <= dmGraphics::DM_MAX_TEXTURE_UPLOAD_BATCHES; ++i)
+    {
+        uint32_t offset = ~0u;
+        dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, size, 4, &offset);
+        ASSERT_EQ(i % (uint32_t) dmGraphics::DM_MAX_TEXTURE_UPLOAD_BATCHES, GetBatchIndex(batch));
+        ASSERT_EQ(0u, offset);
+        ASSERT_TRUE(batch->m_Recording);
+        ASSERT_EQ(size, batch->m_MappedDataCursor);
+
+        for (uint32_t j = 0; j < dmGraphics::DM_MAX_TEXTURE_UPLOAD_BATCHES; ++j)
+        {
+            if (&m_Context->m_TextureUploadBatches[j] != batch)
+            {
+                ASSERT_FALSE(m_Context->m_TextureUploadBatches[j].m_Recording);
+            }
+        }
+    }
+
+    // Whatever fits in the remaining space stays in the current batch
+    uint32_t offset;
+    dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, m_BufferSize - size - 3, 4, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(size + 3, offset);
+}
+
+TEST_F(TextureUploadTest, FenceReuse)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    VkFence vk_fence = m_Context->m_TextureUploadBatches[0].m_SubmitFence;
+
+    // The fences start out signaled, and are reset when a batch starts recording
+    ASSERT_EQ(VK_SUCCESS, vkGetFenceStatus(m_Device, vk_fence));
+    uint32_t offset;
+    dmGraphics::GetTextureUploadBatch(m_Context, 16, 4, &offset);
+    ASSERT_EQ(VK_NOT_READY, vkGetFenceStatus(m_Device, vk_fence));
+
+    dmGraphics::SubmitTextureUploads(m_Context);
+    ASSERT_FALSE(m_Context->m_TextureUploadBatches[0].m_Recording);
+    ASSERT_EQ(1u, (uint32_t) m_Context->m_TextureUploadBatchIndex);
+    ASSERT_EQ(VK_SUCCESS, vkWaitForFences(m_Device, 1, &vk_fence, VK_TRUE, UINT64_MAX));
+
+    // Nothing recorded, nothing to submit
+    dmGraphics::SubmitTextureUploads(m_Context);
+    ASSERT_EQ(1u, (uint32_t) m_Context->m_TextureUploadBatchIndex);
+
+    for (uint32_t i = 1; i < dmGraphics::DM_MAX_TEXTURE_UPLOAD_BATCHES; ++i)
+    {
+        dmGraphics::GetTextureUploadBatch(m_Context, 16, 4, &offset);
+        dmGraphics::SubmitTextureUploads(m_Context);
+    }
+    ASSERT_EQ(0u, (uint32_t) m_Context->m_TextureUploadBatchIndex);
+
+    // Coming back to the first batch reuses its fence
+    dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, 16, 4, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+    ASSERT_EQ(vk_fence, batch->m_SubmitFence);
+    ASSERT_TRUE(batch->m_Recording);
+    ASSERT_EQ(VK_NOT_READY, vkGetFenceStatus(m_Device, vk_fence));
+}
+
+TEST_F(TextureUploadTest, Grow)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    uint32_t offset;
+    dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, 16, 4, &offset);
+    ASSERT_EQ(0u, GetBatchIndex(batch));
+
+    // Larger than the staging buffer, the next batch is grown to fit it
+    const uint32_t size = m_BufferSize * 3;
+    batch = dmGraphics::GetTextureUploadBatch(m_Context, size, 4, &offset);
+    ASSERT_EQ(1u, GetBatchIndex(batch));
+    ASSERT_EQ(0u, offset);
+    ASSERT_GE((uint32_t) batch->m_DeviceBuffer.m_MemorySize, size);
+    ASSERT_NE((void*) 0, batch->m_DeviceBuffer.m_MappedDataPtr);
+    memset(batch->m_DeviceBuffer.m_MappedDataPtr, 0xFF, size);
+
+    // The other batches keep their size
+    ASSERT_EQ(m_BufferSize, (uint32_t) m_Context->m_TextureUploadBatches[0].m_DeviceBuffer.m_MemorySize);
+    ASSERT_EQ(m_BufferSize, (uint32_t) m_Context->m_TextureUploadBatches[2].m_DeviceBuffer.m_MemorySize);
+}
+
+// Compares the upload ring against creating, submitting and waiting for a staging buffer per upload
+TEST_F(TextureUploadTest, UploadPerf)
+{
+    if (!m_Context)
+    {
+        printf("No Vulkan device available, skipping test\n");
+        return;
+    }
+
+    const uint32_t upload_count = 1000;
+    const uint32_t upload_size  = 16 * 1024;
+    VkDevice vk_device          = m_Device;
+    VkPhysicalDevice vk_physical_device = m_Context->m_PhysicalDevice.m_Device;
+    VkQueue vk_queue            = m_Context->m_LogicalDevice.m_GraphicsQueue;
+
+    dmGraphics::DeviceBuffer dst_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateDeviceBuffer(vk_physical_device, vk_device, upload_size,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &dst_buffer));
+
+    dmArray<uint8_t> data;
+    data.SetCapacity(upload_size);
+    data.SetSize(upload_size);
+    memset(data.Begin(), 0xAB, upload_size);
+
+    VkBufferCopy vk_copy_region;
+    memset(&vk_copy_region, 0, sizeof(vk_copy_region));
+    vk_copy_region.size = upload_size;
+
+    uint64_t ring_start = dmTime::GetTime();
+    for (uint32_t i = 0; i < upload_count; ++i)
+    {
+        uint32_t offset;
+        dmGraphics::TextureUploadBatch* batch = dmGraphics::GetTextureUploadBatch(m_Context, upload_size, 4, &offset);
+        memcpy((uint8_t*) batch->m_DeviceBuffer.m_MappedDataPtr + offset, data.Begin(), upload_size);
+        vk_copy_region.srcOffset = offset;
+        vkCmdCopyBuffer(batch->m_CommandBuffer, batch->m_DeviceBuffer.m_Handle.m_Buffer, dst_buffer.m_Handle.m_Buffer, 1, &vk_copy_region);
+    }
+    dmGraphics::SubmitTextureUploads(m_Context);
+    ASSERT_EQ(VK_SUCCESS, vkQueueWaitIdle(vk_queue));
+    uint64_t ring_time = dmTime::GetTime() - ring_start;
+
+    vk_copy_region.srcOffset = 0;
+
+    uint64_t staging_start = dmTime::GetTime();
+    for (uint32_t i = 0; i < upload_count; ++i)
+    {
+        dmGraphics::DeviceBuffer stage_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateDeviceBuffer(vk_physical_device, vk_device, upload_size,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stage_buffer));
+        ASSERT_EQ(VK_SUCCESS, stage_buffer.MapMemory(vk_device));
+        memcpy(stage_buffer.m_MappedDataPtr, data.Begin(), upload_size);
+        stage_buffer.UnmapMemory(vk_device);
+
+        VkCommandBuffer vk_command_buffer;
+        ASSERT_EQ(VK_SUCCESS, dmGraphics::CreateCommandBuffers(vk_device, m_CommandPool, 1, &vk_command_buffer));
+
+        VkCommandBufferBeginInfo vk_command_buffer_begin_info;
+        memset(&vk_command_buffer_begin_info, 0, sizeof(vk_command_buffer_begin_info));
+        vk_command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vk_command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(vk_command_buffer, &vk_command_buffer_begin_info);
+        vkCmdCopyBuffer(vk_command_buffer, stage_buffer.m_Handle.m_Buffer, dst_buffer.m_Handle.m_Buffer, 1, &vk_copy_region);
+        vkEndCommandBuffer(vk_command_buffer);
+
+        VkSubmitInfo vk_submit_info;
+        memset(&vk_submit_info, 0, sizeof(vk_submit_info));
+        vk_submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        vk_submit_info.commandBufferCount = 1;
+        vk_submit_info.pCommandBuffers    = &vk_command_buffer;
+        ASSERT_EQ(VK_SUCCESS, vkQueueSubmit(vk_queue, 1, &vk_submit_info, VK_NULL_HANDLE));
+        ASSERT_EQ(VK_SUCCESS, vkQueueWaitIdle(vk_queue));
+
+        vkFreeCommandBuffers(vk_device, m_CommandPool, 1, &vk_command_buffer);
+        dmGraphics::DestroyDeviceBuffer(vk_device, &stage_buffer.m_Handle);
+    }
+    uint64_t staging_time = dmTime::GetTime() - staging_start;
+
+    printf("%u uploads of %u KB: %.3f ms through the upload ring, %.3f ms with a staging buffer per upload\n",
+        upload_count, upload_size / 1024, ring_time / 1000.0, staging_time / 1000.0);
+
+    dmGraphics::DestroyDeviceBuffer(vk_device, &dst_buffer.m_Handle);
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
@@ -113,6 +113,7 @@ PFN_vkDestroyRenderPass vkDestroyRenderPass;
 PFN_vkDestroyFramebuffer vkDestroyFramebuffer;
 PFN_vkDestroyShaderModule vkDestroyShaderModule;
 PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 PFN_vkCreateQueryPool vkCreateQueryPool;
 PFN_vkDestroyQueryPool vkDestroyQueryPool;
 PFN_vkGetQueryPoolResults vkGetQueryPoolResults;
@@ -260,6 +261,7 @@ namespace dmGraphics
         vkDestroyFramebuffer = (PFN_vkDestroyFramebuffer) vkGetInstanceProcAddr(vk_instance, "vkDestroyFramebuffer");
         vkDestroyShaderModule = (PFN_vkDestroyShaderModule) vkGetInstanceProcAddr(vk_instance, "vkDestroyShaderModule");
         vkDestroyPipelineCache = (PFN_vkDestroyPipelineCache) vkGetInstanceProcAddr(vk_instance, "vkDestroyPipelineCache");
+        vkGetPipelineCacheData = (PFN_vkGetPipelineCacheData) vkGetInstanceProcAddr(vk_instance, "vkGetPipelineCacheData");
         vkCreateQueryPool = (PFN_vkCreateQueryPool) vkGetInstanceProcAddr(vk_instance, "vkCreateQueryPool");
         vkDestroyQueryPool = (PFN_vkDestroyQueryPool) vkGetInstanceProcAddr(vk_instance, "vkDestroyQueryPool");
         vkGetQueryPoolResults = (PFN_vkGetQueryPoolResults) vkGetInstanceProcAddr(vk_instance, "vkGetQueryPoolResults");
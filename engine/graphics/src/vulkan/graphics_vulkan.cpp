@@ -13,10 +13,13 @@
 // specific language governing permissions and limitations under the License.
 
 #include <dlib/math.h>
+#include <dlib/align.h>
 #include <dlib/array.h>
 #include <dlib/profile.h>
 #include <dlib/dstrings.h>
 #include <dlib/log.h>
+#include <dlib/path.h>
+#include <dlib/sys.h>
 
 #include <dmsdk/vectormath/cpp/vectormath_aos.h>
 
@@ -109,6 +112,12 @@ namespace dmGraphics
         m_VerifyGraphicsCalls     = params.m_VerifyGraphicsCalls;
         m_UseValidationLayers     = params.m_UseValidationLayers;
         m_RenderDocSupport        = params.m_RenderDocSupport;
+        m_PipelineHashDirty       = 1;
+
+        if (params.m_PipelineCachePath)
+        {
+            dmStrlCpy(m_DriverPipelineCachePath, params.m_PipelineCachePath, sizeof(m_DriverPipelineCachePath));
+        }
 
         DM_STATIC_ASSERT(sizeof(m_TextureFormatSupport)*4 >= TEXTURE_FORMAT_COUNT, Invalid_Struct_Size );
     }
@@ -174,6 +183,187 @@ namespace dmGraphics
         return VK_SUCCESS;
     }
 
+    static VkResult CreateTextureUploadBuffer(VulkanContext* context, uint32_t size, TextureUploadBatch* batch)
+    {
+        VkDevice vk_device     = context->m_LogicalDevice.m_Device;
+        batch->m_DeviceBuffer  = DeviceBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+        VkResult res = CreateDeviceBuffer(context->m_PhysicalDevice.m_Device, vk_device, size,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &batch->m_DeviceBuffer);
+        if (res != VK_SUCCESS)
+        {
+            return res;
+        }
+
+        // The staging memory stays mapped for as long as the buffer lives
+        return batch->m_DeviceBuffer.MapMemory(vk_device);
+    }
+
+    VkResult CreateTextureUploadBatches(VulkanContext* context, uint32_t buffer_size)
+    {
+        VkDevice vk_device = context->m_LogicalDevice.m_Device;
+
+        VkFenceCreateInfo vk_create_fence_info;
+        memset(&vk_create_fence_info, 0, sizeof(vk_create_fence_info));
+        vk_create_fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vk_create_fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (uint8_t i = 0; i < DM_MAX_TEXTURE_UPLOAD_BATCHES; ++i)
+        {
+            TextureUploadBatch& batch = context->m_TextureUploadBatches[i];
+            memset(&batch, 0, sizeof(batch));
+
+            VkResult res = CreateCommandBuffers(vk_device, context->m_LogicalDevice.m_CommandPool, 1, &batch.m_CommandBuffer);
+            if (res != VK_SUCCESS)
+            {
+                return res;
+            }
+
+            res = vkCreateFence(vk_device, &vk_create_fence_info, 0, &batch.m_SubmitFence);
+            if (res != VK_SUCCESS)
+            {
+                return res;
+            }
+
+            res = CreateTextureUploadBuffer(context, buffer_size, &batch);
+            if (res != VK_SUCCESS)
+            {
+                return res;
+            }
+        }
+
+        context->m_TextureUploadBatchIndex = 0;
+        return VK_SUCCESS;
+    }
+
+    void DestroyTextureUploadBatches(VulkanContext* context)
+    {
+        VkDevice vk_device = context->m_LogicalDevice.m_Device;
+
+        for (uint8_t i = 0; i < DM_MAX_TEXTURE_UPLOAD_BATCHES; ++i)
+        {
+            TextureUploadBatch& batch = context->m_TextureUploadBatches[i];
+            // Uploads recorded after the last Flip are never submitted, and the fence of that batch
+            // was reset when the recording started. Only wait for batches that were submitted.
+            if (batch.m_Recording)
+            {
+                vkEndCommandBuffer(batch.m_CommandBuffer);
+                batch.m_Recording = 0;
+            }
+            else
+            {
+                vkWaitForFences(vk_device, 1, &batch.m_SubmitFence, VK_TRUE, UINT64_MAX);
+            }
+            vkDestroyFence(vk_device, batch.m_SubmitFence, 0);
+            vkFreeCommandBuffers(vk_device, context->m_LogicalDevice.m_CommandPool, 1, &batch.m_CommandBuffer);
+            batch.m_DeviceBuffer.UnmapMemory(vk_device);
+            DestroyDeviceBuffer(vk_device, &batch.m_DeviceBuffer.m_Handle);
+        }
+    }
+
+    // Submits the recorded texture uploads. Since they go on the graphics queue ahead of the frame
+    // command buffer, any draw call recorded after the upload will see the new texture data.
+    void SubmitTextureUploads(VulkanContext* context)
+    {
+        TextureUploadBatch& batch = context->m_TextureUploadBatches[context->m_TextureUploadBatchIndex];
+        if (!batch.m_Recording)
+        {
+            return;
+        }
+
+        VkResult res = vkEndCommandBuffer(batch.m_CommandBuffer);
+        CHECK_VK_ERROR(res);
+
+        VkSubmitInfo vk_submit_info;
+        memset(&vk_submit_info, 0, sizeof(vk_submit_info));
+        vk_submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        vk_submit_info.commandBufferCount = 1;
+        vk_submit_info.pCommandBuffers    = &batch.m_CommandBuffer;
+
+        res = vkQueueSubmit(context->m_LogicalDevice.m_GraphicsQueue, 1, &vk_submit_info, batch.m_SubmitFence);
+        CHECK_VK_ERROR(res);
+
+        batch.m_Recording                  = 0;
+        context->m_TextureUploadBatchIndex = (context->m_TextureUploadBatchIndex + 1) % DM_MAX_TEXTURE_UPLOAD_BATCHES;
+    }
+
+    // The staging buffer offset of a copy must be a multiple of both the texel block size and 4
+    uint32_t GetTextureUploadAlignment(TextureFormat format)
+    {
+        if (IsTextureFormatCompressed(format))
+        {
+            // Compressed blocks are either 8 or 16 bytes
+            return 16;
+        }
+        else if (format == TEXTURE_FORMAT_RGB)
+        {
+            // Expanded to RGBA before the upload
+            return 4;
+        }
+
+        uint32_t texel_size = dmMath::Max(1U, GetTextureFormatBitsPerPixel(format) / 8);
+        if (texel_size % 4 == 0)
+            return texel_size;
+        else if (texel_size % 2 == 0)
+            return texel_size * 2;
+        return texel_size * 4;
+    }
+
+    // Reserves size bytes of staging memory in the current upload batch, and starts recording it if needed.
+    TextureUploadBatch* GetTextureUploadBatch(VulkanContext* context, uint32_t size, uint32_t alignment, uint32_t* offset_out)
+    {
+        VkDevice vk_device         = context->m_LogicalDevice.m_Device;
+        TextureUploadBatch* batch  = &context->m_TextureUploadBatches[context->m_TextureUploadBatchIndex];
+
+        // The alignment isn't necessarily a power of two (e.g 12 bytes for RGB32F)
+        uint32_t offset = ((batch->m_MappedDataCursor + alignment - 1) / alignment) * alignment;
+
+        if (batch->m_Recording && offset + size > batch->m_DeviceBuffer.m_MemorySize)
+        {
+            SubmitTextureUploads(context);
+            batch = &context->m_TextureUploadBatches[context->m_TextureUploadBatchIndex];
+        }
+
+        if (!batch->m_Recording)
+        {
+            // Normally long done, since the batch was submitted DM_MAX_TEXTURE_UPLOAD_BATCHES uploads ago
+            vkWaitForFences(vk_device, 1, &batch->m_SubmitFence, VK_TRUE, UINT64_MAX);
+            vkResetFences(vk_device, 1, &batch->m_SubmitFence);
+
+            const uint32_t buffer_size = (uint32_t) batch->m_DeviceBuffer.m_MemorySize;
+            if (size > buffer_size)
+            {
+                batch->m_DeviceBuffer.UnmapMemory(vk_device);
+                DestroyDeviceBuffer(vk_device, &batch->m_DeviceBuffer.m_Handle);
+
+                VkResult res = CreateTextureUploadBuffer(context, dmMath::Max(size, buffer_size * 2), batch);
+                CHECK_VK_ERROR(res);
+            }
+
+            VkCommandBufferBeginInfo vk_command_buffer_begin_info;
+            memset(&vk_command_buffer_begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+            vk_command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vk_command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            VkResult res = vkBeginCommandBuffer(batch->m_CommandBuffer, &vk_command_buffer_begin_info);
+            CHECK_VK_ERROR(res);
+
+            // Earlier frames may still be sampling the textures we are about to write to
+            vkCmdPipelineBarrier(batch->m_CommandBuffer,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, 0, 0, 0, 0, 0);
+
+            batch->m_MappedDataCursor = 0;
+            batch->m_Recording        = 1;
+            offset                    = 0;
+        }
+
+        batch->m_MappedDataCursor = offset + size;
+        *offset_out               = offset;
+        return batch;
+    }
+
     static VkSamplerAddressMode GetVulkanSamplerAddressMode(TextureWrap wrap)
     {
         const VkSamplerAddressMode address_mode_lut[] = {
@@ -349,7 +539,12 @@ namespace dmGraphics
         vkCmdBeginRenderPass(context->m_MainCommandBuffers[context->m_SwapChain->m_ImageIndex], &vk_render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
         rt->m_IsBound = 1;
-        context->m_CurrentRenderTarget = render_target;
+
+        if (context->m_CurrentRenderTarget != render_target)
+        {
+            context->m_CurrentRenderTarget = render_target;
+            context->m_PipelineHashDirty   = 1;
+        }
     }
 
     static VkImageAspectFlags GetDefaultDepthAndStencilAspectFlags(VkFormat vk_format)
@@ -556,6 +751,11 @@ namespace dmGraphics
         // Create an additional single-time buffer for device uploading
         CreateCommandBuffers(vk_device, context->m_LogicalDevice.m_CommandPool, 1, &context->m_MainCommandBufferUploadHelper);
 
+        // Create the staging areas for texture uploads. They grow if a single texture doesn't fit.
+        const uint32_t texture_upload_buffer_size = 4 * 1024 * 1024;
+        res = CreateTextureUploadBatches(context, texture_upload_buffer_size);
+        CHECK_VK_ERROR(res);
+
         // Create main resources-to-destroy lists, one for each command buffer
         for (uint32_t i = 0; i < num_swap_chain_images; ++i)
         {
@@ -629,6 +829,8 @@ namespace dmGraphics
         // Flush all current commands
         SynchronizeDevice(vk_device);
 
+        context->m_PipelineHashDirty = 1;
+
         DestroyMainFrameBuffers(context);
 
         // Destroy main Depth/Stencil buffer
@@ -825,6 +1027,124 @@ namespace dmGraphics
         }
     }
 
+    // The driver cache data is stored with our own header in front of it, so that files written by
+    // another driver version, or cut short by a crash, are thrown away instead of handed to the driver.
+    struct PipelineCacheFileHeader
+    {
+        uint32_t m_Magic;
+        uint32_t m_Version;
+        uint32_t m_DriverVersion;
+        uint32_t m_DataSize;
+        uint32_t m_DataHash;
+    };
+
+    static const uint32_t PIPELINE_CACHE_FILE_MAGIC   = 0x50435644; // 'DVCP'
+    static const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+    VkResult CreateDriverPipelineCache(VulkanContext* context)
+    {
+        const VkPhysicalDeviceProperties& vk_properties = context->m_PhysicalDevice.m_Properties;
+        const char* path         = context->m_DriverPipelineCachePath[0] ? context->m_DriverPipelineCachePath : 0;
+        uint8_t* file_data       = 0;
+        uint32_t file_size       = 0;
+        const void* cache_data   = 0;
+        uint32_t cache_data_size = 0;
+
+        if (path && dmSys::ResourceSize(path, &file_size) == dmSys::RESULT_OK && file_size > sizeof(PipelineCacheFileHeader))
+        {
+            file_data = (uint8_t*) malloc(file_size);
+
+            uint32_t read_size = 0;
+            if (dmSys::LoadResource(path, file_data, file_size, &read_size) == dmSys::RESULT_OK && read_size == file_size)
+            {
+                PipelineCacheFileHeader header;
+                memcpy(&header, file_data, sizeof(header));
+                const uint8_t* data = file_data + sizeof(header);
+
+                if (header.m_Magic == PIPELINE_CACHE_FILE_MAGIC &&
+                    header.m_Version == PIPELINE_CACHE_FILE_VERSION &&
+                    header.m_DriverVersion == vk_properties.driverVersion &&
+                    header.m_DataSize == file_size - sizeof(header) &&
+                    header.m_DataHash == dmHashBuffer32(data, header.m_DataSize) &&
+                    IsPipelineCacheDataCompatible(vk_properties, data, header.m_DataSize))
+                {
+                    cache_data      = data;
+                    cache_data_size = header.m_DataSize;
+                }
+                else
+                {
+                    dmLogInfo("Discarding Vulkan pipeline cache '%s', it was created for another device or driver", path);
+                }
+            }
+        }
+
+        VkResult res = CreatePipelineCache(context->m_LogicalDevice.m_Device, vk_properties, cache_data, cache_data_size, &context->m_DriverPipelineCache);
+        free(file_data);
+
+        context->m_DriverCacheDirty = 0;
+        return res;
+    }
+
+    void SaveDriverPipelineCache(VulkanContext* context)
+    {
+        const char* path = context->m_DriverPipelineCachePath;
+        if (path[0] == 0 || !context->m_DriverCacheDirty || context->m_DriverPipelineCache == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        VkDevice vk_device = context->m_LogicalDevice.m_Device;
+        size_t data_size   = 0;
+        VkResult res       = vkGetPipelineCacheData(vk_device, context->m_DriverPipelineCache, &data_size, 0);
+        if (res != VK_SUCCESS || data_size == 0)
+        {
+            return;
+        }
+
+        uint32_t file_size = sizeof(PipelineCacheFileHeader) + (uint32_t) data_size;
+        uint8_t* file_data = (uint8_t*) malloc(file_size);
+        uint8_t* data      = file_data + sizeof(PipelineCacheFileHeader);
+
+        res = vkGetPipelineCacheData(vk_device, context->m_DriverPipelineCache, &data_size, data);
+        if (res == VK_SUCCESS)
+        {
+            PipelineCacheFileHeader header;
+            header.m_Magic         = PIPELINE_CACHE_FILE_MAGIC;
+            header.m_Version       = PIPELINE_CACHE_FILE_VERSION;
+            header.m_DriverVersion = context->m_PhysicalDevice.m_Properties.driverVersion;
+            header.m_DataSize      = (uint32_t) data_size;
+            header.m_DataHash      = dmHashBuffer32(data, header.m_DataSize);
+            memcpy(file_data, &header, sizeof(header));
+            file_size = sizeof(header) + header.m_DataSize;
+
+            // Write to a temporary file and move it in place, so a crash never leaves a half written cache behind
+            char tmp_path[DMPATH_MAX_PATH];
+            dmSnPrintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+            bool saved = false;
+            FILE* f = fopen(tmp_path, "wb");
+            if (f)
+            {
+                saved = fwrite(file_data, 1, file_size, f) == file_size;
+                saved = fclose(f) == 0 && saved;
+            }
+
+            if (saved)
+            {
+                saved = dmSys::Rename(path, tmp_path) == dmSys::RESULT_OK;
+            }
+
+            if (!saved)
+            {
+                dmLogWarning("Unable to save the Vulkan pipeline cache to '%s'", path);
+                dmSys::Unlink(tmp_path);
+            }
+        }
+
+        free(file_data);
+        context->m_DriverCacheDirty = 0;
+    }
+
     bool InitializeVulkan(HContext _context, const WindowParams* params)
     {
         VulkanContext* context = (VulkanContext*) _context;
@@ -965,6 +1285,13 @@ namespace dmGraphics
             goto bail;
         }
 
+        res = CreateDriverPipelineCache(context);
+        if (res != VK_SUCCESS)
+        {
+            dmLogError("Could not create a Vulkan pipeline cache, reason: %s", VkResultToStr(res));
+            goto bail;
+        }
+
         delete[] device_list;
 
         context->m_PipelineCache.SetCapacity(32,64);
@@ -980,6 +1307,7 @@ namespace dmGraphics
 
         return true;
 bail:
+        DestroyPipelineCache(context->m_LogicalDevice.m_Device, &context->m_DriverPipelineCache);
         if (context->m_SwapChain)
             delete context->m_SwapChain;
         if (device_list)
@@ -1170,6 +1498,8 @@ bail:
         VkResult res = vkEndCommandBuffer(context->m_MainCommandBuffers[frame_ix]);
         CHECK_VK_ERROR(res);
 
+        SubmitTextureUploads(context);
+
         VkPipelineStageFlags vk_pipeline_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
         VkSubmitInfo vk_submit_info;
@@ -1359,8 +1689,7 @@ bail:
         resource->m_Destroyed = 1;
     }
 
-    static Pipeline* GetOrCreatePipeline(VkDevice vk_device, VkSampleCountFlagBits vk_sample_count,
-        const PipelineState pipelineState, PipelineCache& pipelineCache,
+    static uint64_t GetPipelineHash(VkSampleCountFlagBits vk_sample_count, const PipelineState& pipelineState,
         Program* program, RenderTarget* rt, HVertexDeclaration vertexDeclaration)
     {
         HashState64 pipeline_hash_state;
@@ -1370,9 +1699,14 @@ bail:
         dmHashUpdateBuffer64(&pipeline_hash_state, &vertexDeclaration->m_Hash, sizeof(vertexDeclaration->m_Hash));
         dmHashUpdateBuffer64(&pipeline_hash_state, &rt->m_Id, sizeof(rt->m_Id));
         dmHashUpdateBuffer64(&pipeline_hash_state, &vk_sample_count, sizeof(vk_sample_count));
-        uint64_t pipeline_hash = dmHashFinal64(&pipeline_hash_state);
+        return dmHashFinal64(&pipeline_hash_state);
+    }
 
-        Pipeline* cached_pipeline = pipelineCache.Get(pipeline_hash);
+    static Pipeline* GetOrCreatePipeline(VulkanContext* context, uint64_t pipeline_hash, VkSampleCountFlagBits vk_sample_count,
+        const PipelineState pipelineState, Program* program, RenderTarget* rt, HVertexDeclaration vertexDeclaration)
+    {
+        PipelineCache& pipelineCache = context->m_PipelineCache;
+        Pipeline* cached_pipeline    = pipelineCache.Get(pipeline_hash);
 
         if (!cached_pipeline)
         {
@@ -1384,8 +1718,10 @@ bail:
             vk_scissor.offset.x = 0;
             vk_scissor.offset.y = 0;
 
-            VkResult res = CreatePipeline(vk_device, vk_scissor, vk_sample_count, pipelineState, program, vertexDeclaration, rt, &new_pipeline);
+            VkResult res = CreatePipeline(context->m_LogicalDevice.m_Device, context->m_DriverPipelineCache,
+                vk_scissor, vk_sample_count, pipelineState, program, vertexDeclaration, rt, &new_pipeline);
             CHECK_VK_ERROR(res);
+            context->m_DriverCacheDirty = 1;
 
             if (pipelineCache.Full())
             {
@@ -1738,37 +2074,40 @@ bail:
     static void VulkanDeleteVertexDeclaration(HVertexDeclaration vertex_declaration)
     {
         delete (VertexDeclaration*) vertex_declaration;
+        // A new declaration could get the same address
+        g_VulkanContext->m_PipelineHashDirty = 1;
     }
 
     static void VulkanEnableVertexDeclaration(HContext _context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer)
     {
         VulkanContext* context              = (VulkanContext*) _context;
         context->m_CurrentVertexBuffer      = (DeviceBuffer*) vertex_buffer;
-        context->m_CurrentVertexDeclaration = (VertexDeclaration*) vertex_declaration;
+
+        if (context->m_CurrentVertexDeclaration != vertex_declaration)
+        {
+            context->m_CurrentVertexDeclaration = (VertexDeclaration*) vertex_declaration;
+            context->m_PipelineHashDirty        = 1;
+        }
     }
 
-    static void VulkanEnableVertexDeclarationProgram(HContext _context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    static void FillProgramVertexDeclaration(Program* program, HVertexDeclaration vertex_declaration, VertexDeclaration* declaration_out)
     {
-        VulkanContext* context      = (VulkanContext*) _context;
-        Program* program_ptr        = (Program*) program;
-        ShaderModule* vertex_shader = program_ptr->m_VertexModule;
-
-        VulkanEnableVertexDeclaration(_context, &context->m_MainVertexDeclaration, vertex_buffer);
+        ShaderModule* vertex_shader = program->m_VertexModule;
 
         // JG: This is a bit of a whacky doodle doo, but it's required to avoid a soft crash when creating the pipeline on MVK.
         //     Basically we create fake bindings if a stream isn't defined in the vertex declaration, because otherwise
         //     the MVK driver will complain that we haven't defined all bindings in the shader.
         //     This means that we might get side-effects since we are basically binding the first data buffer
         //     to the stream as an R8 value, but uh yeah not sure what do to about that right now.
-        context->m_MainVertexDeclaration = {0};
-        context->m_MainVertexDeclaration.m_StreamCount = vertex_shader->m_InputCount;
-        context->m_MainVertexDeclaration.m_Stride      = vertex_declaration->m_Stride;
-        context->m_MainVertexDeclaration.m_Hash        = vertex_declaration->m_Hash;
+        *declaration_out = {0};
+        declaration_out->m_StreamCount = vertex_shader->m_InputCount;
+        declaration_out->m_Stride      = vertex_declaration->m_Stride;
+        declaration_out->m_Hash        = vertex_declaration->m_Hash;
 
         for (uint32_t i = 0; i < vertex_shader->m_InputCount; i++)
         {
             ShaderResourceBinding& input      = vertex_shader->m_Inputs[i];
-            VertexDeclaration::Stream& stream = context->m_MainVertexDeclaration.m_Streams[i];
+            VertexDeclaration::Stream& stream = declaration_out->m_Streams[i];
 
             stream.m_NameHash = input.m_NameHash;
             stream.m_Location = input.m_Binding;
@@ -1786,9 +2125,24 @@ bail:
         }
     }
 
+    static void VulkanEnableVertexDeclarationProgram(HContext _context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        VulkanContext* context = (VulkanContext*) _context;
+        uint64_t prev_hash     = context->m_MainVertexDeclaration.m_Hash;
+
+        VulkanEnableVertexDeclaration(_context, &context->m_MainVertexDeclaration, vertex_buffer);
+        FillProgramVertexDeclaration((Program*) program, vertex_declaration, &context->m_MainVertexDeclaration);
+
+        if (prev_hash != vertex_declaration->m_Hash)
+        {
+            context->m_PipelineHashDirty = 1;
+        }
+    }
+
     static void VulkanDisableVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
     {
         ((VulkanContext*) context)->m_CurrentVertexDeclaration = 0;
+        ((VulkanContext*) context)->m_PipelineHashDirty        = 1;
     }
 
     static uint32_t VulkanGetVertexDeclarationStride(HVertexDeclaration vertex_declaration)
@@ -2059,14 +2413,43 @@ bail:
                     vp.m_X, vp.m_Y, vp.m_W, vp.m_H);
             }
 
+            context->m_ViewportChanged = 0;
+            context->m_ScissorChanged  = 1;
+        }
+
+        if (context->m_ScissorChanged)
+        {
             VkRect2D vk_scissor;
             vk_scissor.extent   = current_rt->m_Extent;
             vk_scissor.offset.x = 0;
             vk_scissor.offset.y = 0;
 
+            if (context->m_ScissorTestEnabled)
+            {
+                Viewport& sr = context->m_MainScissor;
+                int32_t y = (int32_t) sr.m_Y;
+                int32_t h = (int32_t) sr.m_H;
+
+                // Same as for the viewport, the y axis is inverted when rendering to the backbuffer
+                if (current_rt->m_Id == DM_RENDERTARGET_BACKBUFFER_ID)
+                {
+                    y = (int32_t) context->m_WindowHeight - (y + h);
+                    if (y < 0)
+                    {
+                        h = dmMath::Max(h + y, 0);
+                        y = 0;
+                    }
+                }
+
+                vk_scissor.offset.x      = sr.m_X;
+                vk_scissor.offset.y      = y;
+                vk_scissor.extent.width  = sr.m_W;
+                vk_scissor.extent.height = (uint32_t) h;
+            }
+
             vkCmdSetScissor(context->m_MainCommandBuffers[context->m_SwapChain->m_ImageIndex], 0, 1, &vk_scissor);
 
-            context->m_ViewportChanged = 0;
+            context->m_ScissorChanged = 0;
         }
 
         // Get the pipeline for the active draw state
@@ -2076,9 +2459,16 @@ bail:
             vk_sample_count = context->m_SwapChain->m_SampleCountFlag;
         }
 
-        Pipeline* pipeline = GetOrCreatePipeline(vk_device, vk_sample_count,
-            context->m_PipelineState, context->m_PipelineCache,
-            program_ptr, current_rt, context->m_CurrentVertexDeclaration);
+        // Most draw calls reuse the state of the previous one, so only rehash the pipeline key when something has changed
+        if (context->m_PipelineHashDirty || memcmp(&context->m_PipelineHashState, &context->m_PipelineState, sizeof(PipelineState)) != 0)
+        {
+            context->m_PipelineHash      = GetPipelineHash(vk_sample_count, context->m_PipelineState, program_ptr, current_rt, context->m_CurrentVertexDeclaration);
+            context->m_PipelineHashState = context->m_PipelineState;
+            context->m_PipelineHashDirty = 0;
+        }
+
+        Pipeline* pipeline = GetOrCreatePipeline(context, context->m_PipelineHash, vk_sample_count,
+            context->m_PipelineState, program_ptr, current_rt, context->m_CurrentVertexDeclaration);
 
         if (pipeline != context->m_CurrentPipeline)
         {
@@ -2424,6 +2814,8 @@ bail:
         Program* program_ptr = (Program*) program;
         DestroyProgram(context, program_ptr);
         delete program_ptr;
+        // A new program could get the same address
+        g_VulkanContext->m_PipelineHashDirty = 1;
     }
 
     static void DestroyShader(ShaderModule* shader)
@@ -2499,12 +2891,17 @@ bail:
 
     static void VulkanEnableProgram(HContext context, HProgram program)
     {
-        g_VulkanContext->m_CurrentProgram = (Program*) program;
+        if (g_VulkanContext->m_CurrentProgram != (Program*) program)
+        {
+            g_VulkanContext->m_CurrentProgram    = (Program*) program;
+            g_VulkanContext->m_PipelineHashDirty = 1;
+        }
     }
 
     static void VulkanDisableProgram(HContext context)
     {
-        g_VulkanContext->m_CurrentProgram = 0;
+        g_VulkanContext->m_CurrentProgram    = 0;
+        g_VulkanContext->m_PipelineHashDirty = 1;
     }
 
     static bool VulkanReloadProgram(HContext context, HProgram program, HVertexProgram vert_program, HFragmentProgram frag_program)
@@ -2512,6 +2909,7 @@ bail:
         Program* program_ptr = (Program*) program;
         DestroyProgram(context, program_ptr);
         CreateProgram((VulkanContext*) context, program_ptr, (ShaderModule*) vert_program, (ShaderModule*) frag_program);
+        g_VulkanContext->m_PipelineHashDirty = 1;
         return true;
     }
 
@@ -2749,12 +3147,22 @@ bail:
     static void VulkanEnableState(HContext context, State state)
     {
         assert(context);
+        if (state == STATE_SCISSOR_TEST)
+        {
+            g_VulkanContext->m_ScissorTestEnabled = 1;
+            g_VulkanContext->m_ScissorChanged     = 1;
+        }
         SetPipelineStateValue(g_VulkanContext->m_PipelineState, state, 1);
     }
 
     static void VulkanDisableState(HContext context, State state)
     {
         assert(context);
+        if (state == STATE_SCISSOR_TEST)
+        {
+            g_VulkanContext->m_ScissorTestEnabled = 0;
+            g_VulkanContext->m_ScissorChanged     = 1;
+        }
         SetPipelineStateValue(g_VulkanContext->m_PipelineState, state, 0);
     }
 
@@ -2788,10 +3196,15 @@ bail:
 
     static void VulkanSetScissor(HContext context, int32_t x, int32_t y, int32_t width, int32_t height)
     {
-        // While scissors are obviously supported in vulkan, we don't expose it
-        // to the users via render scripts so it's a bit hard to test.
-        // Leaving it unsupported for now.
-        assert(0 && "Not supported");
+        // Like the viewport, the scissor is applied when we actually draw,
+        // since it needs to be inverted when rendering to the backbuffer.
+        Viewport& scissor = g_VulkanContext->m_MainScissor;
+        scissor.m_X       = (uint16_t) dmMath::Max(x, 0);
+        scissor.m_Y       = (uint16_t) dmMath::Max(y, 0);
+        scissor.m_W       = (uint16_t) dmMath::Max(width, 0);
+        scissor.m_H       = (uint16_t) dmMath::Max(height, 0);
+
+        g_VulkanContext->m_ScissorChanged = 1;
     }
 
     static void VulkanSetStencilMask(HContext context, uint32_t mask)
@@ -3118,6 +3531,7 @@ bail:
     {
         RenderTarget* rt = GetAssetFromContainer<RenderTarget>(g_VulkanContext->m_AssetHandleContainer, render_target);
         g_VulkanContext->m_AssetHandleContainer.Release(render_target);
+        g_VulkanContext->m_PipelineHashDirty = 1;
 
         for (int i = 0; i < MAX_BUFFER_COLOR_ATTACHMENTS; ++i)
         {
@@ -3313,12 +3727,6 @@ bail:
         uint8_t layer_count = textureOut->m_Depth;
         assert(layer_count > 0);
 
-        // TODO There is potentially a bunch of redundancy here.
-        //      * Can we use a single command buffer for these updates,
-        //        and not create a new one in every transition?
-        //      * Should we batch upload all the mipmap levels instead?
-        //        There's a lot of extra work doing all these transitions and image copies
-        //        per mipmap instead of batching in one cmd
         if (useStageBuffer)
         {
             uint32_t slice_size = texDataSize / layer_count;
@@ -3334,44 +3742,24 @@ bail:
             }
         #endif
 
-            // Create one-time commandbuffer to carry the copy command
-            VkCommandBuffer vk_command_buffer;
-            CreateCommandBuffers(vk_device, context->m_LogicalDevice.m_CommandPool, 1, &vk_command_buffer);
-            VkCommandBufferBeginInfo vk_command_buffer_begin_info;
-            memset(&vk_command_buffer_begin_info, 0, sizeof(VkCommandBufferBeginInfo));
-
-            vk_command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            vk_command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            VkResult res = vkBeginCommandBuffer(vk_command_buffer, &vk_command_buffer_begin_info);
-            CHECK_VK_ERROR(res);
+            // The copy is recorded into the current upload batch instead of being submitted and waited for here,
+            // so loading many textures doesn't stall on the GPU once per texture (or mipmap).
+            uint32_t stage_offset;
+            TextureUploadBatch* batch         = GetTextureUploadBatch(context, texDataSize, GetTextureUploadAlignment(params.m_Format), &stage_offset);
+            VkCommandBuffer vk_command_buffer = batch->m_CommandBuffer;
 
-            VkSubmitInfo vk_submit_info;
-            memset(&vk_submit_info, 0, sizeof(vk_submit_info));
-            vk_submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            vk_submit_info.commandBufferCount = 1;
-            vk_submit_info.pCommandBuffers    = &vk_command_buffer;
-
-            DeviceBuffer stage_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-
-            res = CreateDeviceBuffer(context->m_PhysicalDevice.m_Device, vk_device, texDataSize,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stage_buffer);
-            CHECK_VK_ERROR(res);
-
-            res = WriteToDeviceBuffer(vk_device, texDataSize, 0, texDataPtr, &stage_buffer);
-            CHECK_VK_ERROR(res);
+            memcpy((uint8_t*) batch->m_DeviceBuffer.m_MappedDataPtr + stage_offset, texDataPtr, texDataSize);
 
             // Transition image to transfer dst for the mipmap level we are uploading
-            res = TransitionImageLayout(vk_device, context->m_LogicalDevice.m_CommandPool, context->m_LogicalDevice.m_GraphicsQueue,
-                textureOut->m_Handle.m_Image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                params.m_MipMap, layer_count);
-            CHECK_VK_ERROR(res);
+            CmdTransitionImageLayout(vk_command_buffer, textureOut->m_Handle.m_Image, VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, params.m_MipMap, layer_count);
 
             // NOTE: We should check max layer count in the device properties!
             VkBufferImageCopy* vk_copy_regions = new VkBufferImageCopy[layer_count];
             for (int i = 0; i < layer_count; ++i)
             {
                 VkBufferImageCopy& vk_copy_region = vk_copy_regions[i];
-                vk_copy_region.bufferOffset                    = i * slice_size;
+                vk_copy_region.bufferOffset                    = stage_offset + i * slice_size;
                 vk_copy_region.bufferRowLength                 = 0;
                 vk_copy_region.bufferImageHeight               = 0;
                 vk_copy_region.imageOffset.x                   = params.m_X;
@@ -3386,26 +3774,12 @@ bail:
                 vk_copy_region.imageSubresource.layerCount     = 1;
             }
 
-            vkCmdCopyBufferToImage(vk_command_buffer, stage_buffer.m_Handle.m_Buffer,
+            vkCmdCopyBufferToImage(vk_command_buffer, batch->m_DeviceBuffer.m_Handle.m_Buffer,
                 textureOut->m_Handle.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 layer_count, vk_copy_regions);
 
-            res = vkEndCommandBuffer(vk_command_buffer);
-            CHECK_VK_ERROR(res);
-
-            res = vkQueueSubmit(context->m_LogicalDevice.m_GraphicsQueue, 1, &vk_submit_info, VK_NULL_HANDLE);
-            CHECK_VK_ERROR(res);
-
-            vkQueueWaitIdle(context->m_LogicalDevice.m_GraphicsQueue);
-
-            res = TransitionImageLayout(vk_device, context->m_LogicalDevice.m_CommandPool, context->m_LogicalDevice.m_GraphicsQueue,
-                textureOut->m_Handle.m_Image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                params.m_MipMap, layer_count);
-            CHECK_VK_ERROR(res);
-
-            DestroyDeviceBuffer(vk_device, &stage_buffer.m_Handle);
-
-            vkFreeCommandBuffers(vk_device, context->m_LogicalDevice.m_CommandPool, 1, &vk_command_buffer);
+            CmdTransitionImageLayout(vk_command_buffer, textureOut->m_Handle.m_Image, VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, params.m_MipMap, layer_count);
 
             delete[] vk_copy_regions;
         }
@@ -3567,6 +3941,11 @@ bail:
 
         context->m_PipelineCache.Iterate(DestroyPipelineCacheCb, context);
 
+        SaveDriverPipelineCache(context);
+        DestroyPipelineCache(vk_device, &context->m_DriverPipelineCache);
+
+        DestroyTextureUploadBatches(context);
+
         DestroyDeviceBuffer(vk_device, &context->m_MainTextureDepthStencil.m_DeviceBuffer.m_Handle);
         DestroyTexture(vk_device, &context->m_MainTextureDepthStencil.m_Handle);
         DestroyTexture(vk_device, &context->m_DefaultTexture2D->m_Handle);
@@ -3792,6 +4171,40 @@ bail:
         return false;
     }
 
+    static void VulkanPrewarmPipeline(HContext _context, HProgram program, HVertexDeclaration vertex_declaration, HRenderTarget render_target, const PipelineState& pipeline_state)
+    {
+        VulkanContext* context = (VulkanContext*) _context;
+        if (!context->m_WindowOpened)
+        {
+            return;
+        }
+
+        if (render_target == 0x0)
+        {
+            render_target = context->m_MainRenderTarget;
+        }
+
+        Program* program_ptr = (Program*) program;
+        RenderTarget* rt     = GetAssetFromContainer<RenderTarget>(context->m_AssetHandleContainer, render_target);
+
+        VkSampleCountFlagBits vk_sample_count = VK_SAMPLE_COUNT_1_BIT;
+        if (rt->m_Id == DM_RENDERTARGET_BACKBUFFER_ID)
+        {
+            vk_sample_count = context->m_SwapChain->m_SampleCountFlag;
+        }
+
+        // Use the same declaration as EnableVertexDeclaration with a program would, otherwise the
+        // prewarmed pipeline could end up with different vertex inputs than the one used when drawing
+        VertexDeclaration program_declaration;
+        FillProgramVertexDeclaration(program_ptr, vertex_declaration, &program_declaration);
+
+        uint64_t pipeline_hash = GetPipelineHash(vk_sample_count, pipeline_state, program_ptr, rt, &program_declaration);
+        GetOrCreatePipeline(context, pipeline_hash, vk_sample_count, pipeline_state, program_ptr, rt, &program_declaration);
+
+        // Adding to the pipeline cache can move its entries, so make sure the next draw call looks the pipeline up again
+        context->m_CurrentPipeline = 0;
+    }
+
     static GraphicsAdapterFunctionTable VulkanRegisterFunctionTable()
     {
         GraphicsAdapterFunctionTable fn_table = {};
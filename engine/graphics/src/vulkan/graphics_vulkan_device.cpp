@@ -326,22 +326,10 @@ namespace dmGraphics
         return vk_count_bits[dmMath::Min<uint8_t>(sample_count_index_requested, sample_count_index_max)];
     }
 
-    VkResult TransitionImageLayout(VkDevice vk_device, VkCommandPool vk_command_pool, VkQueue vk_graphics_queue, VkImage vk_image,
+    void CmdTransitionImageLayout(VkCommandBuffer vk_command_buffer, VkImage vk_image,
         VkImageAspectFlags vk_image_aspect, VkImageLayout vk_from_layout, VkImageLayout vk_to_layout,
         uint32_t baseMipLevel, uint32_t layer_count)
     {
-        // Create a one-time-execute command buffer that will only be used for the transition
-        VkCommandBuffer vk_command_buffer;
-        CreateCommandBuffers(vk_device, vk_command_pool, 1, &vk_command_buffer);
-
-        VkCommandBufferBeginInfo vk_command_buffer_begin_info;
-        memset(&vk_command_buffer_begin_info, 0, sizeof(VkCommandBufferBeginInfo));
-
-        vk_command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        vk_command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        vkBeginCommandBuffer(vk_command_buffer, &vk_command_buffer_begin_info);
-
         VkImageMemoryBarrier vk_memory_barrier;
         memset(&vk_memory_barrier, 0, sizeof(vk_memory_barrier));
 
@@ -417,6 +405,25 @@ namespace dmGraphics
             vk_destination_stage,
             0, 0, 0, 0, 0, 1,
             &vk_memory_barrier);
+    }
+
+    VkResult TransitionImageLayout(VkDevice vk_device, VkCommandPool vk_command_pool, VkQueue vk_graphics_queue, VkImage vk_image,
+        VkImageAspectFlags vk_image_aspect, VkImageLayout vk_from_layout, VkImageLayout vk_to_layout,
+        uint32_t baseMipLevel, uint32_t layer_count)
+    {
+        // Create a one-time-execute command buffer that will only be used for the transition
+        VkCommandBuffer vk_command_buffer;
+        CreateCommandBuffers(vk_device, vk_command_pool, 1, &vk_command_buffer);
+
+        VkCommandBufferBeginInfo vk_command_buffer_begin_info;
+        memset(&vk_command_buffer_begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+
+        vk_command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vk_command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(vk_command_buffer, &vk_command_buffer_begin_info);
+
+        CmdTransitionImageLayout(vk_command_buffer, vk_image, vk_image_aspect, vk_from_layout, vk_to_layout, baseMipLevel, layer_count);
 
         vkEndCommandBuffer(vk_command_buffer);
 
@@ -959,7 +966,7 @@ bail:
         VK_COMPARE_OP_ALWAYS
     };
 
-    VkResult CreatePipeline(VkDevice vk_device, VkRect2D vk_scissor, VkSampleCountFlagBits vk_sample_count,
+    VkResult CreatePipeline(VkDevice vk_device, VkPipelineCache vk_pipeline_cache, VkRect2D vk_scissor, VkSampleCountFlagBits vk_sample_count,
         PipelineState pipelineState, Program* program, HVertexDeclaration vertexDeclaration,
         RenderTarget* render_target, Pipeline* pipelineOut)
     {
@@ -1135,7 +1142,44 @@ bail:
         vk_pipeline_info.basePipelineHandle  = VK_NULL_HANDLE;
         vk_pipeline_info.basePipelineIndex   = -1;
 
-        return vkCreateGraphicsPipelines(vk_device, VK_NULL_HANDLE, 1, &vk_pipeline_info, 0, pipelineOut);
+        return vkCreateGraphicsPipelines(vk_device, vk_pipeline_cache, 1, &vk_pipeline_info, 0, pipelineOut);
+    }
+
+    bool IsPipelineCacheDataCompatible(const VkPhysicalDeviceProperties& vk_properties, const void* data, uint32_t dataSize)
+    {
+        // The data starts with a VkPipelineCacheHeaderVersionOne, which the driver uses to identify
+        // its own caches. Some drivers crash on foreign data instead of rejecting it, so we check it ourselves.
+        const uint32_t header_size = 16 + VK_UUID_SIZE;
+        if (data == 0 || dataSize < header_size)
+        {
+            return false;
+        }
+
+        uint32_t header[4];
+        memcpy(header, data, sizeof(header));
+
+        return header[0] >= header_size &&
+               header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header[2] == vk_properties.vendorID &&
+               header[3] == vk_properties.deviceID &&
+               memcmp((const uint8_t*) data + 16, vk_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkResult CreatePipelineCache(VkDevice vk_device, const VkPhysicalDeviceProperties& vk_properties, const void* initialData, uint32_t initialDataSize, VkPipelineCache* vk_pipeline_cache_out)
+    {
+        assert(vk_pipeline_cache_out && *vk_pipeline_cache_out == VK_NULL_HANDLE);
+
+        VkPipelineCacheCreateInfo vk_pipeline_cache_create_info;
+        memset(&vk_pipeline_cache_create_info, 0, sizeof(vk_pipeline_cache_create_info));
+        vk_pipeline_cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        if (IsPipelineCacheDataCompatible(vk_properties, initialData, initialDataSize))
+        {
+            vk_pipeline_cache_create_info.initialDataSize = initialDataSize;
+            vk_pipeline_cache_create_info.pInitialData    = initialData;
+        }
+
+        return vkCreatePipelineCache(vk_device, &vk_pipeline_cache_create_info, 0, vk_pipeline_cache_out);
     }
 
     void ResetScratchBuffer(VkDevice vk_device, ScratchBuffer* scratchBuffer)
@@ -1265,6 +1309,17 @@ bail:
         }
     }
 
+    void DestroyPipelineCache(VkDevice vk_device, VkPipelineCache* vk_pipeline_cache)
+    {
+        assert(vk_pipeline_cache);
+
+        if (*vk_pipeline_cache != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineCache(vk_device, *vk_pipeline_cache, 0);
+            *vk_pipeline_cache = VK_NULL_HANDLE;
+        }
+    }
+
     #define QUEUE_FAMILY_INVALID 0xffff
 
     // All GPU operations are pushed to various queues. The physical device can have multiple
@@ -110,6 +110,7 @@ extern PFN_vkDestroyRenderPass vkDestroyRenderPass;
 extern PFN_vkDestroyFramebuffer vkDestroyFramebuffer;
 extern PFN_vkDestroyShaderModule vkDestroyShaderModule;
 extern PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+extern PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 extern PFN_vkCreateQueryPool vkCreateQueryPool;
 extern PFN_vkDestroyQueryPool vkDestroyQueryPool;
 extern PFN_vkGetQueryPoolResults vkGetQueryPoolResults;
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <dlib/hashtable.h>
 #include <dlib/opaque_handle_container.h>
+#include <dlib/path.h>
 
 #include "../graphics_private.h"
 
@@ -33,6 +34,7 @@ namespace dmGraphics
     const static uint8_t DM_MAX_TEXTURE_UNITS          = 32;
     const static uint8_t DM_RENDERTARGET_BACKBUFFER_ID = 0;
     static const uint8_t DM_MAX_FRAMES_IN_FLIGHT       = 2; // In flight frames - number of concurrent frames being processed
+    static const uint8_t DM_MAX_TEXTURE_UPLOAD_BATCHES = 3; // Number of staging areas texture uploads rotate through
 
     enum VulkanResourceType
     {
@@ -159,6 +161,18 @@ namespace dmGraphics
         uint32_t             m_MappedDataCursor;
     };
 
+    // Texture uploads are copied into a persistently mapped staging buffer and recorded into one
+    // command buffer, which is submitted before the frame that uses them (or when the buffer is full).
+    struct TextureUploadBatch
+    {
+        DeviceBuffer    m_DeviceBuffer;
+        VkCommandBuffer m_CommandBuffer;
+        VkFence         m_SubmitFence;
+        uint32_t        m_MappedDataCursor;
+        uint32_t        m_Recording : 1;
+        uint32_t                    : 31;
+    };
+
     struct RenderTarget
     {
     	RenderTarget(const uint32_t rtId);
@@ -350,6 +364,8 @@ namespace dmGraphics
         dmOpaqueHandleContainer<uintptr_t> m_AssetHandleContainer;
         PipelineCache                   m_PipelineCache;
         PipelineState                   m_PipelineState;
+        VkPipelineCache                 m_DriverPipelineCache;
+        char                            m_DriverPipelineCachePath[DMPATH_MAX_PATH]; // Empty if the driver pipeline cache isn't saved
         SwapChain*                      m_SwapChain;
         SwapChainCapabilities           m_SwapChainCapabilities;
         PhysicalDevice                  m_PhysicalDevice;
@@ -376,10 +392,13 @@ namespace dmGraphics
         ResourcesToDestroyList*         m_MainResourcesToDestroy[3];
         dmArray<ScratchBuffer>          m_MainScratchBuffers;
         dmArray<DescriptorAllocator>    m_MainDescriptorAllocators;
+        TextureUploadBatch              m_TextureUploadBatches[DM_MAX_TEXTURE_UPLOAD_BATCHES];
+        uint8_t                         m_TextureUploadBatchIndex;
         VkRenderPass                    m_MainRenderPass;
         VulkanTexture                   m_MainTextureDepthStencil;
         HRenderTarget                   m_MainRenderTarget;
         Viewport                        m_MainViewport;
+        Viewport                        m_MainScissor;
         VertexDeclaration               m_MainVertexDeclaration;
         // Rendering state
         HRenderTarget                   m_CurrentRenderTarget;
@@ -387,6 +406,9 @@ namespace dmGraphics
         VertexDeclaration*              m_CurrentVertexDeclaration;
         Program*                        m_CurrentProgram;
         Pipeline*                       m_CurrentPipeline;
+        // Key for the current pipeline, only rehashed when the state it was made from changes
+        uint64_t                        m_PipelineHash;
+        PipelineState                   m_PipelineHashState;
         // Misc state
         TextureFilter                   m_DefaultTextureMinFilter;
         TextureFilter                   m_DefaultTextureMagFilter;
@@ -407,7 +429,11 @@ namespace dmGraphics
         uint32_t                        m_CullFaceChanged      : 1;
         uint32_t                        m_UseValidationLayers  : 1;
         uint32_t                        m_RenderDocSupport     : 1;
-        uint32_t                                               : 24;
+        uint32_t                        m_PipelineHashDirty    : 1;
+        uint32_t                        m_DriverCacheDirty     : 1;
+        uint32_t                        m_ScissorChanged       : 1;
+        uint32_t                        m_ScissorTestEnabled   : 1;
+        uint32_t                                               : 20;
     };
 
     // Implemented in graphics_vulkan_context.cpp
@@ -438,7 +464,8 @@ namespace dmGraphics
     VkResult CreateRenderPass(VkDevice vk_device, VkSampleCountFlagBits vk_sample_flags, RenderPassAttachment* colorAttachments, uint8_t numColorAttachments, RenderPassAttachment* depthStencilAttachment, RenderPassAttachment* resolveAttachment, VkRenderPass* renderPassOut);
     VkResult CreateDeviceBuffer(VkPhysicalDevice vk_physical_device, VkDevice vk_device, VkDeviceSize vk_size, VkMemoryPropertyFlags vk_memory_flags, DeviceBuffer* bufferOut);
     VkResult CreateShaderModule(VkDevice vk_device, const void* source, uint32_t sourceSize, ShaderModule* shaderModuleOut);
-    VkResult CreatePipeline(VkDevice vk_device, VkRect2D vk_scissor, VkSampleCountFlagBits vk_sample_count, const PipelineState pipelineState, Program* program, HVertexDeclaration vertexDeclaration, RenderTarget* render_target, Pipeline* pipelineOut);
+    VkResult CreatePipeline(VkDevice vk_device, VkPipelineCache vk_pipeline_cache, VkRect2D vk_scissor, VkSampleCountFlagBits vk_sample_count, const PipelineState pipelineState, Program* program, HVertexDeclaration vertexDeclaration, RenderTarget* render_target, Pipeline* pipelineOut);
+    VkResult CreatePipelineCache(VkDevice vk_device, const VkPhysicalDeviceProperties& vk_properties, const void* initialData, uint32_t initialDataSize, VkPipelineCache* vk_pipeline_cache_out);
 
     // Destroy functions
     void DestroyDeviceBuffer(VkDevice vk_device, DeviceBuffer::VulkanHandle* handle);
@@ -447,6 +474,7 @@ namespace dmGraphics
     void DestroyLogicalDevice(LogicalDevice* device);
     void DestroyPhysicalDevice(PhysicalDevice* device);
     void DestroyPipeline(VkDevice vk_device, Pipeline* pipeline);
+    void DestroyPipelineCache(VkDevice vk_device, VkPipelineCache* vk_pipeline_cache);
     void DestroyProgram(VkDevice vk_device, Program::VulkanHandle* handle);
     void DestroyRenderPass(VkDevice vk_device, VkRenderPass render_pass);
     void DestroyScratchBuffer(VkDevice vk_device, ScratchBuffer* scratchBuffer);
@@ -465,8 +493,10 @@ namespace dmGraphics
 
     // Misc functions
     VkResult TransitionImageLayout(VkDevice vk_device, VkCommandPool vk_command_pool, VkQueue vk_graphics_queue, VkImage vk_image, VkImageAspectFlags vk_image_aspect, VkImageLayout vk_from_layout, VkImageLayout vk_to_layout, uint32_t baseMipLevel = 0, uint32_t layer_count = 1);
+    void     CmdTransitionImageLayout(VkCommandBuffer vk_command_buffer, VkImage vk_image, VkImageAspectFlags vk_image_aspect, VkImageLayout vk_from_layout, VkImageLayout vk_to_layout, uint32_t baseMipLevel = 0, uint32_t layer_count = 1);
     VkResult WriteToDeviceBuffer(VkDevice vk_device, VkDeviceSize size, VkDeviceSize offset, const void* data, DeviceBuffer* buffer);
     void     DestroyPipelineCacheCb(VulkanContext* context, const uint64_t* key, Pipeline* value);
+    bool     IsPipelineCacheDataCompatible(const VkPhysicalDeviceProperties& vk_properties, const void* data, uint32_t dataSize);
     void     FlushResourcesToDestroy(VkDevice vk_device, ResourcesToDestroyList* resource_list);
     void     ResetScratchBuffer(VkDevice vk_device, ScratchBuffer* scratchBuffer);
 
@@ -481,6 +511,18 @@ namespace dmGraphics
     bool InitializeVulkan(HContext context, const WindowParams* params);
     void InitializeVulkanTexture(VulkanTexture* t);
 
+    // Creates the driver pipeline cache, with the data saved by an earlier run if it's valid for the device
+    VkResult CreateDriverPipelineCache(VulkanContext* context);
+    // Saves the driver pipeline cache, if pipelines were added to it since it was created
+    void     SaveDriverPipelineCache(VulkanContext* context);
+
+    // Texture upload batches, the staging ring used by CopyToTexture
+    VkResult            CreateTextureUploadBatches(VulkanContext* context, uint32_t buffer_size);
+    void                DestroyTextureUploadBatches(VulkanContext* context);
+    void                SubmitTextureUploads(VulkanContext* context);
+    uint32_t            GetTextureUploadAlignment(TextureFormat format);
+    TextureUploadBatch* GetTextureUploadBatch(VulkanContext* context, uint32_t size, uint32_t alignment, uint32_t* offset_out);
+
     void OnWindowResize(int width, int height);
     int  OnWindowClose();
     void OnWindowFocus(int focus);
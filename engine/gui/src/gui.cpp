@@ -21,11 +21,13 @@
 #include <dlib/dlib.h>
 #include <dlib/array.h>
 #include <dlib/dstrings.h>
+#include <dlib/frame_arena.h>
 #include <dlib/index_pool.h>
 #include <dlib/log.h>
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dlib/vmath.h>
 #include <dlib/transform.h>
 #include <dlib/message.h>
@@ -68,6 +70,9 @@ namespace dmGui
 
     const uint32_t INITIAL_SCENE_COUNT = 32;
 
+    // The pick index grid has at most this many columns and rows
+    const uint32_t MAX_PICK_GRID_SIZE = 32;
+
     // Currently not used, here for reference only
     // const uint64_t LAYER_RANGE = 8; // 256 layers
     const uint64_t INDEX_RANGE = 24; // 16777216 nodes
@@ -188,6 +193,7 @@ namespace dmGui
         context->m_Dpi = params->m_Dpi;
         context->m_Scenes.SetCapacity(INITIAL_SCENE_COUNT);
         context->m_ScratchBoneNodes.SetCapacity(32);
+        context->m_MemoryTag = dmMemory::RegisterTag("gui");
 
         return context;
     }
@@ -220,6 +226,7 @@ namespace dmGui
         scene->m_Width = width;
         scene->m_Height = height;
         scene->m_ResChanged = 1;
+        scene->m_PickIndexDirty = 1;
     }
 
     void GetPhysicalResolution(HScene scene, uint32_t& width, uint32_t& height)
@@ -244,6 +251,7 @@ namespace dmGui
         {
             Scene* scene = scenes[i];
             scene->m_ResChanged = 1;
+            scene->m_PickIndexDirty = 1;
             if(scene->m_OnWindowResizeCallback)
             {
                 scene->m_OnWindowResizeCallback(scene, width, height);
@@ -281,6 +289,7 @@ namespace dmGui
     void SetSceneAdjustReference(HScene scene, AdjustReference adjust_reference)
     {
         scene->m_AdjustReference = adjust_reference;
+        scene->m_PickIndexDirty = 1;
     }
 
     void SetDefaultNewSceneParams(NewSceneParams* params)
@@ -306,6 +315,14 @@ namespace dmGui
         scene->m_ContextTableReference = LUA_NOREF;
     }
 
+    // The fixed size node and animation storage of a scene, which is what scales with the scene settings
+    static uint32_t GetSceneMemorySize(HScene scene)
+    {
+        return sizeof(Scene) + scene->m_Nodes.Capacity() * sizeof(InternalNode)
+                             + scene->m_Animations.Capacity() * sizeof(Animation)
+                             + scene->m_AliveParticlefxs.Capacity() * sizeof(ParticlefxComponent);
+    }
+
     HScene NewScene(HContext context, const NewSceneParams* params)
     {
         lua_State* L = context->m_LuaState;
@@ -348,6 +365,7 @@ namespace dmGui
         scene->m_AliveParticlefxs.SetCapacity(params->m_MaxParticlefx);
         scene->m_Layers.SetCapacity(params->m_MaxLayers*2, params->m_MaxLayers);
         scene->m_Layouts.SetCapacity(1);
+        dmMemory::TrackAlloc(context->m_MemoryTag, GetSceneMemorySize(scene));
         scene->m_AdjustReference = params->m_AdjustReference;
         scene->m_DefaultFont = 0;
         scene->m_UserData = params->m_UserData;
@@ -355,6 +373,7 @@ namespace dmGui
         scene->m_RenderTail = INVALID_INDEX;
         scene->m_NextVersionNumber = 0;
         scene->m_RenderOrder = 0;
+        scene->m_PickIndexDirty = 1;
         scene->m_Width = context->m_DefaultProjectWidth;
         scene->m_Height = context->m_DefaultProjectHeight;
         scene->m_FetchTextureSetAnimCallback = params->m_FetchTextureSetAnimCallback;
@@ -425,6 +444,8 @@ namespace dmGui
             }
         }
 
+        dmMemory::TrackFree(scene->m_Context->m_MemoryTag, GetSceneMemorySize(scene));
+
         scene->~Scene();
 
         ResetScene(scene);
@@ -833,6 +854,7 @@ namespace dmGui
             if (nodes[i].m_Node.m_LayerHash == layer_hash)
                 nodes[i].m_Node.m_LayerIndex = index;
         }
+        scene->m_PickIndexDirty = 1;
         return RESULT_OK;
     }
 
@@ -932,6 +954,7 @@ namespace dmGui
             set_node_callback(scene, GetNodeHandle(n), n->m_Node.m_NodeDescTable[index]);
             n->m_Node.m_DirtyLocal = 1;
         }
+        scene->m_PickIndexDirty = 1;
         return RESULT_OK;
     }
 
@@ -1009,7 +1032,8 @@ namespace dmGui
         return Vector4(scale_x, scale_y, 1.0f, 1.0f);
     }
 
-    inline void CalculateNodeSize(InternalNode* in)
+    // Returns true if the size of the node changed
+    inline bool CalculateNodeSize(InternalNode* in)
     {
         Node& n = in->m_Node;
         //TODO: Custom/ParticleFX shouldn't be singled out. It's the others that should be included
@@ -1017,9 +1041,12 @@ namespace dmGui
            n.m_NodeType == NODE_TYPE_PARTICLEFX || n.m_TextureType != NODE_TEXTURE_TYPE_TEXTURE_SET ||
            n.m_TextureSetAnimDesc.m_TexCoords == 0x0)
         {
-            return;
+            return false;
         }
 
+        float prev_width = n.m_Properties[PROPERTY_SIZE][0];
+        float prev_height = n.m_Properties[PROPERTY_SIZE][1];
+
         const float* tc = GetNodeFlipbookAnimUVInternal(in);
         TextureSetAnimDesc* anim_desc = &n.m_TextureSetAnimDesc;
 
@@ -1039,6 +1066,7 @@ namespace dmGui
             n.m_Properties[PROPERTY_SIZE][0] = w * (float)anim_desc->m_State.m_OriginalTextureWidth;
             n.m_Properties[PROPERTY_SIZE][1] = h * (float)anim_desc->m_State.m_OriginalTextureHeight;
         }
+        return n.m_Properties[PROPERTY_SIZE][0] != prev_width || n.m_Properties[PROPERTY_SIZE][1] != prev_height;
     }
 
     struct UpdateDynamicTexturesParams
@@ -1205,6 +1233,8 @@ namespace dmGui
     static void UpdateScope(InternalNode* node, StencilScope& scope, StencilScope& child_scope, const StencilScope* parent_scope, uint16_t index, uint16_t non_inv_clipper_count, uint16_t inv_clipper_count, uint16_t bit_field_offset) {
         int bit_range = CalcBitRange(non_inv_clipper_count);
         // state used for drawing the clipper
+        scope.m_Scissor = 0;
+        child_scope.m_Scissor = 0;
         scope.m_WriteMask = 0xff;
         scope.m_TestMask = 0;
         if (parent_scope != 0x0) {
@@ -1428,6 +1458,90 @@ namespace dmGui
         return n->m_Node.m_IsVisible && (opacity != 0.0f || use_clipping);
     }
 
+    // The stencil shape of an unrotated, non-inverted box is its rectangle.
+    // A textured box might be drawn with the trimmed geometry of its image though, unless it uses slice9
+    static bool IsScissorClipper(InternalNode* n, const Matrix4& transform)
+    {
+        const Node& node = n->m_Node;
+        if (node.m_ClippingInverted || node.m_NodeType != NODE_TYPE_BOX)
+            return false;
+
+        const Vector4& slice9 = node.m_Properties[PROPERTY_SLICE9];
+        bool use_slice_nine = slice9.getX() != 0.0f || slice9.getY() != 0.0f || slice9.getZ() != 0.0f || slice9.getW() != 0.0f;
+        if (node.m_TextureType == NODE_TEXTURE_TYPE_TEXTURE_SET && node.m_Texture != 0x0 && !use_slice_nine)
+            return false;
+
+        return transform.getElem(0, 1) == 0.0f && transform.getElem(1, 0) == 0.0f;
+    }
+
+    // Replaces the stencil scopes of clipper hierarchies with scissor rectangles where possible.
+    // The stencil values of a clipper depend on all of its parents, so a hierarchy either uses
+    // scissor rectangles for all of its clippers, or the stencil buffer for all of them.
+    static void UpdateScissorClippers(HScene scene, dmArray<InternalClippingNode>& clippers)
+    {
+        // Parents are always collected before their children
+        uint32_t clipper_count = clippers.Size();
+        for (uint32_t i = 0; i < clipper_count; ++i)
+        {
+            InternalClippingNode& clipper = clippers[i];
+            if (clipper.m_ParentIndex != INVALID_INDEX && !clippers[clipper.m_ParentIndex].m_ChildScope.m_Scissor)
+                continue;
+
+            InternalNode* n = &scene->m_Nodes[clipper.m_NodeIndex];
+            Matrix4 transform;
+            if (CalculateNodeSize(n))
+                scene->m_PickIndexDirty = 1;
+            CalculateNodeTransform(scene, n, CalculateNodeTransformFlags(CALCULATE_NODE_INCLUDE_SIZE | CALCULATE_NODE_RESET_PIVOT), transform);
+
+            StencilScope& scope = clipper.m_ChildScope;
+            scope.m_Scissor = IsScissorClipper(n, transform);
+            if (!scope.m_Scissor)
+                continue;
+
+            Vector4 p0 = transform * Point3(0.0f, 0.0f, 0.0f);
+            Vector4 p1 = transform * Point3(1.0f, 1.0f, 0.0f);
+            float* rect = scope.m_ScissorRect;
+            rect[0] = dmMath::Min(p0.getX(), p1.getX());
+            rect[1] = dmMath::Min(p0.getY(), p1.getY());
+            rect[2] = dmMath::Max(p0.getX(), p1.getX());
+            rect[3] = dmMath::Max(p0.getY(), p1.getY());
+            if (!n->m_Node.m_IsVisible)
+            {
+                // A hidden clipper doesn't write any stencil values, and thus clips everything
+                rect[2] = rect[0];
+                rect[3] = rect[1];
+            }
+
+            if (clipper.m_ParentIndex != INVALID_INDEX)
+            {
+                const float* parent_rect = clippers[clipper.m_ParentIndex].m_ChildScope.m_ScissorRect;
+                rect[0] = dmMath::Max(rect[0], parent_rect[0]);
+                rect[1] = dmMath::Max(rect[1], parent_rect[1]);
+                rect[2] = dmMath::Max(rect[0], dmMath::Min(rect[2], parent_rect[2]));
+                rect[3] = dmMath::Max(rect[1], dmMath::Min(rect[3], parent_rect[3]));
+            }
+        }
+
+        for (uint32_t i = clipper_count; i > 0; --i)
+        {
+            InternalClippingNode& clipper = clippers[i - 1];
+            if (!clipper.m_ChildScope.m_Scissor && clipper.m_ParentIndex != INVALID_INDEX)
+            {
+                clippers[clipper.m_ParentIndex].m_ChildScope.m_Scissor = 0;
+            }
+        }
+
+        for (uint32_t i = 0; i < clipper_count; ++i)
+        {
+            InternalClippingNode& clipper = clippers[i];
+            if (clipper.m_ParentIndex != INVALID_INDEX)
+            {
+                clipper.m_ChildScope.m_Scissor = clippers[clipper.m_ParentIndex].m_ChildScope.m_Scissor;
+            }
+            clipper.m_Scope.m_Scissor = clipper.m_ChildScope.m_Scissor;
+        }
+    }
+
     void RenderScene(HScene scene, const RenderSceneParams& params, void* context)
     {
         Context* c = scene->m_Context;
@@ -1436,22 +1550,14 @@ namespace dmGui
         DeferredDeleteDynamicTextures(scene, params, context);
 
         c->m_RenderNodes.SetSize(0);
-        c->m_RenderTransforms.SetSize(0);
-        c->m_RenderOpacities.SetSize(0);
         c->m_StencilClippingNodes.SetSize(0);
-        c->m_StencilScopes.SetSize(0);
-        c->m_StencilScopeIndices.SetSize(0);
         uint32_t capacity = scene->m_NodePool.Size() * 2;
         if (capacity > c->m_RenderNodes.Capacity())
         {
             c->m_RenderNodes.SetCapacity(capacity);
-            c->m_RenderTransforms.SetCapacity(capacity);
-            c->m_RenderOpacities.SetCapacity(capacity);
             c->m_SceneTraversalCache.m_Data.SetCapacity(capacity);
             c->m_SceneTraversalCache.m_Data.SetSize(capacity);
             c->m_StencilClippingNodes.SetCapacity(capacity);
-            c->m_StencilScopes.SetCapacity(capacity);
-            c->m_StencilScopeIndices.SetCapacity(capacity);
         }
 
         c->m_SceneTraversalCache.m_NodeIndex = 0;
@@ -1461,22 +1567,28 @@ namespace dmGui
         }
 
         CollectNodes(scene, c->m_StencilClippingNodes, c->m_RenderNodes);
+        if (params.m_ScissorClipping)
+        {
+            UpdateScissorClippers(scene, c->m_StencilClippingNodes);
+        }
         uint32_t node_count = c->m_RenderNodes.Size();
         std::sort(c->m_RenderNodes.Begin(), c->m_RenderNodes.End(), RenderEntrySortPred());
         Matrix4 transform;
 
-        if (c->m_RenderNodes.Capacity() > c->m_RenderTransforms.Capacity())
+        if (c->m_RenderNodes.Capacity() > c->m_SceneTraversalCache.m_Data.Capacity())
         {
             uint32_t new_capacity = c->m_RenderNodes.Capacity();
-            c->m_RenderTransforms.SetCapacity(new_capacity);
-            c->m_RenderOpacities.SetCapacity(new_capacity);
             c->m_SceneTraversalCache.m_Data.SetCapacity(new_capacity);
             c->m_SceneTraversalCache.m_Data.SetSize(new_capacity);
             c->m_StencilClippingNodes.SetCapacity(new_capacity);
-            c->m_StencilScopes.SetCapacity(new_capacity);
-            c->m_StencilScopeIndices.SetCapacity(new_capacity);
         }
 
+        // Only needed until the nodes have been rendered
+        Matrix4* render_transforms = dmFrameArena::Alloc<Matrix4>(node_count);
+        float* render_opacities = dmFrameArena::Alloc<float>(node_count);
+        const StencilScope** stencil_scopes = dmFrameArena::Alloc<const StencilScope*>(node_count);
+        uint32_t render_count = 0;
+
         uint32_t num_pruned = 0;
         for (uint32_t i = 0; i < node_count; ++i)
         {
@@ -1489,21 +1601,12 @@ namespace dmGui
             // but since the gui script is updated _after_ the gui component, we need to accomodate
             // for any late scripting changes
             // Note: We need this update step for bones as well, since they update their transform
-            CalculateNodeSize(n);
+            if (CalculateNodeSize(n))
+                scene->m_PickIndexDirty = 1;
             CalculateNodeTransformAndAlphaCached(scene, n, CalculateNodeTransformFlags(CALCULATE_NODE_INCLUDE_SIZE | CALCULATE_NODE_RESET_PIVOT), transform, opacity);
 
-            // Ideally, we'd like to have this update step in the Update function (I'm not even sure why it isn't tbh)
-            // But for now, let's prune the list here
-            if (!IsVisible(n, opacity) || n->m_Node.m_IsBone)
-            {
-                entry.m_Node = INVALID_HANDLE;
-                entry.m_RenderKey = INVALID_RENDER_KEY;
-                ++num_pruned;
-                continue;
-            }
-
-            c->m_RenderTransforms.Push(transform);
-            c->m_RenderOpacities.Push(opacity);
+            const StencilScope* stencil_scope = 0x0;
+            bool scissor_clipper = false;
             if (n->m_ClipperIndex != INVALID_INDEX) {
                 InternalClippingNode* clipper = &c->m_StencilClippingNodes[n->m_ClipperIndex];
                 if (clipper->m_NodeIndex == index) {
@@ -1512,16 +1615,30 @@ namespace dmGui
                         if (clipper->m_ParentIndex != INVALID_INDEX) {
                             scope = &c->m_StencilClippingNodes[clipper->m_ParentIndex].m_ChildScope;
                         }
-                        c->m_StencilScopes.Push(scope);
+                        stencil_scope = scope;
                     } else {
-                        c->m_StencilScopes.Push(&clipper->m_Scope);
+                        stencil_scope = &clipper->m_Scope;
+                        // Nothing is written to the stencil buffer when clipping with a scissor rectangle
+                        scissor_clipper = clipper->m_Scope.m_Scissor;
                     }
                 } else {
-                    c->m_StencilScopes.Push(&clipper->m_ChildScope);
+                    stencil_scope = &clipper->m_ChildScope;
                 }
-            } else {
-                c->m_StencilScopes.Push(0x0);
             }
+
+            // Ideally, we'd like to have this update step in the Update function (I'm not even sure why it isn't tbh)
+            // But for now, let's prune the list here
+            if (!IsVisible(n, opacity) || n->m_Node.m_IsBone || scissor_clipper)
+            {
+                entry.m_Node = INVALID_HANDLE;
+                entry.m_RenderKey = INVALID_RENDER_KEY;
+                ++num_pruned;
+                continue;
+            }
+
+            render_transforms[render_count] = transform;
+            render_opacities[render_count] = opacity;
+            stencil_scopes[render_count++] = stencil_scope;
         }
 
         if (num_pruned)
@@ -1531,7 +1648,7 @@ namespace dmGui
         }
 
         scene->m_ResChanged = 0;
-        params.m_RenderNodes(scene, c->m_RenderNodes.Begin(), c->m_RenderTransforms.Begin(), c->m_RenderOpacities.Begin(), (const StencilScope**)c->m_StencilScopes.Begin(), c->m_RenderNodes.Size(), context);
+        params.m_RenderNodes(scene, c->m_RenderNodes.Begin(), render_transforms, render_opacities, stencil_scopes, c->m_RenderNodes.Size(), context);
     }
 
     static bool IsNodeEnabledRecursive(HScene scene, uint16_t node_index)
@@ -1680,7 +1797,11 @@ namespace dmGui
 
                 *anim->m_Value = anim->m_From + (anim->m_To - anim->m_From) * x;
                 // Flag local transform as dirty for the node
-                scene->m_Nodes[anim->m_Node & 0xffff].m_Node.m_DirtyLocal = 1;
+                InternalNode* n = &scene->m_Nodes[anim->m_Node & 0xffff];
+                n->m_Node.m_DirtyLocal = 1;
+                // A flipbook animation changes the size of auto sized nodes
+                if (anim->m_AffectsPickBounds || (anim->m_Value == &n->m_Node.m_FlipbookAnimPosition && CalculateNodeSize(n)))
+                    scene->m_PickIndexDirty = 1;
 
                 // Animation complete, see above
                 if (t >= 1.0f)
@@ -2515,6 +2636,7 @@ namespace dmGui
 
     static void AddToNodeList(HScene scene, InternalNode* n, InternalNode* parent_n, InternalNode* prev_n)
     {
+        scene->m_PickIndexDirty = 1;
         uint16_t* head = &scene->m_RenderHead, * tail = &scene->m_RenderTail;
         uint16_t parent_index = INVALID_INDEX;
         if (parent_n != 0x0)
@@ -2559,6 +2681,7 @@ namespace dmGui
 
     static void RemoveFromNodeList(HScene scene, InternalNode* n)
     {
+        scene->m_PickIndexDirty = 1;
         // Remove from list
         if (n->m_PrevIndex != INVALID_INDEX)
             scene->m_Nodes[n->m_PrevIndex].m_NextIndex = n->m_NextIndex;
@@ -2679,6 +2802,7 @@ namespace dmGui
         scene->m_RenderTail = INVALID_INDEX;
         scene->m_NodePool.Clear();
         scene->m_Animations.SetSize(0);
+        scene->m_PickIndexDirty = 1;
     }
 
     static Vector4 ApplyAdjustOnReferenceScale(const Vector4& reference_scale, uint32_t adjust_mode)
@@ -2796,6 +2920,7 @@ namespace dmGui
             }
         }
         scene->m_Animations.SetSize(0);
+        scene->m_PickIndexDirty = 1;
     }
 
     uint16_t GetRenderOrder(HScene scene)
@@ -2852,6 +2977,7 @@ namespace dmGui
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_Properties[PROPERTY_POSITION] = Vector4(position);
         n->m_Node.m_DirtyLocal = 1;
+        scene->m_PickIndexDirty = 1;
     }
 
     bool HasPropertyHash(HScene scene, HNode node, dmhash_t property)
@@ -2890,6 +3016,7 @@ namespace dmGui
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_Properties[property] = value;
         n->m_Node.m_DirtyLocal = 1;
+        scene->m_PickIndexDirty = 1;
     }
 
     void SetNodeResetPoint(HScene scene, HNode node)
@@ -3012,6 +3139,7 @@ namespace dmGui
     Result SetNodeTexture(HScene scene, HNode node, dmhash_t texture_id)
     {
         InternalNode* n = GetNode(scene, node);
+        scene->m_PickIndexDirty = 1;
         if (n->m_Node.m_TextureType == NODE_TEXTURE_TYPE_TEXTURE_SET)
             CancelNodeFlipbookAnim(scene, node);
         if (TextureInfo* texture_info = scene->m_Textures.Get(texture_id)) {
@@ -3178,6 +3306,7 @@ namespace dmGui
             InternalNode* n = GetNode(scene, node);
             n->m_Node.m_LayerHash = layer_id;
             n->m_Node.m_LayerIndex = *layer_index;
+            scene->m_PickIndexDirty = 1;
             return RESULT_OK;
         }
         else
@@ -3350,6 +3479,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_ClippingMode = mode;
+        scene->m_PickIndexDirty = 1;
     }
 
     ClippingMode GetNodeClippingMode(HScene scene, HNode node)
@@ -3374,6 +3504,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_ClippingInverted = (uint32_t) inverted;
+        scene->m_PickIndexDirty = 1;
     }
 
     bool GetNodeClippingInverted(HScene scene, HNode node)
@@ -3421,6 +3552,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_XAnchor = (uint32_t) x_anchor;
+        scene->m_PickIndexDirty = 1;
     }
 
     YAnchor GetNodeYAnchor(HScene scene, HNode node)
@@ -3433,6 +3565,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_YAnchor = (uint32_t) y_anchor;
+        scene->m_PickIndexDirty = 1;
     }
 
 
@@ -3494,6 +3627,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_Pivot = (uint32_t) pivot;
+        scene->m_PickIndexDirty = 1;
     }
 
     bool GetNodeIsBone(HScene scene, HNode node)
@@ -3506,18 +3640,21 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_IsBone = is_bone;
+        scene->m_PickIndexDirty = 1;
     }
 
     void SetNodeAdjustMode(HScene scene, HNode node, AdjustMode adjust_mode)
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_AdjustMode = (uint32_t) adjust_mode;
+        scene->m_PickIndexDirty = 1;
     }
 
     void SetNodeSizeMode(HScene scene, HNode node, SizeMode size_mode)
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_SizeMode = (uint32_t) size_mode;
+        scene->m_PickIndexDirty = 1;
         if((n->m_Node.m_SizeMode != SIZE_MODE_MANUAL) && (n->m_Node.m_NodeType != NODE_TYPE_CUSTOM) && (n->m_Node.m_NodeType != NODE_TYPE_PARTICLEFX))
         {
             if (TextureInfo* texture_info = scene->m_Textures.Get(n->m_Node.m_TextureHash))
@@ -3542,6 +3679,16 @@ namespace dmGui
         return (SizeMode) n->m_Node.m_SizeMode;
     }
 
+    // Only the properties that move or resize the node need the pick index to be updated
+    static bool AffectsPickBounds(const Node& node, const float* value)
+    {
+        const float* properties = (const float*) node.m_Properties;
+        if (value < properties || value >= properties + PROPERTY_COUNT * 4)
+            return false;
+        uint32_t property = (uint32_t) (value - properties) / 4;
+        return property == PROPERTY_POSITION || property == PROPERTY_ROTATION || property == PROPERTY_SCALE || property == PROPERTY_SIZE;
+    }
+
     static Animation* AnimateComponent(HScene scene,
                                  HNode node,
                                  float* value,
@@ -3601,6 +3748,7 @@ namespace dmGui
         animation.m_AnimationCompleteCalled = 0;
         animation.m_Cancelled = 0;
         animation.m_Backwards = 0;
+        animation.m_AffectsPickBounds = AffectsPickBounds(n->m_Node, value);
 
         animation_index = InsertAnimation(scene->m_Animations, &animation);
         return &scene->m_Animations[animation_index];
@@ -3890,6 +4038,7 @@ namespace dmGui
             AnimateTextureSetAnim(scene, node, offset, playback_rate, anim_complete_callback, callback_userdata1, callback_userdata2);
         }
         CalculateNodeSize(n);
+        scene->m_PickIndexDirty = 1;
         return RESULT_OK;
     }
 
@@ -3949,6 +4098,279 @@ namespace dmGui
                 && node_pos.getY() <= 1.0f;
     }
 
+    static void CalculatePickQuad(const Matrix4& transform, PickQuad& quad)
+    {
+        static const float corners_x[] = {0.0f, 1.0f, 1.0f, 0.0f};
+        static const float corners_y[] = {0.0f, 0.0f, 1.0f, 1.0f};
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            Vector4 p = transform * Point3(corners_x[i], corners_y[i], 0.0f);
+            quad.m_X[i] = p.getX();
+            quad.m_Y[i] = p.getY();
+        }
+    }
+
+    static void GetPickQuadBounds(const PickQuad& quad, float& min_x, float& min_y, float& max_x, float& max_y)
+    {
+        min_x = dmMath::Min(dmMath::Min(quad.m_X[0], quad.m_X[1]), dmMath::Min(quad.m_X[2], quad.m_X[3]));
+        min_y = dmMath::Min(dmMath::Min(quad.m_Y[0], quad.m_Y[1]), dmMath::Min(quad.m_Y[2], quad.m_Y[3]));
+        max_x = dmMath::Max(dmMath::Max(quad.m_X[0], quad.m_X[1]), dmMath::Max(quad.m_X[2], quad.m_X[3]));
+        max_y = dmMath::Max(dmMath::Max(quad.m_Y[0], quad.m_Y[1]), dmMath::Max(quad.m_Y[2], quad.m_Y[3]));
+    }
+
+    // The quad is a parallelogram (the projection of the node rectangle onto the screen), so the point is
+    // inside if it is on the same side of all the edges. Points on the edges are inside, same as for PickNode.
+    static bool IsPointInPickQuad(const PickQuad& quad, float x, float y)
+    {
+        // Also rejects points in line with quads without area, where all the cross products are zero
+        float min_x, min_y, max_x, max_y;
+        GetPickQuadBounds(quad, min_x, min_y, max_x, max_y);
+        if (x < min_x || x > max_x || y < min_y || y > max_y)
+            return false;
+
+        bool positive = false;
+        bool negative = false;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            uint32_t j = (i + 1) & 3;
+            float cross = (quad.m_X[j] - quad.m_X[i]) * (y - quad.m_Y[i]) - (quad.m_Y[j] - quad.m_Y[i]) * (x - quad.m_X[i]);
+            positive |= cross > 0.0f;
+            negative |= cross < 0.0f;
+        }
+        return !(positive && negative);
+    }
+
+    static bool IsPointClipped(const PickIndex& index, uint16_t clipper_index, float x, float y)
+    {
+        while (clipper_index != INVALID_INDEX)
+        {
+            const PickClipper& clipper = index.m_Clippers[clipper_index];
+            if (IsPointInPickQuad(clipper.m_Quad, x, y) == (bool) clipper.m_Inverted)
+                return true;
+            clipper_index = clipper.m_ParentIndex;
+        }
+        return false;
+    }
+
+    // Collects the pickable nodes in render order, see CollectRenderEntries
+    static uint16_t CollectPickEntries(HScene scene, uint16_t start_index, const Matrix4* parent_transform, uint16_t clipper_index, uint16_t order)
+    {
+        PickIndex& pick_index = scene->m_PickIndex;
+        uint16_t index = start_index;
+        while (index != INVALID_INDEX)
+        {
+            InternalNode* n = &scene->m_Nodes[index];
+            index = n->m_NextIndex;
+            Node& node = n->m_Node;
+            if (!node.m_Enabled)
+                continue;
+
+            if (node.m_DirtyLocal || (scene->m_ResChanged && scene->m_AdjustReference != ADJUST_REFERENCE_DISABLED))
+            {
+                UpdateLocalTransform(scene, n);
+            }
+            CalculateNodeSize(n);
+
+            // Same transform as PickNode
+            Matrix4 quad_transform = node.m_LocalTransform;
+            CalculateNodeExtents(node, CalculateNodeTransformFlags(CALCULATE_NODE_BOUNDARY | CALCULATE_NODE_INCLUDE_SIZE | CALCULATE_NODE_RESET_PIVOT), quad_transform);
+            Matrix4 transform = node.m_LocalTransform;
+            if (parent_transform != 0x0)
+            {
+                quad_transform = *parent_transform * quad_transform;
+                transform = *parent_transform * transform;
+            }
+
+            PickQuad quad;
+            CalculatePickQuad(quad_transform, quad);
+
+            if (node.m_IsVisible && !node.m_IsBone)
+            {
+                PickEntry entry;
+                entry.m_Quad = quad;
+                entry.m_Order = ((uint32_t) GetLayerIndex(scene, n) << 16) | order;
+                entry.m_NodeIndex = n->m_Index;
+                entry.m_ClipperIndex = clipper_index;
+                if (pick_index.m_Entries.Full())
+                    pick_index.m_Entries.OffsetCapacity(16);
+                pick_index.m_Entries.Push(entry);
+            }
+            ++order;
+
+            uint16_t child_clipper_index = clipper_index;
+            if (node.m_ClippingMode == CLIPPING_MODE_STENCIL)
+            {
+                if (node.m_IsVisible)
+                {
+                    PickClipper clipper;
+                    clipper.m_Quad = quad;
+                    clipper.m_ParentIndex = clipper_index;
+                    clipper.m_Inverted = node.m_ClippingInverted;
+                    child_clipper_index = (uint16_t) pick_index.m_Clippers.Size();
+                    if (pick_index.m_Clippers.Full())
+                        pick_index.m_Clippers.OffsetCapacity(16);
+                    pick_index.m_Clippers.Push(clipper);
+                }
+                else if (!node.m_ClippingInverted)
+                {
+                    // A hidden clipper is never drawn to the stencil buffer, so all of its children are clipped
+                    continue;
+                }
+            }
+
+            order = CollectPickEntries(scene, n->m_ChildHead, &transform, child_clipper_index, order);
+        }
+        return order;
+    }
+
+    struct PickEntrySortPred
+    {
+        bool operator ()(const PickEntry& a, const PickEntry& b) const
+        {
+            return a.m_Order < b.m_Order;
+        }
+    };
+
+    static void GetPickCellRange(const PickIndex& index, float min_x, float min_y, float max_x, float max_y, uint32_t& column_start, uint32_t& row_start, uint32_t& column_end, uint32_t& row_end)
+    {
+        column_start = dmMath::Min((uint32_t) dmMath::Max((min_x - index.m_MinX) * index.m_InvCellWidth, 0.0f), index.m_Columns - 1u);
+        row_start = dmMath::Min((uint32_t) dmMath::Max((min_y - index.m_MinY) * index.m_InvCellHeight, 0.0f), index.m_Rows - 1u);
+        column_end = dmMath::Min((uint32_t) dmMath::Max((max_x - index.m_MinX) * index.m_InvCellWidth, 0.0f), index.m_Columns - 1u);
+        row_end = dmMath::Min((uint32_t) dmMath::Max((max_y - index.m_MinY) * index.m_InvCellHeight, 0.0f), index.m_Rows - 1u);
+    }
+
+    static void UpdatePickIndex(HScene scene)
+    {
+        DM_PROFILE(__FUNCTION__);
+
+        PickIndex& index = scene->m_PickIndex;
+        index.m_Entries.SetSize(0);
+        index.m_Clippers.SetSize(0);
+        index.m_Columns = 0;
+        index.m_Rows = 0;
+        scene->m_PickIndexDirty = 0;
+
+        CollectPickEntries(scene, scene->m_RenderHead, 0x0, INVALID_INDEX, 0);
+        uint32_t entry_count = index.m_Entries.Size();
+        if (entry_count == 0)
+        {
+            return;
+        }
+        std::sort(index.m_Entries.Begin(), index.m_Entries.End(), PickEntrySortPred());
+
+        float min_x, min_y, max_x, max_y;
+        GetPickQuadBounds(index.m_Entries[0].m_Quad, min_x, min_y, max_x, max_y);
+        for (uint32_t i = 1; i < entry_count; ++i)
+        {
+            float entry_min_x, entry_min_y, entry_max_x, entry_max_y;
+            GetPickQuadBounds(index.m_Entries[i].m_Quad, entry_min_x, entry_min_y, entry_max_x, entry_max_y);
+            min_x = dmMath::Min(min_x, entry_min_x);
+            min_y = dmMath::Min(min_y, entry_min_y);
+            max_x = dmMath::Max(max_x, entry_max_x);
+            max_y = dmMath::Max(max_y, entry_max_y);
+        }
+
+        // Roughly one entry per cell
+        uint32_t grid_size = dmMath::Clamp((uint32_t) sqrtf((float) entry_count), 1u, MAX_PICK_GRID_SIZE);
+        index.m_Columns = (uint16_t) grid_size;
+        index.m_Rows = (uint16_t) grid_size;
+        index.m_MinX = min_x;
+        index.m_MinY = min_y;
+        index.m_InvCellWidth = max_x > min_x ? grid_size / (max_x - min_x) : 0.0f;
+        index.m_InvCellHeight = max_y > min_y ? grid_size / (max_y - min_y) : 0.0f;
+
+        // Count the entries per cell, offset by one so that the prefix sum gives the start of each cell
+        uint32_t cell_count = grid_size * grid_size;
+        if (index.m_CellStarts.Capacity() < cell_count + 1)
+            index.m_CellStarts.SetCapacity(cell_count + 1);
+        index.m_CellStarts.SetSize(cell_count + 1);
+        memset(index.m_CellStarts.Begin(), 0, index.m_CellStarts.Size() * sizeof(uint32_t));
+        uint32_t* cell_starts = index.m_CellStarts.Begin();
+        for (uint32_t i = 0; i < entry_count; ++i)
+        {
+            float entry_min_x, entry_min_y, entry_max_x, entry_max_y;
+            GetPickQuadBounds(index.m_Entries[i].m_Quad, entry_min_x, entry_min_y, entry_max_x, entry_max_y);
+            uint32_t column_start, row_start, column_end, row_end;
+            GetPickCellRange(index, entry_min_x, entry_min_y, entry_max_x, entry_max_y, column_start, row_start, column_end, row_end);
+            for (uint32_t row = row_start; row <= row_end; ++row)
+                for (uint32_t column = column_start; column <= column_end; ++column)
+                    ++cell_starts[row * grid_size + column + 1];
+        }
+        for (uint32_t i = 0; i < cell_count; ++i)
+        {
+            cell_starts[i + 1] += cell_starts[i];
+        }
+
+        // Fill the cells in order, using the start of the next cell as a cursor
+        uint32_t cell_entry_count = cell_starts[cell_count];
+        if (index.m_CellEntries.Capacity() < cell_entry_count)
+            index.m_CellEntries.SetCapacity(cell_entry_count);
+        index.m_CellEntries.SetSize(cell_entry_count);
+        for (uint32_t i = 0; i < entry_count; ++i)
+        {
+            float entry_min_x, entry_min_y, entry_max_x, entry_max_y;
+            GetPickQuadBounds(index.m_Entries[i].m_Quad, entry_min_x, entry_min_y, entry_max_x, entry_max_y);
+            uint32_t column_start, row_start, column_end, row_end;
+            GetPickCellRange(index, entry_min_x, entry_min_y, entry_max_x, entry_max_y, column_start, row_start, column_end, row_end);
+            for (uint32_t row = row_start; row <= row_end; ++row)
+                for (uint32_t column = column_start; column <= column_end; ++column)
+                    index.m_CellEntries[cell_starts[row * grid_size + column]++] = (uint16_t) i;
+        }
+        for (uint32_t i = cell_count; i > 0; --i)
+        {
+            cell_starts[i] = cell_starts[i - 1];
+        }
+        cell_starts[0] = 0;
+    }
+
+    uint32_t PickNodes(HScene scene, float x, float y, HNode* nodes, uint32_t max_node_count)
+    {
+        if (scene->m_PickIndexDirty)
+        {
+            UpdatePickIndex(scene);
+        }
+
+        const PickIndex& index = scene->m_PickIndex;
+        if (index.m_Columns == 0 || max_node_count == 0)
+        {
+            return 0;
+        }
+
+        // Same conversion to screen space as PickNode
+        x *= (float) scene->m_Context->m_PhysicalWidth / (float) scene->m_Context->m_DefaultProjectWidth;
+        y *= (float) scene->m_Context->m_PhysicalHeight / (float) scene->m_Context->m_DefaultProjectHeight;
+
+        // Points outside of the grid end up in the border cells, where they are rejected by the quad tests
+        uint32_t column, row, column_end, row_end;
+        GetPickCellRange(index, x, y, x, y, column, row, column_end, row_end);
+        uint32_t cell = row * index.m_Columns + column;
+
+        uint32_t node_count = 0;
+        const uint16_t* cell_begin = index.m_CellEntries.Begin() + index.m_CellStarts[cell];
+        const uint16_t* cell_entry = index.m_CellEntries.Begin() + index.m_CellStarts[cell + 1];
+        while (cell_entry != cell_begin)
+        {
+            const PickEntry& entry = index.m_Entries[*--cell_entry];
+            if (IsPointInPickQuad(entry.m_Quad, x, y) && !IsPointClipped(index, entry.m_ClipperIndex, x, y))
+            {
+                nodes[node_count++] = GetNodeHandle(&scene->m_Nodes[entry.m_NodeIndex]);
+                if (node_count == max_node_count)
+                    break;
+            }
+        }
+        return node_count;
+    }
+
+    HNode PickTopNode(HScene scene, float x, float y)
+    {
+        HNode node;
+        if (PickNodes(scene, x, y, &node, 1) == 0)
+        {
+            return INVALID_HANDLE;
+        }
+        return node;
+    }
+
     bool IsNodeEnabled(HScene scene, HNode node, bool recursive)
     {
         InternalNode* n = GetNode(scene, node);
@@ -3980,6 +4402,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_Enabled = enabled;
+        scene->m_PickIndexDirty = 1;
         if(enabled)
         {
             SetDirtyLocalRecursive(scene, node);
@@ -3996,6 +4419,7 @@ namespace dmGui
     {
         InternalNode* n = GetNode(scene, node);
         n->m_Node.m_IsVisible = visible;
+        scene->m_PickIndexDirty = 1;
     }
 
     void MoveNodeBelow(HScene scene, HNode node, HNode reference)
@@ -4136,6 +4560,7 @@ namespace dmGui
         Vector3 local_position = ScreenToLocalPosition(scene, node, parent_node, screen_position);
         node->m_Node.m_Properties[dmGui::PROPERTY_POSITION] = Vector4(local_position, 1.0f);
         node->m_Node.m_DirtyLocal = 1;
+        scene->m_PickIndexDirty = 1;
     }
 
     void SetScreenPosition(HScene scene, HNode node, const Point3& screen_position)
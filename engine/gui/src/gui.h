@@ -225,7 +225,11 @@ namespace dmGui
         uint8_t     m_WriteMask;
         /// Color mask (R,G,B,A)
         uint8_t     m_ColorMask : 4;
-        uint8_t     m_Padding : 4;
+        /// Clip with m_ScissorRect instead of the stencil buffer, see RenderSceneParams::m_ScissorClipping
+        uint8_t     m_Scissor : 1;
+        uint8_t     m_Padding : 3;
+        /// Scissor rectangle in world space (min x, min y, max x, max y), only valid if m_Scissor is set
+        float       m_ScissorRect[4];
     };
 
     struct NewContextParams;
@@ -740,6 +744,9 @@ namespace dmGui
         NewTexture                  m_NewTexture;
         DeleteTexture               m_DeleteTexture;
         SetTextureData              m_SetTextureData;
+        /// Set if the renderer supports scissor rectangles. Hierarchies of axis-aligned box clippers
+        /// are then clipped with StencilScope::m_ScissorRect, without drawing the clippers to the stencil buffer
+        bool                        m_ScissorClipping;
     };
 
     /** Renders a gui scene
@@ -1051,6 +1058,30 @@ namespace dmGui
      */
     bool PickNode(HScene scene, HNode node, float x, float y);
 
+    /** finds the topmost node at a position
+     * Finds the topmost enabled and visible node which is not clipped away at the supplied screen-space coordinates.
+     * The color of the nodes is not considered, and the shapes of nodes and clippers are approximated by their rectangles.
+     * The nodes are looked up in a spatial index of the scene, which is rebuilt when the nodes have changed.
+     *
+     * @param scene the scene to pick from
+     * @param x x-coordinate in predefined screen-space
+     * @param y y-coordinate in predefined screen-space
+     * @return the topmost node, or INVALID_HANDLE if no node was picked
+     */
+    HNode PickTopNode(HScene scene, float x, float y);
+
+    /** finds the nodes at a position
+     * Same as PickTopNode, but finds all the nodes at the supplied screen-space coordinates.
+     *
+     * @param scene the scene to pick from
+     * @param x x-coordinate in predefined screen-space
+     * @param y y-coordinate in predefined screen-space
+     * @param nodes [out] the picked nodes, topmost first
+     * @param max_node_count the maximum number of nodes to return
+     * @return the number of picked nodes written to nodes
+     */
+    uint32_t PickNodes(HScene scene, float x, float y, HNode* nodes, uint32_t max_node_count);
+
     /** retrieves if a node is enabled or not
      * Only enabled nodes are animated and rendered.
      *
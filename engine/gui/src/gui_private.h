@@ -20,6 +20,7 @@
 #include <dlib/hashtable.h>
 #include <dlib/easing.h>
 #include <dlib/image.h>
+#include <dlib/memory.h>
 #include <dmsdk/dlib/vmath.h>
 
 #include "gui.h"
@@ -78,6 +79,46 @@ namespace dmGui
         uint16_t                m_NodeIndex;
     };
 
+    // Screen space corners of a node, see PickNode()
+    struct PickQuad
+    {
+        float m_X[4];
+        float m_Y[4];
+    };
+
+    struct PickClipper
+    {
+        PickQuad    m_Quad;
+        uint16_t    m_ParentIndex;
+        uint16_t    m_Inverted : 1;
+    };
+
+    struct PickEntry
+    {
+        PickQuad    m_Quad;
+        uint32_t    m_Order;        // Layer and render order, the entry with the highest order is on top
+        uint16_t    m_NodeIndex;
+        uint16_t    m_ClipperIndex; // Index into PickIndex::m_Clippers of the closest clipper, INVALID_INDEX if none
+    };
+
+    /* Uniform grid over the screen space quads of all pickable nodes, to answer PickTopNode() and PickNodes()
+     * without calculating the transforms of every node per query.
+     * It is rebuilt on the next query whenever Scene::m_PickIndexDirty has been set.
+     */
+    struct PickIndex
+    {
+        dmArray<PickEntry>      m_Entries;      // Sorted on order
+        dmArray<PickClipper>    m_Clippers;
+        dmArray<uint32_t>       m_CellStarts;   // Offset into m_CellEntries per cell, plus one for the end
+        dmArray<uint16_t>       m_CellEntries;  // Entry indices per cell, sorted on order
+        float                   m_MinX;
+        float                   m_MinY;
+        float                   m_InvCellWidth;
+        float                   m_InvCellHeight;
+        uint16_t                m_Columns;
+        uint16_t                m_Rows;
+    };
+
     struct Context
     {
         lua_State*                      m_LuaState;
@@ -92,15 +133,12 @@ namespace dmGui
         uint32_t                        m_Dpi;
         dmArray<HScene>                 m_Scenes;
         dmArray<RenderEntry>            m_RenderNodes;
-        dmArray<dmVMath::Matrix4>       m_RenderTransforms;
-        dmArray<float>                	m_RenderOpacities;
         dmArray<InternalClippingNode>   m_StencilClippingNodes;
-        dmArray<StencilScope*>          m_StencilScopes;
-        dmArray<uint16_t>               m_StencilScopeIndices;
         dmArray<HNode>                  m_ScratchBoneNodes;
         dmHID::HContext                 m_HidContext;
         void*                           m_DisplayProfiles;
         SceneTraversalCache             m_SceneTraversalCache;
+        dmMemory::HTag                  m_MemoryTag;
     };
 
     struct Node
@@ -214,6 +252,7 @@ namespace dmGui
         uint16_t m_AnimationCompleteCalled : 1;
         uint16_t m_Cancelled : 1;
         uint16_t m_Backwards : 1;
+        uint16_t m_AffectsPickBounds : 1; // If the animated value moves or resizes the node, see PickNodes()
     };
 
     struct Script
@@ -298,8 +337,10 @@ namespace dmGui
         uint16_t                m_RenderOrder; // For the render-key
         uint16_t                m_NextLayerIndex;
         uint16_t                m_ResChanged : 1;
+        uint16_t                m_PickIndexDirty : 1;
         uint32_t                m_Width;
         uint32_t                m_Height;
+        PickIndex               m_PickIndex;
         dmScript::ScriptWorld*  m_ScriptWorld;
         CreateCustomNodeCallback    m_CreateCustomNodeCallback;
         DestroyCustomNodeCallback   m_DestroyCustomNodeCallback;
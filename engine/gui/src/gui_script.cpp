@@ -2228,6 +2228,7 @@ namespace dmGui
         InternalNode* n = LuaCheckNodeInternal(L, 1, &hnode);
         int clipping_mode = (int) luaL_checknumber(L, 2);
         n->m_Node.m_ClippingMode = (ClippingMode) clipping_mode;
+        GetScene(L)->m_PickIndexDirty = 1;
         return 0;
     }
 
@@ -2290,6 +2291,7 @@ namespace dmGui
         InternalNode* n = LuaCheckNodeInternal(L, 1, &hnode);
         int inverted = lua_toboolean(L, 2);
         n->m_Node.m_ClippingInverted = inverted;
+        GetScene(L)->m_PickIndexDirty = 1;
         return 0;
     }
 
@@ -3001,6 +3003,82 @@ namespace dmGui
         return 1;
     }
 
+    /*# returns the topmost node at the supplied coordinates
+     * Finds the topmost node that would be picked by <code>gui.pick_node</code> at the supplied coordinates.
+     * Only enabled and visible nodes are considered, and nodes clipped by a stencil clipper are ignored
+     * at the points where they are clipped. This is faster than calling <code>gui.pick_node</code>
+     * on each node when there are many nodes in the scene.
+     *
+     * @name gui.pick_top_node
+     * @param x [type:number] x-coordinate (see <a href="#on_input">on_input</a> )
+     * @param y [type:number] y-coordinate (see <a href="#on_input">on_input</a> )
+     * @return node [type:node|nil] the topmost node, or `nil` if there is no node at the coordinates
+     * @examples
+     *
+     * ```lua
+     * function on_input(self, action_id, action)
+     *     if action_id == hash("touch") and action.pressed then
+     *         local node = gui.pick_top_node(action.x, action.y)
+     *         if node then
+     *             print(gui.get_id(node))
+     *         end
+     *     end
+     * end
+     * ```
+     */
+    static int LuaPickTopNode(lua_State* L)
+    {
+        lua_Number x = luaL_checknumber(L, 1);
+        lua_Number y = luaL_checknumber(L, 2);
+
+        Scene* scene = GuiScriptInstance_Check(L);
+
+        HNode node = PickTopNode(scene, (float) x, (float) y);
+        if (node == INVALID_HANDLE)
+        {
+            lua_pushnil(L);
+        }
+        else
+        {
+            LuaPushNode(L, scene, node);
+        }
+        return 1;
+    }
+
+    /*# returns all nodes at the supplied coordinates
+     * Finds all nodes that would be picked by <code>gui.pick_node</code> at the supplied coordinates,
+     * with the same rules as <code>gui.pick_top_node</code>.
+     *
+     * @name gui.pick_nodes
+     * @param x [type:number] x-coordinate (see <a href="#on_input">on_input</a> )
+     * @param y [type:number] y-coordinate (see <a href="#on_input">on_input</a> )
+     * @return nodes [type:table] the nodes at the coordinates, topmost node first
+     */
+    static int LuaPickNodes(lua_State* L)
+    {
+        int top = lua_gettop(L);
+        (void) top;
+
+        lua_Number x = luaL_checknumber(L, 1);
+        lua_Number y = luaL_checknumber(L, 2);
+
+        Scene* scene = GuiScriptInstance_Check(L);
+
+        dmArray<HNode> nodes;
+        nodes.SetCapacity(dmMath::Max(GetNodeCount(scene), 1u));
+        nodes.SetSize(PickNodes(scene, (float) x, (float) y, nodes.Begin(), nodes.Capacity()));
+
+        lua_createtable(L, nodes.Size(), 0);
+        for (uint32_t i = 0; i < nodes.Size(); ++i)
+        {
+            LuaPushNode(L, scene, nodes[i]);
+            lua_rawseti(L, -2, i + 1);
+        }
+
+        assert(top + 1 == lua_gettop(L));
+        return 1;
+    }
+
     /*# returns if a node is enabled or not
      * Returns `true` if a node is enabled and `false` if it's not.
      * Disabled nodes are not rendered and animations acting on them are not evaluated.
@@ -3131,6 +3209,7 @@ namespace dmGui
         InternalNode* n = LuaCheckNodeInternal(L, 1, &hnode);
         int adjust_mode = (int) luaL_checknumber(L, 2);
         n->m_Node.m_AdjustMode = (AdjustMode) adjust_mode;
+        GetScene(L)->m_PickIndexDirty = 1;
         return 0;
     }
 
@@ -3749,6 +3828,7 @@ namespace dmGui
                 v = *dmScript::CheckVector4(L, 2);\
             n->m_Node.m_Properties[property] = v;\
             n->m_Node.m_DirtyLocal = 1;\
+            GetScene(L)->m_PickIndexDirty = 1;\
             return 0;\
         }\
 
@@ -3814,6 +3894,7 @@ namespace dmGui
         }
         n->m_Node.m_Properties[PROPERTY_ROTATION] = v;
         n->m_Node.m_DirtyLocal = 1;
+        GetScene(L)->m_PickIndexDirty = 1;
         return 0;
     }
 
@@ -3860,6 +3941,7 @@ namespace dmGui
             v = *dmScript::CheckVector4(L, 2);
         n->m_Node.m_Properties[PROPERTY_SIZE] = v;
         n->m_Node.m_DirtyLocal = 1;
+        GetScene(L)->m_PickIndexDirty = 1;
         return 0;
     }
 
@@ -4449,6 +4531,8 @@ namespace dmGui
         {"get_slice9",      LuaGetSlice9},
         {"set_slice9",      LuaSetSlice9},
         {"pick_node",       LuaPickNode},
+        {"pick_top_node",   LuaPickTopNode},
+        {"pick_nodes",      LuaPickNodes},
         {"is_enabled",      LuaIsEnabled},
         {"set_enabled",     LuaSetEnabled},
         {"get_visible",     LuaGetVisible},
@@ -25,6 +25,7 @@
 #include <dlib/message.h>
 #include <dlib/log.h>
 #include <dlib/testutil.h>
+#include <dlib/time.h>
 #include <dmsdk/dlib/vmath.h>
 #include <particle/particle.h>
 #include <script/script.h>
@@ -2750,6 +2751,194 @@ TEST_F(dmGuiTest, PickingDisabledAdjust)
     ASSERT_TRUE(dmGui::PickNode(m_Scene, n1, tmin.getX()*ref_scale, tmax.getY()*ref_scale));
 }
 
+TEST_F(dmGuiTest, PickTopNode)
+{
+    uint32_t physical_width = 640;
+    uint32_t physical_height = 320;
+    float ref_scale = 0.5f;
+    dmGui::SetPhysicalResolution(m_Context, physical_width, physical_height);
+    dmGui::SetDefaultResolution(m_Context, (uint32_t) (physical_width * ref_scale), (uint32_t) (physical_height * ref_scale));
+    dmGui::SetSceneResolution(m_Scene, (uint32_t) (physical_width * ref_scale), (uint32_t) (physical_height * ref_scale));
+
+    Vector3 size(10, 10, 0);
+    dmGui::HNode n1 = dmGui::NewNode(m_Scene, Point3(5, 5, 0), size, dmGui::NODE_TYPE_BOX, 0);
+    dmGui::HNode n2 = dmGui::NewNode(m_Scene, Point3(10, 10, 0), size, dmGui::NODE_TYPE_BOX, 0);
+
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 2, 2));
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 7, 7));
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 13, 13));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 17, 17));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 100, 100));
+
+    // All hits, topmost first
+    dmGui::HNode nodes[4];
+    ASSERT_EQ(2u, dmGui::PickNodes(m_Scene, 7, 7, nodes, 4));
+    ASSERT_EQ(n2, nodes[0]);
+    ASSERT_EQ(n1, nodes[1]);
+    ASSERT_EQ(1u, dmGui::PickNodes(m_Scene, 7, 7, nodes, 1));
+    ASSERT_EQ(n2, nodes[0]);
+
+    // Layers are drawn on top of the render order
+    ASSERT_EQ(dmGui::RESULT_OK, dmGui::AddLayer(m_Scene, "layer1"));
+    ASSERT_EQ(dmGui::RESULT_OK, dmGui::SetNodeLayer(m_Scene, n1, "layer1"));
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    dmGui::MoveNodeBelow(m_Scene, n2, n1);
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    ASSERT_EQ(dmGui::RESULT_OK, dmGui::SetNodeLayer(m_Scene, n1, ""));
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    dmGui::MoveNodeAbove(m_Scene, n2, n1);
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 7, 7));
+
+    // Disabled and invisible nodes are ignored
+    dmGui::SetNodeEnabled(m_Scene, n2, false);
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    dmGui::SetNodeEnabled(m_Scene, n2, true);
+    dmGui::SetNodeVisible(m_Scene, n2, false);
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 13, 13));
+    dmGui::SetNodeVisible(m_Scene, n2, true);
+
+    // Changes are picked up by the next query
+    dmGui::SetNodePosition(m_Scene, n2, Point3(100, 100, 0));
+    ASSERT_EQ(n1, dmGui::PickTopNode(m_Scene, 7, 7));
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 100, 100));
+    dmGui::SetNodeProperty(m_Scene, n2, dmGui::PROPERTY_SIZE, Vector4(20, 20, 0, 0));
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 108, 108));
+    dmGui::SetNodeProperty(m_Scene, n2, dmGui::PROPERTY_ROTATION, Vector4(0, 0, 45, 0));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 108, 108));
+    ASSERT_EQ(n2, dmGui::PickTopNode(m_Scene, 100, 112));
+    dmGui::DeleteNode(m_Scene, n2);
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 100, 100));
+
+    // Same result as PickNode
+    dmGui::SetNodeProperty(m_Scene, n1, dmGui::PROPERTY_ROTATION, Vector4(0, 0, 30, 0));
+    for (float y = -5.0f; y < 15.0f; y += 0.5f)
+    {
+        for (float x = -5.0f; x < 15.0f; x += 0.5f)
+        {
+            ASSERT_EQ(dmGui::PickNode(m_Scene, n1, x, y), dmGui::PickTopNode(m_Scene, x, y) == n1);
+        }
+    }
+}
+
+TEST_F(dmGuiTest, PickTopNodeClipping)
+{
+    Vector3 size(10, 10, 0);
+    dmGui::HNode clipper = dmGui::NewNode(m_Scene, Point3(50, 50, 0), size, dmGui::NODE_TYPE_BOX, 0);
+    dmGui::HNode child = dmGui::NewNode(m_Scene, Point3(5, 0, 0), size, dmGui::NODE_TYPE_BOX, 0);
+    dmGui::SetNodeParent(m_Scene, child, clipper, false);
+    dmGui::SetNodeClippingMode(m_Scene, clipper, dmGui::CLIPPING_MODE_STENCIL);
+
+    // The child is only picked inside of the clipper
+    ASSERT_EQ(child, dmGui::PickTopNode(m_Scene, 52, 50));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 58, 50));
+    ASSERT_EQ(clipper, dmGui::PickTopNode(m_Scene, 47, 50));
+
+    // Inverted clippers clip the inside
+    dmGui::SetNodeClippingInverted(m_Scene, clipper, true);
+    ASSERT_EQ(clipper, dmGui::PickTopNode(m_Scene, 52, 50));
+    ASSERT_EQ(child, dmGui::PickTopNode(m_Scene, 58, 50));
+
+    // Invisible clippers are not picked, invisible inverted clippers do not clip
+    dmGui::SetNodeVisible(m_Scene, clipper, false);
+    ASSERT_EQ(child, dmGui::PickTopNode(m_Scene, 52, 50));
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 47, 50));
+
+    // Invisible clippers clip all their children
+    dmGui::SetNodeClippingInverted(m_Scene, clipper, false);
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 52, 50));
+
+    dmGui::SetNodeClippingMode(m_Scene, clipper, dmGui::CLIPPING_MODE_NONE);
+    ASSERT_EQ(child, dmGui::PickTopNode(m_Scene, 58, 50));
+}
+
+TEST_F(dmGuiTest, PickTopNodeAnimation)
+{
+    dmGui::HNode node = dmGui::NewNode(m_Scene, Point3(5, 5, 0), Vector3(10, 10, 0), dmGui::NODE_TYPE_BOX, 0);
+    ASSERT_EQ(node, dmGui::PickTopNode(m_Scene, 5, 5));
+    ASSERT_EQ(0, m_Scene->m_PickIndexDirty);
+
+    // Animating the color doesn't change the bounds of the node
+    dmGui::AnimateNodeHash(m_Scene, node, dmGui::GetPropertyHash(dmGui::PROPERTY_COLOR), Vector4(0,0,0,0), dmEasing::Curve(dmEasing::TYPE_LINEAR), dmGui::PLAYBACK_ONCE_FORWARD, 1.0f, 0, 0, 0, 0);
+    dmGui::UpdateScene(m_Scene, 1.0f / 60.0f);
+    ASSERT_EQ(0, m_Scene->m_PickIndexDirty);
+    dmGui::CancelAnimationHash(m_Scene, node, dmGui::GetPropertyHash(dmGui::PROPERTY_COLOR));
+
+    // Animating the position does
+    dmGui::AnimateNodeHash(m_Scene, node, dmGui::GetPropertyHash(dmGui::PROPERTY_POSITION), Vector4(105,5,0,0), dmEasing::Curve(dmEasing::TYPE_LINEAR), dmGui::PLAYBACK_ONCE_FORWARD, 1.0f, 0, 0, 0, 0);
+    dmGui::UpdateScene(m_Scene, 1.0f / 60.0f);
+    ASSERT_EQ(1, m_Scene->m_PickIndexDirty);
+    for (int i = 0; i < 60; ++i)
+        dmGui::UpdateScene(m_Scene, 1.0f / 60.0f);
+    ASSERT_EQ(dmGui::INVALID_HANDLE, dmGui::PickTopNode(m_Scene, 5, 5));
+    ASSERT_EQ(node, dmGui::PickTopNode(m_Scene, 105, 5));
+}
+
+TEST_F(dmGuiTest, PickTopNodePerf)
+{
+    const uint32_t node_count = 1000;
+    const uint32_t pick_count = 1000;
+
+    dmGui::NewSceneParams params;
+    params.m_MaxNodes = node_count;
+    params.m_MaxAnimations = MAX_ANIMATIONS;
+    params.m_UserData = this;
+    dmGui::HScene scene = dmGui::NewScene(m_Context, &params);
+    dmGui::SetSceneResolution(scene, 1, 1);
+
+    uint32_t seed = 0;
+    dmGui::HNode* nodes = new dmGui::HNode[node_count];
+    for (uint32_t i = 0; i < node_count; ++i)
+    {
+        Point3 pos(dmMath::Rand01(&seed) * 1000.0f, dmMath::Rand01(&seed) * 1000.0f, 0);
+        Vector3 size(10.0f + dmMath::Rand01(&seed) * 40.0f, 10.0f + dmMath::Rand01(&seed) * 40.0f, 0);
+        nodes[i] = dmGui::NewNode(scene, pos, size, dmGui::NODE_TYPE_BOX, 0);
+        dmGui::SetNodeProperty(scene, nodes[i], dmGui::PROPERTY_ROTATION, Vector4(0, 0, dmMath::Rand01(&seed) * 90.0f, 0));
+    }
+
+    float* points = new float[pick_count * 2];
+    for (uint32_t i = 0; i < pick_count * 2; ++i)
+    {
+        points[i] = dmMath::Rand01(&seed) * 1000.0f;
+    }
+
+    // The nodes are in render order, the last hit is the topmost
+    dmGui::HNode* expected = new dmGui::HNode[pick_count];
+    uint64_t time = dmTime::GetTime();
+    for (uint32_t i = 0; i < pick_count; ++i)
+    {
+        expected[i] = dmGui::INVALID_HANDLE;
+        for (uint32_t j = 0; j < node_count; ++j)
+        {
+            if (dmGui::PickNode(scene, nodes[j], points[i * 2], points[i * 2 + 1]))
+                expected[i] = nodes[j];
+        }
+    }
+    uint64_t node_time = dmTime::GetTime() - time;
+
+    time = dmTime::GetTime();
+    dmGui::PickTopNode(scene, 0, 0);
+    uint64_t build_time = dmTime::GetTime() - time;
+
+    time = dmTime::GetTime();
+    uint32_t hit_count = 0;
+    for (uint32_t i = 0; i < pick_count; ++i)
+    {
+        dmGui::HNode node = dmGui::PickTopNode(scene, points[i * 2], points[i * 2 + 1]);
+        ASSERT_EQ(expected[i], node);
+        hit_count += node != dmGui::INVALID_HANDLE ? 1 : 0;
+    }
+    uint64_t scene_time = dmTime::GetTime() - time;
+
+    printf("Picking %u points among %u nodes (%u hits): PickNode %.3f ms, PickTopNode %.3f ms (%.3f ms to build the index)\n",
+        pick_count, node_count, hit_count, node_time / 1000.0, scene_time / 1000.0, build_time / 1000.0);
+
+    delete [] expected;
+    delete [] points;
+    delete [] nodes;
+    dmGui::DeleteScene(scene);
+}
+
 TEST_F(dmGuiTest, ScriptPicking)
 {
     uint32_t physical_width = 640;
@@ -2789,6 +2978,39 @@ TEST_F(dmGuiTest, ScriptPicking)
     dmGui::ClearFonts(m_Scene);
 }
 
+TEST_F(dmGuiTest, ScriptPickTopNode)
+{
+    uint32_t physical_width = 640;
+    uint32_t physical_height = 320;
+    dmGui::SetPhysicalResolution(m_Context, physical_width, physical_height);
+    dmGui::SetSceneResolution(m_Scene, physical_width, physical_height);
+    dmGui::SetDefaultResolution(m_Context, physical_width, physical_height);
+
+    const char* s = "function init(self)\n"
+                    "    local size = vmath.vector3(10, 10, 0)\n"
+                    "    local n1 = gui.new_box_node(vmath.vector3(5, 5, 0), size)\n"
+                    "    local n2 = gui.new_box_node(vmath.vector3(10, 10, 0), size)\n"
+                    "    assert(gui.pick_top_node(2, 2) == n1)\n"
+                    "    assert(gui.pick_top_node(7, 7) == n2)\n"
+                    "    assert(gui.pick_top_node(20, 20) == nil)\n"
+                    "    local nodes = gui.pick_nodes(7, 7)\n"
+                    "    assert(#nodes == 2 and nodes[1] == n2 and nodes[2] == n1)\n"
+                    "    assert(#gui.pick_nodes(20, 20) == 0)\n"
+                    "    gui.set_enabled(n2, false)\n"
+                    "    assert(gui.pick_top_node(7, 7) == n1)\n"
+                    "    gui.set_position(n1, vmath.vector3(50, 50, 0))\n"
+                    "    assert(gui.pick_top_node(7, 7) == nil)\n"
+                    "    assert(gui.pick_top_node(50, 50) == n1)\n"
+                    "end\n";
+
+    dmGui::Result r;
+    r = dmGui::SetScript(m_Script, LuaSourceFromStr(s));
+    ASSERT_EQ(dmGui::RESULT_OK, r);
+
+    r = dmGui::InitScene(m_Scene);
+    ASSERT_EQ(dmGui::RESULT_OK, r);
+}
+
 template <> char* jc_test_print_value(char* buffer, size_t buffer_len, Vector4 v) {
     return buffer + dmSnPrintf(buffer, buffer_len, "vector4(%.3f, %.3f, %.3f, %.3f)", v.getX(), v.getY(), v.getZ(), v.getW());
 }
@@ -221,15 +221,21 @@ public:
         return node;
     }
 
-    void Render() {
+    void Render(bool scissor_clipping = false) {
         m_NodeToClipping.clear();
         m_NodeToRenderOrder.clear();
         m_Renderer.ClearBuffer();
         dmGui::RenderSceneParams params;
         params.m_RenderNodes = RenderNodes;
+        params.m_ScissorClipping = scissor_clipping;
         dmGui::RenderScene(m_Scene, params, this);
     }
 
+    void SetRect(dmGui::HNode node, float x, float y, float width, float height) {
+        dmGui::SetNodePosition(m_Scene, node, Point3(x, y, 0.0f));
+        dmGui::SetNodeProperty(m_Scene, node, dmGui::PROPERTY_SIZE, Vector4(width, height, 0.0f, 0.0f));
+    }
+
     void SetLayers(const char* layer0) {
         dmGui::AddLayer(m_Scene, layer0);
     }
@@ -287,6 +293,22 @@ public:
         ASSERT_EQ((int)ref, (int)GetRefVal(state));
     }
 
+    void AssertScissorRect(dmGui::HNode non_clipper, float min_x, float min_y, float max_x, float max_y) {
+        dmGui::StencilScope state;
+        GetStencilScope(non_clipper, state);
+        ASSERT_TRUE(state.m_Scissor);
+        ASSERT_NEAR(min_x, state.m_ScissorRect[0], 0.001f);
+        ASSERT_NEAR(min_y, state.m_ScissorRect[1], 0.001f);
+        ASSERT_NEAR(max_x, state.m_ScissorRect[2], 0.001f);
+        ASSERT_NEAR(max_y, state.m_ScissorRect[3], 0.001f);
+    }
+
+    void AssertStencil(dmGui::HNode node) {
+        dmGui::StencilScope state;
+        GetStencilScope(node, state);
+        ASSERT_FALSE(state.m_Scissor);
+    }
+
     void AssertShapeClippedBy(uint8_t shape, dmGui::HNode non_clipper, uint8_t expected) {
         dmGui::StencilScope state;
         GetStencilScope(non_clipper, state);
@@ -1145,6 +1167,85 @@ TEST_F(dmGuiClippingTest, TestOverflowClearEnd) {
     Render();
 }
 
+/**
+ * Verify that box clippers are clipped with scissor rectangles, when supported by the renderer.
+ * Nothing is drawn to the stencil buffer, and the rectangles are intersected with the parent rectangles.
+ *
+ * - a (scissor)
+ *   - b (scissor)
+ *     - c
+ *   - d
+ */
+TEST_F(dmGuiClippingTest, TestScissor) {
+    dmGui::SetSceneAdjustReference(m_Scene, dmGui::ADJUST_REFERENCE_DISABLED);
+    dmGui::HNode a = AddClipperBox("a");
+    dmGui::HNode b = AddClipperBox("b", a);
+    dmGui::HNode c = AddBox("c", b);
+    dmGui::HNode d = AddBox("d", a);
+    SetRect(a, 50.0f, 50.0f, 100.0f, 100.0f);
+    SetRect(b, 25.0f, 25.0f, 100.0f, 20.0f);
+
+    Render(true);
+
+    ASSERT_TRUE(m_NodeToClippingOrder.empty());
+    AssertScissorRect(b, 0.0f, 0.0f, 100.0f, 100.0f);
+    AssertScissorRect(c, 25.0f, 65.0f, 100.0f, 85.0f);
+    AssertScissorRect(d, 0.0f, 0.0f, 100.0f, 100.0f);
+    AssertRenderOrder(a, b, c, d);
+
+    // A hidden clipper clips everything
+    dmGui::SetNodeVisible(m_Scene, b, false);
+    Render(true);
+
+    AssertScissorRect(c, 25.0f, 65.0f, 25.0f, 65.0f);
+    AssertScissorRect(d, 0.0f, 0.0f, 100.0f, 100.0f);
+}
+
+/**
+ * Verify that clipper hierarchies fall back to the stencil buffer, when any of the clippers can't be
+ * described by a rectangle.
+ *
+ * - a (inv)
+ *   - b
+ * - c
+ *   - d (rotated)
+ *     - e
+ * - f
+ *   - g
+ * - h (pie)
+ *   - i
+ */
+TEST_F(dmGuiClippingTest, TestScissorFallback) {
+    dmGui::SetSceneAdjustReference(m_Scene, dmGui::ADJUST_REFERENCE_DISABLED);
+    dmGui::HNode a = AddInvClipperBox("a");
+    dmGui::HNode b = AddBox("b", a);
+    dmGui::HNode c = AddClipperBox("c");
+    dmGui::HNode d = AddClipperBox("d", c);
+    dmGui::HNode e = AddBox("e", d);
+    dmGui::HNode f = AddClipperBox("f");
+    dmGui::HNode g = AddBox("g", f);
+    dmGui::HNode h = dmGui::NewNode(m_Scene, Point3(), Vector3(), dmGui::NODE_TYPE_PIE, 0);
+    dmGui::SetNodeClippingMode(m_Scene, h, dmGui::CLIPPING_MODE_STENCIL);
+    dmGui::HNode i = AddBox("i", h);
+    SetRect(c, 50.0f, 50.0f, 100.0f, 100.0f);
+    SetRect(d, 0.0f, 0.0f, 50.0f, 50.0f);
+    dmGui::SetNodeProperty(m_Scene, d, dmGui::PROPERTY_ROTATION, Vector4(0.0f, 0.0f, 45.0f, 0.0f));
+    SetRect(f, 50.0f, 50.0f, 100.0f, 100.0f);
+
+    Render(true);
+
+    AssertStencil(b);
+    AssertStencil(d);
+    AssertStencil(e);
+    AssertScissorRect(g, 0.0f, 0.0f, 100.0f, 100.0f);
+    AssertStencil(i);
+    AssertClipperOrder(a, b);
+    AssertClipperOrder(c, e);
+    AssertClipperOrder(d, e);
+    AssertClipperOrder(h, i);
+    ASSERT_TRUE(m_NodeToClippingOrder.find(f) == m_NodeToClippingOrder.end());
+}
+
 #undef BITS
 
 int main(int argc, char **argv)
@@ -52,6 +52,7 @@ namespace dmLiveUpdate
 
     const char* LIVEUPDATE_INDEX_FILENAME           = "liveupdate.arci";
     const char* LIVEUPDATE_INDEX_TMP_FILENAME       = "liveupdate.arci.tmp";
+    const char* LIVEUPDATE_INDEX_JOURNAL_FILENAME   = "liveupdate.arci.journal";
     const char* LIVEUPDATE_ARCHIVE_FILENAME         = "liveupdate.arcd";
     const char* LIVEUPDATE_ARCHIVE_TMP_FILENAME     = "liveupdate.arcd.tmp";
     const char* LIVEUPDATE_ZIP_ARCHIVE_FILENAME     = "liveupdate.ref";
@@ -141,7 +142,7 @@ namespace dmLiveUpdate
 
     static void LegacyCleanOldArchiveMountFormats(const char* app_support_path)
     {
-        const char* filenames[] = {LIVEUPDATE_INDEX_FILENAME, LIVEUPDATE_INDEX_TMP_FILENAME, LIVEUPDATE_BUNDLE_VER_FILENAME,
+        const char* filenames[] = {LIVEUPDATE_INDEX_FILENAME, LIVEUPDATE_INDEX_TMP_FILENAME, LIVEUPDATE_INDEX_JOURNAL_FILENAME, LIVEUPDATE_BUNDLE_VER_FILENAME,
                                    LIVEUPDATE_ARCHIVE_FILENAME, LIVEUPDATE_ARCHIVE_TMP_FILENAME};
         for (int i = 0; i < DM_ARRAY_SIZE(filenames); ++i)
         {
@@ -17,7 +17,9 @@
 #include <resource/resource_manifest.h>
 #include <resource/resource_verify.h>
 
+#include <dlib/array.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
 #include <dlib/memory.h>
 #include <dlib/zip.h>
 
@@ -59,12 +61,76 @@ namespace dmLiveUpdate
         return data;
     }
 
-    static dmResource::Result VerifyZipEntries(dmResource::Manifest* manifest, dmZip::HZip zip)
+    struct ZipVerifyEntry
+    {
+        uint32_t m_DataOffset;
+        uint32_t m_DataSize;
+        uint32_t m_NameOffset;
+    };
+
+    struct ZipVerifyBatch
+    {
+        dmArray<uint8_t>        m_Data;
+        dmArray<char>           m_Names;
+        dmArray<ZipVerifyEntry> m_Entries;
+    };
+
+    template<typename T>
+    static void EnsureCapacity(dmArray<T>& array, uint32_t count)
+    {
+        uint32_t needed = array.Size() + count;
+        if (array.Capacity() < needed)
+            array.OffsetCapacity(dmMath::Max(needed - array.Capacity(), array.Capacity()));
+    }
+
+    static dmResource::Result VerifyZipBatch(dmResource::Manifest* manifest, ZipVerifyBatch& batch)
+    {
+        uint32_t num_entries = batch.m_Entries.Size();
+        if (num_entries == 0)
+            return dmResource::RESULT_OK;
+
+        dmArray<dmResource::VerifyEntry> verify_entries;
+        verify_entries.SetCapacity(num_entries);
+        verify_entries.SetSize(num_entries);
+        for (uint32_t i = 0; i < num_entries; ++i)
+        {
+            const ZipVerifyEntry& zip_entry = batch.m_Entries[i];
+            const char* entry_name = &batch.m_Names[zip_entry.m_NameOffset];
+
+            dmResourceArchive::LiveUpdateResource resource(&batch.m_Data[zip_entry.m_DataOffset], zip_entry.m_DataSize);
+
+            // NOTE: The entry "name" is the actual checksum of the contents of that file. It is not a url.
+            dmResource::VerifyEntry& entry = verify_entries[i];
+            entry.m_Expected = (const uint8_t*)entry_name;
+            entry.m_ExpectedLength = strlen(entry_name);
+            entry.m_Data = resource.m_Data;
+            entry.m_DataLength = resource.m_Count;
+            entry.m_Result = dmResource::RESULT_OK;
+        }
+
+        dmResource::Result result = dmResource::VerifyResources(manifest, verify_entries.Begin(), num_entries);
+        if (dmResource::RESULT_OK != result)
+        {
+            for (uint32_t i = 0; i < num_entries; ++i)
+            {
+                if (dmResource::RESULT_OK != verify_entries[i].m_Result)
+                {
+                    dmLogError("Failed to verify resource '%s' in archive", (const char*)verify_entries[i].m_Expected);
+                }
+            }
+        }
+
+        batch.m_Data.SetSize(0);
+        batch.m_Names.SetSize(0);
+        batch.m_Entries.SetSize(0);
+        return result;
+    }
+
+    dmResource::Result VerifyZipEntries(dmResource::HManifest manifest, dmZip::HZip zip, uint32_t batch_size)
     {
         dmResource::Result result = dmResource::RESULT_OK;
         uint32_t num_entries = dmZip::GetNumEntries(zip);
-        uint32_t entry_data_capacity = 0;
-        uint8_t* entry_data = 0;
+        ZipVerifyBatch batch;
         for( uint32_t i = 0; i < num_entries && dmResource::RESULT_OK == result; ++i)
         {
             dmZip::Result zr = dmZip::OpenEntry(zip, i);
@@ -79,29 +145,32 @@ namespace dmLiveUpdate
                 {
                     dmLogError("Could not get entry size '%s'", entry_name);
                     dmZip::Close(zip);
-                    free((void*)entry_data);
                     return dmResource::RESULT_INVALID_DATA;
                 }
 
-                if (entry_data_capacity < entry_size)
-                {
-                    entry_data = (uint8_t*)realloc(entry_data, entry_size);
-                    entry_data_capacity = entry_size;
-                }
-
-                zr = dmZip::GetEntryData(zip, entry_data, entry_size);
-
-                dmResourceArchive::LiveUpdateResource resource(entry_data, entry_size);
                 if (entry_size >= sizeof(dmResourceArchive::LiveUpdateResourceHeader))
                 {
-                    // NOTE: The entry "name" is the actual checksum of the contents of that file. It is not a url.
                     // NOTE: We probably need to handle custom files existing in the .zip file that _aren't_ part of the manifest
-                    result = dmResource::VerifyResource(manifest, (const uint8_t*)entry_name, strlen(entry_name), resource.m_Data, resource.m_Count);
-
-                    if (dmResource::RESULT_OK != result)
+                    if (!batch.m_Entries.Empty() && batch.m_Data.Size() + entry_size > batch_size)
                     {
-                        dmLogError("Failed to verify resource '%s' in archive", entry_name);
+                        result = VerifyZipBatch(manifest, batch);
                     }
+
+                    ZipVerifyEntry entry;
+                    entry.m_DataOffset = batch.m_Data.Size();
+                    entry.m_DataSize = entry_size;
+                    entry.m_NameOffset = batch.m_Names.Size();
+
+                    uint32_t name_length = strlen(entry_name) + 1;
+                    EnsureCapacity(batch.m_Names, name_length);
+                    batch.m_Names.PushArray(entry_name, name_length);
+
+                    EnsureCapacity(batch.m_Data, entry_size);
+                    batch.m_Data.SetSize(batch.m_Data.Size() + entry_size);
+                    zr = dmZip::GetEntryData(zip, &batch.m_Data[entry.m_DataOffset], entry_size);
+
+                    EnsureCapacity(batch.m_Entries, 1);
+                    batch.m_Entries.Push(entry);
                 }
                 else {
                     dmLogError("Skipping resource %s from archive", entry_name);
@@ -110,8 +179,12 @@ namespace dmLiveUpdate
 
             dmZip::CloseEntry(zip);
         }
-        free((void*)entry_data);
-        return dmResource::RESULT_OK;
+
+        if (dmResource::RESULT_OK == result)
+        {
+            result = VerifyZipBatch(manifest, batch);
+        }
+        return result;
     }
 
     dmResource::Result VerifyZipArchive(const char* path, const char* public_key_path)
@@ -161,7 +234,7 @@ namespace dmLiveUpdate
 
         // TODO: What to do here. It is now ok for a liveupdate manifest/archive to not contain all the resources
         //      * We can require the manifest to only contain entries for the files in the archive
-        result = VerifyZipEntries(manifest, zip);
+        result = VerifyZipEntries(manifest, zip, VERIFY_BATCH_SIZE);
         if (dmResource::RESULT_OK != result)
         {
             dmLogError("Manifest references non existing resources");
@@ -17,10 +17,18 @@
 
 #include "liveupdate.h"
 #include <resource/resource.h>
+#include <resource/resource_manifest.h>
+#include <dlib/zip.h>
 
 namespace dmLiveUpdate
 {
+    // The entries are read into memory in batches, which are then hashed in parallel
+    const uint32_t VERIFY_BATCH_SIZE = 32 * 1024 * 1024;
+
     dmResource::Result VerifyZipArchive(const char* path, const char* public_key_path);
+
+    // Should be private, but is used in unit tests as well
+    dmResource::Result VerifyZipEntries(dmResource::HManifest manifest, dmZip::HZip zip, uint32_t batch_size);
 }
 
 #endif // DM_LIVEUPDATE_VERIFY_H
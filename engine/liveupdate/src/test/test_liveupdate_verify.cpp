@@ -0,0 +1,88 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <dlib/memory.h>
+#include <dlib/testutil.h>
+#include <dlib/zip.h>
+#include <resource/resource_manifest.h>
+
+#include "../liveupdate_verify.h"
+
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+
+class VerifyZipTest : public jc_test_base_class
+{
+public:
+    virtual void SetUp()
+    {
+        m_Zip = 0;
+        m_Manifest = 0;
+    }
+
+    virtual void TearDown()
+    {
+        if (m_Manifest)
+            dmResource::DeleteManifest(m_Manifest);
+        if (m_Zip)
+            dmZip::Close(m_Zip);
+    }
+
+    void Open(const char* name)
+    {
+        char path[1024];
+        dmTestUtil::MakeHostPathf(path, sizeof(path), "src/test/data/%s", name);
+        ASSERT_EQ(dmZip::RESULT_OK, dmZip::Open(path, &m_Zip));
+
+        uint32_t manifest_len = 0;
+        ASSERT_EQ(dmZip::RESULT_OK, dmZip::OpenEntry(m_Zip, "liveupdate.game.dmanifest"));
+        ASSERT_EQ(dmZip::RESULT_OK, dmZip::GetEntrySize(m_Zip, &manifest_len));
+        uint8_t* manifest_data = 0;
+        dmMemory::AlignedMalloc((void**)&manifest_data, 16, manifest_len);
+        ASSERT_EQ(dmZip::RESULT_OK, dmZip::GetEntryData(m_Zip, manifest_data, manifest_len));
+        dmZip::CloseEntry(m_Zip);
+
+        dmResource::Result result = dmResource::LoadManifestFromBuffer(manifest_data, manifest_len, &m_Manifest);
+        dmMemory::AlignedFree(manifest_data);
+        ASSERT_EQ(dmResource::RESULT_OK, result);
+    }
+
+    dmZip::HZip           m_Zip;
+    dmResource::HManifest m_Manifest;
+};
+
+TEST_F(VerifyZipTest, Valid)
+{
+    Open("defold.resourcepack_verify.zip");
+    ASSERT_EQ(dmResource::RESULT_OK, dmLiveUpdate::VerifyZipEntries(m_Manifest, m_Zip, dmLiveUpdate::VERIFY_BATCH_SIZE));
+    ASSERT_EQ(dmResource::RESULT_OK, dmLiveUpdate::VerifyZipEntries(m_Manifest, m_Zip, 512));
+}
+
+// The last entry of the archive is corrupt
+TEST_F(VerifyZipTest, CorruptLastEntry)
+{
+    Open("defold.resourcepack_verify_corrupt.zip");
+    // All entries in a single batch
+    ASSERT_NE(dmResource::RESULT_OK, dmLiveUpdate::VerifyZipEntries(m_Manifest, m_Zip, dmLiveUpdate::VERIFY_BATCH_SIZE));
+    // The entries are verified in batches of 448, 346, 769, and a trailing batch of 406 bytes holding the corrupt entry
+    ASSERT_NE(dmResource::RESULT_OK, dmLiveUpdate::VerifyZipEntries(m_Manifest, m_Zip, 512));
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
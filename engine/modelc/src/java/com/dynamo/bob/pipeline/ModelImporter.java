@@ -59,7 +59,7 @@ public class ModelImporter {
     }
 
     // The suffix of the path dictates which loader it will use
-    public static native Scene LoadFromBufferInternal(String path, byte[] buffer, Object data_resolver);
+    public static native Scene LoadFromBufferInternal(String path, byte[] buffer, Object data_resolver, int num_lods, float lod_reduction);
     public static native int AddressOf(Object o);
     public static native void TestException(String message);
 
@@ -73,9 +73,13 @@ public class ModelImporter {
 
     static public class Options {
         public int dummy;
+        public int lodCount;        // number of simplified lods to generate per mesh
+        public float lodReduction;  // target index count ratio between two consecutive lods
 
         public Options() {
             this.dummy = 0;
+            this.lodCount = 0;
+            this.lodReduction = 0.5f;
         }
     }
 
@@ -148,6 +152,12 @@ public class ModelImporter {
         }
     }
 
+    public static class MeshLod {
+        public int[]       indices; // references the vertices of the parent mesh
+        public int         indexCount;
+        public float       error; // relative to the radius of the mesh bounding sphere
+    }
+
     public static class Mesh {
         public String      name;
         public Material    material;
@@ -171,6 +181,8 @@ public class ModelImporter {
         public int         vertexCount;
         public int         indexCount;
 
+        public MeshLod[]   lods;
+
         public float[] getTexCoords(int index) {
             assert(index < 2);
             if (index == 1) {
@@ -252,7 +264,7 @@ public class ModelImporter {
 
     public static Scene LoadFromBuffer(Options options, String path, byte[] bytes, DataResolver data_resolver)
     {
-        return ModelImporter.LoadFromBufferInternal(path, bytes, data_resolver);
+        return ModelImporter.LoadFromBufferInternal(path, bytes, data_resolver, options.lodCount, options.lodReduction);
     }
 
     // ////////////////////////////////////////////////////////////////////////////////
@@ -370,6 +382,13 @@ public class ModelImporter {
         if (max_count > mesh.indexCount/3)
             max_count = mesh.indexCount/3;
         DebugPrintIntArray(indent+1, "indices", mesh.indices, max_count, 3);
+
+        if (mesh.lods != null) {
+            for (MeshLod lod : mesh.lods) {
+                PrintIndent(indent+1);
+                System.out.printf("Lod: %d indices, error: %f\n", lod.indexCount, lod.error);
+            }
+        }
     }
 
     private static void DebugPrintModel(Model model, int indent) {
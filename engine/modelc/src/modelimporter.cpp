@@ -54,11 +54,16 @@ namespace dmModelImporter
 {
 
 Options::Options()
+: m_NumLods(0)
+, m_LodReduction(0.5f)
 {
 }
 
 static void DestroyMesh(Mesh* mesh)
 {
+    for (uint32_t i = 0; i < mesh->m_LodsCount; ++i)
+        delete[] mesh->m_Lods[i].m_Indices;
+    delete[] mesh->m_Lods;
     delete[] mesh->m_Positions;
     delete[] mesh->m_Normals;
     delete[] mesh->m_Tangents;
@@ -254,6 +259,8 @@ Scene* LoadFromPath(Options* options, const char* path)
         return 0;
     }
 
+    GenerateLods(scene, options);
+
     free(data);
 
     return scene;
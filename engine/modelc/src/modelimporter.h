@@ -40,6 +40,13 @@ namespace dmModelImporter
         uint32_t    m_Index;        // The index into the scene.materials array
     };
 
+    struct MeshLod
+    {
+        uint32_t*   m_Indices;      // Simplified index list, referencing the vertices of the parent mesh
+        uint32_t    m_IndexCount;
+        float       m_Error;        // Geometric error, relative to the radius of the mesh bounding sphere
+    };
+
     struct Mesh
     {
         const char* m_Name;
@@ -61,6 +68,9 @@ namespace dmModelImporter
         uint32_t*   m_Indices;
         uint32_t    m_VertexCount;
         uint32_t    m_IndexCount;
+
+        MeshLod*    m_Lods;         // Generated simplified lods, in order of decreasing detail
+        uint32_t    m_LodsCount;
     };
 
     struct Model
@@ -180,7 +190,8 @@ namespace dmModelImporter
     {
         Options();
 
-        int dummy; // for the java binding to not be zero size
+        uint32_t    m_NumLods;      // Number of simplified lods to generate per mesh (0 = no lods)
+        float       m_LodReduction; // Target index count ratio between two consecutive lods
     };
 
 
@@ -206,6 +217,9 @@ namespace dmModelImporter
 
     extern "C" DM_DLLEXPORT void DestroyScene(Scene* scene);
 
+    // Generates the simplified lods for each mesh in the scene (see Options::m_NumLods)
+    extern "C" DM_DLLEXPORT void GenerateLods(Scene* scene, Options* options);
+
     // Used by the editor to create a standalone data blob suitable for reading
     // Caller owns the memory
     extern "C" DM_DLLEXPORT void* ConvertToProtobufMessage(Scene* scene, size_t* length);
@@ -162,6 +162,15 @@ struct MeshJNI
     jfieldID    indexCount;
 
     jfieldID    aabb;
+    jfieldID    lods;
+};
+
+struct MeshLodJNI
+{
+    jclass      cls;
+    jfieldID    indices;
+    jfieldID    indexCount;
+    jfieldID    error;
 };
 
 struct AabbJNI
@@ -227,6 +236,7 @@ struct TypeInfos
     MEMBER(NodeJNI);
     MEMBER(ModelJNI);
     MEMBER(MeshJNI);
+    MEMBER(MeshLodJNI);
     MEMBER(AabbJNI);
     MEMBER(Vec4JNI);
     MEMBER(TransformJNI);
@@ -353,6 +363,14 @@ static void InitializeJNITypes(JNIEnv* env, TypeInfos* infos)
         GET_FLD_TYPESTR(texCoords1NumComponents, "I");
         GET_FLD_TYPESTR(texCoords0, "[F");
         GET_FLD_TYPESTR(texCoords1, "[F");
+
+        GET_FLD_ARRAY(lods, "MeshLod");
+    }
+    {
+        SETUP_CLASS(MeshLodJNI, "MeshLod");
+        GET_FLD_TYPESTR(indices, "[I");
+        GET_FLD_TYPESTR(indexCount, "I");
+        GET_FLD_TYPESTR(error, "F");
     }
     {
         SETUP_CLASS(KeyFrameJNI, "KeyFrame");
@@ -638,6 +656,29 @@ static void FixupNodeReferences(JNIEnv* env, const TypeInfos* types, const dmMod
 // **************************************************
 // Meshes
 
+static jobject CreateMeshLod(JNIEnv* env, const TypeInfos* types, const dmModelImporter::MeshLod* lod)
+{
+    jobject obj = env->AllocObject(types->m_MeshLodJNI.cls);
+    jintArray arr = CreateIntArray(env, lod->m_IndexCount, (const int*)lod->m_Indices);
+    env->SetObjectField(obj, types->m_MeshLodJNI.indices, arr);
+    env->DeleteLocalRef(arr);
+    SetFieldInt(env, obj, types->m_MeshLodJNI.indexCount, lod->m_IndexCount);
+    env->SetFloatField(obj, types->m_MeshLodJNI.error, lod->m_Error);
+    return obj;
+}
+
+static jobjectArray CreateMeshLodsArray(JNIEnv* env, const TypeInfos* types, uint32_t count, const dmModelImporter::MeshLod* lods)
+{
+    jobjectArray arr = env->NewObjectArray(count, types->m_MeshLodJNI.cls, 0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        jobject o = CreateMeshLod(env, types, &lods[i]);
+        env->SetObjectArrayElement(arr, i, o);
+        env->DeleteLocalRef(o);
+    }
+    return arr;
+}
+
 static jobject CreateMesh(JNIEnv* env, const TypeInfos* types, const dmArray<jobject>& materials, const dmModelImporter::Mesh* mesh)
 {
     jobject obj = env->AllocObject(types->m_MeshJNI.cls);
@@ -682,6 +723,10 @@ static jobject CreateMesh(JNIEnv* env, const TypeInfos* types, const dmArray<job
 
     SetFieldObject(env, obj, types->m_MeshJNI.aabb, CreateAabb(env, types, mesh->m_Aabb));
 
+    jobjectArray lods = CreateMeshLodsArray(env, types, mesh->m_LodsCount, mesh->m_Lods);
+    env->SetObjectField(obj, types->m_MeshJNI.lods, lods);
+    env->DeleteLocalRef(lods);
+
 #undef SET_FARRAY
 #undef SET_UARRAY
 
@@ -978,7 +1023,7 @@ static jobject CreateJavaScene(JNIEnv* env, const dmModelImporter::Scene* scene)
 
 } // namespace
 
-static jobject LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jbyteArray array, jobject data_resolver)
+static jobject LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jbyteArray array, jobject data_resolver, jint num_lods, jfloat lod_reduction)
 {
     ScopedString j_path(env, _path);
     const char* path = j_path.m_String;
@@ -995,6 +1040,8 @@ static jobject LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jb
     jbyte* file_data = env->GetByteArrayElements(array, 0);
 
     dmModelImporter::Options options;
+    options.m_NumLods = num_lods;
+    options.m_LodReduction = lod_reduction;
     dmModelImporter::Scene* scene = dmModelImporter::LoadFromBuffer(&options, suffix, (uint8_t*)file_data, file_size);
 
     if (!scene)
@@ -1047,6 +1094,8 @@ static jobject LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jb
         dmModelImporter::Validate(scene);
     }
 
+    dmModelImporter::GenerateLods(scene, &options);
+
     if (dmLogGetLevel() == LOG_SEVERITY_DEBUG) // verbose mode
     {
         dmModelImporter::DebugScene(scene);
@@ -1061,14 +1110,14 @@ static jobject LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jb
     return jscene;
 }
 
-JNIEXPORT jobject JNICALL Java_ModelImporter_LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jbyteArray array, jobject data_resolver)
+JNIEXPORT jobject JNICALL Java_ModelImporter_LoadFromBufferInternal(JNIEnv* env, jclass cls, jstring _path, jbyteArray array, jobject data_resolver, jint num_lods, jfloat lod_reduction)
 {
     dmLogDebug("Java_ModelImporter_LoadFromBufferInternal: env = %p\n", env);
     dmJNI::SignalContextScope env_scope(env);
 
     jobject jscene;
     DM_JNI_GUARD_SCOPE_BEGIN();
-        jscene = LoadFromBufferInternal(env, cls, _path, array, data_resolver);
+        jscene = LoadFromBufferInternal(env, cls, _path, array, data_resolver, num_lods, lod_reduction);
     DM_JNI_GUARD_SCOPE_END(return 0;);
     return jscene;
 }
@@ -1107,7 +1156,7 @@ JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
     // Register your class' native methods.
     // Don't forget to add them to the corresponding java file (e.g. ModelImporter.java)
     static const JNINativeMethod methods[] = {
-        {"LoadFromBufferInternal", "(Ljava/lang/String;[BLjava/lang/Object;)L" CLASS_SCENE ";", reinterpret_cast<void*>(Java_ModelImporter_LoadFromBufferInternal)},
+        {"LoadFromBufferInternal", "(Ljava/lang/String;[BLjava/lang/Object;IF)L" CLASS_SCENE ";", reinterpret_cast<void*>(Java_ModelImporter_LoadFromBufferInternal)},
         {"AddressOf", "(Ljava/lang/Object;)I", reinterpret_cast<void*>(Java_ModelImporter_AddressOf)},
         {"TestException", "(Ljava/lang/String;)V", reinterpret_cast<void*>(Java_ModelImporter_TestException)},
     };
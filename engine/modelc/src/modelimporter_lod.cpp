@@ -0,0 +1,559 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// Mesh simplification, used for generating the lod chain of each mesh.
+//
+// It's a quadric error metric edge collapse, where a vertex is always collapsed onto one
+// of its neighbours ("vertex preserving"). This means that a lod is only a new index list,
+// and that it shares the vertex buffer with the original mesh.
+//
+// Vertices that share their position with another vertex (i.e. uv/normal seams), vertices on
+// open borders and non manifold vertices are never collapsed, which keeps the seams intact.
+// For skinned meshes, we only collapse vertices that are mainly influenced by the same bone.
+
+#include "modelimporter.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm> // std::sort
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/math.h>
+
+namespace dmModelImporter
+{
+
+static const uint32_t MAX_LOD_COUNT = 8;
+// Stop generating lods when a level cannot remove at least 10% of the triangles of the previous level
+static const float LOD_MIN_REDUCTION = 0.9f;
+static const uint32_t MAX_SIMPLIFY_PASSES = 100;
+
+struct Quadric
+{
+    // Symmetric 3x3 matrix A, vector b and scalar c: error(p) = (p'Ap + 2b'p + c) / w
+    double m_A00, m_A01, m_A02, m_A11, m_A12, m_A22;
+    double m_B0, m_B1, m_B2;
+    double m_C;
+    double m_W; // The sum of the plane weights, so the error becomes an average squared distance
+};
+
+struct CollapseCandidate
+{
+    uint32_t m_Vertex;
+    uint32_t m_Target;
+    float    m_Error;
+};
+
+struct CollapseCandidatePred
+{
+    bool operator() (const CollapseCandidate& a, const CollapseCandidate& b) const
+    {
+        return a.m_Error < b.m_Error;
+    }
+};
+
+struct Simplifier
+{
+    const float*        m_Positions;
+    uint32_t            m_VertexCount;
+    dmArray<uint32_t>   m_Indices;          // The current triangle list
+    dmArray<Quadric>    m_Quadrics;
+    dmArray<uint32_t>   m_PrimaryBone;      // The bone with the largest weight (or INVALID_INDEX)
+    dmArray<uint8_t>    m_Locked;           // Vertices that may never be collapsed
+
+    // Scratch data, recreated each pass
+    dmArray<uint32_t>   m_AdjacencyOffsets; // Vertex -> first entry in m_Adjacency
+    dmArray<uint32_t>   m_AdjacencyCounts;
+    dmArray<uint32_t>   m_Adjacency;        // Triangle indices
+    dmArray<uint32_t>   m_CollapseRemap;
+    dmArray<uint8_t>    m_Touched;
+    dmArray<CollapseCandidate> m_Candidates;
+
+    float               m_Error;            // The largest squared error introduced so far
+};
+
+template<typename T>
+static void SetSizeAndClear(dmArray<T>& array, uint32_t size)
+{
+    if (array.Capacity() < size)
+        array.SetCapacity(size);
+    array.SetSize(size);
+    memset(array.Begin(), 0, sizeof(T) * size);
+}
+
+static inline void Sub(const float* a, const float* b, float* out)
+{
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+static inline void Cross(const float* a, const float* b, float* out)
+{
+    out[0] = a[1]*b[2] - a[2]*b[1];
+    out[1] = a[2]*b[0] - a[0]*b[2];
+    out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static inline float Dot(const float* a, const float* b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static void TriangleNormal(const float* p0, const float* p1, const float* p2, float* out)
+{
+    float e0[3], e1[3];
+    Sub(p1, p0, e0);
+    Sub(p2, p0, e1);
+    Cross(e0, e1, out);
+}
+
+static void AddPlane(Quadric* q, const float* n, float d, float weight)
+{
+    q->m_A00 += weight * n[0] * n[0];
+    q->m_A01 += weight * n[0] * n[1];
+    q->m_A02 += weight * n[0] * n[2];
+    q->m_A11 += weight * n[1] * n[1];
+    q->m_A12 += weight * n[1] * n[2];
+    q->m_A22 += weight * n[2] * n[2];
+    q->m_B0  += weight * n[0] * d;
+    q->m_B1  += weight * n[1] * d;
+    q->m_B2  += weight * n[2] * d;
+    q->m_C   += weight * d * d;
+    q->m_W   += weight;
+}
+
+static void AddQuadric(Quadric* q, const Quadric* other)
+{
+    q->m_A00 += other->m_A00; q->m_A01 += other->m_A01; q->m_A02 += other->m_A02;
+    q->m_A11 += other->m_A11; q->m_A12 += other->m_A12; q->m_A22 += other->m_A22;
+    q->m_B0 += other->m_B0; q->m_B1 += other->m_B1; q->m_B2 += other->m_B2;
+    q->m_C += other->m_C;
+    q->m_W += other->m_W;
+}
+
+static float QuadricError(const Quadric* q, const float* p)
+{
+    double x = p[0], y = p[1], z = p[2];
+    double r = q->m_A00*x*x + q->m_A11*y*y + q->m_A22*z*z
+             + 2.0 * (q->m_A01*x*y + q->m_A02*x*z + q->m_A12*y*z)
+             + 2.0 * (q->m_B0*x + q->m_B1*y + q->m_B2*z)
+             + q->m_C;
+    if (r <= 0.0 || q->m_W <= 0.0)
+        return 0.0f;
+    return (float)(r / q->m_W);
+}
+
+static inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return ((uint64_t)a << 32) | b;
+}
+
+// Finds the unique positions, and locks all vertices that are part of a seam, an open border or a non manifold edge
+static void LockVertices(Simplifier* s)
+{
+    const uint32_t vertex_count = s->m_VertexCount;
+    SetSizeAndClear(s->m_Locked, vertex_count);
+
+    dmArray<uint32_t> position_remap;
+    SetSizeAndClear(position_remap, vertex_count);
+
+    dmHashTable64<uint32_t> positions;
+    positions.SetCapacity(dmMath::Max(1U, vertex_count / 2), vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        uint64_t key = dmHashBuffer64(&s->m_Positions[i*3], sizeof(float)*3);
+        uint32_t* first = positions.Get(key);
+        if (first)
+        {
+            position_remap[i] = *first;
+            s->m_Locked[i] = 1;         // a seam
+            s->m_Locked[*first] = 1;
+        }
+        else
+        {
+            position_remap[i] = i;
+            positions.Put(key, i);
+        }
+    }
+
+    // Count the directed edges (in position space). An edge without its opposite is an open border,
+    // and an edge used more than once is non manifold
+    uint32_t index_count = s->m_Indices.Size();
+    dmHashTable64<uint32_t> edges;
+    edges.SetCapacity(dmMath::Max(1U, index_count / 2), index_count);
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        for (uint32_t e = 0; e < 3; ++e)
+        {
+            uint32_t a = position_remap[s->m_Indices[i + e]];
+            uint32_t b = position_remap[s->m_Indices[i + (e+1)%3]];
+            uint64_t key = EdgeKey(a, b);
+            uint32_t* count = edges.Get(key);
+            if (count)
+                (*count)++;
+            else
+                edges.Put(key, 1);
+        }
+    }
+
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        for (uint32_t e = 0; e < 3; ++e)
+        {
+            uint32_t va = s->m_Indices[i + e];
+            uint32_t vb = s->m_Indices[i + (e+1)%3];
+            uint32_t a = position_remap[va];
+            uint32_t b = position_remap[vb];
+            uint32_t* count = edges.Get(EdgeKey(a, b));
+            uint32_t* opposite = edges.Get(EdgeKey(b, a));
+            if (*count != 1 || opposite == 0 || *opposite != 1)
+            {
+                s->m_Locked[va] = 1;
+                s->m_Locked[vb] = 1;
+            }
+        }
+    }
+}
+
+static void CalcPrimaryBones(Simplifier* s, const Mesh* mesh)
+{
+    const uint32_t vertex_count = s->m_VertexCount;
+    SetSizeAndClear(s->m_PrimaryBone, vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        uint32_t bone = INVALID_INDEX;
+        if (mesh->m_Bones && mesh->m_Weights)
+        {
+            float max_weight = 0.0f;
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                if (mesh->m_Weights[i*4 + j] > max_weight)
+                {
+                    max_weight = mesh->m_Weights[i*4 + j];
+                    bone = mesh->m_Bones[i*4 + j];
+                }
+            }
+        }
+        s->m_PrimaryBone[i] = bone;
+    }
+}
+
+static void CalcQuadrics(Simplifier* s)
+{
+    SetSizeAndClear(s->m_Quadrics, s->m_VertexCount);
+
+    uint32_t index_count = s->m_Indices.Size();
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        uint32_t i0 = s->m_Indices[i+0];
+        uint32_t i1 = s->m_Indices[i+1];
+        uint32_t i2 = s->m_Indices[i+2];
+        const float* p0 = &s->m_Positions[i0*3];
+
+        float n[3];
+        TriangleNormal(p0, &s->m_Positions[i1*3], &s->m_Positions[i2*3], n);
+        float length = sqrtf(Dot(n, n));
+        if (length == 0.0f)
+            continue;
+        n[0] /= length; n[1] /= length; n[2] /= length;
+
+        // Weight the plane with the triangle area, so that sliver triangles matter less
+        float weight = length * 0.5f;
+        float d = -Dot(n, p0);
+        AddPlane(&s->m_Quadrics[i0], n, d, weight);
+        AddPlane(&s->m_Quadrics[i1], n, d, weight);
+        AddPlane(&s->m_Quadrics[i2], n, d, weight);
+    }
+}
+
+static void BuildAdjacency(Simplifier* s)
+{
+    const uint32_t vertex_count = s->m_VertexCount;
+    const uint32_t index_count = s->m_Indices.Size();
+    SetSizeAndClear(s->m_AdjacencyCounts, vertex_count);
+    SetSizeAndClear(s->m_AdjacencyOffsets, vertex_count);
+    SetSizeAndClear(s->m_Adjacency, index_count);
+
+    for (uint32_t i = 0; i < index_count; ++i)
+        s->m_AdjacencyCounts[s->m_Indices[i]]++;
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        s->m_AdjacencyOffsets[i] = offset;
+        offset += s->m_AdjacencyCounts[i];
+        s->m_AdjacencyCounts[i] = 0;
+    }
+
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        uint32_t v = s->m_Indices[i];
+        s->m_Adjacency[s->m_AdjacencyOffsets[v] + s->m_AdjacencyCounts[v]++] = i / 3;
+    }
+}
+
+// Returns false if any of the remaining triangles around the vertex would flip (or collapse to zero area)
+static bool IsCollapseValid(const Simplifier* s, uint32_t vertex, uint32_t target)
+{
+    const uint32_t* triangles = &s->m_Adjacency[s->m_AdjacencyOffsets[vertex]];
+    uint32_t count = s->m_AdjacencyCounts[vertex];
+    const float* target_pos = &s->m_Positions[target*3];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t* tri = &s->m_Indices[triangles[i]*3];
+        if (tri[0] == target || tri[1] == target || tri[2] == target)
+            continue; // Will be removed
+
+        const float* p[3];
+        const float* p_new[3];
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            p[c] = &s->m_Positions[tri[c]*3];
+            p_new[c] = tri[c] == vertex ? target_pos : p[c];
+        }
+
+        float n_old[3], n_new[3];
+        TriangleNormal(p[0], p[1], p[2], n_old);
+        TriangleNormal(p_new[0], p_new[1], p_new[2], n_new);
+        if (Dot(n_old, n_new) <= 0.0f)
+            return false;
+    }
+    return true;
+}
+
+static uint32_t CountSharedTriangles(const Simplifier* s, uint32_t vertex, uint32_t target)
+{
+    const uint32_t* triangles = &s->m_Adjacency[s->m_AdjacencyOffsets[vertex]];
+    uint32_t count = s->m_AdjacencyCounts[vertex];
+    uint32_t shared = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t* tri = &s->m_Indices[triangles[i]*3];
+        if (tri[0] == target || tri[1] == target || tri[2] == target)
+            ++shared;
+    }
+    return shared;
+}
+
+// Finds the cheapest collapse for each vertex
+static void GatherCandidates(Simplifier* s)
+{
+    const uint32_t vertex_count = s->m_VertexCount;
+    dmArray<CollapseCandidate>& candidates = s->m_Candidates;
+    SetSizeAndClear(candidates, vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        candidates[i].m_Vertex = i;
+        candidates[i].m_Target = INVALID_INDEX;
+        candidates[i].m_Error = FLT_MAX;
+    }
+
+    const uint32_t index_count = s->m_Indices.Size();
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        for (uint32_t e = 0; e < 6; ++e)
+        {
+            // Both directions of each edge
+            uint32_t vertex = s->m_Indices[i + e % 3];
+            uint32_t target = s->m_Indices[i + (e < 3 ? (e+1) % 3 : (e+2) % 3)];
+            if (s->m_Locked[vertex] || s->m_PrimaryBone[vertex] != s->m_PrimaryBone[target])
+                continue;
+
+            float error = QuadricError(&s->m_Quadrics[vertex], &s->m_Positions[target*3]);
+            if (error < candidates[vertex].m_Error)
+            {
+                candidates[vertex].m_Target = target;
+                candidates[vertex].m_Error = error;
+            }
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        if (candidates[i].m_Target != INVALID_INDEX)
+            candidates[count++] = candidates[i];
+    }
+    candidates.SetSize(count);
+    std::sort(candidates.Begin(), candidates.End(), CollapseCandidatePred());
+}
+
+static void ApplyCollapses(Simplifier* s)
+{
+    const uint32_t index_count = s->m_Indices.Size();
+    uint32_t write = 0;
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        uint32_t i0 = s->m_CollapseRemap[s->m_Indices[i+0]];
+        uint32_t i1 = s->m_CollapseRemap[s->m_Indices[i+1]];
+        uint32_t i2 = s->m_CollapseRemap[s->m_Indices[i+2]];
+        if (i0 == i1 || i1 == i2 || i0 == i2)
+            continue;
+        s->m_Indices[write++] = i0;
+        s->m_Indices[write++] = i1;
+        s->m_Indices[write++] = i2;
+    }
+    s->m_Indices.SetSize(write);
+}
+
+// Returns the number of collapses made
+static uint32_t SimplifyPass(Simplifier* s, uint32_t target_index_count)
+{
+    const uint32_t vertex_count = s->m_VertexCount;
+    BuildAdjacency(s);
+    GatherCandidates(s);
+
+    SetSizeAndClear(s->m_Touched, vertex_count);
+    SetSizeAndClear(s->m_CollapseRemap, vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i)
+        s->m_CollapseRemap[i] = i;
+
+    uint32_t triangle_count = s->m_Indices.Size() / 3;
+    uint32_t target_triangle_count = target_index_count / 3;
+    uint32_t num_collapses = 0;
+
+    // Only allow a fraction of the candidates per pass, so that the cheapest collapses are done first
+    uint32_t max_collapses = dmMath::Max(1U, s->m_Candidates.Size() / 4);
+
+    for (uint32_t i = 0; i < s->m_Candidates.Size() && num_collapses < max_collapses; ++i)
+    {
+        if (triangle_count <= target_triangle_count)
+            break;
+
+        const CollapseCandidate& c = s->m_Candidates[i];
+        // A vertex whose neighbourhood has changed this pass needs a new error estimate, so we wait until the next pass
+        if (s->m_Touched[c.m_Vertex] || s->m_Touched[c.m_Target])
+            continue;
+
+        if (!IsCollapseValid(s, c.m_Vertex, c.m_Target))
+            continue;
+
+        s->m_CollapseRemap[c.m_Vertex] = c.m_Target;
+        AddQuadric(&s->m_Quadrics[c.m_Target], &s->m_Quadrics[c.m_Vertex]);
+        s->m_Error = dmMath::Max(s->m_Error, c.m_Error);
+        triangle_count -= CountSharedTriangles(s, c.m_Vertex, c.m_Target);
+        ++num_collapses;
+
+        const uint32_t* triangles = &s->m_Adjacency[s->m_AdjacencyOffsets[c.m_Vertex]];
+        uint32_t count = s->m_AdjacencyCounts[c.m_Vertex];
+        for (uint32_t t = 0; t < count; ++t)
+        {
+            const uint32_t* tri = &s->m_Indices[triangles[t]*3];
+            s->m_Touched[tri[0]] = 1;
+            s->m_Touched[tri[1]] = 1;
+            s->m_Touched[tri[2]] = 1;
+        }
+    }
+
+    if (num_collapses)
+        ApplyCollapses(s);
+    return num_collapses;
+}
+
+static void Simplify(Simplifier* s, uint32_t target_index_count)
+{
+    for (uint32_t pass = 0; pass < MAX_SIMPLIFY_PASSES; ++pass)
+    {
+        if (s->m_Indices.Size() <= target_index_count)
+            break;
+        if (SimplifyPass(s, target_index_count) == 0)
+            break;
+    }
+}
+
+static float CalcRadius(const Mesh* mesh)
+{
+    float d[3];
+    Sub(mesh->m_Aabb.m_Max, mesh->m_Aabb.m_Min, d);
+    return sqrtf(Dot(d, d)) * 0.5f;
+}
+
+static void GenerateMeshLods(Mesh* mesh, uint32_t num_lods, float reduction)
+{
+    if (!mesh->m_Positions || !mesh->m_Indices || mesh->m_IndexCount < 3)
+        return;
+
+    float radius = CalcRadius(mesh);
+    if (radius <= 0.0f)
+        return;
+
+    Simplifier s;
+    s.m_Positions = mesh->m_Positions;
+    s.m_VertexCount = mesh->m_VertexCount;
+    s.m_Error = 0.0f;
+    s.m_Indices.SetCapacity(mesh->m_IndexCount);
+    s.m_Indices.SetSize(mesh->m_IndexCount);
+    memcpy(s.m_Indices.Begin(), mesh->m_Indices, sizeof(uint32_t) * mesh->m_IndexCount);
+
+    LockVertices(&s);
+    CalcPrimaryBones(&s, mesh);
+    CalcQuadrics(&s);
+
+    MeshLod lods[MAX_LOD_COUNT];
+    uint32_t lod_count = 0;
+    uint32_t prev_index_count = mesh->m_IndexCount;
+    for (uint32_t i = 0; i < num_lods; ++i)
+    {
+        // The lods are generated in sequence, so each lod is a further simplification of the previous one
+        uint32_t target_index_count = (uint32_t)(prev_index_count * reduction) / 3 * 3;
+        Simplify(&s, target_index_count);
+
+        uint32_t index_count = s.m_Indices.Size();
+        if (index_count == 0 || index_count > prev_index_count * LOD_MIN_REDUCTION)
+            break;
+
+        MeshLod& lod = lods[lod_count++];
+        lod.m_IndexCount = index_count;
+        lod.m_Indices = new uint32_t[index_count];
+        memcpy(lod.m_Indices, s.m_Indices.Begin(), sizeof(uint32_t) * index_count);
+        lod.m_Error = sqrtf(s.m_Error) / radius;
+
+        prev_index_count = index_count;
+    }
+
+    mesh->m_LodsCount = lod_count;
+    mesh->m_Lods = 0;
+    if (lod_count)
+    {
+        mesh->m_Lods = new MeshLod[lod_count];
+        memcpy(mesh->m_Lods, lods, sizeof(MeshLod) * lod_count);
+    }
+
+    dmLogDebug("Mesh '%s': generated %u lods from %u indices", mesh->m_Name, lod_count, mesh->m_IndexCount);
+}
+
+void GenerateLods(Scene* scene, Options* options)
+{
+    uint32_t num_lods = dmMath::Min(options->m_NumLods, MAX_LOD_COUNT);
+    float reduction = options->m_LodReduction;
+    if (num_lods == 0 || reduction <= 0.0f || reduction >= 1.0f)
+        return;
+
+    for (uint32_t i = 0; i < scene->m_ModelsCount; ++i)
+    {
+        Model* model = &scene->m_Models[i];
+        for (uint32_t j = 0; j < model->m_MeshesCount; ++j)
+        {
+            Mesh* mesh = &model->m_Meshes[j];
+            if (mesh->m_LodsCount == 0)
+                GenerateMeshLods(mesh, num_lods, reduction);
+        }
+    }
+}
+
+}
@@ -177,6 +177,46 @@ TEST(ModelGLTF, ExternalBuffer)
     dmModelImporter::DestroyScene(scene);
 }
 
+TEST(ModelGLTF, GenerateLods)
+{
+    dmModelImporter::Options options;
+    options.m_NumLods = 3;
+    options.m_LodReduction = 0.5f;
+    dmModelImporter::Scene* scene = LoadScene("./src/test/assets/car01.glb", options);
+    ASSERT_NE((dmModelImporter::Scene*)0, scene);
+
+    uint32_t num_lods = 0;
+    for (uint32_t m = 0; m < scene->m_ModelsCount; ++m)
+    {
+        dmModelImporter::Model* model = &scene->m_Models[m];
+        for (uint32_t i = 0; i < model->m_MeshesCount; ++i)
+        {
+            dmModelImporter::Mesh* mesh = &model->m_Meshes[i];
+            ASSERT_GE(options.m_NumLods, mesh->m_LodsCount);
+
+            uint32_t prev_index_count = mesh->m_IndexCount;
+            float prev_error = 0.0f;
+            for (uint32_t l = 0; l < mesh->m_LodsCount; ++l)
+            {
+                dmModelImporter::MeshLod* lod = &mesh->m_Lods[l];
+                ASSERT_LT(lod->m_IndexCount, prev_index_count);
+                ASSERT_EQ(0u, lod->m_IndexCount % 3);
+                ASSERT_GE(lod->m_Error, prev_error);
+                for (uint32_t j = 0; j < lod->m_IndexCount; ++j)
+                {
+                    ASSERT_LT(lod->m_Indices[j], mesh->m_VertexCount);
+                }
+                prev_index_count = lod->m_IndexCount;
+                prev_error = lod->m_Error;
+            }
+            num_lods += mesh->m_LodsCount;
+        }
+    }
+    ASSERT_LT(0u, num_lods);
+
+    dmModelImporter::DestroyScene(scene);
+}
+
 // Some tests are simply loading the file to make sure it doesn't crash
 
 static dmModelImporter::Scene* TestLoading(const char* path)
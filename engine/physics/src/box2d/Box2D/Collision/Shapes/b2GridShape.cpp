@@ -8,8 +8,36 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2World.h>
 #include <new>
+#include <algorithm>
 using namespace std;
 
+static const uint32 REGION_CHUNK_SHIFT = 8;
+static const uint32 REGION_CHUNK_SIZE = 1 << REGION_CHUNK_SHIFT;
+// Changed cells are tracked one by one up to this many, or one in 16 cells for larger grids.
+// Past that all regions are rebuilt, which is cheaper than going through the changes.
+static const uint32 MIN_DIRTY_RECT_COUNT = 64;
+// The changes of a large update aren't kept around
+static const uint32 MAX_KEPT_DIRTY_RECT_CAPACITY = 256;
+
+// A hull can be merged with its neighbours if it covers the whole cell, regardless of flip and rotation
+static bool IsBoxHull(const b2HullSet* hullSet, uint32 hullIndex)
+{
+    const float32 epsilon = 0.001f;
+    const b2HullSet::Hull& hull = hullSet->m_hulls[hullIndex];
+    if (hull.m_Count != 4)
+        return false;
+
+    uint32 corners = 0;
+    for (uint32 i = 0; i < hull.m_Count; ++i)
+    {
+        const b2Vec2& v = hullSet->m_vertices[hull.m_Index + i];
+        if (b2Abs(b2Abs(v.x) - 0.5f) > epsilon || b2Abs(b2Abs(v.y) - 0.5f) > epsilon)
+            return false;
+        corners |= 1 << ((v.x > 0.0f ? 1 : 0) + (v.y > 0.0f ? 2 : 0));
+    }
+    return corners == 0xf;
+}
+
 b2GridShape::b2GridShape(const b2HullSet* hullSet,
                          const b2Vec2 position,
                          float32 cellWidth, float32 cellHeight,
@@ -26,6 +54,30 @@ b2GridShape::b2GridShape(const b2HullSet* hullSet,
     size = sizeof(CellFlags) * cellCount;
     m_cellFlags = (CellFlags*) b2Alloc(size);
     memset(m_cellFlags, 0x0, size);
+    size = sizeof(uint32) * cellCount;
+    m_cellRegions = (uint32*) b2Alloc(size);
+    memset(m_cellRegions, 0xff, size);
+
+    m_hullIsBox = (uint8*) b2Alloc(b2Max(1u, hullSet->m_hullCount));
+    for (uint32 i = 0; i < hullSet->m_hullCount; ++i)
+    {
+        m_hullIsBox[i] = IsBoxHull(hullSet, i);
+    }
+
+    m_regionChunks = 0;
+    m_regionChunkCount = 0;
+    m_regionSlotCount = 0;
+    m_regionCount = 0;
+    m_freeRegion = B2GRIDSHAPE_EMPTY_CELL;
+
+    size = sizeof(uint32) * b2Max(1u, (cellCount + 31) / 32);
+    m_dirtyCells = (uint32*) b2Alloc(size);
+    memset(m_dirtyCells, 0, size);
+    m_dirtyRects = 0;
+    m_dirtyRectCount = 0;
+    m_dirtyRectCapacity = 0;
+    m_dirty = 0;
+    m_hasProxies = 0;
 
     m_position = position;
     m_type = e_grid;
@@ -35,8 +87,26 @@ b2GridShape::b2GridShape(const b2HullSet* hullSet,
 
 b2GridShape::~b2GridShape()
 {
+    for (uint32 i = 0; i < m_regionSlotCount; ++i)
+    {
+        Region* region = GetRegion(i);
+        if (region->m_polygon)
+        {
+            region->m_polygon->~b2PolygonShape();
+            b2Free(region->m_polygon);
+        }
+    }
+    for (uint32 i = 0; i < m_regionChunkCount; ++i)
+    {
+        b2Free(m_regionChunks[i]);
+    }
+    b2Free(m_regionChunks);
     b2Free(m_cells);
     b2Free(m_cellFlags);
+    b2Free(m_cellRegions);
+    b2Free(m_hullIsBox);
+    b2Free(m_dirtyCells);
+    b2Free(m_dirtyRects);
 }
 
 b2Shape* b2GridShape::Clone(b2BlockAllocator* allocator) const
@@ -63,37 +133,36 @@ bool b2GridShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 {
     if (!m_enabled)
         return false;
-    const b2GridShape::Cell& cell = m_cells[childIndex];
-    if (cell.m_Index == B2GRIDSHAPE_EMPTY_CELL)
+    const b2PolygonShape* polyShape = GetPolygonShapeForChild(childIndex);
+    if (polyShape == NULL)
     {
         return false;
     }
 
-    b2PolygonShape polyShape;
-    GetPolygonShapeForCell(childIndex, polyShape);
-    return polyShape.RayCast(output, input, transform, childIndex);
+    return polyShape->RayCast(output, input, transform, childIndex);
 }
 
 void b2GridShape::ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const
 {
-    const b2GridShape::Cell& cell = m_cells[childIndex];
-    if (cell.m_Index == B2GRIDSHAPE_EMPTY_CELL)
+    if (!IsRegionChild(childIndex))
     {
         aabb->lowerBound = b2Vec2(FLT_MAX, FLT_MAX);
         aabb->upperBound = b2Vec2(-FLT_MAX, -FLT_MAX);
         return;
     }
 
-    int row = childIndex / m_columnCount;
-    int col = childIndex - m_columnCount * row;
+    ComputeRegionAABB(aabb, transform, GetRegion(m_cellRegions[childIndex]));
+}
 
+void b2GridShape::ComputeRegionAABB(b2AABB* aabb, const b2Transform& transform, const Region* region) const
+{
     b2Vec2 halfDims(m_cellWidth * m_columnCount * 0.5f, m_cellHeight * m_rowCount * 0.5f);
     b2Vec2 offset = m_position - halfDims;
 
-    float32 x0 = m_cellWidth * col - m_radius;
-    float32 x1 = m_cellWidth * (col + 1) + m_radius;
-    float32 y0 = m_cellHeight * row - m_radius;
-    float32 y1 = m_cellHeight * (row + 1) + m_radius;
+    float32 x0 = m_cellWidth * region->m_column - m_radius;
+    float32 x1 = m_cellWidth * (region->m_column + region->m_columnCount) + m_radius;
+    float32 y0 = m_cellHeight * region->m_row - m_radius;
+    float32 y1 = m_cellHeight * (region->m_row + region->m_rowCount) + m_radius;
 
     b2Vec2 v00 = b2Mul(transform, b2Vec2(x0, y0) + offset);
     b2Vec2 v10 = b2Mul(transform, b2Vec2(x1, y0) + offset);
@@ -385,11 +454,17 @@ uint32 b2GridShape::CalculateCellMask(b2Fixture* fixture, uint32 row, uint32 col
     return mask;
 }
 
-void b2GridShape::ClearCellData()
+void b2GridShape::ClearCellData(b2Body* body)
 {
     uint32 cellCount = m_rowCount * m_columnCount;
     memset(m_cells, B2GRIDSHAPE_EMPTY_CELL, sizeof(Cell) * cellCount);
     memset(m_cellFlags, 0x0, sizeof(CellFlags) * cellCount);
+
+    if (cellCount > 0)
+    {
+        SetAllCellsDirty();
+        body->FlagGridForUpdate();
+    }
 }
 
 void b2GridShape::SetCellHull(b2Body* body, uint32 row, uint32 column, uint32 hull, b2GridShape::CellFlags flags)
@@ -409,5 +484,342 @@ void b2GridShape::SetCellHull(b2Body* body, uint32 row, uint32 column, uint32 hu
             cell->m_Index = B2GRIDSHAPE_EMPTY_CELL;
     }
 
-    body->SynchronizeSingle(this, index);
+    SetCellDirty(row, column);
+    body->FlagGridForUpdate();
+}
+
+b2GridShape::Region* b2GridShape::GetRegion(uint32 region) const
+{
+    return m_regionChunks[region >> REGION_CHUNK_SHIFT] + (region & (REGION_CHUNK_SIZE - 1));
+}
+
+const b2GridShape::Region* b2GridShape::GetCellRegion(uint32 index) const
+{
+    uint32 region = m_cellRegions[index];
+    return region != B2GRIDSHAPE_EMPTY_CELL ? GetRegion(region) : NULL;
+}
+
+bool b2GridShape::IsRegionChild(int32 childIndex) const
+{
+    uint32 region = m_cellRegions[childIndex];
+    return region != B2GRIDSHAPE_EMPTY_CELL && GetRegion(region)->m_proxy.childIndex == childIndex;
+}
+
+int32 b2GridShape::GetProxyId(int32 childIndex) const
+{
+    if (!IsRegionChild(childIndex))
+        return b2BroadPhase::e_nullProxy;
+    return GetRegion(m_cellRegions[childIndex])->m_proxy.proxyId;
+}
+
+uint32 b2GridShape::NewRegion()
+{
+    uint32 region = m_freeRegion;
+    if (region != B2GRIDSHAPE_EMPTY_CELL)
+    {
+        m_freeRegion = GetRegion(region)->m_nextFree;
+    }
+    else
+    {
+        if (m_regionSlotCount == m_regionChunkCount * REGION_CHUNK_SIZE)
+        {
+            Region** chunks = (Region**) b2Alloc((m_regionChunkCount + 1) * sizeof(Region*));
+            if (m_regionChunks)
+            {
+                memcpy(chunks, m_regionChunks, m_regionChunkCount * sizeof(Region*));
+                b2Free(m_regionChunks);
+            }
+            chunks[m_regionChunkCount++] = (Region*) b2Alloc(REGION_CHUNK_SIZE * sizeof(Region));
+            m_regionChunks = chunks;
+        }
+        region = m_regionSlotCount++;
+    }
+    ++m_regionCount;
+    return region;
+}
+
+void b2GridShape::DeleteRegion(b2BroadPhase* broadPhase, uint32 regionIndex)
+{
+    Region* region = GetRegion(regionIndex);
+    if (region->m_proxy.proxyId != b2BroadPhase::e_nullProxy)
+    {
+        broadPhase->DestroyProxy(region->m_proxy.proxyId);
+        region->m_proxy.proxyId = b2BroadPhase::e_nullProxy;
+    }
+    if (region->m_polygon)
+    {
+        region->m_polygon->~b2PolygonShape();
+        b2Free(region->m_polygon);
+        region->m_polygon = NULL;
+    }
+    region->m_rowCount = 0;
+    region->m_columnCount = 0;
+    region->m_nextFree = m_freeRegion;
+    m_freeRegion = regionIndex;
+    --m_regionCount;
+}
+
+const b2PolygonShape* b2GridShape::GetPolygonShapeForChild(int32 childIndex) const
+{
+    if (!m_enabled || !IsRegionChild(childIndex))
+        return NULL;
+
+    Region* region = GetRegion(m_cellRegions[childIndex]);
+    if (region->m_polygon == NULL)
+    {
+        b2PolygonShape* polygon = new (b2Alloc(sizeof(b2PolygonShape))) b2PolygonShape();
+        if (region->m_rowCount == 1 && region->m_columnCount == 1)
+        {
+            GetPolygonShapeForCell(childIndex, *polygon);
+        }
+        else
+        {
+            b2Vec2 halfDims(m_cellWidth * m_columnCount * 0.5f, m_cellHeight * m_rowCount * 0.5f);
+            b2Vec2 halfExtents(m_cellWidth * region->m_columnCount * 0.5f, m_cellHeight * region->m_rowCount * 0.5f);
+            b2Vec2 corner(m_cellWidth * region->m_column, m_cellHeight * region->m_row);
+            polygon->SetAsBox(halfExtents.x, halfExtents.y, m_position - halfDims + corner + halfExtents, 0.0f);
+            polygon->m_radius = m_radius;
+        }
+        region->m_polygon = polygon;
+    }
+    return region->m_polygon;
+}
+
+void b2GridShape::SetCellDirty(uint32 row, uint32 column)
+{
+    uint32 index = row * m_columnCount + column;
+    uint32 bit = 1u << (index & 31);
+    if (m_dirtyCells[index >> 5] & bit)
+        return;
+
+    if (m_dirty && m_dirtyRects[0].m_rowCount == m_rowCount && m_dirtyRects[0].m_columnCount == m_columnCount)
+        return; // Already rebuilding all regions
+    if (m_dirtyRectCount >= b2Max(MIN_DIRTY_RECT_COUNT, m_rowCount * m_columnCount / 16))
+    {
+        SetAllCellsDirty();
+        return;
+    }
+
+    m_dirtyCells[index >> 5] |= bit;
+    PushDirtyRect(row, column, 1, 1);
+    m_dirty = 1;
+}
+
+void b2GridShape::SetAllCellsDirty()
+{
+    // The cells changed before don't need to be tracked separately
+    memset(m_dirtyCells, 0, sizeof(uint32) * ((m_rowCount * m_columnCount + 31) / 32));
+    m_dirtyRectCount = 0;
+    PushDirtyRect(0, 0, m_rowCount, m_columnCount);
+    m_dirty = 1;
+}
+
+bool b2GridShape::DirtyRectLessThan(const DirtyRect& a, const DirtyRect& b)
+{
+    return a.m_row < b.m_row || (a.m_row == b.m_row && a.m_column < b.m_column);
+}
+
+void b2GridShape::PushDirtyRect(uint32 row, uint32 column, uint32 rowCount, uint32 columnCount)
+{
+    if (m_dirtyRectCount == m_dirtyRectCapacity)
+    {
+        m_dirtyRectCapacity = b2Max(16u, m_dirtyRectCapacity * 2);
+        DirtyRect* rects = (DirtyRect*) b2Alloc(m_dirtyRectCapacity * sizeof(DirtyRect));
+        if (m_dirtyRects)
+        {
+            memcpy(rects, m_dirtyRects, m_dirtyRectCount * sizeof(DirtyRect));
+            b2Free(m_dirtyRects);
+        }
+        m_dirtyRects = rects;
+    }
+    DirtyRect& rect = m_dirtyRects[m_dirtyRectCount++];
+    rect.m_row = row;
+    rect.m_column = column;
+    rect.m_rowCount = rowCount;
+    rect.m_columnCount = columnCount;
+}
+
+bool b2GridShape::CanMergeCell(const b2Fixture* fixture, uint32 index, uint32 hull, const b2Filter& filter) const
+{
+    if (m_cells[index].m_Index != hull || m_cellRegions[index] != B2GRIDSHAPE_EMPTY_CELL)
+        return false;
+
+    const b2Filter& cellFilter = fixture->GetFilterData(index);
+    return cellFilter.categoryBits == filter.categoryBits &&
+           cellFilter.maskBits == filter.maskBits &&
+           cellFilter.groupIndex == filter.groupIndex;
+}
+
+void b2GridShape::UpdateRegions(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf)
+{
+    if (!m_dirty)
+        return;
+    m_dirty = 0;
+
+    // Remove the regions overlapping the changed cells, or their neighbours so that a refilled cell is merged
+    // with the regions around it. The cells of a removed region are merged again below, the rest are left as is.
+    const uint32 changedCount = m_dirtyRectCount;
+    for (uint32 i = 0; i < changedCount; ++i)
+    {
+        const DirtyRect changed = m_dirtyRects[i];
+        const uint32 minRow = changed.m_row > 0 ? changed.m_row - 1 : 0;
+        const uint32 maxRow = b2Min(changed.m_row + changed.m_rowCount, m_rowCount - 1);
+        const uint32 minColumn = changed.m_column > 0 ? changed.m_column - 1 : 0;
+        const uint32 maxColumn = b2Min(changed.m_column + changed.m_columnCount, m_columnCount - 1);
+
+        for (uint32 row = minRow; row <= maxRow; ++row)
+        {
+            for (uint32 column = minColumn; column <= maxColumn; ++column)
+            {
+                uint32 index = row * m_columnCount + column;
+                m_dirtyCells[index >> 5] &= ~(1u << (index & 31));
+
+                uint32 regionIndex = m_cellRegions[index];
+                if (regionIndex == B2GRIDSHAPE_EMPTY_CELL)
+                    continue;
+
+                Region* region = GetRegion(regionIndex);
+                for (uint32 r = 0; r < region->m_rowCount; ++r)
+                {
+                    memset(&m_cellRegions[(region->m_row + r) * m_columnCount + region->m_column], 0xff, region->m_columnCount * sizeof(uint32));
+                }
+                PushDirtyRect(region->m_row, region->m_column, region->m_rowCount, region->m_columnCount);
+                DeleteRegion(broadPhase, regionIndex);
+            }
+        }
+    }
+
+    // Start with the lowest rows, so that runs of cells are merged from their bottom left cell, as when merging the whole grid
+    std::sort(m_dirtyRects, m_dirtyRects + m_dirtyRectCount, DirtyRectLessThan);
+    for (uint32 i = 0; i < m_dirtyRectCount; ++i)
+    {
+        MergeCells(fixture, broadPhase, xf, m_dirtyRects[i]);
+    }
+    m_dirtyRectCount = 0;
+
+    if (m_dirtyRectCapacity > MAX_KEPT_DIRTY_RECT_CAPACITY)
+    {
+        b2Free(m_dirtyRects);
+        m_dirtyRects = 0;
+        m_dirtyRectCapacity = 0;
+    }
+}
+
+// Every non-empty cell without a region is waiting to be merged, so the regions may grow past the rectangle
+void b2GridShape::MergeCells(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf, const DirtyRect& rect)
+{
+    const uint32 endRow = rect.m_row + rect.m_rowCount;
+    const uint32 endColumn = rect.m_column + rect.m_columnCount;
+
+    // Greedy rectangle merge: grow each region first along the row, then upwards as long as
+    // every cell of the next row can be merged as well
+    for (uint32 row = rect.m_row; row < endRow; ++row)
+    {
+        for (uint32 column = rect.m_column; column < endColumn; ++column)
+        {
+            uint32 index = row * m_columnCount + column;
+            uint32 hull = m_cells[index].m_Index;
+            if (hull == B2GRIDSHAPE_EMPTY_CELL || m_cellRegions[index] != B2GRIDSHAPE_EMPTY_CELL)
+                continue;
+
+            uint32 rowCount = 1;
+            uint32 columnCount = 1;
+            if (m_hullIsBox[hull])
+            {
+                const b2Filter& filter = fixture->GetFilterData(index);
+                while (column + columnCount < m_columnCount && CanMergeCell(fixture, index + columnCount, hull, filter))
+                {
+                    ++columnCount;
+                }
+                while (row + rowCount < m_rowCount)
+                {
+                    uint32 rowIndex = index + rowCount * m_columnCount;
+                    uint32 c = 0;
+                    while (c < columnCount && CanMergeCell(fixture, rowIndex + c, hull, filter))
+                    {
+                        ++c;
+                    }
+                    if (c < columnCount)
+                        break;
+                    ++rowCount;
+                }
+            }
+
+            uint32 regionIndex = NewRegion();
+            Region* region = GetRegion(regionIndex);
+            region->m_proxy.fixture = fixture;
+            region->m_proxy.childIndex = index;
+            region->m_proxy.proxyId = b2BroadPhase::e_nullProxy;
+            region->m_polygon = NULL;
+            region->m_row = row;
+            region->m_column = column;
+            region->m_rowCount = rowCount;
+            region->m_columnCount = columnCount;
+            region->m_nextFree = B2GRIDSHAPE_EMPTY_CELL;
+            for (uint32 r = 0; r < rowCount; ++r)
+            {
+                uint32* cellRegions = &m_cellRegions[index + r * m_columnCount];
+                for (uint32 c = 0; c < columnCount; ++c)
+                {
+                    cellRegions[c] = regionIndex;
+                }
+            }
+
+            if (m_hasProxies)
+            {
+                ComputeRegionAABB(&region->m_proxy.aabb, xf, region);
+                region->m_proxy.proxyId = broadPhase->CreateProxy(region->m_proxy.aabb, &region->m_proxy);
+            }
+            column += columnCount - 1;
+        }
+    }
+}
+
+void b2GridShape::CreateProxies(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf)
+{
+    b2Assert(!m_hasProxies);
+    UpdateRegions(fixture, broadPhase, xf);
+
+    for (uint32 i = 0; i < m_regionSlotCount; ++i)
+    {
+        Region* region = GetRegion(i);
+        if (region->m_rowCount == 0)
+            continue;
+        ComputeRegionAABB(&region->m_proxy.aabb, xf, region);
+        region->m_proxy.proxyId = broadPhase->CreateProxy(region->m_proxy.aabb, &region->m_proxy);
+    }
+    m_hasProxies = 1;
+}
+
+void b2GridShape::DestroyProxies(b2BroadPhase* broadPhase)
+{
+    for (uint32 i = 0; i < m_regionSlotCount; ++i)
+    {
+        Region* region = GetRegion(i);
+        if (region->m_rowCount == 0)
+            continue;
+        broadPhase->DestroyProxy(region->m_proxy.proxyId);
+        region->m_proxy.proxyId = b2BroadPhase::e_nullProxy;
+    }
+    m_hasProxies = 0;
+}
+
+void b2GridShape::Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2)
+{
+    if (!m_hasProxies)
+        return;
+
+    b2Vec2 displacement = xf2.p - xf1.p;
+    for (uint32 i = 0; i < m_regionSlotCount; ++i)
+    {
+        Region* region = GetRegion(i);
+        if (region->m_rowCount == 0)
+            continue;
+
+        b2AABB aabb1, aabb2;
+        ComputeRegionAABB(&aabb1, xf1, region);
+        ComputeRegionAABB(&aabb2, xf2, region);
+        region->m_proxy.aabb.Combine(aabb1, aabb2);
+        broadPhase->MoveProxy(region->m_proxy.proxyId, region->m_proxy.aabb, displacement);
+    }
 }
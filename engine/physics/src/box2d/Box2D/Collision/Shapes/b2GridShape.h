@@ -3,7 +3,9 @@
 
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Collision/Shapes/b2Shape.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
 #include <string.h>
 
 struct b2HullSet
@@ -75,6 +77,26 @@ public:
         uint8 m_Padding : 5;
     };
 
+    /*
+     * A rectangle of cells sharing a single broad-phase proxy. Runs of cells with the same full box hull
+     * and the same filter are merged into one region, any other non-empty cell gets a region of its own.
+     * Empty cells have no region, and thus no proxy.
+     * The child index of a region is the index of its bottom left cell, so that filters and
+     * contacts are still addressed by cell.
+     */
+    struct Region
+    {
+        b2FixtureProxy  m_proxy;
+        // Created on first use, see GetPolygonShapeForChild()
+        b2PolygonShape* m_polygon;
+        uint32          m_row;
+        uint32          m_column;
+        // Zero for unused regions
+        uint32          m_rowCount;
+        uint32          m_columnCount;
+        uint32          m_nextFree;
+    };
+
     b2GridShape(const b2HullSet* hullSet,
                 const b2Vec2 position,
                 float32 cellWidth, float32 cellHeight,
@@ -100,12 +122,23 @@ public:
     void GetPolygonShapeForCell(uint32 index, b2PolygonShape& polyShape) const;
     uint32 GetEdgeShapesForCell(uint32 index, b2EdgeShape* edgeShapes, uint32 edgeShapeCount, uint32 edgeMask) const;
 
+    /// Get the (cached) polygon of the region with the given child index.
+    /// Returns NULL if there is no region for the child index, e.g. for contacts of a removed region.
+    const b2PolygonShape* GetPolygonShapeForChild(int32 childIndex) const;
+
+    /// The regions are rebuilt at the start of the next world step, or when the body is activated.
     void SetCellHull(b2Body* body, uint32 row, uint32 column, uint32 hull, CellFlags flags);
 
-    void ClearCellData();
+    void ClearCellData(b2Body* body);
 
     uint32 CalculateCellMask(b2Fixture* fixture, uint32 row, uint32 column);
 
+    /// Get the number of regions, i.e. broad-phase proxies, of the grid.
+    uint32 GetRegionCount() const { return m_regionCount; }
+
+    /// Get the region of a cell. Returns NULL for empty cells, and for cells changed since the last update.
+    const Region* GetCellRegion(uint32 index) const;
+
     b2Vec2   m_position;
     Cell*    m_cells;
     CellFlags* m_cellFlags;
@@ -118,8 +151,57 @@ public:
     uint8    m_flags:7;
 
 private:
+    friend class b2Fixture;
+    friend class b2Body;
+
     uint32 GetCellVertices(uint32 index, b2Vec2* vertices) const;
     b2Vec2 GetGhostPoint(uint32 index, b2Vec2 v0, b2Vec2 v1, bool fwdDirection) const;
+
+    Region* GetRegion(uint32 region) const;
+    uint32 NewRegion();
+    void DeleteRegion(b2BroadPhase* broadPhase, uint32 region);
+    void ComputeRegionAABB(b2AABB* aabb, const b2Transform& xf, const Region* region) const;
+    bool CanMergeCell(const b2Fixture* fixture, uint32 index, uint32 hull, const b2Filter& filter) const;
+    bool IsRegionChild(int32 childIndex) const;
+    int32 GetProxyId(int32 childIndex) const;
+
+    // A rectangle of cells to update
+    struct DirtyRect
+    {
+        uint32 m_row;
+        uint32 m_column;
+        uint32 m_rowCount;
+        uint32 m_columnCount;
+    };
+
+    static bool DirtyRectLessThan(const DirtyRect& a, const DirtyRect& b);
+    void SetCellDirty(uint32 row, uint32 column);
+    void SetAllCellsDirty();
+    void PushDirtyRect(uint32 row, uint32 column, uint32 rowCount, uint32 columnCount);
+    void UpdateRegions(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf);
+    void MergeCells(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf, const DirtyRect& rect);
+    void CreateProxies(b2Fixture* fixture, b2BroadPhase* broadPhase, const b2Transform& xf);
+    void DestroyProxies(b2BroadPhase* broadPhase);
+    void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
+
+    // Regions are allocated in chunks, as the broad-phase holds on to the address of each proxy
+    Region** m_regionChunks;
+    uint32   m_regionChunkCount;
+    uint32   m_regionSlotCount;
+    uint32   m_regionCount;
+    uint32   m_freeRegion;
+    // Region index per cell, B2GRIDSHAPE_EMPTY_CELL for cells without a region
+    uint32*  m_cellRegions;
+    // Non-zero for hulls covering their whole cell, which can be merged with their neighbours
+    uint8*   m_hullIsBox;
+    // One bit per cell changed since the regions were last updated
+    uint32*  m_dirtyCells;
+    // The changed cells. While updating, the removed regions are added as well.
+    DirtyRect* m_dirtyRects;
+    uint32   m_dirtyRectCount;
+    uint32   m_dirtyRectCapacity;
+    uint8    m_dirty:1;
+    uint8    m_hasProxies:1;
 };
 
 #endif // B2_TILE_SHAPE_H
@@ -23,17 +23,36 @@
 
 b2Version b2_version = {2, 2, 1};
 
-// Memory allocators. Modify these to use your own allocator.
-void* b2Alloc(int32 size)
+static void* b2DefaultAlloc(int32 size)
 {
 	return malloc(size);
 }
 
-void b2Free(void* mem)
+static void b2DefaultFree(void* mem)
 {
 	free(mem);
 }
 
+static b2AllocFcn b2_allocFcn = b2DefaultAlloc;
+static b2FreeFcn b2_freeFcn = b2DefaultFree;
+
+// Memory allocators. Use b2SetAllocator to use your own allocator.
+void* b2Alloc(int32 size)
+{
+	return b2_allocFcn(size);
+}
+
+void b2Free(void* mem)
+{
+	b2_freeFcn(mem);
+}
+
+void b2SetAllocator(b2AllocFcn allocFcn, b2FreeFcn freeFcn)
+{
+	b2_allocFcn = allocFcn;
+	b2_freeFcn = freeFcn;
+}
+
 // You can modify this to use your logging facility.
 void b2Log(const char* string, ...)
 {
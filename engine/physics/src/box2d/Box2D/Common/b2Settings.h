@@ -134,6 +134,13 @@ void* b2Alloc(int32 size);
 /// If you implement b2Alloc, you should also implement this function.
 void b2Free(void* mem);
 
+typedef void* (*b2AllocFcn)(int32 size);
+typedef void (*b2FreeFcn)(void* mem);
+
+/// Route b2Alloc/b2Free through other functions (defaults to malloc/free). Must be set
+/// before anything is allocated, since memory has to be freed by the allocator that made it.
+void b2SetAllocator(b2AllocFcn allocFcn, b2FreeFcn freeFcn);
+
 /// Logging function.
 void b2Log(const char* string, ...);
 
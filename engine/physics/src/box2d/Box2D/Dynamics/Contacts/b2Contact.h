@@ -144,6 +144,7 @@ protected:
 	friend class b2ContactSolver;
 	friend class b2Body;
 	friend class b2Fixture;
+	friend class b2Island;
 
 	// Flags stored in m_flags
 	enum
@@ -183,6 +184,12 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	// Defold mod. Update() split in two, so that the manifolds can be updated on several threads.
+	// UpdateManifold() only touches the contact, UpdateState() wakes the bodies and calls the listener.
+	// Returns true if the contact was touching before the update.
+	bool UpdateManifold(b2Manifold* oldManifold);
+	void UpdateState(b2ContactListener* listener, const b2Manifold& oldManifold, bool wasTouching);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
@@ -204,6 +211,10 @@ protected:
 
 	b2Manifold m_manifold;
 
+	// Defold mod. Island indices of the bodies, see b2Island::StoreBodyIndices()
+	int32 m_islandIndexA;
+	int32 m_islandIndexB;
+
 	int32 m_toiCount;
 	float32 m_toi;
 
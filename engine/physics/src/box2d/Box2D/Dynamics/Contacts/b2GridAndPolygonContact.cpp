@@ -41,13 +41,11 @@ void b2GridAndPolygonContact::Evaluate(b2Manifold* manifold, const b2Transform&
 
     manifold->pointCount = 0;
 
-    const b2GridShape::Cell& cell = gridShape->m_cells[m_indexA];
-    if (cell.m_Index == 0xffffffff)
+    const b2PolygonShape* polyA = gridShape->GetPolygonShapeForChild(m_indexA);
+    if (polyA == NULL)
     {
         return;
     }
 
-    b2PolygonShape polyA;
-    gridShape->GetPolygonShapeForCell(m_indexA, polyA);
-    b2CollidePolygons(manifold, &polyA, xfA, polyB, xfB);
+    b2CollidePolygons(manifold, polyA, xfA, polyB, xfB);
 }
@@ -41,6 +41,53 @@
 // J = [ug cross(r, ug)]
 // K = J * invM * JT = invMass + invI * cross(r, ug)^2
 
+// Defold mod. Bodies C and D are not connected to the gear joint, and a static body is shared between islands.
+// Its island index is only valid for the island that last added it, which may be solved on another thread.
+// Static bodies don't move, so they are read from the body instead, and never written.
+static const int32 b2_staticIndex = -1;
+
+static b2Position GetSolverPosition(const b2SolverData& data, int32 index, const b2Sweep& sweep)
+{
+	if (index != b2_staticIndex)
+	{
+		return data.positions[index];
+	}
+	b2Position position;
+	position.c = sweep.c;
+	position.a = sweep.a;
+	return position;
+}
+
+static b2Velocity GetSolverVelocity(const b2SolverData& data, int32 index)
+{
+	if (index != b2_staticIndex)
+	{
+		return data.velocities[index];
+	}
+	b2Velocity velocity;
+	velocity.v.SetZero();
+	velocity.w = 0.0f;
+	return velocity;
+}
+
+static void SetSolverPosition(const b2SolverData& data, int32 index, const b2Vec2& c, float32 a)
+{
+	if (index != b2_staticIndex)
+	{
+		data.positions[index].c = c;
+		data.positions[index].a = a;
+	}
+}
+
+static void SetSolverVelocity(const b2SolverData& data, int32 index, const b2Vec2& v, float32 w)
+{
+	if (index != b2_staticIndex)
+	{
+		data.velocities[index].v = v;
+		data.velocities[index].w = w;
+	}
+}
+
 b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 : b2Joint(def)
 {
@@ -130,10 +177,10 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 
 void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
-	m_indexC = m_bodyC->m_islandIndex;
-	m_indexD = m_bodyD->m_islandIndex;
+	m_indexA = m_islandIndexA;
+	m_indexB = m_islandIndexB;
+	m_indexC = m_bodyC->m_type == b2_staticBody ? b2_staticIndex : m_bodyC->m_islandIndex;
+	m_indexD = m_bodyD->m_type == b2_staticBody ? b2_staticIndex : m_bodyD->m_islandIndex;
 	m_lcA = m_bodyA->m_sweep.localCenter;
 	m_lcB = m_bodyB->m_sweep.localCenter;
 	m_lcC = m_bodyC->m_sweep.localCenter;
@@ -158,14 +205,14 @@ void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 	float32 wB = data.velocities[m_indexB].w;
 
 	//b2Vec2 cC = data.positions[m_indexC].c;
-	float32 aC = data.positions[m_indexC].a;
-	b2Vec2 vC = data.velocities[m_indexC].v;
-	float32 wC = data.velocities[m_indexC].w;
+	float32 aC = GetSolverPosition(data, m_indexC, m_bodyC->m_sweep).a;
+	b2Vec2 vC = GetSolverVelocity(data, m_indexC).v;
+	float32 wC = GetSolverVelocity(data, m_indexC).w;
 
 	//b2Vec2 cD = data.positions[m_indexD].c;
-	float32 aD = data.positions[m_indexD].a;
-	b2Vec2 vD = data.velocities[m_indexD].v;
-	float32 wD = data.velocities[m_indexD].w;
+	float32 aD = GetSolverPosition(data, m_indexD, m_bodyD->m_sweep).a;
+	b2Vec2 vD = GetSolverVelocity(data, m_indexD).v;
+	float32 wD = GetSolverVelocity(data, m_indexD).w;
 
 	b2Rot qA(aA), qB(aB), qC(aC), qD(aD);
 
@@ -230,10 +277,8 @@ void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 	data.velocities[m_indexA].w = wA;
 	data.velocities[m_indexB].v = vB;
 	data.velocities[m_indexB].w = wB;
-	data.velocities[m_indexC].v = vC;
-	data.velocities[m_indexC].w = wC;
-	data.velocities[m_indexD].v = vD;
-	data.velocities[m_indexD].w = wD;
+	SetSolverVelocity(data, m_indexC, vC, wC);
+	SetSolverVelocity(data, m_indexD, vD, wD);
 }
 
 void b2GearJoint::SolveVelocityConstraints(const b2SolverData& data)
@@ -242,10 +287,10 @@ void b2GearJoint::SolveVelocityConstraints(const b2SolverData& data)
 	float32 wA = data.velocities[m_indexA].w;
 	b2Vec2 vB = data.velocities[m_indexB].v;
 	float32 wB = data.velocities[m_indexB].w;
-	b2Vec2 vC = data.velocities[m_indexC].v;
-	float32 wC = data.velocities[m_indexC].w;
-	b2Vec2 vD = data.velocities[m_indexD].v;
-	float32 wD = data.velocities[m_indexD].w;
+	b2Vec2 vC = GetSolverVelocity(data, m_indexC).v;
+	float32 wC = GetSolverVelocity(data, m_indexC).w;
+	b2Vec2 vD = GetSolverVelocity(data, m_indexD).v;
+	float32 wD = GetSolverVelocity(data, m_indexD).w;
 
 	float32 Cdot = b2Dot(m_JvAC, vA - vC) + b2Dot(m_JvBD, vB - vD);
 	Cdot += (m_JwA * wA - m_JwC * wC) + (m_JwB * wB - m_JwD * wD);
@@ -266,10 +311,8 @@ void b2GearJoint::SolveVelocityConstraints(const b2SolverData& data)
 	data.velocities[m_indexA].w = wA;
 	data.velocities[m_indexB].v = vB;
 	data.velocities[m_indexB].w = wB;
-	data.velocities[m_indexC].v = vC;
-	data.velocities[m_indexC].w = wC;
-	data.velocities[m_indexD].v = vD;
-	data.velocities[m_indexD].w = wD;
+	SetSolverVelocity(data, m_indexC, vC, wC);
+	SetSolverVelocity(data, m_indexD, vD, wD);
 }
 
 bool b2GearJoint::SolvePositionConstraints(const b2SolverData& data)
@@ -278,10 +321,10 @@ bool b2GearJoint::SolvePositionConstraints(const b2SolverData& data)
 	float32 aA = data.positions[m_indexA].a;
 	b2Vec2 cB = data.positions[m_indexB].c;
 	float32 aB = data.positions[m_indexB].a;
-	b2Vec2 cC = data.positions[m_indexC].c;
-	float32 aC = data.positions[m_indexC].a;
-	b2Vec2 cD = data.positions[m_indexD].c;
-	float32 aD = data.positions[m_indexD].a;
+	b2Vec2 cC = GetSolverPosition(data, m_indexC, m_bodyC->m_sweep).c;
+	float32 aC = GetSolverPosition(data, m_indexC, m_bodyC->m_sweep).a;
+	b2Vec2 cD = GetSolverPosition(data, m_indexD, m_bodyD->m_sweep).c;
+	float32 aD = GetSolverPosition(data, m_indexD, m_bodyD->m_sweep).a;
 
 	b2Rot qA(aA), qB(aB), qC(aC), qD(aD);
 
@@ -362,10 +405,8 @@ bool b2GearJoint::SolvePositionConstraints(const b2SolverData& data)
 	data.positions[m_indexA].a = aA;
 	data.positions[m_indexB].c = cB;
 	data.positions[m_indexB].a = aB;
-	data.positions[m_indexC].c = cC;
-	data.positions[m_indexC].a = aC;
-	data.positions[m_indexD].c = cD;
-	data.positions[m_indexD].a = aD;
+	SetSolverPosition(data, m_indexC, cC, aC);
+	SetSolverPosition(data, m_indexD, cD, aD);
 
 	// TODO_ERIN not implemented
 	return linearError < b2_linearSlop;
@@ -178,6 +178,8 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_bodyA = def->bodyA;
 	m_bodyB = def->bodyB;
 	m_index = 0;
+	m_islandIndexA = 0;
+	m_islandIndexB = 0;
 	m_collideConnected = def->collideConnected;
 	m_islandFlag = false;
 	m_userData = def->userData;
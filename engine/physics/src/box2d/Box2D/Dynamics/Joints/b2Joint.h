@@ -173,6 +173,10 @@ protected:
 
 	int32 m_index;
 
+	// Defold mod. Island indices of the bodies, see b2Island::StoreBodyIndices()
+	int32 m_islandIndexA;
+	int32 m_islandIndexB;
+
 	bool m_islandFlag;
 	bool m_collideConnected;
 
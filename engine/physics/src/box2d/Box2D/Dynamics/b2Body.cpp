@@ -21,6 +21,7 @@
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 #include <Box2D/Dynamics/Joints/b2Joint.h>
+#include <Box2D/Collision/Shapes/b2GridShape.h>
 
 b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 {
@@ -462,28 +463,75 @@ void b2Body::SynchronizeFixtures()
 	}
 }
 
-void b2Body::SynchronizeSingle(b2Shape* shape, int32 index)
+void b2Body::SynchronizeFixtureAABBs()
 {
-    // Defold fix: Shapes call this function blindly not knowing if proxies have been created or not.
-    // b2Body only has proxied created when active, so discard calls when not active so shapes can be
-    // updated without crash on inactive objects.
+	b2Transform xf1;
+	xf1.q.Set(m_sweep.a0);
+	xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
+
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->SynchronizeAABBs(xf1, m_xf);
+	}
+}
+
+void b2Body::SynchronizeFixtureProxies()
+{
+	b2Transform xf1;
+	xf1.q.Set(m_sweep.a0);
+	xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
+
+	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->SynchronizeProxies(broadPhase, xf1, m_xf);
+	}
+}
+
+void b2Body::FlagGridForUpdate()
+{
+    m_flags |= e_gridFlag;
+    m_world->m_flags |= b2World::e_gridUpdate;
+}
+
+void b2Body::UpdateGrids()
+{
+    m_flags &= ~e_gridFlag;
+
+    // Defold fix: Shapes are changed blindly not knowing if proxies have been created or not.
+    // b2Body only has proxies created when active, and the grid regions are updated when they are created.
     if (!IsActive())
     {
         return;
     }
 
-    b2Transform xf1;
-    xf1.q.Set(m_sweep.a0);
-    xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
-
     b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
     for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
     {
-        if (f->GetShape() == shape)
+        if (f->GetType() == b2Shape::e_grid)
+        {
+            ((b2GridShape*)f->GetShape())->UpdateRegions(f, broadPhase, m_xf);
+        }
+    }
+
+    // Destroy the contacts of removed regions
+    b2ContactEdge* edge = m_contactList;
+    while (edge)
+    {
+        b2Contact* c = edge->contact;
+        edge = edge->next;
+
+        b2Fixture* fixtureA = c->GetFixtureA();
+        b2Fixture* fixtureB = c->GetFixtureB();
+        if ((fixtureA->GetBody() == this && fixtureA->GetType() == b2Shape::e_grid && fixtureA->GetProxyId(c->GetChildIndexA()) == b2BroadPhase::e_nullProxy) ||
+            (fixtureB->GetBody() == this && fixtureB->GetType() == b2Shape::e_grid && fixtureB->GetProxyId(c->GetChildIndexB()) == b2BroadPhase::e_nullProxy))
         {
-            f->SynchronizeSingle(broadPhase, index, xf1, m_xf);
+            m_world->m_contactManager.Destroy(c);
         }
     }
+
+    // Find the contacts of the new regions
+    m_world->m_flags |= b2World::e_newFixture;
 }
 
 void b2Body::SetActive(bool flag)
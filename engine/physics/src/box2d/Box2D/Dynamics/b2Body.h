@@ -407,6 +407,7 @@ private:
 	friend class b2RopeJoint;
 
     friend class b2GridShape;
+    friend class b2Fixture;
 
 	// m_flags
 	enum
@@ -417,15 +418,21 @@ private:
 		e_bulletFlag		= 0x0008,
 		e_fixedRotationFlag	= 0x0010,
 		e_activeFlag		= 0x0020,
-		e_toiFlag			= 0x0040
+		e_toiFlag			= 0x0040,
+		// Defold mod
+		e_gridFlag			= 0x0080
 	};
 
 	b2Body(const b2BodyDef* bd, b2World* world);
 	~b2Body();
 
     void SynchronizeFixtures();
-    // Defold mod
-    void SynchronizeSingle(b2Shape* shape, int32 index);
+    // Defold mod. SynchronizeFixtures() in two passes, see b2World::SynchronizeFixtures
+    void SynchronizeFixtureAABBs();
+    void SynchronizeFixtureProxies();
+    // Defold mod. Grid shape changes are batched until the next step, see b2World::UpdateGrids
+    void FlagGridForUpdate();
+    void UpdateGrids();
     void SynchronizeTransform();
 
 	// This is used to prevent connected bodies from colliding.
@@ -21,6 +21,8 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Collision/Shapes/b2GridShape.h>
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
@@ -32,6 +34,36 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = NULL;
+	m_stackAllocator = NULL;
+	m_taskExecutor = NULL;
+}
+
+// Defold mod
+struct b2ContactUpdate
+{
+	b2Contact* contact;
+	b2Manifold oldManifold;
+	bool wasTouching;
+};
+
+void b2ContactManager::UpdateManifolds(void* context, int32 begin, int32 end, int32 workerIndex)
+{
+	B2_NOT_USED(workerIndex);
+	b2ContactUpdate* updates = (b2ContactUpdate*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2ContactUpdate* update = updates + i;
+		update->wasTouching = update->contact->UpdateManifold(&update->oldManifold);
+	}
+}
+
+// Defold mod. The grid shapes create the polygons of their regions on first use, which must not happen on the workers
+static void PrepareGridChild(b2Fixture* fixture, int32 childIndex)
+{
+	if (fixture->GetType() == b2Shape::e_grid)
+	{
+		((b2GridShape*)fixture->GetShape())->GetPolygonShapeForChild(childIndex);
+	}
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -104,6 +136,15 @@ void b2ContactManager::Destroy(b2Contact* c)
 // contact list.
 void b2ContactManager::Collide()
 {
+	// Defold mod. With a task executor, the persisting contacts are gathered and their manifolds
+	// updated on the workers. The bodies are then woken and the listener called in contact list order.
+	b2ContactUpdate* updates = NULL;
+	int32 updateCount = 0;
+	if (m_taskExecutor && m_contactCount > 0)
+	{
+		updates = (b2ContactUpdate*)m_stackAllocator->Allocate(m_contactCount * sizeof(b2ContactUpdate));
+	}
+
 	// Update awake contacts.
 	b2Contact* c = m_contactList;
 	while (c)
@@ -150,9 +191,11 @@ void b2ContactManager::Collide()
 			continue;
 		}
 
-		int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+		// Defold mod. The proxy of a grid child is looked up through its region
+		int32 proxyIdA = fixtureA->GetProxyId(indexA);
+		int32 proxyIdB = fixtureB->GetProxyId(indexB);
+		bool overlap = proxyIdA != b2BroadPhase::e_nullProxy && proxyIdB != b2BroadPhase::e_nullProxy &&
+		               m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
 
 		// Here we destroy contacts that cease to overlap in the broad-phase.
 		if (overlap == false)
@@ -164,9 +207,29 @@ void b2ContactManager::Collide()
 		}
 
 		// The contact persists.
-		c->Update(m_contactListener);
+		if (updates)
+		{
+			PrepareGridChild(fixtureA, indexA);
+			PrepareGridChild(fixtureB, indexB);
+			updates[updateCount++].contact = c;
+		}
+		else
+		{
+			c->Update(m_contactListener);
+		}
 		c = c->GetNext();
 	}
+
+	if (updates)
+	{
+		m_taskExecutor->ParallelFor(UpdateManifolds, updates, updateCount, 32);
+		for (int32 i = 0; i < updateCount; ++i)
+		{
+			b2ContactUpdate* update = updates + i;
+			update->contact->UpdateState(m_contactListener, update->oldManifold, update->wasTouching);
+		}
+		m_stackAllocator->Free(updates);
+	}
 }
 
 void b2ContactManager::FindNewContacts()
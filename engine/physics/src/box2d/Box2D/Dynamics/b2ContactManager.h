@@ -25,6 +25,8 @@ class b2Contact;
 class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2StackAllocator;
+class b2TaskExecutor;
 
 // Delegate of b2World.
 class b2ContactManager
@@ -42,13 +44,19 @@ public:
 	void Destroy(b2Contact* c);
 
 	void Collide();
-            
+
+	// Defold mod. Task of the task executor, see Collide()
+	static void UpdateManifolds(void* context, int32 begin, int32 end, int32 workerIndex);
+
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
 	int32 m_contactCount;
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+	// Defold mod
+	b2StackAllocator* m_stackAllocator;
+	b2TaskExecutor* m_taskExecutor;
 };
 
 #endif
@@ -23,6 +23,7 @@
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Collision/Shapes/b2GridShape.h>
 #include <Box2D/Collision/b2BroadPhase.h>
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Common/b2BlockAllocator.h>
@@ -58,8 +59,12 @@ void b2Fixture::Create(b2BlockAllocator* allocator, b2Body* body, const b2Fixtur
     m_shape = (b2Shape*)def->shape;
 
 	// Reserve proxy space
+	// Defold modification. Grid shapes own the proxies of their regions
 	int32 childCount = m_shape->GetChildCount();
-	m_proxies = (b2FixtureProxy*)allocator->Allocate(childCount * sizeof(b2FixtureProxy));
+	if (m_shape->GetType() != b2Shape::e_grid)
+	{
+		m_proxies = (b2FixtureProxy*)allocator->Allocate(childCount * sizeof(b2FixtureProxy));
+	}
     // Defold modification. Allocate filters per child-shape
 	if (m_shape->m_filterPerChild)
 	{
@@ -67,8 +72,11 @@ void b2Fixture::Create(b2BlockAllocator* allocator, b2Body* body, const b2Fixtur
 	}
 	for (int32 i = 0; i < childCount; ++i)
 	{
-		m_proxies[i].fixture = NULL;
-		m_proxies[i].proxyId = b2BroadPhase::e_nullProxy;
+		if (m_proxies)
+		{
+			m_proxies[i].fixture = NULL;
+			m_proxies[i].proxyId = b2BroadPhase::e_nullProxy;
+		}
 	    // Defold modification. Set filter per child shape
 	    if (m_shape->m_filterPerChild)
 	    {
@@ -87,8 +95,11 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 
 	// Free the proxy array.
 	int32 childCount = m_shape->GetChildCount();
-	allocator->Free(m_proxies, childCount * sizeof(b2FixtureProxy));
-	m_proxies = NULL;
+	if (m_proxies)
+	{
+		allocator->Free(m_proxies, childCount * sizeof(b2FixtureProxy));
+		m_proxies = NULL;
+	}
 	if (m_shape->m_filterPerChild)
 	{
 	    allocator->Free(m_filters, childCount * sizeof(b2Filter));
@@ -142,6 +153,13 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 {
 	b2Assert(m_proxyCount == 0);
 
+	// Defold modification. Grid shapes only have proxies for their non-empty regions
+	if (m_shape->GetType() == b2Shape::e_grid)
+	{
+		((b2GridShape*)m_shape)->CreateProxies(this, broadPhase, xf);
+		return;
+	}
+
 	// Create proxies in the broad-phase.
 	m_proxyCount = m_shape->GetChildCount();
 
@@ -157,6 +175,12 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 
 void b2Fixture::DestroyProxies(b2BroadPhase* broadPhase)
 {
+	if (m_shape->GetType() == b2Shape::e_grid)
+	{
+		((b2GridShape*)m_shape)->DestroyProxies(broadPhase);
+		return;
+	}
+
 	// Destroy proxies in the broad-phase.
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
@@ -170,7 +194,14 @@ void b2Fixture::DestroyProxies(b2BroadPhase* broadPhase)
 
 void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2)
 {
-	if (m_proxyCount == 0)
+	SynchronizeAABBs(transform1, transform2);
+	SynchronizeProxies(broadPhase, transform1, transform2);
+}
+
+void b2Fixture::SynchronizeAABBs(const b2Transform& transform1, const b2Transform& transform2)
+{
+	// The grid shape computes the AABBs of its regions as it moves them
+	if (m_shape->GetType() == b2Shape::e_grid)
 	{
 		return;
 	}
@@ -185,28 +216,29 @@ void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transfo
 		m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
 
 		proxy->aabb.Combine(aabb1, aabb2);
-
-		b2Vec2 displacement = transform2.p - transform1.p;
-
-		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
 	}
 }
 
-void b2Fixture::SynchronizeSingle(b2BroadPhase* broadPhase, int32 index, const b2Transform& transform1, const b2Transform& transform2)
+void b2Fixture::SynchronizeProxies(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2)
 {
-    b2Assert(index < m_proxyCount);
-
-    b2FixtureProxy* proxy = m_proxies + index;
-
-    b2AABB aabb1, aabb2;
-    m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
-    m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
+	if (m_shape->GetType() == b2Shape::e_grid)
+	{
+		((b2GridShape*)m_shape)->Synchronize(broadPhase, transform1, transform2);
+		return;
+	}
 
-    proxy->aabb.Combine(aabb1, aabb2);
+	b2Vec2 displacement = transform2.p - transform1.p;
 
-    b2Vec2 displacement = transform2.p - transform1.p;
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		b2FixtureProxy* proxy = m_proxies + i;
+		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+	}
+}
 
-    broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+int32 b2Fixture::GetGridProxyId(int32 childIndex) const
+{
+    return ((b2GridShape*)m_shape)->GetProxyId(childIndex);
 }
 
 void b2Fixture::SetFilterData(const b2Filter& filter, int32 index)
@@ -214,6 +246,15 @@ void b2Fixture::SetFilterData(const b2Filter& filter, int32 index)
     // Defold modifications. Added index
     m_filters[index * m_shape->m_filterPerChild] = filter;
 
+    // Defold modifications. Cells are merged by filter, so the regions of the grid need to be updated
+    if (GetType() == b2Shape::e_grid && m_body != NULL)
+    {
+        b2GridShape* grid = (b2GridShape*)m_shape;
+        uint32 row = index / grid->m_columnCount;
+        grid->SetCellDirty(row, index - row * grid->m_columnCount);
+        m_body->FlagGridForUpdate();
+    }
+
     // Defold modifications. If the body is a grid,
     // we skip updating the proxy list since that will
     // potentially expand the movement buffer.
@@ -217,7 +217,15 @@ protected:
 	void DestroyProxies(b2BroadPhase* broadPhase);
 
 	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
-	void SynchronizeSingle(b2BroadPhase* broadPhase, int32 index, const b2Transform& transform1, const b2Transform& transform2);
+
+	// Defold mod. Synchronize() in two passes. Computing the swept AABBs only touches the fixture
+	// and may run on several threads, moving the proxies in the broad-phase may not.
+	void SynchronizeAABBs(const b2Transform& xf1, const b2Transform& xf2);
+	void SynchronizeProxies(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
+
+	// Defold modification. Get the broad-phase proxy of a child, e_nullProxy if the child has none
+	int32 GetProxyId(int32 childIndex) const;
+	int32 GetGridProxyId(int32 childIndex) const;
 
 	float32 m_density;
 
@@ -344,6 +352,15 @@ inline void b2Fixture::GetMassData(b2MassData* massData) const
 	m_shape->ComputeMass(massData, m_density);
 }
 
+inline int32 b2Fixture::GetProxyId(int32 childIndex) const
+{
+	if (m_shape->m_type == b2Shape::e_grid)
+	{
+		return GetGridProxyId(childIndex);
+	}
+	return m_proxies[childIndex].proxyId;
+}
+
 inline const b2AABB& b2Fixture::GetAABB(int32 childIndex) const
 {
 	b2Assert(0 <= childIndex && childIndex < m_proxyCount);
@@ -36,6 +36,11 @@ class b2Island
 public:
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
 			b2StackAllocator* allocator, b2ContactListener* listener);
+
+	/// Defold mod. An island over lists owned by the caller, used to solve islands on several threads.
+	/// The bodies and constraints must have their island indices stored, see StoreBodyIndices().
+	b2Island(b2Body** bodies, int32 bodyCount, b2Contact** contacts, int32 contactCount,
+			b2Joint** joints, int32 jointCount, b2StackAllocator* allocator, b2ContactListener* listener);
 	~b2Island();
 
 	void Clear()
@@ -45,7 +50,9 @@ public:
 		m_jointCount = 0;
 	}
 
-	void Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep);
+	/// Static bodies are shared between islands and are neither written nor put to sleep.
+	/// Returns true if the island fell asleep.
+	bool Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep);
 
 	void SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB);
 
@@ -69,6 +76,10 @@ public:
 		m_joints[m_jointCount++] = joint;
 	}
 
+	/// Defold mod. Store the island indices of the bodies in the contacts and joints.
+	/// The index of a static body is only valid for the island that last added it.
+	void StoreBodyIndices();
+
 	void Report(const b2ContactVelocityConstraint* constraints);
 
 	b2StackAllocator* m_allocator;
@@ -88,6 +99,9 @@ public:
 	int32 m_bodyCapacity;
 	int32 m_contactCapacity;
 	int32 m_jointCapacity;
+
+	// Defold mod. False if the lists are owned by the caller
+	bool m_ownsLists;
 };
 
 #endif
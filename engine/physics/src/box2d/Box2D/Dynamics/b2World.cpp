@@ -60,6 +60,11 @@ b2World::b2World(const b2Vec2& gravity)
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_stackAllocator = &m_stackAllocator;
+
+	m_taskExecutor = NULL;
+	m_workerAllocators = NULL;
+	m_workerCount = 0;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
 }
@@ -83,6 +88,8 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	SetTaskExecutor(NULL);
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -105,6 +112,31 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	m_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskExecutor(b2TaskExecutor* executor)
+{
+	b2Assert(IsLocked() == false);
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		m_workerAllocators[i].~b2StackAllocator();
+	}
+	b2Free(m_workerAllocators);
+	m_workerAllocators = NULL;
+	m_workerCount = 0;
+
+	m_taskExecutor = executor;
+	m_contactManager.m_taskExecutor = executor;
+	if (executor)
+	{
+		m_workerCount = executor->GetWorkerCount();
+		m_workerAllocators = (b2StackAllocator*)b2Alloc(m_workerCount * sizeof(b2StackAllocator));
+		for (int32 i = 0; i < m_workerCount; ++i)
+		{
+			new (m_workerAllocators + i) b2StackAllocator();
+		}
+	}
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -383,6 +415,45 @@ void b2World::SetAllowSleeping(bool flag)
 	}
 }
 
+// Defold mod
+struct b2IslandRange
+{
+	int32 bodyStart;
+	int32 bodyCount;
+	int32 contactStart;
+	int32 contactCount;
+	int32 jointStart;
+	int32 jointCount;
+	b2Profile profile;
+	bool sleeping;
+};
+
+struct b2SolveIslandsContext
+{
+	const b2TimeStep* step;
+	b2Vec2 gravity;
+	bool allowSleep;
+	b2StackAllocator* allocators;
+	b2Body** bodies;
+	b2Contact** contacts;
+	b2Joint** joints;
+	b2IslandRange* islands;
+};
+
+// Defold mod. Islands don't write to static bodies, since they are shared between islands.
+// A static body is left as the last island touching it left it, the same with and without a task executor.
+static void UpdateStaticBodiesAwake(b2Body** bodies, int32 bodyCount, bool sleeping)
+{
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		b2Body* b = bodies[i];
+		if (b->GetType() == b2_staticBody)
+		{
+			b->SetAwake(!sleeping);
+		}
+	}
+}
+
 // Find islands, integrate and solve constraints, solve position constraints
 void b2World::Solve(const b2TimeStep& step)
 {
@@ -411,6 +482,25 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
+	// Defold mod. With a task executor, the islands are first gathered and then solved on the workers.
+	// Static bodies are shared between islands, so the lists are copied out of the island.
+	b2Body** islandBodies = NULL;
+	b2Contact** islandContacts = NULL;
+	b2Joint** islandJoints = NULL;
+	b2IslandRange* islands = NULL;
+	int32 islandBodyCount = 0;
+	int32 islandContactCount = 0;
+	int32 islandJointCount = 0;
+	int32 islandCount = 0;
+	if (m_taskExecutor)
+	{
+		// A static body may be added to each island of its contacts and joints
+		islandBodies = (b2Body**)m_stackAllocator.Allocate((m_bodyCount + m_contactManager.m_contactCount + m_jointCount) * sizeof(b2Body*));
+		islandContacts = (b2Contact**)m_stackAllocator.Allocate(m_contactManager.m_contactCount * sizeof(b2Contact*));
+		islandJoints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+		islands = (b2IslandRange*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2IslandRange));
+	}
+
 	// Build and simulate all awake islands.
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
@@ -528,11 +618,34 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+		island.StoreBodyIndices();
+
+		if (m_taskExecutor)
+		{
+			b2IslandRange* range = islands + islandCount++;
+			range->bodyStart = islandBodyCount;
+			range->bodyCount = island.m_bodyCount;
+			range->contactStart = islandContactCount;
+			range->contactCount = island.m_contactCount;
+			range->jointStart = islandJointCount;
+			range->jointCount = island.m_jointCount;
+			memcpy(islandBodies + islandBodyCount, island.m_bodies, island.m_bodyCount * sizeof(b2Body*));
+			memcpy(islandContacts + islandContactCount, island.m_contacts, island.m_contactCount * sizeof(b2Contact*));
+			memcpy(islandJoints + islandJointCount, island.m_joints, island.m_jointCount * sizeof(b2Joint*));
+			islandBodyCount += island.m_bodyCount;
+			islandContactCount += island.m_contactCount;
+			islandJointCount += island.m_jointCount;
+		}
+		else
+		{
+			b2Profile profile;
+			bool sleeping = island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+
+			UpdateStaticBodiesAwake(island.m_bodies, island.m_bodyCount, sleeping);
+		}
 
 		// Post solve cleanup.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -548,9 +661,103 @@ void b2World::Solve(const b2TimeStep& step)
 
 	m_stackAllocator.Free(stack);
 
+	if (m_taskExecutor)
+	{
+		SolveIslands(step, islandBodies, islandContacts, islandJoints, islands, islandCount);
+
+		m_stackAllocator.Free(islands);
+		m_stackAllocator.Free(islandJoints);
+		m_stackAllocator.Free(islandContacts);
+		m_stackAllocator.Free(islandBodies);
+	}
+
 	{
 		b2Timer timer;
 		// Synchronize fixtures, check for out of range bodies.
+		SynchronizeFixtures();
+
+		// Look for new contacts.
+		m_contactManager.FindNewContacts();
+		m_profile.broadphase = timer.GetMilliseconds();
+	}
+}
+
+static void SolveIslandsTask(void* _context, int32 begin, int32 end, int32 workerIndex)
+{
+	b2SolveIslandsContext* context = (b2SolveIslandsContext*)_context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2IslandRange* range = context->islands + i;
+		// The listener is called from the world, see SolveIslands()
+		b2Island island(context->bodies + range->bodyStart, range->bodyCount,
+						context->contacts + range->contactStart, range->contactCount,
+						context->joints + range->jointStart, range->jointCount,
+						&context->allocators[workerIndex], NULL);
+		range->sleeping = island.Solve(&range->profile, *context->step, context->gravity, context->allowSleep);
+	}
+}
+
+// Solve the islands with the task executor. Anything shared between islands is done afterwards, in island order.
+void b2World::SolveIslands(const b2TimeStep& step, b2Body** bodies, b2Contact** contacts, b2Joint** joints, b2IslandRange* islands, int32 islandCount)
+{
+	b2SolveIslandsContext context;
+	context.step = &step;
+	context.gravity = m_gravity;
+	context.allowSleep = m_allowSleep;
+	context.allocators = m_workerAllocators;
+	context.bodies = bodies;
+	context.contacts = contacts;
+	context.joints = joints;
+	context.islands = islands;
+	m_taskExecutor->ParallelFor(SolveIslandsTask, &context, islandCount, 1);
+
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		const b2IslandRange* range = islands + i;
+		m_profile.solveInit += range->profile.solveInit;
+		m_profile.solveVelocity += range->profile.solveVelocity;
+		m_profile.solvePosition += range->profile.solvePosition;
+
+		// The impulses are stored in the manifolds for warm starting
+		if (listener)
+		{
+			for (int32 j = 0; j < range->contactCount; ++j)
+			{
+				b2Contact* c = contacts[range->contactStart + j];
+				const b2Manifold* manifold = c->GetManifold();
+
+				b2ContactImpulse impulse;
+				impulse.count = manifold->pointCount;
+				for (int32 k = 0; k < manifold->pointCount; ++k)
+				{
+					impulse.normalImpulses[k] = manifold->points[k].normalImpulse;
+					impulse.tangentImpulses[k] = manifold->points[k].tangentImpulse;
+				}
+
+				listener->PostSolve(c, &impulse);
+			}
+		}
+
+		UpdateStaticBodiesAwake(bodies + range->bodyStart, range->bodyCount, range->sleeping);
+	}
+}
+
+void b2World::SynchronizeFixturesTask(void* context, int32 begin, int32 end, int32 workerIndex)
+{
+	B2_NOT_USED(workerIndex);
+	b2Body** bodies = (b2Body**)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		bodies[i]->SynchronizeFixtureAABBs();
+	}
+}
+
+// Update the broad-phase proxies of the bodies solved in this step.
+void b2World::SynchronizeFixtures()
+{
+	if (m_taskExecutor == NULL)
+	{
 		for (b2Body* b = m_bodyList; b; b = b->GetNext())
 		{
 			// If a body was not in an island then it did not move.
@@ -567,11 +774,29 @@ void b2World::Solve(const b2TimeStep& step)
 			// Update fixtures (for broad-phase).
 			b->SynchronizeFixtures();
 		}
+		return;
+	}
 
-		// Look for new contacts.
-		m_contactManager.FindNewContacts();
-		m_profile.broadphase = timer.GetMilliseconds();
+	// Defold mod. The AABBs are computed on the workers, the proxies are then moved in body list order.
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+	int32 bodyCount = 0;
+	for (b2Body* b = m_bodyList; b; b = b->GetNext())
+	{
+		if ((b->m_flags & b2Body::e_islandFlag) == 0 || b->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+		bodies[bodyCount++] = b;
 	}
+
+	m_taskExecutor->ParallelFor(SynchronizeFixturesTask, bodies, bodyCount, 64);
+
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		bodies[i]->SynchronizeFixtureProxies();
+	}
+
+	m_stackAllocator.Free(bodies);
 }
 
 // Find TOI contacts and solve them.
@@ -861,6 +1086,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		island.StoreBodyIndices();
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -899,6 +1125,8 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 {
 	b2Timer stepTimer;
 
+	UpdateGrids();
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_flags & e_newFixture)
 	{
@@ -978,6 +1206,23 @@ void b2World::ClearForces()
 	}
 }
 
+void b2World::UpdateGrids()
+{
+	if ((m_flags & e_gridUpdate) == 0)
+	{
+		return;
+	}
+	m_flags &= ~e_gridUpdate;
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->m_flags & b2Body::e_gridFlag)
+		{
+			b->UpdateGrids();
+		}
+	}
+}
+
 struct b2WorldQueryWrapper
 {
 	bool QueryCallback(int32 proxyId)
@@ -1266,10 +1511,16 @@ void b2World::DrawDebugData()
 
 			for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
 			{
-				for (int32 i = 0; i < f->m_proxyCount; ++i)
+				// Defold mod. The proxies of a grid are owned by its regions
+				int32 childCount = f->GetType() == b2Shape::e_grid ? f->GetShape()->GetChildCount() : f->m_proxyCount;
+				for (int32 i = 0; i < childCount; ++i)
 				{
-					b2FixtureProxy* proxy = f->m_proxies + i;
-					b2AABB aabb = bp->GetFatAABB(proxy->proxyId);
+					int32 proxyId = f->GetProxyId(i);
+					if (proxyId == b2BroadPhase::e_nullProxy)
+					{
+						continue;
+					}
+					b2AABB aabb = bp->GetFatAABB(proxyId);
 					b2Vec2 vs[4];
 					vs[0].Set(aabb.lowerBound.x, aabb.lowerBound.y);
 					vs[1].Set(aabb.upperBound.x, aabb.lowerBound.y);
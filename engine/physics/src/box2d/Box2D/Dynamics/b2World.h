@@ -30,6 +30,7 @@ struct b2AABB;
 struct b2BodyDef;
 struct b2Color;
 struct b2JointDef;
+struct b2IslandRange;
 class b2Body;
 class b2Draw;
 class b2Fixture;
@@ -66,6 +67,11 @@ public:
 	/// by you and must remain in scope.
 	void SetDebugDraw(b2Draw* debugDraw);
 
+	/// Defold mod. Register a task executor to step the world on several threads.
+	/// The result of a step is the same for any number of workers.
+	/// The executor is owned by you and must remain in scope. Pass NULL to step on the calling thread only.
+	void SetTaskExecutor(b2TaskExecutor* executor);
+
 	/// Create a rigid body given a definition. No reference to the definition
 	/// is retained.
 	/// @warning This function is locked during callbacks.
@@ -107,6 +113,10 @@ public:
 	/// Call this to draw shapes and other debug draw data.
 	void DrawDebugData();
 
+	/// Defold mod. Update the broad-phase proxies of grid shapes changed since the last step.
+	/// This is done at the start of each step, call it before queries made in between steps.
+	void UpdateGrids();
+
 	/// Query the world for all fixtures that potentially overlap the
 	/// provided AABB.
 	/// @param callback a user implemented callback class.
@@ -211,7 +221,9 @@ private:
 	{
 		e_newFixture	= 0x0001,
 		e_locked		= 0x0002,
-		e_clearForces	= 0x0004
+		e_clearForces	= 0x0004,
+		// Defold mod
+		e_gridUpdate	= 0x0008
 	};
 
 	friend class b2Body;
@@ -221,6 +233,10 @@ private:
 
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
+	// Defold mod
+	void SolveIslands(const b2TimeStep& step, b2Body** bodies, b2Contact** contacts, b2Joint** joints, b2IslandRange* islands, int32 islandCount);
+	void SynchronizeFixtures();
+	static void SynchronizeFixturesTask(void* context, int32 begin, int32 end, int32 workerIndex);
 
 	void DrawJoint(b2Joint* joint);
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
@@ -245,6 +261,11 @@ private:
 	b2DestructionListener* m_destructionListener;
 	b2Draw* m_debugDraw;
 
+	// Defold mod. One stack allocator per worker of the task executor
+	b2TaskExecutor* m_taskExecutor;
+	b2StackAllocator* m_workerAllocators;
+	int32 m_workerCount;
+
 	// This is used to compute the time step ratio to
 	// support a variable time step.
 	float32 m_inv_dt0;
@@ -152,4 +152,26 @@ public:
 									const b2Vec2& normal, float32 fraction) = 0;
 };
 
+/// Defold mod. Implement this class to step a world on several threads.
+/// The islands, the contact updates and the fixture AABBs of a step are split into
+/// independent items, and everything that depends on the order of the items
+/// (listener callbacks, broad-phase updates) is still done on the calling thread.
+/// See b2World::SetTaskExecutor
+class b2TaskExecutor
+{
+public:
+	/// Process the items [begin, end). workerIndex is in [0, GetWorkerCount())
+	/// and is unique among the tasks running at the same time.
+	typedef void (*Task)(void* context, int32 begin, int32 end, int32 workerIndex);
+
+	virtual ~b2TaskExecutor() {}
+
+	/// The number of threads running tasks, including the calling thread.
+	virtual int32 GetWorkerCount() const = 0;
+
+	/// Run the task over the items [0, count), split into ranges of at least minRange items,
+	/// and return when all items are processed. The ranges may run in any order.
+	virtual void ParallelFor(Task task, void* context, int32 count, int32 minRange) = 0;
+};
+
 #endif
@@ -243,6 +243,8 @@ namespace dmPhysics
         uint32_t m_RayCastLimit3D;
         /// Maximum number of overlapping triggers
         uint32_t m_TriggerOverlapCapacity;
+        /// Number of threads, besides the calling thread, that step the 2D worlds. 0 steps on the calling thread only
+        uint32_t m_WorkerThreadCount2D;
         /// If true, the collision objects will retrieve the position of its game object
         uint8_t m_AllowDynamicTransforms:1;
         uint8_t :7;
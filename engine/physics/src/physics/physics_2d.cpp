@@ -20,6 +20,7 @@
 #include <dlib/array.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dlib/profile.h>
 
 #include "Box2D/Box2D.h"
@@ -27,13 +28,199 @@
 
 #include "physics_2d.h"
 
+#if !defined(__EMSCRIPTEN__)
+    #define DM_HAS_THREADS
+#endif
+
+#if defined(DM_USE_SINGLE_THREAD)
+    #if defined(DM_HAS_THREADS)
+        #undef DM_HAS_THREADS
+    #endif
+#endif
+
+#if defined(DM_HAS_THREADS)
+    #include <dlib/dlib.h>
+    #include <dmsdk/dlib/atomic.h>
+    #include <dmsdk/dlib/condition_variable.h>
+    #include <dmsdk/dlib/mutex.h>
+    #include <dmsdk/dlib/thread.h>
+#endif
+
 namespace dmPhysics
 {
     using namespace dmVMath;
 
+#if defined(DM_HAS_THREADS)
+    /*
+     * Runs the parallel parts of b2World::Step (island solving, contact and fixture updates) on a pool of threads.
+     * The calling thread is worker 0 and takes part in each job. The threads are kept alive between jobs,
+     * as a step runs several short jobs.
+     */
+    class TaskExecutor2D : public b2TaskExecutor
+    {
+    public:
+        TaskExecutor2D(uint32_t thread_count);
+        virtual ~TaskExecutor2D();
+
+        virtual int32 GetWorkerCount() const;
+        virtual void ParallelFor(Task task, void* context, int32 count, int32 min_range);
+
+    private:
+        struct Worker
+        {
+            TaskExecutor2D*     m_Executor;
+            dmThread::Thread    m_Thread;
+            int32               m_Index;
+        };
+
+        static void WorkerThread(void* _worker);
+        void Work(int32 worker_index);
+
+        dmArray<Worker>                         m_Workers;
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_WakeupCond;
+        dmConditionVariable::HConditionVariable m_DoneCond;
+        Task                                    m_Task;
+        void*                                   m_TaskContext;
+        int32                                   m_Count;
+        int32                                   m_Range;
+        int32_atomic_t                          m_Next;
+        uint32_t                                m_Generation;
+        uint32_t                                m_Pending;
+        uint8_t                                 m_Quit:1;
+        uint8_t                                 :7;
+    };
+
+    TaskExecutor2D::TaskExecutor2D(uint32_t thread_count)
+    : m_Task(0x0)
+    , m_TaskContext(0x0)
+    , m_Count(0)
+    , m_Range(0)
+    , m_Next(0)
+    , m_Generation(0)
+    , m_Pending(0)
+    , m_Quit(0)
+    {
+        const uint32_t THREAD_STACK_SIZE = 0x80000;
+
+        m_Mutex = dmMutex::New();
+        m_WakeupCond = dmConditionVariable::New();
+        m_DoneCond = dmConditionVariable::New();
+
+        // The array must not grow after the threads have started
+        m_Workers.SetCapacity(thread_count);
+        m_Workers.SetSize(thread_count);
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            Worker& worker = m_Workers[i];
+            worker.m_Executor = this;
+            worker.m_Index = (int32)i + 1;
+            worker.m_Thread = dmThread::New(WorkerThread, THREAD_STACK_SIZE, &worker, "physics2d");
+        }
+    }
+
+    TaskExecutor2D::~TaskExecutor2D()
+    {
+        {
+            DM_MUTEX_SCOPED_LOCK(m_Mutex);
+            m_Quit = 1;
+            dmConditionVariable::Broadcast(m_WakeupCond);
+        }
+        for (uint32_t i = 0; i < m_Workers.Size(); ++i)
+        {
+            dmThread::Join(m_Workers[i].m_Thread);
+        }
+        dmConditionVariable::Delete(m_DoneCond);
+        dmConditionVariable::Delete(m_WakeupCond);
+        dmMutex::Delete(m_Mutex);
+    }
+
+    int32 TaskExecutor2D::GetWorkerCount() const
+    {
+        return (int32)m_Workers.Size() + 1;
+    }
+
+    void TaskExecutor2D::Work(int32 worker_index)
+    {
+        while (true)
+        {
+            int32 begin = dmAtomicAdd32(&m_Next, m_Range);
+            if (begin >= m_Count)
+                break;
+            int32 end = dmMath::Min(begin + m_Range, m_Count);
+            m_Task(m_TaskContext, begin, end, worker_index);
+        }
+    }
+
+    void TaskExecutor2D::WorkerThread(void* _worker)
+    {
+        Worker* worker = (Worker*)_worker;
+        TaskExecutor2D* executor = worker->m_Executor;
+        uint32_t generation = 0;
+        while (true)
+        {
+            {
+                DM_MUTEX_SCOPED_LOCK(executor->m_Mutex);
+                while (!executor->m_Quit && executor->m_Generation == generation)
+                {
+                    dmConditionVariable::Wait(executor->m_WakeupCond, executor->m_Mutex);
+                }
+                if (executor->m_Quit)
+                    return;
+                generation = executor->m_Generation;
+            }
+
+            executor->Work(worker->m_Index);
+
+            DM_MUTEX_SCOPED_LOCK(executor->m_Mutex);
+            if (--executor->m_Pending == 0)
+            {
+                dmConditionVariable::Signal(executor->m_DoneCond);
+            }
+        }
+    }
+
+    void TaskExecutor2D::ParallelFor(Task task, void* context, int32 count, int32 min_range)
+    {
+        if (count <= 0)
+            return;
+
+        // Waking the threads isn't worth it for small jobs
+        if (count <= min_range)
+        {
+            task(context, 0, count, 0);
+            return;
+        }
+
+        int32 worker_count = (int32)m_Workers.Size() + 1;
+        m_Task = task;
+        m_TaskContext = context;
+        m_Count = count;
+        // A few ranges per worker, to even out the cost of the items
+        m_Range = dmMath::Max(min_range, count / (worker_count * 4));
+        dmAtomicStore32(&m_Next, 0);
+
+        {
+            DM_MUTEX_SCOPED_LOCK(m_Mutex);
+            m_Pending = m_Workers.Size();
+            ++m_Generation;
+            dmConditionVariable::Broadcast(m_WakeupCond);
+        }
+
+        Work(0);
+
+        DM_MUTEX_SCOPED_LOCK(m_Mutex);
+        while (m_Pending > 0)
+        {
+            dmConditionVariable::Wait(m_DoneCond, m_Mutex);
+        }
+    }
+#endif
+
     Context2D::Context2D()
     : m_Worlds()
     , m_DebugCallbacks()
+    , m_TaskExecutor(0x0)
     , m_Gravity(0.0f, -10.0f)
     , m_Socket(0)
     , m_Scale(1.0f)
@@ -203,6 +390,18 @@ namespace dmPhysics
         m_TempStepWorldContext = context;
     }
 
+    static dmMemory::HTag g_Box2DMemoryTag = dmMemory::INVALID_TAG;
+
+    static void* Box2DAlloc(int32 size)
+    {
+        return dmMemory::Malloc(g_Box2DMemoryTag, (uint32_t)size);
+    }
+
+    static void Box2DFree(void* mem)
+    {
+        dmMemory::Free(mem);
+    }
+
     HContext2D NewContext2D(const NewContextParams& params)
     {
         if (params.m_Scale < MIN_SCALE || params.m_Scale > MAX_SCALE)
@@ -210,6 +409,13 @@ namespace dmPhysics
             dmLogFatal("Physics scale is outside the valid range %.2f - %.2f.", MIN_SCALE, MAX_SCALE);
             return 0x0;
         }
+        // Installed once, before any Box2D allocations are made, and then left in place
+        if (g_Box2DMemoryTag == dmMemory::INVALID_TAG)
+        {
+            g_Box2DMemoryTag = dmMemory::RegisterTag("physics");
+            b2SetAllocator(Box2DAlloc, Box2DFree);
+        }
+
         Context2D* context = new Context2D();
         context->m_Worlds.SetCapacity(params.m_WorldCount);
         ToB2(params.m_Gravity, context->m_Gravity, params.m_Scale);
@@ -221,6 +427,12 @@ namespace dmPhysics
         context->m_TriggerOverlapCapacity = params.m_TriggerOverlapCapacity;
         context->m_VelocityThreshold = params.m_VelocityThreshold;
         context->m_AllowDynamicTransforms = params.m_AllowDynamicTransforms;
+#if defined(DM_HAS_THREADS)
+        if (params.m_WorkerThreadCount2D > 0 && dLib::FeaturesSupported(DM_FEATURE_BIT_THREADS))
+        {
+            context->m_TaskExecutor = new TaskExecutor2D(params.m_WorkerThreadCount2D);
+        }
+#endif
         b2ContactSolver::setVelocityThreshold(params.m_VelocityThreshold * params.m_Scale); // overrides fixed b2_velocityThreshold in b2Settings.h. Includes compensation for the scale factor so that velocityThreshold corresponds to the velocity values used in the game.
         dmMessage::Result result = dmMessage::NewSocket(PHYSICS_SOCKET_NAME, &context->m_Socket);
         if (result != dmMessage::RESULT_OK)
@@ -242,6 +454,9 @@ namespace dmPhysics
         }
         if (context->m_Socket != 0)
             dmMessage::DeleteSocket(context->m_Socket);
+#if defined(DM_HAS_THREADS)
+        delete context->m_TaskExecutor;
+#endif
         delete context;
     }
 
@@ -261,6 +476,8 @@ namespace dmPhysics
         world->m_World.SetDebugDraw(&world->m_DebugDraw);
         world->m_World.SetContactListener(&world->m_ContactListener);
         world->m_World.SetContinuousPhysics(false);
+        if (context->m_TaskExecutor)
+            world->m_World.SetTaskExecutor(context->m_TaskExecutor);
 
         context->m_Worlds.Push(world);
         return world;
@@ -641,7 +858,7 @@ namespace dmPhysics
             if (fixture->GetShape()->GetType() == b2Shape::e_grid)
             {
                 b2GridShape* grid_shape = (b2GridShape*) fixture->GetShape();
-                grid_shape->ClearCellData();
+                grid_shape->ClearCellData(body);
             }
             fixture = fixture->GetNext();
         }
@@ -1284,6 +1501,8 @@ namespace dmPhysics
         query.m_IgnoredUserData = request.m_IgnoredUserData;
         query.m_CollisionMask = request.m_Mask;
         query.m_Response.m_Hit = 0;
+        // Tiles might have been changed since the last step
+        world->m_World.UpdateGrids();
         world->m_World.RayCast(&query, from, to);
 
         if (!request.m_ReturnAllResults) {
@@ -25,6 +25,8 @@
 
 namespace dmPhysics
 {
+    class TaskExecutor2D;
+
     class ContactListener : public b2ContactListener
     {
     public:
@@ -62,6 +64,8 @@ namespace dmPhysics
 
         dmArray<World2D*>           m_Worlds;
         DebugCallbacks              m_DebugCallbacks;
+        /// Steps the worlds on worker threads, 0x0 if stepped on the calling thread only
+        TaskExecutor2D*             m_TaskExecutor;
         b2Vec2                      m_Gravity;
         dmMessage::HSocket          m_Socket;
         float                       m_Scale;
@@ -24,7 +24,12 @@
 
 #include <vector>
 #include <dlib/math.h>
+#include <dlib/memory.h>
+#include <dlib/time.h>
 #include <dlib/vmath.h>
+#include <Box2D/Collision/Shapes/b2GridShape.h>
+#include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/Joints/b2GearJoint.h>
 
 dmPhysics::HullFlags EMPTY_FLAGS;
 
@@ -570,11 +575,12 @@ TYPED_TEST(PhysicsTest, GridShapeCrack)
     dmPhysics::HCollisionShape2D grid_shape = dmPhysics::NewGridShape2D(TestFixture::m_Context, hull_set, dmVMath::Point3(0,0,0), cell_width, cell_height, rows, columns);
     typename TypeParam::CollisionObjectType grid_co = (*TestFixture::m_Test.m_NewCollisionObjectFunc)(TestFixture::m_World, data, &grid_shape, 1u);
 
+    // Different hulls keep the cells from being merged into one box
     for (int32_t row = 0; row < rows; ++row)
     {
         for (int32_t col = 0; col < columns; ++col)
         {
-            dmPhysics::SetGridShapeHull(grid_co, 0, row, col, 0, EMPTY_FLAGS);
+            dmPhysics::SetGridShapeHull(grid_co, 0, row, col, col, EMPTY_FLAGS);
         }
     }
 
@@ -653,11 +659,12 @@ TYPED_TEST(PhysicsTest, PolygonShape)
     dmPhysics::HCollisionShape2D grid_shape = dmPhysics::NewGridShape2D(TestFixture::m_Context, hull_set, dmVMath::Point3(0,0,0), cell_width, cell_height, rows, columns);
     typename TypeParam::CollisionObjectType grid_co = (*TestFixture::m_Test.m_NewCollisionObjectFunc)(TestFixture::m_World, data, &grid_shape, 1u);
 
+    // Different hulls keep the cells from being merged into one box
     for (int32_t row = 0; row < rows; ++row)
     {
         for (int32_t col = 0; col < columns; ++col)
         {
-            dmPhysics::SetGridShapeHull(grid_co, 0, row, col, 0, EMPTY_FLAGS);
+            dmPhysics::SetGridShapeHull(grid_co, 0, row, col, col, EMPTY_FLAGS);
         }
     }
 
@@ -1608,6 +1615,558 @@ TYPED_TEST(PhysicsTest, GridShapeEmptyHull)
     dmPhysics::DeleteHullSet2D(hull_set);
 }
 
+static b2GridShape* GetGridShape(void* collision_object)
+{
+    b2Body* body = (b2Body*) collision_object;
+    return (b2GridShape*) body->GetFixtureList()->GetShape();
+}
+
+static uint32_t GetGridRegionCount(void* collision_object)
+{
+    return GetGridShape(collision_object)->GetRegionCount();
+}
+
+// Test that solid cells are merged into regions and that the regions are updated when cells change
+TYPED_TEST(PhysicsTest, GridShapeRegions)
+{
+    int32_t rows = 4;
+    int32_t columns = 8;
+    int32_t cell_width = 16;
+    int32_t cell_height = 16;
+
+    VisualObject vo_a;
+    vo_a.m_Position = dmVMath::Point3(0, 0, 0);
+    dmPhysics::CollisionObjectData data;
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_STATIC;
+    data.m_Mass = 0.0f;
+    data.m_UserData = &vo_a;
+    data.m_Group = 0xffff;
+    data.m_Mask = 0xffff;
+
+    const float hull_vertices[] = {  // 1x1 around origo
+                                    -0.5f, -0.5f,
+                                     0.5f, -0.5f,
+                                     0.5f,  0.5f,
+                                    -0.5f,  0.5f,
+                                    // lower half of the cell
+                                    -0.5f, -0.5f,
+                                     0.5f, -0.5f,
+                                     0.5f,  0.0f,
+                                    -0.5f,  0.0f };
+
+    const dmPhysics::HullDesc hulls[] = { {0, 4}, {4, 4} };
+    dmPhysics::HHullSet2D hull_set = dmPhysics::NewHullSet2D(TestFixture::m_Context, hull_vertices, 8, hulls, 2);
+    dmPhysics::HCollisionShape2D grid_shape = dmPhysics::NewGridShape2D(TestFixture::m_Context, hull_set, dmVMath::Point3(0,0,0), cell_width, cell_height, rows, columns);
+    typename TypeParam::CollisionObjectType grid_co = (*TestFixture::m_Test.m_NewCollisionObjectFunc)(TestFixture::m_World, data, &grid_shape, 1u);
+
+    for (int32_t row = 0; row < rows; ++row)
+    {
+        for (int32_t col = 0; col < columns; ++col)
+        {
+            dmPhysics::SetGridShapeHull(grid_co, 0, row, col, 0, EMPTY_FLAGS);
+        }
+    }
+
+    std::vector<dmPhysics::RayCastResponse> responses;
+    TestFixture::m_StepWorldContext.m_RayCastCallback = RayCastCallback;
+    TestFixture::m_StepWorldContext.m_RayCastUserData = (void*) &responses;
+
+    // A vertical ray through the third column
+    dmPhysics::RayCastRequest ray_request;
+    ray_request.m_From = dmVMath::Point3(-24, 100, 0);
+    ray_request.m_To = dmVMath::Point3(-24, -100, 0);
+    ray_request.m_IgnoredUserData = 0;
+    ray_request.m_UserData = 0;
+    ray_request.m_Mask = 0xffff;
+    ray_request.m_UserId = 0;
+
+    TestFixture::m_Test.m_RequestRayCastFunc(TestFixture::m_World, ray_request);
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+
+    // All cells are merged into one region
+    ASSERT_EQ(1u, GetGridRegionCount(grid_co));
+    ASSERT_EQ(1U, responses.size());
+    ASSERT_NEAR(32.0f, responses[0].m_Position.getY(), 0.0001f);
+
+    // Clear the third column, the region is split in two
+    for (int32_t row = 0; row < rows; ++row)
+    {
+        dmPhysics::SetGridShapeHull(grid_co, 0, row, 2, dmPhysics::GRIDSHAPE_EMPTY_CELL, EMPTY_FLAGS);
+    }
+    responses.clear();
+    TestFixture::m_Test.m_RequestRayCastFunc(TestFixture::m_World, ray_request);
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+
+    ASSERT_EQ(2u, GetGridRegionCount(grid_co));
+    ASSERT_EQ(0U, responses.size());
+
+    // Half cells are never merged
+    dmPhysics::SetGridShapeHull(grid_co, 0, 0, 2, 1, EMPTY_FLAGS);
+    responses.clear();
+    TestFixture::m_Test.m_RequestRayCastFunc(TestFixture::m_World, ray_request);
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+
+    ASSERT_EQ(3u, GetGridRegionCount(grid_co));
+    ASSERT_EQ(1U, responses.size());
+    ASSERT_NEAR(-24.0f, responses[0].m_Position.getY(), 0.0001f);
+
+    // Refilling the column merges the cells with their neighbours again
+    for (int32_t row = 0; row < rows; ++row)
+    {
+        dmPhysics::SetGridShapeHull(grid_co, 0, row, 2, 0, EMPTY_FLAGS);
+    }
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    ASSERT_EQ(1u, GetGridRegionCount(grid_co));
+
+    // Split the grid in three, and keep the polygon of the middle region
+    for (int32_t row = 0; row < rows; ++row)
+    {
+        dmPhysics::SetGridShapeHull(grid_co, 0, row, 2, dmPhysics::GRIDSHAPE_EMPTY_CELL, EMPTY_FLAGS);
+        dmPhysics::SetGridShapeHull(grid_co, 0, row, 5, dmPhysics::GRIDSHAPE_EMPTY_CELL, EMPTY_FLAGS);
+    }
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    ASSERT_EQ(3u, GetGridRegionCount(grid_co));
+
+    b2GridShape* b2_grid_shape = GetGridShape(grid_co);
+    const b2GridShape::Region* middle_region = b2_grid_shape->GetCellRegion(3);
+    const b2PolygonShape* middle_polygon = b2_grid_shape->GetPolygonShapeForChild(3);
+    ASSERT_NE((void*) 0, middle_region);
+    ASSERT_NE((void*) 0, middle_polygon);
+
+    // Changing cells in opposite corners only rebuilds the regions next to them
+    dmPhysics::SetGridShapeHull(grid_co, 0, 0, 0, 1, EMPTY_FLAGS);
+    dmPhysics::SetGridShapeHull(grid_co, 0, rows - 1, columns - 1, 1, EMPTY_FLAGS);
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    ASSERT_EQ(7u, GetGridRegionCount(grid_co));
+    ASSERT_EQ(middle_region, b2_grid_shape->GetCellRegion(3));
+    ASSERT_EQ(middle_polygon, middle_region->m_polygon);
+
+    dmPhysics::ClearGridShapeHulls(grid_co);
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    ASSERT_EQ(0u, GetGridRegionCount(grid_co));
+
+    (*TestFixture::m_Test.m_DeleteCollisionObjectFunc)(TestFixture::m_World, grid_co);
+    (*TestFixture::m_Test.m_DeleteCollisionShapeFunc)(grid_shape);
+    dmPhysics::DeleteHullSet2D(hull_set);
+}
+
+// Creation time, memory and step time of a large tilemap
+TYPED_TEST(PhysicsTest, GridShapeLargeTilemap)
+{
+    const int32_t rows = 1000;
+    const int32_t columns = 1000;
+
+    VisualObject vo_a;
+    vo_a.m_Position = dmVMath::Point3(0, 0, 0);
+    dmPhysics::CollisionObjectData data;
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_STATIC;
+    data.m_Mass = 0.0f;
+    data.m_UserData = &vo_a;
+    data.m_Group = 0xffff;
+    data.m_Mask = 0xffff;
+
+    const float hull_vertices[] = {  // 1x1 around origo
+                                    -0.5f, -0.5f,
+                                     0.5f, -0.5f,
+                                     0.5f,  0.5f,
+                                    -0.5f,  0.5f,
+                                    // lower half of the cell
+                                    -0.5f, -0.5f,
+                                     0.5f, -0.5f,
+                                     0.5f,  0.0f,
+                                    -0.5f,  0.0f };
+
+    const dmPhysics::HullDesc hulls[] = { {0, 4}, {4, 4} };
+    dmPhysics::HHullSet2D hull_set = dmPhysics::NewHullSet2D(TestFixture::m_Context, hull_vertices, 8, hulls, 2);
+
+    dmMemory::TagStats stats_before;
+    dmMemory::GetTagStats(dmMemory::FindTag("physics"), &stats_before);
+
+    uint64_t start = dmTime::GetTime();
+    dmPhysics::HCollisionShape2D grid_shape = dmPhysics::NewGridShape2D(TestFixture::m_Context, hull_set, dmVMath::Point3(0,0,0), 16, 16, rows, columns);
+    typename TypeParam::CollisionObjectType grid_co = (*TestFixture::m_Test.m_NewCollisionObjectFunc)(TestFixture::m_World, data, &grid_shape, 1u);
+
+    // Platforms every 20 rows, walls every 50 columns and some scattered solid and half tiles
+    uint32_t seed = 1;
+    uint32_t solid_count = 0;
+    for (int32_t row = 0; row < rows; ++row)
+    {
+        for (int32_t col = 0; col < columns; ++col)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t r = (seed >> 16) % 100;
+            if ((row % 20) < 2 || (col % 50) == 0 || r < 3)
+            {
+                dmPhysics::SetGridShapeHull(grid_co, 0, row, col, r < 1 ? 1 : 0, EMPTY_FLAGS);
+                ++solid_count;
+            }
+        }
+    }
+    uint64_t set_time = dmTime::GetTime() - start;
+
+    start = dmTime::GetTime();
+    (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    uint64_t first_step_time = dmTime::GetTime() - start;
+
+    dmMemory::TagStats stats_after;
+    dmMemory::GetTagStats(dmMemory::FindTag("physics"), &stats_after);
+
+    // Spheres falling onto the platforms
+    const uint32_t sphere_count = 100;
+    VisualObject vo_spheres[sphere_count];
+    typename TypeParam::CollisionObjectType sphere_cos[sphere_count];
+    typename TypeParam::CollisionShapeType sphere_shape = (*TestFixture::m_Test.m_NewSphereShapeFunc)(TestFixture::m_Context, 6.0f);
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_DYNAMIC;
+    data.m_Mass = 1.0f;
+    for (uint32_t i = 0; i < sphere_count; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        vo_spheres[i].m_Position = dmVMath::Point3((float)((seed >> 8) % 15000) - 7500.0f, (float)((seed >> 4) % 15000) - 7500.0f, 0.0f);
+        data.m_UserData = &vo_spheres[i];
+        sphere_cos[i] = (*TestFixture::m_Test.m_NewCollisionObjectFunc)(TestFixture::m_World, data, &sphere_shape, 1u);
+    }
+
+    start = dmTime::GetTime();
+    const uint32_t step_count = 60;
+    for (uint32_t i = 0; i < step_count; ++i)
+    {
+        (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    }
+    uint64_t step_time = dmTime::GetTime() - start;
+
+    uint32_t region_count = GetGridRegionCount(grid_co);
+
+    // Cells changed far apart, e.g. tiles destroyed on both sides of the map
+    start = dmTime::GetTime();
+    for (uint32_t i = 0; i < step_count; ++i)
+    {
+        uint32_t hull = i % 2 == 0 ? dmPhysics::GRIDSHAPE_EMPTY_CELL : 0;
+        dmPhysics::SetGridShapeHull(grid_co, 0, 0, 1, hull, EMPTY_FLAGS);
+        dmPhysics::SetGridShapeHull(grid_co, 0, rows - 1, columns - 2, hull, EMPTY_FLAGS);
+        (*TestFixture::m_Test.m_StepWorldFunc)(TestFixture::m_World, TestFixture::m_StepWorldContext);
+    }
+    uint64_t change_step_time = dmTime::GetTime() - start;
+    ASSERT_EQ(region_count, GetGridRegionCount(grid_co));
+
+    printf("Tilemap %dx%d, %u solid cells, %u regions\n", rows, columns, solid_count, region_count);
+    printf("  set cells: %.2f ms, first step: %.2f ms, step: %.3f ms, step with changed cells: %.3f ms\n", set_time / 1000.0f, first_step_time / 1000.0f,
+           step_time / (1000.0f * step_count), change_step_time / (1000.0f * step_count));
+    printf("  physics memory: %u kb\n", (stats_after.m_LiveBytes - stats_before.m_LiveBytes) / 1024);
+
+    ASSERT_LT(region_count, solid_count / 4);
+
+    for (uint32_t i = 0; i < sphere_count; ++i)
+    {
+        (*TestFixture::m_Test.m_DeleteCollisionObjectFunc)(TestFixture::m_World, sphere_cos[i]);
+    }
+    (*TestFixture::m_Test.m_DeleteCollisionShapeFunc)(sphere_shape);
+    (*TestFixture::m_Test.m_DeleteCollisionObjectFunc)(TestFixture::m_World, grid_co);
+    (*TestFixture::m_Test.m_DeleteCollisionShapeFunc)(grid_shape);
+    dmPhysics::DeleteHullSet2D(hull_set);
+}
+
+// Steps a scene of independent box stacks on a static ground with the given number of worker threads.
+// Returns the total step time, and the final positions of the boxes.
+template<typename T>
+static uint64_t StepBoxStacks(T& test, uint32_t worker_thread_count, uint32_t stack_count, uint32_t stack_height, uint32_t step_count, std::vector<dmVMath::Point3>& positions)
+{
+    dmPhysics::NewContextParams context_params = dmPhysics::NewContextParams();
+    context_params.m_Scale = PHYSICS_SCALE;
+    context_params.m_WorkerThreadCount2D = worker_thread_count;
+    typename T::ContextType context = (*test.m_NewContextFunc)(context_params);
+
+    dmPhysics::NewWorldParams world_params;
+    world_params.m_GetWorldTransformCallback = GetWorldTransform;
+    world_params.m_SetWorldTransformCallback = SetWorldTransform;
+    world_params.m_MaxCollisionObjectsCount = stack_count * stack_height + 1;
+    typename T::WorldType world = (*test.m_NewWorldFunc)(context, world_params);
+
+    dmPhysics::StepWorldContext step_context;
+    step_context.m_DT = 1.0f / 60.0f;
+    step_context.m_MaxFixedTimeSteps = 2;
+
+    const float spacing = 12.0f;
+    const float ground_extent = stack_count * spacing * 0.5f + spacing;
+
+    dmPhysics::CollisionObjectData data;
+    data.m_Group = 0xffff;
+    data.m_Mask = 0xffff;
+
+    VisualObject ground_vo;
+    ground_vo.m_Position = dmVMath::Point3(0.0f, -1.0f, 0.0f);
+    typename T::CollisionShapeType ground_shape = (*test.m_NewBoxShapeFunc)(context, dmVMath::Vector3(ground_extent, 1.0f, 1.0f));
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_STATIC;
+    data.m_Mass = 0.0f;
+    data.m_UserData = &ground_vo;
+    typename T::CollisionObjectType ground_co = (*test.m_NewCollisionObjectFunc)(world, data, &ground_shape, 1u);
+
+    uint32_t box_count = stack_count * stack_height;
+    std::vector<VisualObject> box_vos(box_count);
+    std::vector<typename T::CollisionObjectType> box_cos(box_count);
+    typename T::CollisionShapeType box_shape = (*test.m_NewBoxShapeFunc)(context, dmVMath::Vector3(2.0f, 2.0f, 2.0f));
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_DYNAMIC;
+    data.m_Mass = 1.0f;
+    for (uint32_t i = 0; i < box_count; ++i)
+    {
+        uint32_t stack = i / stack_height;
+        uint32_t level = i % stack_height;
+        // Slightly offset, so that the stacks topple a bit
+        box_vos[i].m_Position = dmVMath::Point3(stack * spacing - ground_extent + spacing + level * 0.1f, 2.0f + level * 4.05f, 0.0f);
+        data.m_UserData = &box_vos[i];
+        box_cos[i] = (*test.m_NewCollisionObjectFunc)(world, data, &box_shape, 1u);
+    }
+
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t i = 0; i < step_count; ++i)
+    {
+        (*test.m_StepWorldFunc)(world, step_context);
+    }
+    uint64_t step_time = dmTime::GetTime() - start;
+
+    positions.resize(box_count);
+    for (uint32_t i = 0; i < box_count; ++i)
+    {
+        positions[i] = (*test.m_GetWorldPositionFunc)(context, box_cos[i]);
+        (*test.m_DeleteCollisionObjectFunc)(world, box_cos[i]);
+    }
+    (*test.m_DeleteCollisionShapeFunc)(box_shape);
+    (*test.m_DeleteCollisionObjectFunc)(world, ground_co);
+    (*test.m_DeleteCollisionShapeFunc)(ground_shape);
+    (*test.m_DeleteWorldFunc)(context, world);
+    (*test.m_DeleteContextFunc)(context);
+    return step_time;
+}
+
+enum JointScene
+{
+    JOINT_SCENE_GEARS,
+    JOINT_SCENE_PENDULUMS,
+};
+
+// Steps a scene of independent machines hinged to one static ground body, so that every island shares it.
+// In the gear scene each machine is a motorized wheel geared to a second wheel, in the pendulum scene it's
+// a chain of hinged links. The machines have different numbers of links, so that the ground ends up at
+// different indices in the islands. Returns the final positions and rotations of the dynamic bodies.
+template<typename T>
+static void StepJointScene(T& test, uint32_t worker_thread_count, JointScene scene, uint32_t machine_count, uint32_t step_count,
+                           std::vector<dmVMath::Point3>& positions, std::vector<dmVMath::Quat>& rotations)
+{
+    const uint32_t max_link_count = 3;
+
+    dmPhysics::NewContextParams context_params = dmPhysics::NewContextParams();
+    context_params.m_Scale = PHYSICS_SCALE;
+    context_params.m_WorkerThreadCount2D = worker_thread_count;
+    typename T::ContextType context = (*test.m_NewContextFunc)(context_params);
+
+    dmPhysics::NewWorldParams world_params;
+    world_params.m_GetWorldTransformCallback = GetWorldTransform;
+    world_params.m_SetWorldTransformCallback = SetWorldTransform;
+    world_params.m_MaxCollisionObjectsCount = machine_count * (2 + max_link_count) + 1;
+    typename T::WorldType world = (*test.m_NewWorldFunc)(context, world_params);
+
+    dmPhysics::StepWorldContext step_context;
+    step_context.m_DT = 1.0f / 60.0f;
+    step_context.m_MaxFixedTimeSteps = 2;
+
+    // Far enough apart that the machines never touch, so each one is an island of its own
+    const float spacing = 40.0f;
+    const float ground_extent = machine_count * spacing * 0.5f + spacing;
+    const float pivot_y = 30.0f;
+
+    dmPhysics::CollisionObjectData data;
+    data.m_Group = 0xffff;
+    data.m_Mask = 0xffff;
+
+    VisualObject ground_vo;
+    ground_vo.m_Position = dmVMath::Point3(0.0f, -1.0f, 0.0f);
+    typename T::CollisionShapeType ground_shape = (*test.m_NewBoxShapeFunc)(context, dmVMath::Vector3(ground_extent, 1.0f, 1.0f));
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_STATIC;
+    data.m_Mass = 0.0f;
+    data.m_UserData = &ground_vo;
+    typename T::CollisionObjectType ground_co = (*test.m_NewCollisionObjectFunc)(world, data, &ground_shape, 1u);
+    b2World* b2_world = ((b2Body*) ground_co)->GetWorld();
+
+    // The visual objects are referenced by the bodies, and must not move
+    std::vector<VisualObject> body_vos;
+    body_vos.reserve(machine_count * (2 + max_link_count));
+    std::vector<typename T::CollisionObjectType> body_cos;
+    std::vector<dmPhysics::HJoint> hinges;
+    std::vector<b2Joint*> gears;
+    typename T::CollisionShapeType body_shape = (*test.m_NewBoxShapeFunc)(context, dmVMath::Vector3(2.0f, 1.0f, 1.0f));
+    data.m_Type = dmPhysics::COLLISION_OBJECT_TYPE_DYNAMIC;
+    data.m_Mass = 1.0f;
+
+    // All bodies are 4 units long, and hinged 2 units left of their center
+    const dmVMath::Point3 left_anchor(-2.0f, 0.0f, 0.0f);
+    const dmVMath::Point3 right_anchor(2.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < machine_count; ++i)
+    {
+        const float x = i * spacing - ground_extent + spacing;
+        // The ground anchors are relative to the ground body
+        const dmVMath::Point3 ground_anchor(x, pivot_y - ground_vo.m_Position.getY(), 0.0f);
+        const uint32_t link_count = 1 + i % max_link_count;
+        dmPhysics::ConnectJointParams params(dmPhysics::JOINT_TYPE_HINGE);
+
+        // The first body of a chain of links starting out horizontal, hinged to the ground
+        typename T::CollisionObjectType prev_co = ground_co;
+        dmVMath::Point3 prev_anchor = ground_anchor;
+        float link_x = x + 2.0f;
+
+        if (scene == JOINT_SCENE_GEARS)
+        {
+            // Both wheels are hinged off center, so that their positions follow their rotations
+            const float pivot_distance = 20.0f;
+            typename T::CollisionObjectType wheel_cos[2];
+            for (uint32_t j = 0; j < 2; ++j)
+            {
+                body_vos.push_back(VisualObject());
+                body_vos.back().m_Position = dmVMath::Point3(x + j * pivot_distance + 2.0f, pivot_y, 0.0f);
+                data.m_UserData = &body_vos.back();
+                wheel_cos[j] = (*test.m_NewCollisionObjectFunc)(world, data, &body_shape, 1u);
+                body_cos.push_back(wheel_cos[j]);
+
+                params.m_HingeJointParams.m_EnableMotor = j == 0;
+                params.m_HingeJointParams.m_MotorSpeed = 2.0f + 0.01f * i;
+                params.m_HingeJointParams.m_MaxMotorTorque = 1000.0f;
+                hinges.push_back(dmPhysics::CreateJoint2D(world, ground_co, ground_anchor + dmVMath::Vector3(j * pivot_distance, 0.0f, 0.0f),
+                                                          wheel_cos[j], left_anchor, dmPhysics::JOINT_TYPE_HINGE, params));
+            }
+            params.m_HingeJointParams.m_EnableMotor = false;
+
+            // Gear joints aren't exposed by dmPhysics. The static ground is body C and D of the gear.
+            b2GearJointDef gear_def;
+            gear_def.bodyA = (b2Body*) wheel_cos[0];
+            gear_def.bodyB = (b2Body*) wheel_cos[1];
+            gear_def.joint1 = (b2Joint*) hinges[hinges.size() - 2];
+            gear_def.joint2 = (b2Joint*) hinges[hinges.size() - 1];
+            gear_def.ratio = 2.0f;
+            gears.push_back(b2_world->CreateJoint(&gear_def));
+
+            // The links hang from the far end of the first wheel
+            prev_co = wheel_cos[0];
+            prev_anchor = right_anchor;
+            link_x = x + 6.0f;
+        }
+
+        for (uint32_t j = 0; j < link_count; ++j)
+        {
+            body_vos.push_back(VisualObject());
+            body_vos.back().m_Position = dmVMath::Point3(link_x + j * 4.0f, pivot_y, 0.0f);
+            data.m_UserData = &body_vos.back();
+            typename T::CollisionObjectType link_co = (*test.m_NewCollisionObjectFunc)(world, data, &body_shape, 1u);
+            body_cos.push_back(link_co);
+
+            hinges.push_back(dmPhysics::CreateJoint2D(world, prev_co, prev_anchor, link_co, left_anchor, dmPhysics::JOINT_TYPE_HINGE, params));
+            prev_co = link_co;
+            prev_anchor = right_anchor;
+        }
+    }
+    const uint32_t body_count = body_cos.size();
+
+    for (uint32_t i = 0; i < step_count; ++i)
+    {
+        (*test.m_StepWorldFunc)(world, step_context);
+    }
+
+    positions.resize(body_count);
+    rotations.resize(body_count);
+    for (uint32_t i = 0; i < body_count; ++i)
+    {
+        positions[i] = (*test.m_GetWorldPositionFunc)(context, body_cos[i]);
+        rotations[i] = (*test.m_GetWorldRotationFunc)(context, body_cos[i]);
+    }
+
+    // The gears reference the hinges, so they go first
+    for (uint32_t i = 0; i < gears.size(); ++i)
+    {
+        b2_world->DestroyJoint(gears[i]);
+    }
+    for (uint32_t i = 0; i < hinges.size(); ++i)
+    {
+        dmPhysics::DeleteJoint2D(world, hinges[i]);
+    }
+    for (uint32_t i = 0; i < body_count; ++i)
+    {
+        (*test.m_DeleteCollisionObjectFunc)(world, body_cos[i]);
+    }
+    (*test.m_DeleteCollisionShapeFunc)(body_shape);
+    (*test.m_DeleteCollisionObjectFunc)(world, ground_co);
+    (*test.m_DeleteCollisionShapeFunc)(ground_shape);
+    (*test.m_DeleteWorldFunc)(context, world);
+    (*test.m_DeleteContextFunc)(context);
+}
+
+// Test that stepping on worker threads gives the same result for any number of threads, and print the speedup
+TYPED_TEST(PhysicsTest, StepWorkerThreads)
+{
+    const uint32_t stack_count = 200;
+    const uint32_t stack_height = 10;
+    const uint32_t step_count = 120;
+    const uint32_t worker_thread_counts[] = { 0, 1, 3, 7 };
+    const uint32_t run_count = DM_ARRAY_SIZE(worker_thread_counts);
+
+    // Each thread count needs a context of its own, and only one context at a time can own the physics socket
+    (*TestFixture::m_Test.m_DeleteWorldFunc)(TestFixture::m_Context, TestFixture::m_World);
+    (*TestFixture::m_Test.m_DeleteContextFunc)(TestFixture::m_Context);
+
+    std::vector<dmVMath::Point3> positions[run_count];
+    uint64_t times[run_count];
+    for (uint32_t i = 0; i < run_count; ++i)
+    {
+        times[i] = StepBoxStacks(TestFixture::m_Test, worker_thread_counts[i], stack_count, stack_height, step_count, positions[i]);
+    }
+
+    // Islands joined to the same static body, through gear and revolute joints
+    const uint32_t machine_count = 50;
+    const JointScene joint_scenes[] = { JOINT_SCENE_GEARS, JOINT_SCENE_PENDULUMS };
+    const uint32_t joint_scene_count = DM_ARRAY_SIZE(joint_scenes);
+    std::vector<dmVMath::Point3> joint_positions[joint_scene_count][run_count];
+    std::vector<dmVMath::Quat> joint_rotations[joint_scene_count][run_count];
+    for (uint32_t s = 0; s < joint_scene_count; ++s)
+    {
+        for (uint32_t i = 0; i < run_count; ++i)
+        {
+            StepJointScene(TestFixture::m_Test, worker_thread_counts[i], joint_scenes[s], machine_count, step_count, joint_positions[s][i], joint_rotations[s][i]);
+        }
+    }
+
+    TestFixture::SetUp();
+
+    printf("%u bodies, %u steps\n", stack_count * stack_height, step_count);
+    for (uint32_t i = 0; i < run_count; ++i)
+    {
+        printf("  %u worker threads: %.2f ms/step, speedup %.2fx\n", worker_thread_counts[i], times[i] / (1000.0f * step_count), times[0] / (float)dmMath::Max<uint64_t>(times[i], 1));
+    }
+
+    for (uint32_t i = 1; i < run_count; ++i)
+    {
+        ASSERT_EQ(positions[0].size(), positions[i].size());
+        for (uint32_t j = 0; j < positions[i].size(); ++j)
+        {
+            ASSERT_EQ(positions[0][j].getX(), positions[i][j].getX());
+            ASSERT_EQ(positions[0][j].getY(), positions[i][j].getY());
+        }
+    }
+
+    for (uint32_t s = 0; s < joint_scene_count; ++s)
+    {
+        // The machines must have moved, or there is nothing to compare
+        ASSERT_NE(0.0f, joint_rotations[s][0][0].getZ());
+
+        for (uint32_t i = 1; i < run_count; ++i)
+        {
+            ASSERT_EQ(joint_positions[s][0].size(), joint_positions[s][i].size());
+            for (uint32_t j = 0; j < joint_positions[s][i].size(); ++j)
+            {
+                ASSERT_EQ(joint_positions[s][0][j].getX(), joint_positions[s][i][j].getX());
+                ASSERT_EQ(joint_positions[s][0][j].getY(), joint_positions[s][i][j].getY());
+                ASSERT_EQ(joint_rotations[s][0][j].getZ(), joint_rotations[s][i][j].getZ());
+                ASSERT_EQ(joint_rotations[s][0][j].getW(), joint_rotations[s][i][j].getW());
+            }
+        }
+    }
+}
+
 // Test that grid shape cells are flipped correctly
 TYPED_TEST(PhysicsTest, GridShapeFlipped)
 {
@@ -17,6 +17,7 @@
 #include <dlib/dlib.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/memory.h>
 #include <dlib/profile.h>
 #include <dlib/time.h>
 #include <extension/extension.h>
@@ -150,6 +151,93 @@ static int MemoryUsage(lua_State* L)
     return 1;
 }
 
+/*# get the engine memory usage per subsystem
+ * Get the memory accounted to each engine subsystem and resource type, as tracked by the engine
+ * itself. Subsystems are e.g. `lua`, `physics`, `gui` and `sprite`, and each resource type is listed
+ * as `resource.<extension>`.
+ *
+ * @name profiler.get_memory_stats
+ * @return stats [type:table] a table with one entry per subsystem, keyed by name. Each entry has the fields:
+ *
+ * `live`
+ * : [type:number] bytes currently allocated
+ *
+ * `peak`
+ * : [type:number] the highest number of bytes allocated at any time
+ *
+ * `count`
+ * : [type:number] number of live allocations
+ *
+ * `soft_budget`
+ * : [type:number] the soft budget in bytes, 0 if not set
+ *
+ * `hard_budget`
+ * : [type:number] the hard budget in bytes, 0 if not set
+ *
+ * @examples
+ *
+ * ```lua
+ * local stats = profiler.get_memory_stats()
+ * print(stats["lua"].live, stats["resource.texturec"].live)
+ * ```
+ */
+static int MemoryStats(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1);
+    lua_newtable(L);
+    uint32_t tag_count = dmMemory::GetTagCount();
+    for (uint32_t i = 0; i < tag_count; ++i)
+    {
+        dmMemory::TagStats stats;
+        dmMemory::GetTagStats(i, &stats);
+
+        lua_newtable(L);
+        lua_pushnumber(L, stats.m_LiveBytes);
+        lua_setfield(L, -2, "live");
+        lua_pushnumber(L, stats.m_PeakBytes);
+        lua_setfield(L, -2, "peak");
+        lua_pushnumber(L, stats.m_LiveCount);
+        lua_setfield(L, -2, "count");
+        lua_pushnumber(L, stats.m_SoftBudget);
+        lua_setfield(L, -2, "soft_budget");
+        lua_pushnumber(L, stats.m_HardBudget);
+        lua_setfield(L, -2, "hard_budget");
+        lua_setfield(L, -2, stats.m_Name);
+    }
+    return 1;
+}
+
+/*# set the memory budgets of a subsystem
+ * Set the soft and hard memory budget of a subsystem or resource type. When the memory of the subsystem
+ * goes above a budget, a warning (soft budget) or an error (hard budget) is logged.
+ * The budgets can also be set in `game.project`, with `memory.<name>_soft_budget_kb` and `memory.<name>_hard_budget_kb`.
+ *
+ * @name profiler.set_memory_budget
+ * @param name [type:string] the subsystem name, as listed by [ref:profiler.get_memory_stats]
+ * @param soft_budget [type:number] the soft budget in bytes, 0 to disable
+ * @param hard_budget [type:number] the hard budget in bytes, 0 to disable
+ *
+ * @examples
+ *
+ * ```lua
+ * profiler.set_memory_budget("lua", 8 * 1024 * 1024, 16 * 1024 * 1024)
+ * ```
+ */
+static int SetMemoryBudget(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 0);
+    const char* name = luaL_checkstring(L, 1);
+    uint32_t soft_budget = (uint32_t) luaL_checknumber(L, 2);
+    uint32_t hard_budget = (uint32_t) luaL_checknumber(L, 3);
+    dmMemory::HTag tag = dmMemory::FindTag(name);
+    if (tag == dmMemory::INVALID_TAG)
+    {
+        return DM_LUA_ERROR("No memory statistics named '%s'", name);
+    }
+    dmMemory::SetTagBudget(tag, soft_budget, hard_budget);
+    return 0;
+}
+
 /*# get current CPU usage for app reported by OS
  * Get the percent of CPU usage by the application, as reported by the OS.
  *
@@ -648,6 +736,8 @@ static dmExtension::Result InitializeProfiler(dmExtension::Params* params)
     {
         {"get_memory_usage",            MemoryUsage},
         {"get_cpu_usage",               CPUUsage},
+        {"get_memory_stats",            MemoryStats},
+        {"set_memory_budget",           SetMemoryBudget},
         {"enable_ui",                   EnableProfilerUI},
         {"set_ui_mode",                 SetProfileUIMode},
         {"set_ui_view_mode",            SetProfilerUIViewMode},
@@ -172,6 +172,8 @@ namespace dmRender
      * @member m_VertexCount [type: uint32_t] the vertex count
      * @member m_SetBlendFactors [type: uint8_t:1] use the blend factors
      * @member m_SetStencilTest [type: uint8_t:1] use the stencil test
+     * @member m_SetScissor [type: uint8_t:1] use the scissor rectangle
+     * @member m_ScissorRect [type: dmVMath::Vector4] the scissor rectangle in the same space as the vertices (min x, min y, max x, max y)
      */
     struct RenderObject
     {
@@ -199,6 +201,8 @@ namespace dmRender
         uint8_t                         m_SetBlendFactors : 1;
         uint8_t                         m_SetStencilTest : 1;
         uint8_t                         m_SetFaceWinding : 1;
+        uint8_t                         m_SetScissor : 1;
+        dmVMath::Vector4                m_ScissorRect;
     };
 
     /*#
@@ -351,12 +351,12 @@ void IterateNamedConstants(HNamedConstantBuffer buffer, void (*callback)(dmhash_
 
 struct ApplyConstantContext
 {
-    dmGraphics::HContext m_GraphicsContext;
+    HRenderContext       m_RenderContext;
     HMaterial            m_Material;
     HNamedConstantBuffer m_ConstantBuffer;
-    ApplyConstantContext(dmGraphics::HContext graphics_context, HMaterial material, HNamedConstantBuffer constant_buffer)
+    ApplyConstantContext(HRenderContext render_context, HMaterial material, HNamedConstantBuffer constant_buffer)
     {
-        m_GraphicsContext = graphics_context;
+        m_RenderContext = render_context;
         m_Material = material;
         m_ConstantBuffer = constant_buffer;
     }
@@ -368,22 +368,14 @@ static inline void ApplyConstant(ApplyConstantContext* context, const uint64_t*
     if (location)
     {
         dmVMath::Vector4* values = &context->m_ConstantBuffer->m_Values[constant->m_ValueIndex];
-
-        if (constant->m_Type == dmRenderDDF::MaterialDesc::CONSTANT_TYPE_USER_MATRIX4)
-        {
-            dmGraphics::SetConstantM4(context->m_GraphicsContext, values, constant->m_NumValues / 4, *location);
-        }
-        else
-        {
-            dmGraphics::SetConstantV4(context->m_GraphicsContext, values, constant->m_NumValues, *location);
-        }
+        bool is_matrix = constant->m_Type == dmRenderDDF::MaterialDesc::CONSTANT_TYPE_USER_MATRIX4;
+        SetMaterialConstantValues(context->m_RenderContext, context->m_Material, *location, is_matrix, values, constant->m_NumValues);
     }
 }
 
 void ApplyNamedConstantBuffer(dmRender::HRenderContext render_context, HMaterial material, HNamedConstantBuffer buffer)
 {
-    dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
-    ApplyConstantContext context(graphics_context, material, buffer);
+    ApplyConstantContext context(render_context, material, buffer);
     buffer->m_Constants.Iterate(ApplyConstant, &context);
 }
 
@@ -493,6 +493,7 @@ namespace dmRender
     , m_Align(TEXT_ALIGN_LEFT)
     , m_VAlign(TEXT_VALIGN_TOP)
     , m_StencilTestParamsSet(0)
+    , m_ScissorSet(0)
     {
         m_StencilTestParams.Init();
     }
@@ -553,6 +554,9 @@ namespace dmRender
             if (params.m_StencilTestParamsSet) {
                 dmHashUpdateBuffer64(&key_state, &params.m_StencilTestParams, sizeof(params.m_StencilTestParams));
             }
+            if (params.m_ScissorSet) {
+                dmHashUpdateBuffer64(&key_state, &params.m_ScissorRect, sizeof(params.m_ScissorRect));
+            }
             if (material) {
                 dmHashUpdateBuffer64(&key_state, &material, sizeof(material));
             }
@@ -592,6 +596,8 @@ namespace dmRender
         te.m_VAlign = params.m_VAlign;
         te.m_StencilTestParams = params.m_StencilTestParams;
         te.m_StencilTestParamsSet = params.m_StencilTestParamsSet;
+        te.m_ScissorRect = params.m_ScissorRect;
+        te.m_ScissorSet = params.m_ScissorSet;
         te.m_SourceBlendFactor = params.m_SourceBlendFactor;
         te.m_DestinationBlendFactor = params.m_DestinationBlendFactor;
 
@@ -1073,6 +1079,8 @@ namespace dmRender
         ro->m_VertexStart = text_context.m_VertexIndex;
         ro->m_StencilTestParams = first_te.m_StencilTestParams;
         ro->m_SetStencilTest = first_te.m_StencilTestParamsSet;
+        ro->m_ScissorRect = first_te.m_ScissorRect;
+        ro->m_SetScissor = first_te.m_ScissorSet;
 
         Vector4 texture_size_recip(im_recip, ih_recip, cache_cell_width_ratio, cache_cell_height_ratio);
 
@@ -221,8 +221,12 @@ namespace dmRender
         TextVAlign m_VAlign;
         /// Stencil parameters
         StencilTestParams m_StencilTestParams;
+        /// Scissor rectangle in world space (min x, min y, max x, max y)
+        dmVMath::Vector4 m_ScissorRect;
         /// Stencil parameters set or not
         uint8_t m_StencilTestParamsSet : 1;
+        /// Scissor rectangle set or not
+        uint8_t m_ScissorSet : 1;
     };
 
     /**
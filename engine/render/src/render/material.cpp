@@ -179,6 +179,7 @@ namespace dmRender
         {
             material->m_NameHashToLocation.SetCapacity((constants_count + samplers_count), (constants_count + samplers_count) * 2);
             material->m_Constants.SetCapacity(constants_count);
+            material->m_ConstantShadows.SetCapacity(constants_count);
         }
 
         if (samplers_count > 0)
@@ -275,6 +276,17 @@ namespace dmRender
                     constant.m_ElementIds[3] = 0;
                 }
                 material->m_Constants.Push(constant);
+
+                MaterialConstantShadow shadow;
+                shadow.m_Location      = location;
+                shadow.m_Generation    = 0;
+                shadow.m_ValueIndex    = material->m_ConstantShadowValues.Size();
+                shadow.m_ValueCapacity = num_values;
+                shadow.m_ValueCount    = 0;
+                material->m_ConstantShadows.Push(shadow);
+
+                material->m_ConstantShadowValues.OffsetCapacity(num_values);
+                material->m_ConstantShadowValues.SetSize(material->m_ConstantShadowValues.Size() + num_values);
             }
             else if (type == dmGraphics::TYPE_SAMPLER_2D || type == dmGraphics::TYPE_SAMPLER_CUBE || type == dmGraphics::TYPE_SAMPLER_2D_ARRAY)
             {
@@ -338,10 +350,92 @@ namespace dmRender
         delete material;
     }
 
+    // Returns false if the values are the same as the ones last uploaded for the constant
+    static inline bool UpdateConstantShadow(HRenderContext render_context, HMaterial material, MaterialConstantShadow& shadow, const Vector4* values, uint32_t num_values)
+    {
+        if (num_values > shadow.m_ValueCapacity)
+        {
+            // The constant has grown since the material was created, don't track it
+            shadow.m_Generation = 0;
+            return true;
+        }
+
+        Vector4* shadow_values = &material->m_ConstantShadowValues[shadow.m_ValueIndex];
+        if (shadow.m_Generation == render_context->m_ConstantShadowGeneration &&
+            shadow.m_ValueCount == num_values &&
+            memcmp(shadow_values, values, sizeof(Vector4) * num_values) == 0)
+        {
+            return false;
+        }
+
+        memcpy(shadow_values, values, sizeof(Vector4) * num_values);
+        shadow.m_Generation = render_context->m_ConstantShadowGeneration;
+        shadow.m_ValueCount = num_values;
+        return true;
+    }
+
+    static inline void UploadConstantValues(HRenderContext render_context, HMaterial material, uint32_t shadow_index, int32_t location, bool is_matrix, const Vector4* values, uint32_t num_values)
+    {
+        if (!UpdateConstantShadow(render_context, material, material->m_ConstantShadows[shadow_index], values, num_values))
+        {
+            return;
+        }
+
+        if (is_matrix)
+        {
+            dmGraphics::SetConstantM4(render_context->m_GraphicsContext, values, num_values / 4, location);
+        }
+        else
+        {
+            dmGraphics::SetConstantV4(render_context->m_GraphicsContext, values, num_values, location);
+        }
+    }
+
+    void SetMaterialConstantValues(HRenderContext render_context, HMaterial material, int32_t location, bool is_matrix, const Vector4* values, uint32_t num_values)
+    {
+        const dmArray<MaterialConstantShadow>& shadows = material->m_ConstantShadows;
+        uint32_t n = shadows.Size();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (shadows[i].m_Location == location)
+            {
+                UploadConstantValues(render_context, material, i, location, is_matrix, values, num_values);
+                return;
+            }
+        }
+
+        if (is_matrix)
+        {
+            dmGraphics::SetConstantM4(render_context->m_GraphicsContext, values, num_values / 4, location);
+        }
+        else
+        {
+            dmGraphics::SetConstantV4(render_context->m_GraphicsContext, values, num_values, location);
+        }
+    }
+
+    void UpdateShaderTransforms(HRenderContext render_context)
+    {
+        // Vulkan NDC is [0..1] for z, so we must transform
+        // the projection before setting the constants.
+        if (dmGraphics::GetShaderProgramLanguage(render_context->m_GraphicsContext) == dmGraphics::ShaderDesc::LANGUAGE_SPIRV)
+        {
+            Matrix4 ndc_matrix = Matrix4::identity();
+            ndc_matrix.setElem(2, 2, 0.5f );
+            ndc_matrix.setElem(3, 2, 0.5f );
+            render_context->m_ShaderProjection = ndc_matrix * render_context->m_Projection;
+            render_context->m_ShaderViewProj   = ndc_matrix * render_context->m_ViewProj;
+        }
+        else
+        {
+            render_context->m_ShaderProjection = render_context->m_Projection;
+            render_context->m_ShaderViewProj   = render_context->m_ViewProj;
+        }
+    }
+
     void ApplyMaterialConstants(dmRender::HRenderContext render_context, HMaterial material, const RenderObject* ro)
     {
         const dmArray<MaterialConstant>& constants = material->m_Constants;
-        dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
         uint32_t n = constants.Size();
         for (uint32_t i = 0; i < n; ++i)
         {
@@ -356,63 +450,39 @@ namespace dmRender
                 {
                     uint32_t num_values;
                     dmVMath::Vector4* values = GetConstantValues(constant, &num_values);
-                    dmGraphics::SetConstantV4(graphics_context, values, num_values, location);
+                    UploadConstantValues(render_context, material, i, location, false, values, num_values);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_USER_MATRIX4:
                 {
                     uint32_t num_values;
                     dmVMath::Vector4* values = GetConstantValues(constant, &num_values);
-                    dmGraphics::SetConstantM4(graphics_context, values, num_values / 4, location);
+                    UploadConstantValues(render_context, material, i, location, true, values, num_values);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_VIEWPROJ:
                 {
-                    if (dmGraphics::GetShaderProgramLanguage(graphics_context) == dmGraphics::ShaderDesc::LANGUAGE_SPIRV)
-                    {
-                        Matrix4 ndc_matrix = Matrix4::identity();
-                        ndc_matrix.setElem(2, 2, 0.5f );
-                        ndc_matrix.setElem(3, 2, 0.5f );
-                        const Matrix4 view_projection = ndc_matrix * render_context->m_ViewProj;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&view_projection, 1, location);
-                    }
-                    else
-                    {
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_ViewProj, 1, location);
-                    }
+                    UploadConstantValues(render_context, material, i, location, true, (Vector4*)&render_context->m_ShaderViewProj, 4);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_WORLD:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&ro->m_WorldTransform, 1, location);
+                    UploadConstantValues(render_context, material, i, location, true, (Vector4*)&ro->m_WorldTransform, 4);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_TEXTURE:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&ro->m_TextureTransform, 1, location);
+                    UploadConstantValues(render_context, material, i, location, true, (Vector4*)&ro->m_TextureTransform, 4);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_VIEW:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_View, 1, location);
+                    UploadConstantValues(render_context, material, i, location, true, (Vector4*)&render_context->m_View, 4);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_PROJECTION:
                 {
-                    // Vulkan NDC is [0..1] for z, so we must transform
-                    // the projection before setting the constant.
-                    if (dmGraphics::GetShaderProgramLanguage(graphics_context) == dmGraphics::ShaderDesc::LANGUAGE_SPIRV)
-                    {
-                        Matrix4 ndc_matrix = Matrix4::identity();
-                        ndc_matrix.setElem(2, 2, 0.5f );
-                        ndc_matrix.setElem(3, 2, 0.5f );
-                        const Matrix4 proj = ndc_matrix * render_context->m_Projection;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&proj, 1, location);
-                    }
-                    else
-                    {
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_Projection, 1, location);
-                    }
+                    UploadConstantValues(render_context, material, i, location, true, (Vector4*)&render_context->m_ShaderProjection, 4);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_NORMAL:
@@ -424,7 +494,7 @@ namespace dmRender
                         // It is always affine however
                         normalT = affineInverse(normalT);
                         normalT = transpose(normalT);
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&normalT, 1, location);
+                        UploadConstantValues(render_context, material, i, location, true, (Vector4*)&normalT, 4);
                     }
                     break;
                 }
@@ -432,24 +502,15 @@ namespace dmRender
                 {
                     {
                         Matrix4 world_view = render_context->m_View * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view, 1, location);
+                        UploadConstantValues(render_context, material, i, location, true, (Vector4*)&world_view, 4);
                     }
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_WORLDVIEWPROJ:
                 {
-                    if (dmGraphics::GetShaderProgramLanguage(graphics_context) == dmGraphics::ShaderDesc::LANGUAGE_SPIRV)
                     {
-                        Matrix4 ndc_matrix = Matrix4::identity();
-                        ndc_matrix.setElem(2, 2, 0.5f );
-                        ndc_matrix.setElem(3, 2, 0.5f );
-                        const Matrix4 world_view_projection = ndc_matrix * render_context->m_ViewProj * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view_projection, 1, location);
-                    }
-                    else
-                    {
-                        const Matrix4 world_view_projection = render_context->m_ViewProj * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view_projection, 1, location);
+                        const Matrix4 world_view_projection = render_context->m_ShaderViewProj * ro->m_WorldTransform;
+                        UploadConstantValues(render_context, material, i, location, true, (Vector4*)&world_view_projection, 4);
                     }
                     break;
                 }
@@ -774,6 +835,22 @@ namespace dmRender
         return material->m_VertexDeclaration;
     }
 
+    void PrewarmMaterial(HMaterial material, dmGraphics::HVertexDeclaration vertex_declaration, dmGraphics::HRenderTarget render_target, const dmGraphics::PipelineState& pipeline_state)
+    {
+        if (vertex_declaration == 0)
+        {
+            vertex_declaration = material->m_VertexDeclaration;
+        }
+
+        if (vertex_declaration == 0)
+        {
+            return;
+        }
+
+        dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(material->m_RenderContext);
+        dmGraphics::PrewarmPipeline(graphics_context, material->m_Program, vertex_declaration, render_target, pipeline_state);
+    }
+
     HRenderContext GetMaterialRenderContext(HMaterial material)
     {
         return material->m_RenderContext;
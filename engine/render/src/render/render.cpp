@@ -17,6 +17,7 @@
 #include <float.h>
 #include <algorithm>
 
+#include <dlib/frame_arena.h>
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
 #include <dlib/profile.h>
@@ -86,6 +87,7 @@ namespace dmRender
     , m_MaxCharacters(0)
     , m_CommandBufferSize(1024)
     , m_MaxDebugVertexCount(0)
+    , m_PrewarmMaterials(0)
     {
 
     }
@@ -113,6 +115,10 @@ namespace dmRender
         context->m_View = Matrix4::identity();
         context->m_Projection = Matrix4::identity();
         context->m_ViewProj = context->m_Projection * context->m_View;
+        context->m_ShaderProjection = context->m_Projection;
+        context->m_ShaderViewProj = context->m_ViewProj;
+
+        context->m_ConstantShadowGeneration = 1;
 
         context->m_ScriptContext = params.m_ScriptContext;
         InitializeRenderScriptContext(context->m_RenderScriptContext, graphics_context, params.m_ScriptContext, params.m_CommandBufferSize);
@@ -131,6 +137,13 @@ namespace dmRender
         context->m_OutOfResources = 0;
 
         context->m_StencilBufferCleared = 0;
+        context->m_ScissorTestEnabled = 0;
+        context->m_PrewarmMaterials = params.m_PrewarmMaterials;
+
+        context->m_ViewportX = 0;
+        context->m_ViewportY = 0;
+        context->m_ViewportWidth = 0;
+        context->m_ViewportHeight = 0;
 
         context->m_RenderListDispatch.SetCapacity(255);
 
@@ -164,6 +177,10 @@ namespace dmRender
         render_context->m_RenderListDispatch.SetSize(0);
         render_context->m_RenderListRanges.SetSize(0);
         render_context->m_FrustumHash = 0xFFFFFFFF; // trigger a first recalculation each frame
+
+        // Upload all material constants at least once per frame, e.g in case a program was reloaded
+        if (++render_context->m_ConstantShadowGeneration == 0)
+            render_context->m_ConstantShadowGeneration = 1;
     }
 
     HRenderListDispatch RenderListMakeDispatch(HRenderContext render_context, RenderListDispatchFn dispatch_fn, RenderListVisibilityFn visibility_fn, void* user_data)
@@ -273,6 +290,11 @@ namespace dmRender
         return render_context->m_GraphicsContext;
     }
 
+    bool GetPrewarmMaterials(HRenderContext render_context)
+    {
+        return render_context->m_PrewarmMaterials;
+    }
+
     const Matrix4& GetViewProjectionMatrix(HRenderContext render_context)
     {
         return render_context->m_ViewProj;
@@ -383,6 +405,55 @@ namespace dmRender
         #undef HAS_CHANGED
     }
 
+    // The scissor rectangle of a render object is in the same space as its vertices, so it is transformed the same way
+    // and then mapped to the pixels of the viewport. Pixels are inside if their center is, same as for rasterization.
+    static void ApplyScissor(HRenderContext render_context, dmGraphics::HContext graphics_context, const RenderObject* ro)
+    {
+        float viewport_x = (float) render_context->m_ViewportX;
+        float viewport_y = (float) render_context->m_ViewportY;
+        float viewport_width = (float) render_context->m_ViewportWidth;
+        float viewport_height = (float) render_context->m_ViewportHeight;
+        if (render_context->m_ViewportWidth == 0 || render_context->m_ViewportHeight == 0)
+        {
+            viewport_width = (float) dmGraphics::GetWidth(graphics_context);
+            viewport_height = (float) dmGraphics::GetHeight(graphics_context);
+        }
+
+        const Matrix4 transform = render_context->m_ViewProj * ro->m_WorldTransform;
+        const Vector4& rect = ro->m_ScissorRect;
+        Vector4 p0 = transform * Point3(rect.getX(), rect.getY(), 0.0f);
+        Vector4 p1 = transform * Point3(rect.getZ(), rect.getW(), 0.0f);
+        float x0 = viewport_x + (p0.getX() / p0.getW() * 0.5f + 0.5f) * viewport_width;
+        float y0 = viewport_y + (p0.getY() / p0.getW() * 0.5f + 0.5f) * viewport_height;
+        float x1 = viewport_x + (p1.getX() / p1.getW() * 0.5f + 0.5f) * viewport_width;
+        float y1 = viewport_y + (p1.getY() / p1.getW() * 0.5f + 0.5f) * viewport_height;
+
+        int32_t left   = (int32_t) floorf(dmMath::Min(x0, x1) + 0.5f);
+        int32_t bottom = (int32_t) floorf(dmMath::Min(y0, y1) + 0.5f);
+        int32_t right  = (int32_t) floorf(dmMath::Max(x0, x1) + 0.5f);
+        int32_t top    = (int32_t) floorf(dmMath::Max(y0, y1) + 0.5f);
+        left   = dmMath::Max(left, 0);
+        bottom = dmMath::Max(bottom, 0);
+        right  = dmMath::Max(right, left);
+        top    = dmMath::Max(top, bottom);
+
+        dmGraphics::SetScissor(graphics_context, left, bottom, right - left, top - bottom);
+        if (!render_context->m_ScissorTestEnabled)
+        {
+            dmGraphics::EnableState(graphics_context, dmGraphics::STATE_SCISSOR_TEST);
+            render_context->m_ScissorTestEnabled = 1;
+        }
+    }
+
+    static void ResetScissor(HRenderContext render_context, dmGraphics::HContext graphics_context)
+    {
+        if (render_context->m_ScissorTestEnabled)
+        {
+            dmGraphics::DisableState(graphics_context, dmGraphics::STATE_SCISSOR_TEST);
+            render_context->m_ScissorTestEnabled = 0;
+        }
+    }
+
     static void ApplyRenderState(HRenderContext render_context, dmGraphics::HContext graphics_context, dmGraphics::PipelineState ps_default, const RenderObject* ro)
     {
         dmGraphics::PipelineState ps_now = ps_default;
@@ -443,6 +514,15 @@ namespace dmRender
             }
         }
 
+        if (ro->m_SetScissor)
+        {
+            ApplyScissor(render_context, graphics_context, ro);
+        }
+        else
+        {
+            ResetScissor(render_context, graphics_context);
+        }
+
         ResetRenderStateIfChanged(graphics_context, ps_now, ps_default);
     }
 
@@ -461,18 +541,10 @@ namespace dmRender
     }
 
     // Compute new sort values for everything that matches tag_mask
-    static void MakeSortBuffer(HRenderContext context, uint32_t tag_count, dmhash_t* tags)
+    static void MakeSortBuffer(HRenderContext context, uint32_t tag_count, dmhash_t* tags, RenderListSortValue* sort_values, dmArray<uint32_t>& sort_buffer)
     {
         DM_PROFILE("MakeSortBuffer");
 
-        const uint32_t required_capacity = context->m_RenderListSortIndices.Capacity();
-        // SetCapacity does early out if they are the same, so just call anyway.
-        context->m_RenderListSortBuffer.SetCapacity(required_capacity);
-        context->m_RenderListSortBuffer.SetSize(0);
-        context->m_RenderListSortValues.SetCapacity(required_capacity);
-        context->m_RenderListSortValues.SetSize(context->m_RenderListSortIndices.Size());
-
-        RenderListSortValue* sort_values = context->m_RenderListSortValues.Begin();
         RenderListEntry* entries = context->m_RenderList.Begin();
 
         const Matrix4& transform = context->m_ViewProj;
@@ -561,7 +633,7 @@ namespace dmRender
                 sort_values[idx].m_MinorOrder = entry->m_MinorOrder;
                 sort_values[idx].m_BatchKey = entry->m_BatchKey & 0x00ffffff;
                 sort_values[idx].m_Dispatch = entry->m_Dispatch;
-                context->m_RenderListSortBuffer.Push(idx);
+                sort_buffer.Push(idx);
             }
         }
     }
@@ -701,16 +773,21 @@ namespace dmRender
             }
         }
 
-        MakeSortBuffer(context, predicate?predicate->m_TagCount:0, predicate?predicate->m_Tags:0);
+        // The sort data is only needed during this call, so it comes from the frame arena
+        const uint32_t entry_count = context->m_RenderListSortIndices.Size();
+        RenderListSortValue* sort_values = dmFrameArena::Alloc<RenderListSortValue>(entry_count);
+        dmArray<uint32_t> sort_buffer(dmFrameArena::Alloc<uint32_t>(entry_count), 0, entry_count);
+
+        MakeSortBuffer(context, predicate?predicate->m_TagCount:0, predicate?predicate->m_Tags:0, sort_values, sort_buffer);
 
-        if (context->m_RenderListSortBuffer.Empty())
+        if (sort_buffer.Empty())
             return RESULT_OK;
 
         {
             DM_PROFILE("DrawRenderList_SORT");
             RenderListSorter sort;
-            sort.values = context->m_RenderListSortValues.Begin();
-            std::stable_sort(context->m_RenderListSortBuffer.Begin(), context->m_RenderListSortBuffer.End(), sort);
+            sort.values = sort_values;
+            std::stable_sort(sort_buffer.Begin(), sort_buffer.End(), sort);
         }
 
         // Construct render objects
@@ -739,15 +816,15 @@ namespace dmRender
 
         // Make batches for matching dispatch, batch key & minor order
         RenderListEntry *base = context->m_RenderList.Begin();
-        uint32_t *last = context->m_RenderListSortBuffer.Begin();
-        uint32_t count = context->m_RenderListSortBuffer.Size();
+        uint32_t *last = sort_buffer.Begin();
+        uint32_t count = sort_buffer.Size();
 
         {
             DM_PROFILE("Dispatch_Batch");
 
             for (uint32_t i=1;i<=count;i++)
             {
-                uint32_t *idx = context->m_RenderListSortBuffer.Begin() + i;
+                uint32_t *idx = sort_buffer.Begin() + i;
                 const RenderListEntry *last_entry = &base[*last];
                 const RenderListEntry *current_entry = &base[*idx];
 
@@ -808,6 +885,8 @@ namespace dmRender
 
         dmGraphics::PipelineState ps_orig = dmGraphics::GetPipelineState(context);
 
+        UpdateShaderTransforms(render_context);
+
         for (uint32_t i = 0; i < render_context->m_RenderObjects.Size(); ++i)
         {
             RenderObject* ro = render_context->m_RenderObjects[i];
@@ -892,6 +971,7 @@ namespace dmRender
             }
         }
 
+        ResetScissor(render_context, context);
         ResetRenderStateIfChanged(context, ps_orig, dmGraphics::GetPipelineState(context));
 
         return RESULT_OK;
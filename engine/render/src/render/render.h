@@ -108,6 +108,8 @@ namespace dmRender
         /// Max debug vertex count
         /// NOTE: This is per debug-type and not the total sum
         uint32_t                        m_MaxDebugVertexCount;
+        /// Create the pipelines of materials with their default state when they are loaded, see PrewarmMaterial()
+        uint32_t                        m_PrewarmMaterials : 1;
     };
 
     static const uint8_t RENDERLIST_INVALID_DISPATCH = 0xff;
@@ -125,6 +127,7 @@ namespace dmRender
     void SetSystemFontMap(HRenderContext render_context, HFontMap font_map);
 
     dmGraphics::HContext GetGraphicsContext(HRenderContext render_context);
+    bool GetPrewarmMaterials(HRenderContext render_context);
 
     const dmVMath::Matrix4& GetViewProjectionMatrix(HRenderContext render_context);
     void SetViewMatrix(HRenderContext render_context, const dmVMath::Matrix4& view);
@@ -211,6 +214,14 @@ namespace dmRender
     bool                            GetMaterialProgramConstant(HMaterial, dmhash_t name_hash, HConstant& out_value);
 
     dmGraphics::HVertexDeclaration  GetVertexDeclaration(HMaterial material);
+
+    /** Create the graphics pipeline a material will be drawn with ahead of time, e.g while loading a level.
+     * @param material Material to prewarm
+     * @param vertex_declaration Vertex format the material will be drawn with, or 0 to use the vertex format of the material
+     * @param render_target Render target the material will be drawn to, or 0 for the main framebuffer
+     * @param pipeline_state Render state the material will be drawn with
+     */
+    void                            PrewarmMaterial(HMaterial material, dmGraphics::HVertexDeclaration vertex_declaration, dmGraphics::HRenderTarget render_target, const dmGraphics::PipelineState& pipeline_state);
     void                            GetMaterialProgramAttributes(HMaterial material, const dmGraphics::VertexAttribute** attributes, uint32_t* attribute_count);
     void                            GetMaterialProgramAttributeValues(HMaterial material, uint32_t index, const uint8_t** value_ptr, uint32_t* num_values);
     void                            SetMaterialProgramAttributes(HMaterial material, const dmGraphics::VertexAttribute* attributes, uint32_t attributes_count);
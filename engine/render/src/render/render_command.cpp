@@ -105,6 +105,10 @@ namespace dmRender
                 case COMMAND_TYPE_SET_VIEWPORT:
                 {
                     dmGraphics::SetViewport(context, c->m_Operands[0], c->m_Operands[1], c->m_Operands[2], c->m_Operands[3]);
+                    render_context->m_ViewportX      = (int32_t) c->m_Operands[0];
+                    render_context->m_ViewportY      = (int32_t) c->m_Operands[1];
+                    render_context->m_ViewportWidth  = (uint32_t) c->m_Operands[2];
+                    render_context->m_ViewportHeight = (uint32_t) c->m_Operands[3];
                     break;
                 }
                 case COMMAND_TYPE_SET_VIEW:
@@ -70,6 +70,16 @@ namespace dmRender
         uint16_t m_ValueCount;
     };
 
+    // The values last uploaded to a program constant, so that uploading the same values again can be skipped
+    struct MaterialConstantShadow
+    {
+        int32_t  m_Location;
+        uint32_t m_Generation;      // Only valid if equal to the render context generation
+        uint32_t m_ValueIndex;      // Index into Material::m_ConstantShadowValues
+        uint16_t m_ValueCapacity;
+        uint16_t m_ValueCount;
+    };
+
     struct Material
     {
         Material()
@@ -93,6 +103,8 @@ namespace dmRender
         dmArray<MaterialAttribute>              m_MaterialAttributes;
         dmArray<uint8_t>                        m_MaterialAttributeValues;
         dmArray<MaterialConstant>               m_Constants;
+        dmArray<MaterialConstantShadow>         m_ConstantShadows; // One per constant in m_Constants
+        dmArray<dmVMath::Vector4>               m_ConstantShadowValues;
         dmArray<Sampler>                        m_Samplers;
         uint32_t                                m_TagListKey;      // the key to use with GetMaterialTagList()
         uint64_t                                m_UserData1;
@@ -134,6 +146,7 @@ namespace dmRender
     {
         StencilTestParams   m_StencilTestParams;
         Matrix4             m_Transform;
+        Vector4             m_ScissorRect;
         HConstant           m_RenderConstants[MAX_TEXT_RENDER_CONSTANTS];
         HFontMap            m_FontMap;
         HMaterial           m_Material;
@@ -158,6 +171,7 @@ namespace dmRender
         uint32_t            m_Align : 2;
         uint32_t            m_VAlign : 2;
         uint32_t            m_StencilTestParamsSet : 1;
+        uint32_t            m_ScissorSet : 1;
     };
 
     struct TextContext
@@ -239,8 +253,6 @@ namespace dmRender
 
         dmArray<RenderListEntry>    m_RenderList;
         dmArray<RenderListDispatch> m_RenderListDispatch;
-        dmArray<RenderListSortValue>m_RenderListSortValues;
-        dmArray<uint32_t>           m_RenderListSortBuffer;
         dmArray<uint32_t>           m_RenderListSortIndices;
         dmArray<RenderListRange>    m_RenderListRanges;         // Maps tagmask to a range in the (sorted) render list
         dmhash_t                    m_FrustumHash;
@@ -252,6 +264,9 @@ namespace dmRender
         Matrix4                     m_View;
         Matrix4                     m_Projection;
         Matrix4                     m_ViewProj;
+        // The projection and view projection in the clip space of the shader language, updated once per draw
+        Matrix4                     m_ShaderProjection;
+        Matrix4                     m_ShaderViewProj;
 
         dmGraphics::HContext        m_GraphicsContext;
 
@@ -259,8 +274,18 @@ namespace dmRender
 
         dmMessage::HSocket          m_Socket;
 
+        uint32_t                    m_ConstantShadowGeneration; // Bumped every frame to invalidate all constant shadows
+
+        // The viewport set with render.set_viewport, used to map scissor rectangles to pixels. The size is zero until set.
+        int32_t                     m_ViewportX;
+        int32_t                     m_ViewportY;
+        uint32_t                    m_ViewportWidth;
+        uint32_t                    m_ViewportHeight;
+
         uint32_t                    m_OutOfResources : 1;
         uint32_t                    m_StencilBufferCleared : 1;
+        uint32_t                    m_ScissorTestEnabled : 1;
+        uint32_t                    m_PrewarmMaterials : 1;
     };
 
     void RenderTypeTextBegin(HRenderContext rendercontext, void* user_context);
@@ -281,6 +306,11 @@ namespace dmRender
     bool GetCanBindTexture(dmGraphics::HTexture texture, HSampler sampler, uint32_t unit);
     uint32_t ApplyTextureAndSampler(dmRender::HRenderContext render_context, dmGraphics::HTexture texture, HSampler sampler, uint8_t unit);
 
+    // Calculates the per draw constants shared by all render objects (e.g the view projection)
+    void UpdateShaderTransforms(HRenderContext render_context);
+    // Uploads the constant values to the current program, unless they are the same as the last values uploaded to that location
+    void SetMaterialConstantValues(HRenderContext render_context, HMaterial material, int32_t location, bool is_matrix, const dmVMath::Vector4* values, uint32_t num_values);
+
     // Exposed here for unit testing
     struct RenderListEntrySorter
     {
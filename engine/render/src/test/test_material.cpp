@@ -29,6 +29,7 @@ using namespace dmVMath;
 namespace dmGraphics
 {
     extern const Vector4& GetConstantV4Ptr(dmGraphics::HContext context, int base_register);
+    extern uint32_t GetConstantUploadCount(dmGraphics::HContext context);
 }
 
 class dmRenderMaterialTest : public jc_test_base_class
@@ -267,6 +268,68 @@ TEST_F(dmRenderMaterialTest, TestMaterialConstantsOverride)
     dmRender::DeleteMaterial(m_RenderContext, material);
 }
 
+TEST_F(dmRenderMaterialTest, TestMaterialConstantsShadowing)
+{
+    const char* vs_src = "uniform vec4 tint;\nuniform mat4 world;\n";
+    dmGraphics::ShaderDesc::Shader vp_shader = MakeDDFShader(vs_src, strlen(vs_src));
+    dmGraphics::HVertexProgram vp = dmGraphics::NewVertexProgram(m_GraphicsContext, &vp_shader);
+    dmGraphics::ShaderDesc::Shader fp_shader = MakeDDFShader("foo", 3);
+    dmGraphics::HFragmentProgram fp = dmGraphics::NewFragmentProgram(m_GraphicsContext, &fp_shader);
+    dmRender::HMaterial material = dmRender::NewMaterial(m_RenderContext, vp, fp);
+    dmRender::SetMaterialProgramConstantType(material, dmHashString64("world"), dmRenderDDF::MaterialDesc::CONSTANT_TYPE_WORLD);
+
+    dmRender::HNamedConstantBuffer constants = dmRender::NewNamedConstantBuffer();
+    Vector4 test_v(1.0f, 0.0f, 0.0f, 0.0f);
+    dmRender::SetNamedConstant(constants, dmHashString64("tint"), &test_v, 1);
+
+    dmRender::RenderObject ro;
+    ro.m_Material = material;
+    ro.m_WorldTransform = Matrix4::identity();
+
+    dmGraphics::EnableProgram(m_GraphicsContext, dmRender::GetMaterialProgram(material));
+    dmRender::UpdateShaderTransforms(m_RenderContext);
+
+    // First time, both constants are uploaded
+    uint32_t count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyMaterialConstants(m_RenderContext, material, &ro);
+    ASSERT_EQ(count + 2, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+
+    // Nothing has changed
+    count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyMaterialConstants(m_RenderContext, material, &ro);
+    ASSERT_EQ(count, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+
+    // Only the world transform has changed
+    ro.m_WorldTransform = Matrix4::translation(Vector3(1.0f, 2.0f, 3.0f));
+    count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyMaterialConstants(m_RenderContext, material, &ro);
+    ASSERT_EQ(count + 1, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+
+    // The constant buffer overrides the tint, and the next object must get the material tint again
+    count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyNamedConstantBuffer(m_RenderContext, material, constants);
+    dmRender::ApplyNamedConstantBuffer(m_RenderContext, material, constants);
+    ASSERT_EQ(count + 1, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+    ASSERT_EQ(1.0f, dmGraphics::GetConstantV4Ptr(m_GraphicsContext, 0).getX());
+
+    count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyMaterialConstants(m_RenderContext, material, &ro);
+    ASSERT_EQ(count + 1, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+    ASSERT_EQ(0.0f, dmGraphics::GetConstantV4Ptr(m_GraphicsContext, 0).getX());
+
+    // A new frame uploads everything again
+    dmRender::RenderListBegin(m_RenderContext);
+    count = dmGraphics::GetConstantUploadCount(m_GraphicsContext);
+    dmRender::ApplyMaterialConstants(m_RenderContext, material, &ro);
+    ASSERT_EQ(count + 2, dmGraphics::GetConstantUploadCount(m_GraphicsContext));
+
+    dmRender::DeleteNamedConstantBuffer(constants);
+    dmGraphics::DisableProgram(m_GraphicsContext);
+    dmGraphics::DeleteVertexProgram(vp);
+    dmGraphics::DeleteFragmentProgram(fp);
+    dmRender::DeleteMaterial(m_RenderContext, material);
+}
+
 TEST_F(dmRenderMaterialTest, MatchMaterialTags)
 {
     dmhash_t material_tags[] = { 1, 2, 3, 4, 5 };
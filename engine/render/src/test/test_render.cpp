@@ -333,6 +333,10 @@ static void TestDrawStateDispatch(dmRender::RenderListDispatchParams const & par
         ro_0->m_StencilTestParams.m_ColorBufferMask = dmGraphics::DM_GRAPHICS_STATE_WRITE_R | dmGraphics::DM_GRAPHICS_STATE_WRITE_A;
         ro_0->m_StencilTestParams.m_BufferMask      = 1;
 
+        // Clip with a scissor rectangle, expected: disabled after render
+        ro_0->m_SetScissor  = true;
+        ro_0->m_ScissorRect = Vector4(-0.5f, -0.5f, 0.5f, 0.5f);
+
         dmRender::RenderObject* ro_1 = &user_ctx->m_RenderObjects[1];
         ro_1->Init();
         ro_1->m_Material          = user_ctx->m_Material;
@@ -425,6 +429,7 @@ TEST_F(dmRenderTest, TestRenderListDrawState)
     dmGraphics::PipelineState ps_after = dmGraphics::GetPipelineState(m_GraphicsContext);
 
     ASSERT_EQ(0, memcmp(&ps_before, &ps_after, sizeof(dmGraphics::PipelineState)));
+    ASSERT_FALSE(m_Context->m_ScissorTestEnabled);
 
     dmGraphics::DeleteVertexProgram(vp);
     dmGraphics::DeleteFragmentProgram(fp);
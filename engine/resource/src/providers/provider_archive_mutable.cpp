@@ -20,6 +20,7 @@
 #include "../resource_manifest.h"
 #include "../resource_manifest_private.h"
 #include "../resource_archive.h"
+#include "../resource_archive_private.h"
 #include "../resource_util.h"
 #include "../resource_private.h"
 
@@ -30,6 +31,7 @@
 #include <dlib/lz4.h>
 #include <dlib/math.h>
 #include <dlib/memory.h>
+#include <dlib/mutex.h>
 #include <dlib/sys.h>
 #include <dlib/uri.h>
 #include <ddf/ddf.h>
@@ -51,12 +53,23 @@ namespace dmResourceProviderArchiveMutable
         dmResourceArchive::HArchiveIndexContainer   m_ArchiveContainer;
         dmHashTable64<EntryInfo>                    m_EntryMap; // url hash -> entry in the manifest
         dmURI::Parts                                m_Uri;
+        dmResourceArchive::HArchiveTransaction      m_Transaction;      // The resources written since the last commit
+        dmResourceArchive::HArchiveIndex            m_CommittedIndex;   // The index created by the last commit
+        dmMutex::HMutex                             m_Mutex;
 
         GameArchiveFile()
         : m_Manifest(0)
         , m_BaseManifest(0)
         , m_ArchiveContainer(0)
+        , m_Transaction(0)
+        , m_CommittedIndex(0)
         {
+            m_Mutex = dmMutex::New();
+        }
+
+        ~GameArchiveFile()
+        {
+            dmMutex::Delete(m_Mutex);
         }
     };
 
@@ -87,12 +100,18 @@ namespace dmResourceProviderArchiveMutable
 
     static void DeleteArchive(GameArchiveFile* archive)
     {
+        if (archive->m_Transaction)
+            dmResourceArchive::DeleteTransaction(archive->m_Transaction);
+
         if (archive->m_Manifest)
             dmResource::DeleteManifest(archive->m_Manifest);
 
         if (archive->m_ArchiveContainer)
             dmResource::UnmountArchiveInternal(archive->m_ArchiveContainer, archive->m_ArchiveContainer->m_UserData);
 
+        if (archive->m_CommittedIndex)
+            dmResourceArchive::Delete(archive->m_CommittedIndex);
+
         delete archive;
     }
 
@@ -151,6 +170,12 @@ namespace dmResourceProviderArchiveMutable
 
     }
 
+    static void GetArchiveJournalPath(const dmURI::Parts* uri, char* buffer, uint32_t buffer_len)
+    {
+        dmResourceProviderArchivePrivate::GetArchiveIndexPath(uri, buffer, buffer_len);
+        dmStrlCat(buffer, ".journal", buffer_len);
+    }
+
     static bool ArchiveFilesExist(const dmURI::Parts* uri)
     {
         char path[DMPATH_MAX_PATH];
@@ -269,6 +294,30 @@ namespace dmResourceProviderArchiveMutable
         return dmResourceProvider::RESULT_OK;
     }
 
+    // Adds the resources from a transaction that wasn't committed before the application was terminated
+    static dmResourceProvider::Result ReplayJournal(const dmURI::Parts* uri)
+    {
+        char journal_path[DMPATH_MAX_PATH];
+        GetArchiveJournalPath(uri, journal_path, sizeof(journal_path));
+        if (!dmSys::Exists(journal_path))
+        {
+            return dmResourceProvider::RESULT_OK;
+        }
+
+        char archive_index_path[DMPATH_MAX_PATH];
+        char archive_data_path[DMPATH_MAX_PATH];
+        dmResourceProviderArchivePrivate::GetArchiveIndexPath(uri, archive_index_path, sizeof(archive_index_path));
+        dmResourceProviderArchivePrivate::GetArchiveDataPath(uri, archive_data_path, sizeof(archive_data_path));
+
+        dmResourceArchive::Result result = dmResourceArchive::ReplayJournal(archive_index_path, archive_data_path, journal_path);
+        if (result != dmResourceArchive::RESULT_OK)
+        {
+            dmLogError("Failed to replay liveupdate journal '%s' (%i).", journal_path, result);
+            return dmResourceProvider::RESULT_IO_ERROR;
+        }
+        return dmResourceProvider::RESULT_OK;
+    }
+
     static dmResourceProvider::Result LoadArchive(const dmURI::Parts* uri, dmResource::HManifest base_manifest, dmResourceProvider::HArchiveInternal* out_archive)
     {
         dmResourceProvider::Result result;
@@ -280,6 +329,12 @@ namespace dmResourceProviderArchiveMutable
             return result;
         }
 
+        result = ReplayJournal(uri);
+        if (result != dmResourceProvider::RESULT_OK)
+        {
+            return result;
+        }
+
         GameArchiveFile* archive = new GameArchiveFile;
         *out_archive = (dmResourceProvider::HArchive)archive;
         archive->m_Manifest = 0;
@@ -364,9 +419,60 @@ namespace dmResourceProviderArchiveMutable
         return LoadArchive(&uri, manifest, out_archive);
     }
 
-    static dmResourceProvider::Result Unmount(dmResourceProvider::HArchiveInternal archive)
+    static void UpdateEntryInfo(GameArchiveFile* archive, const dmhash_t* url_hash, EntryInfo* info)
     {
-        delete (GameArchiveFile*)archive;
+        dmLiveUpdateDDF::ResourceEntry* entry = info->m_ManifestEntry;
+        dmResourceArchive::Result result = dmResourceArchive::FindEntry(archive->m_ArchiveContainer,
+                                                                        entry->m_Hash.m_Data.m_Data, entry->m_Hash.m_Data.m_Count, &info->m_ArchiveInfo);
+        if (result != dmResourceArchive::RESULT_OK)
+        {
+            info->m_ArchiveInfo = 0;
+        }
+    }
+
+    // Adds all resources written since the last commit to the archive index in one go.
+    // This is done lazily, the next time the archive is read from.
+    static dmResourceProvider::Result CommitResources(GameArchiveFile* archive)
+    {
+        if (!archive->m_Transaction || dmResourceArchive::GetTransactionResourceCount(archive->m_Transaction) == 0)
+            return dmResourceProvider::RESULT_OK;
+
+        char index_tmp_path[DMPATH_MAX_PATH];
+        dmResourceProviderArchivePrivate::GetArchiveIndexPath(&archive->m_Uri, index_tmp_path, sizeof(index_tmp_path));
+        dmStrlCat(index_tmp_path, ".tmp", sizeof(index_tmp_path));
+
+        // Stores the index to index_tmp_path, which replaces the index file at the next mount
+        dmResourceArchive::HArchiveIndex new_archive_index;
+        dmResourceArchive::Result result = dmResourceArchive::CommitTransaction(archive->m_Transaction, index_tmp_path, new_archive_index);
+        if (result != dmResourceArchive::RESULT_OK)
+        {
+            // The transaction is kept, so that it's either committed later or replayed at the next mount
+            dmLogError("Failed to commit liveupdate resources, result = %i", result);
+            return dmResourceProvider::RESULT_IO_ERROR;
+        }
+
+        dmResourceArchive::DeleteTransaction(archive->m_Transaction);
+        archive->m_Transaction = 0;
+
+        dmResourceArchive::SetNewArchiveIndex(archive->m_Manifest->m_ArchiveIndex, new_archive_index, true);
+        archive->m_ArchiveContainer = archive->m_Manifest->m_ArchiveIndex;
+        archive->m_EntryMap.Iterate(UpdateEntryInfo, archive);
+
+        // No entry refers to the previous index anymore
+        if (archive->m_CommittedIndex)
+            dmResourceArchive::Delete(archive->m_CommittedIndex);
+        archive->m_CommittedIndex = new_archive_index;
+
+        return dmResourceProvider::RESULT_OK;
+    }
+
+    static dmResourceProvider::Result Unmount(dmResourceProvider::HArchiveInternal _archive)
+    {
+        GameArchiveFile* archive = (GameArchiveFile*)_archive;
+        CommitResources(archive);
+        if (archive->m_Transaction)
+            dmResourceArchive::DeleteTransaction(archive->m_Transaction);
+        delete archive;
         return dmResourceProvider::RESULT_OK;
     }
 
@@ -404,6 +510,8 @@ namespace dmResourceProviderArchiveMutable
     static dmResourceProvider::Result GetFileSize(dmResourceProvider::HArchiveInternal internal, dmhash_t path_hash, const char* path, uint32_t* file_size)
     {
         GameArchiveFile* archive = (GameArchiveFile*)internal;
+        DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
+        CommitResources(archive);
         if (!archive->m_ArchiveContainer)
             return dmResourceProvider::RESULT_NOT_FOUND;
 
@@ -420,6 +528,8 @@ namespace dmResourceProviderArchiveMutable
     static dmResourceProvider::Result ReadFile(dmResourceProvider::HArchiveInternal internal, dmhash_t path_hash, const char* path, uint8_t* buffer, uint32_t buffer_len)
     {
         GameArchiveFile* archive = (GameArchiveFile*)internal;
+        DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
+        CommitResources(archive);
         if (!archive->m_ArchiveContainer)
             return dmResourceProvider::RESULT_NOT_FOUND;
         if (archive->m_EntryMap.Empty())
@@ -450,24 +560,10 @@ namespace dmResourceProviderArchiveMutable
         return comp ? dmResourceProvider::RESULT_OK : dmResourceProvider::RESULT_SIGNATURE_MISMATCH;
     }
 
-    static dmResourceProvider::Result NewArchiveIndexWithResource(GameArchiveFile* archive,
-                                                                    const uint8_t* digest, const uint32_t digest_length, const dmResourceArchive::LiveUpdateResource* resource,
-                                                                    dmResourceArchive::HArchiveIndex& out_new_index)
-    {
-        char index_tmp_path[DMPATH_MAX_PATH];
-        dmResourceProviderArchivePrivate::GetArchiveIndexPath(&archive->m_Uri, index_tmp_path, sizeof(index_tmp_path));
-        dmStrlCat(index_tmp_path, ".tmp", sizeof(index_tmp_path));
-
-        // Calls ShiftAndInsert, which in turn calls WriteResourceToArchive which writes to the file handle currently stored in m_FileResourceData
-        // Calls WriteArchiveIndex (i.e. stores the index to index_tmp_path)
-        dmResourceArchive::Result res = dmResourceArchive::NewArchiveIndexWithResource(archive->m_Manifest->m_ArchiveIndex, index_tmp_path, digest, digest_length, resource, out_new_index);
-
-        return (res == dmResourceArchive::RESULT_OK) ? dmResourceProvider::RESULT_OK : dmResourceProvider::RESULT_IO_ERROR;
-    }
-
     static dmResourceProvider::Result WriteFile(dmResourceProvider::HArchiveInternal internal, dmhash_t path_hash, const char* path, const uint8_t* buffer, uint32_t buffer_length)
     {
         GameArchiveFile* archive = (GameArchiveFile*)internal;
+        DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
 
         // If we don't have a manifest at this point, we might need to create one
         dmLiveUpdateDDF::HashAlgorithm algorithm = archive->m_Manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
@@ -507,30 +603,31 @@ namespace dmResourceProviderArchiveMutable
             return result;
         }
 
-        dmResourceArchive::HArchiveIndex new_archive_index;
-
         CreateFilesIfNotExists(&archive->m_Uri);
         CreateDynamicManifestArchiveIndex(archive->m_Manifest, archive->m_BaseManifest);
         OpenDynamicArchiveFile(&archive->m_Uri, archive->m_Manifest);
 
-        result = NewArchiveIndexWithResource(archive, digest, algorithm_length*2, &resource, new_archive_index);
-        if (dmResourceProvider::RESULT_OK == result)
+        if (!archive->m_Transaction)
         {
-            dmResourceArchive::SetNewArchiveIndex(archive->m_Manifest->m_ArchiveIndex, new_archive_index, true);
-            archive->m_ArchiveContainer = archive->m_Manifest->m_ArchiveIndex;
+            char journal_path[DMPATH_MAX_PATH];
+            GetArchiveJournalPath(&archive->m_Uri, journal_path, sizeof(journal_path));
+            dmResourceArchive::Result ar_result = dmResourceArchive::NewTransaction(archive->m_Manifest->m_ArchiveIndex, journal_path, &archive->m_Transaction);
+            if (dmResourceArchive::RESULT_OK != ar_result)
+            {
+                return dmResourceProvider::RESULT_IO_ERROR;
+            }
         }
 
-        if (!entry->m_ArchiveInfo)
+        // Appends the data to the file handle currently stored in m_FileResourceData, and records it in the journal.
+        // The resource is added to the index by CommitResources()
+        dmResourceArchive::Result ar_result = dmResourceArchive::StoreResource(archive->m_Transaction, digest, algorithm_length, &resource);
+        if (dmResourceArchive::RESULT_OK != ar_result)
         {
-            dmResourceArchive::Result result = dmResourceArchive::FindEntry(archive->m_ArchiveContainer,
-                                                                            entry->m_ManifestEntry->m_Hash.m_Data.m_Data, entry->m_ManifestEntry->m_Hash.m_Data.m_Count, &entry->m_ArchiveInfo);
-            if (result != dmResourceArchive::RESULT_OK)
-            {
-                dmLogError("Failed to find data entry for %s in archive", entry->m_ManifestEntry->m_Url);
-            }
+            dmLogError("Failed to store resource %s, result = %i", (const char*)hex_expected_digest, ar_result);
+            return dmResourceProvider::RESULT_IO_ERROR;
         }
 
-        return result;
+        return dmResourceProvider::RESULT_OK;
     }
 
     static dmResourceProvider::Result GetManifest(dmResourceProvider::HArchiveInternal _archive, dmResource::HManifest* out_manifest)
@@ -547,6 +644,8 @@ namespace dmResourceProviderArchiveMutable
     static dmResourceProvider::Result SetManifest(dmResourceProvider::HArchiveInternal _archive, dmResource::HManifest manifest)
     {
         GameArchiveFile* archive = (GameArchiveFile*)_archive;
+        DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
+        CommitResources(archive);
         if (archive->m_Manifest)
             dmResource::DeleteManifest(archive->m_Manifest);
 
@@ -78,10 +78,11 @@ namespace dmResourceProviderArchivePrivate
             dmResourceArchive::EntryData* e = &entries[i];
 
             uint32_t flags = dmEndian::ToNetwork(e->m_Flags);
-            printf("entry e/c/l: %d%d%d sz: %u csz: %u off: %u hash: ",
+            printf("entry e/c/l/a: %d%d%d%d sz: %u csz: %u off: %u hash: ",
                 (flags & dmResourceArchive::ENTRY_FLAG_ENCRYPTED) != 0,
                 (flags & dmResourceArchive::ENTRY_FLAG_COMPRESSED) != 0,
                 (flags & dmResourceArchive::ENTRY_FLAG_LIVEUPDATE_DATA) != 0,
+                (flags & dmResourceArchive::ENTRY_FLAG_ENCRYPTED_AES) != 0,
                 dmEndian::ToNetwork(e->m_ResourceSize), dmEndian::ToNetwork(e->m_ResourceCompressedSize), dmEndian::ToNetwork(e->m_ResourceDataOffset));
 
             PrintHash(h, 20);
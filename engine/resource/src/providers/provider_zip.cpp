@@ -255,12 +255,13 @@ static dmResourceProvider::Result UnpackData(const char* path, dmLiveUpdateDDF::
     uint32_t flags = entry->m_Flags;
     bool encrypted = flags & dmLiveUpdateDDF::ENCRYPTED;
     bool compressed = flags & dmLiveUpdateDDF::COMPRESSED;
+    dmCrypt::Algorithm algorithm = (flags & dmLiveUpdateDDF::ENCRYPTED_AES) ? dmCrypt::ALGORITHM_AES_CTR : dmCrypt::ALGORITHM_XTEA;
     uint32_t compressed_size = compressed ? entry->m_CompressedSize : entry->m_Size;
     uint32_t resource_size = entry->m_Size;
 
     if (encrypted)
     {
-        dmResource::Result r = dmResource::DecryptBuffer((void*)resource.m_Data, resource.m_Count);
+        dmResource::Result r = dmResource::DecryptBuffer(algorithm, (void*)resource.m_Data, resource.m_Count);
         if (dmResource::RESULT_OK != r)
         {
             dmLogError("Failed to decrypt resource: '%s", path);
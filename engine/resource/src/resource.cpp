@@ -95,6 +95,8 @@ struct SResourceFactory
     // TODO: Arg... budget. Two hash-maps. Really necessary?
     dmHashTable64<SResourceDescriptor>*          m_Resources;
     dmHashTable<uintptr_t, uint64_t>*            m_ResourceToHash;
+    // The size of each resource that is reported to the memory tag of its type
+    dmHashTable64<uint32_t>*                     m_AccountedSizes;
     // Only valid if RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT is set
     // Used for reloading of resources
     dmHashTable64<const char*>*                  m_ResourceHashToFilename;
@@ -327,6 +329,9 @@ HFactory NewFactory(NewFactoryParams* params, const char* uri)
     factory->m_ResourceToHash = new dmHashTable<uintptr_t, uint64_t>();
     factory->m_ResourceToHash->SetCapacity(table_size, params->m_MaxResources);
 
+    factory->m_AccountedSizes = new dmHashTable64<uint32_t>();
+    factory->m_AccountedSizes->SetCapacity(table_size, params->m_MaxResources);
+
     if (params->m_Flags & RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT)
     {
         factory->m_ResourceHashToFilename = new dmHashTable64<const char*>();
@@ -381,6 +386,7 @@ void DeleteFactory(HFactory factory)
     free((void*)factory->m_PublicKeyPath);
     delete factory->m_Resources;
     delete factory->m_ResourceToHash;
+    delete factory->m_AccountedSizes;
     if (factory->m_ResourceHashToFilename)
         delete factory->m_ResourceHashToFilename;
     if (factory->m_ResourceReloadedCallbacks)
@@ -459,6 +465,10 @@ Result RegisterType(HFactory factory,
     resource_type.m_DestroyFunction = destroy_function;
     resource_type.m_RecreateFunction = recreate_function;
 
+    char tag_name[dmMemory::MAX_TAG_NAME];
+    dmSnPrintf(tag_name, sizeof(tag_name), "resource.%s", extension);
+    resource_type.m_MemoryTag = dmMemory::RegisterTag(tag_name);
+
     factory->m_ResourceTypes[factory->m_ResourceTypesCount++] = resource_type;
 
     return RESULT_OK;
@@ -846,6 +856,11 @@ Result InsertResource(HFactory factory, const char* path, uint64_t canonical_pat
     assert(descriptor->m_Resource);
     assert(descriptor->m_ReferenceCount == 1);
 
+    SResourceType* resource_type = (SResourceType*) descriptor->m_ResourceType;
+    uint32_t accounted_size = descriptor->m_ResourceSize ? descriptor->m_ResourceSize : descriptor->m_ResourceSizeOnDisc;
+    dmMemory::TrackAlloc(resource_type->m_MemoryTag, accounted_size);
+    factory->m_AccountedSizes->Put(canonical_path_hash, accounted_size);
+
     factory->m_Resources->Put(canonical_path_hash, *descriptor);
     factory->m_ResourceToHash->Put((uintptr_t) descriptor->m_Resource, canonical_path_hash);
     if (factory->m_ResourceHashToFilename)
@@ -858,6 +873,16 @@ Result InsertResource(HFactory factory, const char* path, uint64_t canonical_pat
     return RESULT_OK;
 }
 
+void UpdateMemoryAccounting(HFactory factory, uint64_t canonical_path_hash, SResourceDescriptor* descriptor)
+{
+    uint32_t* accounted_size = factory->m_AccountedSizes->Get(canonical_path_hash);
+    assert(accounted_size);
+    SResourceType* resource_type = (SResourceType*) descriptor->m_ResourceType;
+    uint32_t size = descriptor->m_ResourceSize ? descriptor->m_ResourceSize : descriptor->m_ResourceSizeOnDisc;
+    dmMemory::TrackRealloc(resource_type->m_MemoryTag, *accounted_size, size);
+    *accounted_size = size;
+}
+
 Result GetRaw(HFactory factory, const char* name, void** resource, uint32_t* resource_size)
 {
     DM_PROFILE(__FUNCTION__);
@@ -933,6 +958,7 @@ static Result DoReloadResource(HFactory factory, const char* name, SResourceDesc
     if (create_result == RESULT_OK)
     {
         params.m_Resource->m_ResourceSizeOnDisc = buffer_size;
+        UpdateMemoryAccounting(factory, canonical_path_hash, rd);
         if (factory->m_ResourceReloadedCallbacks)
         {
             for (uint32_t i = 0; i < factory->m_ResourceReloadedCallbacks->Size(); ++i)
@@ -1028,6 +1054,7 @@ Result SetResource(HFactory factory, uint64_t hashed_name, void* data, uint32_t
     Result create_result = resource_type->m_RecreateFunction(params);
     if (create_result == RESULT_OK)
     {
+        UpdateMemoryAccounting(factory, hashed_name, rd);
         if (factory->m_ResourceReloadedCallbacks)
         {
             for (uint32_t i = 0; i < factory->m_ResourceReloadedCallbacks->Size(); ++i)
@@ -1080,6 +1107,7 @@ Result SetResource(HFactory factory, uint64_t hashed_name, void* message)
     Result create_result = resource_type->m_RecreateFunction(params);
     if (create_result == RESULT_OK)
     {
+        UpdateMemoryAccounting(factory, hashed_name, rd);
         if (factory->m_ResourceReloadedCallbacks)
         {
             for (uint32_t i = 0; i < factory->m_ResourceReloadedCallbacks->Size(); ++i)
@@ -1251,6 +1279,10 @@ void Release(HFactory factory, void* resource)
         params.m_Context = resource_type->m_Context;
         params.m_Resource = rd;
         resource_type->m_DestroyFunction(params);
+        uint32_t* accounted_size = factory->m_AccountedSizes->Get(*resource_hash);
+        assert(accounted_size);
+        dmMemory::TrackFree(resource_type->m_MemoryTag, *accounted_size);
+        factory->m_AccountedSizes->Erase(*resource_hash);
 
         factory->m_ResourceToHash->Erase((uintptr_t) resource);
         factory->m_Resources->Erase(*resource_hash);
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm> // std::sort
 
 #include "resource.h"
 #include "resource_archive.h"
@@ -25,8 +26,11 @@
 #include <dlib/crypt.h>
 #include <dlib/dstrings.h>
 #include <dlib/endian.h>
+#include <dlib/hash.h>
+#include <dlib/hashtable.h>
 #include <dlib/log.h>
 #include <dlib/lz4.h>
+#include <dlib/math.h>
 #include <dlib/memory.h>
 #include <dlib/path.h>
 #include <dlib/sys.h>
@@ -392,9 +396,8 @@ namespace dmResourceArchive
         }
     }
 
-    Result WriteResourceToArchive(HArchiveIndexContainer& archive, const uint8_t* buf, uint32_t buf_len, uint32_t& bytes_written, uint32_t& offset)
+    static Result AppendResourceData(ArchiveFileIndex* afi, const uint8_t* buf, uint32_t buf_len, uint32_t& bytes_written, uint32_t& offset)
     {
-        ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
         FILE* res_file = afi->m_FileResourceData;
         assert(afi->m_FileResourceData != 0);
 
@@ -408,31 +411,61 @@ namespace dmResourceArchive
         bytes_written = bytes;
         offset = offs;
 
-        fflush(res_file); // make sure all writes flushed before mem-mapping below
+        fflush(res_file); // make sure all writes flushed before mem-mapping
+        return RESULT_OK;
+    }
+
+    // Maps the resource file again, to include the data appended since it was last mapped
+    static Result RemapResourceData(ArchiveFileIndex* afi)
+    {
+        void* temp_map = (void*)afi->m_ResourceData;
+        dmResource::UnmapFile(temp_map, afi->m_ResourceSize);
+
+        temp_map = 0x0;
+        uint32_t map_size = 0;
+        dmResource::Result res = dmResource::MapFile(afi->m_Path, temp_map, map_size);
+        if (res != dmResource::RESULT_OK)
+        {
+            dmLogError("Failed to map liveupdate resource file, result = %i", res);
+            afi->m_ResourceData = 0x0;
+            afi->m_ResourceSize = 0;
+            return RESULT_IO_ERROR;
+        }
+        afi->m_ResourceData = (uint8_t*)temp_map;
+        afi->m_ResourceSize = map_size;
+        return RESULT_OK;
+    }
+
+    Result WriteResourceToArchive(HArchiveIndexContainer& archive, const uint8_t* buf, uint32_t buf_len, uint32_t& bytes_written, uint32_t& offset)
+    {
+        ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
+        Result result = AppendResourceData(afi, buf, buf_len, bytes_written, offset);
+        if (result != RESULT_OK)
+        {
+            return result;
+        }
 
         // We have written to the resource file, need to update mapping
         if (afi->m_IsMemMapped)
         {
-            void* temp_map = (void*)afi->m_ResourceData;
             assert(afi->m_ResourceSize == offset); // I want to use the m_ResourceSize
-            dmResource::UnmapFile(temp_map, offset);
-
-            temp_map = 0x0;
-            uint32_t map_size = 0;
-            dmResource::Result res = dmResource::MapFile(afi->m_Path, temp_map, map_size);
-            if (res != dmResource::RESULT_OK)
-            {
-                dmLogError("Failed to map liveupdate resource file, result = %i", res);
-                return RESULT_IO_ERROR;
-            }
-            afi->m_ResourceData = (uint8_t*)temp_map;
-            afi->m_ResourceSize = offset + bytes_written;
-            assert((offset + bytes_written) == map_size); // I want to use the map_size
+            result = RemapResourceData(afi);
+            assert(result != RESULT_OK || (offset + bytes_written) == afi->m_ResourceSize); // I want to use the map_size
+            return result;
         }
 
         return RESULT_OK;
     }
 
+    static void CreateEntryData(const dmResourceArchive::LiveUpdateResource* resource, uint32_t offset, EntryData* entry)
+    {
+        bool is_compressed = (resource->m_Header->m_Flags & ENTRY_FLAG_COMPRESSED);
+        entry->m_ResourceDataOffset = dmEndian::ToHost(offset);
+        entry->m_ResourceSize = is_compressed ? resource->m_Header->m_Size : dmEndian::ToHost((uint32_t)resource->m_Count);
+        entry->m_ResourceCompressedSize = is_compressed ? dmEndian::ToHost((uint32_t)resource->m_Count) : (dmEndian::ToHost(0xffffffff));
+        entry->m_Flags = dmEndian::ToHost((uint32_t)(resource->m_Header->m_Flags | ENTRY_FLAG_LIVEUPDATE_DATA));
+    }
+
     // only used for live update archives
     Result ShiftAndInsert(ArchiveIndexContainer* archive_container, ArchiveIndex* ai, const uint8_t* hash_digest, uint32_t hash_digest_len, int insertion_index,
                             const dmResourceArchive::LiveUpdateResource* resource, const EntryData* entry_data)
@@ -485,12 +518,7 @@ namespace dmResourceArchive
             }
 
             // Create entrydata instance and insert into index
-            bool is_compressed = (resource->m_Header->m_Flags & ENTRY_FLAG_COMPRESSED);
-            //EntryData entry;
-            entry.m_ResourceDataOffset = dmEndian::ToHost(offs);
-            entry.m_ResourceSize = is_compressed ? resource->m_Header->m_Size : dmEndian::ToHost((uint32_t)resource->m_Count);
-            entry.m_ResourceCompressedSize = is_compressed ? dmEndian::ToHost((uint32_t)resource->m_Count) : (dmEndian::ToHost(0xffffffff));
-            entry.m_Flags = dmEndian::ToHost((uint32_t)(resource->m_Header->m_Flags | ENTRY_FLAG_LIVEUPDATE_DATA));
+            CreateEntryData(resource, offs, &entry);
             /// --- WRITE RESOURCE END
         }
 
@@ -509,6 +537,7 @@ namespace dmResourceArchive
 
         bool encrypted = (flags & dmResourceArchive::ENTRY_FLAG_ENCRYPTED);
         bool compressed = (flags & dmResourceArchive::ENTRY_FLAG_COMPRESSED);
+        dmCrypt::Algorithm algorithm = (flags & dmResourceArchive::ENTRY_FLAG_ENCRYPTED_AES) ? dmCrypt::ALGORITHM_AES_CTR : dmCrypt::ALGORITHM_XTEA;
 
         const ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
         bool resource_memmapped = afi->m_IsMemMapped;
@@ -591,7 +620,7 @@ namespace dmResourceArchive
         // Encryption is done in-place
         if(encrypted)
         {
-            dmResource::Result r = dmResource::DecryptBuffer((uint8_t*)source_data, source_data_size);
+            dmResource::Result r = dmResource::DecryptBuffer(algorithm, (uint8_t*)source_data, source_data_size);
             if (dmResource::RESULT_OK != r)
             {
                 delete[] temp_data;
@@ -631,8 +660,14 @@ namespace dmResourceArchive
             dmLogError("Failed to write %u bytes to liveupdate index file: %s", (uint32_t)total_size, path);
             return RESULT_IO_ERROR;
         }
-        fflush(f);
+        // Make sure the index is on disc before it replaces the old one
+        dmSys::Result sys_result = dmSys::FlushFile(f);
         fclose(f);
+        if (sys_result != dmSys::RESULT_OK)
+        {
+            dmLogError("Failed to flush liveupdate index file: %s (%i)", path, sys_result);
+            return RESULT_IO_ERROR;
+        }
 
         return RESULT_OK;
     }
@@ -687,6 +722,434 @@ namespace dmResourceArchive
         archive_container->m_IsMemMapped = mem_mapped;
     }
 
+    // *********************************************************************************
+    // Transactions
+    //
+    // A LiveUpdate resource is first appended to the data file, and then recorded in the journal.
+    // On commit, the data file is synced once, and all recorded resources are merged into a new index which is written
+    // to disc before the journal is removed.
+    // If the application is terminated before that, the journal records are merged at the next mount. Since nothing is
+    // synced before the commit, each record holds a hash of its data, and records whose data didn't reach the disc are skipped.
+
+    const static uint32_t JOURNAL_MAGIC = 0x444D4A52; // 'DMJR'
+    const static uint32_t JOURNAL_VERSION = 2;
+
+    // part of the .journal file format
+    struct DM_ALIGNED(16) JournalHeader
+    {
+        uint32_t        m_Magic;
+        uint32_t        m_Version;
+        uint32_t        m_Checksum;     // Checksum of m_ArchiveIndex
+        uint32_t        :32;
+        ArchiveIndex    m_ArchiveIndex; // Used as the index header if the index file is missing
+    };
+
+    // part of the .journal file format
+    struct DM_ALIGNED(16) JournalRecord
+    {
+        uint8_t     m_Hash[MAX_HASH];
+        EntryData   m_Entry;
+        uint32_t    m_DataHash;         // Hash of the resource data
+        uint32_t    m_Checksum;         // Checksum of m_Hash, m_Entry and m_DataHash
+        uint32_t    :32;
+        uint32_t    :32;
+    };
+
+    struct ArchiveTransaction
+    {
+        HArchiveIndexContainer  m_Archive;
+        FILE*                   m_Journal;
+        dmArray<JournalRecord>  m_Records;
+        dmHashTable64<uint32_t> m_RecordIndices; // Hash of the resource hash to index in m_Records
+        char                    m_JournalPath[DMPATH_MAX_PATH];
+    };
+
+    struct JournalRecordSortPred
+    {
+        JournalRecordSortPred(uint32_t hash_length) : m_HashLength(hash_length) {}
+
+        bool operator() (const JournalRecord& a, const JournalRecord& b) const
+        {
+            return memcmp(a.m_Hash, b.m_Hash, m_HashLength) < 0;
+        }
+
+        uint32_t m_HashLength;
+    };
+
+    static bool IsStoredInTransaction(HArchiveTransaction transaction, const uint8_t* hash_digest, uint32_t hash_length)
+    {
+        uint32_t* index = transaction->m_RecordIndices.Get(dmHashBuffer64(hash_digest, hash_length));
+        return index != 0 && memcmp(transaction->m_Records[*index].m_Hash, hash_digest, hash_length) == 0;
+    }
+
+    static uint32_t GetRecordChecksum(const JournalRecord* record)
+    {
+        return dmHashBuffer32(record, sizeof(record->m_Hash) + sizeof(record->m_Entry) + sizeof(record->m_DataHash));
+    }
+
+    // The end offset of the entry data in the data file
+    static uint64_t GetEntryDataEnd(const EntryData* entry)
+    {
+        uint32_t flags = dmEndian::ToNetwork(entry->m_Flags);
+        uint32_t size = (flags & ENTRY_FLAG_COMPRESSED) ? dmEndian::ToNetwork(entry->m_ResourceCompressedSize) : dmEndian::ToNetwork(entry->m_ResourceSize);
+        return (uint64_t)dmEndian::ToNetwork(entry->m_ResourceDataOffset) + size;
+    }
+
+    static void GetHashesAndEntries(HArchiveIndexContainer archive, uint8_t** hashes, EntryData** entries)
+    {
+        if (!archive->m_IsMemMapped)
+        {
+            *hashes = archive->m_ArchiveFileIndex->m_Hashes;
+            *entries = archive->m_ArchiveFileIndex->m_Entries;
+        }
+        else
+        {
+            *hashes = (uint8_t*)((uintptr_t)archive->m_ArchiveIndex + dmEndian::ToNetwork(archive->m_ArchiveIndex->m_HashOffset));
+            *entries = (EntryData*)((uintptr_t)archive->m_ArchiveIndex + dmEndian::ToNetwork(archive->m_ArchiveIndex->m_EntryDataOffset));
+        }
+    }
+
+    // Merges the records with the sorted hashes and entries in a single pass. Records already in the index are skipped.
+    // The returned index has the same layout as an index file, and should be deleted with Delete(ArchiveIndex*)
+    static ArchiveIndex* NewMergedArchiveIndex(const ArchiveIndex* src, const uint8_t* hashes, const EntryData* entries, JournalRecord* records, uint32_t record_count)
+    {
+        uint32_t hash_length = dmEndian::ToNetwork(src->m_HashLength);
+        uint32_t entry_count = dmEndian::ToNetwork(src->m_EntryDataCount);
+        uint32_t max_count = entry_count + record_count;
+
+        std::sort(records, records + record_count, JournalRecordSortPred(hash_length));
+
+        uint8_t* data = new uint8_t[sizeof(ArchiveIndex) + max_count * (dmResourceArchive::MAX_HASH + sizeof(EntryData))];
+        ArchiveIndex* ai = (ArchiveIndex*)data;
+        memcpy(ai, src, sizeof(ArchiveIndex));
+        uint8_t* dst_hashes = data + sizeof(ArchiveIndex);
+        EntryData* dst_entries = (EntryData*)(dst_hashes + max_count * dmResourceArchive::MAX_HASH);
+
+        uint32_t count = 0;
+        uint32_t i = 0;
+        uint32_t j = 0;
+        while (i < entry_count || j < record_count)
+        {
+            const uint8_t* hash = hashes + dmResourceArchive::MAX_HASH * i;
+            int cmp = (i == entry_count) ? 1 : ((j == record_count) ? -1 : memcmp(hash, records[j].m_Hash, hash_length));
+            if (cmp <= 0)
+            {
+                memcpy(dst_hashes + dmResourceArchive::MAX_HASH * count, hash, dmResourceArchive::MAX_HASH);
+                dst_entries[count++] = entries[i++];
+                continue;
+            }
+
+            // Skip the record if the resource was already added, from the index or from an earlier record
+            const JournalRecord& record = records[j++];
+            if (count > 0 && memcmp(dst_hashes + dmResourceArchive::MAX_HASH * (count - 1), record.m_Hash, hash_length) == 0)
+                continue;
+
+            memcpy(dst_hashes + dmResourceArchive::MAX_HASH * count, record.m_Hash, dmResourceArchive::MAX_HASH);
+            dst_entries[count++] = record.m_Entry;
+        }
+
+        // The entries should directly follow the hashes
+        if (count < max_count)
+        {
+            memmove(dst_hashes + dmResourceArchive::MAX_HASH * count, dst_entries, count * sizeof(EntryData));
+        }
+
+        ai->m_Userdata = 0;
+        ai->m_EntryDataCount = dmEndian::ToHost(count);
+        ai->m_HashOffset = dmEndian::ToHost((uint32_t)sizeof(ArchiveIndex));
+        ai->m_EntryDataOffset = dmEndian::ToHost((uint32_t)(sizeof(ArchiveIndex) + dmResourceArchive::MAX_HASH * count));
+        return ai;
+    }
+
+    // Writes to a temporary file first, so that the file at path is always a complete index
+    static Result WriteArchiveIndexAtomic(const char* path, ArchiveIndex* ai)
+    {
+        char tmp_path[DMPATH_MAX_PATH];
+        dmSnPrintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+        Result result = WriteArchiveIndex(tmp_path, ai);
+        if (RESULT_OK != result)
+        {
+            return result;
+        }
+
+        dmSys::Result sys_result = dmSys::Rename(path, tmp_path);
+        if (sys_result != dmSys::RESULT_OK)
+        {
+            dmLogError("Failed to rename '%s' to '%s' (%i).", tmp_path, path, sys_result);
+            dmSys::Unlink(tmp_path);
+            return RESULT_IO_ERROR;
+        }
+        return RESULT_OK;
+    }
+
+    Result NewTransaction(HArchiveIndexContainer archive, const char* journal_path, HArchiveTransaction* out_transaction)
+    {
+        FILE* f = fopen(journal_path, "wb");
+        if (!f)
+        {
+            dmLogError("Failed to create liveupdate journal file: %s", journal_path);
+            return RESULT_IO_ERROR;
+        }
+
+        ArchiveIndex* src = archive->m_ArchiveIndex;
+
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        header.m_Magic = dmEndian::ToHost(JOURNAL_MAGIC);
+        header.m_Version = dmEndian::ToHost(JOURNAL_VERSION);
+        header.m_ArchiveIndex.m_Version = src->m_Version;
+        header.m_ArchiveIndex.m_HashLength = src->m_HashLength;
+        header.m_ArchiveIndex.m_HashOffset = dmEndian::ToHost((uint32_t)sizeof(ArchiveIndex));
+        header.m_ArchiveIndex.m_EntryDataOffset = dmEndian::ToHost((uint32_t)sizeof(ArchiveIndex));
+        memcpy(header.m_ArchiveIndex.m_ArchiveIndexMD5, src->m_ArchiveIndexMD5, sizeof(header.m_ArchiveIndex.m_ArchiveIndexMD5));
+        header.m_Checksum = dmEndian::ToHost(dmHashBuffer32(&header.m_ArchiveIndex, sizeof(ArchiveIndex)));
+
+        if (fwrite(&header, 1, sizeof(header), f) != sizeof(header))
+        {
+            dmLogError("Failed to write liveupdate journal file: %s", journal_path);
+            fclose(f);
+            dmSys::Unlink(journal_path);
+            return RESULT_IO_ERROR;
+        }
+        fflush(f);
+
+        ArchiveTransaction* transaction = new ArchiveTransaction;
+        transaction->m_Archive = archive;
+        transaction->m_Journal = f;
+        dmStrlCpy(transaction->m_JournalPath, journal_path, sizeof(transaction->m_JournalPath));
+        *out_transaction = transaction;
+        return RESULT_OK;
+    }
+
+    Result StoreResource(HArchiveTransaction transaction, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource)
+    {
+        assert(transaction->m_Journal != 0);
+        HArchiveIndexContainer archive = transaction->m_Archive;
+
+        if (hash_digest_len > dmResourceArchive::MAX_HASH)
+        {
+            return RESULT_INVALID_DATA;
+        }
+
+        uint32_t hash_length = dmEndian::ToNetwork(archive->m_ArchiveIndex->m_HashLength);
+        if (FindEntry(archive, hash_digest, hash_length, 0) == RESULT_OK || IsStoredInTransaction(transaction, hash_digest, hash_length))
+        {
+            return RESULT_ALREADY_STORED;
+        }
+
+        // The data is only mapped again when the transaction is committed
+        uint32_t bytes_written = 0;
+        uint32_t offs = 0;
+        Result result = AppendResourceData(archive->m_ArchiveFileIndex, resource->m_Data, resource->m_Count, bytes_written, offs);
+        if (result != RESULT_OK)
+        {
+            dmLogError("All bytes not written for resource, bytes written: %u, resource size: %u", bytes_written, resource->m_Count);
+            return result;
+        }
+
+        JournalRecord record;
+        memset(&record, 0, sizeof(record));
+        memcpy(record.m_Hash, hash_digest, hash_digest_len);
+        CreateEntryData(resource, offs, &record.m_Entry);
+        record.m_DataHash = dmEndian::ToHost(dmHashBuffer32(resource->m_Data, resource->m_Count));
+        record.m_Checksum = dmEndian::ToHost(GetRecordChecksum(&record));
+
+        // Flushed, but not synced, so that the record survives if the application is terminated
+        if (fwrite(&record, 1, sizeof(record), transaction->m_Journal) != sizeof(record) || fflush(transaction->m_Journal) != 0)
+        {
+            dmLogError("Failed to write liveupdate journal file: %s", transaction->m_JournalPath);
+            return RESULT_IO_ERROR;
+        }
+
+        if (transaction->m_Records.Full())
+        {
+            transaction->m_Records.OffsetCapacity(dmMath::Max(16U, transaction->m_Records.Capacity()));
+        }
+        if (transaction->m_RecordIndices.Full())
+        {
+            uint32_t capacity = transaction->m_RecordIndices.Capacity() + dmMath::Max(16U, transaction->m_RecordIndices.Capacity());
+            transaction->m_RecordIndices.SetCapacity((capacity*2)/3, capacity);
+        }
+        transaction->m_RecordIndices.Put(dmHashBuffer64(hash_digest, hash_length), transaction->m_Records.Size());
+        transaction->m_Records.Push(record);
+        return RESULT_OK;
+    }
+
+    uint32_t GetTransactionResourceCount(HArchiveTransaction transaction)
+    {
+        return transaction->m_Records.Size();
+    }
+
+    Result CommitTransaction(HArchiveTransaction transaction, const char* path, HArchiveIndex& out_new_index)
+    {
+        assert(transaction->m_Journal != 0);
+        HArchiveIndexContainer archive = transaction->m_Archive;
+        ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
+
+        if (!transaction->m_Records.Empty())
+        {
+            // The data must be on disc before the index that refers to it. This is the only sync of the data for the whole transaction
+            dmSys::Result sys_result = dmSys::FlushFile(afi->m_FileResourceData);
+            if (sys_result != dmSys::RESULT_OK)
+            {
+                dmLogError("Failed to flush liveupdate resource file (%i)", sys_result);
+                return RESULT_IO_ERROR;
+            }
+        }
+
+        // Map the data of all stored resources in one go
+        if (afi->m_IsMemMapped && !transaction->m_Records.Empty())
+        {
+            Result result = RemapResourceData(afi);
+            if (result != RESULT_OK)
+            {
+                return result;
+            }
+        }
+
+        uint8_t* hashes = 0;
+        EntryData* entries = 0;
+        GetHashesAndEntries(archive, &hashes, &entries);
+        ArchiveIndex* ai = NewMergedArchiveIndex(archive->m_ArchiveIndex, hashes, entries, transaction->m_Records.Begin(), transaction->m_Records.Size());
+
+        Result result = WriteArchiveIndexAtomic(path, ai);
+        if (RESULT_OK != result)
+        {
+            Delete(ai);
+            return result;
+        }
+
+        // The journal is only removed once the new index is on disc
+        fclose(transaction->m_Journal);
+        transaction->m_Journal = 0;
+        dmSys::Unlink(transaction->m_JournalPath);
+        transaction->m_Records.SetSize(0);
+        transaction->m_RecordIndices.Clear();
+
+        out_new_index = ai;
+        return RESULT_OK;
+    }
+
+    void DeleteTransaction(HArchiveTransaction transaction)
+    {
+        if (transaction->m_Journal)
+        {
+            fclose(transaction->m_Journal);
+        }
+        delete transaction;
+    }
+
+    Result ReplayJournal(const char* index_path, const char* data_path, const char* journal_path)
+    {
+        FILE* f = fopen(journal_path, "rb");
+        if (!f)
+        {
+            return RESULT_IO_ERROR;
+        }
+
+        JournalHeader header;
+        bool valid_header = fread(&header, 1, sizeof(header), f) == sizeof(header) &&
+                            dmEndian::ToNetwork(header.m_Magic) == JOURNAL_MAGIC &&
+                            dmEndian::ToNetwork(header.m_Version) == JOURNAL_VERSION &&
+                            dmEndian::ToNetwork(header.m_Checksum) == dmHashBuffer32(&header.m_ArchiveIndex, sizeof(ArchiveIndex));
+        if (!valid_header)
+        {
+            // No resources were recorded before the application was terminated
+            dmLogWarning("Discarding incomplete liveupdate journal '%s'", journal_path);
+            fclose(f);
+            dmSys::Unlink(journal_path);
+            return RESULT_OK;
+        }
+
+        dmSys::StatInfo stat;
+        uint64_t data_size = dmSys::Stat(data_path, &stat) == dmSys::RESULT_OK ? stat.m_Size : 0;
+        FILE* data_file = fopen(data_path, "rb");
+
+        dmArray<JournalRecord> records;
+        dmArray<uint8_t> data;
+        uint32_t skipped_count = 0;
+        JournalRecord record;
+        while (fread(&record, 1, sizeof(record), f) == sizeof(record))
+        {
+            // The first incomplete record marks the end of the transaction
+            if (dmEndian::ToNetwork(record.m_Checksum) != GetRecordChecksum(&record))
+            {
+                break;
+            }
+
+            // Neither the data nor the journal was synced, so the data of any record may be missing or incomplete
+            uint32_t offset = dmEndian::ToNetwork(record.m_Entry.m_ResourceDataOffset);
+            uint64_t end = GetEntryDataEnd(&record.m_Entry);
+            bool valid_data = false;
+            if (data_file && end <= data_size)
+            {
+                uint32_t size = (uint32_t)(end - offset);
+                if (data.Capacity() < size)
+                {
+                    data.SetCapacity(size);
+                }
+                data.SetSize(size);
+                valid_data = fseek(data_file, offset, SEEK_SET) == 0 &&
+                             fread(data.Begin(), 1, size, data_file) == size &&
+                             dmHashBuffer32(data.Begin(), size) == dmEndian::ToNetwork(record.m_DataHash);
+            }
+            if (!valid_data)
+            {
+                ++skipped_count;
+                continue;
+            }
+
+            if (records.Full())
+            {
+                records.OffsetCapacity(dmMath::Max(16U, records.Capacity()));
+            }
+            records.Push(record);
+        }
+        fclose(f);
+        if (data_file)
+        {
+            fclose(data_file);
+        }
+
+        if (skipped_count > 0)
+        {
+            dmLogWarning("Skipped %u resources with missing data in liveupdate journal '%s'", skipped_count, journal_path);
+        }
+
+        if (!records.Empty())
+        {
+            ArchiveIndex* ai = 0;
+            if (dmSys::Stat(index_path, &stat) == dmSys::RESULT_OK && stat.m_Size >= sizeof(ArchiveIndex))
+            {
+                HArchiveIndexContainer archive = 0;
+                Result result = LoadArchiveFromFile(index_path, data_path, &archive);
+                if (RESULT_OK != result)
+                {
+                    dmLogError("Failed to load liveupdate index '%s' to replay journal, result = %i", index_path, result);
+                    return result;
+                }
+                ai = NewMergedArchiveIndex(archive->m_ArchiveIndex, archive->m_ArchiveFileIndex->m_Hashes, archive->m_ArchiveFileIndex->m_Entries, records.Begin(), records.Size());
+                Delete(archive);
+            }
+            else
+            {
+                ai = NewMergedArchiveIndex(&header.m_ArchiveIndex, 0, 0, records.Begin(), records.Size());
+            }
+
+            Result result = WriteArchiveIndexAtomic(index_path, ai);
+            Delete(ai);
+            if (RESULT_OK != result)
+            {
+                return result;
+            }
+            dmLogInfo("Replayed %u resources from liveupdate journal '%s'", records.Size(), journal_path);
+        }
+
+        dmSys::Unlink(journal_path);
+        return RESULT_OK;
+    }
+
     uint32_t GetEntryCount(HArchiveIndexContainer archive)
     {
         return dmEndian::ToNetwork(archive->m_ArchiveIndex->m_EntryDataCount);
@@ -58,6 +58,7 @@ namespace dmResourceArchive
         ENTRY_FLAG_ENCRYPTED        = 1 << 0,
         ENTRY_FLAG_COMPRESSED       = 1 << 1,
         ENTRY_FLAG_LIVEUPDATE_DATA  = 1 << 2,
+        ENTRY_FLAG_ENCRYPTED_AES    = 1 << 3, // Set together with ENTRY_FLAG_ENCRYPTED, if the data was encrypted with AES-CTR
     };
 
     // part of the .arci file format
@@ -241,6 +242,64 @@ namespace dmResourceArchive
      */
     void SetNewArchiveIndex(HArchiveIndexContainer archive_container, HArchiveIndex new_index, bool mem_mapped);
 
+    typedef struct ArchiveTransaction* HArchiveTransaction;
+
+    /**
+     * Start a transaction for storing LiveUpdate resources in the archive.
+     * Stored resources are appended to the archive data file and recorded in an append-only journal,
+     * and are added to the archive index in a single pass when the transaction is committed.
+     * An existing journal file is replaced, use ReplayJournal() to recover it first.
+     * @param archive archive container
+     * @param journal_path the journal file
+     * @param out_transaction the new transaction (on success)
+     * @return RESULT_OK on success
+     */
+    Result NewTransaction(HArchiveIndexContainer archive, const char* journal_path, HArchiveTransaction* out_transaction);
+
+    /**
+     * Append a LiveUpdate resource to the archive data file and to the journal.
+     * The resource is not visible in the archive index until the transaction is committed.
+     * @param transaction transaction handle
+     * @param hash_digest hash_digest data
+     * @param hash_digest_len size in bytes of hash_digest data
+     * @param resource LiveUpdate resource to store
+     * @return RESULT_OK on success, RESULT_ALREADY_STORED if the resource is already in the archive index
+     */
+    Result StoreResource(HArchiveTransaction transaction, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource);
+
+    /**
+     * Get the number of resources stored in the transaction since it was started
+     * @param transaction transaction handle
+     * @return resource count
+     */
+    uint32_t GetTransactionResourceCount(HArchiveTransaction transaction);
+
+    /**
+     * Merge the stored resources into a copy of the archive index, write it to file and remove the journal.
+     * The resource data mapping is updated once for the whole transaction. The transaction can't be used afterwards.
+     * @param transaction transaction handle
+     * @param path file to save the new archive index to
+     * @param out_new_index reference to HArchiveIndex that will contain the new archive index (on success)
+     * @return RESULT_OK on success
+     */
+    Result CommitTransaction(HArchiveTransaction transaction, const char* path, HArchiveIndex& out_new_index);
+
+    /**
+     * Delete the transaction. If it wasn't committed, the journal is kept on disc for ReplayJournal()
+     * @param transaction transaction handle
+     */
+    void DeleteTransaction(HArchiveTransaction transaction);
+
+    /**
+     * Merge the resources recorded in a journal, left by a transaction that was never committed, into the archive index file.
+     * Records that are incomplete or refer to data missing from the data file are discarded. The journal is removed afterwards.
+     * @param index_path the archive index file. May be empty or missing.
+     * @param data_path the archive data file
+     * @param journal_path the journal file
+     * @return RESULT_OK on success
+     */
+    Result ReplayJournal(const char* index_path, const char* data_path, const char* journal_path);
+
     // For debugging purposes only
     void DebugArchiveIndex(HArchiveIndexContainer archive);
 
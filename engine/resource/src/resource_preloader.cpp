@@ -904,7 +904,10 @@ namespace dmResource
             if (rd)
             {
                 if (params.m_Resource->m_ResourceSize != 0)
+                {
                     rd->m_ResourceSize = params.m_Resource->m_ResourceSize;
+                    UpdateMemoryAccounting(preloader->m_Factory, params.m_Resource->m_NameHash, rd);
+                }
             }
         }
 
@@ -16,6 +16,7 @@
 #define DM_RESOURCE_PRIVATE_H
 
 #include <ddf/ddf.h>
+#include <dlib/memory.h>
 #include "resource_archive.h"
 #include "resource.h"
 
@@ -52,6 +53,7 @@ namespace dmResource
         FResourcePostCreate m_PostCreateFunction;
         FResourceDestroy    m_DestroyFunction;
         FResourceRecreate   m_RecreateFunction;
+        dmMemory::HTag      m_MemoryTag;
     };
 
     typedef dmArray<char> LoadBufferType;
@@ -60,6 +62,9 @@ namespace dmResource
 
     Result CheckSuppliedResourcePath(const char* name);
 
+    // Updates the memory tag of the resource type after the size of an inserted resource has changed
+    void UpdateMemoryAccounting(HFactory factory, uint64_t canonical_path_hash, SResourceDescriptor* descriptor);
+
     // load with default internal buffer and its management, returns buffer ptr in 'buffer'
     Result LoadResource(HFactory factory, const char* path, const char* original_name, void** buffer, uint32_t* resource_size);
     // load with own buffer
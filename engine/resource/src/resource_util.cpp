@@ -49,6 +49,19 @@ dmResource::Result DecryptBuffer(void* buffer, uint32_t buffer_len)
     return g_ResourceDecryption(buffer, buffer_len);
 }
 
+dmResource::Result DecryptBuffer(dmCrypt::Algorithm algorithm, void* buffer, uint32_t buffer_len)
+{
+    if (algorithm != dmCrypt::ALGORITHM_AES_CTR)
+        return g_ResourceDecryption(buffer, buffer_len);
+
+    dmCrypt::Result cr = dmCrypt::Decrypt(dmCrypt::ALGORITHM_AES_CTR, (uint8_t*) buffer, buffer_len, (const uint8_t*) KEY, strlen(KEY));
+    if (cr != dmCrypt::RESULT_OK)
+    {
+        return dmResource::RESULT_UNKNOWN_ERROR;
+    }
+    return dmResource::RESULT_OK;
+}
+
 Result DecryptSignatureHash(const dmResource::HManifest manifest, const uint8_t* pub_key_buf, uint32_t pub_key_len, uint8_t** out_digest, uint32_t* out_digest_len)
 {
     const uint8_t* signature = manifest->m_DDF->m_Signature.m_Data;
@@ -16,6 +16,7 @@
 #define DM_RESOURCE_UTIL_H
 
 #include "resource.h"
+#include <dlib/crypt.h>
 #include <resource/liveupdate_ddf.h>
 
 namespace dmResource
@@ -28,6 +29,10 @@ namespace dmResource
     // Decrypts a buffer, using the built in function, or the custom one set by RegisterResourceDecryption
     Result DecryptBuffer(void* buffer, uint32_t buffer_len);
 
+    // Decrypts a buffer encrypted with the given algorithm.
+    // The AES algorithm always uses the built in function, as custom encryption plugins only produce XTEA flagged resources
+    Result DecryptBuffer(dmCrypt::Algorithm algorithm, void* buffer, uint32_t buffer_len);
+
     /**
      * The manifest has a signature embedded. This signature is created when bundling by hashing the manifest content
      * and encrypting the hash with the private part of a public-private key pair. To verify a manifest this procedure
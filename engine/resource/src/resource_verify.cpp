@@ -10,6 +10,8 @@
 #include "resource_util.h"
 #include "resource_verify.h"
 
+#include <stdlib.h>
+#include <dlib/crypt.h>
 #include <dlib/endian.h>
 #include <dlib/log.h>
 #include <dlib/sys.h>
@@ -71,6 +73,64 @@ namespace dmResource
         return dmResource::MemCompare(hexDigest, hexDigestLength-1, expected, expected_length);
     }
 
+    Result VerifyResources(const dmResource::HManifest manifest, VerifyEntry* entries, uint32_t num_entries)
+    {
+        const uint32_t MAX_VERIFY_THREADS = 4;
+
+        if (manifest == 0x0)
+        {
+            return RESULT_INVALID_DATA;
+        }
+
+        dmCrypt::HashAlgorithm crypt_algorithm;
+        dmLiveUpdateDDF::HashAlgorithm algorithm = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
+        if (algorithm == dmLiveUpdateDDF::HASH_MD5)
+            crypt_algorithm = dmCrypt::HASH_ALGORITHM_MD5;
+        else if (algorithm == dmLiveUpdateDDF::HASH_SHA1)
+            crypt_algorithm = dmCrypt::HASH_ALGORITHM_SHA1;
+        else
+        {
+            dmLogError("The algorithm specified for manifest verification hashing is not supported (%i)", algorithm);
+            return RESULT_INVALID_DATA;
+        }
+
+        uint32_t digest_length = dmResource::HashLength(algorithm);
+        uint8_t* digests = (uint8_t*)malloc(num_entries * digest_length);
+        dmCrypt::HashBuffer* buffers = (dmCrypt::HashBuffer*)malloc(num_entries * sizeof(dmCrypt::HashBuffer));
+        for (uint32_t i = 0; i < num_entries; ++i)
+        {
+            buffers[i].m_Buffer = entries[i].m_Data;
+            buffers[i].m_BufferLength = entries[i].m_Data ? entries[i].m_DataLength : 0;
+            buffers[i].m_Digest = digests + i * digest_length;
+        }
+
+        dmCrypt::HashBuffers(crypt_algorithm, buffers, num_entries, MAX_VERIFY_THREADS);
+
+        Result result = RESULT_OK;
+        uint32_t hex_digest_length = digest_length * 2 + 1;
+        char* hex_digest = (char*)alloca(hex_digest_length);
+        for (uint32_t i = 0; i < num_entries; ++i)
+        {
+            VerifyEntry& entry = entries[i];
+            if (entry.m_Data == 0x0)
+            {
+                entry.m_Result = RESULT_INVALID_DATA;
+            }
+            else
+            {
+                dmResource::BytesToHexString(buffers[i].m_Digest, digest_length, hex_digest, hex_digest_length);
+                entry.m_Result = dmResource::MemCompare((const uint8_t*)hex_digest, hex_digest_length-1, entry.m_Expected, entry.m_ExpectedLength);
+            }
+
+            if (result == RESULT_OK)
+                result = entry.m_Result;
+        }
+
+        free(buffers);
+        free(digests);
+        return result;
+    }
+
     static bool VerifyManifestSupportedEngineVersion(const dmResource::HManifest manifest)
     {
         // Calculate running dmengine version SHA1 hash
@@ -31,6 +31,19 @@ namespace dmResource
 
     Result VerifyResource(const dmResource::HManifest manifest, const uint8_t* expected, uint32_t expected_length, const uint8_t* data, uint32_t data_length);
 
+    struct VerifyEntry
+    {
+        const uint8_t*  m_Expected;         // The expected hash, as a hex string
+        uint32_t        m_ExpectedLength;
+        const uint8_t*  m_Data;
+        uint32_t        m_DataLength;
+        Result          m_Result;           // [out] The verification result of this entry
+    };
+
+    // Same as VerifyResource(), but hashes the resources in parallel on worker threads
+    // Returns the first failing result, or RESULT_OK if all resources verified
+    Result VerifyResources(const dmResource::HManifest manifest, VerifyEntry* entries, uint32_t num_entries);
+
     Result VerifyResourcesBundled(dmResourceArchive::HArchiveIndexContainer base_archive, const Manifest* manifest);
 
     // Should be private, but is used in unit tests as well
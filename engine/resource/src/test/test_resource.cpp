@@ -18,6 +18,7 @@
 #include <dlib/dstrings.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/memory.h>
 #include <dlib/message.h>
 #include <dlib/socket.h>
 #include <dlib/sys.h>
@@ -1035,22 +1036,35 @@ TEST(RecreateTest, RecreateTest)
     fprintf(f, "123");
     fclose(f);
 
+    // Resources are accounted to the memory tag of their type, with the size on disc if they don't report a size
+    dmMemory::HTag memory_tag = dmMemory::FindTag("resource.foo");
+    ASSERT_NE(dmMemory::INVALID_TAG, memory_tag);
+    dmMemory::TagStats memory_stats;
+    dmMemory::GetTagStats(memory_tag, &memory_stats);
+    uint32_t live_bytes = memory_stats.m_LiveBytes;
+
     int* resource;
     dmResource::Result fr = dmResource::Get(factory, resource_name, (void**) &resource);
     ASSERT_EQ(dmResource::RESULT_OK, fr);
     ASSERT_EQ(123, *resource);
 
+    dmMemory::GetTagStats(memory_tag, &memory_stats);
+    ASSERT_EQ(live_bytes + 3, memory_stats.m_LiveBytes);
+
     f = fopen(path, "wb");
     ASSERT_NE((FILE*) 0, f);
-    fprintf(f, "456");
+    fprintf(f, "45678");
     fclose(f);
 
     dmResource::Result rr = dmResource::ReloadResource(factory, resource_name, 0);
     ASSERT_EQ(dmResource::RESULT_OK, rr);
-    ASSERT_EQ(456, *resource);
+    ASSERT_EQ(45678, *resource);
 
     ASSERT_EQ(123, reload_data.m_Old);
-    ASSERT_EQ(456, reload_data.m_New);
+    ASSERT_EQ(45678, reload_data.m_New);
+
+    dmMemory::GetTagStats(memory_tag, &memory_stats);
+    ASSERT_EQ(live_bytes + 5, memory_stats.m_LiveBytes);
 
     dmSys::Unlink(path);
     rr = dmResource::ReloadResource(factory, resource_name, 0);
@@ -1058,6 +1072,10 @@ TEST(RecreateTest, RecreateTest)
 
     dmResource::UnregisterResourceReloadedCallback(factory, ResourceReloadedCallback, &reload_data);
     dmResource::Release(factory, resource);
+
+    dmMemory::GetTagStats(memory_tag, &memory_stats);
+    ASSERT_EQ(live_bytes, memory_stats.m_LiveBytes);
+
     dmResource::DeleteFactory(factory);
 }
 
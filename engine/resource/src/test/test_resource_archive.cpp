@@ -22,8 +22,10 @@
 #include "../providers/provider_archive_private.h"
 #include <dlib/dstrings.h>
 #include <dlib/endian.h>
+#include <dlib/hash.h>
 #include <dlib/sys.h>
 #include <dlib/testutil.h>
+#include <dlib/time.h>
 #include <testmain/testmain.h>
 
 #include "../resource_archive.h"
@@ -795,6 +797,398 @@ TEST(dmResourceArchive, ResourceDecryption)
     ASSERT_ARRAY_EQ_LEN(expected_buffer_xtea, buffer, DM_ARRAY_SIZE(buffer));
 }
 
+// ****************************************************************************************************************
+
+static const uint32_t TRANSACTION_HASH_LENGTH = 20;
+
+static void MakeTransactionHash(uint32_t i, uint8_t* hash)
+{
+    // Spread the hashes, so that they aren't stored in order
+    uint64_t h = dmHashBuffer64(&i, sizeof(i));
+    memset(hash, 0, TRANSACTION_HASH_LENGTH);
+    memcpy(hash, &h, sizeof(h));
+    memcpy(hash + sizeof(h), &i, sizeof(i));
+}
+
+static void MakeTransactionResource(uint32_t i, uint8_t* buffer, uint32_t buffer_size, dmResourceArchive::LiveUpdateResource* resource)
+{
+    uint32_t header_size = sizeof(dmResourceArchive::LiveUpdateResourceHeader);
+    memset(buffer, 0, header_size);
+    uint32_t length = dmSnPrintf((char*)buffer + header_size, buffer_size - header_size, "transaction resource %u", i);
+    resource->Set(buffer, header_size + length);
+}
+
+static uint32_t GetFileSize(const char* path)
+{
+    dmSys::StatInfo stat;
+    return dmSys::Stat(path, &stat) == dmSys::RESULT_OK ? (uint32_t)stat.m_Size : 0;
+}
+
+// Simulates a write that was interrupted
+static void TruncateFile(const char* path, uint32_t size)
+{
+    uint8_t* buffer = new uint8_t[size];
+    FILE* f = fopen(path, "rb");
+    ASSERT_NE((FILE*)0, f);
+    ASSERT_EQ(size, (uint32_t)fread(buffer, 1, size, f));
+    fclose(f);
+    f = fopen(path, "wb");
+    ASSERT_NE((FILE*)0, f);
+    ASSERT_EQ(size, (uint32_t)fwrite(buffer, 1, size, f));
+    fclose(f);
+    delete[] buffer;
+}
+
+class ArchiveTransaction : public jc_test_base_class
+{
+protected:
+    virtual void SetUp()
+    {
+        dmTestUtil::MakeHostPath(m_IndexPath, sizeof(m_IndexPath), "test_transaction.arci");
+        dmTestUtil::MakeHostPath(m_DataPath, sizeof(m_DataPath), "test_transaction.arcd");
+        dmTestUtil::MakeHostPath(m_JournalPath, sizeof(m_JournalPath), "test_transaction.arci.journal");
+        RemoveFiles();
+
+        // Same as an empty liveupdate archive
+        m_Archive = new dmResourceArchive::ArchiveIndexContainer;
+        m_Archive->m_ArchiveIndex = new dmResourceArchive::ArchiveIndex;
+        m_Archive->m_ArchiveIndex->m_Version = dmEndian::ToHost(dmResourceArchive::VERSION);
+        m_Archive->m_ArchiveIndex->m_HashLength = dmEndian::ToHost(TRANSACTION_HASH_LENGTH);
+        m_Archive->m_IsMemMapped = true;
+        m_Archive->m_ArchiveFileIndex = new dmResourceArchive::ArchiveFileIndex;
+        dmStrlCpy(m_Archive->m_ArchiveFileIndex->m_Path, m_DataPath, sizeof(m_Archive->m_ArchiveFileIndex->m_Path));
+        m_Archive->m_ArchiveFileIndex->m_FileResourceData = fopen(m_DataPath, "ab+");
+        ASSERT_NE((FILE*)0, m_Archive->m_ArchiveFileIndex->m_FileResourceData);
+        m_Index = 0;
+        m_Transaction = 0;
+    }
+
+    virtual void TearDown()
+    {
+        if (m_Transaction)
+            dmResourceArchive::DeleteTransaction(m_Transaction);
+        if (m_Index)
+            dmResourceArchive::Delete(m_Index);
+        else
+            delete m_Archive->m_ArchiveIndex;
+        dmResourceArchive::Delete(m_Archive); // fclose on the FILE*
+        RemoveFiles();
+    }
+
+    void RemoveFiles()
+    {
+        const char* paths[] = { m_IndexPath, m_DataPath, m_JournalPath };
+        for (uint32_t i = 0; i < DM_ARRAY_SIZE(paths); ++i)
+        {
+            if (dmSys::Exists(paths[i]))
+                dmSys::Unlink(paths[i]);
+        }
+    }
+
+    dmResourceArchive::Result Store(uint32_t first, uint32_t count)
+    {
+        uint8_t buffer[128];
+        uint8_t hash[TRANSACTION_HASH_LENGTH];
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            dmResourceArchive::LiveUpdateResource resource;
+            MakeTransactionResource(i, buffer, sizeof(buffer), &resource);
+            MakeTransactionHash(i, hash);
+            dmResourceArchive::Result result = dmResourceArchive::StoreResource(m_Transaction, hash, sizeof(hash), &resource);
+            if (dmResourceArchive::RESULT_OK != result)
+                return result;
+        }
+        return dmResourceArchive::RESULT_OK;
+    }
+
+    void Commit()
+    {
+        dmResourceArchive::HArchiveIndex new_index = 0;
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::CommitTransaction(m_Transaction, m_IndexPath, new_index));
+        dmResourceArchive::DeleteTransaction(m_Transaction);
+        m_Transaction = 0;
+
+        if (m_Index)
+            dmResourceArchive::Delete(m_Index);
+        else
+            delete m_Archive->m_ArchiveIndex;
+        dmResourceArchive::SetNewArchiveIndex(m_Archive, new_index, true);
+        m_Index = new_index;
+    }
+
+    // Simulates that the application was terminated
+    void Crash()
+    {
+        dmResourceArchive::DeleteTransaction(m_Transaction);
+        m_Transaction = 0;
+    }
+
+    void VerifyResources(dmResourceArchive::HArchiveIndexContainer archive, uint32_t count)
+    {
+        ASSERT_EQ(count, dmResourceArchive::GetEntryCount(archive));
+        ASSERT_EQ(0, dmResource::VerifyArchiveIndex(archive));
+
+        uint8_t hash[TRANSACTION_HASH_LENGTH];
+        uint8_t expected[128];
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            dmResourceArchive::LiveUpdateResource resource;
+            MakeTransactionResource(i, expected, sizeof(expected), &resource);
+            MakeTransactionHash(i, hash);
+
+            dmResourceArchive::EntryData* entry = 0;
+            ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntry(archive, hash, sizeof(hash), &entry));
+            ASSERT_EQ(resource.m_Count, dmEndian::ToNetwork(entry->m_ResourceSize));
+
+            char buffer[128] = { 0 };
+            ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReadEntry(archive, entry, buffer));
+            ASSERT_STREQ((const char*)resource.m_Data, buffer);
+        }
+    }
+
+    // Verifies the index on disc, the same way it's loaded at the next mount
+    void VerifyStoredResources(uint32_t count)
+    {
+        dmResourceArchive::HArchiveIndexContainer archive = 0;
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::LoadArchiveFromFile(m_IndexPath, m_DataPath, &archive));
+        VerifyResources(archive, count);
+        dmResourceArchive::Delete(archive);
+    }
+
+    char                                    m_IndexPath[DMPATH_MAX_PATH];
+    char                                    m_DataPath[DMPATH_MAX_PATH];
+    char                                    m_JournalPath[DMPATH_MAX_PATH];
+    dmResourceArchive::HArchiveIndexContainer m_Archive;
+    dmResourceArchive::HArchiveIndex        m_Index;
+    dmResourceArchive::HArchiveTransaction  m_Transaction;
+};
+
+TEST_F(ArchiveTransaction, Commit)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_TRUE(dmSys::Exists(m_JournalPath));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 100));
+    ASSERT_EQ(100U, dmResourceArchive::GetTransactionResourceCount(m_Transaction));
+
+    // Stored resources aren't visible until committed, but are only stored once
+    uint8_t hash[TRANSACTION_HASH_LENGTH];
+    MakeTransactionHash(0, hash);
+    ASSERT_EQ(dmResourceArchive::RESULT_NOT_FOUND, dmResourceArchive::FindEntry(m_Archive, hash, sizeof(hash), 0));
+    uint32_t data_size = GetFileSize(m_DataPath);
+    ASSERT_EQ(dmResourceArchive::RESULT_ALREADY_STORED, Store(0, 1));
+    ASSERT_EQ(dmResourceArchive::RESULT_ALREADY_STORED, Store(99, 1));
+    ASSERT_EQ(100U, dmResourceArchive::GetTransactionResourceCount(m_Transaction));
+    ASSERT_EQ(data_size, GetFileSize(m_DataPath));
+    ASSERT_FALSE(dmSys::Exists(m_IndexPath));
+
+    Commit();
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+    VerifyResources(m_Archive, 100);
+    VerifyStoredResources(100);
+
+    // A second batch is merged with the committed index
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_ALREADY_STORED, Store(0, 1));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(100, 50));
+    Commit();
+    VerifyResources(m_Archive, 150);
+    VerifyStoredResources(150);
+}
+
+TEST_F(ArchiveTransaction, CommitMemMapped)
+{
+    // The data file is mapped again once per commit
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+    m_Archive->m_ArchiveFileIndex->m_IsMemMapped = true;
+    Commit();
+    ASSERT_EQ(GetFileSize(m_DataPath), m_Archive->m_ArchiveFileIndex->m_ResourceSize);
+    VerifyResources(m_Archive, 10);
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(10, 10));
+    Commit();
+    ASSERT_EQ(GetFileSize(m_DataPath), m_Archive->m_ArchiveFileIndex->m_ResourceSize);
+    VerifyResources(m_Archive, 20);
+
+    void* map = m_Archive->m_ArchiveFileIndex->m_ResourceData;
+    dmResource::UnmapFile(map, m_Archive->m_ArchiveFileIndex->m_ResourceSize);
+    m_Archive->m_ArchiveFileIndex->m_ResourceData = 0;
+    m_Archive->m_ArchiveFileIndex->m_IsMemMapped = false;
+}
+
+TEST_F(ArchiveTransaction, RecoverNotCommitted)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+    Crash();
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+    VerifyStoredResources(10);
+}
+
+TEST_F(ArchiveTransaction, RecoverPartialRecord)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+    Crash();
+
+    // Terminated while writing the last record
+    TruncateFile(m_JournalPath, GetFileSize(m_JournalPath) - 1);
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+    VerifyStoredResources(9);
+}
+
+TEST_F(ArchiveTransaction, RecoverPartialData)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+    Crash();
+
+    // The data of the last record never reached the disc
+    fclose(m_Archive->m_ArchiveFileIndex->m_FileResourceData);
+    m_Archive->m_ArchiveFileIndex->m_FileResourceData = 0;
+    TruncateFile(m_DataPath, GetFileSize(m_DataPath) - 1);
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    VerifyStoredResources(9);
+}
+
+TEST_F(ArchiveTransaction, RecoverUnsyncedData)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+    Crash();
+
+    // The records reached the disc, but the data of the first one didn't
+    fclose(m_Archive->m_ArchiveFileIndex->m_FileResourceData);
+    m_Archive->m_ArchiveFileIndex->m_FileResourceData = 0;
+    uint8_t buffer[128];
+    dmResourceArchive::LiveUpdateResource resource;
+    MakeTransactionResource(0, buffer, sizeof(buffer), &resource);
+    memset(buffer, 0, sizeof(buffer));
+    FILE* f = fopen(m_DataPath, "rb+");
+    ASSERT_NE((FILE*)0, f);
+    ASSERT_EQ(resource.m_Count, (uint32_t)fwrite(buffer, 1, resource.m_Count, f));
+    fclose(f);
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+
+    dmResourceArchive::HArchiveIndexContainer archive = 0;
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::LoadArchiveFromFile(m_IndexPath, m_DataPath, &archive));
+    ASSERT_EQ(9U, dmResourceArchive::GetEntryCount(archive));
+    uint8_t hash[TRANSACTION_HASH_LENGTH];
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        MakeTransactionHash(i, hash);
+        ASSERT_EQ(i == 0 ? dmResourceArchive::RESULT_NOT_FOUND : dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntry(archive, hash, sizeof(hash), 0));
+    }
+    dmResourceArchive::Delete(archive);
+}
+
+TEST_F(ArchiveTransaction, RecoverDataWithoutRecord)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+
+    // Terminated after writing the data, but before writing the record
+    const char data[] = "unreferenced data";
+    fwrite(data, 1, sizeof(data), m_Archive->m_ArchiveFileIndex->m_FileResourceData);
+    fflush(m_Archive->m_ArchiveFileIndex->m_FileResourceData);
+    Crash();
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    VerifyStoredResources(10);
+}
+
+TEST_F(ArchiveTransaction, RecoverPartialHeader)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    Crash();
+
+    // Terminated while creating the journal
+    TruncateFile(m_JournalPath, 10);
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_IndexPath));
+}
+
+TEST_F(ArchiveTransaction, RecoverAfterCommit)
+{
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(0, 10));
+
+    uint32_t journal_size = GetFileSize(m_JournalPath);
+    uint8_t* journal = new uint8_t[journal_size];
+    FILE* f = fopen(m_JournalPath, "rb");
+    ASSERT_EQ(journal_size, (uint32_t)fread(journal, 1, journal_size, f));
+    fclose(f);
+
+    Commit();
+
+    // Terminated after writing the index, but before removing the journal
+    f = fopen(m_JournalPath, "wb");
+    ASSERT_EQ(journal_size, (uint32_t)fwrite(journal, 1, journal_size, f));
+    fclose(f);
+    delete[] journal;
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    ASSERT_FALSE(dmSys::Exists(m_JournalPath));
+    VerifyStoredResources(10);
+
+    // Records are merged with the existing index
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(10, 5));
+    Crash();
+
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReplayJournal(m_IndexPath, m_DataPath, m_JournalPath));
+    VerifyStoredResources(15);
+}
+
+TEST_F(ArchiveTransaction, StorePerf)
+{
+    const uint32_t legacy_count = 1000;
+    const uint32_t count = 10000;
+
+    uint8_t buffer[128];
+    uint8_t hash[TRANSACTION_HASH_LENGTH];
+
+    // One index per resource
+    uint64_t time = dmTime::GetTime();
+    for (uint32_t i = 0; i < legacy_count; ++i)
+    {
+        dmResourceArchive::LiveUpdateResource resource;
+        MakeTransactionResource(i, buffer, sizeof(buffer), &resource);
+        MakeTransactionHash(i, hash);
+
+        dmResourceArchive::HArchiveIndex new_index = 0;
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewArchiveIndexWithResource(m_Archive, m_IndexPath, hash, sizeof(hash), &resource, new_index));
+        if (m_Index)
+            dmResourceArchive::Delete(m_Index);
+        else
+            delete m_Archive->m_ArchiveIndex;
+        dmResourceArchive::SetNewArchiveIndex(m_Archive, new_index, true);
+        m_Index = new_index;
+    }
+    time = dmTime::GetTime() - time;
+    printf("Storing %u resources, one index each: %.2f ms\n", legacy_count, time / 1000.0);
+
+    // One index per transaction
+    time = dmTime::GetTime();
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::NewTransaction(m_Archive, m_JournalPath, &m_Transaction));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, Store(legacy_count, count));
+    Commit();
+    time = dmTime::GetTime() - time;
+    printf("Storing %u resources in a transaction: %.2f ms\n", count, time / 1000.0);
+
+    VerifyStoredResources(legacy_count + count);
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
@@ -14,9 +14,12 @@
 
 #include "script.h"
 
+#include <string.h>
+
 #include <dlib/dstrings.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
+#include <dlib/memory.h>
 #include <dlib/pprint.h>
 #include <dlib/profile.h>
 
@@ -35,6 +38,7 @@
 #include "script_bitop.h"
 #include "script_timer.h"
 #include "script_extensions.h"
+#include "script_alloc.h"
 
 extern "C"
 {
@@ -42,6 +46,9 @@ extern "C"
 }
 
 DM_PROPERTY_GROUP(rmtp_Script, "");
+DM_PROPERTY_U32(rmtp_LuaMemory, 0, FrameReset, "# kb allocated by Lua", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaPeakMemory, 0, FrameReset, "# kb peak allocated by Lua", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaAllocations, 0, FrameReset, "# Lua allocations", &rmtp_Script);
 
 namespace dmScript
 {
@@ -73,6 +80,13 @@ namespace dmScript
     // A debug value for profiling lua references
     int g_LuaReferenceCount = 0;
 
+    static int LuaPanic(lua_State* L)
+    {
+        // Same as the panic function installed by luaL_newstate()
+        dmLogFatal("PANIC: unprotected error in call to Lua API (%s)", lua_tostring(L, -1));
+        return 0;
+    }
+
     HContext NewContext(dmConfigFile::HConfig config_file, dmResource::HFactory factory, bool enable_extensions)
     {
         Context* context = new Context();
@@ -80,18 +94,52 @@ namespace dmScript
         context->m_PathToModule.SetCapacity(127, 256);
         context->m_HashInstances.SetCapacity(443, 256);
         context->m_ScriptExtensions.SetCapacity(8);
+        context->m_URLCache.SetCapacity(URL_CACHE_TABLE_SIZE, URL_CACHE_CAPACITY);
+        context->m_MessageIdCache.SetCapacity(URL_CACHE_TABLE_SIZE, URL_CACHE_CAPACITY);
         context->m_ConfigFile = config_file;
         context->m_ResourceFactory = factory;
-        context->m_LuaState = lua_open();
+        context->m_LuaAllocator = NewLuaAllocator();
+        context->m_LuaState = lua_newstate(LuaAlloc, context->m_LuaAllocator);
+        if (context->m_LuaState)
+        {
+            lua_atpanic(context->m_LuaState, LuaPanic);
+        }
+        else
+        {
+            // LuaJIT doesn't allow custom allocators on all 64 bit targets
+            DeleteLuaAllocator(context->m_LuaAllocator);
+            context->m_LuaAllocator = 0;
+            context->m_LuaState = lua_open();
+        }
         context->m_ContextTableRef = LUA_NOREF;
+        context->m_URLCacheStringsRef = LUA_NOREF;
+        context->m_URLCacheSocketGeneration = dmMessage::GetSocketGeneration();
+        context->m_MessageTableOwner = new MessageTableOwner;
+        context->m_MessageTableOwner->m_Context = context;
+        context->m_MessageTableOwner->m_RefCount = 1;
+        context->m_SysSaveQueue = 0x0;
+        context->m_JsonDecodeQueue = 0x0;
+        context->m_BytecodeCachePath = 0x0;
         context->m_EnableExtensions = enable_extensions;
+        context->m_MemoryTag = dmMemory::RegisterTag("lua");
+        context->m_ReportedLuaBytes = 0;
+        dmMemory::TrackAlloc(context->m_MemoryTag, 0);
         return context;
     }
 
     void DeleteContext(HContext context)
     {
         ClearModules(context);
+        // Tables of messages still in flight are gone with the Lua state
+        context->m_MessageTableOwner->m_Context = 0x0;
+        ReleaseMessageTableOwner(context->m_MessageTableOwner);
         lua_close(context->m_LuaState);
+        if (context->m_LuaAllocator)
+        {
+            DeleteLuaAllocator(context->m_LuaAllocator);
+        }
+        dmMemory::TrackFree(context->m_MemoryTag, context->m_ReportedLuaBytes);
+        free(context->m_BytecodeCachePath);
         delete context;
     }
 
@@ -209,6 +257,8 @@ namespace dmScript
 
         InitializeHttp(context);
         InitializeTimer(context);
+        InitializeSysSave(context);
+        InitializeJsonDecode(context);
         if (context->m_EnableExtensions)
         {
             InitializeExtensions(context);
@@ -241,12 +291,35 @@ namespace dmScript
                 (*l)->Update(context);
             }
         }
+
+        uint32_t live_bytes;
+        if (context->m_LuaAllocator)
+        {
+            LuaMemoryStats stats;
+            GetLuaAllocatorStats(context->m_LuaAllocator, &stats);
+            DM_PROPERTY_ADD_U32(rmtp_LuaMemory, (uint32_t) (stats.m_LiveBytes / 1024));
+            DM_PROPERTY_ADD_U32(rmtp_LuaPeakMemory, (uint32_t) (stats.m_PeakBytes / 1024));
+            DM_PROPERTY_ADD_U32(rmtp_LuaAllocations, stats.m_FrameAllocations);
+            ResetLuaAllocatorFrameStats(context->m_LuaAllocator);
+            live_bytes = (uint32_t) stats.m_LiveBytes;
+        }
+        else
+        {
+            uint32_t kb = GetLuaGCCount(context->m_LuaState);
+            DM_PROPERTY_ADD_U32(rmtp_LuaMemory, kb);
+            live_bytes = kb * 1024;
+        }
+
+        dmMemory::TrackRealloc(context->m_MemoryTag, context->m_ReportedLuaBytes, live_bytes);
+        context->m_ReportedLuaBytes = live_bytes;
     }
 
     void Finalize(HContext context)
     {
         lua_State* L = context->m_LuaState;
 
+        ClearURLCache(context);
+
         for (HScriptExtension* l = context->m_ScriptExtensions.Begin(); l != context->m_ScriptExtensions.End(); ++l)
         {
             if ((*l)->Finalize != 0x0)
@@ -1461,6 +1534,19 @@ namespace dmScript
         return (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
     }
 
+    void GetLuaMemoryStats(HContext context, LuaMemoryStats* stats)
+    {
+        if (context->m_LuaAllocator)
+        {
+            GetLuaAllocatorStats(context->m_LuaAllocator, stats);
+            return;
+        }
+
+        memset(stats, 0, sizeof(*stats));
+        lua_State* L = context->m_LuaState;
+        stats->m_LiveBytes = (uint64_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + (uint64_t) lua_gc(L, LUA_GCCOUNTB, 0);
+    }
+
     LuaStackCheck::LuaStackCheck(lua_State* L, int diff, const char* filename, int linenumber) : m_L(L), m_Filename(filename), m_Linenumber(linenumber), m_Top(lua_gettop(L)), m_Diff(diff)
     {
         if (!(m_Diff >= -m_Top)) {
@@ -597,9 +597,19 @@ namespace dmScript
 
     /**
      * Wraps luaL_loadbuffer but takes dmLuaDDF::LuaSource instead of buffer directly.
+     * Bytecode that can't be loaded by the running Lua VM is ignored in favour of the source, if there is any.
      */
     int LuaLoad(lua_State *L, dmLuaDDF::LuaSource* source);
 
+    /**
+     * Set the directory where bytecode compiled from Lua source is cached between runs.
+     * There is one file per chunk name, which is only used if it was written by the same Lua VM, with the same pointer
+     * width, from the same source. Otherwise the source is compiled and the file is replaced.
+     * @param context script context
+     * @param path existing directory, or 0x0 to disable the cache (default)
+     */
+    void SetBytecodeCachePath(HContext context, const char* path);
+
     /** Gets the number of references currently kept
      * @return the total number of references in the game
     */
@@ -615,6 +625,27 @@ namespace dmScript
     */
     uint32_t GetLuaGCCount(lua_State* L);
 
+    /** Memory statistics of the Lua state in a script context
+     */
+    struct LuaMemoryStats
+    {
+        /// Bytes currently allocated by Lua
+        uint64_t m_LiveBytes;
+        /// The highest m_LiveBytes since the context was created
+        uint64_t m_PeakBytes;
+        /// Number of allocations since the last call to Update()
+        uint32_t m_FrameAllocations;
+        /// Bytes reserved for the small block slabs
+        uint32_t m_SlabBytes;
+    };
+
+    /** Gets the memory statistics of the Lua state.
+    * If the Lua state couldn't use the engine allocator, only m_LiveBytes is set
+    * @param context script context
+    * @param stats [out] the statistics
+    */
+    void GetLuaMemoryStats(HContext context, LuaMemoryStats* stats);
+
 // DEPRECATED
 // I really don't like this callback setup (mistake on my part). It's clunky.
 // Perhaps better to have a lambda function? (now that all compilers support C++11) /MAWE
@@ -0,0 +1,219 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "script_alloc.h"
+#include "script.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <dlib/array.h>
+#include <dlib/math.h>
+
+namespace dmScript
+{
+    // Blocks up to this size are served from the slabs, the larger ones go to the system allocator
+    static const uint32_t SMALL_BLOCK_MAX_SIZE    = 256;
+    // Also the alignment of the blocks, since the slabs come from malloc
+    static const uint32_t SMALL_BLOCK_GRANULARITY = 16;
+    static const uint32_t SIZE_CLASS_COUNT        = SMALL_BLOCK_MAX_SIZE / SMALL_BLOCK_GRANULARITY;
+    static const uint32_t SLAB_SIZE               = 16 * 1024;
+
+    struct FreeBlock
+    {
+        FreeBlock* m_Next;
+    };
+
+    struct SizeClass
+    {
+        FreeBlock*  m_FreeList;
+        // The part of the newest slab that hasn't been handed out yet
+        uint8_t*    m_Cursor;
+        uint8_t*    m_End;
+    };
+
+    struct LuaAllocator
+    {
+        SizeClass       m_SizeClasses[SIZE_CLASS_COUNT];
+        dmArray<void*>  m_Slabs;
+        uint64_t        m_LiveBytes;
+        uint64_t        m_PeakBytes;
+        uint32_t        m_FrameAllocations;
+    };
+
+    static inline bool IsSmallBlock(size_t size)
+    {
+        return size != 0 && size <= SMALL_BLOCK_MAX_SIZE;
+    }
+
+    static inline uint32_t GetSizeClass(size_t size)
+    {
+        return (uint32_t) ((size - 1) / SMALL_BLOCK_GRANULARITY);
+    }
+
+    static void* AllocSmall(LuaAllocator* allocator, uint32_t size_class)
+    {
+        SizeClass& sc = allocator->m_SizeClasses[size_class];
+        if (sc.m_FreeList)
+        {
+            FreeBlock* block = sc.m_FreeList;
+            sc.m_FreeList = block->m_Next;
+            return block;
+        }
+
+        uint32_t block_size = (size_class + 1) * SMALL_BLOCK_GRANULARITY;
+        if ((uintptr_t) (sc.m_End - sc.m_Cursor) < block_size)
+        {
+            uint8_t* slab = (uint8_t*) malloc(SLAB_SIZE);
+            if (!slab)
+            {
+                return 0;
+            }
+            if (allocator->m_Slabs.Full())
+            {
+                allocator->m_Slabs.OffsetCapacity(64);
+            }
+            allocator->m_Slabs.Push(slab);
+            sc.m_Cursor = slab;
+            sc.m_End = slab + SLAB_SIZE;
+        }
+
+        void* block = sc.m_Cursor;
+        sc.m_Cursor += block_size;
+        return block;
+    }
+
+    static void FreeSmall(LuaAllocator* allocator, void* ptr, uint32_t size_class)
+    {
+        SizeClass& sc = allocator->m_SizeClasses[size_class];
+        FreeBlock* block = (FreeBlock*) ptr;
+        block->m_Next = sc.m_FreeList;
+        sc.m_FreeList = block;
+    }
+
+    static void Free(LuaAllocator* allocator, void* ptr, size_t size)
+    {
+        if (ptr == 0)
+        {
+            return;
+        }
+        if (IsSmallBlock(size))
+        {
+            FreeSmall(allocator, ptr, GetSizeClass(size));
+        }
+        else
+        {
+            free(ptr);
+        }
+        allocator->m_LiveBytes -= size;
+    }
+
+    static inline void TrackAllocation(LuaAllocator* allocator, size_t old_size, size_t new_size)
+    {
+        allocator->m_LiveBytes = allocator->m_LiveBytes - old_size + new_size;
+        allocator->m_PeakBytes = dmMath::Max(allocator->m_PeakBytes, allocator->m_LiveBytes);
+        allocator->m_FrameAllocations++;
+    }
+
+    HLuaAllocator NewLuaAllocator()
+    {
+        LuaAllocator* allocator = new LuaAllocator;
+        memset(allocator->m_SizeClasses, 0, sizeof(allocator->m_SizeClasses));
+        allocator->m_LiveBytes = 0;
+        allocator->m_PeakBytes = 0;
+        allocator->m_FrameAllocations = 0;
+        return allocator;
+    }
+
+    void DeleteLuaAllocator(HLuaAllocator allocator)
+    {
+        for (uint32_t i = 0; i < allocator->m_Slabs.Size(); ++i)
+        {
+            free(allocator->m_Slabs[i]);
+        }
+        delete allocator;
+    }
+
+    void* LuaAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        LuaAllocator* allocator = (LuaAllocator*) ud;
+
+        // Lua always passes the size of the old block, so we know where it came from without any block headers
+        if (ptr == 0)
+        {
+            osize = 0;
+        }
+
+        if (nsize == 0)
+        {
+            Free(allocator, ptr, osize);
+            return 0;
+        }
+
+        bool old_small = IsSmallBlock(osize);
+        bool new_small = IsSmallBlock(nsize);
+        if (ptr != 0)
+        {
+            if (old_small && new_small && GetSizeClass(osize) == GetSizeClass(nsize))
+            {
+                allocator->m_LiveBytes = allocator->m_LiveBytes - osize + nsize;
+                return ptr;
+            }
+            if (!old_small && !new_small)
+            {
+                void* new_ptr = realloc(ptr, nsize);
+                if (new_ptr == 0)
+                {
+                    return 0;
+                }
+                TrackAllocation(allocator, osize, nsize);
+                return new_ptr;
+            }
+        }
+
+        void* new_ptr = new_small ? AllocSmall(allocator, GetSizeClass(nsize)) : malloc(nsize);
+        if (new_ptr == 0)
+        {
+            // Lua requires that shrinking never fails. The old block is at least as large as
+            // the new size class, so it can be put in that free list once Lua releases it
+            if (ptr != 0 && nsize <= osize)
+            {
+                allocator->m_LiveBytes = allocator->m_LiveBytes - osize + nsize;
+                return ptr;
+            }
+            return 0;
+        }
+
+        if (ptr != 0)
+        {
+            memcpy(new_ptr, ptr, dmMath::Min(osize, nsize));
+            Free(allocator, ptr, osize);
+        }
+        TrackAllocation(allocator, 0, nsize);
+        return new_ptr;
+    }
+
+    void GetLuaAllocatorStats(HLuaAllocator allocator, LuaMemoryStats* stats)
+    {
+        stats->m_LiveBytes = allocator->m_LiveBytes;
+        stats->m_PeakBytes = allocator->m_PeakBytes;
+        stats->m_FrameAllocations = allocator->m_FrameAllocations;
+        stats->m_SlabBytes = allocator->m_Slabs.Size() * SLAB_SIZE;
+    }
+
+    void ResetLuaAllocatorFrameStats(HLuaAllocator allocator)
+    {
+        allocator->m_FrameAllocations = 0;
+    }
+}
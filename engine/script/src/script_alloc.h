@@ -0,0 +1,48 @@
+// Copyright 2020-2023 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_SCRIPT_ALLOC_H
+#define DM_SCRIPT_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dmScript
+{
+    struct LuaMemoryStats;
+
+    typedef struct LuaAllocator* HLuaAllocator;
+
+    /** Creates an allocator that serves the small blocks (<= 256 bytes) from size class slabs,
+     * and the larger ones from the system allocator.
+     * An allocator is not thread safe, and is meant to be used by a single Lua state.
+     */
+    HLuaAllocator NewLuaAllocator();
+
+    /** Deletes the allocator and all its slabs. The Lua state using it must be closed first.
+     */
+    void DeleteLuaAllocator(HLuaAllocator allocator);
+
+    /** A lua_Alloc function, with the allocator as user data
+     */
+    void* LuaAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    void GetLuaAllocatorStats(HLuaAllocator allocator, LuaMemoryStats* stats);
+
+    /** Resets the per frame allocation counter
+     */
+    void ResetLuaAllocatorFrameStats(HLuaAllocator allocator);
+}
+
+#endif // DM_SCRIPT_ALLOC_H
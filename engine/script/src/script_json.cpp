@@ -15,9 +15,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <float.h>
 
+#include <dlib/array.h>
 #include <dlib/dstrings.h>
+#include <dlib/math.h>
+#include <dlib/profile.h>
 
 #include "script.h"
 
@@ -29,8 +33,22 @@ extern "C"
     // Defined in luacjson/lua_cjson.c
     int lua_cjson_decode(lua_State* L, const char* json_string, size_t json_len);
     int lua_cjson_encode(lua_State* L, char** json_str, size_t* json_length);
+
+    #include "luacjson/fpconv.h"
 }
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DM_JSON_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define DM_JSON_NEON
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 #include "script_json.h"
 #include "script_private.h"
 
@@ -45,8 +63,853 @@ namespace dmScript
      * @namespace json
      */
 
+    // The decoder works in two stages, much like simdjson:
+    // Stage 1 classifies the json 64 bytes at a time, using SIMD compares, and produces an index of the
+    // positions of all structural characters, string starts and scalar starts (outside of strings).
+    // Stage 2 walks the index and builds the Lua tables, without having to look at the whitespace or
+    // the string contents (except for the strings with escape codes).
+    //
+    // The decoder accepts the same input as lua-cjson (e.g. hex numbers and inf/nan), and if it fails,
+    // the input is decoded again by lua-cjson which produces the actual error message.
+    //
+    // The index is produced in windows, so the memory overhead doesn't depend on the json size,
+    // and the decoding can be suspended after any value (see JsonDecoderStep()).
+
+    static const uint32_t JSON_MAX_DEPTH = 1000;        // Same as lua-cjson
+    static const uint32_t JSON_BLOCK_SIZE = 64;
+    static const uint32_t JSON_MAX_INDEX_SIZE = 4096;   // Entries in the index window
+    static const uint32_t JSON_MAX_LENGTH = 0xFFFFFFFF - 2 * JSON_BLOCK_SIZE;
+
+    enum JsonDecoderState
+    {
+        JSON_DECODER_STATE_VALUE,
+        JSON_DECODER_STATE_KEY,
+        JSON_DECODER_STATE_STORE,
+        JSON_DECODER_STATE_NEXT,
+        JSON_DECODER_STATE_DONE,
+        JSON_DECODER_STATE_ERROR,
+    };
+
+    struct JsonFrame
+    {
+        uint32_t m_Count;       // Number of values stored in the container
+        uint32_t m_IsArray;
+    };
+
+    // Sizes of the last closed containers at a depth, used to preallocate the next ones
+    // (e.g. in an array of similar objects)
+    struct JsonSizeHint
+    {
+        uint32_t m_Array;
+        uint32_t m_Object;
+    };
+
+    struct JsonDecoder
+    {
+        lua_State*  m_L;
+        const char* m_Json;
+        uint32_t    m_Length;           // Stops at the first null character
+        uint32_t    m_ScanOffset;       // Where stage 1 continues
+        uint64_t    m_InString;         // All bits set if the previous block ended inside a string
+        uint64_t    m_Escaped;          // 1 if the first character of the next block is escaped
+        uint64_t    m_InScalar;         // 1 if the previous block ended with a scalar character
+        uint32_t*   m_Index;
+        uint32_t    m_IndexSize;
+        uint32_t    m_IndexCount;
+        uint32_t    m_IndexCursor;
+        JsonFrame*  m_Frames;           // The open containers
+        JsonSizeHint* m_SizeHints;      // Per depth
+        uint32_t    m_Depth;
+        int         m_StackIndex;       // Stack index of the table holding the open containers and their keys (incremental decoding only)
+        int         m_DecoderRef;
+        int         m_StackRef;
+        uint8_t     m_State;
+        uint8_t     m_ScanFinished:1;   // All blocks are scanned
+        uint8_t     m_ScanDone:1;       // The end position is added to the index
+    };
+
+    struct JsonBlockMasks
+    {
+        uint64_t m_Quote;
+        uint64_t m_Backslash;
+        uint64_t m_Operator;    // {}[]:,
+        uint64_t m_Whitespace;
+        uint64_t m_Null;
+    };
+
+    static inline uint32_t CountTrailingZeros(uint64_t x)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        #if defined(_M_X64) || defined(_M_ARM64)
+            _BitScanForward64(&index, x);
+        #else
+            if (!_BitScanForward(&index, (unsigned long)x))
+            {
+                _BitScanForward(&index, (unsigned long)(x >> 32));
+                index += 32;
+            }
+        #endif
+        return (uint32_t)index;
+    #else
+        return (uint32_t)__builtin_ctzll(x);
+    #endif
+    }
+
+    // Bit n is set if there's an odd number of bits set at or below n
+    static inline uint64_t PrefixXor(uint64_t x)
+    {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+#if defined(DM_JSON_SSE2)
+    static inline uint64_t MoveMask(__m128i v, uint32_t shift)
+    {
+        return (uint64_t)(uint32_t)_mm_movemask_epi8(v) << shift;
+    }
+
+    static void ClassifyBlock(const uint8_t* p, JsonBlockMasks* masks)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i lower = _mm_set1_epi8(0x20);
+        const __m128i open = _mm_set1_epi8('{');    // '[' | 0x20
+        const __m128i close = _mm_set1_epi8('}');   // ']' | 0x20
+        const __m128i colon = _mm_set1_epi8(':');
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i zero = _mm_setzero_si128();
+
+        memset(masks, 0, sizeof(*masks));
+        for (uint32_t i = 0; i < JSON_BLOCK_SIZE; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+            __m128i vl = _mm_or_si128(v, lower);
+            __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vl, open), _mm_cmpeq_epi8(vl, close)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+            __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, cr)));
+            masks->m_Quote |= MoveMask(_mm_cmpeq_epi8(v, quote), i);
+            masks->m_Backslash |= MoveMask(_mm_cmpeq_epi8(v, backslash), i);
+            masks->m_Operator |= MoveMask(op, i);
+            masks->m_Whitespace |= MoveMask(ws, i);
+            masks->m_Null |= MoveMask(_mm_cmpeq_epi8(v, zero), i);
+        }
+    }
+#elif defined(DM_JSON_NEON)
+    static inline uint64_t MoveMask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+    {
+        static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t bit_mask = vld1q_u8(bits);
+        uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bit_mask), vandq_u8(m1, bit_mask));
+        uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bit_mask), vandq_u8(m3, bit_mask));
+        sum0 = vpaddq_u8(sum0, sum1);
+        sum0 = vpaddq_u8(sum0, sum0);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+    }
+
+    static void ClassifyBlock(const uint8_t* p, JsonBlockMasks* masks)
+    {
+        uint8x16_t quote[4], backslash[4], op[4], ws[4], null[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            uint8x16_t v = vld1q_u8(p + i * 16);
+            uint8x16_t vl = vorrq_u8(v, vdupq_n_u8(0x20));
+            quote[i] = vceqq_u8(v, vdupq_n_u8('"'));
+            backslash[i] = vceqq_u8(v, vdupq_n_u8('\\'));
+            op[i] = vorrq_u8(vorrq_u8(vceqq_u8(vl, vdupq_n_u8('{')), vceqq_u8(vl, vdupq_n_u8('}'))),
+                             vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')), vceqq_u8(v, vdupq_n_u8(','))));
+            ws[i] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                             vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+            null[i] = vceqq_u8(v, vdupq_n_u8(0));
+        }
+        masks->m_Quote = MoveMask(quote[0], quote[1], quote[2], quote[3]);
+        masks->m_Backslash = MoveMask(backslash[0], backslash[1], backslash[2], backslash[3]);
+        masks->m_Operator = MoveMask(op[0], op[1], op[2], op[3]);
+        masks->m_Whitespace = MoveMask(ws[0], ws[1], ws[2], ws[3]);
+        masks->m_Null = MoveMask(null[0], null[1], null[2], null[3]);
+    }
+#else
+    static void ClassifyBlock(const uint8_t* p, JsonBlockMasks* masks)
+    {
+        memset(masks, 0, sizeof(*masks));
+        for (uint32_t i = 0; i < JSON_BLOCK_SIZE; ++i)
+        {
+            uint64_t bit = 1ULL << i;
+            switch (p[i])
+            {
+            case '"':   masks->m_Quote |= bit; break;
+            case '\\':  masks->m_Backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                        masks->m_Operator |= bit; break;
+            case ' ': case '\t': case '\n': case '\r':
+                        masks->m_Whitespace |= bit; break;
+            case 0:     masks->m_Null |= bit; break;
+            default:    break;
+            }
+        }
+    }
+#endif
+
+    // Stage 1: Scans the next block and adds its structural positions to the index
+    static void ScanBlock(JsonDecoder* decoder)
+    {
+        uint32_t offset = decoder->m_ScanOffset;
+        uint32_t remaining = decoder->m_Length - offset;
+
+        JsonBlockMasks masks;
+        uint64_t valid = ~0ULL;
+        if (remaining >= JSON_BLOCK_SIZE)
+        {
+            ClassifyBlock((const uint8_t*)decoder->m_Json + offset, &masks);
+        }
+        else
+        {
+            // Pad with whitespace so that we never read outside of the json
+            uint8_t block[JSON_BLOCK_SIZE];
+            memset(block, ' ', sizeof(block));
+            memcpy(block, decoder->m_Json + offset, remaining);
+            ClassifyBlock(block, &masks);
+            valid = (1ULL << remaining) - 1;
+        }
+
+        if (masks.m_Null & valid)
+        {
+            // Same as lua-cjson, the json ends at the first null character
+            uint32_t end = CountTrailingZeros(masks.m_Null & valid);
+            valid = (1ULL << end) - 1;
+            decoder->m_Length = offset + end;
+        }
+
+        uint64_t quote = masks.m_Quote & valid;
+        uint64_t backslash = masks.m_Backslash & valid;
+
+        // Escape sequences are rare, so we resolve them one at a time
+        uint64_t escaped = 0;
+        if (backslash | decoder->m_Escaped)
+        {
+            if (decoder->m_Escaped)
+            {
+                escaped = 1;
+                backslash &= ~1ULL;
+            }
+            decoder->m_Escaped = 0;
+            while (backslash)
+            {
+                uint32_t i = CountTrailingZeros(backslash);
+                if (i == JSON_BLOCK_SIZE - 1)
+                {
+                    decoder->m_Escaped = 1;
+                    break;
+                }
+                escaped |= 2ULL << i;
+                backslash &= ~(3ULL << i);
+            }
+            quote &= ~escaped;
+        }
+
+        // The opening quotes are inside the string, the closing quotes are not
+        uint64_t in_string = PrefixXor(quote) ^ decoder->m_InString;
+        decoder->m_InString = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t op = masks.m_Operator & ~in_string & valid;
+        uint64_t scalar = ~(masks.m_Operator | masks.m_Whitespace | quote | in_string) & valid;
+        uint64_t scalar_start = scalar & ~((scalar << 1) | decoder->m_InScalar);
+        decoder->m_InScalar = scalar >> 63;
+
+        uint64_t structural = op | (quote & in_string) | scalar_start;
+
+        uint32_t* index = decoder->m_Index + decoder->m_IndexCount;
+        while (structural)
+        {
+            *index++ = offset + CountTrailingZeros(structural);
+            structural &= structural - 1;
+        }
+        decoder->m_IndexCount = (uint32_t)(index - decoder->m_Index);
+
+        decoder->m_ScanOffset = offset + JSON_BLOCK_SIZE;
+        if (decoder->m_ScanOffset >= decoder->m_Length)
+        {
+            decoder->m_ScanOffset = decoder->m_Length;
+            decoder->m_ScanFinished = 1;
+        }
+    }
+
+    static void RefillIndex(JsonDecoder* decoder)
+    {
+        uint32_t unread = decoder->m_IndexCount - decoder->m_IndexCursor;
+        memmove(decoder->m_Index, decoder->m_Index + decoder->m_IndexCursor, unread * sizeof(uint32_t));
+        decoder->m_IndexCount = unread;
+        decoder->m_IndexCursor = 0;
+
+        while (!decoder->m_ScanFinished && decoder->m_IndexCount + JSON_BLOCK_SIZE <= decoder->m_IndexSize)
+        {
+            ScanBlock(decoder);
+        }
+        if (decoder->m_ScanFinished && decoder->m_IndexCount < decoder->m_IndexSize)
+        {
+            decoder->m_Index[decoder->m_IndexCount++] = decoder->m_Length;
+            decoder->m_ScanDone = 1;
+        }
+    }
+
+    // Returns the position of the current token, and makes sure the next one is available
+    static inline uint32_t CurrentToken(JsonDecoder* decoder)
+    {
+        if (decoder->m_IndexCursor + 1 >= decoder->m_IndexCount && !decoder->m_ScanDone)
+        {
+            RefillIndex(decoder);
+        }
+        return decoder->m_IndexCursor < decoder->m_IndexCount ? decoder->m_Index[decoder->m_IndexCursor] : decoder->m_Length;
+    }
+
+    static inline uint32_t NextToken(JsonDecoder* decoder)
+    {
+        uint32_t next = decoder->m_IndexCursor + 1;
+        return next < decoder->m_IndexCount ? decoder->m_Index[next] : decoder->m_Length;
+    }
+
+    static inline char CurrentChar(JsonDecoder* decoder)
+    {
+        uint32_t pos = CurrentToken(decoder);
+        return pos < decoder->m_Length ? decoder->m_Json[pos] : 0;
+    }
+
+    // Only whitespace can follow a string or a scalar before the next token
+    static inline uint32_t TokenEnd(JsonDecoder* decoder, uint32_t start, uint32_t next)
+    {
+        const char* json = decoder->m_Json;
+        while (next > start)
+        {
+            char c = json[next - 1];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+                break;
+            --next;
+        }
+        return next;
+    }
+
+    static int HexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f')
+            return 10 + c - 'a';
+        return -1;
+    }
+
+    static int DecodeHex4(const char* p)
+    {
+        int value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            int digit = HexDigit(p[i]);
+            if (digit < 0)
+                return -1;
+            value = (value << 4) | digit;
+        }
+        return value;
+    }
+
+    // Returns the number of bytes consumed from p (the text after "\u"), or 0 if the escape code is invalid
+    static uint32_t AddUnicodeEscape(luaL_Buffer* buffer, const char* p, const char* end)
+    {
+        if (end - p < 4)
+            return 0;
+        int codepoint = DecodeHex4(p);
+        if (codepoint < 0)
+            return 0;
+
+        uint32_t consumed = 4;
+        if ((codepoint & 0xF800) == 0xD800)
+        {
+            // A high surrogate must be followed by a low surrogate
+            if ((codepoint & 0x400) || end - p < 10 || p[4] != '\\' || p[5] != 'u')
+                return 0;
+            int low = DecodeHex4(p + 6);
+            if (low < 0 || (low & 0xFC00) != 0xDC00)
+                return 0;
+            codepoint = (((codepoint & 0x3FF) << 10) | (low & 0x3FF)) + 0x10000;
+            consumed = 10;
+        }
+
+        char utf8[4];
+        uint32_t len;
+        if (codepoint <= 0x7F)
+        {
+            utf8[0] = (char)codepoint;
+            len = 1;
+        }
+        else if (codepoint <= 0x7FF)
+        {
+            utf8[0] = (char)((codepoint >> 6) | 0xC0);
+            utf8[1] = (char)((codepoint & 0x3F) | 0x80);
+            len = 2;
+        }
+        else if (codepoint <= 0xFFFF)
+        {
+            utf8[0] = (char)((codepoint >> 12) | 0xE0);
+            utf8[1] = (char)(((codepoint >> 6) & 0x3F) | 0x80);
+            utf8[2] = (char)((codepoint & 0x3F) | 0x80);
+            len = 3;
+        }
+        else
+        {
+            utf8[0] = (char)((codepoint >> 18) | 0xF0);
+            utf8[1] = (char)(((codepoint >> 12) & 0x3F) | 0x80);
+            utf8[2] = (char)(((codepoint >> 6) & 0x3F) | 0x80);
+            utf8[3] = (char)((codepoint & 0x3F) | 0x80);
+            len = 4;
+        }
+        luaL_addlstring(buffer, utf8, len);
+        return consumed;
+    }
+
+    static bool PushEscapedString(lua_State* L, const char* s, const char* backslash, const char* end)
+    {
+        // The buffer uses a few stack slots
+        if (!lua_checkstack(L, LUA_MINSTACK))
+            return false;
+
+        luaL_Buffer buffer;
+        luaL_buffinit(L, &buffer);
+        while (backslash)
+        {
+            luaL_addlstring(&buffer, s, backslash - s);
+            if (backslash + 1 >= end)
+                return false;
+
+            char c = backslash[1];
+            s = backslash + 2;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/': luaL_addchar(&buffer, c); break;
+            case 'b': luaL_addchar(&buffer, '\b'); break;
+            case 'f': luaL_addchar(&buffer, '\f'); break;
+            case 'n': luaL_addchar(&buffer, '\n'); break;
+            case 'r': luaL_addchar(&buffer, '\r'); break;
+            case 't': luaL_addchar(&buffer, '\t'); break;
+            case 'u':
+                {
+                    uint32_t consumed = AddUnicodeEscape(&buffer, s, end);
+                    if (!consumed)
+                        return false;
+                    s += consumed;
+                }
+                break;
+            default:
+                return false;
+            }
+            backslash = (const char*)memchr(s, '\\', end - s);
+        }
+        luaL_addlstring(&buffer, s, end - s);
+        luaL_pushresult(&buffer);
+        return true;
+    }
+
+    static bool PushString(lua_State* L, JsonDecoder* decoder, uint32_t pos, uint32_t next)
+    {
+        uint32_t end = TokenEnd(decoder, pos, next);
+        if (end < pos + 2 || decoder->m_Json[end - 1] != '"')
+            return false;
+        // An unterminated string can only be the last token
+        if (next == decoder->m_Length && decoder->m_InString)
+            return false;
+
+        const char* s = decoder->m_Json + pos + 1;
+        size_t len = end - pos - 2;
+        const char* backslash = (const char*)memchr(s, '\\', len);
+        if (!backslash)
+        {
+            lua_pushlstring(L, s, len);
+            return true;
+        }
+        return PushEscapedString(L, s, backslash, s + len);
+    }
+
+    static const double g_Pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Handles the common cases exactly (up to 15 significant digits and a small exponent, where both
+    // the mantissa and the power of ten are exact doubles). Returns false if strtod() is needed.
+    static bool ParseNumberFast(const char* p, const char* end, double* out)
+    {
+        bool negative = *p == '-';
+        if (negative)
+            ++p;
+
+        uint64_t mantissa = 0;
+        uint32_t digits = 0;
+        int32_t exponent = 0;
+
+        const char* int_start = p;
+        while (p < end && (uint32_t)(*p - '0') < 10)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+            ++p;
+        }
+        if (p == int_start || digits > 15)
+            return false;
+
+        if (p < end && *p == '.')
+        {
+            const char* frac_start = ++p;
+            while (p < end && (uint32_t)(*p - '0') < 10)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                ++p;
+            }
+            if (p == frac_start || digits > 15)
+                return false;
+            exponent = -(int32_t)(p - frac_start);
+        }
+
+        if (p < end && (*p | 0x20) == 'e')
+        {
+            ++p;
+            bool exponent_negative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                exponent_negative = *p++ == '-';
+            const char* exp_start = p;
+            int32_t e = 0;
+            while (p < end && (uint32_t)(*p - '0') < 10 && e < 1000)
+                e = e * 10 + (*p++ - '0');
+            if (p == exp_start)
+                return false;
+            exponent += exponent_negative ? -e : e;
+        }
+
+        if (p != end || exponent < -22 || exponent > 22)
+            return false;
+
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / g_Pow10[-exponent] : value * g_Pow10[exponent];
+        *out = negative ? -value : value;
+        return true;
+    }
+
+    static bool PushScalar(lua_State* L, JsonDecoder* decoder, uint32_t pos, uint32_t next)
+    {
+        const char* json = decoder->m_Json;
+        char c = json[pos];
+        if (c == '"')
+            return PushString(L, decoder, pos, next);
+
+        uint32_t end = TokenEnd(decoder, pos, next);
+        uint32_t len = end - pos;
+        const char* s = json + pos;
+        if (c == 't' || c == 'f' || c == 'n')
+        {
+            if (len == 4 && memcmp(s, "true", 4) == 0)
+            {
+                lua_pushboolean(L, 1);
+                return true;
+            }
+            if (len == 5 && memcmp(s, "false", 5) == 0)
+            {
+                lua_pushboolean(L, 0);
+                return true;
+            }
+            if (len == 4 && memcmp(s, "null", 4) == 0)
+            {
+                // See lua_cjson.c, a table can't hold a nil value
+                lua_pushlightuserdata(L, NULL);
+                return true;
+            }
+            if (c != 'n')
+                return false;
+        }
+        else if (c != '-' && c != '+' && (uint32_t)(c - '0') >= 10 && (c | 0x20) != 'i' && (c | 0x20) != 'n')
+        {
+            return false;
+        }
+
+        double value;
+        if (!ParseNumberFast(s, json + end, &value))
+        {
+            // The same forms as lua-cjson (hex, inf, nan etc), and strtod() must consume the whole scalar
+            char buffer[64];
+            const char* number = s;
+            if (end == decoder->m_Length)
+            {
+                // Not followed by a delimiter
+                if (len >= sizeof(buffer))
+                    return false;
+                memcpy(buffer, s, len);
+                buffer[len] = 0;
+                number = buffer;
+            }
+            char* number_end;
+            value = fpconv_strtod(number, &number_end);
+            if (number_end != number + len)
+                return false;
+        }
+        lua_pushnumber(L, value);
+        return true;
+    }
+
+    static JsonDecodeResult DecodeFail(JsonDecoder* decoder)
+    {
+        decoder->m_State = JSON_DECODER_STATE_ERROR;
+        return JSON_DECODE_RESULT_ERROR;
+    }
+
+    // Stage 2: Builds the Lua values from the index. The open containers are kept on the Lua stack.
+    static JsonDecodeResult DecodeValues(lua_State* L, JsonDecoder* decoder, uint32_t max_values)
+    {
+        uint32_t state = decoder->m_State;
+        for (;;)
+        {
+            switch (state)
+            {
+            case JSON_DECODER_STATE_VALUE:
+                {
+                    uint32_t pos = CurrentToken(decoder);
+                    if (pos == decoder->m_Length)
+                        return DecodeFail(decoder);
+
+                    char c = decoder->m_Json[pos];
+                    if (c == '{' || c == '[')
+                    {
+                        if (decoder->m_Depth == JSON_MAX_DEPTH || !lua_checkstack(L, 3))
+                            return DecodeFail(decoder);
+                        ++decoder->m_IndexCursor;
+                        if (CurrentChar(decoder) == (c == '[' ? ']' : '}'))
+                        {
+                            lua_newtable(L);
+                            ++decoder->m_IndexCursor;
+                            state = JSON_DECODER_STATE_STORE;
+                            break;
+                        }
+
+                        JsonSizeHint* hint = &decoder->m_SizeHints[decoder->m_Depth];
+                        JsonFrame* frame = &decoder->m_Frames[decoder->m_Depth++];
+                        frame->m_Count = 0;
+                        frame->m_IsArray = c == '[';
+                        if (frame->m_IsArray)
+                            lua_createtable(L, hint->m_Array, 0);
+                        else
+                            lua_createtable(L, 0, hint->m_Object);
+
+                        if (decoder->m_StackIndex)
+                        {
+                            // Save the container, and its key in the parent object, so that the stack can be restored
+                            int slot = 2 * decoder->m_Depth;
+                            lua_pushvalue(L, -1);
+                            lua_rawseti(L, decoder->m_StackIndex, slot - 1);
+                            if (decoder->m_Depth > 1 && !decoder->m_Frames[decoder->m_Depth - 2].m_IsArray)
+                            {
+                                lua_pushvalue(L, -2);
+                                lua_rawseti(L, decoder->m_StackIndex, slot);
+                            }
+                        }
+                        state = frame->m_IsArray ? JSON_DECODER_STATE_VALUE : JSON_DECODER_STATE_KEY;
+                        break;
+                    }
+
+                    if (!PushScalar(L, decoder, pos, NextToken(decoder)))
+                        return DecodeFail(decoder);
+                    ++decoder->m_IndexCursor;
+                    state = JSON_DECODER_STATE_STORE;
+                }
+                break;
+
+            case JSON_DECODER_STATE_KEY:
+                {
+                    uint32_t pos = CurrentToken(decoder);
+                    if (pos == decoder->m_Length || decoder->m_Json[pos] != '"' || !PushString(L, decoder, pos, NextToken(decoder)))
+                        return DecodeFail(decoder);
+                    ++decoder->m_IndexCursor;
+                    if (CurrentChar(decoder) != ':')
+                        return DecodeFail(decoder);
+                    ++decoder->m_IndexCursor;
+                    state = JSON_DECODER_STATE_VALUE;
+                }
+                break;
+
+            case JSON_DECODER_STATE_STORE:
+                {
+                    if (decoder->m_Depth == 0)
+                    {
+                        // There must be nothing but whitespace after the root value
+                        if (CurrentToken(decoder) != decoder->m_Length)
+                            return DecodeFail(decoder);
+                        decoder->m_State = JSON_DECODER_STATE_DONE;
+                        return JSON_DECODE_RESULT_OK;
+                    }
+
+                    JsonFrame* frame = &decoder->m_Frames[decoder->m_Depth - 1];
+                    if (frame->m_IsArray)
+                        lua_rawseti(L, -2, ++frame->m_Count);
+                    else
+                    {
+                        lua_rawset(L, -3);
+                        ++frame->m_Count;
+                    }
+
+                    if (max_values && --max_values == 0)
+                    {
+                        decoder->m_State = JSON_DECODER_STATE_NEXT;
+                        return JSON_DECODE_RESULT_PENDING;
+                    }
+                }
+                // fall through
+
+            case JSON_DECODER_STATE_NEXT:
+                {
+                    JsonFrame* frame = &decoder->m_Frames[decoder->m_Depth - 1];
+                    char c = CurrentChar(decoder);
+                    ++decoder->m_IndexCursor;
+                    if (c == ',')
+                    {
+                        state = frame->m_IsArray ? JSON_DECODER_STATE_VALUE : JSON_DECODER_STATE_KEY;
+                    }
+                    else if (c == (frame->m_IsArray ? ']' : '}'))
+                    {
+                        // The container is now the value on top of the stack
+                        JsonSizeHint* hint = &decoder->m_SizeHints[--decoder->m_Depth];
+                        if (frame->m_IsArray)
+                            hint->m_Array = frame->m_Count;
+                        else
+                            hint->m_Object = frame->m_Count;
+                        state = JSON_DECODER_STATE_STORE;
+                    }
+                    else
+                    {
+                        return DecodeFail(decoder);
+                    }
+                }
+                break;
+
+            default:
+                return DecodeFail(decoder);
+            }
+        }
+    }
+
+    // Creates the decoder as a userdata on the stack, so that it's collected even if a Lua error is raised
+    static JsonDecoder* PushDecoder(lua_State* L, const char* json, size_t json_len)
+    {
+        if (json_len > JSON_MAX_LENGTH)
+            return 0;
+        // lua-cjson doesn't support UTF-16 or UTF-32
+        if (json_len >= 2 && (!json[0] || !json[1]))
+            return 0;
+
+        uint32_t length = (uint32_t)json_len;
+        uint32_t index_size = dmMath::Min(JSON_MAX_INDEX_SIZE, length + 2 * JSON_BLOCK_SIZE);
+        uint32_t max_depth = dmMath::Min(JSON_MAX_DEPTH, length);
+
+        size_t size = sizeof(JsonDecoder) + index_size * sizeof(uint32_t) + max_depth * (sizeof(JsonFrame) + sizeof(JsonSizeHint));
+        JsonDecoder* decoder = (JsonDecoder*)lua_newuserdata(L, size);
+        memset(decoder, 0, sizeof(JsonDecoder));
+        decoder->m_L = L;
+        decoder->m_Json = json;
+        decoder->m_Length = length;
+        decoder->m_Index = (uint32_t*)(decoder + 1);
+        decoder->m_IndexSize = index_size;
+        decoder->m_Frames = (JsonFrame*)(decoder->m_Index + index_size);
+        decoder->m_SizeHints = (JsonSizeHint*)(decoder->m_Frames + max_depth);
+        memset(decoder->m_SizeHints, 0, max_depth * sizeof(JsonSizeHint));
+        decoder->m_DecoderRef = LUA_NOREF;
+        decoder->m_StackRef = LUA_NOREF;
+        decoder->m_State = JSON_DECODER_STATE_VALUE;
+        return decoder;
+    }
+
+    bool DecodeJson(lua_State* L, const char* json, size_t json_len)
+    {
+        int top = lua_gettop(L);
+        JsonDecoder* decoder = PushDecoder(L, json, json_len);
+        if (!decoder)
+            return false;
+
+        if (DecodeValues(L, decoder, 0) != JSON_DECODE_RESULT_OK)
+        {
+            lua_settop(L, top);
+            return false;
+        }
+        lua_replace(L, top + 1);
+        return true;
+    }
+
+    HJsonDecoder NewJsonDecoder(lua_State* L, const char* json, size_t json_len)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+        JsonDecoder* decoder = PushDecoder(L, json, json_len);
+        if (!decoder)
+            return 0;
+        decoder->m_DecoderRef = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        lua_newtable(L);
+        decoder->m_StackRef = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        return decoder;
+    }
+
+    void DeleteJsonDecoder(HJsonDecoder decoder)
+    {
+        lua_State* L = decoder->m_L;
+        dmScript::Unref(L, LUA_REGISTRYINDEX, decoder->m_StackRef);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, decoder->m_DecoderRef);
+    }
+
+    JsonDecodeResult JsonDecoderStep(HJsonDecoder decoder, uint32_t max_values)
+    {
+        if (decoder->m_State == JSON_DECODER_STATE_DONE || decoder->m_State == JSON_DECODER_STATE_ERROR)
+            return JSON_DECODE_RESULT_ERROR;
+
+        lua_State* L = decoder->m_L;
+        int top = lua_gettop(L);
+        if (!lua_checkstack(L, 2 * decoder->m_Depth + 4))
+            return DecodeFail(decoder);
+
+        // Restore the open containers, and the keys of the objects holding them
+        lua_rawgeti(L, LUA_REGISTRYINDEX, decoder->m_StackRef);
+        decoder->m_StackIndex = top + 1;
+        for (uint32_t i = 1; i <= decoder->m_Depth; ++i)
+        {
+            if (i > 1 && !decoder->m_Frames[i - 2].m_IsArray)
+            {
+                lua_rawgeti(L, decoder->m_StackIndex, 2 * i);
+            }
+            lua_rawgeti(L, decoder->m_StackIndex, 2 * i - 1);
+        }
+
+        JsonDecodeResult result = DecodeValues(L, decoder, dmMath::Max(max_values, 1u));
+        if (result == JSON_DECODE_RESULT_OK)
+        {
+            lua_replace(L, top + 1);
+        }
+        else
+        {
+            lua_settop(L, top);
+        }
+        decoder->m_StackIndex = 0;
+        return result;
+    }
+
     int JsonToLua(lua_State* L, const char* json, size_t json_len)
     {
+        if (DecodeJson(L, json, json_len))
+            return 1;
+
+        // Either an error, or something the indexed decoder doesn't handle. Let lua-cjson decode it,
+        // which also gives us the correct error message
         int top = lua_gettop(L);
         int ret = lua_cjson_decode(L, json, json_len);
         if (ret != 1)
@@ -110,6 +973,247 @@ namespace dmScript
         return JsonToLua(L, json, json_len);
     }
 
+    /*
+     * json.decode_async()
+     *
+     * The requests of a context are decoded a number of values at a time in the context update, with the incremental
+     * decoder. Json that it can't decode (e.g. errors) is decoded at once by JsonToLua(), which gives the error message.
+     */
+
+    const uint32_t DEFAULT_JSON_VALUES_PER_FRAME = 10000;
+
+    struct JsonDecodeRequest
+    {
+        HJsonDecoder        m_Decoder;
+        LuaCallbackInfo*    m_Callback;
+        int                 m_JsonRef;      // Keeps the json string alive while it's decoded
+        int                 m_ValueRef;     // The decoded value, or the error message
+        uint32_t            m_ValuesPerFrame;
+        uint8_t             m_Done:1;
+        uint8_t             m_Result:1;
+    };
+
+    struct JsonDecodeQueue
+    {
+        dmArray<JsonDecodeRequest*> m_Requests;
+    };
+
+    static int JsonToLuaProtected(lua_State* L)
+    {
+        size_t json_len;
+        const char* json = lua_tolstring(L, 1, &json_len);
+        return JsonToLua(L, json, json_len);
+    }
+
+    // Decodes the next values of the request, and keeps the result once it's done
+    static void StepJsonDecodeRequest(lua_State* L, JsonDecodeRequest* request)
+    {
+        DM_PROFILE("JsonDecodeStep");
+        if (request->m_Decoder)
+        {
+            JsonDecodeResult result = JsonDecoderStep(request->m_Decoder, request->m_ValuesPerFrame);
+            if (result == JSON_DECODE_RESULT_PENDING)
+            {
+                return;
+            }
+            DeleteJsonDecoder(request->m_Decoder);
+            request->m_Decoder = 0;
+            if (result == JSON_DECODE_RESULT_OK)
+            {
+                request->m_ValueRef = dmScript::Ref(L, LUA_REGISTRYINDEX);
+                request->m_Result = 1;
+                request->m_Done = 1;
+                return;
+            }
+        }
+
+        lua_pushcfunction(L, JsonToLuaProtected);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, request->m_JsonRef);
+        request->m_Result = lua_pcall(L, 1, 1, 0) == 0;
+        request->m_ValueRef = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        request->m_Done = 1;
+    }
+
+    static void JsonDecodeCallbackArgsCB(lua_State* L, void* user_context)
+    {
+        JsonDecodeRequest* request = (JsonDecodeRequest*)user_context;
+        if (request->m_Result)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, request->m_ValueRef);
+            lua_pushnil(L);
+        }
+        else
+        {
+            lua_pushnil(L);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, request->m_ValueRef);
+        }
+    }
+
+    static void DeleteJsonDecodeRequest(lua_State* L, JsonDecodeRequest* request, bool invoke_callback)
+    {
+        if (request->m_Decoder)
+        {
+            DeleteJsonDecoder(request->m_Decoder);
+        }
+        if (request->m_Callback)
+        {
+            if (invoke_callback && IsCallbackValid(request->m_Callback))
+            {
+                InvokeCallback(request->m_Callback, JsonDecodeCallbackArgsCB, request);
+            }
+            if (IsCallbackValid(request->m_Callback))
+            {
+                DestroyCallback(request->m_Callback);
+            }
+        }
+        dmScript::Unref(L, LUA_REGISTRYINDEX, request->m_ValueRef);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, request->m_JsonRef);
+        delete request;
+    }
+
+    static void JsonDecodeInitialize(HContext context)
+    {
+        context->m_JsonDecodeQueue = new JsonDecodeQueue;
+    }
+
+    static void JsonDecodeUpdate(HContext context)
+    {
+        JsonDecodeQueue* queue = context->m_JsonDecodeQueue;
+        if (queue->m_Requests.Empty())
+        {
+            return;
+        }
+
+        DM_PROFILE("JsonDecode");
+        lua_State* L = GetLuaState(context);
+        DM_LUA_STACK_CHECK(L, 0);
+
+        // The callbacks may make new requests, which are decoded from the next update
+        dmArray<JsonDecodeRequest*> done;
+        uint32_t size = 0;
+        for (uint32_t i = 0; i < queue->m_Requests.Size(); ++i)
+        {
+            JsonDecodeRequest* request = queue->m_Requests[i];
+            StepJsonDecodeRequest(L, request);
+            if (request->m_Done)
+            {
+                if (done.Full())
+                {
+                    done.OffsetCapacity(8);
+                }
+                done.Push(request);
+            }
+            else
+            {
+                queue->m_Requests[size++] = request;
+            }
+        }
+        queue->m_Requests.SetSize(size);
+
+        for (uint32_t i = 0; i < done.Size(); ++i)
+        {
+            DeleteJsonDecodeRequest(L, done[i], true);
+        }
+    }
+
+    static void JsonDecodeFinalize(HContext context)
+    {
+        JsonDecodeQueue* queue = context->m_JsonDecodeQueue;
+        lua_State* L = GetLuaState(context);
+        // The scripts are already deleted, so there are no callbacks to invoke
+        for (uint32_t i = 0; i < queue->m_Requests.Size(); ++i)
+        {
+            DeleteJsonDecodeRequest(L, queue->m_Requests[i], false);
+        }
+        delete queue;
+        context->m_JsonDecodeQueue = 0x0;
+    }
+
+    /*# decode JSON from a string to a lua-table, over several frames
+     * Decode a string of JSON data into a Lua table, like <code>json.decode</code>, but without blocking.
+     * The data is decoded a number of values at a time each frame, and the callback is invoked
+     * with the result once it's done. Use this for large documents, to avoid a hitch.
+     * The callback is never invoked from within the call.
+     *
+     * @name json.decode_async
+     * @param json [type:string] json data
+     * @param callback [type:function(self, data, error)] function called when the data is decoded, or the decoding failed
+     *
+     * `self`
+     * : [type:object] The script instance
+     *
+     * `data`
+     * : [type:table] The decoded json, or `nil`
+     *
+     * `error`
+     * : [type:string] The syntax error, or `nil`
+     *
+     * @param [options] [type:table] optional table with request parameters. Supported entries:
+     *
+     * - [type:number] `values_per_frame`: the number of values to decode each frame. Default is 10000.
+     *
+     * @examples
+     *
+     * Decode a large json document without blocking the game:
+     *
+     * ```lua
+     * function init(self)
+     *     json.decode_async(large_json, function(self, data, error)
+     *         if error then
+     *             print(error)
+     *         else
+     *             self.level = data
+     *         end
+     *     end)
+     * end
+     * ```
+     */
+    static int Json_DecodeAsync(lua_State* L)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+
+        size_t json_len;
+        const char* json = luaL_checklstring(L, 1, &json_len);
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+
+        uint32_t values_per_frame = DEFAULT_JSON_VALUES_PER_FRAME;
+        if (lua_gettop(L) > 2 && !lua_isnil(L, 3))
+        {
+            luaL_checktype(L, 3, LUA_TTABLE);
+            lua_getfield(L, 3, "values_per_frame");
+            if (!lua_isnil(L, -1))
+            {
+                values_per_frame = (uint32_t) dmMath::Max((lua_Integer) 1, luaL_checkinteger(L, -1));
+            }
+            lua_pop(L, 1);
+        }
+
+        LuaCallbackInfo* callback = CreateCallback(L, 2);
+        if (callback == 0x0)
+        {
+            return DM_LUA_ERROR("json.decode_async callbacks are not available from this script-type.");
+        }
+
+        JsonDecodeRequest* request = new JsonDecodeRequest;
+        request->m_Callback = callback;
+        request->m_ValueRef = LUA_NOREF;
+        request->m_ValuesPerFrame = values_per_frame;
+        request->m_Done = 0;
+        request->m_Result = 0;
+        lua_pushvalue(L, 1);
+        request->m_JsonRef = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        // 0 if it has to be decoded at once
+        request->m_Decoder = NewJsonDecoder(L, json, json_len);
+
+        JsonDecodeQueue* queue = GetScriptContext(L)->m_JsonDecodeQueue;
+        if (queue->m_Requests.Full())
+        {
+            queue->m_Requests.OffsetCapacity(8);
+        }
+        queue->m_Requests.Push(request);
+        return 0;
+    }
+
     /*# encode a lua table to a JSON string
      * Encode a lua table to a JSON string.
      * A Lua error is raised for syntax errors.
@@ -172,6 +1276,7 @@ namespace dmScript
     static const luaL_reg ScriptJson_methods[] =
     {
         {"decode", Json_Decode},
+        {"decode_async", Json_DecodeAsync},
         {"encode", Json_Encode},
         {0, 0}
     };
@@ -191,4 +1296,19 @@ namespace dmScript
 
         assert(top == lua_gettop(L));
     }
+
+    void InitializeJsonDecode(HContext context)
+    {
+        static ScriptExtension sl;
+        sl.Initialize = JsonDecodeInitialize;
+        sl.Update = JsonDecodeUpdate;
+        sl.Finalize = JsonDecodeFinalize;
+        sl.NewScriptWorld = 0x0;
+        sl.DeleteScriptWorld = 0x0;
+        sl.UpdateScriptWorld = 0x0;
+        sl.FixedUpdateScriptWorld = 0x0;
+        sl.InitializeScriptInstance = 0x0;
+        sl.FinalizeScriptInstance = 0x0;
+        RegisterScriptExtension(context, &sl);
+    }
 }
@@ -15,6 +15,9 @@
 #ifndef DM_SCRIPT_JSON_H
 #define DM_SCRIPT_JSON_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 extern "C"
 {
 #include <lua/lua.h>
@@ -22,7 +25,34 @@ extern "C"
 
 namespace dmScript
 {
+    typedef struct Context* HContext;
+
     void InitializeJson(lua_State* L);
+    // Registers the extension updating the json.decode_async() requests
+    void InitializeJsonDecode(HContext context);
+
+    // Decodes the json and pushes the value. Returns false, leaving the stack untouched, if the json is
+    // invalid or if it needs lua-cjson to decode it. Used by JsonToLua()
+    bool DecodeJson(lua_State* L, const char* json, size_t json_len);
+
+    enum JsonDecodeResult
+    {
+        JSON_DECODE_RESULT_OK       = 0,
+        JSON_DECODE_RESULT_PENDING  = 1,
+        JSON_DECODE_RESULT_ERROR    = -1,
+    };
+
+    typedef struct JsonDecoder* HJsonDecoder;
+
+    // Incremental decoding, to spread the decoding of a large json document over several frames.
+    // The json data must stay valid until the decoder is deleted. Returns 0 if the json can't be decoded
+    // this way, in which case JsonToLua() should be used.
+    HJsonDecoder NewJsonDecoder(lua_State* L, const char* json, size_t json_len);
+    void DeleteJsonDecoder(HJsonDecoder decoder);
+
+    // Decodes at most max_values values. When the decoding is complete, the value is pushed and
+    // JSON_DECODE_RESULT_OK is returned. Nothing is pushed on error; use JsonToLua() to get the error message.
+    JsonDecodeResult JsonDecoderStep(HJsonDecoder decoder, uint32_t max_values);
 }
 
 #endif // DM_SCRIPT_JSON_H
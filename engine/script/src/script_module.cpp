@@ -17,13 +17,19 @@
 #include "script_private.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <dlib/array.h>
 #include <dlib/dstrings.h>
+#include <dlib/hash.h>
 #include <dlib/math.h>
 #include <dlib/message.h>
 #include <dlib/log.h>
 #include <dlib/path.h>
+#include <dlib/profile.h>
+#include <dlib/sys.h>
 
 #include <ddf/ddf.h>
 
@@ -38,29 +44,223 @@ extern "C"
 namespace dmScript
 {
 
+    // Written in front of the bytecode in the files of the bytecode cache
+    struct BytecodeCacheHeader
+    {
+        uint32_t m_Magic;
+        uint32_t m_Version;
+        uint64_t m_SourceHash;
+        uint32_t m_VMHash;          // See GetVMInfo()
+        uint32_t m_BytecodeSize;
+        uint32_t m_BytecodeHash;
+        uint32_t m_Padding;
+    };
+
+    static const uint32_t BYTECODE_CACHE_MAGIC = 0x434C4D44; // "DMLC"
+    static const uint32_t BYTECODE_CACHE_VERSION = 1;
+    // Enough to identify the Lua VM (and version) a chunk was dumped by
+    static const uint32_t BYTECODE_SIGNATURE_SIZE = 4;
+
+    struct VMInfo
+    {
+        // Start of the bytecode dumped by the running VM
+        char        m_Signature[BYTECODE_SIGNATURE_SIZE];
+        // Hash of an empty chunk dumped by the running VM, which depends on the VM version, format and
+        // the size of the basic types, together with the pointer width
+        uint32_t    m_Hash;
+        bool        m_Initialized;
+    };
+
+    static VMInfo g_VMInfo = {};
+
+    static int BytecodeWriter(lua_State* L, const void* p, size_t size, void* ud)
+    {
+        dmArray<uint8_t>* buffer = (dmArray<uint8_t>*) ud;
+        if (buffer->Remaining() < size)
+        {
+            buffer->OffsetCapacity(dmMath::Max((uint32_t) size, buffer->Capacity()));
+        }
+        buffer->PushArray((const uint8_t*) p, (uint32_t) size);
+        return 0;
+    }
+
+    static const VMInfo& GetVMInfo(lua_State* L)
+    {
+        if (!g_VMInfo.m_Initialized)
+        {
+            int top = lua_gettop(L);
+            (void) top;
+
+            dmArray<uint8_t> buffer;
+            int ret = luaL_loadbuffer(L, "", 0, "=?");
+            assert(ret == 0);
+            (void) ret;
+            lua_dump(L, BytecodeWriter, &buffer);
+            lua_pop(L, 1);
+            assert(top == lua_gettop(L));
+
+            assert(buffer.Size() >= BYTECODE_SIGNATURE_SIZE);
+            memcpy(g_VMInfo.m_Signature, buffer.Begin(), BYTECODE_SIGNATURE_SIZE);
+            HashState32 state;
+            dmHashInit32(&state, false);
+            dmHashUpdateBuffer32(&state, buffer.Begin(), buffer.Size());
+            uint32_t pointer_size = sizeof(void*);
+            dmHashUpdateBuffer32(&state, &pointer_size, sizeof(pointer_size));
+            g_VMInfo.m_Hash = dmHashFinal32(&state);
+            g_VMInfo.m_Initialized = true;
+        }
+        return g_VMInfo;
+    }
+
     // Helper function where the decision is made if to load bytecode or source code.
     //
     // Currently the bytecode is only ever built with LuaJIT which means it cannot be loaded
-    // with vanilla lua runtime. The LUA_BYTECODE_ENABLE_(32/62) indicates if we can load bytecode,
-    // and in reality, if linking happens against LuaJIT.
-    static void GetLuaSource(dmLuaDDF::LuaSource *source, const char **buf, uint32_t *size)
+    // with vanilla lua runtime. Bytecode from another VM than the running one is skipped in favour of the source.
+    static void GetLuaSource(lua_State* L, dmLuaDDF::LuaSource *source, const char **buf, uint32_t *size)
     {
         if (source->m_Bytecode.m_Count > 0)
         {
-            *buf = (const char*)source->m_Bytecode.m_Data;
-            *size = source->m_Bytecode.m_Count;
-            return;
+            bool compatible = source->m_Bytecode.m_Count >= BYTECODE_SIGNATURE_SIZE &&
+                              memcmp(source->m_Bytecode.m_Data, GetVMInfo(L).m_Signature, BYTECODE_SIGNATURE_SIZE) == 0;
+            if (compatible || source->m_Script.m_Count == 0)
+            {
+                *buf = (const char*)source->m_Bytecode.m_Data;
+                *size = source->m_Bytecode.m_Count;
+                return;
+            }
         }
         *buf = (const char*)source->m_Script.m_Data;
         *size = source->m_Script.m_Count;
     }
 
+    static bool IsBytecode(const char* buf, uint32_t size)
+    {
+        return size > 0 && buf[0] == LUA_SIGNATURE[0];
+    }
+
+    static void GetBytecodeCacheFilePath(HContext context, const char* filename, char* path, uint32_t path_size)
+    {
+        char name[32];
+        dmSnPrintf(name, sizeof(name), "%016llx.luac", (unsigned long long) dmHashString64(filename));
+        dmPath::Concat(context->m_BytecodeCachePath, name, path, path_size);
+    }
+
+    static bool LoadCachedBytecode(lua_State* L, const char* path, uint64_t source_hash, const char* filename)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        BytecodeCacheHeader header;
+        bool valid = fread(&header, 1, sizeof(header), file) == sizeof(header) &&
+                     header.m_Magic == BYTECODE_CACHE_MAGIC &&
+                     header.m_Version == BYTECODE_CACHE_VERSION &&
+                     header.m_SourceHash == source_hash &&
+                     header.m_VMHash == GetVMInfo(L).m_Hash;
+
+        char* bytecode = 0;
+        if (valid)
+        {
+            bytecode = (char*) malloc(header.m_BytecodeSize);
+            valid = fread(bytecode, 1, header.m_BytecodeSize, file) == header.m_BytecodeSize &&
+                    dmHashBuffer32(bytecode, header.m_BytecodeSize) == header.m_BytecodeHash;
+        }
+        fclose(file);
+
+        if (valid && luaL_loadbuffer(L, bytecode, header.m_BytecodeSize, filename) != 0)
+        {
+            dmLogWarning("Failed to load cached bytecode '%s' for '%s': %s", path, filename, lua_tostring(L, -1));
+            lua_pop(L, 1);
+            valid = false;
+        }
+        free(bytecode);
+        return valid;
+    }
+
+    static void WriteCachedBytecode(lua_State* L, const char* path, uint64_t source_hash)
+    {
+        dmArray<uint8_t> bytecode;
+        bytecode.SetCapacity(4096);
+        if (lua_dump(L, BytecodeWriter, &bytecode) != 0)
+        {
+            return;
+        }
+
+        BytecodeCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        header.m_Magic = BYTECODE_CACHE_MAGIC;
+        header.m_Version = BYTECODE_CACHE_VERSION;
+        header.m_SourceHash = source_hash;
+        header.m_VMHash = GetVMInfo(L).m_Hash;
+        header.m_BytecodeSize = bytecode.Size();
+        header.m_BytecodeHash = dmHashBuffer32(bytecode.Begin(), bytecode.Size());
+
+        // Written to a temporary file first, so that a cache file is either complete or missing
+        char tmp_path[DMPATH_MAX_PATH];
+        dmSnPrintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+        FILE* file = fopen(tmp_path, "wb");
+        if (!file)
+        {
+            return;
+        }
+        bool result = fwrite(&header, 1, sizeof(header), file) == sizeof(header);
+        result = result && fwrite(bytecode.Begin(), 1, bytecode.Size(), file) == bytecode.Size();
+        result = (fclose(file) == 0) && result;
+        if (!result || dmSys::Rename(path, tmp_path) != dmSys::RESULT_OK)
+        {
+            dmLogWarning("Failed to write the cached bytecode '%s'", path);
+            dmSys::Unlink(tmp_path);
+        }
+    }
+
+    // Same as luaL_loadbuffer, but source is compiled through the bytecode cache of the context, if enabled
+    static int LoadBuffer(lua_State* L, const char* buf, uint32_t size, const char* filename)
+    {
+        HContext context = GetScriptContext(L);
+        if (context == 0x0 || context->m_BytecodeCachePath == 0x0 || IsBytecode(buf, size))
+        {
+            return luaL_loadbuffer(L, buf, size, filename);
+        }
+
+        DM_PROFILE(__FUNCTION__);
+
+        char path[DMPATH_MAX_PATH];
+        GetBytecodeCacheFilePath(context, filename, path, sizeof(path));
+        uint64_t source_hash = dmHashBuffer64(buf, size);
+        if (LoadCachedBytecode(L, path, source_hash, filename))
+        {
+            return 0;
+        }
+
+        int ret = luaL_loadbuffer(L, buf, size, filename);
+        if (ret == 0)
+        {
+            WriteCachedBytecode(L, path, source_hash);
+        }
+        return ret;
+    }
+
     int LuaLoad(lua_State *L, dmLuaDDF::LuaSource *source)
     {
         const char *buf;
         uint32_t size;
-        GetLuaSource(source, &buf, &size);
-        return luaL_loadbuffer(L, buf, size, source->m_Filename);
+        GetLuaSource(L, source, &buf, &size);
+        int ret = LoadBuffer(L, buf, size, source->m_Filename);
+        if (ret != 0 && buf != (const char*) source->m_Script.m_Data && source->m_Script.m_Count > 0)
+        {
+            dmLogWarning("Failed to load the bytecode of '%s', loading the source instead: %s", source->m_Filename, lua_tostring(L, -1));
+            lua_pop(L, 1);
+            ret = LoadBuffer(L, (const char*) source->m_Script.m_Data, source->m_Script.m_Count, source->m_Filename);
+        }
+        return ret;
+    }
+
+    void SetBytecodeCachePath(HContext context, const char* path)
+    {
+        free(context->m_BytecodeCachePath);
+        context->m_BytecodeCachePath = path ? strdup(path) : 0x0;
     }
 
     static bool LuaLoadModule(lua_State *L, const char *buf, uint32_t size, const char *filename)
@@ -68,7 +268,7 @@ namespace dmScript
         int top = lua_gettop(L);
         (void) top;
 
-        int ret = luaL_loadbuffer(L, buf, size, filename);
+        int ret = LoadBuffer(L, buf, size, filename);
         if (ret == 0)
         {
             assert(top + 1 == lua_gettop(L));
@@ -121,7 +321,7 @@ namespace dmScript
 
         const char *buf;
         uint32_t size;
-        GetLuaSource(source, &buf, &size);
+        GetLuaSource(context->m_LuaState, source, &buf, &size);
 
         module.m_Script = (char*) malloc(size);
         module.m_ScriptSize = size;
@@ -158,7 +358,7 @@ namespace dmScript
 
         const char *buf;
         uint32_t size;
-        GetLuaSource(source, &buf, &size);
+        GetLuaSource(L, source, &buf, &size);
 
         module->m_Script = (char*) realloc(module->m_Script, size);
         module->m_ScriptSize = size;
@@ -21,6 +21,7 @@
 
 #include <dlib/dlib.h>
 #include <dlib/dstrings.h>
+#include <dlib/hash.h>
 #include <dlib/math.h>
 #include <dlib/message.h>
 
@@ -478,6 +479,13 @@ namespace dmScript
      * msg.post(my_url, "my_message", params)
      * ```
      */
+    static dmhash_t CheckMessageId(lua_State* L, int index);
+
+    static void DestroyMessageTable(dmMessage::Message* message)
+    {
+        ReleaseMessageTable(message->m_Data);
+    }
+
     int Msg_Post(lua_State* L)
     {
         int top = lua_gettop(L);
@@ -490,18 +498,11 @@ namespace dmScript
         dmMessage::URL sender;
         ResolveURL(L, 1, &receiver, &sender);
 
-        dmhash_t message_id;
-        if (lua_isstring(L, 2))
-        {
-            message_id = dmHashString64(lua_tostring(L, 2));
-        }
-        else
-        {
-            message_id = CheckHash(L, 2);
-        }
+        dmhash_t message_id = CheckMessageId(L, 2);
 
         char DM_ALIGNED(16) data[MAX_MESSAGE_DATA_SIZE];
         uint32_t data_size = 0;
+        dmMessage::MessageDestroyCallback destroy_callback = 0x0;
 
 
         const dmDDF::Descriptor* desc = dmDDF::GetDescriptorFromHash(message_id);
@@ -527,13 +528,27 @@ namespace dmScript
         {
             if (!lua_isnil(L, 3))
             {
-                data_size = dmScript::CheckTable(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                // A table posted to a component in the same collection is most likely received in this context,
+                // where it can be handed over instead of serialized
+                if (receiver.m_Socket == sender.m_Socket && receiver.m_Fragment != 0 && lua_istable(L, 3))
+                {
+                    data_size = CheckMessageTable(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                    destroy_callback = DestroyMessageTable;
+                }
+                else
+                {
+                    data_size = dmScript::CheckTable(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                }
             }
         }
 
         assert(top == lua_gettop(L));
 
-        dmMessage::Result result = dmMessage::Post(&sender, &receiver, message_id, 0, (uintptr_t) desc, data, data_size, 0);
+        dmMessage::Result result = dmMessage::Post(&sender, &receiver, message_id, 0, (uintptr_t) desc, data, data_size, destroy_callback);
+        if (result != dmMessage::RESULT_OK && destroy_callback != 0x0)
+        {
+            ReleaseMessageTable(data);
+        }
         if (result == dmMessage::RESULT_SOCKET_NOT_FOUND)
         {
             char receiver_buffer[64];
@@ -657,7 +672,7 @@ namespace dmScript
         return url->m_SocketSize > 0 && url->m_PathSize > 0 && *url->m_Path == '/';
     }
 
-    int ResolveURL(lua_State* L, int index, dmMessage::URL* out_url, dmMessage::URL* out_default_url)
+    static int ResolveURLUncached(lua_State* L, int index, dmMessage::URL* out_url, dmMessage::URL* out_default_url)
     {
         if (dmScript::IsURL(L, index))
         {
@@ -769,6 +784,158 @@ namespace dmScript
         return 0;
     }
 
+    void ClearURLCache(HContext context)
+    {
+        context->m_URLCache.Clear();
+        context->m_MessageIdCache.Clear();
+        if (context->m_URLCacheStringsRef != LUA_NOREF)
+        {
+            luaL_unref(context->m_LuaState, LUA_REGISTRYINDEX, context->m_URLCacheStringsRef);
+            context->m_URLCacheStringsRef = LUA_NOREF;
+        }
+        context->m_URLCacheSocketGeneration = dmMessage::GetSocketGeneration();
+    }
+
+    // Get the script context, with the cache cleared if sockets have been created or deleted since it was filled
+    static HContext GetURLCacheContext(lua_State* L)
+    {
+        HContext context = GetScriptContext(L);
+        if (context != 0x0 && context->m_URLCacheSocketGeneration != dmMessage::GetSocketGeneration())
+        {
+            ClearURLCache(context);
+        }
+        return context;
+    }
+
+    // Make room for one more entry and keep the string at index alive while it's cached,
+    // since the cache is keyed by the address of the string
+    static void RetainURLCacheString(lua_State* L, HContext context, int index)
+    {
+        if (context->m_URLCache.Full() || context->m_MessageIdCache.Full())
+        {
+            ClearURLCache(context);
+        }
+        if (context->m_URLCacheStringsRef == LUA_NOREF)
+        {
+            lua_newtable(L);
+            context->m_URLCacheStringsRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+        lua_rawgeti(L, LUA_REGISTRYINDEX, context->m_URLCacheStringsRef);
+        lua_pushvalue(L, index);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, -3);
+        lua_pop(L, 1);
+    }
+
+    static dmhash_t GetURLCacheKey(const char* url, const dmMessage::URL* default_url)
+    {
+        if (default_url == 0x0)
+        {
+            return (dmhash_t)(uintptr_t)url;
+        }
+        uint64_t key[4] = { (uint64_t)(uintptr_t)url, default_url->m_Socket, default_url->m_Path, default_url->m_Fragment };
+        return dmHashBufferNoReverse64(key, sizeof(key));
+    }
+
+    static bool IsSameURL(const dmMessage::URL& a, const dmMessage::URL& b)
+    {
+        return a.m_Socket == b.m_Socket && a.m_Path == b.m_Path && a.m_Fragment == b.m_Fragment;
+    }
+
+    int ResolveURL(lua_State* L, int index, dmMessage::URL* out_url, dmMessage::URL* out_default_url)
+    {
+        // Strings are interned by Lua, so the address identifies the URL. Global URLs are cached by address only,
+        // relative ones by address and the default URL they are resolved against.
+        HContext context = 0x0;
+        if (lua_type(L, index) == LUA_TSTRING)
+        {
+            context = GetURLCacheContext(L);
+        }
+        if (context == 0x0)
+        {
+            return ResolveURLUncached(L, index, out_url, out_default_url);
+        }
+
+        if (index < 0)
+        {
+            index = lua_gettop(L) + index + 1;
+        }
+        const char* url = lua_tostring(L, index);
+
+        ResolvedURL* entry = context->m_URLCache.Get(GetURLCacheKey(url, 0x0));
+        if (entry != 0x0 && entry->m_Global && entry->m_String == url)
+        {
+            *out_url = entry->m_URL;
+            if (out_default_url != 0x0)
+            {
+                dmMessage::ResetURL(out_default_url);
+                GetURL(L, out_default_url);
+            }
+            return 0;
+        }
+
+        dmMessage::URL default_url;
+        dmMessage::ResetURL(&default_url);
+        GetURL(L, &default_url);
+        dmhash_t key = GetURLCacheKey(url, &default_url);
+        entry = context->m_URLCache.Get(key);
+        if (entry != 0x0 && !entry->m_Global && entry->m_String == url && IsSameURL(entry->m_DefaultURL, default_url))
+        {
+            *out_url = entry->m_URL;
+            if (out_default_url != 0x0)
+            {
+                *out_default_url = default_url;
+            }
+            return 0;
+        }
+
+        int result = ResolveURLUncached(L, index, out_url, out_default_url);
+        if (result != 0)
+        {
+            return result;
+        }
+
+        dmMessage::StringURL string_url;
+        dmMessage::ParseURL(url, &string_url);
+        ResolvedURL resolved;
+        resolved.m_String = url;
+        resolved.m_DefaultURL = default_url;
+        resolved.m_URL = *out_url;
+        resolved.m_Global = IsURLGlobal(&string_url);
+        RetainURLCacheString(L, context, index);
+        context->m_URLCache.Put(resolved.m_Global ? GetURLCacheKey(url, 0x0) : key, resolved);
+        return 0;
+    }
+
+    static dmhash_t CheckMessageId(lua_State* L, int index)
+    {
+        if (lua_type(L, index) != LUA_TSTRING)
+        {
+            if (lua_isstring(L, index))
+            {
+                return dmHashString64(lua_tostring(L, index));
+            }
+            return CheckHash(L, index);
+        }
+
+        const char* name = lua_tostring(L, index);
+        HContext context = GetURLCacheContext(L);
+        if (context == 0x0)
+        {
+            return dmHashString64(name);
+        }
+        dmhash_t key = GetURLCacheKey(name, 0x0);
+        dmhash_t* cached_id = context->m_MessageIdCache.Get(key);
+        if (cached_id != 0x0)
+        {
+            return *cached_id;
+        }
+        dmhash_t message_id = dmHashString64(name);
+        RetainURLCacheString(L, context, index);
+        context->m_MessageIdCache.Put(key, message_id);
+        return message_id;
+    }
+
 #undef SCRIPT_LIB_NAME
 #undef SCRIPT_TYPE_NAME_URL
 }
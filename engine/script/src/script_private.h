@@ -16,6 +16,7 @@
 #define SCRIPT_PRIVATE_H
 
 #include <dlib/hashtable.h>
+#include <dlib/memory.h>
 
 #define SCRIPT_MAIN_THREAD "__script_main_thread"
 #define SCRIPT_ERROR_HANDLER_VAR "__error_handler"
@@ -66,6 +67,32 @@ namespace dmScript
     };
 
     typedef struct ScriptExtension* HScriptExtension;
+    typedef struct LuaAllocator* HLuaAllocator;
+
+    const uint32_t URL_CACHE_TABLE_SIZE = 347;
+    const uint32_t URL_CACHE_CAPACITY = 512;
+
+    /*
+     * A string URL resolved by ResolveURL. Relative URLs are only valid for the default URL they were resolved against.
+     */
+    struct ResolvedURL
+    {
+        // Lua string the URL was resolved from, kept alive by the cache strings table
+        const char*                 m_String;
+        dmMessage::URL              m_DefaultURL;
+        dmMessage::URL              m_URL;
+        uint8_t                     m_Global:1;
+    };
+
+    /*
+     * The script context of tables posted by reference, see CheckMessageTable().
+     * Referenced by the context and each message, m_Context is cleared when the context is deleted.
+     */
+    struct MessageTableOwner
+    {
+        HContext                    m_Context;
+        uint32_t                    m_RefCount;
+    };
 
     struct Context
     {
@@ -76,7 +103,25 @@ namespace dmScript
         dmHashTable64<int>          m_HashInstances;
         dmArray<HScriptExtension>   m_ScriptExtensions;
         lua_State*                  m_LuaState;
+        HLuaAllocator               m_LuaAllocator;
+        dmMemory::HTag              m_MemoryTag;
+        // The Lua memory last reported to m_MemoryTag, updated once per frame to keep the allocator fast
+        uint32_t                    m_ReportedLuaBytes;
         int                         m_ContextTableRef;
+        // Resolved string URLs and message ids, keyed by the address of the interned Lua string
+        // Cleared when full and when sockets are created or deleted, see ClearURLCache()
+        dmHashTable64<ResolvedURL>  m_URLCache;
+        dmHashTable64<dmhash_t>     m_MessageIdCache;
+        // Table holding the cached strings, so that their addresses are not reused while cached
+        int                         m_URLCacheStringsRef;
+        uint32_t                    m_URLCacheSocketGeneration;
+        MessageTableOwner*          m_MessageTableOwner;
+        // Pending sys.save_async() requests, see script_sys.cpp
+        struct SysSaveQueue*        m_SysSaveQueue;
+        // Pending json.decode_async() requests, see script_json.cpp
+        struct JsonDecodeQueue*     m_JsonDecodeQueue;
+        // Directory of the bytecode cache, see SetBytecodeCachePath()
+        char*                       m_BytecodeCachePath;
         bool                        m_EnableExtensions;
     };
 
@@ -93,6 +138,68 @@ namespace dmScript
      * @param context script context
      */
     void ClearModules(HContext context);
+
+    /**
+     * Remove all resolved URLs and message ids.
+     * @param context script context
+     */
+    void ClearURLCache(HContext context);
+
+    /**
+     * Copy the table at index and store a reference to the copy in buffer, instead of serializing the table.
+     * The message must be posted with a destroy callback calling ReleaseMessageTable() and dispatched on the main thread.
+     * PushTable() hands over the copy to a receiver in the same context, and copies it to receivers in other contexts.
+     * @param L lua state
+     * @param buffer message data buffer
+     * @param buffer_size buffer size
+     * @param index index of the table
+     * @return number of bytes used in buffer
+     */
+    uint32_t CheckMessageTable(lua_State* L, char* buffer, uint32_t buffer_size, int index);
+
+    /**
+     * Release the table referenced by message data from CheckMessageTable().
+     * @param data message data
+     */
+    void ReleaseMessageTable(void* data);
+
+    void ReleaseMessageTableOwner(MessageTableOwner* owner);
+
+    /*
+     * A table serialized over several calls to StepCheckTable(), in the same format as CheckTable()
+     */
+    struct CheckTableState
+    {
+        dmArray<char>               m_Buffer;
+        int                         m_TableRef;
+        int                         m_KeyRef;
+        uint32_t                    m_Count;
+    };
+
+    /**
+     * Start serializing the table at index. The table is referenced until EndCheckTable() is called.
+     * @param L lua state
+     * @param index index of the table
+     * @param state [out] the serialization state
+     */
+    void BeginCheckTable(lua_State* L, int index, CheckTableState* state);
+
+    /**
+     * Serialize the next entries of the table, until at least max_size bytes are written or the table is done.
+     * Subtables are written in full. As with CheckTable(), a lua error is raised if the table can't be serialized.
+     * @param L lua state
+     * @param state the serialization state
+     * @param max_size number of bytes to write in this step
+     * @return true when the whole table is serialized into state->m_Buffer
+     */
+    bool StepCheckTable(lua_State* L, CheckTableState* state, uint32_t max_size);
+
+    /**
+     * Release the references of the serialization state. The buffer is kept.
+     * @param L lua state
+     * @param state the serialization state
+     */
+    void EndCheckTable(lua_State* L, CheckTableState* state);
 }
 
 #endif // SCRIPT_PRIVATE_H
@@ -40,6 +40,9 @@
 #include <dlib/path.h>
 #include <dlib/align.h>
 #include <dlib/memory.h>
+#include <dlib/math.h>
+#include <dlib/lz4.h>
+#include <dlib/profile.h>
 #include <resource/resource.h>
 #include "script.h"
 #include "script/sys_ddf.h"
@@ -53,6 +56,22 @@ extern "C"
 
 #include "script_private.h"
 
+#if !defined(__EMSCRIPTEN__)
+    #define DM_HAS_THREADS
+#endif
+
+#if defined(DM_USE_SINGLE_THREAD)
+    #if defined(DM_HAS_THREADS)
+        #undef DM_HAS_THREADS
+    #endif
+#endif
+
+#if defined(DM_HAS_THREADS)
+    #include <dmsdk/dlib/condition_variable.h>
+    #include <dmsdk/dlib/mutex.h>
+    #include <dmsdk/dlib/thread.h>
+#endif
+
 namespace dmScript
 {
 
@@ -60,6 +79,10 @@ const uint32_t MAX_BUFFER_SIZE = 512 * 1024;
 
 static int g_DebuggerLightweightHook = 0;
 
+// The counter and hash are there to make the files unique enough to avoid that the user
+// accidentally writes to it.
+static int g_SaveCounter = 0;
+
 union SaveLoadBuffer
 {
     uint32_t m_alignment; // This alignment is required for js-web
@@ -146,11 +169,8 @@ union SaveLoadBuffer
 #if !defined(__EMSCRIPTEN__)
 
         char tmp_filename[DMPATH_MAX_PATH];
-        // The counter and hash are there to make the files unique enough to avoid that the user
-        // accidentally writes to it.
-        static int save_counter = 0;
         uint32_t hash = dmHashString32(filename);
-        int res = dmSnPrintf(tmp_filename, sizeof(tmp_filename), "%s.defoldtmp_%x_%d", filename, hash, save_counter++);
+        int res = dmSnPrintf(tmp_filename, sizeof(tmp_filename), "%s.defoldtmp_%x_%d", filename, hash, g_SaveCounter++);
         if (res == -1)
         {
             Sys_FreeTableSerializationBuffer(buffer);
@@ -213,6 +233,607 @@ union SaveLoadBuffer
     }
 
 
+    /*
+     * sys.save_async()
+     *
+     * The table is serialized on the main thread when the function is called, or over several frames
+     * in chunked mode. Compression and file I/O is done on a worker thread shared by all script contexts.
+     * The requests of a context are written in the order they were made, and the callbacks are invoked
+     * from the context update.
+     */
+
+    // Prefix of compressed save files, followed by the uncompressed size and the LZ4 data
+    const uint32_t SAVE_LZ4_MAGIC = 0x345a4c44; // "DLZ4"
+    const uint32_t DEFAULT_SAVE_CHUNK_SIZE = 128 * 1024;
+
+    struct CompressedSaveHeader
+    {
+        uint32_t m_Magic;
+        uint32_t m_Size;
+    };
+
+    enum SaveStatus
+    {
+        SAVE_STATUS_SERIALIZING,
+        SAVE_STATUS_READY,
+        SAVE_STATUS_WRITING,
+        SAVE_STATUS_DONE,
+    };
+
+    struct SaveRequest
+    {
+        CheckTableState     m_Table;    // Chunked mode
+        char*               m_Data;     // The table serialized at once, or 0 in chunked mode
+        uint32_t            m_DataSize;
+        char                m_Filename[DMPATH_MAX_PATH];
+        char                m_TmpFilename[DMPATH_MAX_PATH];
+        char                m_Error[256];
+        LuaCallbackInfo*    m_Callback;
+        uint32_t            m_ChunkSize;
+        // Accessed by the worker thread, protected by the worker mutex
+        SaveStatus          m_Status;
+        uint8_t             m_Compress:1;
+        uint8_t             m_Result:1;
+    };
+
+    struct SysSaveQueue
+    {
+        dmArray<SaveRequest*> m_Requests;
+        // The requests before this index have been handed to the worker, the others are only accessed by the main thread
+        uint32_t              m_SubmittedCount;
+    };
+
+    struct SaveWorker
+    {
+#if defined(DM_HAS_THREADS)
+        dmThread::Thread                        m_Thread;
+        dmMutex::HMutex                         m_Mutex;
+        // Signalled when work is added, and when the worker is stopped
+        dmConditionVariable::HConditionVariable m_WorkCond;
+        // Broadcast when a request is written
+        dmConditionVariable::HConditionVariable m_DoneCond;
+        bool                                    m_Run;
+#endif
+        dmArray<SaveRequest*>                   m_Work;
+        // Number of script contexts using the worker, the thread is started on the first write
+        uint32_t                                m_RefCount;
+    };
+
+    static SaveWorker g_SaveWorker;
+
+    static bool WriteSaveFile(const char* filename, const char* data, uint32_t data_size, const CompressedSaveHeader* header)
+    {
+        FILE* file = fopen(filename, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool result = true;
+        if (header)
+        {
+            result = fwrite(header, 1, sizeof(*header), file) == sizeof(*header);
+        }
+        result = result && fwrite(data, 1, data_size, file) == data_size;
+        result = (fclose(file) == 0) && result;
+        return result;
+    }
+
+    // Called on the worker thread
+    static void WriteSaveRequest(SaveRequest* request)
+    {
+        DM_PROFILE("SysSaveWrite");
+
+        const char* data = request->m_Data;
+        uint32_t data_size = request->m_DataSize;
+        if (!data)
+        {
+            data = request->m_Table.m_Buffer.Begin();
+            data_size = request->m_Table.m_Buffer.Size();
+        }
+
+        char* compressed = 0;
+        CompressedSaveHeader header;
+        if (request->m_Compress)
+        {
+            int max_size = 0;
+            int compressed_size = 0;
+            if (dmLZ4::MaxCompressedSize(data_size, &max_size) == dmLZ4::RESULT_OK)
+            {
+                compressed = (char*)malloc(max_size);
+            }
+            if (!compressed || dmLZ4::CompressBuffer(data, data_size, compressed, &compressed_size) != dmLZ4::RESULT_OK)
+            {
+                free(compressed);
+                request->m_Result = 0;
+                dmSnPrintf(request->m_Error, sizeof(request->m_Error), "Could not compress the table for the file %s.", request->m_Filename);
+                return;
+            }
+            header.m_Magic = SAVE_LZ4_MAGIC;
+            header.m_Size = data_size;
+            data = compressed;
+            data_size = (uint32_t)compressed_size;
+        }
+        const CompressedSaveHeader* file_header = compressed ? &header : 0;
+
+#if !defined(__EMSCRIPTEN__)
+        // The file is replaced only when the new data is completely written
+        bool result = WriteSaveFile(request->m_TmpFilename, data, data_size, file_header);
+        if (!result)
+        {
+            dmSys::Unlink(request->m_TmpFilename);
+            dmSnPrintf(request->m_Error, sizeof(request->m_Error), "Could not write to the file %s.", request->m_Filename);
+        }
+        else if (dmSys::Rename(request->m_Filename, request->m_TmpFilename) != dmSys::RESULT_OK)
+        {
+            dmSys::Unlink(request->m_TmpFilename);
+            dmSnPrintf(request->m_Error, sizeof(request->m_Error), "Could not rename %s to the file %s.", request->m_TmpFilename, request->m_Filename);
+            result = false;
+        }
+#else
+        bool result = WriteSaveFile(request->m_Filename, data, data_size, file_header);
+        if (!result)
+        {
+            dmSys::Unlink(request->m_Filename);
+            dmSnPrintf(request->m_Error, sizeof(request->m_Error), "Could not write to the file %s.", request->m_Filename);
+        }
+#endif
+        free(compressed);
+        request->m_Result = result;
+    }
+
+#if defined(DM_HAS_THREADS)
+    static void SaveWorkerThread(void* _worker)
+    {
+        SaveWorker* worker = (SaveWorker*)_worker;
+        DM_MUTEX_SCOPED_LOCK(worker->m_Mutex);
+        while (worker->m_Run)
+        {
+            if (worker->m_Work.Empty())
+            {
+                dmConditionVariable::Wait(worker->m_WorkCond, worker->m_Mutex);
+                continue;
+            }
+
+            dmArray<SaveRequest*> work;
+            work.Swap(worker->m_Work);
+
+            for (uint32_t i = 0; i < work.Size(); ++i)
+            {
+                dmMutex::Unlock(worker->m_Mutex);
+                WriteSaveRequest(work[i]);
+                dmMutex::Lock(worker->m_Mutex);
+
+                work[i]->m_Status = SAVE_STATUS_DONE;
+                dmConditionVariable::Broadcast(worker->m_DoneCond);
+            }
+        }
+    }
+#endif
+
+    static void SubmitSaveRequest(SaveRequest* request)
+    {
+        request->m_Status = SAVE_STATUS_WRITING;
+#if defined(DM_HAS_THREADS)
+        if (g_SaveWorker.m_Thread == 0)
+        {
+            g_SaveWorker.m_Run = true;
+            g_SaveWorker.m_Thread = dmThread::New(SaveWorkerThread, 0x80000, &g_SaveWorker, "syssave");
+        }
+        if (g_SaveWorker.m_Work.Full())
+        {
+            g_SaveWorker.m_Work.OffsetCapacity(8);
+        }
+        g_SaveWorker.m_Work.Push(request);
+        dmConditionVariable::Signal(g_SaveWorker.m_WorkCond);
+#else
+        WriteSaveRequest(request);
+        request->m_Status = SAVE_STATUS_DONE;
+#endif
+    }
+
+    struct SaveStep
+    {
+        SaveRequest*    m_Request;
+        uint32_t        m_MaxSize;
+    };
+
+    static int StepSaveRequestProtected(lua_State* L)
+    {
+        SaveStep* step = (SaveStep*)lua_touserdata(L, 1);
+        lua_pop(L, 1);
+        if (StepCheckTable(L, &step->m_Request->m_Table, step->m_MaxSize))
+        {
+            step->m_Request->m_Status = SAVE_STATUS_READY;
+        }
+        return 0;
+    }
+
+    // Returns false, with the error message on the stack, if the table can't be serialized
+    static bool StepSaveRequest(lua_State* L, SaveRequest* request, uint32_t max_size)
+    {
+        DM_PROFILE("SysSaveSerialize");
+        SaveStep step = { request, max_size };
+        bool result = lua_cpcall(L, StepSaveRequestProtected, &step) == 0;
+        if (!result)
+        {
+            dmSnPrintf(request->m_Error, sizeof(request->m_Error), "Could not save the file %s: %s", request->m_Filename, lua_tostring(L, -1));
+            request->m_Result = 0;
+            request->m_Status = SAVE_STATUS_DONE;
+        }
+        if (request->m_Status != SAVE_STATUS_SERIALIZING)
+        {
+            EndCheckTable(L, &request->m_Table);
+        }
+        return result;
+    }
+
+    // Serializes the table at the top of the stack into an exactly sized buffer. Called with lua_pcall, as a lua error is raised if the table can't be serialized
+    static int SerializeSaveRequestProtected(lua_State* L)
+    {
+        SaveRequest* request = (SaveRequest*)lua_touserdata(L, 1);
+        uint32_t table_size = CheckTableSize(L, 2);
+        if (dmMemory::AlignedMalloc((void**)&request->m_Data, 16, table_size) != dmMemory::RESULT_OK)
+        {
+            request->m_Data = 0;
+            return luaL_error(L, "Could not allocate %d bytes for table serialization.", table_size);
+        }
+        request->m_DataSize = CheckTable(L, request->m_Data, table_size, 2);
+        request->m_Status = SAVE_STATUS_READY;
+        return 0;
+    }
+
+    static void SaveCallbackArgsCB(lua_State* L, void* user_context)
+    {
+        SaveRequest* request = (SaveRequest*)user_context;
+        lua_pushstring(L, request->m_Filename);
+        lua_pushboolean(L, request->m_Result);
+        if (request->m_Result)
+        {
+            lua_pushnil(L);
+        }
+        else
+        {
+            lua_pushstring(L, request->m_Error);
+        }
+    }
+
+    static void DeleteSaveRequest(lua_State* L, SaveRequest* request, bool invoke_callback)
+    {
+        if (!request->m_Result)
+        {
+            dmLogError("%s", request->m_Error);
+        }
+        if (request->m_Callback)
+        {
+            if (invoke_callback && IsCallbackValid(request->m_Callback))
+            {
+                InvokeCallback(request->m_Callback, SaveCallbackArgsCB, request);
+            }
+            if (IsCallbackValid(request->m_Callback))
+            {
+                DestroyCallback(request->m_Callback);
+            }
+        }
+        EndCheckTable(L, &request->m_Table);
+        if (request->m_Data)
+        {
+            dmMemory::AlignedFree(request->m_Data);
+        }
+        delete request;
+    }
+
+    // Serialize the next chunk of the chunked requests. The worker mutex isn't needed, since the requests aren't submitted yet
+    static void SerializeSaveRequests(lua_State* L, SysSaveQueue* queue, uint32_t max_size)
+    {
+        for (uint32_t i = queue->m_SubmittedCount; i < queue->m_Requests.Size(); ++i)
+        {
+            SaveRequest* request = queue->m_Requests[i];
+            if (request->m_Status == SAVE_STATUS_SERIALIZING)
+            {
+                if (!StepSaveRequest(L, request, max_size ? max_size : request->m_ChunkSize))
+                {
+                    lua_pop(L, 1);
+                }
+            }
+        }
+    }
+
+    // Submit the serialized requests in order. Called with the worker mutex held
+    static void SubmitSaveRequests(SysSaveQueue* queue)
+    {
+        while (queue->m_SubmittedCount < queue->m_Requests.Size())
+        {
+            SaveRequest* request = queue->m_Requests[queue->m_SubmittedCount];
+            if (request->m_Status == SAVE_STATUS_SERIALIZING)
+            {
+                break;
+            }
+            else if (request->m_Status == SAVE_STATUS_READY)
+            {
+                SubmitSaveRequest(request);
+            }
+            queue->m_SubmittedCount++;
+        }
+    }
+
+    static void SysSaveInitialize(HContext context)
+    {
+        context->m_SysSaveQueue = new SysSaveQueue;
+        context->m_SysSaveQueue->m_SubmittedCount = 0;
+        if (g_SaveWorker.m_RefCount++ == 0)
+        {
+#if defined(DM_HAS_THREADS)
+            g_SaveWorker.m_Thread = 0;
+            g_SaveWorker.m_Mutex = dmMutex::New();
+            g_SaveWorker.m_WorkCond = dmConditionVariable::New();
+            g_SaveWorker.m_DoneCond = dmConditionVariable::New();
+#endif
+        }
+    }
+
+    static void SysSaveUpdate(HContext context)
+    {
+        SysSaveQueue* queue = context->m_SysSaveQueue;
+        if (queue->m_Requests.Empty())
+        {
+            return;
+        }
+
+        DM_PROFILE("SysSave");
+        lua_State* L = GetLuaState(context);
+
+        SerializeSaveRequests(L, queue, 0);
+
+        dmArray<SaveRequest*> done;
+        {
+#if defined(DM_HAS_THREADS)
+            DM_MUTEX_SCOPED_LOCK(g_SaveWorker.m_Mutex);
+#endif
+            SubmitSaveRequests(queue);
+
+            uint32_t size = 0;
+            uint32_t submitted_count = 0;
+            for (uint32_t i = 0; i < queue->m_Requests.Size(); ++i)
+            {
+                SaveRequest* request = queue->m_Requests[i];
+                if (request->m_Status == SAVE_STATUS_DONE)
+                {
+                    if (done.Full())
+                    {
+                        done.OffsetCapacity(8);
+                    }
+                    done.Push(request);
+                }
+                else
+                {
+                    if (i < queue->m_SubmittedCount)
+                    {
+                        submitted_count++;
+                    }
+                    queue->m_Requests[size++] = request;
+                }
+            }
+            queue->m_Requests.SetSize(size);
+            queue->m_SubmittedCount = submitted_count;
+        }
+
+        // The callbacks may make new requests
+        for (uint32_t i = 0; i < done.Size(); ++i)
+        {
+            DeleteSaveRequest(L, done[i], true);
+        }
+    }
+
+    static void SysSaveFinalize(HContext context)
+    {
+        SysSaveQueue* queue = context->m_SysSaveQueue;
+        lua_State* L = GetLuaState(context);
+
+        // Complete the pending requests, the scripts are already deleted so there are no callbacks to invoke
+        SerializeSaveRequests(L, queue, 0xffffffff);
+        {
+#if defined(DM_HAS_THREADS)
+            DM_MUTEX_SCOPED_LOCK(g_SaveWorker.m_Mutex);
+#endif
+            SubmitSaveRequests(queue);
+#if defined(DM_HAS_THREADS)
+            for (uint32_t i = 0; i < queue->m_Requests.Size(); ++i)
+            {
+                while (queue->m_Requests[i]->m_Status == SAVE_STATUS_WRITING)
+                {
+                    dmConditionVariable::Wait(g_SaveWorker.m_DoneCond, g_SaveWorker.m_Mutex);
+                }
+            }
+#endif
+        }
+        for (uint32_t i = 0; i < queue->m_Requests.Size(); ++i)
+        {
+            DeleteSaveRequest(L, queue->m_Requests[i], false);
+        }
+        delete queue;
+        context->m_SysSaveQueue = 0x0;
+
+        assert(g_SaveWorker.m_RefCount > 0);
+        if (--g_SaveWorker.m_RefCount == 0)
+        {
+#if defined(DM_HAS_THREADS)
+            if (g_SaveWorker.m_Thread)
+            {
+                {
+                    DM_MUTEX_SCOPED_LOCK(g_SaveWorker.m_Mutex);
+                    g_SaveWorker.m_Run = false;
+                    dmConditionVariable::Signal(g_SaveWorker.m_WorkCond);
+                }
+                dmThread::Join(g_SaveWorker.m_Thread);
+                g_SaveWorker.m_Thread = 0;
+            }
+            dmConditionVariable::Delete(g_SaveWorker.m_DoneCond);
+            dmConditionVariable::Delete(g_SaveWorker.m_WorkCond);
+            dmMutex::Delete(g_SaveWorker.m_Mutex);
+#endif
+        }
+    }
+
+    /*# saves a lua table to a file stored on disk, without blocking
+     * Saves a table like <code>sys.save</code>, but writes the file on a background thread.
+     * The table is serialized when the function is called, changes made to it afterwards are not saved.
+     * As with <code>sys.save</code>, the file is only replaced once the new data is completely written,
+     * and requests are written in the order they are made.
+     *
+     * With the `chunked` option the table is instead serialized over several frames, to avoid a hitch when saving
+     * very large tables. Only the entries of the table itself are copied when the function is called, changes made
+     * to its subtables before the callback is invoked may or may not be saved.
+     *
+     * There is no size limit for the table.
+     *
+     * [icon:html5] On HTML5 the file is written when the function is called.
+     *
+     * @name sys.save_async
+     * @param filename [type:string] file to write to
+     * @param table [type:table] lua table to save
+     * @param [callback] [type:function(self, filename, success, error)] function called when the file is written, or the save failed
+     *
+     * `self`
+     * : [type:object] The script instance
+     *
+     * `filename`
+     * : [type:string] The file that was written
+     *
+     * `success`
+     * : [type:boolean] If the table was saved
+     *
+     * `error`
+     * : [type:string] The reason the table couldn't be saved, or `nil`
+     *
+     * @param [options] [type:table] optional table with request parameters. Supported entries:
+     *
+     * - [type:boolean] `compress`: compress the file with LZ4. Compressed files are loaded by <code>sys.load</code> as usual. Default is false.
+     * - [type:boolean] `chunked`: serialize the table over several frames. Default is false.
+     * - [type:number] `chunk_size`: the number of bytes to serialize each frame in chunked mode. Default is 131072.
+     *
+     * @examples
+     *
+     * Save data without blocking the game:
+     *
+     * ```lua
+     * local my_file_path = sys.get_save_file("my_game", "my_file")
+     * sys.save_async(my_file_path, my_table, function(self, filename, success, error)
+     *     if not success then
+     *         print(error)
+     *     end
+     * end, { compress = true })
+     * ```
+     */
+    static int Sys_SaveAsync(lua_State* L)
+    {
+        const char* filename = luaL_checkstring(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        int top = lua_gettop(L);
+        if (top > 2 && !lua_isnil(L, 3))
+        {
+            luaL_checktype(L, 3, LUA_TFUNCTION);
+        }
+
+        bool compress = false;
+        bool chunked = false;
+        uint32_t chunk_size = DEFAULT_SAVE_CHUNK_SIZE;
+        if (top > 3 && !lua_isnil(L, 4))
+        {
+            luaL_checktype(L, 4, LUA_TTABLE);
+            lua_getfield(L, 4, "compress");
+            compress = lua_toboolean(L, -1);
+            lua_getfield(L, 4, "chunked");
+            chunked = lua_toboolean(L, -1);
+            lua_getfield(L, 4, "chunk_size");
+            if (!lua_isnil(L, -1))
+            {
+                chunk_size = (uint32_t) dmMath::Max((lua_Integer) 1, luaL_checkinteger(L, -1));
+            }
+            lua_pop(L, 3);
+        }
+
+        SysSaveQueue* queue = GetScriptContext(L)->m_SysSaveQueue;
+        SaveRequest* request = new SaveRequest;
+        request->m_Table.m_TableRef = LUA_NOREF;
+        request->m_Table.m_KeyRef = LUA_NOREF;
+        request->m_Data = 0;
+        request->m_DataSize = 0;
+        request->m_TmpFilename[0] = 0;
+        request->m_Error[0] = 0;
+        request->m_Callback = 0x0;
+        request->m_Compress = compress;
+        request->m_Result = 1;
+        request->m_ChunkSize = chunk_size;
+        request->m_Status = SAVE_STATUS_SERIALIZING;
+
+        if (dmStrlCpy(request->m_Filename, filename, sizeof(request->m_Filename)) >= sizeof(request->m_Filename))
+        {
+            DeleteSaveRequest(L, request, false);
+            return luaL_error(L, "Could not write to the file %s. Path too long.", filename);
+        }
+#if !defined(__EMSCRIPTEN__)
+        int res = dmSnPrintf(request->m_TmpFilename, sizeof(request->m_TmpFilename), "%s.defoldtmp_%x_%d", filename, dmHashString32(filename), g_SaveCounter++);
+        if (res == -1)
+        {
+            DeleteSaveRequest(L, request, false);
+            return luaL_error(L, "Could not write to the file %s. Path too long.", filename);
+        }
+#endif
+
+        if (chunked)
+        {
+            // Copy the entries, so that adding or removing entries in between the steps is safe
+            lua_newtable(L);
+            lua_pushnil(L);
+            while (lua_next(L, 2) != 0)
+            {
+                lua_pushvalue(L, -2);
+                lua_insert(L, -2);
+                lua_rawset(L, -4);
+            }
+            BeginCheckTable(L, -1, &request->m_Table);
+            lua_pop(L, 1);
+        }
+        else
+        {
+            DM_PROFILE("SysSaveSerialize");
+            lua_pushcfunction(L, SerializeSaveRequestProtected);
+            lua_pushlightuserdata(L, request);
+            lua_pushvalue(L, 2);
+            if (lua_pcall(L, 2, 0, 0) != 0)
+            {
+                DeleteSaveRequest(L, request, false);
+                return lua_error(L);
+            }
+        }
+
+        if (top > 2 && !lua_isnil(L, 3))
+        {
+            request->m_Callback = CreateCallback(L, 3);
+            if (request->m_Callback == 0x0)
+            {
+                DeleteSaveRequest(L, request, false);
+                return luaL_error(L, "sys.save_async callbacks are not available from this script-type.");
+            }
+        }
+
+        if (queue->m_Requests.Full())
+        {
+            queue->m_Requests.OffsetCapacity(8);
+        }
+        queue->m_Requests.Push(request);
+
+        // Written right away, unless requests made before are still being serialized
+        if (!chunked)
+        {
+#if defined(DM_HAS_THREADS)
+            DM_MUTEX_SCOPED_LOCK(g_SaveWorker.m_Mutex);
+#endif
+            SubmitSaveRequests(queue);
+        }
+        return 0;
+    }
+
     /*# loads a lua table from a file on disk
      * If the file exists, it must have been created by <code>sys.save</code> to be loaded.
      *
@@ -258,6 +879,28 @@ union SaveLoadBuffer
             Sys_FreeTableSerializationBuffer(buffer);
             return luaL_error(L, "Could not read from the file %s.", filename);
         }
+
+        // Written by sys.save_async with the compress option
+        const CompressedSaveHeader header = *(const CompressedSaveHeader*)buffer;
+        if (nread >= sizeof(header) && header.m_Magic == SAVE_LZ4_MAGIC)
+        {
+            char* table_buffer = 0;
+            int table_size = 0;
+            dmMemory::AlignedMalloc((void**)&table_buffer, 16, dmMath::Max(header.m_Size, 1U));
+            if (!table_buffer || dmLZ4::DecompressBuffer(buffer + sizeof(header), nread - sizeof(header), table_buffer, header.m_Size, &table_size) != dmLZ4::RESULT_OK)
+            {
+                Sys_FreeTableSerializationBuffer(buffer);
+                if (table_buffer)
+                {
+                    dmMemory::AlignedFree(table_buffer);
+                }
+                return luaL_error(L, "Could not decompress the file %s.", filename);
+            }
+            Sys_FreeTableSerializationBuffer(buffer);
+            buffer = table_buffer;
+            nread = table_size;
+        }
+
         PushTable(L, buffer, nread);
         Sys_FreeTableSerializationBuffer(buffer);
         return 1;
@@ -1377,6 +2020,59 @@ union SaveLoadBuffer
         return 1;
     }
 
+    /*# get the Lua memory statistics
+     *
+     * Returns a table with the memory statistics of the Lua state the calling script runs in.
+     *
+     * @name sys.get_lua_memory_stats
+     * @return stats [type:table] table with memory statistics in the following fields:
+     *
+     * `live_bytes`
+     * : [type:number] The number of bytes currently allocated by Lua.
+     *
+     * `peak_bytes`
+     * : [type:number] The highest number of bytes allocated by Lua. Only available if `slab_bytes` is non zero.
+     *
+     * `frame_allocations`
+     * : [type:number] The number of allocations made during the current frame. Only available if `slab_bytes` is non zero.
+     *
+     * `slab_bytes`
+     * : [type:number] The number of bytes reserved for the small allocations.
+     *
+     * @examples
+     *
+     * Log the allocations made in this frame:
+     *
+     * ```lua
+     * function update(self, dt)
+     *     local stats = sys.get_lua_memory_stats()
+     *     print("Lua allocations: " .. stats.frame_allocations .. " (" .. stats.live_bytes .. " bytes in use)")
+     * end
+     * ```
+     */
+    static int Sys_GetLuaMemoryStats(lua_State* L)
+    {
+        DM_LUA_STACK_CHECK(L, 1);
+
+        LuaMemoryStats stats;
+        GetLuaMemoryStats(dmScript::GetScriptContext(L), &stats);
+
+        lua_newtable(L);
+        lua_pushliteral(L, "live_bytes");
+        lua_pushnumber(L, (lua_Number) stats.m_LiveBytes);
+        lua_rawset(L, -3);
+        lua_pushliteral(L, "peak_bytes");
+        lua_pushnumber(L, (lua_Number) stats.m_PeakBytes);
+        lua_rawset(L, -3);
+        lua_pushliteral(L, "frame_allocations");
+        lua_pushnumber(L, stats.m_FrameAllocations);
+        lua_rawset(L, -3);
+        lua_pushliteral(L, "slab_bytes");
+        lua_pushnumber(L, stats.m_SlabBytes);
+        lua_rawset(L, -3);
+        return 1;
+    }
+
     //undocummented function for debugger
 
     static void Sys_DebuggerLightweightHook(lua_State *L, lua_Debug *ar)
@@ -1423,6 +2119,7 @@ union SaveLoadBuffer
     static const luaL_reg ScriptSys_methods[] =
     {
         {"save", Sys_Save},
+        {"save_async", Sys_SaveAsync},
         {"load", Sys_Load},
         {"exists", Sys_Exists},
         {"get_host_path", Sys_GetHostPath},
@@ -1447,6 +2144,7 @@ union SaveLoadBuffer
         {"set_vsync_swap_interval", Sys_SetVsyncSwapInterval},
         {"serialize", Sys_Serialize},
         {"deserialize", Sys_Deserialize},
+        {"get_lua_memory_stats", Sys_GetLuaMemoryStats},
 
         // undocummented functions for debugger
         {"set_debugger_lightweight_hook", Sys_SetDebuggerLightweightHook},
@@ -1489,4 +2187,19 @@ union SaveLoadBuffer
 
         assert(top == lua_gettop(L));
     }
+
+    void InitializeSysSave(HContext context)
+    {
+        static ScriptExtension sl;
+        sl.Initialize = SysSaveInitialize;
+        sl.Update = SysSaveUpdate;
+        sl.Finalize = SysSaveFinalize;
+        sl.NewScriptWorld = 0x0;
+        sl.DeleteScriptWorld = 0x0;
+        sl.UpdateScriptWorld = 0x0;
+        sl.FixedUpdateScriptWorld = 0x0;
+        sl.InitializeScriptInstance = 0x0;
+        sl.FinalizeScriptInstance = 0x0;
+        RegisterScriptExtension(context, &sl);
+    }
 }
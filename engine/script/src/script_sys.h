@@ -22,7 +22,9 @@ extern "C"
 
 namespace dmScript
 {
+    typedef struct Context* HContext;
     void InitializeSys(lua_State* L);
+    void InitializeSysSave(HContext context);
 }
 
 #endif // DM_SCRIPT_SYS_H
@@ -17,6 +17,8 @@
 #include <dlib/array.h>
 #include <dlib/log.h>
 #include <dlib/dstrings.h>
+#include <dlib/hash.h>
+#include <dlib/math.h>
 #include <dlib/static_assert.h>
 #include "script.h"
 #include "script_private.h"
@@ -173,6 +175,35 @@ namespace dmScript
 
     } g_ScriptTableInit;
 
+    // Enough for most tables, to avoid allocating the table stack when checking a table
+    static const uint32_t TABLE_STACK_CAPACITY = 16;
+
+    static const uint32_t TYPE_HASH_VECTOR3 = dmHashBuffer32("vector3", 7);
+    static const uint32_t TYPE_HASH_VECTOR4 = dmHashBuffer32("vector4", 7);
+    static const uint32_t TYPE_HASH_QUAT    = dmHashBuffer32("quat", 4);
+    static const uint32_t TYPE_HASH_MATRIX4 = dmHashBuffer32("matrix4", 7);
+    static const uint32_t TYPE_HASH_HASH    = dmHashBuffer32("hash", 4);
+    static const uint32_t TYPE_HASH_URL     = dmHashBuffer32("url", 3);
+
+    // Get the sub type of the user data at index with a single meta table lookup, SUB_TYPE_MAX if not supported
+    static SubType GetSubType(lua_State* L, int index)
+    {
+        uint32_t type_hash = GetUserType(L, index);
+        if (type_hash == TYPE_HASH_VECTOR3)
+            return SUB_TYPE_VECTOR3;
+        else if (type_hash == TYPE_HASH_VECTOR4)
+            return SUB_TYPE_VECTOR4;
+        else if (type_hash == TYPE_HASH_QUAT)
+            return SUB_TYPE_QUAT;
+        else if (type_hash == TYPE_HASH_MATRIX4)
+            return SUB_TYPE_MATRIX4;
+        else if (type_hash == TYPE_HASH_HASH)
+            return SUB_TYPE_HASH;
+        else if (type_hash == TYPE_HASH_URL)
+            return SUB_TYPE_URL;
+        return SUB_TYPE_MAX;
+    }
+
     static bool IsSupportedVersion(const TableHeader& header)
     {
         bool supported = false;
@@ -289,10 +320,16 @@ namespace dmScript
         return total_size;
     }
 
+    // The table stack starts out in user allocated storage, see TABLE_STACK_CAPACITY
     static void StackPush(dmArray<const void*>& table_stack, const void* p)
     {
         if (table_stack.Full())
-            table_stack.OffsetCapacity(8);
+        {
+            dmArray<const void*> stack;
+            stack.SetCapacity(table_stack.Capacity() + 8);
+            stack.PushArray(table_stack.Begin(), table_stack.Size());
+            table_stack.Swap(stack);
+        }
         table_stack.Push(p);
     }
 
@@ -314,6 +351,95 @@ namespace dmScript
         return false;
     }
 
+    uint32_t DoCheckTableSize(lua_State* L, int index, int parent_offset, dmArray<const void*>& table_stack);
+
+    // Size of the table entry with the key at -2 and the value at -1
+    static uint32_t DoCheckTableEntrySize(lua_State* L, int parent_offset, dmArray<const void*>& table_stack)
+    {
+        uint32_t size = 0;
+
+        int key_type = lua_type(L, -2);
+        int value_type = lua_type(L, -1);
+        if (key_type != LUA_TSTRING && key_type != LUA_TNUMBER)
+        {
+            luaL_error(L, "keys in table must be of type number or string (found %s)", lua_typename(L, key_type));
+        }
+
+        // key + value type
+        size += 2;
+        if (key_type == LUA_TSTRING)
+        {
+            size += sizeof(uint32_t) + lua_objlen(L, -2);
+        }
+        else if (key_type == LUA_TNUMBER)
+        {
+            size += 4;
+        }
+
+        switch (value_type)
+        {
+            case LUA_TBOOLEAN:
+            {
+                size += 1;
+            }
+            break;
+
+            case LUA_TNUMBER:
+            {
+                int offset = parent_offset + size;
+                int aligned_offset = (offset + sizeof(float)-1) & ~(sizeof(float)-1);
+                int align_size = aligned_offset - offset;
+                size += align_size;
+                size += sizeof(lua_Number);
+            }
+            break;
+
+            case LUA_TSTRING:
+            {
+                size += sizeof(uint32_t) + lua_objlen(L, -1);
+            }
+            break;
+
+            case LUA_TUSERDATA:
+            {
+                // subtype
+                size += 1;
+
+                int offset = parent_offset + size;
+                int aligned_offset = (offset + sizeof(float)-1) & ~(sizeof(float)-1);
+                int align_size = aligned_offset - offset;
+                size += align_size;
+
+
+                switch (GetSubType(L, -1))
+                {
+                    case SUB_TYPE_VECTOR3:  size += sizeof(float) * 3; break;
+                    case SUB_TYPE_VECTOR4:  size += sizeof(float) * 4; break;
+                    case SUB_TYPE_QUAT:     size += sizeof(float) * 4; break;
+                    case SUB_TYPE_MATRIX4:  size += sizeof(float) * 16; break;
+                    case SUB_TYPE_HASH:     size += sizeof(dmhash_t); break;
+                    case SUB_TYPE_URL:      size += sizeof(dmMessage::URL); break;
+                    default:
+                        luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                        break;
+                }
+            }
+            break;
+
+            case LUA_TTABLE:
+            {
+                size += DoCheckTableSize(L, -1, parent_offset + size, table_stack);
+            }
+            break;
+
+            default:
+                luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                break;
+        }
+
+        return size;
+    }
+
     uint32_t DoCheckTableSize(lua_State* L, int index, int parent_offset, dmArray<const void*>& table_stack)
     {
         int top = lua_gettop(L);
@@ -337,115 +463,246 @@ namespace dmScript
         size += 4;
         while (lua_next(L, -2) != 0)
         {
-            int key_type = lua_type(L, -2);
-            int value_type = lua_type(L, -1);
-            if (key_type != LUA_TSTRING && key_type != LUA_TNUMBER)
-            {
-                luaL_error(L, "keys in table must be of type number or string (found %s)", lua_typename(L, key_type));
-            }
+            size += DoCheckTableEntrySize(L, parent_offset + size, table_stack);
 
-            // key + value type
-            size += 2;
-            if (key_type == LUA_TSTRING)
-            {
-                size += sizeof(uint32_t) + lua_objlen(L, -2);
-            }
-            else if (key_type == LUA_TNUMBER)
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+
+        const void* p = StackPop(table_stack);
+        assert(p == table_data);
+        return size;
+    }
+
+    uint32_t CheckTableSize(lua_State* L, int index)
+    {
+        const void* table_stack_storage[TABLE_STACK_CAPACITY];
+        dmArray<const void*> table_stack(table_stack_storage, 0, TABLE_STACK_CAPACITY);
+        uint32_t size = sizeof(TableHeader) + DoCheckTableSize(L, index, 0, table_stack);
+        return size;
+    }
+
+    uint32_t DoCheckTable(lua_State* L, const TableHeader& header, const char* original_buffer, char* buffer, uint32_t buffer_size, int index, dmArray<const void*>& table_stack);
+
+    // Writes the table entry with the key at -2 and the value at -1, returns the end of the written entry
+    static char* DoCheckTableEntry(lua_State* L, const TableHeader& header, const char* original_buffer, char* buffer, const char* buffer_end, uint32_t buffer_size, uint32_t count, dmArray<const void*>& table_stack)
+    {
+        int key_type = lua_type(L, -2);
+        int value_type = lua_type(L, -1);
+        if (key_type != LUA_TSTRING && key_type != LUA_TNUMBER)
+        {
+            luaL_error(L, "keys in table must be of type number or string (found %s)", lua_typename(L, key_type));
+        }
+
+        if (buffer_end - buffer < 2)
+        {
+            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at key for element #%d", buffer_size, count);
+        }
+
+        if (key_type == LUA_TSTRING)
+        {
+            (*buffer++) = (char) LUA_TSTRING;
+            (*buffer++) = (char) value_type;
+            buffer += SaveTSTRING(L, -2, buffer, buffer_size, buffer_end, count);
+        }
+        else if (key_type == LUA_TNUMBER)
+        {
+            lua_Number key = lua_tonumber(L, -2);
+            (*buffer++) = (char) (key >= 0 ? LUA_TNUMBER : LUA_TNEGATIVENUMBER);
+            (*buffer++) = (char) value_type;
+            buffer = WriteEncodedIndex(L, key, header, buffer, buffer_end);
+        }
+
+        switch (value_type)
+        {
+            case LUA_TBOOLEAN:
             {
-                size += 4;
+                if (buffer_end - buffer < 1)
+                {
+                    luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
+                }
+                (*buffer++) = (char) lua_toboolean(L, -1);
             }
+            break;
 
-            switch (value_type)
+            case LUA_TNUMBER:
             {
-                case LUA_TBOOLEAN:
+                // NOTE: We align lua_Number to sizeof(float) even if lua_Number probably is of double type
+                intptr_t offset = buffer - original_buffer;
+                intptr_t aligned_buffer = ((intptr_t) offset + sizeof(float)-1) & ~(sizeof(float)-1);
+                intptr_t align_size = aligned_buffer - (intptr_t) offset;
+
+                if (buffer_end - buffer < align_size)
                 {
-                    size += 1;
+                    luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                 }
-                break;
 
-                case LUA_TNUMBER:
+#ifndef NDEBUG
+                memset(buffer, 0, align_size);
+#endif
+                buffer += align_size;
+
+                if (buffer_end - buffer < int32_t(sizeof(lua_Number)) || buffer_end - buffer < align_size)
                 {
-                    int offset = parent_offset + size;
-                    int aligned_offset = (offset + sizeof(float)-1) & ~(sizeof(float)-1);
-                    int align_size = aligned_offset - offset;
-                    size += align_size;
-                    size += sizeof(lua_Number);
+                    luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                 }
-                break;
 
-                case LUA_TSTRING:
+                union
                 {
-                    size += sizeof(uint32_t) + lua_objlen(L, -1);
-                }
-                break;
+                    lua_Number x;
+                    char buf[sizeof(lua_Number)];
+                };
 
-                case LUA_TUSERDATA:
+                x = lua_tonumber(L, -1);
+                memcpy(buffer, buf, sizeof(lua_Number));
+                buffer += sizeof(lua_Number);
+            }
+            break;
+
+            case LUA_TSTRING:
+            {
+                buffer += SaveTSTRING(L, -1, buffer, buffer_size, buffer_end, count);
+            }
+            break;
+
+            case LUA_TUSERDATA:
+            {
+                if (buffer_end - buffer < 1)
                 {
-                    // subtype
-                    size += 1;
+                    luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
+                }
 
-                    int offset = parent_offset + size;
-                    int aligned_offset = (offset + sizeof(float)-1) & ~(sizeof(float)-1);
-                    int align_size = aligned_offset - offset;
-                    size += align_size;
+                char* sub_type = buffer++;
 
+                // NOTE: We align lua_Number to sizeof(float) even if lua_Number probably is of double type
+                intptr_t offset = buffer - original_buffer;
+                intptr_t aligned_buffer = ((intptr_t) offset + sizeof(float)-1) & ~(sizeof(float)-1);
+                intptr_t align_size = aligned_buffer - (intptr_t) offset;
 
-                    if (IsVector3(L, -1))
-                    {
-                        size += sizeof(float) * 3;
-                    }
-                    else if (IsVector4(L, -1))
+                if (buffer_end - buffer < align_size)
+                {
+                    luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
+                }
+
+#ifndef NDEBUG
+                memset(buffer, 0, align_size);
+#endif
+                buffer += align_size;
+
+                float* f = (float*) (buffer);
+                SubType value_sub_type = GetSubType(L, -1);
+                if (value_sub_type == SUB_TYPE_VECTOR3)
+                {
+                    dmVMath::Vector3* v3 = (dmVMath::Vector3*)lua_touserdata(L, -1);
+                    if (buffer_end - buffer < int32_t(sizeof(float) * 3))
                     {
-                        size += sizeof(float) * 4;
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                    else if (IsQuat(L, -1))
+
+                    *sub_type = (char) SUB_TYPE_VECTOR3;
+                    *f++ = v3->getX();
+                    *f++ = v3->getY();
+                    *f++ = v3->getZ();
+
+                    buffer += sizeof(float) * 3;
+                }
+                else if (value_sub_type == SUB_TYPE_VECTOR4)
+                {
+                    dmVMath::Vector4* v4 = (dmVMath::Vector4*)lua_touserdata(L, -1);
+                    if (buffer_end - buffer < int32_t(sizeof(float) * 4))
                     {
-                        size += sizeof(float) * 4;
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                    else if (IsMatrix4(L, -1))
+
+                    *sub_type = (char) SUB_TYPE_VECTOR4;
+                    *f++ = v4->getX();
+                    *f++ = v4->getY();
+                    *f++ = v4->getZ();
+                    *f++ = v4->getW();
+
+                    buffer += sizeof(float) * 4;
+                }
+                else if (value_sub_type == SUB_TYPE_QUAT)
+                {
+                    dmVMath::Quat* q = (dmVMath::Quat*)lua_touserdata(L, -1);
+                    if (buffer_end - buffer < int32_t(sizeof(float) * 4))
                     {
-                        size += sizeof(float) * 16;
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                    else if (IsHash(L, -1))
+
+                    *sub_type = (char) SUB_TYPE_QUAT;
+                    *f++ = q->getX();
+                    *f++ = q->getY();
+                    *f++ = q->getZ();
+                    *f++ = q->getW();
+
+                    buffer += sizeof(float) * 4;
+                }
+                else if (value_sub_type == SUB_TYPE_MATRIX4)
+                {
+                    dmVMath::Matrix4* m = (dmVMath::Matrix4*)lua_touserdata(L, -1);
+                    if (buffer_end - buffer < int32_t(sizeof(float) * 16))
                     {
-                        size += sizeof(dmhash_t);
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                    else if (IsURL(L, -1))
+
+                    *sub_type = (char) SUB_TYPE_MATRIX4;
+                    for (uint32_t i = 0; i < 4; ++i)
+                        for (uint32_t j = 0; j < 4; ++j)
+                            *f++ = m->getElem(i, j);
+
+                    buffer += sizeof(float) * 16;
+                }
+                else if (value_sub_type == SUB_TYPE_HASH)
+                {
+                    dmhash_t hash = *(dmhash_t*)lua_touserdata(L, -1);
+                    const uint32_t hash_size = sizeof(dmhash_t);
+
+                    if (buffer_end - buffer < int32_t(hash_size))
                     {
-                        size += sizeof(dmMessage::URL);
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                    else
+
+                    *sub_type = (char) SUB_TYPE_HASH;
+
+                    memcpy(buffer, (const void*)&hash, hash_size);
+                    buffer += hash_size;
+                }
+                else if (value_sub_type == SUB_TYPE_URL)
+                {
+                    dmMessage::URL* url = (dmMessage::URL*)lua_touserdata(L, -1);
+                    const uint32_t url_size = sizeof(dmMessage::URL);
+
+                    if (buffer_end - buffer < int32_t(url_size))
                     {
-                        luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
                     }
-                }
-                break;
 
-                case LUA_TTABLE:
+                    *sub_type = (char) SUB_TYPE_URL;
+
+                    memcpy(buffer, (const void*)url, url_size);
+                    buffer += url_size;
+                }
+                else
                 {
-                    size += DoCheckTableSize(L, -1, parent_offset + size, table_stack);
+                    luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
                 }
-                break;
+            }
+            break;
 
-                default:
-                    luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
-                    break;
+            case LUA_TTABLE:
+            {
+                uint32_t n_used = DoCheckTable(L, header, original_buffer, buffer, buffer_end - buffer, -1, table_stack);
+                buffer += n_used;
             }
+            break;
 
-            lua_pop(L, 1);
+            default:
+                luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                break;
         }
-        lua_pop(L, 1);
 
-        const void* p = StackPop(table_stack);
-        assert(p == table_data);
-        return size;
-    }
-
-    uint32_t CheckTableSize(lua_State* L, int index)
-    {
-        dmArray<const void*> table_stack;
-        uint32_t size = sizeof(TableHeader) + DoCheckTableSize(L, index, 0, table_stack);
-        return size;
+        return buffer;
     }
 
     uint32_t DoCheckTable(lua_State* L, const TableHeader& header, const char* original_buffer, char* buffer, uint32_t buffer_size, int index, dmArray<const void*>& table_stack)
@@ -485,250 +742,347 @@ namespace dmScript
 
             count++;
 
-            int key_type = lua_type(L, -2);
-            int value_type = lua_type(L, -1);
-            if (key_type != LUA_TSTRING && key_type != LUA_TNUMBER)
-            {
-                luaL_error(L, "keys in table must be of type number or string (found %s)", lua_typename(L, key_type));
-            }
+            buffer = DoCheckTableEntry(L, header, original_buffer, buffer, buffer_end, buffer_size, count, table_stack);
 
-            if (buffer_end - buffer < 2)
-            {
-                luaL_error(L, "buffer (%d bytes) too small for table, exceeded at key for element #%d", buffer_size, count);
-            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
 
-            if (key_type == LUA_TSTRING)
-            {
-                (*buffer++) = (char) LUA_TSTRING;
-                (*buffer++) = (char) value_type;
-                buffer += SaveTSTRING(L, -2, buffer, buffer_size, buffer_end, count);
-            }
-            else if (key_type == LUA_TNUMBER)
-            {
-                lua_Number key = lua_tonumber(L, -2);
-                (*buffer++) = (char) (key >= 0 ? LUA_TNUMBER : LUA_TNEGATIVENUMBER);
-                (*buffer++) = (char) value_type;
-                buffer = WriteEncodedIndex(L, key, header, buffer, buffer_end);
-            }
+        const void* p = StackPop(table_stack);
+        assert(p == table_data);
 
-            switch (value_type)
-            {
-                case LUA_TBOOLEAN:
-                {
-                    if (buffer_end - buffer < 1)
-                    {
-                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                    }
-                    (*buffer++) = (char) lua_toboolean(L, -1);
-                }
-                break;
+        memcpy(buffer_start, &count, sizeof(uint32_t));
 
-                case LUA_TNUMBER:
-                {
-                    // NOTE: We align lua_Number to sizeof(float) even if lua_Number probably is of double type
-                    intptr_t offset = buffer - original_buffer;
-                    intptr_t aligned_buffer = ((intptr_t) offset + sizeof(float)-1) & ~(sizeof(float)-1);
-                    intptr_t align_size = aligned_buffer - (intptr_t) offset;
+        assert(top == lua_gettop(L));
+        return buffer - buffer_start;
+    }
 
-                    if (buffer_end - buffer < align_size)
-                    {
-                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                    }
+    uint32_t CheckTable(lua_State* L, char* buffer, uint32_t buffer_size, int index)
+    {
+        assert((intptr_t)buffer % 16 == 0);
+        if (buffer_size > sizeof(TableHeader)) {
+            char* original_buffer = buffer;
 
-#ifndef NDEBUG
-                    memset(buffer, 0, align_size);
-#endif
-                    buffer += align_size;
+            TableHeader* header = (TableHeader*)buffer;
+            header->m_Magic = TABLE_MAGIC;
+            header->m_Version = TABLE_VERSION_CURRENT;
+            buffer += sizeof(TableHeader);
+            buffer_size -= (buffer - original_buffer);
 
-                    if (buffer_end - buffer < int32_t(sizeof(lua_Number)) || buffer_end - buffer < align_size)
-                    {
-                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                    }
+            const void* table_stack_storage[TABLE_STACK_CAPACITY];
+            dmArray<const void*> table_stack(table_stack_storage, 0, TABLE_STACK_CAPACITY);
+            return sizeof(TableHeader) + DoCheckTable(L, *header, original_buffer, buffer, buffer_size, index, table_stack);
+        } else {
+            luaL_error(L, "buffer (%d bytes) too small for header (%zu bytes)", buffer_size, sizeof(TableHeader));
+            return 0;
+        }
+    }
 
-                    union
-                    {
-                        lua_Number x;
-                        char buf[sizeof(lua_Number)];
-                    };
+    void BeginCheckTable(lua_State* L, int index, CheckTableState* state)
+    {
+        luaL_checktype(L, index, LUA_TTABLE);
 
-                    x = lua_tonumber(L, -1);
-                    memcpy(buffer, buf, sizeof(lua_Number));
-                    buffer += sizeof(lua_Number);
-                }
-                break;
+        TableHeader header;
+        header.m_Magic = TABLE_MAGIC;
+        header.m_Version = TABLE_VERSION_CURRENT;
+        uint32_t count = 0;
 
-                case LUA_TSTRING:
-                {
-                    buffer += SaveTSTRING(L, -1, buffer, buffer_size, buffer_end, count);
-                }
-                break;
+        state->m_Buffer.SetCapacity(sizeof(TableHeader) + sizeof(count));
+        state->m_Buffer.SetSize(0);
+        state->m_Buffer.PushArray((const char*)&header, sizeof(TableHeader));
+        state->m_Buffer.PushArray((const char*)&count, sizeof(count));
+        state->m_Count = 0;
 
-                case LUA_TUSERDATA:
-                {
-                    if (buffer_end - buffer < 1)
-                    {
-                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                    }
+        lua_pushvalue(L, index);
+        state->m_TableRef = Ref(L, LUA_REGISTRYINDEX);
+        state->m_KeyRef = LUA_NOREF;
+    }
 
-                    char* sub_type = buffer++;
+    bool StepCheckTable(lua_State* L, CheckTableState* state, uint32_t max_size)
+    {
+        int top = lua_gettop(L);
+        (void)top;
 
-                    // NOTE: We align lua_Number to sizeof(float) even if lua_Number probably is of double type
-                    intptr_t offset = buffer - original_buffer;
-                    intptr_t aligned_buffer = ((intptr_t) offset + sizeof(float)-1) & ~(sizeof(float)-1);
-                    intptr_t align_size = aligned_buffer - (intptr_t) offset;
+        assert(state->m_TableRef != LUA_NOREF);
+        const TableHeader header = *(const TableHeader*)state->m_Buffer.Begin();
 
-                    if (buffer_end - buffer < align_size)
-                    {
-                        luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                    }
+        lua_rawgeti(L, LUA_REGISTRYINDEX, state->m_TableRef);
+        if (state->m_KeyRef != LUA_NOREF)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, state->m_KeyRef);
+            Unref(L, LUA_REGISTRYINDEX, state->m_KeyRef);
+            state->m_KeyRef = LUA_NOREF;
+        }
+        else
+        {
+            lua_pushnil(L);
+        }
 
-#ifndef NDEBUG
-                    memset(buffer, 0, align_size);
-#endif
-                    buffer += align_size;
+        const void* table_stack_storage[TABLE_STACK_CAPACITY];
+        dmArray<const void*> table_stack(table_stack_storage, 0, TABLE_STACK_CAPACITY);
+        StackPush(table_stack, lua_topointer(L, -2));
 
-                    float* f = (float*) (buffer);
-                    dmVMath::Vector3* v3;
-                    dmVMath::Vector4* v4;
-                    dmVMath::Quat* q;
-                    dmVMath::Matrix4* m;
-                    if ((v3 = ToVector3(L, -1)))
-                    {
-                        if (buffer_end - buffer < int32_t(sizeof(float) * 3))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+        dmArray<char>& buffer = state->m_Buffer;
+        uint32_t written = 0;
+        while (written < max_size && lua_next(L, -2) != 0)
+        {
+            if (state->m_Count == (uint32_t)0xffffffff)
+            {
+                luaL_error(L, "too many values in table, %d is max", 0xffffffff);
+            }
+            state->m_Count++;
 
-                        *sub_type = (char) SUB_TYPE_VECTOR3;
-                        *f++ = v3->getX();
-                        *f++ = v3->getY();
-                        *f++ = v3->getZ();
+            // The size is an upper bound, as indices are written with a variable length encoding
+            uint32_t offset = buffer.Size();
+            uint32_t entry_size = DoCheckTableEntrySize(L, offset, table_stack);
+            if (buffer.Remaining() < entry_size)
+            {
+                buffer.OffsetCapacity(dmMath::Max(entry_size, buffer.Capacity()));
+            }
 
-                        buffer += sizeof(float) * 3;
-                    }
-                    else if ((v4 = ToVector4(L, -1)))
-                    {
-                        if (buffer_end - buffer < int32_t(sizeof(float) * 4))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+            char* entry_end = DoCheckTableEntry(L, header, buffer.Begin(), buffer.End(), buffer.Begin() + buffer.Capacity(), buffer.Capacity(), state->m_Count, table_stack);
+            buffer.SetSize(entry_end - buffer.Begin());
+            written += buffer.Size() - offset;
 
-                        *sub_type = (char) SUB_TYPE_VECTOR4;
-                        *f++ = v4->getX();
-                        *f++ = v4->getY();
-                        *f++ = v4->getZ();
-                        *f++ = v4->getW();
+            lua_pop(L, 1);
+        }
 
-                        buffer += sizeof(float) * 4;
-                    }
-                    else if ((q = ToQuat(L, -1)))
-                    {
-                        if (buffer_end - buffer < int32_t(sizeof(float) * 4))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+        bool done = lua_gettop(L) == top + 1;
+        if (done)
+        {
+            memcpy(buffer.Begin() + sizeof(TableHeader), &state->m_Count, sizeof(uint32_t));
+        }
+        else
+        {
+            // Continue from the current key in the next step
+            state->m_KeyRef = Ref(L, LUA_REGISTRYINDEX);
+        }
+        lua_pop(L, 1);
 
-                        *sub_type = (char) SUB_TYPE_QUAT;
-                        *f++ = q->getX();
-                        *f++ = q->getY();
-                        *f++ = q->getZ();
-                        *f++ = q->getW();
+        assert(top == lua_gettop(L));
+        return done;
+    }
 
-                        buffer += sizeof(float) * 4;
-                    }
-                    else if ((m = ToMatrix4(L, -1)))
-                    {
-                        if (buffer_end - buffer < int32_t(sizeof(float) * 16))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+    void EndCheckTable(lua_State* L, CheckTableState* state)
+    {
+        Unref(L, LUA_REGISTRYINDEX, state->m_TableRef);
+        Unref(L, LUA_REGISTRYINDEX, state->m_KeyRef);
+        state->m_TableRef = LUA_NOREF;
+        state->m_KeyRef = LUA_NOREF;
+    }
 
-                        *sub_type = (char) SUB_TYPE_MATRIX4;
-                        for (uint32_t i = 0; i < 4; ++i)
-                            for (uint32_t j = 0; j < 4; ++j)
-                                *f++ = m->getElem(i, j);
+    /*
+     * Message data referring to a table in the Lua state of the owner context, see CheckMessageTable().
+     *
+     * The magic is chosen not to match serialized tables, neither with a header (TABLE_MAGIC) nor without,
+     * where the byte following the count is a key type.
+     */
+    const uint32_t TABLE_REF_MAGIC = 0x52544448;
 
-                        buffer += sizeof(float) * 16;
-                    }
-                    else if (IsHash(L, -1))
-                    {
-                        dmhash_t hash = *(dmhash_t*)lua_touserdata(L, -1);
-                        const uint32_t hash_size = sizeof(dmhash_t);
+    struct TableRef
+    {
+        uint32_t            m_Magic;
+        // Registry reference to the table, LUA_NOREF once handed over to the receiver
+        int                 m_Ref;
+        MessageTableOwner*  m_Owner;
+    };
+
+    static void PushTableString(lua_State* from_L, int index, lua_State* to_L)
+    {
+        if (from_L == to_L)
+        {
+            lua_pushvalue(to_L, index);
+        }
+        else
+        {
+            size_t len = 0;
+            const char* str = lua_tolstring(from_L, index, &len);
+            lua_pushlstring(to_L, str, len);
+        }
+    }
 
-                        if (buffer_end - buffer < int32_t(hash_size))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+    /*
+     * Copy the table at index in from_L to a new table on top of to_L, which may be the same Lua state.
+     * Keys and values are restricted, and numeric keys truncated, the same way as when the table is
+     * serialized by CheckTable(), so that the copy is equal to what PushTable() would give.
+     */
+    static void CopyTable(lua_State* from_L, int index, lua_State* to_L, dmArray<const void*>& table_stack)
+    {
+        if (index < 0)
+        {
+            index = lua_gettop(from_L) + index + 1;
+        }
 
-                        *sub_type = (char) SUB_TYPE_HASH;
+        const void* table_data = (const void*)lua_topointer(from_L, index);
+        if (StackContains(table_stack, table_data))
+        {
+            luaL_error(to_L, "Save table is recursive!");
+        }
+        StackPush(table_stack, table_data);
 
-                        memcpy(buffer, (const void*)&hash, hash_size);
-                        buffer += hash_size;
-                    }
-                    else if (IsURL(L, -1))
-                    {
-                        dmMessage::URL* url = (dmMessage::URL*)lua_touserdata(L, -1);
-                        const uint32_t url_size = sizeof(dmMessage::URL);
+        luaL_checkstack(to_L, 6, "table too deep");
+        if (from_L != to_L && !lua_checkstack(from_L, 3))
+        {
+            luaL_error(to_L, "table too deep");
+        }
 
-                        if (buffer_end - buffer < int32_t(url_size))
-                        {
-                            luaL_error(L, "buffer (%d bytes) too small for table, exceeded at value (%s) for element #%d", buffer_size, lua_typename(L, key_type), count);
-                        }
+        lua_newtable(to_L);
+        int table_index = lua_gettop(to_L);
 
-                        *sub_type = (char) SUB_TYPE_URL;
+        lua_pushnil(from_L);
+        while (lua_next(from_L, index) != 0)
+        {
+            int value_index = lua_gettop(from_L);
+            int key_index = value_index - 1;
 
-                        memcpy(buffer, (const void*)url, url_size);
-                        buffer += url_size;
-                    }
-                    else
+            int key_type = lua_type(from_L, key_index);
+            if (key_type == LUA_TSTRING)
+            {
+                PushTableString(from_L, key_index, to_L);
+            }
+            else if (key_type == LUA_TNUMBER)
+            {
+                lua_Number key = lua_tonumber(from_L, key_index);
+                bool negative = key < 0;
+                if (negative)
+                    key = -key;
+                if (key > 0xffffffff)
+                    luaL_error(to_L, "index out of bounds, max is %d", 0xffffffff);
+                lua_Number truncated_key = (lua_Number)(uint32_t)key;
+                lua_pushnumber(to_L, negative ? -truncated_key : truncated_key);
+            }
+            else
+            {
+                luaL_error(to_L, "keys in table must be of type number or string (found %s)", lua_typename(from_L, key_type));
+            }
+
+            int value_type = lua_type(from_L, value_index);
+            switch (value_type)
+            {
+                case LUA_TBOOLEAN:
+                    lua_pushboolean(to_L, lua_toboolean(from_L, value_index));
+                    break;
+
+                case LUA_TNUMBER:
+                    lua_pushnumber(to_L, lua_tonumber(from_L, value_index));
+                    break;
+
+                case LUA_TSTRING:
+                    PushTableString(from_L, value_index, to_L);
+                    break;
+
+                case LUA_TUSERDATA:
+                {
+                    void* data = lua_touserdata(from_L, value_index);
+                    switch (GetSubType(from_L, value_index))
                     {
-                        luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                        case SUB_TYPE_VECTOR3:  dmScript::PushVector3(to_L, *(dmVMath::Vector3*)data); break;
+                        case SUB_TYPE_VECTOR4:  dmScript::PushVector4(to_L, *(dmVMath::Vector4*)data); break;
+                        case SUB_TYPE_QUAT:     dmScript::PushQuat(to_L, *(dmVMath::Quat*)data); break;
+                        case SUB_TYPE_MATRIX4:  dmScript::PushMatrix4(to_L, *(dmVMath::Matrix4*)data); break;
+                        case SUB_TYPE_URL:      dmScript::PushURL(to_L, *(dmMessage::URL*)data); break;
+                        case SUB_TYPE_HASH:
+                            // Hashes are immutable and can be shared within a Lua state
+                            if (from_L == to_L)
+                                lua_pushvalue(to_L, value_index);
+                            else
+                                dmScript::PushHash(to_L, *(dmhash_t*)data);
+                            break;
+                        default:
+                            luaL_error(to_L, "unsupported value type in table: %s", lua_typename(from_L, value_type));
+                            break;
                     }
                 }
                 break;
 
                 case LUA_TTABLE:
-                {
-                    uint32_t n_used = DoCheckTable(L, header, original_buffer, buffer, buffer_end - buffer, -1, table_stack);
-                    buffer += n_used;
-                }
-                break;
+                    CopyTable(from_L, value_index, to_L, table_stack);
+                    break;
 
                 default:
-                    luaL_error(L, "unsupported value type in table: %s", lua_typename(L, value_type));
+                    luaL_error(to_L, "unsupported value type in table: %s", lua_typename(from_L, value_type));
                     break;
             }
 
-            lua_pop(L, 1);
+            lua_rawset(to_L, table_index);
+            lua_pop(from_L, 1);
         }
-        lua_pop(L, 1);
 
         const void* p = StackPop(table_stack);
         assert(p == table_data);
+    }
 
-        memcpy(buffer_start, &count, sizeof(uint32_t));
+    uint32_t CheckMessageTable(lua_State* L, char* buffer, uint32_t buffer_size, int index)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+        assert(buffer_size >= sizeof(TableRef));
+        luaL_checktype(L, index, LUA_TTABLE);
 
-        assert(top == lua_gettop(L));
-        return buffer - buffer_start;
+        HContext context = GetScriptContext(L);
+        assert(context != 0x0);
+
+        // Copy the table, so that later changes by the sender aren't seen by the receiver
+        const void* table_stack_storage[TABLE_STACK_CAPACITY];
+        dmArray<const void*> table_stack(table_stack_storage, 0, TABLE_STACK_CAPACITY);
+        CopyTable(L, index, L, table_stack);
+
+        TableRef* table_ref = (TableRef*)buffer;
+        table_ref->m_Magic = TABLE_REF_MAGIC;
+        table_ref->m_Ref = Ref(L, LUA_REGISTRYINDEX);
+        table_ref->m_Owner = context->m_MessageTableOwner;
+        table_ref->m_Owner->m_RefCount++;
+        return sizeof(TableRef);
     }
 
-    uint32_t CheckTable(lua_State* L, char* buffer, uint32_t buffer_size, int index)
+    void ReleaseMessageTable(void* data)
     {
-        assert((intptr_t)buffer % 16 == 0);
-        if (buffer_size > sizeof(TableHeader)) {
-            char* original_buffer = buffer;
+        TableRef* table_ref = (TableRef*)data;
+        assert(table_ref->m_Magic == TABLE_REF_MAGIC);
+        HContext context = table_ref->m_Owner->m_Context;
+        if (context != 0x0)
+        {
+            Unref(context->m_LuaState, LUA_REGISTRYINDEX, table_ref->m_Ref);
+        }
+        table_ref->m_Ref = LUA_NOREF;
+        ReleaseMessageTableOwner(table_ref->m_Owner);
+        table_ref->m_Owner = 0x0;
+    }
 
-            TableHeader* header = (TableHeader*)buffer;
-            header->m_Magic = TABLE_MAGIC;
-            header->m_Version = TABLE_VERSION_CURRENT;
-            buffer += sizeof(TableHeader);
-            buffer_size -= (buffer - original_buffer);
+    void ReleaseMessageTableOwner(MessageTableOwner* owner)
+    {
+        assert(owner->m_RefCount > 0);
+        if (--owner->m_RefCount == 0)
+        {
+            delete owner;
+        }
+    }
 
-            dmArray<const void*> table_stack;
-            return sizeof(TableHeader) + DoCheckTable(L, *header, original_buffer, buffer, buffer_size, index, table_stack);
-        } else {
-            luaL_error(L, "buffer (%d bytes) too small for header (%zu bytes)", buffer_size, sizeof(TableHeader));
-            return 0;
+    static void PushTableRef(lua_State* L, TableRef* table_ref)
+    {
+        HContext context = table_ref->m_Owner != 0x0 ? table_ref->m_Owner->m_Context : 0x0;
+        if (context == 0x0 || table_ref->m_Ref == LUA_NOREF)
+        {
+            dmLogError("The message table is no longer available, it has either been received already or its script context is deleted.");
+            lua_newtable(L);
+            return;
+        }
+
+        if (GetScriptContext(L) == context)
+        {
+            // Hand over the table to the receiver
+            lua_rawgeti(L, LUA_REGISTRYINDEX, table_ref->m_Ref);
+            Unref(L, LUA_REGISTRYINDEX, table_ref->m_Ref);
+            table_ref->m_Ref = LUA_NOREF;
+        }
+        else
+        {
+            // Copy from the Lua state of the owner context, which is left for the destroy callback to release
+            lua_State* owner_L = context->m_LuaState;
+            lua_rawgeti(owner_L, LUA_REGISTRYINDEX, table_ref->m_Ref);
+            const void* table_stack_storage[TABLE_STACK_CAPACITY];
+            dmArray<const void*> table_stack(table_stack_storage, 0, TABLE_STACK_CAPACITY);
+            CopyTable(owner_L, -1, L, table_stack);
+            lua_pop(owner_L, 1);
         }
     }
 
@@ -1074,6 +1428,12 @@ namespace dmScript
 
     void PushTable(lua_State*L, const char* buffer, uint32_t buffer_size)
     {
+        if (buffer_size == sizeof(TableRef) && ((const TableRef*)buffer)->m_Magic == TABLE_REF_MAGIC)
+        {
+            PushTableRef(L, (TableRef*)buffer);
+            return;
+        }
+
         TableHeader header;
         const char* original_buffer = buffer;
 
@@ -42,22 +42,20 @@ namespace dmScript
      */
 
     /*
-        The timers are stored in a flat array with no holes which we scan sequenctially on each update.
+        The timers are stored in an array indexed by the lookup index of the timer handle, the free
+        indices are kept in an index pool.
 
-        When a timer is removed the last timer in the list may change location (EraseSwap).
+        The timer identity is an index into the timer array combined with a generation counter,
+        this makes it possible to reuse the index without risk of using stale indexes - the caller to
+        CancelTimer is allowed to call with an handle of a timer that already has expired.
 
-        This is to keep the array sweep fast and handle cases where multiple short lived timers are
-        created followed by one long-lived timer. If we did not re-shuffle and keep holes we would keep
-        scanning the array to the end where the only live timer exists skipping all the holes.
-        How much of an issue this is guesswork at this point.
-
-        The timer identity is an index into an indirection layer combined with a generation counter,
-        this makes it possible to reuse the index for the indirection layer without risk of using
-        stale indexes - the caller to CancelTimer is allowed to call with an handle of a timer that already
-        has expired.
+        Scheduled timers are kept in a binary min-heap, ordered on the (world) time when they fire, so
+        each update only touches the timers that trigger, instead of scanning all timers. Each timer
+        knows its position in the heap, so that cancelled timers can be removed from the heap directly.
 
         Each script instance needs to call KillTimers for its owner to clean up potential timers
-        that has not yet been cancelled or completed (one-shot).
+        that has not yet been cancelled or completed (one-shot). To make that fast, the timers of an
+        owner are linked together in an intrusive list, with the first timer stored in m_OwnerTimers.
     */
 
     static const char TIMER_WORLD_VALUE_KEY[] = "__dm_timer_world__";
@@ -72,115 +70,311 @@ namespace dmScript
         // Store complete timer handle with generation here to identify stale timer handles
         HTimer          m_Handle;
 
-        // How much time remaining until the timer fires
-        float           m_Remaining;
+        // The timer world time when the timer fires
+        double          m_Expiry;
 
         // The timer delay, we need to keep this for repeating timers
         float           m_Delay;
 
+        // Index in the TimerWorld::m_Heap, or INVALID_TIMER_INDEX if the timer isn't scheduled
+        uint32_t        m_HeapIndex;
+
+        // The other timers with the same owner
+        uint32_t        m_PrevOwnerTimer;
+        uint32_t        m_NextOwnerTimer;
+
         // Flag if the timer should repeat
         uint32_t        m_Repeat : 1;
         // Flag if the timer is alive
         uint32_t        m_IsAlive : 1;
     };
 
-    #define INVALID_TIMER_LOOKUP_INDEX  0xffffu
+    struct TimerHeapEntry
+    {
+        double          m_Expiry;
+        // Timers with the same expiry time trigger in the order they were scheduled
+        uint64_t        m_Order;
+        uint32_t        m_Timer;
+    };
+
+    #define TIMER_INDEX_BITS            17u
+    #define TIMER_INDEX_MASK            ((1u << TIMER_INDEX_BITS) - 1u)
+    #define INVALID_TIMER_INDEX         0xffffffffu
     #define INITIAL_TIMER_CAPACITY      8u
-    #define MAX_TIMER_CAPACITY          65000u  // Needs to be less that 65535 since 65535 is reserved for invalid index
-    #define TIMER_CAPACITY_GROWTH       16u
+    #define MAX_TIMER_CAPACITY          131000u  // Needs to be less that 131071 since that index is part of the INVALID_TIMER_HANDLE
 
     struct TimerWorld
     {
         dmArray<Timer>                      m_Timers;
-        dmArray<uint16_t>                   m_IndexLookup;
-        dmIndexPool<uint16_t>               m_IndexPool;
+        dmArray<TimerHeapEntry>             m_Heap;
+        dmArray<uint32_t>                   m_Triggered;    // The timers triggering in the current UpdateTimers
+        dmArray<uint32_t>                   m_DeadTimers;   // Timers that died during UpdateTimers, freed at the end of the update
+        dmHashTable<uintptr_t, uint32_t>    m_OwnerTimers;  // The first timer of each owner
+        dmIndexPool<uint32_t>               m_IndexPool;
+        double                              m_Time;
+        uint64_t                            m_Order;
+        uint32_t                            m_AliveCount;
         uint16_t                            m_Version;   // Incremented to avoid collisions each time we push timer indexes back to the m_IndexPool
         uint16_t                            m_InUpdate : 1;
     };
 
-    static uint16_t GetLookupIndex(HTimer handle)
+    static uint32_t GetLookupIndex(HTimer handle)
     {
-        return (uint16_t)(handle & 0xffffu);
+        return handle & TIMER_INDEX_MASK;
     }
 
-    static HTimer MakeHandle(uint16_t generation, uint16_t lookup_index)
+    static HTimer MakeHandle(uint16_t generation, uint32_t lookup_index)
     {
-        return (((uint32_t)generation) << 16) | (lookup_index);
+        return (((uint32_t)generation) << TIMER_INDEX_BITS) | lookup_index; // the upper generation bit is dropped
     }
 
-    static Timer* AllocateTimer(HTimerWorld timer_world, uintptr_t owner)
+    static Timer* GetTimer(HTimerWorld timer_world, HTimer handle)
     {
-        assert(timer_world != 0x0);
-        uint32_t timer_count = timer_world->m_Timers.Size();
-        if (timer_count == MAX_TIMER_CAPACITY)
+        uint32_t lookup_index = GetLookupIndex(handle);
+        if (lookup_index >= timer_world->m_Timers.Size())
         {
-            dmLogError("Timer could not be stored since the timer buffer is full (%d).", MAX_TIMER_CAPACITY);
             return 0x0;
         }
 
-        if (timer_world->m_IndexPool.Remaining() == 0)
+        Timer* timer = &timer_world->m_Timers[lookup_index];
+        if (timer->m_Handle != handle)
         {
-            uint32_t old_capacity = timer_world->m_IndexPool.Capacity();
-            uint32_t capacity = dmMath::Min(old_capacity + TIMER_CAPACITY_GROWTH, MAX_TIMER_CAPACITY);
-            timer_world->m_IndexPool.SetCapacity(capacity);
-            timer_world->m_IndexLookup.SetCapacity(capacity);
-            timer_world->m_IndexLookup.SetSize(capacity);
-            memset(&timer_world->m_IndexLookup[old_capacity], 0u, (capacity - old_capacity) * sizeof(uint16_t));
+            return 0x0;
         }
+        return timer;
+    }
+
+    static float GetTimeRemaining(HTimerWorld timer_world, const Timer* timer)
+    {
+        return (float)(timer->m_Expiry - timer_world->m_Time);
+    }
 
-        HTimer handle = MakeHandle(timer_world->m_Version, timer_world->m_IndexPool.Pop());
+    static inline bool HeapLess(const TimerHeapEntry& a, const TimerHeapEntry& b)
+    {
+        return a.m_Expiry < b.m_Expiry || (a.m_Expiry == b.m_Expiry && a.m_Order < b.m_Order);
+    }
 
-        if (timer_world->m_Timers.Full())
+    static inline void HeapSet(HTimerWorld timer_world, uint32_t heap_index, const TimerHeapEntry& entry)
+    {
+        timer_world->m_Heap[heap_index] = entry;
+        timer_world->m_Timers[entry.m_Timer].m_HeapIndex = heap_index;
+    }
+
+    static void HeapSiftUp(HTimerWorld timer_world, uint32_t heap_index)
+    {
+        dmArray<TimerHeapEntry>& heap = timer_world->m_Heap;
+        TimerHeapEntry entry = heap[heap_index];
+        while (heap_index > 0)
         {
-            uint32_t capacity = timer_world->m_Timers.Capacity();
-            capacity = dmMath::Min(capacity + TIMER_CAPACITY_GROWTH, MAX_TIMER_CAPACITY);
-            timer_world->m_Timers.SetCapacity(capacity);
+            uint32_t parent = (heap_index - 1) / 2;
+            if (!HeapLess(entry, heap[parent]))
+            {
+                break;
+            }
+            HeapSet(timer_world, heap_index, heap[parent]);
+            heap_index = parent;
         }
+        HeapSet(timer_world, heap_index, entry);
+    }
 
-        timer_world->m_Timers.SetSize(timer_count + 1);
-        Timer& timer = timer_world->m_Timers[timer_count];
-        timer.m_Handle = handle;
-        timer.m_Owner = owner;
+    static void HeapSiftDown(HTimerWorld timer_world, uint32_t heap_index)
+    {
+        dmArray<TimerHeapEntry>& heap = timer_world->m_Heap;
+        TimerHeapEntry entry = heap[heap_index];
+        uint32_t size = heap.Size();
+        while (true)
+        {
+            uint32_t child = heap_index * 2 + 1;
+            if (child >= size)
+            {
+                break;
+            }
+            if (child + 1 < size && HeapLess(heap[child + 1], heap[child]))
+            {
+                ++child;
+            }
+            if (!HeapLess(heap[child], entry))
+            {
+                break;
+            }
+            HeapSet(timer_world, heap_index, heap[child]);
+            heap_index = child;
+        }
+        HeapSet(timer_world, heap_index, entry);
+    }
+
+    static void ScheduleTimer(HTimerWorld timer_world, uint32_t timer_index)
+    {
+        Timer& timer = timer_world->m_Timers[timer_index];
+        assert(timer.m_HeapIndex == INVALID_TIMER_INDEX);
+
+        if (timer_world->m_Heap.Full())
+        {
+            timer_world->m_Heap.OffsetCapacity(dmMath::Max(INITIAL_TIMER_CAPACITY, timer_world->m_Heap.Capacity()));
+        }
+
+        TimerHeapEntry entry;
+        entry.m_Expiry = timer.m_Expiry;
+        entry.m_Order = timer_world->m_Order++;
+        entry.m_Timer = timer_index;
+        timer_world->m_Heap.Push(entry);
+        HeapSiftUp(timer_world, timer_world->m_Heap.Size() - 1);
+    }
 
-        uint16_t lookup_index = GetLookupIndex(handle);
+    static void UnscheduleTimer(HTimerWorld timer_world, uint32_t timer_index)
+    {
+        Timer& timer = timer_world->m_Timers[timer_index];
+        uint32_t heap_index = timer.m_HeapIndex;
+        if (heap_index == INVALID_TIMER_INDEX)
+        {
+            return;
+        }
+        timer.m_HeapIndex = INVALID_TIMER_INDEX;
+
+        dmArray<TimerHeapEntry>& heap = timer_world->m_Heap;
+        TimerHeapEntry last = heap.Back();
+        heap.Pop();
+        if (heap_index == heap.Size())
+        {
+            return;
+        }
+
+        HeapSet(timer_world, heap_index, last);
+        if (heap_index > 0 && HeapLess(last, heap[(heap_index - 1) / 2]))
+        {
+            HeapSiftUp(timer_world, heap_index);
+        }
+        else
+        {
+            HeapSiftDown(timer_world, heap_index);
+        }
+    }
 
-        timer_world->m_IndexLookup[lookup_index] = timer_count;
-        return &timer;
+    static void ClearTimers(HTimerWorld timer_world, uint32_t start, uint32_t end)
+    {
+        memset(&timer_world->m_Timers[start], 0u, (end - start) * sizeof(Timer));
+        for (uint32_t i = start; i < end; ++i)
+        {
+            timer_world->m_Timers[i].m_Handle = INVALID_TIMER_HANDLE;
+        }
     }
 
-    static void EraseTimer(HTimerWorld timer_world, uint32_t timer_index)
+    static uint32_t AllocateTimer(HTimerWorld timer_world, uintptr_t owner)
     {
         assert(timer_world != 0x0);
+        if (timer_world->m_IndexPool.Remaining() == 0)
+        {
+            uint32_t old_capacity = timer_world->m_IndexPool.Capacity();
+            if (old_capacity == MAX_TIMER_CAPACITY)
+            {
+                dmLogError("Timer could not be stored since the timer buffer is full (%d).", MAX_TIMER_CAPACITY);
+                return INVALID_TIMER_INDEX;
+            }
+
+            uint32_t capacity = dmMath::Min(old_capacity * 2, MAX_TIMER_CAPACITY);
+            timer_world->m_IndexPool.SetCapacity(capacity);
+            timer_world->m_Timers.SetCapacity(capacity);
+            timer_world->m_Timers.SetSize(capacity);
+            ClearTimers(timer_world, old_capacity, capacity);
+        }
 
-        Timer& movedTimer = timer_world->m_Timers.EraseSwap(timer_index);
+        uint32_t timer_index = timer_world->m_IndexPool.Pop();
 
-        if (timer_index < timer_world->m_Timers.Size())
+        Timer& timer = timer_world->m_Timers[timer_index];
+        timer.m_Handle = MakeHandle(timer_world->m_Version, timer_index);
+        timer.m_Owner = owner;
+        timer.m_HeapIndex = INVALID_TIMER_INDEX;
+        timer.m_PrevOwnerTimer = INVALID_TIMER_INDEX;
+
+        uint32_t* first = timer_world->m_OwnerTimers.Get(owner);
+        if (first)
         {
-            uint16_t moved_lookup_index = GetLookupIndex(movedTimer.m_Handle);
-            timer_world->m_IndexLookup[moved_lookup_index] = timer_index;
+            timer.m_NextOwnerTimer = *first;
+            timer_world->m_Timers[*first].m_PrevOwnerTimer = timer_index;
+            *first = timer_index;
+        }
+        else
+        {
+            if (timer_world->m_OwnerTimers.Full())
+            {
+                uint32_t capacity = timer_world->m_OwnerTimers.Capacity() * 2;
+                // Odd table size, since the owners are usually aligned pointers
+                timer_world->m_OwnerTimers.SetCapacity((capacity / 3) | 1, capacity);
+            }
+            timer.m_NextOwnerTimer = INVALID_TIMER_INDEX;
+            timer_world->m_OwnerTimers.Put(owner, timer_index);
         }
+        return timer_index;
     }
 
-    static void FreeTimer(HTimerWorld timer_world, Timer& timer)
+    static void FreeTimer(HTimerWorld timer_world, uint32_t timer_index)
     {
         assert(timer_world != 0x0);
+        Timer& timer = timer_world->m_Timers[timer_index];
         assert(timer.m_IsAlive == 0);
+        assert(timer.m_HeapIndex == INVALID_TIMER_INDEX);
+
+        if (timer.m_NextOwnerTimer != INVALID_TIMER_INDEX)
+        {
+            timer_world->m_Timers[timer.m_NextOwnerTimer].m_PrevOwnerTimer = timer.m_PrevOwnerTimer;
+        }
+        if (timer.m_PrevOwnerTimer != INVALID_TIMER_INDEX)
+        {
+            timer_world->m_Timers[timer.m_PrevOwnerTimer].m_NextOwnerTimer = timer.m_NextOwnerTimer;
+        }
+        else if (timer.m_NextOwnerTimer != INVALID_TIMER_INDEX)
+        {
+            *timer_world->m_OwnerTimers.Get(timer.m_Owner) = timer.m_NextOwnerTimer;
+        }
+        else
+        {
+            timer_world->m_OwnerTimers.Erase(timer.m_Owner);
+        }
 
-        uint16_t lookup_index = GetLookupIndex(timer.m_Handle);
-        uint16_t timer_index = timer_world->m_IndexLookup[lookup_index];
-        timer_world->m_IndexPool.Push(lookup_index);
+        // Invalidate the handle, the slot gets a new handle when it is reused
+        timer.m_Handle = INVALID_TIMER_HANDLE;
+        timer_world->m_IndexPool.Push(timer_index);
+    }
+
+    // Frees a dead timer, unless we're in the middle of an update
+    static void ReleaseTimer(HTimerWorld timer_world, uint32_t timer_index)
+    {
+        if (timer_world->m_InUpdate == 0)
+        {
+            FreeTimer(timer_world, timer_index);
+        }
+        else
+        {
+            if (timer_world->m_DeadTimers.Full())
+            {
+                timer_world->m_DeadTimers.OffsetCapacity(dmMath::Max(INITIAL_TIMER_CAPACITY, timer_world->m_DeadTimers.Capacity()));
+            }
+            timer_world->m_DeadTimers.Push(timer_index);
+        }
+    }
 
-        EraseTimer(timer_world, timer_index);
+    static void KillTimer(HTimerWorld timer_world, uint32_t timer_index)
+    {
+        Timer& timer = timer_world->m_Timers[timer_index];
+        assert(timer.m_IsAlive == 1);
+        timer.m_IsAlive = 0;
+        --timer_world->m_AliveCount;
+        UnscheduleTimer(timer_world, timer_index);
+        ReleaseTimer(timer_world, timer_index);
     }
 
     HTimerWorld NewTimerWorld()
     {
         TimerWorld* timer_world = new TimerWorld();
         timer_world->m_Timers.SetCapacity(INITIAL_TIMER_CAPACITY);
-        timer_world->m_IndexLookup.SetCapacity(INITIAL_TIMER_CAPACITY);
-        timer_world->m_IndexLookup.SetSize(INITIAL_TIMER_CAPACITY);
-        memset(&timer_world->m_IndexLookup[0], 0u, INITIAL_TIMER_CAPACITY * sizeof(uint16_t));
+        timer_world->m_Timers.SetSize(INITIAL_TIMER_CAPACITY);
+        ClearTimers(timer_world, 0, INITIAL_TIMER_CAPACITY);
+        timer_world->m_Heap.SetCapacity(INITIAL_TIMER_CAPACITY);
         timer_world->m_IndexPool.SetCapacity(INITIAL_TIMER_CAPACITY);
+        timer_world->m_OwnerTimers.SetCapacity(5, INITIAL_TIMER_CAPACITY);
+        timer_world->m_Time = 0.0;
+        timer_world->m_Order = 0;
+        timer_world->m_AliveCount = 0;
         timer_world->m_Version = 0;
         timer_world->m_InUpdate = 0;
         return timer_world;
@@ -198,34 +392,47 @@ namespace dmScript
         DM_PROFILE("Update");
 
         timer_world->m_InUpdate = 1;
+        timer_world->m_Time += dt;
+        const double time = timer_world->m_Time;
+
+        DM_PROPERTY_ADD_U32(rmtp_TimerCount, timer_world->m_AliveCount);
+
+        // We only trigger timers that *existed at entry to UpdateTimers*, so we collect the
+        // triggered timers before calling any callbacks. Any timers added or rescheduled in a
+        // trigger callback will not be triggered in this scope.
+        dmArray<TimerHeapEntry>& heap = timer_world->m_Heap;
+        dmArray<uint32_t>& triggered = timer_world->m_Triggered;
+        triggered.SetSize(0);
+        while (!heap.Empty() && heap[0].m_Expiry <= time)
+        {
+            uint32_t timer_index = heap[0].m_Timer;
+            UnscheduleTimer(timer_world, timer_index);
+            if (triggered.Full())
+            {
+                triggered.OffsetCapacity(dmMath::Max(INITIAL_TIMER_CAPACITY, triggered.Capacity()));
+            }
+            triggered.Push(timer_index);
+        }
 
-        // We only scan timers for trigger if the timer *existed at entry to UpdateTimers*, any timers added
-        // in a trigger callback will always be added at the end of m_Timers and not triggered in this scope.
-        uint32_t size = timer_world->m_Timers.Size();
-        DM_PROPERTY_ADD_U32(rmtp_TimerCount, size);
-
+        uint32_t size = triggered.Size();
         for (uint32_t i = 0; i < size; ++i)
         {
-            Timer* timer = &timer_world->m_Timers[i];
+            uint32_t timer_index = triggered[i];
+            Timer* timer = &timer_world->m_Timers[timer_index];
             if (timer->m_IsAlive == 0)
             {
                 continue;
             }
 
-            timer->m_Remaining -= dt;
-            if (timer->m_Remaining > 0.0f)
-            {
-                continue;
-            }
-
-            float elapsed_time = timer->m_Delay - timer->m_Remaining;
+            float remaining = GetTimeRemaining(timer_world, timer);
+            float elapsed_time = timer->m_Delay - remaining;
 
             TimerEventType eventType = timer->m_Repeat == 0 ? TIMER_EVENT_TRIGGER_WILL_DIE : TIMER_EVENT_TRIGGER_WILL_REPEAT;
 
             timer->m_Callback(timer_world, eventType, timer->m_Handle, elapsed_time, timer->m_Owner, timer->m_UserData);
 
             // The array might have been reallocated here! So grab the pointer again...
-            timer = &timer_world->m_Timers[i];
+            timer = &timer_world->m_Timers[timer_index];
 
             if (timer->m_IsAlive == 0)
             {
@@ -234,44 +441,36 @@ namespace dmScript
 
             if (timer->m_Repeat == 0)
             {
-                timer->m_IsAlive = 0;
+                KillTimer(timer_world, timer_index);
                 continue;
             }
 
             if (timer->m_Delay == 0.0f)
             {
-                timer->m_Remaining = 0.0f;
-                continue;
+                timer->m_Expiry = time;
             }
-
-            float wrapped_count = ((-timer->m_Remaining) / timer->m_Delay) + 1.f;
-            float offset_to_next_trigger  = floor(wrapped_count) * timer->m_Delay;
-            timer->m_Remaining += offset_to_next_trigger;
-            if (timer->m_Remaining < 0) // If the delay is very small, the floating point precision might produce issues
-                timer->m_Remaining = timer->m_Delay; // reset the timer
+            else
+            {
+                float wrapped_count = ((-remaining) / timer->m_Delay) + 1.f;
+                float offset_to_next_trigger  = floor(wrapped_count) * timer->m_Delay;
+                remaining += offset_to_next_trigger;
+                if (remaining < 0) // If the delay is very small, the floating point precision might produce issues
+                    remaining = timer->m_Delay; // reset the timer
+                timer->m_Expiry = time + remaining;
+            }
+            ScheduleTimer(timer_world, timer_index);
         }
 
         timer_world->m_InUpdate = 0;
 
-        size = timer_world->m_Timers.Size();
-        uint32_t original_size = size;
-        uint32_t i = 0;
-        while (i < size)
+        dmArray<uint32_t>& dead_timers = timer_world->m_DeadTimers;
+        if (!dead_timers.Empty())
         {
-            Timer& timer = timer_world->m_Timers[i];
-            if (timer.m_IsAlive == 0)
+            for (uint32_t i = 0; i < dead_timers.Size(); ++i)
             {
-                FreeTimer(timer_world, timer);
-                --size;
+                FreeTimer(timer_world, dead_timers[i]);
             }
-            else
-            {
-                ++i;
-            }
-        }
-
-        if (size != original_size)
-        {
+            dead_timers.SetSize(0);
             ++timer_world->m_Version;
         }
     }
@@ -286,54 +485,46 @@ namespace dmScript
         assert(timer_world != 0x0);
         assert(delay >= 0.f);
         assert(timer_callback != 0x0);
-        Timer* timer = AllocateTimer(timer_world, owner);
-        if (timer == 0x0)
+        uint32_t timer_index = AllocateTimer(timer_world, owner);
+        if (timer_index == INVALID_TIMER_INDEX)
         {
             return INVALID_TIMER_HANDLE;
         }
 
-        timer->m_Delay = delay;
-        timer->m_Remaining = delay;
-        timer->m_UserData = userdata;
-        timer->m_Callback = timer_callback;
-        timer->m_Repeat = repeat;
-        timer->m_IsAlive = 1;
+        Timer& timer = timer_world->m_Timers[timer_index];
+        timer.m_Delay = delay;
+        timer.m_Expiry = timer_world->m_Time + delay;
+        timer.m_UserData = userdata;
+        timer.m_Callback = timer_callback;
+        timer.m_Repeat = repeat;
+        timer.m_IsAlive = 1;
+        ++timer_world->m_AliveCount;
+
+        ScheduleTimer(timer_world, timer_index);
 
-        return timer->m_Handle;
+        return timer.m_Handle;
     }
 
     bool CancelTimer(HTimerWorld timer_world, HTimer handle)
     {
         assert(timer_world != 0x0);
-        uint16_t lookup_index = GetLookupIndex(handle);
-        if (lookup_index >= timer_world->m_IndexLookup.Size())
-        {
-            return false;
-        }
-
-        uint16_t timer_index = timer_world->m_IndexLookup[lookup_index];
-        if (timer_index >= timer_world->m_Timers.Size())
-        {
-            return false;
-        }
-
-        Timer& timer = timer_world->m_Timers[timer_index];
-        if (timer.m_Handle != handle)
+        Timer* timer = GetTimer(timer_world, handle);
+        if (timer == 0x0 || timer->m_IsAlive == 0)
         {
             return false;
         }
 
-        if (timer.m_IsAlive == 0)
-        {
-            return false;
-        }
+        uint32_t timer_index = GetLookupIndex(handle);
+        timer->m_IsAlive = 0;
+        --timer_world->m_AliveCount;
+        UnscheduleTimer(timer_world, timer_index);
 
-        timer.m_IsAlive = 0;
-        timer.m_Callback(timer_world, TIMER_EVENT_CANCELLED, timer.m_Handle, 0.f, timer.m_Owner, timer.m_UserData);
+        // The timer is released after the callback, so that timers added in the callback don't reuse the handle
+        timer->m_Callback(timer_world, TIMER_EVENT_CANCELLED, timer->m_Handle, 0.f, timer->m_Owner, timer->m_UserData);
+        ReleaseTimer(timer_world, timer_index);
 
         if (timer_world->m_InUpdate == 0)
         {
-            FreeTimer(timer_world, timer);
             ++timer_world->m_Version;
         }
         return true;
@@ -343,33 +534,24 @@ namespace dmScript
     {
         assert(timer_world != 0x0);
 
-        uint32_t size = timer_world->m_Timers.Size();
-        uint32_t cancelled_count = 0;
-        uint32_t timer_index = 0;
-        while (timer_index < size)
+        uint32_t* first = timer_world->m_OwnerTimers.Get(owner);
+        if (first == 0x0)
         {
-            Timer& timer = timer_world->m_Timers[timer_index];
-            if (timer.m_Owner != owner)
-            {
-                ++timer_index;
-                continue;
-            }
+            return 0;
+        }
 
-            if (timer.m_IsAlive == 1)
+        uint32_t cancelled_count = 0;
+        uint32_t timer_index = *first;
+        while (timer_index != INVALID_TIMER_INDEX)
+        {
+            // The timer may be freed (and unlinked) below
+            uint32_t next_timer_index = timer_world->m_Timers[timer_index].m_NextOwnerTimer;
+            if (timer_world->m_Timers[timer_index].m_IsAlive == 1)
             {
-                timer.m_IsAlive = 0;
+                KillTimer(timer_world, timer_index);
                 ++cancelled_count;
             }
-
-            if (timer_world->m_InUpdate == 0)
-            {
-                FreeTimer(timer_world, timer);
-                --size;
-            }
-            else
-            {
-                ++timer_index;
-            }
+            timer_index = next_timer_index;
         }
 
         if (cancelled_count > 0)
@@ -383,20 +565,7 @@ namespace dmScript
     uint32_t GetAliveTimers(HTimerWorld timer_world)
     {
         assert(timer_world != 0x0);
-
-        uint32_t alive_timers = 0u;
-        uint32_t size = timer_world->m_Timers.Size();
-        uint32_t i = 0;
-        while (i < size)
-        {
-            Timer& timer = timer_world->m_Timers[i];
-            if(timer.m_IsAlive == 1)
-            {
-                ++alive_timers;
-            }
-            ++i;
-        }
-        return alive_timers;
+        return timer_world->m_AliveCount;
     }
 
     static void SetTimerWorld(HScriptWorld script_world, HTimerWorld timer_world)
@@ -688,30 +857,21 @@ namespace dmScript
             return 1;
         }
 
-        uint16_t lookup_index = GetLookupIndex(timer_handle);
-        if (lookup_index >= timer_world->m_IndexLookup.Size())
-        {
-            lua_pushboolean(L, 0);
-            return 1;
-        }
-
-        uint16_t timer_index = timer_world->m_IndexLookup[lookup_index];
-        if (timer_index >= timer_world->m_Timers.Size())
+        Timer* timer = GetTimer(timer_world, (dmScript::HTimer)timer_handle);
+        if (timer == 0x0)
         {
             lua_pushboolean(L, 0);
             return 1;
         }
 
-        Timer& timer = timer_world->m_Timers[timer_index];
-
-        LuaCallbackInfo* callback = (LuaCallbackInfo*)timer.m_UserData;
+        LuaCallbackInfo* callback = (LuaCallbackInfo*)timer->m_UserData;
         if (!IsCallbackValid(callback))
         {
             lua_pushboolean(L, 0);
             return 1;
         }
 
-        LuaTimerCallbackArgs args = { timer.m_Handle, timer.m_Delay - timer.m_Remaining };
+        LuaTimerCallbackArgs args = { timer->m_Handle, timer->m_Delay - GetTimeRemaining(timer_world, timer) };
         InvokeCallback(callback, LuaTimerCallbackArgsCB, &args);
 
         lua_pushboolean(L, 1);
@@ -763,34 +923,19 @@ namespace dmScript
             return 1;
         }
 
-        uint16_t lookup_index = GetLookupIndex(timer_handle);
-        if (lookup_index >= timer_world->m_IndexLookup.Size())
-        {
-            lua_pushnil(L);
-            return 1;
-        }
-
-        uint16_t timer_index = timer_world->m_IndexLookup[lookup_index];
-        if (timer_index >= timer_world->m_Timers.Size())
-        {
-            lua_pushnil(L);
-            return 1;
-        }
-
-        Timer& timer = timer_world->m_Timers[timer_index];
-
-        if (timer.m_Handle != timer_handle)
+        Timer* timer = GetTimer(timer_world, (dmScript::HTimer)timer_handle);
+        if (timer == 0x0)
         {
             lua_pushnil(L);
             return 1;
         }
 
         lua_newtable(L);
-        lua_pushnumber(L,timer.m_Remaining);
+        lua_pushnumber(L,GetTimeRemaining(timer_world, timer));
         lua_setfield(L, -2, "time_remaining");
-        lua_pushnumber(L,timer.m_Delay);
+        lua_pushnumber(L,timer->m_Delay);
         lua_setfield(L, -2, "delay");
-        lua_pushboolean(L,timer.m_Repeat==1);
+        lua_pushboolean(L,timer->m_Repeat==1);
         lua_setfield(L, -2, "repeating");
         return 1;
     }
@@ -13,17 +13,109 @@
 // specific language governing permissions and limitations under the License.
 
 #include <string.h> // memcpy
+#include <math.h>
 
 #include "script.h"
+#include "script_json.h"
 #include "test_script.h"
 
 #include <testmain/testmain.h>
+#include <dlib/array.h>
+#include <dlib/dstrings.h>
 #include <dlib/log.h>
+#include <dlib/time.h>
+
+#include "data/json_corpus.txt.embed.h"
+
+extern "C"
+{
+    // Defined in luacjson/lua_cjson.c
+    int lua_cjson_decode(lua_State* L, const char* json_string, size_t json_len);
+}
 
 class ScriptJsonTest : public dmScriptTest::ScriptTest
 {
 };
 
+struct ScriptInstance
+{
+    int m_InstanceReference;
+    int m_ContextTableReference;
+};
+
+static int ScriptGetInstanceContextTableRef(lua_State* L)
+{
+    ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, 1);
+    lua_pushnumber(L, i->m_ContextTableReference);
+    return 1;
+}
+
+static int ScriptInstanceIsValid(lua_State* L)
+{
+    ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, 1);
+    lua_pushboolean(L, i != 0x0 && i->m_ContextTableReference != LUA_NOREF);
+    return 1;
+}
+
+static const luaL_reg ScriptInstance_methods[] =
+{
+    {0,0}
+};
+
+static const luaL_reg ScriptInstance_meta[] =
+{
+    {dmScript::META_TABLE_IS_VALID,                 ScriptInstanceIsValid},
+    {dmScript::META_GET_INSTANCE_CONTEXT_TABLE_REF, ScriptGetInstanceContextTableRef},
+    {0, 0}
+};
+
+// json.decode_async() callbacks need a script instance
+class ScriptJsonAsyncTest : public dmScriptTest::ScriptTest
+{
+protected:
+    virtual void SetUp()
+    {
+        dmScriptTest::ScriptTest::SetUp();
+
+        dmScript::RegisterUserType(L, "TestScriptInstance", ScriptInstance_methods, ScriptInstance_meta);
+        ScriptInstance* i = (ScriptInstance *)lua_newuserdata(L, sizeof(ScriptInstance));
+        i->m_InstanceReference = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        lua_newtable(L);
+        i->m_ContextTableReference = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, i->m_InstanceReference);
+        luaL_getmetatable(L, "TestScriptInstance");
+        lua_setmetatable(L, -2);
+        dmScript::SetInstance(L);
+
+        ASSERT_TRUE(RunString(L,
+            "results = {}\n"
+            "function on_decoded(self, data, error)\n"
+            "    results[#results + 1] = { data = data, error = error }\n"
+            "end\n"));
+    }
+
+    virtual void TearDown()
+    {
+        dmScript::GetInstance(L);
+        ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, -1);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, i->m_InstanceReference);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, i->m_ContextTableReference);
+        lua_pop(L, 1);
+        lua_pushnil(L);
+        dmScript::SetInstance(L);
+
+        dmScriptTest::ScriptTest::TearDown();
+    }
+
+    uint32_t GetResultCount()
+    {
+        lua_getglobal(L, "results");
+        uint32_t count = (uint32_t)lua_objlen(L, -1);
+        lua_pop(L, 1);
+        return count;
+    }
+};
+
 TEST_F(ScriptJsonTest, TestJson)
 {
     int top = lua_gettop(L);
@@ -107,6 +199,250 @@ TEST_F(ScriptJsonTest, TestLuaToJson)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+struct JsonInput
+{
+    const char* m_Json;
+    size_t      m_Length;
+};
+
+static int CJsonDecode(lua_State* L)
+{
+    JsonInput* input = (JsonInput*)lua_touserdata(L, 1);
+    return lua_cjson_decode(L, input->m_Json, input->m_Length);
+}
+
+// Decodes with lua-cjson, which is what the indexed decoder must match
+static bool CJsonDecode(lua_State* L, const char* json, size_t json_len)
+{
+    JsonInput input = { json, json_len };
+    lua_pushcfunction(L, CJsonDecode);
+    lua_pushlightuserdata(L, &input);
+    if (lua_pcall(L, 1, 1, 0) != 0)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+
+static bool LuaValuesEqual(lua_State* L, int a, int b)
+{
+    lua_checkstack(L, 4);
+    a = a < 0 ? lua_gettop(L) + a + 1 : a;
+    b = b < 0 ? lua_gettop(L) + b + 1 : b;
+    if (lua_type(L, a) != lua_type(L, b))
+        return false;
+
+    if (lua_type(L, a) == LUA_TNUMBER)
+    {
+        double x = lua_tonumber(L, a);
+        double y = lua_tonumber(L, b);
+        if (isnan(x) || isnan(y))
+            return isnan(x) && isnan(y);
+        return x == y && signbit(x) == signbit(y);
+    }
+    if (lua_type(L, a) != LUA_TTABLE)
+        return lua_rawequal(L, a, b);
+
+    int count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, a))
+    {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, b);
+        if (!LuaValuesEqual(L, -1, -2))
+        {
+            lua_pop(L, 3);
+            return false;
+        }
+        lua_pop(L, 2);
+        ++count;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, b))
+    {
+        lua_pop(L, 1);
+        --count;
+    }
+    return count == 0;
+}
+
+// Each line is "<y|n|i> <json>": y for valid json, n for json that lua-cjson rejects,
+// and i for invalid json that lua-cjson still accepts (e.g. hex numbers and inf)
+TEST_F(ScriptJsonTest, TestJsonCorpus)
+{
+    int top = lua_gettop(L);
+
+    const char* corpus = (const char*)JSON_CORPUS_TXT;
+    const char* corpus_end = corpus + JSON_CORPUS_TXT_SIZE;
+    uint32_t num_tests = 0;
+    while (corpus < corpus_end)
+    {
+        const char* line_end = (const char*)memchr(corpus, '\n', corpus_end - corpus);
+        if (!line_end)
+            line_end = corpus_end;
+        ASSERT_LE(2, (int)(line_end - corpus));
+
+        char expected = corpus[0];
+        size_t json_len = line_end - corpus - 2;
+        // A separate allocation, so that ASAN can catch reads outside of the json
+        char* json = (char*)malloc(json_len + 1);
+        memcpy(json, corpus + 2, json_len);
+        json[json_len] = 0;
+
+        bool decoded = dmScript::DecodeJson(L, json, json_len);
+        bool cjson_decoded = CJsonDecode(L, json, json_len);
+        if (expected == 'n')
+        {
+            ASSERT_FALSE(decoded);
+            ASSERT_FALSE(cjson_decoded);
+        }
+        else
+        {
+            ASSERT_TRUE(decoded);
+            ASSERT_TRUE(cjson_decoded);
+            ASSERT_TRUE(LuaValuesEqual(L, -1, -2));
+            lua_pop(L, 2);
+        }
+        ASSERT_EQ(top, lua_gettop(L));
+
+        free(json);
+        corpus = line_end + 1;
+        ++num_tests;
+    }
+    ASSERT_LT(100u, num_tests);
+}
+
+static void MakeLargeJson(dmArray<char>& json, uint32_t count)
+{
+    const char* begin = "{\"items\":[";
+    json.SetCapacity(count * 128);
+    json.PushArray(begin, strlen(begin));
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        char item[128];
+        dmSnPrintf(item, sizeof(item), "%s\n  {\"id\": %u, \"name\": \"item \\\"%u\\\"\", \"position\": [%u.5, -%u.125, 0], \"enabled\": %s}",
+                    i ? "," : "", i, i, i, i, (i & 1) ? "true" : "false");
+        json.PushArray(item, strlen(item));
+    }
+    const char* end = "], \"count\": null}";
+    json.PushArray(end, strlen(end));
+}
+
+TEST_F(ScriptJsonTest, TestJsonIncremental)
+{
+    int top = lua_gettop(L);
+
+    dmArray<char> json;
+    MakeLargeJson(json, 5000);
+
+    ASSERT_TRUE(CJsonDecode(L, json.Begin(), json.Size()));
+
+    const uint32_t budgets[] = { 1, 7, 100, 1000000 };
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(budgets); ++i)
+    {
+        dmScript::HJsonDecoder decoder = dmScript::NewJsonDecoder(L, json.Begin(), json.Size());
+        ASSERT_NE((dmScript::HJsonDecoder)0, decoder);
+
+        dmScript::JsonDecodeResult result;
+        while ((result = dmScript::JsonDecoderStep(decoder, budgets[i])) == dmScript::JSON_DECODE_RESULT_PENDING)
+        {
+            ASSERT_EQ(top + 1, lua_gettop(L));
+            lua_gc(L, LUA_GCSTEP, 10);
+        }
+        dmScript::DeleteJsonDecoder(decoder);
+
+        ASSERT_EQ(dmScript::JSON_DECODE_RESULT_OK, result);
+        ASSERT_EQ(top + 2, lua_gettop(L));
+        ASSERT_TRUE(LuaValuesEqual(L, -1, -2));
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    const char* invalid = "[1, 2, {\"a\": x}]";
+    dmScript::HJsonDecoder decoder = dmScript::NewJsonDecoder(L, invalid, strlen(invalid));
+    dmScript::JsonDecodeResult result;
+    while ((result = dmScript::JsonDecoderStep(decoder, 1)) == dmScript::JSON_DECODE_RESULT_PENDING)
+    {
+    }
+    dmScript::DeleteJsonDecoder(decoder);
+    ASSERT_EQ(dmScript::JSON_DECODE_RESULT_ERROR, result);
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptJsonTest, TestJsonDecodePerformance)
+{
+    int top = lua_gettop(L);
+
+    dmArray<char> json;
+    MakeLargeJson(json, 50000);
+
+    const uint32_t iterations = 4;
+    uint64_t cjson_time = 0;
+    uint64_t indexed_time = 0;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        uint64_t start = dmTime::GetTime();
+        ASSERT_TRUE(CJsonDecode(L, json.Begin(), json.Size()));
+        cjson_time += dmTime::GetTime() - start;
+        lua_pop(L, 1);
+
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        start = dmTime::GetTime();
+        ASSERT_EQ(1, dmScript::JsonToLua(L, json.Begin(), json.Size()));
+        indexed_time += dmTime::GetTime() - start;
+        lua_pop(L, 1);
+    }
+
+    double mb = json.Size() * iterations / (1024.0 * 1024.0);
+    printf("json.decode %.1f MB: lua-cjson %.1f MB/s, indexed %.1f MB/s\n", json.Size() / (1024.0 * 1024.0),
+            mb / (cjson_time / 1000000.0), mb / (indexed_time / 1000000.0));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptJsonAsyncTest, TestJsonDecodeAsync)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(RunString(L,
+        "json.decode_async('{\"a\": [1, 2, {\"b\": \"c\"}], \"d\": true}', on_decoded, { values_per_frame = 1 })\n"
+        "json.decode_async('[1, 2, {\"a\": x}]', on_decoded)\n"
+        // The callbacks are only invoked from the update
+        "assert(#results == 0)\n"));
+
+    // The invalid json fails in the first update, the valid one is decoded one value at a time
+    dmScript::Update(m_Context);
+    ASSERT_EQ(1u, GetResultCount());
+    ASSERT_TRUE(RunString(L,
+        "assert(results[1].data == nil)\n"
+        "assert(results[1].error:find(\"Expected value\"))\n"));
+
+    uint32_t updates = 1;
+    while (GetResultCount() < 2 && updates < 100)
+    {
+        dmScript::Update(m_Context);
+        ++updates;
+    }
+    ASSERT_LT(2u, updates);
+    ASSERT_TRUE(RunString(L,
+        "assert(#results == 2)\n"
+        "assert(results[2].error == nil)\n"
+        "local data = results[2].data\n"
+        "assert(#data.a == 3 and data.a[1] == 1 and data.a[3].b == \"c\")\n"
+        "assert(data.d == true)\n"));
+
+    // Pending requests are dropped when the context is finalized
+    ASSERT_TRUE(RunString(L, "json.decode_async('[1, 2, 3]', on_decoded, { values_per_frame = 1 })"));
+
+    ASSERT_FALSE(RunString(L, "json.decode_async('[]')"));
+    lua_pop(L, 1); // The error message
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
@@ -15,11 +15,14 @@
 #include "script.h"
 #include "test_script.h"
 #include "test_script_private.h"
+#include "script_alloc.h"
 
 #include <testmain/testmain.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/time.h>
 
+#include <assert.h>
 #include <string.h>
 #include <setjmp.h>
 
@@ -1067,6 +1070,74 @@ TEST_F(ScriptTestLua, LuaBooleanFunctions)
 
 #undef USE_PANIC_FN
 
+TEST_F(ScriptTestLua, LuaMemoryStats)
+{
+    dmScript::LuaMemoryStats stats;
+    dmScript::GetLuaMemoryStats(m_Context, &stats);
+    ASSERT_LT(0u, stats.m_LiveBytes);
+    uint64_t live_bytes = stats.m_LiveBytes;
+
+    ASSERT_TRUE(RunString(L, "g_tables = {}; for i=1,1000 do g_tables[i] = { i, tostring(i) } end"));
+
+    dmScript::GetLuaMemoryStats(m_Context, &stats);
+    ASSERT_LT(live_bytes, stats.m_LiveBytes);
+
+    if (stats.m_SlabBytes != 0)
+    {
+        ASSERT_LE(stats.m_LiveBytes, stats.m_PeakBytes);
+        ASSERT_LT(1000u, stats.m_FrameAllocations);
+
+        dmScript::Update(m_Context);
+        dmScript::GetLuaMemoryStats(m_Context, &stats);
+        ASSERT_EQ(0u, stats.m_FrameAllocations);
+    }
+
+    ASSERT_TRUE(RunString(L, "g_tables = nil; collectgarbage()"));
+    ASSERT_TRUE(RunString(L, "local stats = sys.get_lua_memory_stats(); assert(stats.live_bytes > 0); assert(stats.slab_bytes >= 0)"));
+}
+
+static const char* LUA_ALLOCATION_BENCH =
+    "local t = {}\n"
+    "for frame=1,50 do\n"
+    "    for i=1,2000 do\n"
+    "        t[i] = { x = i, y = frame, name = \"n\" .. i }\n"
+    "    end\n"
+    "    for i=1,2000 do\n"
+    "        t[i] = nil\n"
+    "    end\n"
+    "end\n";
+
+static uint64_t RunLuaAllocationBench(lua_State* L)
+{
+    luaL_openlibs(L);
+    uint64_t start = dmTime::GetTime();
+    int ret = luaL_dostring(L, LUA_ALLOCATION_BENCH);
+    uint64_t elapsed = dmTime::GetTime() - start;
+    assert(ret == 0);
+    (void) ret;
+    lua_close(L);
+    return elapsed;
+}
+
+TEST(ScriptLuaAlloc, Bench)
+{
+    dmScript::HLuaAllocator allocator = dmScript::NewLuaAllocator();
+    lua_State* L = lua_newstate(dmScript::LuaAlloc, allocator);
+    if (!L)
+    {
+        dmScript::DeleteLuaAllocator(allocator);
+        printf("Custom Lua allocators aren't supported on this platform\n");
+        return;
+    }
+
+    uint64_t slab_time = RunLuaAllocationBench(L);
+    dmScript::DeleteLuaAllocator(allocator);
+
+    uint64_t default_time = RunLuaAllocationBench(lua_open());
+
+    printf("Lua allocation benchmark: default allocator %.3f ms, slab allocator %.3f ms\n", default_time / 1000.0f, slab_time / 1000.0f);
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
@@ -19,8 +19,14 @@
 #include <script/lua_source_ddf.h>
 
 #include <testmain/testmain.h>
+#include <dlib/array.h>
+#include <dlib/dstrings.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/path.h>
+#include <dlib/sys.h>
+#include <dlib/testutil.h>
+#include <dlib/time.h>
 
 class ScriptModuleTest : public dmScriptTest::ScriptTest
 {
@@ -135,6 +141,225 @@ TEST_F(ScriptModuleTest, TestReloadNotLoaded)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+static void MakeLuaSource(dmLuaDDF::LuaSource* source, const char* text, const char* filename)
+{
+    memset(source, 0x00, sizeof(*source));
+    source->m_Script.m_Data = (uint8_t*)text;
+    source->m_Script.m_Count = strlen(text);
+    source->m_Filename = filename;
+}
+
+static int ArrayWriter(lua_State* L, const void* p, size_t size, void* ud)
+{
+    dmArray<uint8_t>* buffer = (dmArray<uint8_t>*) ud;
+    buffer->OffsetCapacity(size);
+    buffer->PushArray((const uint8_t*) p, size);
+    return 0;
+}
+
+struct CacheFiles
+{
+    char        m_Path[DMPATH_MAX_PATH];
+    uint32_t    m_Count;
+};
+
+static void CacheFileCallback(void* ctx, const char* path, bool isdir)
+{
+    CacheFiles* files = (CacheFiles*) ctx;
+    if (!isdir)
+    {
+        dmStrlCpy(files->m_Path, path, sizeof(files->m_Path));
+        ++files->m_Count;
+    }
+}
+
+static void GetCacheFiles(const char* dir, CacheFiles* files)
+{
+    files->m_Count = 0;
+    dmSys::IterateTree(dir, false, true, files, CacheFileCallback);
+}
+
+static void ResetBytecodeCacheDir(char* path, uint32_t path_size)
+{
+    dmTestUtil::MakeHostPath(path, path_size, "build/src/test/bytecode_cache");
+    if (dmSys::Exists(path))
+    {
+        dmSys::RmTree(path);
+    }
+    dmSys::Mkdir(path, 0755);
+}
+
+static int LoadAndCall(lua_State* L, dmLuaDDF::LuaSource* source)
+{
+    if (dmScript::LuaLoad(L, source) != 0)
+    {
+        lua_pop(L, 1);
+        return -1;
+    }
+    lua_call(L, 0, 1);
+    int result = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return result;
+}
+
+TEST_F(ScriptModuleTest, TestBytecodeCache)
+{
+    int top = lua_gettop(L);
+    char path[DMPATH_MAX_PATH];
+    ResetBytecodeCacheDir(path, sizeof(path));
+    dmScript::SetBytecodeCachePath(m_Context, path);
+
+    dmLuaDDF::LuaSource source;
+    MakeLuaSource(&source, "return 1", "/cached.lua");
+    ASSERT_EQ(dmScript::RESULT_OK, dmScript::AddModule(m_Context, &source, "cached", 0, dmHashString64("/cached.lua")));
+    ASSERT_TRUE(RunString(L, "assert(require('cached') == 1)"));
+
+    // One file per chunk
+    CacheFiles files;
+    GetCacheFiles(path, &files);
+    ASSERT_EQ(1u, files.m_Count);
+    ASSERT_EQ(1, LoadAndCall(L, &source));
+    GetCacheFiles(path, &files);
+    ASSERT_EQ(1u, files.m_Count);
+
+    // Changed source is compiled again
+    MakeLuaSource(&source, "return 2", "/cached.lua");
+    ASSERT_EQ(2, LoadAndCall(L, &source));
+    ASSERT_EQ(2, LoadAndCall(L, &source));
+
+    // Damaged files are replaced
+    FILE* file = fopen(files.m_Path, "r+b");
+    ASSERT_NE((FILE*) 0, file);
+    fseek(file, -1, SEEK_END);
+    int c = fgetc(file);
+    fseek(file, -1, SEEK_END);
+    fputc(c ^ 0xff, file);
+    fclose(file);
+    ASSERT_EQ(2, LoadAndCall(L, &source));
+
+    file = fopen(files.m_Path, "wb");
+    ASSERT_NE((FILE*) 0, file);
+    fputs("DMLC", file);
+    fclose(file);
+    ASSERT_EQ(2, LoadAndCall(L, &source));
+    ASSERT_EQ(2, LoadAndCall(L, &source));
+
+    // Errors are reported as without the cache
+    MakeLuaSource(&source, "return (", "/cached.lua");
+    ASSERT_NE(0, dmScript::LuaLoad(L, &source));
+    lua_pop(L, 1);
+
+    dmScript::SetBytecodeCachePath(m_Context, 0);
+    dmSys::RmTree(path);
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptModuleTest, TestBytecodeFallback)
+{
+    int top = lua_gettop(L);
+
+    // Bytecode for another Lua VM
+    dmLuaDDF::LuaSource source;
+    MakeLuaSource(&source, "return 3", "/fallback.lua");
+    const char* other_bytecode = "\033XYZ bytecode";
+    source.m_Bytecode.m_Data = (uint8_t*) other_bytecode;
+    source.m_Bytecode.m_Count = strlen(other_bytecode);
+    ASSERT_EQ(3, LoadAndCall(L, &source));
+
+    // Bytecode that the running VM fails to load
+    dmArray<uint8_t> bytecode;
+    ASSERT_EQ(0, luaL_loadstring(L, "return 4"));
+    lua_dump(L, ArrayWriter, &bytecode);
+    lua_pop(L, 1);
+    source.m_Bytecode.m_Data = bytecode.Begin();
+    source.m_Bytecode.m_Count = bytecode.Size();
+    ASSERT_EQ(4, LoadAndCall(L, &source));
+    source.m_Bytecode.m_Count = bytecode.Size() / 2;
+    ASSERT_EQ(3, LoadAndCall(L, &source));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+static uint64_t RequireModules(const char* cache_path, const char** sources, uint32_t module_count)
+{
+    dmScript::HContext context = dmScript::NewContext(0, 0, true);
+    dmScript::Initialize(context);
+    dmScript::SetBytecodeCachePath(context, cache_path);
+    lua_State* L = dmScript::GetLuaState(context);
+
+    char name[64];
+    char filename[64];
+    for (uint32_t i = 0; i < module_count; ++i)
+    {
+        dmSnPrintf(name, sizeof(name), "perf.module%u", i);
+        dmSnPrintf(filename, sizeof(filename), "/perf/module%u.lua", i);
+        dmLuaDDF::LuaSource source;
+        MakeLuaSource(&source, sources[i], filename);
+        dmScript::AddModule(context, &source, name, 0, dmHashString64(filename));
+    }
+
+    uint64_t time = dmTime::GetTime();
+    for (uint32_t i = 0; i < module_count; ++i)
+    {
+        lua_getglobal(L, "require");
+        lua_pushfstring(L, "perf.module%d", (int) i);
+        lua_call(L, 1, 1);
+        lua_pop(L, 1);
+    }
+    time = dmTime::GetTime() - time;
+
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+    return time;
+}
+
+TEST_F(ScriptModuleTest, TestBytecodeCachePerf)
+{
+    const uint32_t module_count = 2000;
+    const uint32_t function_count = 20;
+
+    const char** sources = new const char*[module_count];
+    for (uint32_t i = 0; i < module_count; ++i)
+    {
+        dmArray<char> source;
+        source.SetCapacity(function_count * 256);
+        char line[256];
+        for (uint32_t j = 0; j < function_count + 2; ++j)
+        {
+            if (j == 0)
+                dmSnPrintf(line, sizeof(line), "local M = { id = %u }\n", i);
+            else if (j <= function_count)
+                dmSnPrintf(line, sizeof(line), "function M.f%u(a, b)\n    local t = {}\n    for i = 1, a do t[i] = (i * b + %u) %% 7 end\n    return t, \"module%u\"\nend\n", j, j, i);
+            else
+                dmSnPrintf(line, sizeof(line), "return M\n");
+            source.PushArray(line, strlen(line));
+        }
+        source.Push(0);
+        sources[i] = strdup(source.Begin());
+    }
+
+    char path[DMPATH_MAX_PATH];
+    ResetBytecodeCacheDir(path, sizeof(path));
+
+    uint64_t source_time = RequireModules(0, sources, module_count);
+    uint64_t cold_time = RequireModules(path, sources, module_count);
+    uint64_t warm_time = RequireModules(path, sources, module_count);
+
+    CacheFiles files;
+    GetCacheFiles(path, &files);
+    ASSERT_EQ(module_count, files.m_Count);
+
+    printf("Require %u modules: source %.3f ms, cold bytecode cache %.3f ms, warm bytecode cache %.3f ms\n",
+        module_count, source_time / 1000.0, cold_time / 1000.0, warm_time / 1000.0);
+
+    dmSys::RmTree(path);
+    for (uint32_t i = 0; i < module_count; ++i)
+    {
+        free((void*) sources[i]);
+    }
+    delete [] sources;
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
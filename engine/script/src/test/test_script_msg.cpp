@@ -656,6 +656,128 @@ TEST_F(ScriptMsgTest, TestPost)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+static void DispatchCallbackPushTable(dmMessage::Message *message, void* user_ptr)
+{
+    lua_State* L = (lua_State*)user_ptr;
+    dmScript::PushTable(L, (const char*)message->m_Data, message->m_DataSize);
+    lua_setglobal(L, "received");
+}
+
+TEST_F(ScriptMsgTest, TestPostTableReference)
+{
+    int top = lua_gettop(L);
+    int ref_count = dmScript::GetLuaRefCount();
+
+    // Tables to a component in the same collection are handed over, not serialized
+    ASSERT_TRUE(dmScriptTest::RunString(L,
+        "sent = {1, 2, x = \"x\", v = vmath.vector3(1, 2, 3), h = hash(\"h\"), u = msg.url(), t = {t = {true}}, [-2.5] = -2, [3.5] = 3}\n"
+        "msg.post(\"#fragment\", \"table\", sent)\n"
+        "sent.x = \"changed\"\n"
+        "sent.v.x = 10\n"
+        "sent.t.t[1] = false\n"
+        ));
+    ASSERT_EQ(ref_count + 1, dmScript::GetLuaRefCount());
+    ASSERT_EQ(1u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, L));
+    ASSERT_EQ(ref_count, dmScript::GetLuaRefCount());
+    // Same result as a serialized table
+    ASSERT_TRUE(dmScriptTest::RunString(L,
+        "assert(received ~= sent)\n"
+        "assert(received[1] == 1 and received[2] == 2)\n"
+        "assert(received.x == \"x\")\n"
+        "assert(received.v == vmath.vector3(1, 2, 3))\n"
+        "assert(received.h == hash(\"h\"))\n"
+        "assert(received.u == msg.url())\n"
+        "assert(received.t.t[1] == true)\n"
+        "assert(received[-2] == -2)\n"
+        "assert(received[3] == 3)\n"
+        ));
+
+    // No size limit
+    ASSERT_TRUE(dmScriptTest::RunString(L,
+        "large = {}\n"
+        "for i = 1,10000 do large[i] = \"value\" .. i end\n"
+        "msg.post(\"#fragment\", \"table\", large)\n"
+        ));
+    ASSERT_EQ(1u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, L));
+    ASSERT_TRUE(dmScriptTest::RunString(L, "assert(#received == 10000 and received[10000] == \"value10000\")"));
+
+    // Same restrictions as serialized tables
+    ASSERT_FALSE(dmScriptTest::RunString(L, "msg.post(\"#fragment\", \"table\", {f = print})"));
+    ASSERT_FALSE(dmScriptTest::RunString(L, "local t = {} t.t = t msg.post(\"#fragment\", \"table\", t)"));
+    ASSERT_FALSE(dmScriptTest::RunString(L, "msg.post(\"#fragment\", \"table\", {[true] = 1})"));
+    ASSERT_EQ(0u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, L));
+
+    // Copied to receivers in other contexts
+    dmScript::HContext context = dmScript::NewContext(0, 0, true);
+    dmScript::Initialize(context);
+    lua_State* other_L = dmScript::GetLuaState(context);
+    int other_ref_count = dmScript::GetLuaRefCount();
+    ASSERT_TRUE(dmScriptTest::RunString(L, "msg.post(\"#fragment\", \"table\", sent)"));
+    ASSERT_EQ(1u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, other_L));
+    ASSERT_EQ(other_ref_count, dmScript::GetLuaRefCount());
+    ASSERT_TRUE(dmScriptTest::RunString(other_L,
+        "assert(received.x == \"changed\")\n"
+        "assert(received.v == vmath.vector3(10, 2, 3))\n"
+        "assert(received.h == hash(\"h\"))\n"
+        "assert(received.t.t[1] == false)\n"
+        ));
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+
+    // Released when not received
+    ASSERT_TRUE(dmScriptTest::RunString(L, "msg.post(\"#fragment\", \"table\", sent)"));
+    ASSERT_EQ(1u, dmMessage::Consume(m_DefaultURL.m_Socket));
+    ASSERT_EQ(ref_count, dmScript::GetLuaRefCount());
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptMsgTest, TestPerfTable)
+{
+    dmMessage::HSocket socket;
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::NewSocket("socket", &socket));
+
+    // Tables to the default socket are passed by reference, to other sockets they are serialized
+    const char* payloads[] = {
+        "{x = 1, y = 2, id = hash(\"id\")}",
+        "(function() local t = {} for i = 1,40 do t[i] = {i, \"item\" .. i} end return t end)()",
+        "(function() local t = {} for i = 1,6 do t = {child = t, v = vmath.vector3(i), s = \"level\" .. i} end return t end)()",
+    };
+    const char* payload_names[] = { "small", "large", "nested" };
+    const char* receivers[] = { "#fragment", "socket:/path#fragment" };
+    dmMessage::HSocket receiver_sockets[] = { m_DefaultURL.m_Socket, socket };
+    const char* receiver_names[] = { "reference", "serialized" };
+
+    uint32_t count = 1000;
+    for (uint32_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); ++p)
+    {
+        for (uint32_t r = 0; r < sizeof(receivers) / sizeof(receivers[0]); ++r)
+        {
+            char program[512];
+            dmSnPrintf(program, sizeof(program), "payload = %s", payloads[p]);
+            ASSERT_TRUE(dmScriptTest::RunString(L, program));
+            dmSnPrintf(program, sizeof(program), "msg.post(\"%s\", \"table\", payload)", receivers[r]);
+
+            uint64_t time = dmTime::GetTime();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                lua_getglobal(L, "msg");
+                lua_getfield(L, -1, "post");
+                lua_pushstring(L, receivers[r]);
+                lua_pushstring(L, "table");
+                lua_getglobal(L, "payload");
+                ASSERT_EQ(0, lua_pcall(L, 3, 0, 0));
+                lua_pop(L, 1);
+                ASSERT_EQ(1u, dmMessage::Dispatch(receiver_sockets[r], DispatchCallbackPushTable, L));
+            }
+            time = dmTime::GetTime() - time;
+            printf("Time per %s table message (%s): %.4f us\n", payload_names[p], receiver_names[r], time / (double)count);
+        }
+    }
+
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::DeleteSocket(socket));
+}
+
 TEST_F(ScriptMsgTest, TestFailPost)
 {
     int top = lua_gettop(L);
@@ -739,6 +861,69 @@ TEST_F(ScriptMsgTest, TestPerf)
     printf("Time per post: %.4f\n", time / (double)count);
 }
 
+// Posting to string URLs is expected to be as fast as posting to URL objects, since the resolved URLs are cached
+TEST_F(ScriptMsgTest, TestPerfStringURL)
+{
+    uint32_t count = 10000;
+    char program[512];
+    dmSnPrintf(program, sizeof(program),
+        "local count = %u\n"
+        "local url = msg.url(\"test_path#test_fragment\")\n"
+        "local id = hash(\"test_message\")\n"
+        "local t = os.clock()\n"
+        "for i = 1,count do\n"
+        "    msg.post(url, id)\n"
+        "end\n"
+        "print(string.format(\"Time per post (url, hash): %%.4f us\", (os.clock() - t) * 1000000 / count))\n"
+        "t = os.clock()\n"
+        "for i = 1,count do\n"
+        "    msg.post(\"test_path#test_fragment\", \"test_message\")\n"
+        "end\n"
+        "print(string.format(\"Time per post (string, string): %%.4f us\", (os.clock() - t) * 1000000 / count))\n",
+        count);
+    ASSERT_TRUE(dmScriptTest::RunString(L, program));
+    dmMessage::Consume(m_DefaultURL.m_Socket);
+}
+
+TEST_F(ScriptMsgTest, TestURLCache)
+{
+    // Relative URLs are resolved against the current default URL
+    ASSERT_TRUE(dmScriptTest::RunString(L,
+        "local url = msg.url(\"test_path#test_fragment\")\n"
+        "assert(url.socket == __default_url.socket, \"invalid socket\")\n"
+        "assert(url.path == hash(\"test_path\"), \"invalid path\")\n"
+        "assert(url.fragment == hash(\"test_fragment\"), \"invalid fragment\")\n"
+        "url = msg.url(\"#\")\n"
+        "assert(url.fragment == hash(\"default_fragment\"), \"invalid fragment\")\n"
+        "__default_url = msg.url(\"default_socket:other_path#other_fragment\")\n"
+        "url = msg.url(\"#\")\n"
+        "assert(url.path == hash(\"other_path\"), \"invalid path\")\n"
+        "assert(url.fragment == hash(\"other_fragment\"), \"invalid fragment\")\n"
+        ));
+
+    // Global URLs to sockets created after the URL was first used
+    ASSERT_FALSE(dmScriptTest::RunString(L, "msg.post(\"test_socket:/test_path\", \"test_message\")"));
+    dmMessage::HSocket socket;
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::NewSocket("test_socket", &socket));
+    ASSERT_TRUE(dmScriptTest::RunString(L, "msg.post(\"test_socket:/test_path\", \"test_message\")"));
+    ASSERT_EQ(1u, dmMessage::Consume(socket));
+    dmMessage::DeleteSocket(socket);
+    ASSERT_FALSE(dmScriptTest::RunString(L, "msg.post(\"test_socket:/test_path\", \"test_message\")"));
+
+    // Beyond the capacity of the cache
+    ASSERT_TRUE(dmScriptTest::RunString(L,
+        "for i = 1,2000 do\n"
+        "    local url = msg.url(\"path_\" .. i .. \"#fragment\")\n"
+        "    assert(url.path == hash(\"path_\" .. i), \"invalid path\")\n"
+        "end\n"
+        "collectgarbage()\n"
+        "for i = 1,2000 do\n"
+        "    local url = msg.url(\"path_\" .. i .. \"#fragment\")\n"
+        "    assert(url.path == hash(\"path_\" .. i), \"invalid path\")\n"
+        "end\n"
+        ));
+}
+
 TEST_F(ScriptMsgTest, TestPostDeletedSocket)
 {
     dmMessage::HSocket socket;
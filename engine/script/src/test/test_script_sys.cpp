@@ -17,11 +17,105 @@
 
 #include <testmain/testmain.h>
 #include <dlib/log.h>
+#include <dlib/time.h>
 
 class ScriptSysTest : public dmScriptTest::ScriptTest
 {
 };
 
+struct ScriptInstance
+{
+    int m_InstanceReference;
+    int m_ContextTableReference;
+};
+
+static int ScriptGetInstanceContextTableRef(lua_State* L)
+{
+    ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, 1);
+    lua_pushnumber(L, i->m_ContextTableReference);
+    return 1;
+}
+
+static int ScriptInstanceIsValid(lua_State* L)
+{
+    ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, 1);
+    lua_pushboolean(L, i != 0x0 && i->m_ContextTableReference != LUA_NOREF);
+    return 1;
+}
+
+static const luaL_reg ScriptInstance_methods[] =
+{
+    {0,0}
+};
+
+static const luaL_reg ScriptInstance_meta[] =
+{
+    {dmScript::META_TABLE_IS_VALID,                 ScriptInstanceIsValid},
+    {dmScript::META_GET_INSTANCE_CONTEXT_TABLE_REF, ScriptGetInstanceContextTableRef},
+    {0, 0}
+};
+
+class ScriptSysSaveTest : public dmScriptTest::ScriptTest
+{
+protected:
+    virtual void SetUp()
+    {
+        dmScriptTest::ScriptTest::SetUp();
+
+        dmScript::RegisterUserType(L, "TestScriptInstance", ScriptInstance_methods, ScriptInstance_meta);
+        ScriptInstance* i = (ScriptInstance *)lua_newuserdata(L, sizeof(ScriptInstance));
+        i->m_InstanceReference = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        lua_newtable(L);
+        i->m_ContextTableReference = dmScript::Ref(L, LUA_REGISTRYINDEX);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, i->m_InstanceReference);
+        luaL_getmetatable(L, "TestScriptInstance");
+        lua_setmetatable(L, -2);
+        dmScript::SetInstance(L);
+
+        ASSERT_TRUE(RunString(L,
+            "file = sys.get_save_file(\"my_game\", \"save_async.save\")\n"
+            "os.remove(file)\n"
+            "function on_saved(self, filename, success, error)\n"
+            "    saved = { filename = filename, success = success, error = error }\n"
+            "end\n"));
+    }
+
+    virtual void TearDown()
+    {
+        dmScript::GetInstance(L);
+        ScriptInstance* i = (ScriptInstance*)lua_touserdata(L, -1);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, i->m_InstanceReference);
+        dmScript::Unref(L, LUA_REGISTRYINDEX, i->m_ContextTableReference);
+        lua_pop(L, 1);
+        lua_pushnil(L);
+        dmScript::SetInstance(L);
+
+        dmScriptTest::ScriptTest::TearDown();
+    }
+
+    // Update the context until the on_saved callback is invoked, returns the number of updates
+    uint32_t WaitForSave()
+    {
+        uint32_t updates = 0;
+        for (;;)
+        {
+            dmScript::Update(m_Context);
+            ++updates;
+
+            lua_getglobal(L, "saved");
+            bool saved = !lua_isnil(L, -1);
+            lua_pop(L, 1);
+            if (saved || updates == 10000)
+            {
+                break;
+            }
+            dmTime::Sleep(1000);
+        }
+        RunString(L, "last_saved = saved saved = nil");
+        return updates;
+    }
+};
+
 TEST_F(ScriptSysTest, TestSys)
 {
     int top = lua_gettop(L);
@@ -46,6 +140,204 @@ TEST_F(ScriptSysTest, TestSys)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+TEST_F(ScriptSysSaveTest, TestSaveAsync)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(RunString(L,
+        "data = { 1, 2, name = \"name\", v = vmath.vector3(1, 2, 3), t = { h = hash(\"h\") } }\n"
+        "sys.save_async(file, data, on_saved)\n"
+        // Changes made after the call are not saved
+        "data.name = \"changed\"\n"));
+    WaitForSave();
+    ASSERT_TRUE(RunString(L,
+        "assert(last_saved.filename == file)\n"
+        "assert(last_saved.success == true)\n"
+        "assert(last_saved.error == nil)\n"
+        "local loaded = sys.load(file)\n"
+        "assert(loaded[1] == 1 and loaded[2] == 2)\n"
+        "assert(loaded.name == \"name\")\n"
+        "assert(loaded.v == vmath.vector3(1, 2, 3))\n"
+        "assert(loaded.t.h == hash(\"h\"))\n"));
+
+    // Without callback
+    ASSERT_TRUE(RunString(L, "sys.save_async(file, { name = \"no callback\" })"));
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        dmScript::Update(m_Context);
+        ASSERT_TRUE(RunString(L, "written = sys.load(file).name == \"no callback\""));
+        lua_getglobal(L, "written");
+        bool written = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        if (written)
+            break;
+        dmTime::Sleep(1000);
+    }
+    ASSERT_TRUE(RunString(L, "assert(written)"));
+
+    // Errors are raised right away, as for sys.save
+    ASSERT_FALSE(RunString(L, "sys.save_async(file, { f = print }, on_saved)"));
+    lua_pop(L, 1); // The error message
+    ASSERT_FALSE(RunString(L, "local t = {} t.t = t sys.save_async(file, t, on_saved)"));
+    lua_pop(L, 1);
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptSysSaveTest, TestSaveAsyncCompressed)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(RunString(L,
+        "data = {}\n"
+        "for i = 1,1000 do data[i] = { name = \"item\", value = i } end\n"
+        "sys.save_async(file, data, on_saved, { compress = true })\n"));
+    WaitForSave();
+    ASSERT_TRUE(RunString(L,
+        "assert(last_saved.success == true)\n"
+        "local f = io.open(file, \"rb\")\n"
+        "local content = f:read(\"*all\")\n"
+        "f:close()\n"
+        "assert(content:sub(1, 4) == \"DLZ4\")\n"
+        "assert(#content < #sys.serialize(data) / 2)\n"
+        "local loaded = sys.load(file)\n"
+        "assert(#loaded == 1000)\n"
+        "assert(loaded[1000].name == \"item\" and loaded[1000].value == 1000)\n"));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptSysSaveTest, TestSaveAsyncChunked)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(RunString(L,
+        "data = {}\n"
+        "for i = 1,1000 do data[i] = { name = \"item\", value = i } end\n"
+        "sys.save_async(file, data, on_saved, { chunked = true, chunk_size = 1024 })\n"
+        // The entries of the table are copied
+        "data.added = true\n"
+        "data[1] = nil\n"));
+    ASSERT_LT(10u, WaitForSave());
+    ASSERT_TRUE(RunString(L,
+        "assert(last_saved.success == true)\n"
+        "local loaded = sys.load(file)\n"
+        "assert(#loaded == 1000)\n"
+        "assert(loaded[1].value == 1 and loaded[1000].value == 1000)\n"
+        "assert(loaded.added == nil)\n"));
+
+    // Requests are written in order, a save made after a chunked save is written after it
+    ASSERT_TRUE(RunString(L,
+        "sys.save_async(file, { 1, 2, 3 }, nil, { chunked = true, chunk_size = 1 })\n"
+        "sys.save_async(file, { name = \"last\" }, on_saved)\n"));
+    WaitForSave();
+    ASSERT_TRUE(RunString(L, "assert(sys.load(file).name == \"last\")"));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptSysSaveTest, TestSaveAsyncFailureKeepsFile)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(RunString(L, "sys.save(file, { name = \"old\" })"));
+
+    // The unsupported value is found in a later chunk, after the save has started
+    ASSERT_TRUE(RunString(L,
+        "data = {}\n"
+        "for i = 1,100 do data[i] = { name = \"item\", value = i } end\n"
+        "sys.save_async(file, data, on_saved, { chunked = true, chunk_size = 64 })\n"
+        "data[100].value = print\n"));
+    dmScript::Update(m_Context);
+    ASSERT_TRUE(RunString(L, "assert(sys.load(file).name == \"old\")"));
+    WaitForSave();
+    ASSERT_TRUE(RunString(L,
+        "assert(last_saved.success == false)\n"
+        "assert(last_saved.error:find(\"unsupported value type in table\"))\n"
+        "assert(sys.load(file).name == \"old\")\n"));
+
+    // Unwritable location
+    ASSERT_TRUE(RunString(L,
+        "sys.save_async(file .. \"_dir/does_not_exist/file\", { name = \"new\" }, on_saved)\n"));
+    WaitForSave();
+    ASSERT_TRUE(RunString(L,
+        "assert(last_saved.success == false)\n"
+        "assert(last_saved.error ~= nil)\n"
+        "assert(sys.load(file).name == \"old\")\n"));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptSysSaveTest, TestSaveAsyncFinalize)
+{
+    // Pending requests are written when the context is finalized
+    ASSERT_TRUE(RunString(L,
+        "data = {}\n"
+        "for i = 1,1000 do data[i] = i end\n"
+        "sys.save_async(file, data, on_saved, { chunked = true, chunk_size = 16 })\n"));
+
+    dmScript::HContext context = dmScript::NewContext(0, 0, true);
+    dmScript::Initialize(context);
+    lua_State* other_L = dmScript::GetLuaState(context);
+    ASSERT_TRUE(RunString(other_L,
+        "file = sys.get_save_file(\"my_game\", \"save_async_finalize.save\")\n"
+        "os.remove(file)\n"
+        "sys.save_async(file, { name = \"finalized\" }, nil, { chunked = true, chunk_size = 1 })\n"));
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+
+    ASSERT_TRUE(RunString(L,
+        "local finalized = sys.load(sys.get_save_file(\"my_game\", \"save_async_finalize.save\"))\n"
+        "assert(finalized.name == \"finalized\")\n"));
+}
+
+TEST_F(ScriptSysSaveTest, TestPerfSaveAsync)
+{
+    ASSERT_TRUE(RunString(L,
+        "data = {}\n"
+        "for i = 1,50000 do data[i] = { name = \"item\" .. i, value = i, pos = vmath.vector3(i) } end\n"));
+
+    const char* saves[] = {
+        "sys.save(file, data)",
+        "sys.save_async(file, data, on_saved)",
+        "sys.save_async(file, data, on_saved, { compress = true })",
+        "sys.save_async(file, data, on_saved, { chunked = true })",
+    };
+
+    for (uint32_t i = 0; i < sizeof(saves) / sizeof(saves[0]); ++i)
+    {
+        uint64_t time = dmTime::GetTime();
+        ASSERT_TRUE(RunString(L, saves[i]));
+        uint64_t call_time = dmTime::GetTime() - time;
+
+        // Main thread time spent in the updates until the file is written
+        uint64_t update_time = 0;
+        uint64_t max_update_time = 0;
+        uint32_t updates = 0;
+        if (i > 0)
+        {
+            for (;;)
+            {
+                time = dmTime::GetTime();
+                dmScript::Update(m_Context);
+                time = dmTime::GetTime() - time;
+                update_time += time;
+                max_update_time = time > max_update_time ? time : max_update_time;
+                ++updates;
+
+                lua_getglobal(L, "saved");
+                bool saved = !lua_isnil(L, -1);
+                lua_pop(L, 1);
+                if (saved)
+                    break;
+                dmTime::Sleep(1000);
+            }
+            ASSERT_TRUE(RunString(L, "assert(saved.success) saved = nil"));
+        }
+        printf("%-60s call: %.3f ms, updates: %.3f ms (%u updates, max %.3f ms each)\n", saves[i], call_time / 1000.0, update_time / 1000.0, updates, max_update_time / 1000.0);
+    }
+}
+
 int main(int argc, char **argv)
 {
     TestMainPlatformInit();
@@ -14,6 +14,7 @@
 
 #include "../script.h"
 #include "../script_timer_private.h"
+#include <dlib/time.h>
 #include "test_script.h"
 
 #include <testmain/testmain.h>
@@ -706,6 +707,100 @@ TEST_F(ScriptTimerTest, TestKillTimers)
     dmScript::DeleteTimerWorld(timer_world);
 }
 
+TEST_F(ScriptTimerTest, TestStaleHandle)
+{
+    dmScript::HTimerWorld timer_world = dmScript::NewTimerWorld();
+
+    dmScript::HTimer handle1 = dmScript::AddTimer(timer_world, 1.0f, false, TestCallback, 0x10, 0x0);
+    dmScript::UpdateTimers(timer_world, 1.f);
+    ASSERT_EQ(1u, TimerTestCallback::callback_count);
+
+    // The new timer reuses the slot of the first timer
+    dmScript::HTimer handle2 = dmScript::AddTimer(timer_world, 1.0f, false, TestCallback, 0x10, 0x0);
+    ASSERT_NE(handle1, handle2);
+    ASSERT_FALSE(dmScript::CancelTimer(timer_world, handle1));
+    ASSERT_EQ(1u, GetAliveTimers(timer_world));
+    ASSERT_TRUE(dmScript::CancelTimer(timer_world, handle2));
+    ASSERT_EQ(0u, GetAliveTimers(timer_world));
+
+    dmScript::DeleteTimerWorld(timer_world);
+}
+
+TEST_F(ScriptTimerTest, TestTriggerOrder)
+{
+    dmScript::HTimerWorld timer_world = dmScript::NewTimerWorld();
+
+    static uint32_t order[4];
+    static uint32_t count = 0;
+    count = 0;
+
+    struct Callback {
+        static void cb(dmScript::HTimerWorld timer_world, dmScript::TimerEventType event_type, dmScript::HTimer timer_handle, float time_elapsed, uintptr_t owner, uintptr_t userdata)
+        {
+            order[count++] = (uint32_t)userdata;
+        }
+    };
+
+    // Timers with the same expiry time trigger in the order they were added
+    dmScript::AddTimer(timer_world, 2.0f, false, Callback::cb, 0x10, 2);
+    dmScript::AddTimer(timer_world, 1.0f, false, Callback::cb, 0x10, 0);
+    dmScript::AddTimer(timer_world, 1.0f, false, Callback::cb, 0x10, 1);
+    dmScript::AddTimer(timer_world, 2.0f, false, Callback::cb, 0x10, 3);
+
+    dmScript::UpdateTimers(timer_world, 5.f);
+    ASSERT_EQ(4u, count);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        ASSERT_EQ(i, order[i]);
+    }
+
+    dmScript::DeleteTimerWorld(timer_world);
+}
+
+TEST_F(ScriptTimerTest, TestManyTimersPerformance)
+{
+    dmScript::HTimerWorld timer_world = dmScript::NewTimerWorld();
+
+    const uint32_t timer_count = 100000;
+    const uint32_t owner_count = 1000;
+
+    uint64_t tstart = dmTime::GetTime();
+    for (uint32_t i = 0; i < timer_count; ++i)
+    {
+        // Mostly long timers, 9% of them trigger during the simulated 10 seconds
+        float delay = 1.05f + (i % 1000) * 0.1f;
+        dmScript::HTimer handle = dmScript::AddTimer(timer_world, delay, false, TestCallback, 1 + (i % owner_count), 0x0);
+        ASSERT_NE(dmScript::INVALID_TIMER_HANDLE, handle);
+    }
+    uint64_t tadd = dmTime::GetTime() - tstart;
+    ASSERT_EQ(timer_count, GetAliveTimers(timer_world));
+
+    const uint32_t update_count = 600;
+    tstart = dmTime::GetTime();
+    for (uint32_t i = 0; i < update_count; ++i)
+    {
+        dmScript::UpdateTimers(timer_world, 1.0f / 60.0f);
+    }
+    uint64_t tupdate = dmTime::GetTime() - tstart;
+    ASSERT_EQ(9000u, TimerTestCallback::callback_count);
+    ASSERT_EQ(timer_count - 9000u, GetAliveTimers(timer_world));
+
+    tstart = dmTime::GetTime();
+    uint32_t kill_count = 0;
+    for (uint32_t i = 0; i < owner_count; ++i)
+    {
+        kill_count += dmScript::KillTimers(timer_world, 1 + i);
+    }
+    uint64_t tkill = dmTime::GetTime() - tstart;
+    ASSERT_EQ(timer_count - 9000u, kill_count);
+    ASSERT_EQ(0u, GetAliveTimers(timer_world));
+
+    printf("%u timers: add %.3f ms, %u updates %.3f ms (%.4f ms/update), kill %u owners %.3f ms\n", timer_count,
+            tadd / 1000.0f, update_count, tupdate / 1000.0f, tupdate / (1000.0f * update_count), owner_count, tkill / 1000.0f);
+
+    dmScript::DeleteTimerWorld(timer_world);
+}
+
 static dmScript::HTimer cb_callback_handle = dmScript::INVALID_TIMER_HANDLE;
 static uint32_t cb_callback_counter = 0u;
 static float cb_elapsed_time = 0.0f;